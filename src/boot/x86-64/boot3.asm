@@ -4,6 +4,27 @@ ORG 0x8200
 
 BITS 64
 
+STACK_POINTER_INIT	equ	0x9C00
+
+; the initrd is loaded to INITRD_LOAD, and its address and size (or zeros if
+; it wasn't loaded) are left at INITRD_INFO for the kernel.  see
+; read_boot_initrd_info() in the kernel
+INITRD_LBA		equ	20480
+INITRD_LOAD		equ	0x400000
+INITRD_MAX_SIZE		equ	0xC00000	; up to 12MB, so it ends at 0x1000000, where the kernel stack starts
+INITRD_MAGIC		equ	'CSINITRD'	; version 2 images start with this
+INITRD_SIZE_OFFSET	equ	32		; of the image size, in the header
+INITRD_INFO		equ	0xF000
+
+IDENTITY_PDT	equ	0x12000		; the PDT boot2 identity-maps the first 2MB with
+
+ATA_DATA	equ	0x1F0
+ATA_COUNT	equ	0x1F2
+ATA_READ	equ	0x20
+ATA_BSY		equ	0x80
+ATA_DRQ		equ	0x08
+ATA_ERR		equ	0x01
+
 cli                           ; Clear the interrupt flag.
 
 ; set up pages for kernel stack
@@ -41,48 +62,68 @@ add rbx, 8
 mov [rbx], rax
 
 ; and finally, fill out the page table entries, eight megabytes
-; starting at 0x100000
+; starting at 0x1000000.  the four page tables are side by side, and so
+; are the pages, so it's one run of 2048 entries
 
 mov edi, [ptKstackBase1]
-mov ecx, 512
+mov ecx, 2048
 mov ebx, [kStackLoc1]
 add ebx, 3
-.fillK1:
+.fillK:
 	mov DWORD [edi], ebx
 	add ebx, 0x1000
 	add edi, 8
-	loop .fillK1
+	loop .fillK
 
-mov edi, [ptKstackBase2]
-mov ecx, 512
-mov ebx, [kStackLoc2]
-add ebx, 3
-.fillK2:
-	mov DWORD [edi], ebx
-	add ebx, 0x1000
-	add edi, 8
-	loop .fillK2
-	
-mov edi, [ptKstackBase3]
-mov ecx, 512
-mov ebx, [kStackLoc3]
-add ebx, 3
-.fillK3:
-	mov DWORD [edi], ebx
-	add ebx, 0x1000
-	add edi, 8
-	loop .fillK3
-	
-mov edi, [ptKstackBase4]
-mov ecx, 512
-mov ebx, [kStackLoc4]
-add ebx, 3
-.fillK4:
+; load the initrd, so the kernel can read it from memory rather than the disk.
+; identity-map 2MB-16MB with 2MB pages, so there's somewhere to put it
+mov edi, IDENTITY_PDT + 8
+mov ebx, 0x200000 + 0x83	; present, writable, 2MB page
+mov ecx, 7
+.mapLow:
 	mov DWORD [edi], ebx
-	add ebx, 0x1000
+	add ebx, 0x200000
 	add edi, 8
-	loop .fillK4
-	
+	loop .mapLow
+
+mov esp, STACK_POINTER_INIT
+cld
+
+; nothing loaded, unless we get to the end
+xor eax, eax
+mov [INITRD_INFO], rax
+mov [INITRD_INFO + 8], rax
+
+; the first sector says how big the image is.  version 1 images don't, so
+; they're left on the disk
+mov edi, INITRD_LOAD
+mov ebx, INITRD_LBA
+call readSector
+jc .initrdDone
+mov rax, INITRD_MAGIC
+cmp [INITRD_LOAD], rax
+jne .initrdDone
+mov rcx, [INITRD_LOAD + INITRD_SIZE_OFFSET]
+cmp rcx, INITRD_MAX_SIZE
+ja .initrdDone
+mov [INITRD_INFO + 8], rcx
+add rcx, 511
+shr rcx, 9
+jrcxz .initrdDone
+dec rcx
+
+.readInitrd:
+	jrcxz .initrdLoaded
+	call readSector
+	jc .initrdDone
+	dec rcx
+	jmp .readInitrd
+
+.initrdLoaded:
+mov DWORD [INITRD_INFO], INITRD_LOAD
+
+.initrdDone:
+
 ; set the new stack pointer
 mov rsp, 0x0
     
@@ -90,6 +131,48 @@ mov rax, [kernelAddress]
 
 jmp rax
 
+; read the sector at lba ebx, from the primary master by PIO, to edi.  moves
+; both on.  carry is set if the drive reports an error
+readSector:
+	push rcx
+	mov dx, ATA_COUNT
+	mov al, 1
+	out dx, al
+	mov eax, ebx
+	inc dx			; lba low
+	out dx, al
+	shr eax, 8
+	inc dx			; lba mid
+	out dx, al
+	shr eax, 8
+	inc dx			; lba high
+	out dx, al
+	shr eax, 8
+	or al, 0xE0		; master, lba addressing
+	inc dx			; drive
+	out dx, al
+	mov al, ATA_READ
+	inc dx			; command
+	out dx, al
+.wait:
+	in al, dx		; status
+	test al, ATA_BSY
+	jnz .wait
+	test al, ATA_ERR
+	jnz .error
+	test al, ATA_DRQ
+	jz .wait
+	mov dx, ATA_DATA
+	mov ecx, 256
+	rep insw
+	inc ebx			; carry is still clear from the test
+	pop rcx
+	ret
+.error:
+	stc
+	pop rcx
+	ret
+
 kernelAddress	dq	0xFFFF800000000000
     
 pml4Base	dq	0x00010000
@@ -97,13 +180,7 @@ pml4Base	dq	0x00010000
 pdptKstackBase	dq	0x00020000
 pdtKstackBase	dq	0x00021000
 ptKstackBase1	dq	0x00022000
-ptKstackBase2	dq	0x00023000
-ptKstackBase3	dq	0x00024000
-ptKstackBase4	dq	0x00025000
 
 kStackLoc1	dq	0x001000000
-kStackLoc2	dq	0x001200000
-kStackLoc3	dq	0x001400000
-kStackLoc4	dq	0x001600000
 
 times 512 - ($-$$) db 0
\ No newline at end of file
@@ -10,6 +10,7 @@
 #include <obj/logical/ethernet/ethernet.h>
 #include <obj/logical/fs/initrd/initrd.h>
 #include <obj/logical/fs/objfs/objfs.h>
+#include <obj/logical/fs/swap/swap.h>
 #include <obj/logical/fs/voh/voh.h>
 #include <obj/logical/group/group.h>
 #include <obj/logical/hostid/hostid.h>
@@ -28,7 +29,12 @@
 #include <obj/logical/user/user.h>
 #include <sys/fs/fs_facade.h>
 #include <sys/kprintf/kprintf.h>
+#include <sys/netpoll/netpoll.h>
+#include <sys/obj/object/object.h>
+#include <sys/obj/objectinterface/objectinterface_ip.h>
 #include <sys/obj/objectmgr/objectmgr.h>
+#include <sys/x86-64/mm/mm.h>
+#include <sys/x86-64/mm/pagetables.h>
 #include <types.h>
 
 void attach_logical_objects() {
@@ -103,9 +109,12 @@ void attach_logical_objects() {
     /*
     * tick device
     */
+    struct object* tick = 0;
     struct object* pit = objectmgr_find_object_by_name("pit0");
     if (0 != pit) {
-        tick_attach(pit);
+        tick = tick_attach(pit);
+        // NICs with frames waiting are polled when the kernel is idle, and by threads waiting, once a tick
+        netpoll_attach_tick(tick);
     } else {
         kprintf("Unable to find %s\n", "pit0");
     }
@@ -115,10 +124,13 @@ void attach_logical_objects() {
     struct object* vnic = objectmgr_find_object_by_name("vnic0");
     if (0 != vnic) {
         struct object* eth = ethernet_attach(vnic);
-        arp_attach(eth);
+        struct object* arp = arp_attach(eth);
         icmp_attach(eth);
-        struct object* ip_dev = ip_attach(eth);
-        tcp_attach(ip_dev);
+        struct object* ip_dev = ip_attach(eth, arp);
+        // the QEMU user network hands out 10.0.2.15, with the host at 10.0.2.2
+        struct objectinterface_ip* ip_api = (struct objectinterface_ip*)ip_dev->api;
+        (*ip_api->configure)(ip_dev, IP_ADDRESS(10, 0, 2, 15), IP_ADDRESS(255, 255, 255, 0), IP_ADDRESS(10, 0, 2, 2));
+        tcp_attach(ip_dev, tick);
         udp_attach(ip_dev);
 
         // test arp!
@@ -131,11 +143,28 @@ void attach_logical_objects() {
     struct object* initrd_dev = 0;
     struct object* dsk = objectmgr_find_object_by_name(devicename);
     if (0 != dsk) {
-        initrd_dev = initrd_attach(dsk, initrd_lba());
+        // boot3 loads a version 2 initrd into memory, so reads needn't go to the disk
+        boot_initrd_info* boot_initrd = read_boot_initrd_info();
+        if (0 != boot_initrd->base) {
+            initrd_dev = initrd_attach_image(dsk, initrd_lba(), (uint8_t*)CONV_PHYS_ADDR(boot_initrd->base),
+                                             boot_initrd->size);
+        } else {
+            initrd_dev = initrd_attach(dsk, initrd_lba());
+        }
     } else {
         kprintf("Unable to find %s\n", devicename);
     }
     /*
+    * swap
+    */
+    uint8_t swapname[] = {SWAP_DISK};
+    struct object* swap_dsk = objectmgr_find_object_by_name(swapname);
+    if (0 != swap_dsk) {
+        reclaim_set_swap(swap_attach(swap_dsk));
+    } else {
+        kprintf("Unable to find %s\n", swapname);
+    }
+    /*
     * fs0
     */
     struct object* fs0_dev = objectmgr_find_object_by_name("fs0");
@@ -5,20 +5,42 @@
 // See the file "LICENSE" in the source distribution for details  *
 // ****************************************************************
 
+#include <obj/logical/ethernet/ethernet.h>
+#include <obj/logical/tcpip/ip/ipdev.h>
+#include <obj/logical/tcpip/net_endian.h>
 #include <sys/debug/assert.h>
 #include <sys/kmalloc/kmalloc.h>
 #include <sys/kprintf/kprintf.h>
+#include <sys/netbuf/netbuf.h>
 #include <sys/obj/object/object.h>
 #include <sys/obj/objectinterface/objectinterface_ethernet.h>
 #include <sys/obj/objectinterface/objectinterface_nic.h>
 #include <sys/obj/objectmgr/objectmgr.h>
 #include <sys/obj/objecttype/objectype.h>
+#include <sys/panic/panic.h>
 #include <sys/string/mem.h>
 #include <types.h>
 
+#define ETHERNET_MAX_PROTOCOLS 4
+
+uint8_t ethernet_broadcast_hw[ETHERNET_HW_LEN] = {0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF};
+
+struct ethernet_protocol {
+    uint16_t type;
+    struct object* protocol;
+    ethernet_input_function input;
+};
+
 struct ethernet_objectdata {
     struct object* nic_device;
-} __attribute__((packed));
+    uint8_t hw_address[ETHERNET_HW_LEN];
+    struct ethernet_protocol protocols[ETHERNET_MAX_PROTOCOLS];
+    uint64_t rx_frames;
+    uint64_t rx_dropped;
+    uint64_t tx_frames;
+};
+
+void ethernet_receive(struct object* obj, struct netbuf* frame);
 
 /*
  * perform device instance specific init here
@@ -27,6 +49,16 @@ uint8_t ethernet_init(struct object* obj) {
     ASSERT_NOT_NULL(obj);
     ASSERT_NOT_NULL(obj->object_data);
     struct ethernet_objectdata* object_data = (struct ethernet_objectdata*)obj->object_data;
+    struct objectinterface_nic* nic_api = (struct objectinterface_nic*)object_data->nic_device->api;
+    /*
+     * our address, and have the NIC hand us what it receives
+     */
+    if (0 != nic_api->hw_address) {
+        (*nic_api->hw_address)(object_data->nic_device, object_data->hw_address);
+    }
+    if (0 != nic_api->set_receiver) {
+        (*nic_api->set_receiver)(object_data->nic_device, obj, &ethernet_receive);
+    }
     kprintf("Init %s on %s (%s)\n", obj->description, object_data->nic_device->name, obj->name);
     return 1;
 }
@@ -36,34 +68,123 @@ uint8_t ethernet_init(struct object* obj) {
  */
 uint8_t ethernet_uninit(struct object* obj) {
     ASSERT_NOT_NULL(obj);
+    ASSERT_NOT_NULL(obj->object_data);
     kprintf("Uninit %s (%s)\n", obj->description, obj->name);
+    struct ethernet_objectdata* object_data = (struct ethernet_objectdata*)obj->object_data;
+    struct objectinterface_nic* nic_api = (struct objectinterface_nic*)object_data->nic_device->api;
+    if (0 != nic_api->set_receiver) {
+        (*nic_api->set_receiver)(object_data->nic_device, 0, 0);
+    }
     kfree(obj->api);
     kfree(obj->object_data);
 
     return 1;
 }
 
-void ethernet_read(struct object* obj, struct eth_hdr* eth, uint16_t size) {
+/*
+ * frames from the NIC. pass the payload to whoever registered the EtherType
+ */
+void ethernet_receive(struct object* obj, struct netbuf* frame) {
     ASSERT_NOT_NULL(obj);
     ASSERT_NOT_NULL(obj->object_data);
-    ASSERT_NOT_NULL(eth);
+    ASSERT_NOT_NULL(frame);
     struct ethernet_objectdata* object_data = (struct ethernet_objectdata*)obj->object_data;
-    struct objectinterface_nic* nic_api = (struct objectinterface_nic*)object_data->nic_device->api;
-    nic_api->read(object_data->nic_device, (uint8_t*)eth, size);
+    object_data->rx_frames++;
+
+    if (frame->len < ETHERNET_HEADER_LEN) {
+        object_data->rx_dropped++;
+        return;
+    }
+    struct eth_hdr* eth = (struct eth_hdr*)frame->data;
+
+    // for us, or for everyone
+    if ((0 != memcmp(eth->dest_hw, object_data->hw_address, ETHERNET_HW_LEN)) &&
+        (0 != memcmp(eth->dest_hw, ethernet_broadcast_hw, ETHERNET_HW_LEN))) {
+        object_data->rx_dropped++;
+        return;
+    }
+
+    uint16_t type = switch_endian16(eth->type);
+    for (uint8_t i = 0; i < ETHERNET_MAX_PROTOCOLS; i++) {
+        struct ethernet_protocol* p = &(object_data->protocols[i]);
+        if ((0 != p->input) && (p->type == type)) {
+            // the header stays in the buffer, in front of the payload, so eth is still good
+            netbuf_pull(frame, ETHERNET_HEADER_LEN);
+            (*p->input)(p->protocol, eth, frame);
+            return;
+        }
+    }
+    object_data->rx_dropped++;
 }
 
-void ethernet_write(struct object* obj, struct eth_hdr* eth, uint16_t size) {
+void ethernet_write(struct object* obj, uint8_t* dest_hw, uint16_t type, struct netbuf* payload) {
     ASSERT_NOT_NULL(obj);
     ASSERT_NOT_NULL(obj->object_data);
-    ASSERT_NOT_NULL(eth);
+    ASSERT_NOT_NULL(dest_hw);
+    ASSERT_NOT_NULL(payload);
+    ASSERT(netbuf_length(payload) <= ETHERNET_MTU);
     struct ethernet_objectdata* object_data = (struct ethernet_objectdata*)obj->object_data;
     struct objectinterface_nic* nic_api = (struct objectinterface_nic*)object_data->nic_device->api;
-    nic_api->write(object_data->nic_device, (uint8_t*)eth, size);
+
+    // a checksum left for the NIC is done here if the NIC can't
+    if (NETBUF_CSUM_PARTIAL == payload->csum) {
+        uint8_t offload = (0 != nic_api->offload) ? (*nic_api->offload)(object_data->nic_device) : 0;
+        if (0 == (offload & NIC_OFFLOAD_TX_CSUM)) {
+            ip_checksum_complete(payload);
+        }
+    }
+
+    struct eth_hdr* eth = (struct eth_hdr*)netbuf_push(payload, ETHERNET_HEADER_LEN);
+    memcpy(eth->dest_hw, dest_hw, ETHERNET_HW_LEN);
+    memcpy(eth->source_hw, object_data->hw_address, ETHERNET_HW_LEN);
+    eth->type = switch_endian16(type);
+
+    object_data->tx_frames++;
+    (*nic_api->write)(object_data->nic_device, payload);
+}
+
+void ethernet_register_protocol(struct object* obj, uint16_t type, struct object* protocol,
+                                ethernet_input_function input) {
+    ASSERT_NOT_NULL(obj);
+    ASSERT_NOT_NULL(obj->object_data);
+    struct ethernet_objectdata* object_data = (struct ethernet_objectdata*)obj->object_data;
+
+    // replace, or remove if input is null
+    for (uint8_t i = 0; i < ETHERNET_MAX_PROTOCOLS; i++) {
+        struct ethernet_protocol* p = &(object_data->protocols[i]);
+        if ((0 != p->input) && (p->type == type)) {
+            p->protocol = protocol;
+            p->input = input;
+            return;
+        }
+    }
+    if (0 == input) {
+        return;
+    }
+    for (uint8_t i = 0; i < ETHERNET_MAX_PROTOCOLS; i++) {
+        struct ethernet_protocol* p = &(object_data->protocols[i]);
+        if (0 == p->input) {
+            p->type = type;
+            p->protocol = protocol;
+            p->input = input;
+            return;
+        }
+    }
+    PANIC("Too many EtherTypes registered");
+}
+
+void ethernet_hw_address(struct object* obj, uint8_t* hw_address) {
+    ASSERT_NOT_NULL(obj);
+    ASSERT_NOT_NULL(obj->object_data);
+    ASSERT_NOT_NULL(hw_address);
+    struct ethernet_objectdata* object_data = (struct ethernet_objectdata*)obj->object_data;
+    memcpy(hw_address, object_data->hw_address, ETHERNET_HW_LEN);
 }
 
 struct object* ethernet_attach(struct object* nic_device) {
     ASSERT_NOT_NULL(nic_device);
-    ASSERT((nic_device->objectype == OBJECT_TYPE_NIC) || (nic_device->objectype == OBJECT_TYPE_VNIC));
+    ASSERT((nic_device->objectype == OBJECT_TYPE_NIC) || (nic_device->objectype == OBJECT_TYPE_VNIC) ||
+           (nic_device->objectype == OBJECT_TYPE_LOOPBACK));
     /*
      * register device
      */
@@ -79,13 +200,15 @@ struct object* ethernet_attach(struct object* nic_device) {
     struct objectinterface_ethernet* api =
         (struct objectinterface_ethernet*)kmalloc(sizeof(struct objectinterface_ethernet));
     memzero((uint8_t*)api, sizeof(struct objectinterface_ethernet));
-    api->read = &ethernet_read;
     api->write = &ethernet_write;
+    api->register_protocol = &ethernet_register_protocol;
+    api->hw_address = &ethernet_hw_address;
     objectinstance->api = api;
     /*
      * device data
      */
     struct ethernet_objectdata* object_data = (struct ethernet_objectdata*)kmalloc(sizeof(struct ethernet_objectdata));
+    memzero((uint8_t*)object_data, sizeof(struct ethernet_objectdata));
     object_data->nic_device = nic_device;
     objectinstance->object_data = object_data;
     /*
@@ -121,17 +244,3 @@ void ethernet_detach(struct object* obj) {
     */
     objectmgr_detach_object(obj);
 }
-
-void ethernet_init_eth(struct eth_hdr* eth, uint8_t* hw_source, uint8_t* hw_dest, uint8_t* data,
-                       uint16_t payload_size) {
-    ASSERT_NOT_NULL(eth);
-    ASSERT_NOT_NULL(hw_source);
-    ASSERT_NOT_NULL(hw_dest);
-    ASSERT_NOT_NULL(data);
-    ASSERT(payload_size <= 1500);
-    memzero((uint8_t*)eth, sizeof(struct eth_hdr));
-    memcpy((uint8_t*)&(eth->dest_hw), hw_dest, 6);
-    memcpy((uint8_t*)&(eth->source_hw), hw_source, 6);
-    eth->data = data;
-    eth->type = payload_size;
-}
@@ -15,6 +15,6 @@ struct object;
 struct object* ethernet_attach(struct object* nic_device);
 void ethernet_detach(struct object* obj);
 
-// hw_source and hw_dest are 6 bytes
-void ethernet_init_eth(struct eth_hdr* eth, uint8_t* hw_source, uint8_t* hw_dest, uint8_t* data, uint16_t payload_size);
+// ff:ff:ff:ff:ff:ff
+extern uint8_t ethernet_broadcast_hw[ETHERNET_HW_LEN];
 #endif
\ No newline at end of file
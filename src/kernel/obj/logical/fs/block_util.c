@@ -78,7 +78,7 @@ uint32_t blockutil_write(struct object* obj, uint8_t* data, uint32_t data_size,
     if (0 != (data_size + start_byte) % sector_size) {
         total_sectors += 1;
     }
-    ASSERT((start_lba + total_sectors) < sector_count);
+    ASSERT((start_lba + total_sectors) <= sector_count);
 
     // get the api
     struct objectinterface_block* block_api = (struct objectinterface_block*)obj->api;
@@ -118,6 +118,78 @@ uint32_t blockutil_write(struct object* obj, uint8_t* data, uint32_t data_size,
     }
 }
 
+/*
+ * write bytes over part of the disk, keeping the rest of the first and last sectors
+ */
+uint32_t blockutil_update(struct object* obj, const uint8_t* data, uint32_t data_size, uint32_t start_lba,
+                          uint32_t start_byte) {
+    ASSERT_NOT_NULL(obj);
+    ASSERT_NOT_NULL(obj->api);
+    ASSERT_NOT_NULL(data);
+    ASSERT(data_size > 0);
+    ASSERT(1 == blockutil_is_block_object(obj));
+
+    uint32_t sector_count = blockutil_get_sector_count(obj);
+    uint32_t sector_size = blockutil_get_sector_size(obj);
+    ASSERT(sector_size > start_byte);
+    uint32_t total_sectors = (data_size + start_byte) / sector_size;
+    if (0 != (data_size + start_byte) % sector_size) {
+        total_sectors += 1;
+    }
+    ASSERT((start_lba + total_sectors) <= sector_count);
+
+    struct objectinterface_block* block_api = (struct objectinterface_block*)obj->api;
+    ASSERT_NOT_NULL(block_api->read);
+    if (0 == block_api->write) {
+        // read-only
+        return 0;
+    }
+
+    uint32_t total_bytes_written = 0;
+    uint32_t lba = start_lba;
+
+    // a partial first sector is read, changed and written back
+    if ((0 != start_byte) || (data_size < sector_size)) {
+        uint8_t buffer[sector_size];
+        uint32_t read = (*block_api->read)(obj, buffer, sector_size, lba);
+        ASSERT(read == sector_size);
+        uint32_t needed = sector_size - start_byte;
+        if (needed > data_size) {
+            needed = data_size;
+        }
+        memcpy(&(buffer[start_byte]), data, needed);
+        uint32_t written = (*block_api->write)(obj, buffer, sector_size, lba);
+        ASSERT(written == sector_size);
+        total_bytes_written += needed;
+        lba += 1;
+    }
+
+    // whole sectors go straight from data, as many to a request as the device takes
+    while ((data_size - total_bytes_written) >= sector_size) {
+        uint32_t count = (data_size - total_bytes_written) / sector_size;
+        if (count > BLOCKUTIL_MAX_TRANSFER) {
+            count = BLOCKUTIL_MAX_TRANSFER;
+        }
+        uint32_t written =
+            (*block_api->write)(obj, (uint8_t*)&(data[total_bytes_written]), count * sector_size, lba);
+        ASSERT(written == count * sector_size);
+        total_bytes_written += written;
+        lba += count;
+    }
+
+    // and a partial last sector
+    if (total_bytes_written < data_size) {
+        uint8_t buffer[sector_size];
+        uint32_t read = (*block_api->read)(obj, buffer, sector_size, lba);
+        ASSERT(read == sector_size);
+        memcpy(buffer, &(data[total_bytes_written]), data_size - total_bytes_written);
+        uint32_t written = (*block_api->write)(obj, buffer, sector_size, lba);
+        ASSERT(written == sector_size);
+        total_bytes_written = data_size;
+    }
+    return total_bytes_written;
+}
+
 /*
  * read multiple sectors
  */
@@ -148,37 +220,51 @@ uint32_t blockutil_read(struct object* obj, uint8_t* data, uint32_t data_size, u
     if (0 != (data_size + start_byte) % sector_size) {
         total_sectors += 1;
     }
-    ASSERT((start_lba + total_sectors) < sector_count);
+    ASSERT((start_lba + total_sectors) <= sector_count);
 
     // get the api
     struct objectinterface_block* block_api = (struct objectinterface_block*)obj->api;
     ASSERT_NOT_NULL(block_api);
     ASSERT_NOT_NULL(block_api->read);
 
-    // loop over lbas, reading a sector at a time and copying into the data
     uint32_t total_bytes_copied = 0;
-    for (uint32_t i = 0; i < total_sectors; i++) {
+    uint32_t lba = start_lba;
+
+    // a partial first sector goes through a buffer
+    if ((0 != start_byte) || (data_size < sector_size)) {
         uint8_t buffer[sector_size];
         memzero(buffer, sector_size);
-        uint32_t read = (*block_api->read)(obj, buffer, sector_size, i + start_lba);
+        uint32_t read = (*block_api->read)(obj, buffer, sector_size, lba);
         ASSERT(read == sector_size);
-        if (i == 0) {
-            uint32_t needed = sector_size - start_byte;
-            if (needed > data_size) {
-                needed = data_size;
-            }
-            //      kprintf("needed %llu\n", needed);
-            memcpy(&(data[total_bytes_copied]), &(buffer[start_byte]), needed);
-            total_bytes_copied += needed;
-        } else if (i == total_sectors - 1) {
-            uint32_t offset = data_size - total_bytes_copied;
-            //      kprintf("offset %llu\n", offset);
-            memcpy(&(data[total_bytes_copied]), buffer, offset);
-            total_bytes_copied += offset;
-        } else {
-            memcpy(&(data[total_bytes_copied]), buffer, sector_size);
-            total_bytes_copied += sector_size;
+        uint32_t needed = sector_size - start_byte;
+        if (needed > data_size) {
+            needed = data_size;
+        }
+        memcpy(data, &(buffer[start_byte]), needed);
+        total_bytes_copied += needed;
+        lba += 1;
+    }
+
+    // whole sectors go straight into data, as many to a request as the device takes
+    while ((data_size - total_bytes_copied) >= sector_size) {
+        uint32_t count = (data_size - total_bytes_copied) / sector_size;
+        if (count > BLOCKUTIL_MAX_TRANSFER) {
+            count = BLOCKUTIL_MAX_TRANSFER;
         }
+        uint32_t read = (*block_api->read)(obj, &(data[total_bytes_copied]), count * sector_size, lba);
+        ASSERT(read == count * sector_size);
+        total_bytes_copied += read;
+        lba += count;
+    }
+
+    // and a partial last sector
+    if (total_bytes_copied < data_size) {
+        uint8_t buffer[sector_size];
+        memzero(buffer, sector_size);
+        uint32_t read = (*block_api->read)(obj, buffer, sector_size, lba);
+        ASSERT(read == sector_size);
+        memcpy(&(data[total_bytes_copied]), buffer, data_size - total_bytes_copied);
+        total_bytes_copied = data_size;
     }
 
     // done
@@ -12,6 +12,11 @@
 
 struct object;
 
+/*
+* the most sectors asked of a device in one request.  ATA counts sectors in a byte
+*/
+#define BLOCKUTIL_MAX_TRANSFER 128
+
 uint32_t blockutil_get_sector_size(struct object* obj);
 uint32_t blockutil_get_sector_count(struct object* obj);
 uint32_t blockutil_get_total_size(struct object* obj);
@@ -27,12 +32,18 @@ uint32_t blockutil_get_total_size(struct object* obj);
 uint32_t blockutil_write(struct object* obj, uint8_t* data, uint32_t data_size, uint32_t start_lba,
                          uint32_t start_byte);
 /*
+* like blockutil_write, but the parts of the first and last sectors outside the data are kept rather than zeroed
+*/
+uint32_t blockutil_update(struct object* obj, const uint8_t* data, uint32_t data_size, uint32_t start_lba,
+                          uint32_t start_byte);
+/*
 * write bytes from 'data'.  'data_size' is the number of bytes to write and 'start_lba' is the starting lba.
 * return total bytes written
 */
 /*
 * the total data read from the block device is sectors * sector size, which may be larger than data_size
 * only data_size bytes will be written to data.  data reading starts from "start_byte" bytes into first sector.
+* whole sectors are read straight into data, up to BLOCKUTIL_MAX_TRANSFER at a time
 */
 uint32_t blockutil_read(struct object* obj, uint8_t* data, uint32_t data_size, uint32_t start_lba, uint32_t start_byte);
 /*
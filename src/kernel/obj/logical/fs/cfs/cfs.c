@@ -7,6 +7,7 @@
 
 #include <obj/logical/fs/block_util.h>
 #include <obj/logical/fs/cfs/cfs.h>
+#include <sys/collection/arraylist/arraylist.h>
 #include <sys/debug/assert.h>
 #include <sys/kmalloc/kmalloc.h>
 #include <sys/kprintf/kprintf.h>
@@ -17,14 +18,16 @@
 #include <sys/string/mem.h>
 #include <types.h>
 
+#define CFS_BLOCK_SIZE 512
+
 /*
- * every 512 byte sector contains 512 bytes of sector map
+ * every 512 byte sector of sector map has its magic number, then 504 bytes of map
  */
-#define SECTORMAP_BYTE_PER_SECTORS 512
+#define SECTORMAP_BYTE_PER_SECTORS (CFS_BLOCK_SIZE - 8)
 /*
  * 1 bit per sector
  */
-#define SECTORS_MAPPED_PER_SECTOR SECTORMAP_BYTE_PER_SECTORS * 8
+#define SECTORS_MAPPED_PER_SECTOR (SECTORMAP_BYTE_PER_SECTORS * 8)
 
 #define CFS_MAGIC_SUPERBLOCK 0x303244594C4F4647
 #define CFS_MAGIC_DATA_DIR 0x30324D4C424D4C42
@@ -34,6 +37,24 @@
 #define CFS_MAGIC_PRESENTATION 0x4E45444942454F00
 #define CFS_MAGIC_GROUP 0x535241484E444900
 #define CFS_MAGIC_BLOCKMAP 0x535241484E444907
+#define CFS_MAGIC_JOURNAL 0x4C4E524A53464343
+#define CFS_MAGIC_TRANSACTION 0x4E5854534A534643
+
+#define CFS_DIRECTORY_POINTERS 61
+
+/*
+ * the journal.  metadata sectors (blockmaps, directories and the headers of data spaces, presentations and groups)
+ * are changed in memory, and committed to the journal together, as one transaction written in one request.  they
+ * are only written to where they belong (checkpointed) once the journal is half full, or at detach; a sector
+ * changed many times in between is written there once
+ */
+#define CFS_JOURNAL_SECTORS 128
+#define CFS_JOURNAL_MAX_TRANSACTION 60  // sectors, as many as the descriptor has room for
+/*
+ * commit once this many sectors have changed.  an operation changes at most a few, and a transaction holds whole
+ * operations, so it can't pass CFS_JOURNAL_MAX_TRANSACTION
+ */
+#define CFS_JOURNAL_BATCH 48
 
 struct cfs_superblock {
     uint64_t magic;  // CFS_MAGIC_SUPERBLOCK
@@ -41,14 +62,17 @@ struct cfs_superblock {
     uint64_t primary_data_space;
     uint64_t primary_presentation_space;
     uint64_t primary_group_directory;
-    uint64_t reserved[58];
+    uint64_t blockmap_sectors;  // the blockmaps start at lba 1
+    uint64_t journal_start;
+    uint64_t journal_sectors;
+    uint64_t reserved[56];
 } __attribute__((packed));
 
 struct cfs_directory {
     uint64_t magic;  // CFS_MAGIC_DATA_DIR | CFS_MAGIC_PRESENTATION_DIR | CFS_MAGIC_GROUP_DIR
     uint64_t previous;
     uint64_t next;
-    uint64_t pointer[61];
+    uint64_t pointer[CFS_DIRECTORY_POINTERS];  // 0 if free
 } __attribute__((packed));
 
 struct cfs_data {
@@ -67,25 +91,56 @@ struct cfs_groups {
  * bit map of sector status (0 = unused, 1 = used)
  */
 struct cfs_blockmap {
-    uint64_t magic;         // CFS_MAGIC_BLOCKMAP
-    uint8_t map[512 - 64];  // 448 bytes of bitmap, mapping 448*8=3584 sectors
+    uint64_t magic;                          // CFS_MAGIC_BLOCKMAP
+    uint8_t map[SECTORMAP_BYTE_PER_SECTORS];  // 504 bytes of bitmap, mapping 504*8=4032 sectors
+} __attribute__((packed));
+
+/*
+ * the first sector of the journal
+ */
+struct cfs_journal_header {
+    uint64_t magic;     // CFS_MAGIC_JOURNAL
+    uint64_t sequence;  // of the first transaction to replay
+    uint64_t reserved[62];
+} __attribute__((packed));
+
+/*
+ * a transaction is a descriptor followed by the sectors it lists.  the checksum covers the lbas and the sectors,
+ * so a transaction only partly written isn't replayed
+ */
+struct cfs_journal_descriptor {
+    uint64_t magic;  // CFS_MAGIC_TRANSACTION
+    uint64_t sequence;
+    uint64_t count;
+    uint64_t checksum;
+    uint64_t lba[CFS_JOURNAL_MAX_TRANSACTION];
 } __attribute__((packed));
 
+/*
+ * a metadata sector changed since the last checkpoint
+ */
+struct cfs_buffer {
+    uint64_t lba;
+    bool dirty;  // changed since the last commit.  otherwise it's in the journal
+    uint8_t data[CFS_BLOCK_SIZE];
+};
+
 struct cfs_objectdata {
     struct object* partition_object;
-} __attribute__((packed));
+    struct cfs_superblock superblock;
+    struct arraylist* buffers;
+    uint32_t dirty_count;
+    uint64_t sequence;      // of the next transaction
+    uint64_t journal_next;  // where in the journal it goes
+    uint64_t next_free;     // where the next search of the blockmaps starts
+};
 
 /*
  * total number of sectormap sectors for this disk
  */
 uint32_t cfs_total_sectormap_sectors(struct object* obj) {
     uint32_t sectors = blockutil_get_sector_count(obj);
-
-    if (SECTORS_MAPPED_PER_SECTOR >= sectors) {
-        return 1;
-    } else {
-        return (sectors / SECTORS_MAPPED_PER_SECTOR) + 1;
-    }
+    return (sectors + SECTORS_MAPPED_PER_SECTOR - 1) / SECTORS_MAPPED_PER_SECTOR;
 }
 
 /*
@@ -124,36 +179,418 @@ void cfs_read_blockmap(struct object* obj, struct cfs_blockmap* blockmap, uint32
     blockutil_read(obj, (uint8_t*)blockmap, sizeof(struct cfs_blockmap), sector, 0);
 }
 
+void cfs_write_journal_header(struct object* obj, uint64_t journal_start, uint64_t sequence) {
+    struct cfs_journal_header header;
+    memzero((uint8_t*)&header, sizeof(struct cfs_journal_header));
+    header.magic = CFS_MAGIC_JOURNAL;
+    header.sequence = sequence;
+    blockutil_write(obj, (uint8_t*)&header, sizeof(struct cfs_journal_header), journal_start, 0);
+}
+
+uint64_t cfs_directory_magic(uint8_t kind) {
+    switch (kind) {
+        case CFS_KIND_DATA:
+            return CFS_MAGIC_DATA_DIR;
+        case CFS_KIND_PRESENTATION:
+            return CFS_MAGIC_PRESENTATION_DIR;
+        default:
+            return CFS_MAGIC_GROUP_DIR;
+    }
+}
+
 /*
- * format. I just guessed here.
+ * format
  */
-void cfs_format(struct object* obj) {
-    ASSERT_NOT_NULL(obj->object_data);
-    struct cfs_objectdata* object_data = (struct cfs_objectdata*)obj->object_data;
+void cfs_format(struct object* partition_object) {
+    ASSERT_NOT_NULL(partition_object);
+    ASSERT(CFS_BLOCK_SIZE == blockutil_get_sector_size(partition_object));
 
-    uint32_t total_sectors_blockmap = cfs_total_sectormap_sectors(object_data->partition_object);
+    uint32_t sector_count = blockutil_get_sector_count(partition_object);
+    uint32_t total_sectors_blockmap = cfs_total_sectormap_sectors(partition_object);
     // kprintf("Blockmap sectors %llu\n",total_sectors_blockmap);
     /*
-     * superblock
+     * superblock.  blockmaps, then the journal, then the three primary directories
      */
     struct cfs_superblock superblock;
     memset((uint8_t*)&superblock, 0, sizeof(struct cfs_superblock));
     superblock.magic = CFS_MAGIC_SUPERBLOCK;
     superblock.lastmount = 0;
-    superblock.primary_data_space = 2;
-    superblock.primary_presentation_space = 3;
-    superblock.primary_group_directory = 4;
-    cfs_write_superblock(object_data->partition_object, &superblock);
+    superblock.blockmap_sectors = total_sectors_blockmap;
+    superblock.journal_start = 1 + total_sectors_blockmap;
+    superblock.journal_sectors = CFS_JOURNAL_SECTORS;
+    superblock.primary_data_space = superblock.journal_start + superblock.journal_sectors;
+    superblock.primary_presentation_space = superblock.primary_data_space + 1;
+    superblock.primary_group_directory = superblock.primary_data_space + 2;
+    uint32_t used = superblock.primary_group_directory + 1;
+    ASSERT(used < sector_count);
     /*
-     * blockmaps.  first one at lba 1.
+     * blockmaps.  first one at lba 1.  what's above is in use, and so is anything past the end of the disk
      */
     for (uint32_t i = 0; i < total_sectors_blockmap; i++) {
         struct cfs_blockmap blockmap;
-        memset((uint8_t*)&blockmap, 0, sizeof(struct cfs_superblock));
-        cfs_write_blockmap(object_data->partition_object, &blockmap, 1 + i);
+        memset((uint8_t*)&blockmap, 0, sizeof(struct cfs_blockmap));
+        blockmap.magic = CFS_MAGIC_BLOCKMAP;
+        for (uint32_t j = 0; j < SECTORS_MAPPED_PER_SECTOR; j++) {
+            uint32_t sector = (i * SECTORS_MAPPED_PER_SECTOR) + j;
+            if ((sector < used) || (sector >= sector_count)) {
+                blockmap.map[j / 8] |= (1 << (j % 8));
+            }
+        }
+        cfs_write_blockmap(partition_object, &blockmap, 1 + i);
+    }
+    cfs_write_journal_header(partition_object, superblock.journal_start, 1);
+    for (uint8_t kind = 0; kind < CFS_KINDS; kind++) {
+        struct cfs_directory directory;
+        memzero((uint8_t*)&directory, sizeof(struct cfs_directory));
+        directory.magic = cfs_directory_magic(kind);
+        blockutil_write(partition_object, (uint8_t*)&directory, sizeof(struct cfs_directory),
+                        superblock.primary_data_space + kind, 0);
+    }
+    /*
+     * superblock last, so a volume is only CFS once it's all there
+     */
+    cfs_write_superblock(partition_object, &superblock);
+}
+
+/*
+ * FNV-1a
+ */
+uint64_t cfs_checksum(uint64_t hash, const uint8_t* data, uint32_t size) {
+    for (uint32_t i = 0; i < size; i++) {
+        hash = (hash ^ data[i]) * 0x100000001B3;
+    }
+    return hash;
+}
+
+struct cfs_buffer* cfs_buffer_find(struct cfs_objectdata* object_data, uint64_t lba) {
+    for (uint32_t i = 0; i < arraylist_count(object_data->buffers); i++) {
+        struct cfs_buffer* buffer = (struct cfs_buffer*)arraylist_get(object_data->buffers, i);
+        if (buffer->lba == lba) {
+            return buffer;
+        }
+    }
+    return 0;
+}
+
+/*
+ * read a metadata sector, as changed in memory
+ */
+void cfs_meta_read(struct cfs_objectdata* object_data, uint64_t lba, uint8_t* data) {
+    struct cfs_buffer* buffer = cfs_buffer_find(object_data, lba);
+    if (0 != buffer) {
+        memcpy(data, buffer->data, CFS_BLOCK_SIZE);
+    } else {
+        blockutil_read(object_data->partition_object, data, CFS_BLOCK_SIZE, lba, 0);
+    }
+}
+
+/*
+ * change a metadata sector.  nothing is written until the next commit
+ */
+void cfs_meta_write(struct cfs_objectdata* object_data, uint64_t lba, const uint8_t* data) {
+    struct cfs_buffer* buffer = cfs_buffer_find(object_data, lba);
+    if (0 == buffer) {
+        buffer = (struct cfs_buffer*)kmalloc(sizeof(struct cfs_buffer));
+        buffer->lba = lba;
+        buffer->dirty = false;
+        arraylist_add(object_data->buffers, buffer);
+    }
+    memcpy(buffer->data, data, CFS_BLOCK_SIZE);
+    if (!buffer->dirty) {
+        buffer->dirty = true;
+        object_data->dirty_count += 1;
+    }
+}
+
+/*
+ * write every buffer to where it belongs, lowest lba first and consecutive ones together, then empty the journal.
+ * nothing may be dirty
+ */
+void cfs_checkpoint(struct cfs_objectdata* object_data) {
+    ASSERT(0 == object_data->dirty_count);
+    uint32_t count = arraylist_count(object_data->buffers);
+    if (count > 0) {
+        // sort by lba
+        for (uint32_t i = 1; i < count; i++) {
+            struct cfs_buffer* buffer = (struct cfs_buffer*)arraylist_get(object_data->buffers, i);
+            uint32_t j = i;
+            while ((j > 0) && (((struct cfs_buffer*)arraylist_get(object_data->buffers, j - 1))->lba > buffer->lba)) {
+                arraylist_set(object_data->buffers, j, arraylist_get(object_data->buffers, j - 1));
+                j--;
+            }
+            arraylist_set(object_data->buffers, j, buffer);
+        }
+        uint8_t* run = kmalloc(CFS_JOURNAL_MAX_TRANSACTION * CFS_BLOCK_SIZE);
+        uint32_t i = 0;
+        while (i < count) {
+            struct cfs_buffer* first = (struct cfs_buffer*)arraylist_get(object_data->buffers, i);
+            uint32_t n = 0;
+            while ((i + n < count) && (n < CFS_JOURNAL_MAX_TRANSACTION) &&
+                   (((struct cfs_buffer*)arraylist_get(object_data->buffers, i + n))->lba == first->lba + n)) {
+                struct cfs_buffer* buffer = (struct cfs_buffer*)arraylist_get(object_data->buffers, i + n);
+                memcpy(&(run[n * CFS_BLOCK_SIZE]), buffer->data, CFS_BLOCK_SIZE);
+                n++;
+            }
+            blockutil_update(object_data->partition_object, run, n * CFS_BLOCK_SIZE, first->lba, 0);
+            i += n;
+        }
+        kfree(run);
+        for (uint32_t j = 0; j < count; j++) {
+            kfree(arraylist_get(object_data->buffers, j));
+        }
+        arraylist_delete(object_data->buffers);
+        object_data->buffers = arraylist_new();
+    }
+    // only once everything is where it belongs is the journal emptied
+    cfs_write_journal_header(object_data->partition_object, object_data->superblock.journal_start,
+                             object_data->sequence);
+    object_data->journal_next = 1;
+}
+
+/*
+ * write the dirty sectors to the journal as one transaction, in one request
+ */
+void cfs_commit(struct cfs_objectdata* object_data) {
+    if (0 == object_data->dirty_count) {
+        return;
+    }
+    uint32_t n = object_data->dirty_count;
+    ASSERT(n <= CFS_JOURNAL_MAX_TRANSACTION);
+    ASSERT((object_data->journal_next + 1 + n) <= object_data->superblock.journal_sectors);
+
+    uint8_t* transaction = kmalloc((1 + n) * CFS_BLOCK_SIZE);
+    struct cfs_journal_descriptor* descriptor = (struct cfs_journal_descriptor*)transaction;
+    memzero(transaction, CFS_BLOCK_SIZE);
+    descriptor->magic = CFS_MAGIC_TRANSACTION;
+    descriptor->sequence = object_data->sequence;
+    descriptor->count = n;
+    uint32_t j = 0;
+    for (uint32_t i = 0; i < arraylist_count(object_data->buffers); i++) {
+        struct cfs_buffer* buffer = (struct cfs_buffer*)arraylist_get(object_data->buffers, i);
+        if (buffer->dirty) {
+            descriptor->lba[j] = buffer->lba;
+            memcpy(&(transaction[(1 + j) * CFS_BLOCK_SIZE]), buffer->data, CFS_BLOCK_SIZE);
+            buffer->dirty = false;
+            j++;
+        }
+    }
+    ASSERT(j == n);
+    uint64_t checksum = cfs_checksum(0xCBF29CE484222325, (uint8_t*)descriptor->lba, sizeof(descriptor->lba));
+    descriptor->checksum = cfs_checksum(checksum, &(transaction[CFS_BLOCK_SIZE]), n * CFS_BLOCK_SIZE);
+    blockutil_update(object_data->partition_object, transaction, (1 + n) * CFS_BLOCK_SIZE,
+                     object_data->superblock.journal_start + object_data->journal_next, 0);
+    kfree(transaction);
+    object_data->dirty_count = 0;
+    object_data->sequence += 1;
+    object_data->journal_next += 1 + n;
+    // a half full journal always has room for the next transaction
+    if (object_data->journal_next > (object_data->superblock.journal_sectors / 2)) {
+        cfs_checkpoint(object_data);
+    }
+}
+
+/*
+ * called at the end of each operation, so transactions hold whole operations
+ */
+void cfs_operation_end(struct cfs_objectdata* object_data) {
+    if (object_data->dirty_count >= CFS_JOURNAL_BATCH) {
+        cfs_commit(object_data);
     }
 }
 
+/*
+ * write the transactions in the journal to where they belong.  they are replayed in order, and replay stops at the
+ * first that isn't whole
+ */
+void cfs_replay(struct cfs_objectdata* object_data) {
+    struct object* obj = object_data->partition_object;
+    struct cfs_superblock* superblock = &(object_data->superblock);
+    struct cfs_journal_header header;
+    blockutil_read(obj, (uint8_t*)&header, sizeof(struct cfs_journal_header), superblock->journal_start, 0);
+    uint64_t sequence = header.sequence;
+    uint64_t position = 1;
+    uint8_t* transaction = kmalloc((1 + CFS_JOURNAL_MAX_TRANSACTION) * CFS_BLOCK_SIZE);
+    struct cfs_journal_descriptor* descriptor = (struct cfs_journal_descriptor*)transaction;
+    while ((position + 1) < superblock->journal_sectors) {
+        blockutil_read(obj, transaction, CFS_BLOCK_SIZE, superblock->journal_start + position, 0);
+        uint64_t n = descriptor->count;
+        if ((CFS_MAGIC_TRANSACTION != descriptor->magic) || (sequence != descriptor->sequence) || (0 == n) ||
+            (n > CFS_JOURNAL_MAX_TRANSACTION) || ((position + 1 + n) > superblock->journal_sectors)) {
+            break;
+        }
+        blockutil_read(obj, &(transaction[CFS_BLOCK_SIZE]), n * CFS_BLOCK_SIZE,
+                       superblock->journal_start + position + 1, 0);
+        uint64_t checksum = cfs_checksum(0xCBF29CE484222325, (uint8_t*)descriptor->lba, sizeof(descriptor->lba));
+        if (descriptor->checksum != cfs_checksum(checksum, &(transaction[CFS_BLOCK_SIZE]), n * CFS_BLOCK_SIZE)) {
+            break;
+        }
+        for (uint64_t i = 0; i < n; i++) {
+            blockutil_write(obj, &(transaction[(1 + i) * CFS_BLOCK_SIZE]), CFS_BLOCK_SIZE, descriptor->lba[i], 0);
+        }
+        sequence += 1;
+        position += 1 + n;
+    }
+    kfree(transaction);
+    if (sequence != header.sequence) {
+        kprintf("Replayed %llu CFS transactions on %s\n", sequence - header.sequence, obj->name);
+        cfs_write_journal_header(obj, superblock->journal_start, sequence);
+    }
+    object_data->sequence = sequence;
+    object_data->journal_next = 1;
+}
+
+/*
+ * take a free sector.  0 if the disk is full
+ */
+uint64_t cfs_allocate_sector(struct cfs_objectdata* object_data) {
+    uint64_t maps = object_data->superblock.blockmap_sectors;
+    uint64_t first = object_data->next_free / SECTORS_MAPPED_PER_SECTOR;
+    struct cfs_blockmap blockmap;
+    for (uint64_t m = 0; m < maps; m++) {
+        uint64_t map = (first + m) % maps;
+        cfs_meta_read(object_data, 1 + map, (uint8_t*)&blockmap);
+        for (uint32_t i = 0; i < SECTORMAP_BYTE_PER_SECTORS; i++) {
+            if (0xFF != blockmap.map[i]) {
+                uint8_t bit = 0;
+                while (0 != (blockmap.map[i] & (1 << bit))) {
+                    bit++;
+                }
+                blockmap.map[i] |= (1 << bit);
+                cfs_meta_write(object_data, 1 + map, (uint8_t*)&blockmap);
+                uint64_t ret = (map * SECTORS_MAPPED_PER_SECTOR) + (i * 8) + bit;
+                object_data->next_free = ret + 1;
+                return ret;
+            }
+        }
+    }
+    return 0;
+}
+
+void cfs_free_sector(struct cfs_objectdata* object_data, uint64_t sector) {
+    uint64_t map = sector / SECTORS_MAPPED_PER_SECTOR;
+    uint32_t bit = sector % SECTORS_MAPPED_PER_SECTOR;
+    struct cfs_blockmap blockmap;
+    cfs_meta_read(object_data, 1 + map, (uint8_t*)&blockmap);
+    ASSERT(0 != (blockmap.map[bit / 8] & (1 << (bit % 8))));
+    blockmap.map[bit / 8] &= ~(1 << (bit % 8));
+    cfs_meta_write(object_data, 1 + map, (uint8_t*)&blockmap);
+    if (sector < object_data->next_free) {
+        object_data->next_free = sector;
+    }
+}
+
+/*
+ * put a pointer in the first free slot of a kind's directories, adding a directory if they are full
+ */
+bool cfs_directory_add(struct cfs_objectdata* object_data, uint8_t kind, uint64_t pointer) {
+    struct cfs_directory directory;
+    uint64_t lba = object_data->superblock.primary_data_space + kind;
+    while (1) {
+        cfs_meta_read(object_data, lba, (uint8_t*)&directory);
+        for (uint32_t i = 0; i < CFS_DIRECTORY_POINTERS; i++) {
+            if (0 == directory.pointer[i]) {
+                directory.pointer[i] = pointer;
+                cfs_meta_write(object_data, lba, (uint8_t*)&directory);
+                return true;
+            }
+        }
+        if (0 == directory.next) {
+            break;
+        }
+        lba = directory.next;
+    }
+    uint64_t next = cfs_allocate_sector(object_data);
+    if (0 == next) {
+        return false;
+    }
+    directory.next = next;
+    cfs_meta_write(object_data, lba, (uint8_t*)&directory);
+    memzero((uint8_t*)&directory, sizeof(struct cfs_directory));
+    directory.magic = cfs_directory_magic(kind);
+    directory.previous = lba;
+    directory.pointer[0] = pointer;
+    cfs_meta_write(object_data, next, (uint8_t*)&directory);
+    return true;
+}
+
+bool cfs_directory_remove(struct cfs_objectdata* object_data, uint8_t kind, uint64_t pointer) {
+    struct cfs_directory directory;
+    uint64_t lba = object_data->superblock.primary_data_space + kind;
+    while (0 != lba) {
+        cfs_meta_read(object_data, lba, (uint8_t*)&directory);
+        for (uint32_t i = 0; i < CFS_DIRECTORY_POINTERS; i++) {
+            if (pointer == directory.pointer[i]) {
+                directory.pointer[i] = 0;
+                cfs_meta_write(object_data, lba, (uint8_t*)&directory);
+                return true;
+            }
+        }
+        lba = directory.next;
+    }
+    return false;
+}
+
+uint64_t cfs_create(struct object* obj, uint8_t kind) {
+    ASSERT_NOT_NULL(obj);
+    ASSERT_NOT_NULL(obj->object_data);
+    ASSERT(kind < CFS_KINDS);
+    struct cfs_objectdata* object_data = (struct cfs_objectdata*)obj->object_data;
+    uint64_t ret = cfs_allocate_sector(object_data);
+    if (0 == ret) {
+        return 0;
+    }
+    uint8_t sector[CFS_BLOCK_SIZE];
+    memzero(sector, CFS_BLOCK_SIZE);
+    const uint64_t magics[CFS_KINDS] = {CFS_MAGIC_DATA, CFS_MAGIC_PRESENTATION, CFS_MAGIC_GROUP};
+    ((struct cfs_data*)sector)->magic = magics[kind];
+    cfs_meta_write(object_data, ret, sector);
+    if (!cfs_directory_add(object_data, kind, ret)) {
+        cfs_free_sector(object_data, ret);
+        ret = 0;
+    }
+    cfs_operation_end(object_data);
+    return ret;
+}
+
+bool cfs_delete(struct object* obj, uint8_t kind, uint64_t lba) {
+    ASSERT_NOT_NULL(obj);
+    ASSERT_NOT_NULL(obj->object_data);
+    ASSERT(kind < CFS_KINDS);
+    struct cfs_objectdata* object_data = (struct cfs_objectdata*)obj->object_data;
+    if (!cfs_directory_remove(object_data, kind, lba)) {
+        return false;
+    }
+    cfs_free_sector(object_data, lba);
+    cfs_operation_end(object_data);
+    return true;
+}
+
+uint32_t cfs_count(struct object* obj, uint8_t kind) {
+    ASSERT_NOT_NULL(obj);
+    ASSERT_NOT_NULL(obj->object_data);
+    ASSERT(kind < CFS_KINDS);
+    struct cfs_objectdata* object_data = (struct cfs_objectdata*)obj->object_data;
+    struct cfs_directory directory;
+    uint32_t ret = 0;
+    uint64_t lba = object_data->superblock.primary_data_space + kind;
+    while (0 != lba) {
+        cfs_meta_read(object_data, lba, (uint8_t*)&directory);
+        for (uint32_t i = 0; i < CFS_DIRECTORY_POINTERS; i++) {
+            if (0 != directory.pointer[i]) {
+                ret++;
+            }
+        }
+        lba = directory.next;
+    }
+    return ret;
+}
+
+void cfs_sync(struct object* obj) {
+    ASSERT_NOT_NULL(obj);
+    ASSERT_NOT_NULL(obj->object_data);
+    cfs_commit((struct cfs_objectdata*)obj->object_data);
+}
+
 /*
  * perform device instance specific init here
  */
@@ -161,6 +598,13 @@ uint8_t cfs_init(struct object* obj) {
     ASSERT_NOT_NULL(obj);
     ASSERT_NOT_NULL(obj->object_data);
     struct cfs_objectdata* object_data = (struct cfs_objectdata*)obj->object_data;
+    cfs_read_superblock(object_data->partition_object, &(object_data->superblock));
+    if ((CFS_MAGIC_SUPERBLOCK != object_data->superblock.magic) || (0 == object_data->superblock.journal_sectors)) {
+        // not CFS
+        return 0;
+    }
+    cfs_replay(object_data);
+    object_data->buffers = arraylist_new();
     kprintf("Init %s on %s (%s)\n", obj->description, object_data->partition_object->name, obj->name);
     return 1;
 }
@@ -174,12 +618,20 @@ uint8_t cfs_uninit(struct object* obj) {
     struct cfs_objectdata* object_data = (struct cfs_objectdata*)obj->object_data;
 
     kprintf("Uninit %s on %s (%s)\n", obj->description, object_data->partition_object->name, obj->name);
+    cfs_commit(object_data);
+    cfs_checkpoint(object_data);
+    arraylist_delete(object_data->buffers);
     kfree(obj->api);
     kfree(obj->object_data);
     return 1;
 }
 
 struct object* cfs_attach(struct object* partition_object) {
+    ASSERT(sizeof(struct cfs_superblock) == CFS_BLOCK_SIZE);
+    ASSERT(sizeof(struct cfs_directory) == CFS_BLOCK_SIZE);
+    ASSERT(sizeof(struct cfs_blockmap) == CFS_BLOCK_SIZE);
+    ASSERT(sizeof(struct cfs_journal_header) == CFS_BLOCK_SIZE);
+    ASSERT(sizeof(struct cfs_journal_descriptor) == CFS_BLOCK_SIZE);
     ASSERT_NOT_NULL(partition_object);
     ASSERT(1 == blockutil_is_block_object(partition_object));
 
@@ -198,12 +650,13 @@ struct object* cfs_attach(struct object* partition_object) {
     struct objectinterface_filesystem* api =
         (struct objectinterface_filesystem*)kmalloc(sizeof(struct objectinterface_filesystem));
     memzero((uint8_t*)api, sizeof(struct objectinterface_filesystem));
-    //  api->format = &cfs_format;
+    api->sync = &cfs_sync;
     objectinstance->api = api;
     /*
      * device data
      */
     struct cfs_objectdata* object_data = (struct cfs_objectdata*)kmalloc(sizeof(struct cfs_objectdata));
+    memzero((uint8_t*)object_data, sizeof(struct cfs_objectdata));
     object_data->partition_object = partition_object;
     objectinstance->object_data = object_data;
     /*
@@ -238,4 +691,4 @@ void cfs_detach(struct object* obj) {
     * detach
     */
     objectmgr_detach_object(obj);
-}
\ No newline at end of file
+}
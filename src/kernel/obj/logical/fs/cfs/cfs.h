@@ -8,9 +8,31 @@
 #ifndef _CFS_H
 #define _CFS_H
 
+#include <types.h>
+
 struct object;
 
+/*
+ * the kinds of thing a CFS volume keeps a directory of
+ */
+#define CFS_KIND_DATA 0
+#define CFS_KIND_PRESENTATION 1
+#define CFS_KIND_GROUP 2
+#define CFS_KINDS 3
+
+void cfs_format(struct object* partition_object);
 struct object* cfs_attach(struct object* partition_object);
 void cfs_detach(struct object* obj);
 
-#endif
\ No newline at end of file
+/*
+ * the lba of a new data space, presentation or group, or 0 if the volume is full
+ */
+uint64_t cfs_create(struct object* obj, uint8_t kind);
+bool cfs_delete(struct object* obj, uint8_t kind, uint64_t lba);
+uint32_t cfs_count(struct object* obj, uint8_t kind);
+/*
+ * commit changed metadata to the journal
+ */
+void cfs_sync(struct object* obj);
+
+#endif
@@ -10,6 +10,8 @@
 #include <obj/logical/fs/fat/fat_support.h>
 #include <obj/logical/fs/filesystem_node_map.h>
 #include <obj/logical/fs/node_util.h>
+#include <sys/collection/arraylist/arraylist.h>
+#include <sys/collection/tree/tree.h>
 #include <sys/debug/assert.h>
 #include <sys/debug/debug.h>
 #include <sys/kmalloc/kmalloc.h>
@@ -24,18 +26,94 @@
 #include <types.h>
 
 /*
-* the filesystem_node field "node_data" field for FAT folder objects contains the starting cluster
+* the filesystem_node field "node_data" is a struct fat_node
 */
 
 // https://wiki.osdev.org/FAT
 
+/*
+* writes past the end of a file's clusters are held in memory, and clusters for them are only allocated at sync,
+* all at once, so a file written a piece at a time still ends up in one run.  a file holding back more than this
+* has its clusters allocated early
+*/
+#define FAT_DELAYED_MAX (256 * 1024)
+
+// a node whose cluster count hasn't been worked out yet
+#define FAT_CLUSTERS_UNKNOWN 0xFFFFFFFF
+
 struct fat_objectdata {
     struct object* block_object;
     struct fat_fs_parameters fs_parameters;
     struct filesystem_node* root_node;
     struct filesystem_node_map* filesystem_nodes;
+    /*
+    * the first FAT, read in whole at init.  following a chain never goes to the disk, and changes to it are only
+    * written, to every FAT, at sync
+    */
+    uint8_t* table;
+    uint32_t table_size;
+    uint32_t table_dirty_start;  // the bytes of the table changed since the last sync
+    uint32_t table_dirty_end;    // 0 if none
+    uint32_t free_clusters;
+    uint32_t reserved_clusters;  // promised to data held back, so sync can't run out
+    uint32_t next_free;          // where to start looking for free clusters
+    /*
+    * nodes with data held back, or a directory entry to update
+    */
+    struct arraylist* pending;
+};
+
+struct fat_node {
+    uint32_t first_cluster;  // 0 for an empty file, and for the FAT12 and FAT16 root folder
+    uint32_t clusters;       // in the chain
+    uint32_t entry_sector;   // where the node's directory entry is.  0 for the root folder
+    uint16_t entry_offset;
+    bool pending;     // on the pending list
+    bool entry_dirty;  // the directory entry is out of date
+    /*
+    * where the last transfer got to in the chain, so reading or writing straight on doesn't walk it from the
+    * start.  0 for the cluster when there isn't one
+    */
+    uint32_t cursor_index;
+    uint32_t cursor_cluster;
+    /*
+    * data written past the end of the clusters
+    */
+    uint8_t* delayed;
+    uint32_t delayed_size;
+    uint32_t delayed_capacity;
 };
 
+/*
+* called for each directory entry in a folder, the end marker included, with where on the disk the entry is.
+* return false to stop
+*/
+typedef bool (*fat_directory_function)(struct filesystem_node* parent, struct fat_dir_entry* entry, uint32_t sector,
+                                       uint16_t offset, void* context);
+
+void fat_filesystem_sync(struct object* filesystem_obj);
+
+struct fat_node* fat_node_new(uint32_t first_cluster, uint32_t entry_sector, uint16_t entry_offset) {
+    struct fat_node* ret = (struct fat_node*)kmalloc(sizeof(struct fat_node));
+    memzero((uint8_t*)ret, sizeof(struct fat_node));
+    ret->first_cluster = first_cluster;
+    ret->clusters = FAT_CLUSTERS_UNKNOWN;
+    ret->entry_sector = entry_sector;
+    ret->entry_offset = entry_offset;
+    return ret;
+}
+
+void fat_node_delete_iterator(void* value) {
+    if (0 != value) {
+        struct filesystem_node* fs_node = (struct filesystem_node*)value;
+        struct fat_node* node = (struct fat_node*)fs_node->node_data;
+        if (0 != node->delayed) {
+            kfree(node->delayed);
+        }
+        kfree(node);
+    }
+}
+
 /*
  * perform device instance specific init here
  */
@@ -43,10 +121,32 @@ uint8_t fat_init(struct object* obj) {
     ASSERT_NOT_NULL(obj);
     ASSERT_NOT_NULL(obj->object_data);
     struct fat_objectdata* object_data = (struct fat_objectdata*)obj->object_data;
-    fat_read_fs_parameters(object_data->block_object, &(object_data->fs_parameters));
-    uint64_t first_dir_sector = (uint64_t)object_data->fs_parameters.first_root_dir_sector;
-    object_data->root_node = filesystem_node_new(folder, obj, obj->name, 0, (void*)first_dir_sector, 0);
-    fat_dump_fat_fs_parameters(&(object_data->fs_parameters));
+    struct fat_fs_parameters* fs_parameters = &(object_data->fs_parameters);
+    fat_read_fs_parameters(object_data->block_object, fs_parameters);
+    if (ExFAT == fs_parameters->type) {
+        PANIC("Unsupported FAT type");
+    }
+    object_data->table_size = fs_parameters->fat_size * fs_parameters->sector_size;
+    object_data->table = kmalloc(object_data->table_size);
+    blockutil_read(object_data->block_object, object_data->table, object_data->table_size,
+                   fs_parameters->first_fat_sector, 0);
+    object_data->table_dirty_start = object_data->table_size;
+    object_data->table_dirty_end = 0;
+    object_data->free_clusters = 0;
+    for (uint32_t i = 2; i < fs_parameters->total_clusters + 2; i++) {
+        if (0 == fat_next_cluster(object_data->table, i, fs_parameters)) {
+            object_data->free_clusters += 1;
+        }
+    }
+    object_data->next_free = 2;
+
+    // the FAT32 root folder is a cluster chain like any other; the FAT12 and FAT16 one has sectors of its own
+    uint32_t root_cluster = 0;
+    if (FAT32 == fs_parameters->type) {
+        root_cluster = fs_parameters->root_cluster_32;
+    }
+    object_data->root_node = filesystem_node_new(folder, obj, obj->name, 0, fat_node_new(root_cluster, 0, 0), 0);
+    fat_dump_fat_fs_parameters(fs_parameters);
     kprintf("Init %s on %s (%s)\n", obj->description, object_data->block_object->name, obj->name);
     return 1;
 }
@@ -59,9 +159,14 @@ uint8_t fat_uninit(struct object* obj) {
     ASSERT_NOT_NULL(obj->object_data);
     struct fat_objectdata* object_data = (struct fat_objectdata*)obj->object_data;
     kprintf("Uninit %s on %s (%s)\n", obj->description, object_data->block_object->name, obj->name);
+    fat_filesystem_sync(obj);
+    tree_iterate(object_data->filesystem_nodes->filesystem_nodes_by_id, &fat_node_delete_iterator);
     filesystem_node_map_clear(object_data->filesystem_nodes);
     filesystem_node_map_delete(object_data->filesystem_nodes);
-    kfree(object_data->root_node);
+    fat_node_delete_iterator(object_data->root_node);
+    filesystem_node_delete(object_data->root_node);
+    arraylist_delete(object_data->pending);
+    kfree(object_data->table);
     kfree(obj->api);
     kfree(obj->object_data);
     return 1;
@@ -74,26 +179,549 @@ struct filesystem_node* fat_filesystem_get_root_node(struct object* filesystem_o
     return object_data->root_node;
 }
 
-uint32_t fat_filesystem_read(struct filesystem_node* fs_node, uint8_t* data, uint32_t data_size) {
+bool fat_fixed_root(struct fat_objectdata* object_data, struct filesystem_node* fs_node) {
+    return (fs_node == object_data->root_node) && (FAT32 != object_data->fs_parameters.type);
+}
+
+uint32_t fat_cluster_size(struct fat_objectdata* object_data) {
+    return object_data->fs_parameters.sectors_per_cluster * object_data->fs_parameters.sector_size;
+}
+
+uint32_t fat_clusters_for(struct fat_objectdata* object_data, uint64_t size) {
+    uint32_t cluster_size = fat_cluster_size(object_data);
+    return (size + cluster_size - 1) / cluster_size;
+}
+
+void fat_node_set_cursor(struct fat_node* node, uint64_t index, uint32_t cluster) {
+    node->cursor_index = index;
+    node->cursor_cluster = cluster;
+}
+
+/*
+ * the cluster 'index' clusters along a node's chain, or an end of chain value if the chain is shorter.  the walk
+ * starts from the node's cursor when that is no further along, and leaves the cursor where it stopped
+ */
+uint32_t fat_node_cluster(struct fat_objectdata* object_data, struct filesystem_node* fs_node, uint64_t index) {
+    struct fat_node* node = (struct fat_node*)fs_node->node_data;
+    uint32_t cluster = node->first_cluster;
+    uint64_t i = 0;
+    if ((0 != node->cursor_cluster) && (node->cursor_index <= index)) {
+        cluster = node->cursor_cluster;
+        i = node->cursor_index;
+    }
+    for (; i < index; i++) {
+        if (fat_end_of_chain(cluster, &(object_data->fs_parameters))) {
+            return cluster;
+        }
+        cluster = fat_next_cluster(object_data->table, cluster, &(object_data->fs_parameters));
+    }
+    if (!fat_end_of_chain(cluster, &(object_data->fs_parameters))) {
+        fat_node_set_cursor(node, index, cluster);
+    }
+    return cluster;
+}
+
+/*
+ * the bytes of a node's clusters
+ */
+uint64_t fat_node_allocated(struct fat_objectdata* object_data, struct filesystem_node* fs_node) {
+    struct fat_node* node = (struct fat_node*)fs_node->node_data;
+    if (FAT_CLUSTERS_UNKNOWN == node->clusters) {
+        node->clusters = 0;
+        uint32_t cluster = node->first_cluster;
+        while (!fat_end_of_chain(cluster, &(object_data->fs_parameters))) {
+            node->clusters += 1;
+            cluster = fat_next_cluster(object_data->table, cluster, &(object_data->fs_parameters));
+        }
+    }
+    return (uint64_t)node->clusters * fat_cluster_size(object_data);
+}
+
+/*
+ * change the in-memory FAT, and remember what has to be written back
+ */
+void fat_table_set(struct fat_objectdata* object_data, uint32_t cluster, uint32_t value) {
+    uint32_t offset = fat_set_next_cluster(object_data->table, cluster, value, &(object_data->fs_parameters));
+    if (offset < object_data->table_dirty_start) {
+        object_data->table_dirty_start = offset;
+    }
+    // an entry is at most 4 bytes
+    uint32_t end = offset + 4;
+    if (end > object_data->table_size) {
+        end = object_data->table_size;
+    }
+    if (end > object_data->table_dirty_end) {
+        object_data->table_dirty_end = end;
+    }
+}
+
+bool fat_cluster_free(struct fat_objectdata* object_data, uint32_t cluster) {
+    return 0 == fat_next_cluster(object_data->table, cluster, &(object_data->fs_parameters));
+}
+
+bool fat_free_run(struct fat_objectdata* object_data, uint32_t start, uint32_t count) {
+    if ((start < 2) || ((start + count) > (object_data->fs_parameters.total_clusters + 2))) {
+        return false;
+    }
+    for (uint32_t i = start; i < start + count; i++) {
+        if (!fat_cluster_free(object_data, i)) {
+            return false;
+        }
+    }
+    return true;
+}
+
+/*
+ * the first run of 'count' free clusters, starting the search at next_free.  0 if there isn't one
+ */
+uint32_t fat_find_free_run(struct fat_objectdata* object_data, uint32_t count) {
+    uint32_t end = object_data->fs_parameters.total_clusters + 2;
+    for (uint32_t pass = 0; pass < 2; pass++) {
+        uint32_t start = (0 == pass) ? object_data->next_free : 2;
+        uint32_t run = 0;
+        for (uint32_t i = start; i < end; i++) {
+            if (fat_cluster_free(object_data, i)) {
+                run += 1;
+                if (run == count) {
+                    return i + 1 - count;
+                }
+            } else {
+                run = 0;
+            }
+        }
+    }
+    return 0;
+}
+
+/*
+ * take 'count' free clusters and chain them on after 'last', or into a new chain if 'last' is 0.  returns the first
+ * of them.  the clusters straight after 'last' are preferred, then the first run that is long enough, and only
+ * then whatever is free.  the caller has checked there are enough
+ */
+uint32_t fat_allocate_clusters(struct fat_objectdata* object_data, uint32_t last, uint32_t count) {
+    ASSERT(count > 0);
+    ASSERT(count <= object_data->free_clusters);
+    uint32_t end = object_data->fs_parameters.total_clusters + 2;
+    uint32_t eoc = fat_end_of_chain_marker(&(object_data->fs_parameters));
+
+    uint32_t cluster = 0;
+    if ((0 != last) && (fat_free_run(object_data, last + 1, count))) {
+        cluster = last + 1;
+    } else {
+        cluster = fat_find_free_run(object_data, count);
+    }
+    if (0 == cluster) {
+        cluster = object_data->next_free;
+    }
+
+    uint32_t first = 0;
+    uint32_t previous = last;
+    for (uint32_t allocated = 0; allocated < count; cluster++) {
+        if (cluster >= end) {
+            cluster = 2;
+        }
+        if (fat_cluster_free(object_data, cluster)) {
+            fat_table_set(object_data, cluster, eoc);
+            if (0 != previous) {
+                fat_table_set(object_data, previous, cluster);
+            }
+            if (0 == first) {
+                first = cluster;
+            }
+            previous = cluster;
+            allocated += 1;
+        }
+    }
+    object_data->free_clusters -= count;
+    object_data->next_free = (previous + 1 < end) ? previous + 1 : 2;
+    return first;
+}
+
+void fat_free_chain(struct fat_objectdata* object_data, uint32_t cluster) {
+    while (!fat_end_of_chain(cluster, &(object_data->fs_parameters))) {
+        uint32_t next = fat_next_cluster(object_data->table, cluster, &(object_data->fs_parameters));
+        fat_table_set(object_data, cluster, 0);
+        object_data->free_clusters += 1;
+        cluster = next;
+    }
+}
+
+/*
+ * grow a node's chain by 'count' clusters
+ */
+uint32_t fat_extend_node(struct fat_objectdata* object_data, struct filesystem_node* fs_node, uint32_t count) {
+    struct fat_node* node = (struct fat_node*)fs_node->node_data;
+    fat_node_allocated(object_data, fs_node);
+    uint32_t last = 0;
+    if (node->clusters > 0) {
+        last = fat_node_cluster(object_data, fs_node, node->clusters - 1);
+        ASSERT(!fat_end_of_chain(last, &(object_data->fs_parameters)));
+    }
+    uint32_t first_new = fat_allocate_clusters(object_data, last, count);
+    if (0 == node->first_cluster) {
+        node->first_cluster = first_new;
+    }
+    node->clusters += count;
+    return first_new;
+}
+
+/*
+ * move bytes to or from a node's clusters, starting 'offset' bytes in.  clusters that follow each other on the
+ * disk are done together, so a file that isn't fragmented takes as few requests as the device allows
+ */
+uint32_t fat_transfer_clusters(struct fat_objectdata* object_data, struct filesystem_node* fs_node, uint64_t offset,
+                               uint8_t* data, uint32_t data_size, bool write) {
+    struct fat_fs_parameters* fs_parameters = &(object_data->fs_parameters);
+    struct fat_node* node = (struct fat_node*)fs_node->node_data;
+    uint32_t cluster_size = fat_cluster_size(object_data);
+
+    // find the cluster 'offset' is in
+    uint64_t index = offset / cluster_size;
+    uint32_t cluster = fat_node_cluster(object_data, fs_node, index);
+    uint32_t cluster_offset = offset % cluster_size;
+
+    uint32_t done = 0;
+    while ((done < data_size) && (!fat_end_of_chain(cluster, fs_parameters))) {
+        // a run of consecutive clusters, no longer than what's left
+        uint32_t first = cluster;
+        uint64_t run = cluster_size - cluster_offset;
+        uint32_t next = fat_next_cluster(object_data->table, cluster, fs_parameters);
+        while ((next == cluster + 1) && (run < (data_size - done))) {
+            cluster = next;
+            run += cluster_size;
+            next = fat_next_cluster(object_data->table, cluster, fs_parameters);
+        }
+        if (run > (data_size - done)) {
+            run = data_size - done;
+        }
+        uint64_t sector =
+            fat_first_sector_of_cluster(first, fs_parameters) + (cluster_offset / fs_parameters->sector_size);
+        if (write) {
+            blockutil_update(object_data->block_object, &(data[done]), run, sector,
+                             cluster_offset % fs_parameters->sector_size);
+        } else {
+            blockutil_read(object_data->block_object, &(data[done]), run, sector,
+                           cluster_offset % fs_parameters->sector_size);
+        }
+        done += run;
+        cluster_offset = 0;
+        index += cluster - first;
+        fat_node_set_cursor(node, index, cluster);
+        index += 1;
+        cluster = next;
+    }
+    return done;
+}
+
+void fat_queue_node(struct fat_objectdata* object_data, struct filesystem_node* fs_node) {
+    struct fat_node* node = (struct fat_node*)fs_node->node_data;
+    if (!node->pending) {
+        node->pending = true;
+        arraylist_add(object_data->pending, fs_node);
+    }
+}
+
+/*
+ * give a node's held back data its clusters, as one run if there is one, and write it
+ */
+void fat_flush_node(struct fat_objectdata* object_data, struct filesystem_node* fs_node) {
+    struct fat_node* node = (struct fat_node*)fs_node->node_data;
+    if (0 == node->delayed_size) {
+        return;
+    }
+    uint64_t allocated = fat_node_allocated(object_data, fs_node);
+    uint32_t count = fat_clusters_for(object_data, node->delayed_size);
+    ASSERT(count <= object_data->reserved_clusters);
+    object_data->reserved_clusters -= count;
+    fat_extend_node(object_data, fs_node, count);
+    fat_transfer_clusters(object_data, fs_node, allocated, node->delayed, node->delayed_size, true);
+    kfree(node->delayed);
+    node->delayed = 0;
+    node->delayed_size = 0;
+    node->delayed_capacity = 0;
+    node->entry_dirty = true;
+}
+
+/*
+ * set how much data a node holds back, keeping enough clusters reserved for it.  false if the volume is too full
+ */
+bool fat_resize_delayed(struct fat_objectdata* object_data, struct filesystem_node* fs_node, uint32_t size) {
+    struct fat_node* node = (struct fat_node*)fs_node->node_data;
+    uint32_t had = fat_clusters_for(object_data, node->delayed_size);
+    uint32_t needs = fat_clusters_for(object_data, size);
+    if (needs > had) {
+        if ((needs - had) > (object_data->free_clusters - object_data->reserved_clusters)) {
+            return false;
+        }
+    }
+    object_data->reserved_clusters = object_data->reserved_clusters + needs - had;
+    if (size > node->delayed_capacity) {
+        uint32_t capacity = (0 == node->delayed_capacity) ? fat_cluster_size(object_data) : node->delayed_capacity;
+        while (capacity < size) {
+            capacity = capacity * 2;
+        }
+        uint8_t* delayed = kmalloc(capacity);
+        if (node->delayed_size > 0) {
+            memcpy(delayed, node->delayed, node->delayed_size);
+        }
+        if (0 != node->delayed) {
+            kfree(node->delayed);
+        }
+        node->delayed = delayed;
+        node->delayed_capacity = capacity;
+    }
+    if (size > node->delayed_size) {
+        memzero(&(node->delayed[node->delayed_size]), size - node->delayed_size);
+    }
+    node->delayed_size = size;
+    return true;
+}
+
+/*
+ * write without regard to the node's size.  'offset' is no further than the end of the data held back.  returns
+ * the bytes written, which is short if the volume is full
+ */
+uint32_t fat_write_data(struct fat_objectdata* object_data, struct filesystem_node* fs_node, uint64_t offset,
+                        const uint8_t* data, uint32_t data_size) {
+    struct fat_node* node = (struct fat_node*)fs_node->node_data;
+    uint32_t done = 0;
+    while (done < data_size) {
+        uint64_t allocated = fat_node_allocated(object_data, fs_node);
+        uint64_t position = offset + done;
+        uint32_t remaining = data_size - done;
+        if (position < allocated) {
+            // over clusters the node already has
+            uint32_t count = remaining;
+            if (count > allocated - position) {
+                count = allocated - position;
+            }
+            done += fat_transfer_clusters(object_data, fs_node, position, (uint8_t*)&(data[done]), count, true);
+            continue;
+        }
+        uint32_t delayed_offset = position - allocated;
+        ASSERT(delayed_offset <= node->delayed_size);
+        if ((delayed_offset + remaining) <= FAT_DELAYED_MAX) {
+            // held back until sync
+            if ((delayed_offset + remaining) > node->delayed_size) {
+                if (!fat_resize_delayed(object_data, fs_node, delayed_offset + remaining)) {
+                    return done;
+                }
+            }
+            memcpy(&(node->delayed[delayed_offset]), &(data[done]), remaining);
+            fat_queue_node(object_data, fs_node);
+            done += remaining;
+        } else if (node->delayed_size > 0) {
+            // too much to hold; what is held gets its clusters now
+            fat_flush_node(object_data, fs_node);
+        } else {
+            // a big write gets all the clusters it needs in one go
+            uint32_t count = fat_clusters_for(object_data, remaining);
+            if (count > (object_data->free_clusters - object_data->reserved_clusters)) {
+                count = object_data->free_clusters - object_data->reserved_clusters;
+                if (0 == count) {
+                    return done;
+                }
+            }
+            fat_extend_node(object_data, fs_node, count);
+            node->entry_dirty = true;
+            fat_queue_node(object_data, fs_node);
+        }
+    }
+    return done;
+}
+
+/*
+ * zero a node from 'from' to 'to'
+ */
+bool fat_zero_data(struct fat_objectdata* object_data, struct filesystem_node* fs_node, uint64_t from, uint64_t to) {
+    uint8_t zeros[512];
+    memzero(zeros, sizeof(zeros));
+    while (from < to) {
+        uint32_t count = sizeof(zeros);
+        if (count > to - from) {
+            count = to - from;
+        }
+        uint32_t written = fat_write_data(object_data, fs_node, from, zeros, count);
+        from += written;
+        if (written < count) {
+            return false;
+        }
+    }
+    return true;
+}
+
+uint32_t fat_filesystem_read(struct filesystem_node* fs_node, uint64_t offset, uint8_t* data, uint32_t data_size) {
+    ASSERT_NOT_NULL(fs_node);
+    ASSERT_NOT_NULL(fs_node->filesystem_obj);
+    ASSERT_NOT_NULL(fs_node->filesystem_obj->object_data);
+    ASSERT_NOT_NULL(data);
+    if (offset >= fs_node->size) {
+        return 0;
+    }
+    if (data_size > fs_node->size - offset) {
+        data_size = fs_node->size - offset;
+    }
+    struct fat_objectdata* object_data = (struct fat_objectdata*)fs_node->filesystem_obj->object_data;
+    struct fat_node* node = (struct fat_node*)fs_node->node_data;
+    uint64_t allocated = fat_node_allocated(object_data, fs_node);
+    uint32_t done = 0;
+    if (offset < allocated) {
+        uint32_t count = data_size;
+        if (count > allocated - offset) {
+            count = allocated - offset;
+        }
+        done = fat_transfer_clusters(object_data, fs_node, offset, data, count, false);
+    }
+    // the rest is held back in memory
+    if (done < data_size) {
+        uint32_t delayed_offset = offset + done - allocated;
+        ASSERT((delayed_offset + (data_size - done)) <= node->delayed_size);
+        memcpy(&(data[done]), &(node->delayed[delayed_offset]), data_size - done);
+        done = data_size;
+    }
+    return done;
+}
+
+/*
+ * writes past the end of the file extend it, and a gap before 'offset' is filled with zeros.  FAT sizes are 32
+ * bits, so nothing is written past 4GB
+ */
+uint32_t fat_filesystem_write(struct filesystem_node* fs_node, uint64_t offset, const uint8_t* data,
+                              uint32_t data_size) {
     ASSERT_NOT_NULL(fs_node);
     ASSERT_NOT_NULL(fs_node->filesystem_obj);
     ASSERT_NOT_NULL(fs_node->filesystem_obj->object_data);
-    ASSERT(data_size >= fs_node->size);
-    uint64_t start_sector = (uint64_t)fs_node->node_data;
+    ASSERT_NOT_NULL(data);
+    if ((file != fs_node->type) || (offset >= 0xFFFFFFFF)) {
+        return 0;
+    }
+    if (data_size > 0xFFFFFFFF - offset) {
+        data_size = 0xFFFFFFFF - offset;
+    }
     struct fat_objectdata* object_data = (struct fat_objectdata*)fs_node->filesystem_obj->object_data;
+    struct fat_node* node = (struct fat_node*)fs_node->node_data;
+    if (offset > fs_node->size) {
+        if (!fat_zero_data(object_data, fs_node, fs_node->size, offset)) {
+            return 0;
+        }
+        fs_node->size = offset;
+    }
+    uint32_t written = fat_write_data(object_data, fs_node, offset, data, data_size);
+    if ((offset + written) > fs_node->size) {
+        fs_node->size = offset + written;
+        node->entry_dirty = true;
+        fat_queue_node(object_data, fs_node);
+    }
+    return written;
+}
 
-    return blockutil_read(object_data->block_object, data, data_size, start_sector, 0);
+bool fat_filesystem_truncate(struct filesystem_node* fs_node, uint64_t size) {
+    ASSERT_NOT_NULL(fs_node);
+    ASSERT_NOT_NULL(fs_node->filesystem_obj);
+    ASSERT_NOT_NULL(fs_node->filesystem_obj->object_data);
+    if ((file != fs_node->type) || (size > 0xFFFFFFFF)) {
+        return false;
+    }
+    struct fat_objectdata* object_data = (struct fat_objectdata*)fs_node->filesystem_obj->object_data;
+    struct fat_node* node = (struct fat_node*)fs_node->node_data;
+    if (size > fs_node->size) {
+        bool ret = fat_zero_data(object_data, fs_node, fs_node->size, size);
+        if (ret) {
+            fs_node->size = size;
+            node->entry_dirty = true;
+            fat_queue_node(object_data, fs_node);
+        }
+        return ret;
+    }
+    uint64_t allocated = fat_node_allocated(object_data, fs_node);
+    if (size >= allocated) {
+        fat_resize_delayed(object_data, fs_node, size - allocated);
+    } else {
+        fat_resize_delayed(object_data, fs_node, 0);
+        fat_node_set_cursor(node, 0, 0);
+        uint32_t keep = fat_clusters_for(object_data, size);
+        if (0 == keep) {
+            fat_free_chain(object_data, node->first_cluster);
+            node->first_cluster = 0;
+        } else {
+            uint32_t last = fat_node_cluster(object_data, fs_node, keep - 1);
+            uint32_t next = fat_next_cluster(object_data->table, last, &(object_data->fs_parameters));
+            fat_table_set(object_data, last, fat_end_of_chain_marker(&(object_data->fs_parameters)));
+            fat_free_chain(object_data, next);
+        }
+        node->clusters = keep;
+    }
+    fs_node->size = size;
+    node->entry_dirty = true;
+    fat_queue_node(object_data, fs_node);
+    return true;
 }
 
-uint32_t fat_filesystem_write(struct filesystem_node* fs_node, const uint8_t* data, uint32_t data_size) {
-    PANIC("Not Implemented");
-    return 0;
+/*
+ * write what has been held back: file data first, getting its clusters, then the FAT, then the directory entries.
+ * the FAT goes out as one write for each copy of it, and each directory sector once, however many entries in it
+ * changed
+ */
+void fat_filesystem_sync(struct object* filesystem_obj) {
+    ASSERT_NOT_NULL(filesystem_obj);
+    ASSERT_NOT_NULL(filesystem_obj->object_data);
+    struct fat_objectdata* object_data = (struct fat_objectdata*)filesystem_obj->object_data;
+    struct fat_fs_parameters* fs_parameters = &(object_data->fs_parameters);
+    uint32_t count = arraylist_count(object_data->pending);
+
+    for (uint32_t i = 0; i < count; i++) {
+        fat_flush_node(object_data, (struct filesystem_node*)arraylist_get(object_data->pending, i));
+    }
+
+    if (object_data->table_dirty_end > object_data->table_dirty_start) {
+        uint32_t first = object_data->table_dirty_start / fs_parameters->sector_size;
+        uint32_t last = (object_data->table_dirty_end - 1) / fs_parameters->sector_size;
+        uint32_t size = (last - first + 1) * fs_parameters->sector_size;
+        for (uint32_t i = 0; i < fs_parameters->table_count; i++) {
+            blockutil_update(object_data->block_object, &(object_data->table[first * fs_parameters->sector_size]),
+                             size, fs_parameters->first_fat_sector + (i * fs_parameters->fat_size) + first, 0);
+        }
+        object_data->table_dirty_start = object_data->table_size;
+        object_data->table_dirty_end = 0;
+    }
+
+    uint8_t buffer[fs_parameters->sector_size];
+    for (uint32_t i = 0; i < count; i++) {
+        struct filesystem_node* fs_node = (struct filesystem_node*)arraylist_get(object_data->pending, i);
+        struct fat_node* node = (struct fat_node*)fs_node->node_data;
+        if (node->entry_dirty) {
+            uint32_t sector = node->entry_sector;
+            blockutil_read(object_data->block_object, buffer, fs_parameters->sector_size, sector, 0);
+            // every entry in this sector
+            for (uint32_t j = i; j < count; j++) {
+                struct filesystem_node* other = (struct filesystem_node*)arraylist_get(object_data->pending, j);
+                struct fat_node* other_node = (struct fat_node*)other->node_data;
+                if ((other_node->entry_dirty) && (other_node->entry_sector == sector)) {
+                    struct fat_dir_entry* entry = (struct fat_dir_entry*)&(buffer[other_node->entry_offset]);
+                    entry->size = other->size;
+                    entry->cluster_low = other_node->first_cluster & 0xFFFF;
+                    if (FAT32 == fs_parameters->type) {
+                        entry->cluster_high = other_node->first_cluster >> 16;
+                    }
+                    other_node->entry_dirty = false;
+                }
+            }
+            blockutil_update(object_data->block_object, buffer, fs_parameters->sector_size, sector, 0);
+        }
+        node->pending = false;
+    }
+    arraylist_delete(object_data->pending);
+    object_data->pending = arraylist_new();
 }
 
 void fat_filesystem_open(struct filesystem_node* fs_node) {
-    PANIC("Not Implemented");
+    ASSERT_NOT_NULL(fs_node);
+}
+
+void fat_filesystem_close(struct filesystem_node* fs_node) {
+    ASSERT_NOT_NULL(fs_node);
+    fat_filesystem_sync(fs_node->filesystem_obj);
 }
-void fat_filesystem_close(struct filesystem_node* fs_node) {}
 
 struct filesystem_node* fat_filesystem_find_node_by_id(struct filesystem_node* fs_node, uint64_t id) {
     ASSERT_NOT_NULL(fs_node);
@@ -105,104 +733,202 @@ struct filesystem_node* fat_filesystem_find_node_by_id(struct filesystem_node* f
     return filesystem_node_map_find_id(object_data->filesystem_nodes, id);
 }
 
+/*
+ * call f for each entry in a folder, a sector or a cluster at a time, until the end of the folder or f returns
+ * false
+ */
+void fat_walk_directory(struct fat_objectdata* object_data, struct filesystem_node* parent, fat_directory_function f,
+                        void* context) {
+    struct fat_fs_parameters* fs_parameters = &(object_data->fs_parameters);
+    uint32_t sector_size = fs_parameters->sector_size;
+    uint32_t sectors;
+    uint32_t sector;
+    uint32_t cluster = ((struct fat_node*)parent->node_data)->first_cluster;
+    if (fat_fixed_root(object_data, parent)) {
+        sectors = fs_parameters->root_dir_sectors;
+        sector = fs_parameters->first_root_dir_sector;
+    } else {
+        if (fat_end_of_chain(cluster, fs_parameters)) {
+            return;
+        }
+        sectors = fs_parameters->sectors_per_cluster;
+        sector = fat_first_sector_of_cluster(cluster, fs_parameters);
+    }
+    uint32_t buffer_size = sectors * sector_size;
+    uint8_t* buffer = kmalloc(buffer_size);
+    bool more = true;
+    while (more) {
+        blockutil_read(object_data->block_object, buffer, buffer_size, sector, 0);
+        for (uint32_t i = 0; (more) && (i < buffer_size); i = i + sizeof(struct fat_dir_entry)) {
+            struct fat_dir_entry* entry = (struct fat_dir_entry*)&(buffer[i]);
+            more = (*f)(parent, entry, sector + (i / sector_size), i % sector_size, context);
+        }
+        if (fat_fixed_root(object_data, parent)) {
+            more = false;
+        } else if (more) {
+            cluster = fat_next_cluster(object_data->table, cluster, fs_parameters);
+            if (fat_end_of_chain(cluster, fs_parameters)) {
+                more = false;
+            } else {
+                sector = fat_first_sector_of_cluster(cluster, fs_parameters);
+            }
+        }
+    }
+    kfree(buffer);
+}
+
+uint32_t fat_entry_first_cluster(struct fat_objectdata* object_data, struct fat_dir_entry* entry) {
+    uint32_t ret = entry->cluster_low;
+    if (FAT32 == object_data->fs_parameters.type) {
+        ret = ret | (entry->cluster_high << 16);
+    }
+    return ret;
+}
+
+bool fat_list_directory_entry(struct filesystem_node* parent, struct fat_dir_entry* entry, uint32_t sector,
+                              uint16_t offset, void* context) {
+    struct filesystem_directory* dir = (struct filesystem_directory*)context;
+    struct fat_objectdata* object_data = (struct fat_objectdata*)parent->filesystem_obj->object_data;
+    if (0 == entry->name[0]) {
+        // the end of the folder
+        return false;
+    }
+    // deleted, long file name pieces and the volume label aren't nodes
+    if ((0xE5 == entry->name[0]) || ((entry->attributes & FAT_LFN) == FAT_LFN) ||
+        (entry->attributes & FAT_VOLUME_ID)) {
+        return true;
+    }
+    enum filesystem_node_type type = file;
+    if (entry->attributes & FAT_DIRECTORY) {
+        type = folder;
+    } else if (0 != (entry->attributes & FAT_IGNORE)) {
+        return true;
+    }
+
+    uint8_t fn[32];
+    fat_filename_from_fat(entry->name, fn, 32);
+    tolower(fn);
+    if ((0 == strcmp(fn, ".")) || (0 == strcmp(fn, ".."))) {
+        return true;
+    }
+
+    uint32_t first_cluster = fat_entry_first_cluster(object_data, entry);
+    struct filesystem_node* node = filesystem_node_map_find_child(object_data->filesystem_nodes, parent->id, fn);
+    if (0 == node) {
+        node = filesystem_node_new(type, parent->filesystem_obj, fn, entry->size,
+                                   fat_node_new(first_cluster, sector, offset), parent->id);
+        filesystem_node_map_insert(object_data->filesystem_nodes, node);
+    } else {
+        struct fat_node* fat_node = (struct fat_node*)node->node_data;
+        // a node with changes waiting is newer than the disk
+        if (!fat_node->pending) {
+            fat_node->first_cluster = first_cluster;
+            fat_node->clusters = FAT_CLUSTERS_UNKNOWN;
+            fat_node_set_cursor(fat_node, 0, 0);
+            fat_node->entry_sector = sector;
+            fat_node->entry_offset = offset;
+            node->size = entry->size;
+        }
+    }
+    dir->ids[dir->count] = node->id;
+    dir->count += 1;
+    return (dir->count < FILESYSTEM_MAX_FILES_PER_DIR);
+}
+
 void fat_filesystem_list_directory(struct filesystem_node* fs_node, struct filesystem_directory* dir) {
     ASSERT_NOT_NULL(fs_node);
     ASSERT_NOT_NULL(fs_node->filesystem_obj);
     ASSERT_NOT_NULL(fs_node->filesystem_obj->object_data);
+    ASSERT_NOT_NULL(dir);
     struct fat_objectdata* object_data = (struct fat_objectdata*)fs_node->filesystem_obj->object_data;
 
+    dir->count = 0;
     if (fs_node->type == folder) {
-        //    kprintf("listing folder %s\n", fs_node->name);
-
-        dir->count = 0;
-        if ((object_data->fs_parameters.type == FAT12) || (object_data->fs_parameters.type == FAT16)) {
-            uint64_t current_sector = (uint64_t)fs_node->node_data;
-            //      kprintf("cs: %llu\n", current_sector);
-
-            bool more = true;
-            while (more) {
-                // read sector
-                uint8_t* buffer = kmalloc(object_data->fs_parameters.sector_size);
-                memset(buffer, 0, object_data->fs_parameters.sector_size);
-
-                // read first sector of root dir
-                blockutil_read(object_data->block_object, buffer, object_data->fs_parameters.sector_size,
-                               current_sector, 0);
-
-                // loop entries
-                for (uint16_t i = 0; i < object_data->fs_parameters.sector_size; i = i + sizeof(struct fat_dir_entry)) {
-                    struct fat_dir_entry* entry = (struct fat_dir_entry*)&(buffer[i]);
-
-                    // entry ok
-                    if (entry->name[0] != 0) {
-                        // entry is used
-                        if (entry->name[0] != 0xe5) {
-                            // not a long file name
-                            if (entry->name[10] != 0xFF) {
-
-                                // get name
-                                uint8_t fn[32];
-                                fat_filename_from_fat(entry->name, fn, 32);
-                                tolower(fn);
-                                //      kprintf("name: %s\n", fn);
-                                if ((0 != strcmp(fn, ".")) && (0 != strcmp(fn, ".."))) {
-
-                                    //       kprintf("fn %s\n", fn);
-                                    uint64_t node_id = filesystem_node_map_find_name(object_data->filesystem_nodes, fn);
-
-                                    uint32_t node_sector =
-                                        ((entry->cluster_low - 2) * object_data->fs_parameters.sectors_per_cluster) +
-                                        object_data->fs_parameters.first_data_sector;
-
-                                    if (0 == node_id) {
-                                        struct filesystem_node* node = 0;
-                                        if (entry->attributes & FAT_DIRECTORY) {
-                                            //                    kprintf("new folder %s at sector %llu\n", fn, node_sector);
-
-                                            node = filesystem_node_new(folder, fs_node->filesystem_obj, fn, entry->size,
-
-                                                                       (void*)(uint64_t)node_sector, fs_node->id);
-                                        } else if (0 == (entry->attributes & FAT_IGNORE)) {
-                                            //                  kprintf("new file %s at sector %llu\n", fn, node_sector);
-
-                                            node = filesystem_node_new(file, fs_node->filesystem_obj, fn, entry->size,
-                                                                       (void*)(uint64_t)node_sector, fs_node->id);
-                                        }
-                                        if (0 != node) {
-
-                                            //   uint8_t node_full_name[FILESYSTEM_MAX_PATH];
-                                            //   filesystem_node_map_get_node_name(object_data->filesystem_nodes, node,
-                                            //    node_full_name, FILESYSTEM_MAX_PATH);
-
-                                            //   kprintf("node_full_name: %s\n", node_full_name);
-                                            filesystem_node_map_insert(object_data->filesystem_nodes, node);
-                                            //           kprintf("new node %llu\n", node->id);
-                                            node_id = node->id;
-                                        }
-                                    }
-                                    if (0 != node_id) {
-                                        //     kprintf("count %llu, id %llu\n", dir->count, node_id);
-                                        dir->ids[dir->count] = node_id;
-                                        dir->count += 1;
-                                    }
-                                }
-                            }
-                        }
-                    } else {
-                        // we done!
-                        more = false;
-                        break;
-                    }
-                }
-                kfree(buffer);
-                current_sector = current_sector + 1;
-            }
-        } else {
-            PANIC("Unsupported FAT type");
+        fat_walk_directory(object_data, fs_node, &fat_list_directory_entry, dir);
+    }
+}
+
+struct fat_create_search {
+    uint8_t name[11];
+    bool exists;
+    bool have_slot;
+    uint32_t sector;
+    uint16_t offset;
+};
+
+bool fat_create_search_entry(struct filesystem_node* parent, struct fat_dir_entry* entry, uint32_t sector,
+                             uint16_t offset, void* context) {
+    struct fat_create_search* search = (struct fat_create_search*)context;
+    bool end = (0 == entry->name[0]);
+    if ((end) || (0xE5 == entry->name[0])) {
+        if (!search->have_slot) {
+            search->have_slot = true;
+            search->sector = sector;
+            search->offset = offset;
         }
-    } else {
-        dir->count = 0;
+        return !end;
+    }
+    if (((entry->attributes & FAT_LFN) != FAT_LFN) && (0 == memcmp(entry->name, search->name, 11))) {
+        search->exists = true;
+        return false;
     }
+    return true;
+}
+
+/*
+ * the directory entry is written straight away, with no clusters; they come with the first sync after a write
+ */
+struct filesystem_node* fat_filesystem_create(struct filesystem_node* fs_node, uint8_t* name) {
+    ASSERT_NOT_NULL(fs_node);
+    ASSERT_NOT_NULL(fs_node->filesystem_obj);
+    ASSERT_NOT_NULL(fs_node->filesystem_obj->object_data);
+    ASSERT_NOT_NULL(name);
+    struct fat_objectdata* object_data = (struct fat_objectdata*)fs_node->filesystem_obj->object_data;
+    struct fat_fs_parameters* fs_parameters = &(object_data->fs_parameters);
+    if (folder != fs_node->type) {
+        return 0;
+    }
+    struct fat_create_search search;
+    memzero((uint8_t*)&search, sizeof(struct fat_create_search));
+    if (!fat_filename_to_fat(name, search.name, 11)) {
+        return 0;
+    }
+    fat_walk_directory(object_data, fs_node, &fat_create_search_entry, &search);
+    if (search.exists) {
+        return 0;
+    }
+    if (!search.have_slot) {
+        // the folder is full.  the fixed root can't grow; others get another cluster
+        if ((fat_fixed_root(object_data, fs_node)) ||
+            (object_data->free_clusters == object_data->reserved_clusters)) {
+            return 0;
+        }
+        uint32_t cluster = fat_extend_node(object_data, fs_node, 1);
+        uint32_t cluster_size = fat_cluster_size(object_data);
+        uint8_t* zeros = kmalloc(cluster_size);
+        memzero(zeros, cluster_size);
+        blockutil_update(object_data->block_object, zeros, cluster_size,
+                         fat_first_sector_of_cluster(cluster, fs_parameters), 0);
+        kfree(zeros);
+        search.sector = fat_first_sector_of_cluster(cluster, fs_parameters);
+        search.offset = 0;
+    }
+
+    struct fat_dir_entry entry;
+    memzero((uint8_t*)&entry, sizeof(struct fat_dir_entry));
+    memcpy(entry.name, search.name, 11);
+    entry.attributes = FAT_ARCHIVE;
+    blockutil_update(object_data->block_object, (uint8_t*)&entry, sizeof(struct fat_dir_entry), search.sector,
+                     search.offset);
+
+    uint8_t fn[32];
+    fat_filename_from_fat(search.name, fn, 32);
+    tolower(fn);
+    struct fat_node* node = fat_node_new(0, search.sector, search.offset);
+    node->clusters = 0;
+    struct filesystem_node* ret = filesystem_node_new(file, fs_node->filesystem_obj, fn, 0, node, fs_node->id);
+    filesystem_node_map_insert(object_data->filesystem_nodes, ret);
+    return ret;
 }
 
 struct object* fat_attach(struct object* block_object) {
@@ -226,20 +952,26 @@ struct object* fat_attach(struct object* block_object) {
         (struct objectinterface_filesystem*)kmalloc(sizeof(struct objectinterface_filesystem));
     memzero((uint8_t*)api, sizeof(struct objectinterface_filesystem));
     api->close = &fat_filesystem_close;
+    api->create = &fat_filesystem_create;
     api->find_id = &fat_filesystem_find_node_by_id;
     api->list = &fat_filesystem_list_directory;
     api->open = &fat_filesystem_open;
     api->read = &fat_filesystem_read;
     api->root = &fat_filesystem_get_root_node;
+    api->sync = &fat_filesystem_sync;
+    api->truncate = &fat_filesystem_truncate;
     api->write = &fat_filesystem_write;
+    api->cached = true;
     objectinstance->api = api;
     /*
      * device data
      */
     struct fat_objectdata* object_data = (struct fat_objectdata*)kmalloc(sizeof(struct fat_objectdata));
+    memzero((uint8_t*)object_data, sizeof(struct fat_objectdata));
     object_data->block_object = block_object;
     object_data->root_node = 0;
     object_data->filesystem_nodes = filesystem_node_map_new();
+    object_data->pending = arraylist_new();
     objectinstance->object_data = object_data;
 
     /*
@@ -257,7 +989,8 @@ struct object* fat_attach(struct object* block_object) {
     } else {
         filesystem_node_map_clear(object_data->filesystem_nodes);
         filesystem_node_map_delete(object_data->filesystem_nodes);
-        kfree(object_data->root_node);
+        filesystem_node_delete(object_data->root_node);
+        arraylist_delete(object_data->pending);
         kfree(object_data);
         kfree(api);
         kfree(objectinstance);
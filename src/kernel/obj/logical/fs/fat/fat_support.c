@@ -27,6 +27,7 @@ void fat_dump_fat_fs_parameters(struct fat_fs_parameters* param) {
     kprintf("  root_cluster_32 %llu\n", param->root_cluster_32);
     kprintf("  type: %llu\n", param->type);
     kprintf("  sectors_per_cluster: %llu\n", param->sectors_per_cluster);
+    kprintf("  table_count: %llu\n", param->table_count);
 }
 
 void fat_dump_fat_extBS_16(struct fat_extBS_16* ebs) {
@@ -61,9 +62,9 @@ void fat_read_fs_parameters(struct object* obj, struct fat_fs_parameters* param)
     param->first_data_sector =
         fat_boot->reserved_sector_count + (fat_boot->table_count * param->fat_size) + param->root_dir_sectors;
     param->first_fat_sector = fat_boot->reserved_sector_count;
-    param->data_sectors =
-        fat_boot->total_sectors_16 -
-        (fat_boot->reserved_sector_count + (fat_boot->table_count * param->fat_size) + param->root_dir_sectors);
+    param->table_count = fat_boot->table_count;
+    param->data_sectors = param->total_sectors - (fat_boot->reserved_sector_count +
+                                                  (fat_boot->table_count * param->fat_size) + param->root_dir_sectors);
     param->total_clusters = param->data_sectors / fat_boot->sectors_per_cluster;
     param->first_root_dir_sector = param->first_data_sector - param->root_dir_sectors;
     param->root_cluster_32 = fat_boot_ext_32->root_cluster;
@@ -91,18 +92,67 @@ void fat_filename_from_fat(uint8_t* fat_name, uint8_t* normal_name, uint16_t siz
             normal_name[j++] = fat_name[i];
         }
     }
-    if ((' ' != fat_name[8]) && (' ' != fat_name[9]) && (' ' != fat_name[10])) {
+    // the extension is space padded, and may be shorter than 3
+    if (' ' != fat_name[8]) {
         normal_name[j++] = '.';
-        normal_name[j++] = fat_name[8];
-        normal_name[j++] = fat_name[9];
-        normal_name[j++] = fat_name[10];
+        for (uint8_t i = 8; i < 11; i++) {
+            if (fat_name[i] != ' ') {
+                normal_name[j++] = fat_name[i];
+            }
+        }
     }
     normal_name[j] = 0;
 }
 
-void fat_filename_to_fat(uint8_t* normal_name, uint8_t* fat_name, uint16_t size) {
-    PANIC("not implemented");
+// characters 8.3 names can't have, besides control characters and spaces
+const uint8_t fat_invalid_characters[] = "\"*+,/:;<=>?[\\]|";
+
+/*
+ * make the space padded, upper case 8.3 name for 'normal_name'.  returns false if it doesn't have one
+ */
+bool fat_filename_to_fat(uint8_t* normal_name, uint8_t* fat_name, uint16_t size) {
+    ASSERT_NOT_NULL(normal_name);
+    ASSERT_NOT_NULL(fat_name);
+    ASSERT(size >= 11);
+    memset(fat_name, ' ', 11);
+    uint8_t base = 0;
+    uint8_t ext = 0;
+    bool in_ext = false;
+    for (uint32_t i = 0; 0 != normal_name[i]; i++) {
+        uint8_t c = normal_name[i];
+        if ('.' == c) {
+            if (in_ext || (0 == base)) {
+                return false;
+            }
+            in_ext = true;
+            continue;
+        }
+        if ((c <= ' ') || (c >= 0x7F)) {
+            return false;
+        }
+        for (uint8_t j = 0; 0 != fat_invalid_characters[j]; j++) {
+            if (c == fat_invalid_characters[j]) {
+                return false;
+            }
+        }
+        if ((c >= 'a') && (c <= 'z')) {
+            c = c - 'a' + 'A';
+        }
+        if (in_ext) {
+            if (ext == 3) {
+                return false;
+            }
+            fat_name[8 + ext++] = c;
+        } else {
+            if (base == 8) {
+                return false;
+            }
+            fat_name[base++] = c;
+        }
+    }
+    return (base > 0) && ((!in_ext) || (ext > 0));
 }
+
 /*
  * find first sector of cluster
  */
@@ -110,21 +160,13 @@ uint64_t fat_first_sector_of_cluster(uint32_t cluster, struct fat_fs_parameters*
     return ((cluster - 2) * fs_parameters->sectors_per_cluster) + fs_parameters->first_data_sector;
 }
 
-uint32_t fat_fat12_next_cluster(struct object* obj, uint32_t current_cluster, struct fat_fs_parameters* fs_parameters) {
-    uint8_t FAT_table[fs_parameters->sector_size];
+/*
+ * the FAT entries are read from the copy of the table in memory.  FAT12 packs two entries into three bytes
+ */
+uint32_t fat_fat12_next_cluster(uint8_t* table, uint32_t current_cluster) {
+    ASSERT_NOT_NULL(table);
     uint32_t fat_offset = current_cluster + (current_cluster / 2);  // multiply by 1.5
-    kprintf("fat_offset %llu\n", fat_offset);
-
-    uint32_t fat_sector = fs_parameters->first_fat_sector + (fat_offset / fs_parameters->sector_size);
-    kprintf("fat_sector %llu\n", fat_sector);
-
-    uint32_t ent_offset = fat_offset % fs_parameters->sector_size;
-
-    memset((uint8_t*)&FAT_table, 0, fs_parameters->sector_size);
-    blockutil_read(obj, (uint8_t*)&FAT_table, fs_parameters->sector_size, fat_sector, 0);
-
-    unsigned short table_value = *(unsigned short*)&FAT_table[ent_offset];
-
+    uint16_t table_value = table[fat_offset] | (table[fat_offset + 1] << 8);
     if (current_cluster & 0x0001) {
         table_value = table_value >> 4;
     } else {
@@ -133,14 +175,88 @@ uint32_t fat_fat12_next_cluster(struct object* obj, uint32_t current_cluster, st
     return table_value;
 }
 
-uint32_t fat_fat16_next_cluster(struct object* obj, uint32_t current_cluster, struct fat_fs_parameters* fs_parameters) {
-    uint8_t FAT_table[fs_parameters->sector_size];
+uint32_t fat_fat16_next_cluster(uint8_t* table, uint32_t current_cluster) {
+    ASSERT_NOT_NULL(table);
     uint32_t fat_offset = current_cluster * 2;
-    uint32_t fat_sector = fs_parameters->first_fat_sector + (fat_offset / fs_parameters->sector_size);
-    uint32_t ent_offset = fat_offset % fs_parameters->sector_size;
+    return table[fat_offset] | (table[fat_offset + 1] << 8);
+}
+
+uint32_t fat_fat32_next_cluster(uint8_t* table, uint32_t current_cluster) {
+    ASSERT_NOT_NULL(table);
+    uint32_t fat_offset = current_cluster * 4;
+    uint32_t table_value = table[fat_offset] | (table[fat_offset + 1] << 8) | (table[fat_offset + 2] << 16) |
+                           ((uint32_t)table[fat_offset + 3] << 24);
+    // the top 4 bits are reserved
+    return table_value & 0x0FFFFFFF;
+}
+
+uint32_t fat_next_cluster(uint8_t* table, uint32_t current_cluster, struct fat_fs_parameters* fs_parameters) {
+    ASSERT_NOT_NULL(fs_parameters);
+    ASSERT(current_cluster < (fs_parameters->total_clusters + 2));
+    if (FAT12 == fs_parameters->type) {
+        return fat_fat12_next_cluster(table, current_cluster);
+    } else if (FAT16 == fs_parameters->type) {
+        return fat_fat16_next_cluster(table, current_cluster);
+    }
+    return fat_fat32_next_cluster(table, current_cluster);
+}
+
+/*
+ * true if 'cluster', read from the FAT, ends a chain.  free and reserved entries end it too, so a damaged chain
+ * can't run off into clusters that aren't the file's
+ */
+bool fat_end_of_chain(uint32_t cluster, struct fat_fs_parameters* fs_parameters) {
+    ASSERT_NOT_NULL(fs_parameters);
+    if ((cluster < 2) || (cluster >= (fs_parameters->total_clusters + 2))) {
+        return true;
+    }
+    return false;
+}
 
-    memset((uint8_t*)&FAT_table, 0, fs_parameters->sector_size);
-    blockutil_read(obj, (uint8_t*)&FAT_table, fs_parameters->sector_size, fat_sector, 0);
+/*
+ * the value that ends a chain
+ */
+uint32_t fat_end_of_chain_marker(struct fat_fs_parameters* fs_parameters) {
+    ASSERT_NOT_NULL(fs_parameters);
+    if (FAT12 == fs_parameters->type) {
+        return 0xFFF;
+    } else if (FAT16 == fs_parameters->type) {
+        return 0xFFFF;
+    }
+    return 0x0FFFFFFF;
+}
 
-    return *(unsigned short*)&FAT_table[ent_offset];
+/*
+ * set a cluster's entry in a FAT held in memory.  returns the offset of the first byte changed; the entry is at
+ * most 4 bytes from there
+ */
+uint32_t fat_set_next_cluster(uint8_t* table, uint32_t current_cluster, uint32_t next_cluster,
+                              struct fat_fs_parameters* fs_parameters) {
+    ASSERT_NOT_NULL(table);
+    ASSERT_NOT_NULL(fs_parameters);
+    ASSERT(current_cluster < (fs_parameters->total_clusters + 2));
+    uint32_t fat_offset;
+    if (FAT12 == fs_parameters->type) {
+        fat_offset = current_cluster + (current_cluster / 2);
+        uint16_t table_value = table[fat_offset] | (table[fat_offset + 1] << 8);
+        if (current_cluster & 0x0001) {
+            table_value = (table_value & 0x000F) | ((next_cluster & 0x0FFF) << 4);
+        } else {
+            table_value = (table_value & 0xF000) | (next_cluster & 0x0FFF);
+        }
+        table[fat_offset] = table_value & 0xFF;
+        table[fat_offset + 1] = table_value >> 8;
+    } else if (FAT16 == fs_parameters->type) {
+        fat_offset = current_cluster * 2;
+        table[fat_offset] = next_cluster & 0xFF;
+        table[fat_offset + 1] = (next_cluster >> 8) & 0xFF;
+    } else {
+        fat_offset = current_cluster * 4;
+        // keep the reserved top 4 bits
+        table[fat_offset] = next_cluster & 0xFF;
+        table[fat_offset + 1] = (next_cluster >> 8) & 0xFF;
+        table[fat_offset + 2] = (next_cluster >> 16) & 0xFF;
+        table[fat_offset + 3] = (table[fat_offset + 3] & 0xF0) | ((next_cluster >> 24) & 0x0F);
+    }
+    return fat_offset;
 }
@@ -109,6 +109,7 @@ struct fat_fs_parameters {
     uint32_t total_clusters;
     uint32_t first_root_dir_sector;
     uint32_t root_cluster_32;
+    uint8_t table_count;
     enum fat_type type;
 };
 
@@ -116,9 +117,18 @@ void fat_dump_fat_fs_parameters(struct fat_fs_parameters* param);
 void fat_dump_fat_extBS_16(struct fat_extBS_16* ebs);
 void fat_read_fs_parameters(struct object* obj, struct fat_fs_parameters* param);
 uint64_t fat_first_sector_of_cluster(uint32_t cluster, struct fat_fs_parameters* fs_parameters);
-uint32_t fat_fat12_next_cluster(struct object* obj, uint32_t current_cluster, struct fat_fs_parameters* fs_parameters);
-uint32_t fat_fat16_next_cluster(struct object* obj, uint32_t current_cluster, struct fat_fs_parameters* fs_parameters);
+/*
+* next cluster in a chain, from a FAT held in memory
+*/
+uint32_t fat_fat12_next_cluster(uint8_t* table, uint32_t current_cluster);
+uint32_t fat_fat16_next_cluster(uint8_t* table, uint32_t current_cluster);
+uint32_t fat_fat32_next_cluster(uint8_t* table, uint32_t current_cluster);
+uint32_t fat_next_cluster(uint8_t* table, uint32_t current_cluster, struct fat_fs_parameters* fs_parameters);
+bool fat_end_of_chain(uint32_t cluster, struct fat_fs_parameters* fs_parameters);
+uint32_t fat_end_of_chain_marker(struct fat_fs_parameters* fs_parameters);
+uint32_t fat_set_next_cluster(uint8_t* table, uint32_t current_cluster, uint32_t next_cluster,
+                              struct fat_fs_parameters* fs_parameters);
 void fat_filename_from_fat(uint8_t* fat_name, uint8_t* normal_name, uint16_t size);
-void fat_filename_to_fat(uint8_t* normal_name, uint8_t* fat_name, uint16_t size);
+bool fat_filename_to_fat(uint8_t* normal_name, uint8_t* fat_name, uint16_t size);
 
 #endif
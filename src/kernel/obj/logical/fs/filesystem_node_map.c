@@ -6,6 +6,7 @@
 // ****************************************************************
 
 #include <obj/logical/fs/filesystem_node_map.h>
+#include <obj/logical/fs/node_util.h>
 #include <sys/collection/arraylist/arraylist.h>
 #include <sys/collection/tree/tree.h>
 #include <sys/debug/assert.h>
@@ -31,7 +32,7 @@ void filesystem_node_map_delete(struct filesystem_node_map* map) {
 
 void filesystem_delete_tree_iterator(void* value) {
     if (0 != value) {
-        kfree(value);
+        filesystem_node_delete((struct filesystem_node*)value);
     }
 }
 
@@ -77,6 +78,37 @@ uint64_t filesystem_node_map_find_name(struct filesystem_node_map* map, uint8_t*
     return tree_find(map->filesystem_nodes_by_id, &filesystem_node_map_name_comparator, name);
 }
 
+struct filesystem_node_map_child_criteria {
+    uint64_t parent;
+    uint8_t* name;
+};
+
+uint8_t filesystem_node_map_child_comparator(void* criteria, void* value) {
+    ASSERT_NOT_NULL(criteria);
+    ASSERT_NOT_NULL(value);
+    struct filesystem_node_map_child_criteria* c = (struct filesystem_node_map_child_criteria*)criteria;
+    struct filesystem_node* node = (struct filesystem_node*)value;
+    if ((c->parent == node->parent) && (0 == strcmp(c->name, node->name))) {
+        return 1;
+    }
+    return 0;
+}
+
+struct filesystem_node* filesystem_node_map_find_child(struct filesystem_node_map* map, uint64_t parent,
+                                                       uint8_t* name) {
+    ASSERT_NOT_NULL(map);
+    ASSERT_NOT_NULL(map->filesystem_nodes_by_id);
+    ASSERT_NOT_NULL(name);
+    struct filesystem_node_map_child_criteria criteria;
+    criteria.parent = parent;
+    criteria.name = name;
+    uint64_t id = tree_find(map->filesystem_nodes_by_id, &filesystem_node_map_child_comparator, &criteria);
+    if (0 == id) {
+        return 0;
+    }
+    return filesystem_node_map_find_id(map, id);
+}
+
 void filesystem_node_map_get_node_name(struct filesystem_node_map* map, struct filesystem_node* node, uint8_t* name,
                                        uint32_t name_size) {
     ASSERT_NOT_NULL(map);
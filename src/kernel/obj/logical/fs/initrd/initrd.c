@@ -9,6 +9,7 @@
 #include <obj/logical/fs/filesystem_node_map.h>
 #include <obj/logical/fs/initrd/initrd.h>
 #include <obj/logical/fs/node_util.h>
+#include <sys/compress/lz4.h>
 #include <sys/debug/assert.h>
 #include <sys/kmalloc/kmalloc.h>
 #include <sys/kprintf/kprintf.h>
@@ -18,27 +19,119 @@
 #include <sys/obj/objecttype/objectype.h>
 #include <sys/panic/panic.h>
 #include <sys/string/mem.h>
+#include <sys/string/string.h>
 
-struct initrd_file_header {
-    uint8_t magic;
-    uint8_t name[INITRD_NAME_SIZE];
-    uint32_t offset;  // byte count from start of initrd
-    uint32_t length;  // byte length
-};
-
-struct initrd_header {
-    uint32_t number_files;
-    struct initrd_file_header headers[INITRD_MAX_FILES];
-};
+/*
+ * the filesystem_node field "node_data" is the index of the file's entry
+ */
 
 struct initrd_objectdata {
     struct object* partition_object;
     uint32_t lba;
-    struct initrd_header header;
+    const uint8_t* image;  // the whole image, if the boot loader left it in memory.  otherwise it's read from the disk
+    uint64_t image_size;
+    uint64_t number_files;
+    struct initrd2_entry* entries;   // sorted by name.  a version 1 table is made into these at init
+    struct filesystem_node** nodes;  // for each entry, made when first listed or found
     struct filesystem_node* root_node;
     struct filesystem_node_map* filesystem_nodes;
+    /*
+     * the chunk decoded last, so reading a compressed file a piece at a time decodes each chunk once
+     */
+    uint8_t* chunk;
+    uint8_t* stored;
+    uint64_t chunk_entry;  // 0 if none, else the entry index + 1
+    uint64_t chunk_index;
+    uint32_t chunk_size;
 };
 
+/*
+ * where bytes of the image are in memory, or 0 if it isn't there
+ */
+const uint8_t* initrd_image_at(struct initrd_objectdata* object_data, uint64_t offset, uint64_t size) {
+    if ((0 == object_data->image) || (offset > object_data->image_size) ||
+        (size > (object_data->image_size - offset))) {
+        return 0;
+    }
+    return &(object_data->image[offset]);
+}
+
+/*
+ * read bytes from anywhere in the image
+ */
+void initrd_read_image(struct initrd_objectdata* object_data, uint64_t offset, uint8_t* data, uint32_t data_size) {
+    const uint8_t* in_memory = initrd_image_at(object_data, offset, data_size);
+    if (0 != in_memory) {
+        memcpy(data, in_memory, data_size);
+        return;
+    }
+    uint32_t sector_size = blockutil_get_sector_size(object_data->partition_object);
+    blockutil_read(object_data->partition_object, data, data_size, object_data->lba + (offset / sector_size),
+                   offset % sector_size);
+}
+
+/*
+ * make the version 1 table into entries, sorted
+ */
+bool initrd_load_v1(struct initrd_objectdata* object_data) {
+    struct initrd_header* header = (struct initrd_header*)kmalloc(sizeof(struct initrd_header));
+    initrd_read_image(object_data, 0, (uint8_t*)header, sizeof(struct initrd_header));
+    if (header->number_files > INITRD_MAX_FILES) {
+        kfree(header);
+        return false;
+    }
+    object_data->number_files = header->number_files;
+    object_data->entries = (struct initrd2_entry*)kmalloc((header->number_files + 1) * sizeof(struct initrd2_entry));
+    for (uint32_t i = 0; i < header->number_files; i++) {
+        if (INITRD_FILE_MAGIC != header->headers[i].magic) {
+            kfree(header);
+            return false;
+        }
+        struct initrd2_entry entry;
+        memzero((uint8_t*)&entry, sizeof(struct initrd2_entry));
+        memcpy(entry.name, header->headers[i].name, INITRD_NAME_SIZE);
+        entry.name[INITRD_NAME_SIZE - 1] = 0;
+        entry.offset = header->headers[i].offset;
+        entry.length = header->headers[i].length;
+        entry.stored_length = entry.length;
+        entry.compression = INITRD_COMPRESSION_NONE;
+        uint32_t j = i;
+        while ((j > 0) && ((int8_t)strcmp(object_data->entries[j - 1].name, entry.name) > 0)) {
+            object_data->entries[j] = object_data->entries[j - 1];
+            j--;
+        }
+        object_data->entries[j] = entry;
+    }
+    kfree(header);
+    return true;
+}
+
+/*
+ * read the index.  mkinitrd sorts it
+ */
+bool initrd_load_v2(struct initrd_objectdata* object_data, struct initrd2_header* header) {
+    if ((INITRD_VERSION != header->version) || (sizeof(struct initrd2_entry) != header->entry_size) ||
+        (header->number_files > (header->image_size / sizeof(struct initrd2_entry)))) {
+        return false;
+    }
+    object_data->number_files = header->number_files;
+    object_data->entries = (struct initrd2_entry*)kmalloc((header->number_files + 1) * sizeof(struct initrd2_entry));
+    if (header->number_files > 0) {
+        initrd_read_image(object_data, header->index_offset, (uint8_t*)object_data->entries,
+                          header->number_files * sizeof(struct initrd2_entry));
+    }
+    for (uint64_t i = 0; i < header->number_files; i++) {
+        struct initrd2_entry* entry = &(object_data->entries[i]);
+        entry->name[INITRD_NAME_SIZE - 1] = 0;
+        if (((i > 0) && ((int8_t)strcmp(object_data->entries[i - 1].name, entry->name) >= 0)) ||
+            (entry->compression > INITRD_COMPRESSION_LZ4) || (0 == entry->offset) ||
+            ((entry->offset + entry->stored_length) > header->image_size)) {
+            return false;
+        }
+    }
+    return true;
+}
+
 /*
  * perform device instance specific init here
  */
@@ -46,15 +139,34 @@ uint8_t initrd_init(struct object* obj) {
     ASSERT_NOT_NULL(obj);
     ASSERT_NOT_NULL(obj->object_data);
     struct initrd_objectdata* object_data = (struct initrd_objectdata*)obj->object_data;
-    object_data->root_node = filesystem_node_new(folder, obj, obj->name, 0, 0, 0);
 
     /*
-    * read the header
+    * read the header, which says which version this is
     */
-    blockutil_read(object_data->partition_object, (uint8_t*)&(object_data->header), sizeof(struct initrd_header),
-                   object_data->lba, 0);
-
-    kprintf("Init %s on %s (%s)\n", obj->description, object_data->partition_object->name, obj->name);
+    struct initrd2_header header;
+    initrd_read_image(object_data, 0, (uint8_t*)&header, sizeof(struct initrd2_header));
+    bool loaded = false;
+    if (0 == memcmp(header.magic, INITRD_MAGIC, sizeof(header.magic))) {
+        if (header.image_size > object_data->image_size) {
+            // not all of it made it into memory
+            object_data->image = 0;
+        }
+        loaded = initrd_load_v2(object_data, &header);
+    } else {
+        loaded = initrd_load_v1(object_data);
+    }
+    if (!loaded) {
+        if (0 != object_data->entries) {
+            kfree(object_data->entries);
+        }
+        return 0;
+    }
+    object_data->nodes =
+        (struct filesystem_node**)kmalloc((object_data->number_files + 1) * sizeof(struct filesystem_node*));
+    memzero((uint8_t*)object_data->nodes, (object_data->number_files + 1) * sizeof(struct filesystem_node*));
+    object_data->root_node = filesystem_node_new(folder, obj, obj->name, 0, 0, 0);
+    kprintf("Init %s on %s (%s)%s\n", obj->description, object_data->partition_object->name, obj->name,
+            (0 != object_data->image) ? " in memory" : "");
     return 1;
 }
 
@@ -66,10 +178,20 @@ uint8_t initrd_uninit(struct object* obj) {
     ASSERT_NOT_NULL(obj->object_data);
     struct initrd_objectdata* object_data = (struct initrd_objectdata*)obj->object_data;
     kprintf("Uninit %s on %s (%s)\n", obj->description, object_data->partition_object->name, obj->name);
-    filesystem_node_map_clear(object_data->filesystem_nodes);
+    for (uint64_t i = 0; i < object_data->number_files; i++) {
+        if (0 != object_data->nodes[i]) {
+            filesystem_node_delete(object_data->nodes[i]);
+        }
+    }
     filesystem_node_map_delete(object_data->filesystem_nodes);
+    kfree(object_data->nodes);
+    kfree(object_data->entries);
+    if (0 != object_data->chunk) {
+        kfree(object_data->chunk);
+        kfree(object_data->stored);
+    }
     kfree(obj->api);
-    kfree(object_data->root_node);
+    filesystem_node_delete(object_data->root_node);
     kfree(object_data);
     return 1;
 }
@@ -81,7 +203,90 @@ struct filesystem_node* initrd_get_root_node(struct object* filesystem_obj) {
     return object_data->root_node;
 }
 
-uint32_t initrd_read(struct filesystem_node* fs_node, uint8_t* data, uint32_t data_size) {
+/*
+ * the node for entry i
+ */
+struct filesystem_node* initrd_node(struct object* obj, uint64_t i) {
+    struct initrd_objectdata* object_data = (struct initrd_objectdata*)obj->object_data;
+    if (0 == object_data->nodes[i]) {
+        // node_data is the index into the entries
+        struct filesystem_node* node = filesystem_node_new(file, obj, object_data->entries[i].name,
+                                                           object_data->entries[i].length, (void*)i,
+                                                           object_data->root_node->id);
+        filesystem_node_map_insert(object_data->filesystem_nodes, node);
+        object_data->nodes[i] = node;
+    }
+    return object_data->nodes[i];
+}
+
+struct filesystem_node* initrd_find_node_by_name(struct object* obj, const uint8_t* name) {
+    ASSERT_NOT_NULL(obj);
+    ASSERT_NOT_NULL(obj->object_data);
+    ASSERT_NOT_NULL(name);
+    struct initrd_objectdata* object_data = (struct initrd_objectdata*)obj->object_data;
+    uint64_t low = 0;
+    uint64_t high = object_data->number_files;
+    while (low < high) {
+        uint64_t middle = low + ((high - low) / 2);
+        int8_t compare = (int8_t)strcmp(object_data->entries[middle].name, (uint8_t*)name);
+        if (0 == compare) {
+            return initrd_node(obj, middle);
+        } else if (compare < 0) {
+            low = middle + 1;
+        } else {
+            high = middle;
+        }
+    }
+    return 0;
+}
+
+/*
+ * decode chunk 'index' of a compressed file, unless it's the one decoded last.  false if it's corrupt
+ */
+bool initrd_decode_chunk(struct initrd_objectdata* object_data, uint64_t i, uint64_t index) {
+    if ((object_data->chunk_entry == (i + 1)) && (object_data->chunk_index == index)) {
+        return true;
+    }
+    struct initrd2_entry* entry = &(object_data->entries[i]);
+    uint64_t chunks = (entry->length + INITRD_CHUNK_SIZE - 1) / INITRD_CHUNK_SIZE;
+    uint32_t size = INITRD_CHUNK_SIZE;
+    if (index == (chunks - 1)) {
+        size = entry->length - (index * INITRD_CHUNK_SIZE);
+    }
+    // where the chunk starts and ends
+    uint64_t bounds[2];
+    initrd_read_image(object_data, entry->offset + (index * sizeof(uint64_t)), (uint8_t*)bounds, sizeof(bounds));
+    uint64_t table_size = (chunks + 1) * sizeof(uint64_t);
+    if ((bounds[0] < table_size) || (bounds[1] <= bounds[0]) || (bounds[1] > entry->stored_length) ||
+        ((bounds[1] - bounds[0]) > size)) {
+        return false;
+    }
+    uint32_t stored = bounds[1] - bounds[0];
+    if (0 == object_data->chunk) {
+        object_data->chunk = kmalloc(INITRD_CHUNK_SIZE);
+        object_data->stored = kmalloc(INITRD_CHUNK_SIZE);
+    }
+    object_data->chunk_entry = 0;
+    if (stored == size) {
+        initrd_read_image(object_data, entry->offset + bounds[0], object_data->chunk, size);
+    } else {
+        // decoded straight from the image, if it's in memory
+        const uint8_t* source = initrd_image_at(object_data, entry->offset + bounds[0], stored);
+        if (0 == source) {
+            initrd_read_image(object_data, entry->offset + bounds[0], object_data->stored, stored);
+            source = object_data->stored;
+        }
+        if (size != lz4_decompress(source, stored, object_data->chunk, size)) {
+            return false;
+        }
+    }
+    object_data->chunk_entry = i + 1;
+    object_data->chunk_index = index;
+    object_data->chunk_size = size;
+    return true;
+}
+
+uint32_t initrd_read(struct filesystem_node* fs_node, uint64_t offset, uint8_t* data, uint32_t data_size) {
     //  kprintf("initrd_read node %s on device %s to buffer %#llX with length %llu\n", fs_node->name,
     //        fs_node->filesystem_obj->name, data, data_size);
     ASSERT_NOT_NULL(fs_node);
@@ -95,44 +300,68 @@ uint32_t initrd_read(struct filesystem_node* fs_node, uint8_t* data, uint32_t da
         * cant read or write root node
         */
         return 0;
-    } else {
-        uint32_t idx = (uint32_t)(uint64_t)fs_node->node_data;
-
-        /*
-        * get underlying sector size
-        */
-        uint32_t sector_size = blockutil_get_sector_size(object_data->partition_object);
-        uint32_t offset = object_data->header.headers[idx].offset;
-        ASSERT(offset > 0);
-        uint32_t length = object_data->header.headers[idx].length;
-        ASSERT(data_size >= length);
-        //  kprintf("offset %llu length %llu\n", offset, length);
-
-        uint32_t lba_offset = offset / sector_size;
-        uint32_t byte_offset = offset % sector_size;
-        uint32_t total_sectors = length / sector_size;
-        if ((length % 512) != 0) {
-            total_sectors += 1;
+    }
+    uint64_t i = (uint64_t)fs_node->node_data;
+    struct initrd2_entry* entry = &(object_data->entries[i]);
+    ASSERT(entry->offset > 0);
+    if (offset >= entry->length) {
+        return 0;
+    }
+    if (data_size > entry->length - offset) {
+        data_size = entry->length - offset;
+    }
+    if (INITRD_COMPRESSION_NONE == entry->compression) {
+        initrd_read_image(object_data, entry->offset + offset, data, data_size);
+        return data_size;
+    }
+    /*
+     * a chunk at a time
+     */
+    uint32_t done = 0;
+    while (done < data_size) {
+        uint64_t index = (offset + done) / INITRD_CHUNK_SIZE;
+        if (!initrd_decode_chunk(object_data, i, index)) {
+            kprintf("initrd file %s is corrupt\n", entry->name);
+            return done;
         }
-        // if it spans sectors
-        if (byte_offset + length > sector_size) {
-            total_sectors += 1;
+        uint32_t in_chunk = (offset + done) % INITRD_CHUNK_SIZE;
+        uint32_t count = object_data->chunk_size - in_chunk;
+        if (count > (data_size - done)) {
+            count = data_size - done;
         }
-        uint32_t target_lba = object_data->lba + lba_offset;
-
-        //   kprintf("lba_offset %llu byte_offset %llu total_sectors %llu target_lba %llu buffer_size %#llX\\n", lba_offset,
-        //         byte_offset, total_sectors, target_lba, buffer_size);
-
-        /*
-        * read the blocks
-        */
-        blockutil_read(object_data->partition_object, data, data_size, target_lba, byte_offset);
+        memcpy(&(data[done]), &(object_data->chunk[in_chunk]), count);
+        done += count;
+    }
+    return done;
+}
 
-        return 1;
+/*
+ * a file stored as it is, in an image in memory, can be mapped.  mkinitrd starts those on a page boundary and pads
+ * them with zeros to the next
+ */
+const uint8_t* initrd_map(struct filesystem_node* fs_node) {
+    ASSERT_NOT_NULL(fs_node);
+    ASSERT_NOT_NULL(fs_node->filesystem_obj);
+    ASSERT_NOT_NULL(fs_node->filesystem_obj->object_data);
+    struct initrd_objectdata* object_data = (struct initrd_objectdata*)fs_node->filesystem_obj->object_data;
+    if (fs_node == object_data->root_node) {
+        return 0;
     }
+    struct initrd2_entry* entry = &(object_data->entries[(uint64_t)fs_node->node_data]);
+    uint64_t mapped = ((entry->length + INITRD_PAGE_SIZE - 1) / INITRD_PAGE_SIZE) * INITRD_PAGE_SIZE;
+    const uint8_t* ret = initrd_image_at(object_data, entry->offset, mapped);
+    if ((INITRD_COMPRESSION_NONE != entry->compression) || (0 == ret) || (0 != ((uint64_t)ret % INITRD_PAGE_SIZE))) {
+        return 0;
+    }
+    for (uint64_t i = entry->length; i < mapped; i++) {
+        if (0 != ret[i]) {
+            return 0;
+        }
+    }
+    return ret;
 }
 
-uint32_t initrd_write(struct filesystem_node* fs_node, const uint8_t* data, uint32_t data_size) {
+uint32_t initrd_write(struct filesystem_node* fs_node, uint64_t offset, const uint8_t* data, uint32_t data_size) {
     ASSERT_NOT_NULL(fs_node);
     ASSERT_NOT_NULL(fs_node->filesystem_obj);
     ASSERT_NOT_NULL(fs_node->filesystem_obj->object_data);
@@ -184,18 +413,8 @@ void initrd_list_directory(struct filesystem_node* fs_node, struct filesystem_di
     */
     if (fs_node == object_data->root_node) {
         dir->count = 0;
-        for (uint64_t i = 0; i < object_data->header.number_files; i++) {
-            uint8_t* name = object_data->header.headers[i].name;
-            uint64_t node_id = filesystem_node_map_find_name(object_data->filesystem_nodes, name);
-            if (0 == node_id) {
-                // node_data is the index into the header table
-                struct filesystem_node* node = filesystem_node_new(
-                    file, fs_node->filesystem_obj, name, object_data->header.headers[i].length, (void*)i, fs_node->id);
-                filesystem_node_map_insert(object_data->filesystem_nodes, node);
-                //       kprintf("new node %llu with name %s\n", node->id, node->name);
-                node_id = node->id;
-            }
-            dir->ids[dir->count] = node_id;
+        for (uint64_t i = 0; (i < object_data->number_files) && (i < FILESYSTEM_MAX_FILES_PER_DIR); i++) {
+            dir->ids[dir->count] = initrd_node(fs_node->filesystem_obj, i)->id;
             dir->count += 1;
         }
     } else {
@@ -205,6 +424,11 @@ void initrd_list_directory(struct filesystem_node* fs_node, struct filesystem_di
 }
 
 struct object* initrd_attach(struct object* partition_object, uint32_t lba) {
+    return initrd_attach_image(partition_object, lba, 0, 0);
+}
+
+struct object* initrd_attach_image(struct object* partition_object, uint32_t lba, const uint8_t* image,
+                                   uint64_t image_size) {
     ASSERT_NOT_NULL(partition_object);
     ASSERT(1 == blockutil_is_block_object(partition_object));
 
@@ -230,14 +454,19 @@ struct object* initrd_attach(struct object* partition_object, uint32_t lba) {
     api->write = &initrd_write;
     api->read = &initrd_read;
     api->list = &initrd_list_directory;
+    api->map = &initrd_map;
+    // an image in memory is its own page cache
+    api->cached = (0 == image);
     objectinstance->api = api;
     /*
      * device data
      */
     struct initrd_objectdata* object_data = (struct initrd_objectdata*)kmalloc(sizeof(struct initrd_objectdata));
-    object_data->root_node = 0;
+    memzero((uint8_t*)object_data, sizeof(struct initrd_objectdata));
     object_data->lba = lba;
     object_data->partition_object = partition_object;
+    object_data->image = image;
+    object_data->image_size = (0 != image) ? image_size : 0;
     object_data->filesystem_nodes = filesystem_node_map_new();
     objectinstance->object_data = object_data;
     /*
@@ -253,9 +482,7 @@ struct object* initrd_attach(struct object* partition_object, uint32_t lba) {
         */
         return objectinstance;
     } else {
-        filesystem_node_map_clear(object_data->filesystem_nodes);
         filesystem_node_map_delete(object_data->filesystem_nodes);
-        kfree(object_data->root_node);
         kfree(object_data);
         kfree(api);
         kfree(objectinstance);
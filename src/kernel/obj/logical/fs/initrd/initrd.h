@@ -15,13 +15,71 @@
 #include <types.h>
 
 struct object;
+struct filesystem_node;
 
 #define INITRD_NAME_SIZE 64
-#define INITRD_MAX_FILES 64
+#define INITRD_MAX_FILES 64  // version 1 only
+
+/*
+ * version 1 is a table of INITRD_MAX_FILES headers, then the files
+ */
+#define INITRD_FILE_MAGIC 0xBF
+
+struct initrd_file_header {
+    uint8_t magic;  // INITRD_FILE_MAGIC
+    uint8_t name[INITRD_NAME_SIZE];
+    uint32_t offset;  // byte count from start of initrd
+    uint32_t length;  // byte length
+};
+
+struct initrd_header {
+    uint32_t number_files;
+    struct initrd_file_header headers[INITRD_MAX_FILES];
+};
+
+/*
+ * version 2 is a header, an index of any number of entries sorted by name, then the files.  a compressed file is
+ * a table of chunk offsets, then the chunks, each of which is INITRD_CHUNK_SIZE bytes when decoded, but the last.
+ * a chunk as long as it decodes to is stored as it is
+ */
+#define INITRD_MAGIC "CSINITRD"
+#define INITRD_VERSION 2
+#define INITRD_CHUNK_SIZE (64 * 1024)
+#define INITRD_COMPRESSION_NONE 0
+#define INITRD_COMPRESSION_LZ4 1
+#define INITRD_PAGE_SIZE 4096  // files stored as they are start on one of these, and are zero padded to the next
+
+struct initrd2_header {
+    uint8_t magic[8];  // INITRD_MAGIC
+    uint32_t version;  // INITRD_VERSION
+    uint32_t entry_size;
+    uint64_t number_files;
+    uint64_t index_offset;  // byte count from start of initrd
+    uint64_t image_size;
+    uint8_t reserved[24];
+} __attribute__((packed));
+
+struct initrd2_entry {
+    uint8_t name[INITRD_NAME_SIZE];
+    uint64_t offset;         // byte count from start of initrd
+    uint64_t length;         // byte length, decoded
+    uint64_t stored_length;  // byte length in the initrd
+    uint32_t compression;    // INITRD_COMPRESSION_NONE | INITRD_COMPRESSION_LZ4
+    uint32_t reserved;
+} __attribute__((packed));
 
 struct object* initrd_attach(struct object* partition_object, uint32_t lba);
+/*
+ * the same, for an image the boot loader has already read into memory, which reads come from instead of the disk
+ */
+struct object* initrd_attach_image(struct object* partition_object, uint32_t lba, const uint8_t* image,
+                                   uint64_t image_size);
 void initrd_detach(struct object* obj);
+/*
+ * a binary search of the index.  0 if there's no file called name
+ */
+struct filesystem_node* initrd_find_node_by_name(struct object* obj, const uint8_t* name);
 
 uint64_t initrd_lba();
 
-#endif
\ No newline at end of file
+#endif
@@ -7,7 +7,7 @@
 
 #include <obj/logical/fs/node_util.h>
 #include <sys/debug/assert.h>
-#include <sys/kmalloc/kmalloc.h>
+#include <sys/kmalloc/kpool.h>
 #include <sys/string/mem.h>
 #include <sys/string/string.h>
 
@@ -15,12 +15,14 @@ struct object;
 
 uint64_t next_filesystem_node_id = 0x80;
 
+kpool filesystem_node_pool = KPOOL_INIT("filesystem_node", struct filesystem_node, NULL);
+
 struct filesystem_node* filesystem_node_new(enum filesystem_node_type type, struct object* obj, const uint8_t* name,
                                             uint64_t size, void* node_data, uint64_t parent) {
 
     ASSERT_NOT_NULL(obj);
     ASSERT_NOT_NULL(name);
-    struct filesystem_node* ret = (struct filesystem_node*)kmalloc(sizeof(struct filesystem_node));
+    struct filesystem_node* ret = (struct filesystem_node*)kpool_alloc(&filesystem_node_pool);
     memzero((uint8_t*)ret, sizeof(struct filesystem_node));
     ret->type = type;
     ret->filesystem_obj = obj;
@@ -32,3 +34,8 @@ struct filesystem_node* filesystem_node_new(enum filesystem_node_type type, stru
     ret->size = size;
     return ret;
 }
+
+void filesystem_node_delete(struct filesystem_node* node) {
+    ASSERT_NOT_NULL(node);
+    kpool_free(&filesystem_node_pool, node);
+}
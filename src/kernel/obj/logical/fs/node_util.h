@@ -15,5 +15,6 @@ struct object;
 
 struct filesystem_node* filesystem_node_new(enum filesystem_node_type type, struct object*, const uint8_t* name,
                                             uint64_t size, void* node_data, uint64_t parent);
+void filesystem_node_delete(struct filesystem_node* node);
 
 #endif
\ No newline at end of file
@@ -19,6 +19,7 @@
 #include <sys/obj/objecttypes/objecttypes.h>
 #include <sys/panic/panic.h>
 #include <sys/string/mem.h>
+#include <sys/string/string.h>
 #include <types.h>
 
 /*
@@ -56,7 +57,7 @@ uint8_t objfs_uninit(struct object* obj) {
     filesystem_node_map_clear(object_data->filesystem_nodes);
     filesystem_node_map_delete(object_data->filesystem_nodes);
     kfree(obj->api);
-    kfree(object_data->root_node);
+    filesystem_node_delete(object_data->root_node);
     kfree(object_data);
     return 1;
 }
@@ -68,28 +69,60 @@ struct filesystem_node* objfs_get_root_node(struct object* filesystem_obj) {
     return object_data->root_node;
 }
 
-uint32_t objfs_read(struct filesystem_node* fs_node, uint8_t* data, uint32_t data_size) {
+/*
+* an object's node reads as its description, and a newline
+*/
+uint64_t objfs_node_size(struct object* obj) {
+    return strlen(obj->description) + 1;
+}
+
+uint32_t objfs_read(struct filesystem_node* fs_node, uint64_t offset, uint8_t* data, uint32_t data_size) {
     ASSERT_NOT_NULL(fs_node);
     ASSERT_NOT_NULL(fs_node->filesystem_obj);
     ASSERT_NOT_NULL(fs_node->filesystem_obj->object_data);
     ASSERT_NOT_NULL(data);
     ASSERT_NOT_NULL(data_size);
-    // read from node. we cant read from the root node, but we can find underlying file and folder nodes
-    PANIC("not implemented");
-
-    return 0;
+    struct objfs_objectdata* object_data = (struct objfs_objectdata*)fs_node->filesystem_obj->object_data;
+    if (fs_node == object_data->root_node) {
+        return 0;
+    }
+    // the object may have gone since the node was made
+    struct object* obj = objectmgr_find_object_by_handle((uint64_t)fs_node->node_data);
+    if (0 == obj) {
+        return 0;
+    }
+    uint64_t size = objfs_node_size(obj);
+    fs_node->size = size;
+    if (offset >= size) {
+        return 0;
+    }
+    if (data_size > size - offset) {
+        data_size = size - offset;
+    }
+    uint32_t copied = 0;
+    uint64_t description_length = size - 1;
+    if (offset < description_length) {
+        copied = description_length - offset;
+        if (copied > data_size) {
+            copied = data_size;
+        }
+        memcpy(data, &(obj->description[offset]), copied);
+    }
+    if (copied < data_size) {
+        data[copied] = '\n';
+        copied++;
+    }
+    return copied;
 }
 
-uint32_t objfs_write(struct filesystem_node* fs_node, const uint8_t* data, uint32_t data_size) {
+uint32_t objfs_write(struct filesystem_node* fs_node, uint64_t offset, const uint8_t* data, uint32_t data_size) {
     ASSERT_NOT_NULL(fs_node);
     ASSERT_NOT_NULL(fs_node->filesystem_obj);
     ASSERT_NOT_NULL(fs_node->filesystem_obj->object_data);
 
     ASSERT_NOT_NULL(data);
     ASSERT_NOT_NULL(data_size);
-    // write to node. we cant write to the root node, but we can find underlying file and folder nodes
-    PANIC("not implemented");
-
+    // objects can't be written through the filesystem
     return 0;
 }
 
@@ -142,8 +175,9 @@ void objfs_list_directory(struct filesystem_node* fs_node, struct filesystem_dir
                     uint64_t node_id = filesystem_node_map_find_name(object_data->filesystem_nodes, obj->name);
                     if (0 == node_id) {
                         // object_data is the obhect handle
-                        struct filesystem_node* node = filesystem_node_new(file, fs_node->filesystem_obj, obj->name, 0,
-                                                                           (void*)obj->handle, fs_node->id);
+                        struct filesystem_node* node =
+                            filesystem_node_new(file, fs_node->filesystem_obj, obj->name, objfs_node_size(obj),
+                                                (void*)obj->handle, fs_node->id);
                         filesystem_node_map_insert(object_data->filesystem_nodes, node);
                         //    kprintf("new node %llu\n", node->id);
                         node_id = node->id;
@@ -205,7 +239,7 @@ struct object* objfs_attach() {
     } else {
         filesystem_node_map_clear(object_data->filesystem_nodes);
         filesystem_node_map_delete(object_data->filesystem_nodes);
-        kfree(object_data->root_node);
+        filesystem_node_delete(object_data->root_node);
         kfree(object_data);
         kfree(api);
         kfree(objectinstance);
@@ -6,7 +6,10 @@
 // ****************************************************************
 
 #include <obj/logical/fs/block_util.h>
+#include <obj/logical/fs/filesystem_node_map.h>
+#include <obj/logical/fs/node_util.h>
 #include <obj/logical/fs/sfs/sfs.h>
+#include <obj/logical/fs/sfs/sfs_block.h>
 #include <sys/debug/assert.h>
 #include <sys/kmalloc/kmalloc.h>
 #include <sys/kprintf/kprintf.h>
@@ -15,108 +18,55 @@
 #include <sys/obj/objectmgr/objectmgr.h>
 #include <sys/obj/objecttype/objectype.h>
 #include <sys/string/mem.h>
+#include <sys/string/string.h>
 #include <types.h>
 
-#define SFS_VOLUME_IDENTIFIER 0x01
-#define SFS_STARTING_MARKER 0x02
-#define SFS_UNUSED_ENTRY 0x10
-#define SFS_DIRECTORY_ENTRY 0x11
-#define SFS_FILE_ENTRY 0x12
-#define SFS_UNUSABLE_ENTRY 0x18
-#define SFS_DELETED_DIRECTORY_ENTRY 0x19
-#define SFS_DELETED_FILE_ENTRY 0x1A
-#define SFS_CONTINUATION_ENTRY 0x20
-
-struct sfs_superblock {
-    uint8_t reserved1[11];
-    uint8_t reserved2[21];
-    uint8_t reserved3[372];
-    uint64_t timestamp;
-    uint64_t dataarea_size_blocks;
-    uint64_t indexarea_size_bytes;
-    uint8_t magic[3];
-    uint8_t version;
-    uint64_t total_blocks;
-    uint32_t reserved_blocks;
-    uint8_t block_size;
-    uint8_t checksum;
-    uint8_t reserved4[64];
-    uint8_t reserved5[2];
-} __attribute__((packed));
-
-struct sfs_volume_identifier {
-    uint8_t entry_type;
-    uint8_t reserved[3];
-    uint64_t timestamp;
-    uint8_t name[52];
-} __attribute__((packed));
-
-struct sfs_starting_marker {
-    uint8_t entry_type;
-    uint8_t reserved[63];
-} __attribute__((packed));
-
-struct sfs_unused_entry {
-    uint8_t entry_type;
-    uint8_t reserved[63];
-} __attribute__((packed));
-
-struct sfs_directory_entry {
-    uint8_t entry_type;
-    uint8_t number_continuations;
-    uint64_t timestamp;
-    uint8_t reserved[54];
-} __attribute__((packed));
-
-struct sfs_file_entry {
-    uint8_t entry_type;
-    uint8_t number_continuations;
-    uint64_t timestamp;
-    uint64_t start_block;
-    uint64_t end_block;
-    uint64_t file_length;
-    uint8_t name[30];
-} __attribute__((packed));
-
-struct sfs_unusable_entry {
-    uint8_t entry_type;
-    uint8_t reserved1[9];
-    uint64_t start_block;
-    uint64_t end_block;
-    uint8_t reserved2[38];
-} __attribute__((packed));
-
-struct sfs_deleted_directory_entry {
-    uint8_t entry_type;
-    uint8_t number_continuations;
-    uint64_t timestamp;
-    uint8_t name[54];
-} __attribute__((packed));
-
-struct sfs_deleted_file_entry {
-    uint8_t entry_type;
-    uint8_t number_continuations;
-    uint64_t timestamp;
-    uint64_t start_block;
-    uint64_t end_block;
-    uint64_t file_length;
-    uint8_t name[30];
-} __attribute__((packed));
+/*
+ * the filesystem_node field "node_data" is a struct sfs_node
+ */
 
-struct sfs_continuation_entry {
-    uint8_t name[64];
-} __attribute__((packed));
+#define SFS_INDEX_BUCKETS 256
+
+/*
+ * a file or folder in the index, read at attach.  a file's data is contiguous, so a read is a single transfer
+ */
+struct sfs_node {
+    uint8_t* path;  // full path, the key
+    struct filesystem_node* fs_node;
+    uint64_t start_block;
+    struct sfs_node* next;      // in the bucket
+    struct sfs_node* children;  // of a folder
+    struct sfs_node* sibling;
+};
 
 struct sfs_objectdata {
     struct object* partition_object;
-} __attribute__((packed));
+    struct sfs_superblock superblock;
+    uint64_t block_size;  // bytes
+    struct sfs_node* buckets[SFS_INDEX_BUCKETS];
+    struct sfs_node root;
+    struct filesystem_node_map* filesystem_nodes;
+};
+
+/*
+ * the bytes from magic to checksum add up to zero
+ */
+uint8_t sfs_checksum(struct sfs_superblock* superblock) {
+    uint8_t* bytes = (uint8_t*)superblock;
+    uint8_t sum = 0;
+    for (uint32_t i = 0x1AC; i < 0x1BE; i++) {
+        sum += bytes[i];
+    }
+    return sum;
+}
 
 /*
  * check if valid superblock
  */
 bool sfs_is_valid_superblock(struct sfs_superblock* superblock) {
     ASSERT_NOT_NULL(superblock);
-    if ((superblock->magic[0] == 0x53) && (superblock->magic[1] == 0x46) && (superblock->magic[2] == 0x53)) {
+    if ((superblock->magic[0] == 0x53) && (superblock->magic[1] == 0x46) && (superblock->magic[2] == 0x53) &&
+        (0 == sfs_checksum(superblock))) {
         return true;
     }
     return false;
@@ -127,32 +77,271 @@ void sfs_read_superblock(struct object* obj, struct sfs_superblock* superblock)
     blockutil_read(obj, (uint8_t*)superblock, sizeof(struct sfs_superblock), 0, 0);
 }
 
-void sfs_format(struct object* obj) {
-    ASSERT_NOT_NULL(obj);
-    ASSERT_NOT_NULL(obj->object_data);
-    struct sfs_objectdata* object_data = (struct sfs_objectdata*)obj->object_data;
+/*
+ * format.  an empty index area holds the starting marker and the volume identifier
+ */
+void sfs_format(struct object* partition_object) {
+    ASSERT_NOT_NULL(partition_object);
 
     // device parameters
-    //    uint64_t total_size = blockutil_get_total_size(object_data->block_device);
-    uint32_t sector_size = blockutil_get_sector_size(object_data->partition_object);
-    uint32_t total_sectors = blockutil_get_sector_count(object_data->partition_object);
+    uint32_t sector_size = blockutil_get_sector_size(partition_object);
+    uint32_t total_sectors = blockutil_get_sector_count(partition_object);
+    ASSERT(sector_size >= 512);
 
     // create a superblock struct
     struct sfs_superblock superblock;
     memset((uint8_t*)&superblock, 0, sizeof(struct sfs_superblock));
-    superblock.timestamp = 0;                             // later
-    superblock.dataarea_size_blocks = total_sectors - 2;  // 1 for superblock and 1 for index
-    superblock.indexarea_size_bytes = sector_size;        // 1 sector
-    superblock.reserved_blocks = 1;                       // 1, for the superblock
+    superblock.timestamp = 0;  // later
+    superblock.dataarea_size_blocks = 0;
+    superblock.indexarea_size_bytes = 2 * SFS_ENTRY_SIZE;
+    superblock.reserved_blocks = 1;  // 1, for the superblock
     superblock.total_blocks = total_sectors;
     superblock.version = 0x10;  // 1.0
     superblock.magic[0] = 0x53;
     superblock.magic[1] = 0x46;
     superblock.magic[2] = 0x53;
-    superblock.block_size = (sector_size / 512) + 1;
+    superblock.block_size = 2;  // 512 bytes
+    while ((uint32_t)(1 << (superblock.block_size + 7)) < sector_size) {
+        superblock.block_size += 1;
+    }
+    superblock.checksum = -sfs_checksum(&superblock);
+
+    // index area, at the end of the volume
+    uint8_t index[2 * SFS_ENTRY_SIZE];
+    memzero(index, 2 * SFS_ENTRY_SIZE);
+    ((struct sfs_starting_marker*)index)->entry_type = SFS_STARTING_MARKER;
+    ((struct sfs_volume_identifier*)&(index[SFS_ENTRY_SIZE]))->entry_type = SFS_VOLUME_IDENTIFIER;
+    uint64_t index_start = ((uint64_t)total_sectors * sector_size) - (2 * SFS_ENTRY_SIZE);
+    blockutil_update(partition_object, index, 2 * SFS_ENTRY_SIZE, index_start / sector_size,
+                     index_start % sector_size);
 
     // write superblock
-    blockutil_write(object_data->partition_object, (uint8_t*)&superblock, sizeof(struct sfs_superblock), 0, 0);
+    blockutil_update(partition_object, (uint8_t*)&superblock, sizeof(struct sfs_superblock), 0, 0);
+}
+
+/*
+ * FNV-1a over the first 'length' bytes of path
+ */
+uint32_t sfs_hash(const uint8_t* path, uint32_t length) {
+    uint64_t hash = 0xCBF29CE484222325;
+    for (uint32_t i = 0; i < length; i++) {
+        hash = (hash ^ path[i]) * 0x100000001B3;
+    }
+    return (hash ^ (hash >> 32)) % SFS_INDEX_BUCKETS;
+}
+
+struct sfs_node* sfs_index_find(struct sfs_objectdata* object_data, const uint8_t* path, uint32_t length) {
+    if (0 == length) {
+        return &(object_data->root);
+    }
+    struct sfs_node* node = object_data->buckets[sfs_hash(path, length)];
+    while (0 != node) {
+        if ((0 == strncmp(node->path, path, length)) && (0 == node->path[length])) {
+            return node;
+        }
+        node = node->next;
+    }
+    return 0;
+}
+
+/*
+ * add the first 'length' bytes of path to the index, and any folders above it that aren't there yet.  0 if it
+ * can't be added
+ */
+struct sfs_node* sfs_index_add(struct object* obj, const uint8_t* path, uint32_t length,
+                               enum filesystem_node_type type, uint64_t size, uint64_t start_block) {
+    struct sfs_objectdata* object_data = (struct sfs_objectdata*)obj->object_data;
+    struct sfs_node* ret = sfs_index_find(object_data, path, length);
+    if (0 != ret) {
+        // a folder can be named more than once; a file can't
+        return ((folder == type) && (folder == ret->fs_node->type)) ? ret : 0;
+    }
+    uint32_t name = length;
+    while ((name > 0) && (FILESYSTEM_NAME_DELIMITER[0] != path[name - 1])) {
+        name--;
+    }
+    if ((name == length) || ((length - name) >= FILESYSTEM_MAX_NAME)) {
+        return 0;
+    }
+    struct sfs_node* parent = (0 == name) ? &(object_data->root) : sfs_index_add(obj, path, name - 1, folder, 0, 0);
+    if ((0 == parent) || (folder != parent->fs_node->type)) {
+        return 0;
+    }
+    ret = (struct sfs_node*)kmalloc(sizeof(struct sfs_node));
+    memzero((uint8_t*)ret, sizeof(struct sfs_node));
+    ret->path = (uint8_t*)kmalloc(length + 1);
+    memcpy(ret->path, (uint8_t*)path, length);
+    ret->path[length] = 0;
+    ret->start_block = start_block;
+    ret->fs_node = filesystem_node_new(type, obj, &(ret->path[name]), size, ret, parent->fs_node->id);
+    uint32_t bucket = sfs_hash(path, length);
+    ret->next = object_data->buckets[bucket];
+    object_data->buckets[bucket] = ret;
+    ret->sibling = parent->children;
+    parent->children = ret;
+    filesystem_node_map_insert(object_data->filesystem_nodes, ret->fs_node);
+    return ret;
+}
+
+/*
+ * a file or folder entry, and the continuation entries after it
+ */
+void sfs_index_add_entry(struct object* obj, uint8_t* entry, uint32_t entries) {
+    struct sfs_objectdata* object_data = (struct sfs_objectdata*)obj->object_data;
+    uint8_t* name = &(entry[SFS_ENTRY_SIZE - SFS_DIRECTORY_NAME_SIZE]);
+    uint32_t name_size = SFS_DIRECTORY_NAME_SIZE + (entries * SFS_ENTRY_SIZE);
+    if (SFS_FILE_ENTRY == entry[0]) {
+        name = &(entry[SFS_ENTRY_SIZE - SFS_FILE_NAME_SIZE]);
+        name_size = SFS_FILE_NAME_SIZE + (entries * SFS_ENTRY_SIZE);
+    }
+    uint32_t length = 0;
+    while ((length < name_size) && (0 != name[length])) {
+        length++;
+    }
+    if ((length == name_size) || (length >= FILESYSTEM_MAX_PATH)) {
+        // no terminator
+        return;
+    }
+    if (SFS_DIRECTORY_ENTRY == entry[0]) {
+        sfs_index_add(obj, name, length, folder, 0, 0);
+        return;
+    }
+    struct sfs_file_entry* file_entry = (struct sfs_file_entry*)entry;
+    uint64_t start = file_entry->start_block;
+    uint64_t size = file_entry->file_length;
+    uint64_t blocks = (size + object_data->block_size - 1) / object_data->block_size;
+    if ((blocks > 0) && ((start < object_data->superblock.reserved_blocks) ||
+                         ((start + blocks) > object_data->superblock.total_blocks) ||
+                         ((start + blocks) > (file_entry->end_block + 1)))) {
+        kprintf("SFS file %s is outside the volume\n", name);
+        return;
+    }
+    sfs_index_add(obj, name, length, file, size, start);
+}
+
+/*
+ * read the index area, in one go, and index every file and folder by path
+ */
+bool sfs_index_load(struct object* obj) {
+    struct sfs_objectdata* object_data = (struct sfs_objectdata*)obj->object_data;
+    uint32_t sector_size = blockutil_get_sector_size(object_data->partition_object);
+    uint64_t volume_size = object_data->superblock.total_blocks * object_data->block_size;
+    uint64_t index_size = object_data->superblock.indexarea_size_bytes;
+    if ((index_size < (2 * SFS_ENTRY_SIZE)) || (0 != (index_size % SFS_ENTRY_SIZE)) ||
+        (index_size > (volume_size - (object_data->superblock.reserved_blocks * object_data->block_size)))) {
+        return false;
+    }
+    uint8_t* index = kmalloc(index_size);
+    uint64_t index_start = volume_size - index_size;
+    blockutil_read(object_data->partition_object, index, index_size, index_start / sector_size,
+                   index_start % sector_size);
+    uint32_t entries = index_size / SFS_ENTRY_SIZE;
+    if ((SFS_STARTING_MARKER != index[0]) ||
+        (SFS_VOLUME_IDENTIFIER != index[(entries - 1) * SFS_ENTRY_SIZE])) {
+        kfree(index);
+        return false;
+    }
+    for (uint32_t i = 1; i < (entries - 1); i++) {
+        uint8_t* entry = &(index[i * SFS_ENTRY_SIZE]);
+        switch (entry[0]) {
+            case SFS_DIRECTORY_ENTRY:
+            case SFS_FILE_ENTRY:
+            case SFS_DELETED_DIRECTORY_ENTRY:
+            case SFS_DELETED_FILE_ENTRY: {
+                // the continuation entries are part of this one
+                uint32_t continuations = entry[1];
+                if ((i + continuations) >= (entries - 1)) {
+                    break;
+                }
+                if ((SFS_DIRECTORY_ENTRY == entry[0]) || (SFS_FILE_ENTRY == entry[0])) {
+                    sfs_index_add_entry(obj, entry, continuations);
+                }
+                i += continuations;
+                break;
+            }
+            default:
+                break;
+        }
+    }
+    kfree(index);
+    return true;
+}
+
+void sfs_index_delete(struct sfs_objectdata* object_data) {
+    for (uint32_t i = 0; i < SFS_INDEX_BUCKETS; i++) {
+        struct sfs_node* node = object_data->buckets[i];
+        while (0 != node) {
+            struct sfs_node* next = node->next;
+            filesystem_node_delete(node->fs_node);
+            kfree(node->path);
+            kfree(node);
+            node = next;
+        }
+        object_data->buckets[i] = 0;
+    }
+    filesystem_node_map_delete(object_data->filesystem_nodes);
+    filesystem_node_delete(object_data->root.fs_node);
+}
+
+/*
+ * the file's blocks are contiguous, so this is a single read, of whole sectors but for the ends
+ */
+uint32_t sfs_read(struct filesystem_node* fs_node, uint64_t offset, uint8_t* data, uint32_t data_size) {
+    ASSERT_NOT_NULL(fs_node);
+    ASSERT_NOT_NULL(fs_node->filesystem_obj);
+    ASSERT_NOT_NULL(fs_node->filesystem_obj->object_data);
+    ASSERT_NOT_NULL(data);
+    if ((file != fs_node->type) || (offset >= fs_node->size)) {
+        return 0;
+    }
+    if (data_size > (fs_node->size - offset)) {
+        data_size = fs_node->size - offset;
+    }
+    struct sfs_objectdata* object_data = (struct sfs_objectdata*)fs_node->filesystem_obj->object_data;
+    struct sfs_node* node = (struct sfs_node*)fs_node->node_data;
+    uint32_t sector_size = blockutil_get_sector_size(object_data->partition_object);
+    uint64_t start = (node->start_block * object_data->block_size) + offset;
+    return blockutil_read(object_data->partition_object, data, data_size, start / sector_size, start % sector_size);
+}
+
+struct filesystem_node* sfs_get_root_node(struct object* obj) {
+    ASSERT_NOT_NULL(obj);
+    ASSERT_NOT_NULL(obj->object_data);
+    struct sfs_objectdata* object_data = (struct sfs_objectdata*)obj->object_data;
+    return object_data->root.fs_node;
+}
+
+struct filesystem_node* sfs_find_node_by_id(struct filesystem_node* fs_node, uint64_t id) {
+    ASSERT_NOT_NULL(fs_node);
+    ASSERT_NOT_NULL(fs_node->filesystem_obj);
+    ASSERT_NOT_NULL(fs_node->filesystem_obj->object_data);
+    struct sfs_objectdata* object_data = (struct sfs_objectdata*)fs_node->filesystem_obj->object_data;
+    return filesystem_node_map_find_id(object_data->filesystem_nodes, id);
+}
+
+void sfs_list_dir(struct filesystem_node* fs_node, struct filesystem_directory* dir) {
+    ASSERT_NOT_NULL(fs_node);
+    ASSERT_NOT_NULL(fs_node->node_data);
+    ASSERT_NOT_NULL(dir);
+    dir->count = 0;
+    struct sfs_node* node = ((struct sfs_node*)fs_node->node_data)->children;
+    while ((0 != node) && (dir->count < FILESYSTEM_MAX_FILES_PER_DIR)) {
+        dir->ids[dir->count] = node->fs_node->id;
+        dir->count += 1;
+        node = node->sibling;
+    }
+}
+
+struct filesystem_node* sfs_find_node_by_path(struct object* obj, const uint8_t* path) {
+    ASSERT_NOT_NULL(obj);
+    ASSERT_NOT_NULL(obj->object_data);
+    ASSERT_NOT_NULL(path);
+    struct sfs_objectdata* object_data = (struct sfs_objectdata*)obj->object_data;
+    struct sfs_node* node = sfs_index_find(object_data, path, strlen((uint8_t*)path));
+    if (0 != node) {
+        return node->fs_node;
+    }
+    return 0;
 }
 
 /*
@@ -162,6 +351,27 @@ uint8_t sfs_init(struct object* obj) {
     ASSERT_NOT_NULL(obj);
     ASSERT_NOT_NULL(obj->object_data);
     struct sfs_objectdata* object_data = (struct sfs_objectdata*)obj->object_data;
+    struct sfs_superblock* superblock = &(object_data->superblock);
+    sfs_read_superblock(object_data->partition_object, superblock);
+    uint32_t sector_size = blockutil_get_sector_size(object_data->partition_object);
+    if ((!sfs_is_valid_superblock(superblock)) || (superblock->block_size < 2) || (superblock->block_size > 24) ||
+        (0 == superblock->reserved_blocks)) {
+        // not SFS
+        return 0;
+    }
+    object_data->block_size = (uint64_t)1 << (superblock->block_size + 7);
+    if ((0 != (object_data->block_size % sector_size)) ||
+        ((superblock->total_blocks * object_data->block_size) >
+         blockutil_get_total_size(object_data->partition_object))) {
+        return 0;
+    }
+    object_data->filesystem_nodes = filesystem_node_map_new();
+    object_data->root.path = (uint8_t*)"";
+    object_data->root.fs_node = filesystem_node_new(folder, obj, obj->name, 0, &(object_data->root), 0);
+    if (!sfs_index_load(obj)) {
+        sfs_index_delete(object_data);
+        return 0;
+    }
     kprintf("Init %s on %s (%s)\n", obj->description, object_data->partition_object->name, obj->name);
     return 1;
 }
@@ -175,12 +385,16 @@ uint8_t sfs_uninit(struct object* obj) {
 
     struct sfs_objectdata* object_data = (struct sfs_objectdata*)obj->object_data;
     kprintf("Uninit %s on %s (%s)\n", obj->description, object_data->partition_object->name, obj->name);
+    sfs_index_delete(object_data);
     kfree(obj->api);
     kfree(obj->object_data);
     return 1;
 }
 
 struct object* sfs_attach(struct object* partition_object) {
+    ASSERT(sizeof(struct sfs_superblock) == 512);
+    ASSERT(sizeof(struct sfs_file_entry) == SFS_ENTRY_SIZE);
+    ASSERT(sizeof(struct sfs_directory_entry) == SFS_ENTRY_SIZE);
     ASSERT_NOT_NULL(partition_object);
     ASSERT(1 == blockutil_is_block_object(partition_object));
     /*
@@ -193,17 +407,22 @@ struct object* sfs_attach(struct object* partition_object) {
     objectinstance->objectype = OBJECT_TYPE_FILESYSTEM;
     objectmgr_set_object_description(objectinstance, "Simple File System");
     /*
-     * the device api
+     * the device api.  read-only
      */
     struct objectinterface_filesystem* api =
         (struct objectinterface_filesystem*)kmalloc(sizeof(struct objectinterface_filesystem));
     memzero((uint8_t*)api, sizeof(struct objectinterface_filesystem));
-    //  api->format = &sfs_format;
+    api->find_id = &sfs_find_node_by_id;
+    api->list = &sfs_list_dir;
+    api->read = &sfs_read;
+    api->root = &sfs_get_root_node;
+    api->cached = true;
     objectinstance->api = api;
     /*
      * device data
      */
     struct sfs_objectdata* object_data = (struct sfs_objectdata*)kmalloc(sizeof(struct sfs_objectdata));
+    memzero((uint8_t*)object_data, sizeof(struct sfs_objectdata));
     object_data->partition_object = partition_object;
     objectinstance->object_data = object_data;
 
@@ -240,4 +459,4 @@ void sfs_detach(struct object* obj) {
     * detach
     */
     objectmgr_detach_object(obj);
-}
\ No newline at end of file
+}
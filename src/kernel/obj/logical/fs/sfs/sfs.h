@@ -8,9 +8,23 @@
 #ifndef _SFS_H
 #define _SFS_H
 
+#include <types.h>
+
 struct object;
+struct filesystem_node;
 
+/*
+ * make an empty SFS on a block device.  anything on it is lost
+ */
+void sfs_format(struct object* partition_object);
+/*
+ * SFS is read-only
+ */
 struct object* sfs_attach(struct object* partition_object);
 void sfs_detach(struct object* obj);
+/*
+ * the node for a full path, like "dir/file", from the index.  0 if there isn't one
+ */
+struct filesystem_node* sfs_find_node_by_path(struct object* obj, const uint8_t* path);
 
-#endif
\ No newline at end of file
+#endif
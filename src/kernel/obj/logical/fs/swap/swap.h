@@ -8,6 +8,9 @@
 #ifndef _SWAP_H
 #define _SWAP_H
 
+// blank disk that the kernel pages out to
+#define SWAP_DISK "disk3"
+
 struct object;
 
 struct object* swap_attach(struct object* block_device);
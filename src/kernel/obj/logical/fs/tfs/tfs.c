@@ -6,10 +6,15 @@
 // ****************************************************************
 
 #include <obj/logical/fs/block_util.h>
+#include <obj/logical/fs/filesystem_node_map.h>
+#include <obj/logical/fs/node_util.h>
 #include <obj/logical/fs/tfs/tfs.h>
 #include <obj/logical/fs/tfs/tfs_block.h>
 #include <obj/logical/fs/tfs/tfs_dir.h>
 #include <obj/logical/fs/tfs/tfs_map.h>
+#include <sys/collection/arraylist/arraylist.h>
+#include <sys/collection/bitmap/bitmap.h>
+#include <sys/collection/tree/tree.h>
 #include <sys/debug/assert.h>
 #include <sys/kmalloc/kmalloc.h>
 #include <sys/kprintf/kprintf.h>
@@ -21,102 +26,536 @@
 #include <sys/string/string.h>
 #include <types.h>
 
+/*
+* the filesystem_node field "node_data" is a struct tfs_node, except on the root node
+*/
+
+// zeros are written this many bytes at a time
+#define TFS_ZERO_CHUNK (64 * 1024)
+
+/*
+ * a file growing by writes is given up to this many blocks more than it needs, as many as it already has, so files
+ * appended to a piece at a time, side by side, still get long extents.  what is unused goes back at sync
+ */
+#define TFS_PREALLOCATE_MAX 128
+
 struct tfs_objectdata {
     struct object* partition_object;
-} __attribute__((packed));
+    struct tfs_superblock_block superblock;
+    struct tfs_map map;
+    struct tfs_dir dir;
+    struct filesystem_node* root_node;
+    struct filesystem_node_map* filesystem_nodes;
+    struct arraylist* dirty;  // nodes whose file block is out of date
+};
 
 /*
- * format. I just guessed here.
+ * a file, with all its extents in memory.  the file block and allocation blocks are written at sync
  */
-void tfs_format(struct object* obj) {
-    ASSERT_NOT_NULL(obj);
-    ASSERT_NOT_NULL(obj->object_data);
-    struct tfs_objectdata* object_data = (struct tfs_objectdata*)obj->object_data;
+struct tfs_node {
+    uint64_t file_block;
+    struct tfs_extent* extents;
+    uint64_t extent_count;
+    uint64_t extent_capacity;
+    uint64_t* allocation_blocks;  // the chain holding the extents that don't fit in the file block
+    uint64_t allocation_count;
+    uint64_t blocks;  // in the extents
+    bool dirty;
+};
+
+void tfs_sync(struct object* obj);
+
+/*
+ * format
+ */
+void tfs_format(struct object* partition_object) {
+    ASSERT_NOT_NULL(partition_object);
+    ASSERT(TFS_BLOCK_SIZE == blockutil_get_sector_size(partition_object));
 
     /*
      * figure out how many map blocks we need
      */
-    uint32_t number_map_blocks = tfs_map_block_count(object_data->partition_object);
+    uint32_t number_map_blocks = tfs_map_block_count(partition_object);
     /*
      * create superblock
      */
     struct tfs_superblock_block superblock;
     memset((uint8_t*)&superblock, 0, sizeof(struct tfs_superblock_block));
     superblock.magic = TFS_MAGIC_SUPERBLOCK;
-    superblock.blocks_size = (uint64_t)blockutil_get_sector_size(object_data->partition_object);
-    superblock.blocks_count = (uint64_t)blockutil_get_sector_count(object_data->partition_object);
+    superblock.blocks_size = TFS_BLOCK_SIZE;
+    superblock.blocks_count = (uint64_t)blockutil_get_sector_count(partition_object);
     superblock.number_map_blocks = number_map_blocks;
-    superblock.root_dir = number_map_blocks + 1;  // sector one, since sector zero is the super-block
-    kprintf("blocks_count %llu\n", superblock.blocks_count);
-    kprintf("number_map_blocks %llu\n", superblock.number_map_blocks);
-    kprintf("root_dir %llu\n", superblock.root_dir);
+    superblock.root_dir = number_map_blocks + 1;  // after the superblock and the map blocks
+    ASSERT(superblock.blocks_count > (superblock.root_dir + 1));
     /*
-     * write superblock
+     * map blocks, with the superblock, the map blocks themselves and the root dir in use
      */
-    tfs_write_superblock(object_data->partition_object, &superblock);
-    /*
-     * create & write map blocks
-     */
-    for (uint32_t i = 0; i < number_map_blocks; i++) {
-        struct tfs_map_block map_block;
-        memset((uint8_t*)&map_block, 0, sizeof(struct tfs_map_block));
-        tfs_write_map_block(object_data->partition_object, &map_block, i + 1);
-        //    kprintf("map block: %llu\n",i+1);
-    }
+    struct tfs_map map;
+    tfs_map_new(&map, superblock.blocks_count, number_map_blocks);
+    tfs_map_set(&map, 0, superblock.root_dir + 1);
+    bitmap_set_range(map.dirty, 0, number_map_blocks);
+    tfs_map_sync(partition_object, &map);
+    tfs_map_delete(&map);
     /*
      * root dir block
      */
     struct tfs_dir_block root_dir_block;
     memset((uint8_t*)&root_dir_block, 0, sizeof(struct tfs_dir_block));
     root_dir_block.next = 0;
+    tfs_write_dir_block(partition_object, &root_dir_block, superblock.root_dir);
     /*
-     * write root dir
+     * write superblock last, so a volume is only TFS once it's all there
      */
-    tfs_write_dir_block(object_data->partition_object, &root_dir_block, superblock.root_dir);
-    kprintf("dir block: %llu\n", superblock.root_dir);
+    tfs_write_superblock(partition_object, &superblock);
+    kprintf("Formatted TFS on %s, %llu blocks\n", partition_object->name, superblock.blocks_count);
+}
+
+struct tfs_node* tfs_node_new(uint64_t file_block) {
+    struct tfs_node* ret = (struct tfs_node*)kmalloc(sizeof(struct tfs_node));
+    memzero((uint8_t*)ret, sizeof(struct tfs_node));
+    ret->file_block = file_block;
+    return ret;
+}
+
+void tfs_node_delete_iterator(void* value) {
+    if (0 != value) {
+        struct filesystem_node* fs_node = (struct filesystem_node*)value;
+        struct tfs_node* node = (struct tfs_node*)fs_node->node_data;
+        if (0 != node->extents) {
+            kfree(node->extents);
+        }
+        if (0 != node->allocation_blocks) {
+            kfree(node->allocation_blocks);
+        }
+        kfree(node);
+    }
+}
+
+/*
+ * krealloc, which doesn't take a null pointer
+ */
+void* tfs_grow(void* ptr, uint64_t size) {
+    if (0 == ptr) {
+        return kmalloc(size);
+    }
+    return krealloc(ptr, size);
 }
 
-bool tfs_dir_list_iterator(struct tfs_file_block* file_block) {
-    ASSERT_NOT_NULL(file_block);
-    kprintf("tfs file at block %s\n", file_block->name);
+void tfs_node_add_extent(struct tfs_node* node, uint64_t start, uint64_t count) {
+    // on the end of the last one, if it can be
+    if (node->extent_count > 0) {
+        struct tfs_extent* last = &(node->extents[node->extent_count - 1]);
+        if ((last->start + last->count) == start) {
+            last->count += count;
+            node->blocks += count;
+            return;
+        }
+    }
+    if (node->extent_count == node->extent_capacity) {
+        node->extent_capacity = (0 == node->extent_capacity) ? TFS_EXTENTS_PER_FILE_BLOCK : node->extent_capacity * 2;
+        node->extents = tfs_grow(node->extents, node->extent_capacity * sizeof(struct tfs_extent));
+    }
+    node->extents[node->extent_count].start = start;
+    node->extents[node->extent_count].count = count;
+    node->extent_count += 1;
+    node->blocks += count;
+}
+
+/*
+ * read a file block, and its allocation blocks
+ */
+struct filesystem_node* tfs_node_load(struct object* obj, uint64_t file_block_lba) {
+    struct tfs_objectdata* object_data = (struct tfs_objectdata*)obj->object_data;
+    struct tfs_file_block file_block;
+    tfs_read_file_block(object_data->partition_object, &file_block, file_block_lba);
+    file_block.name[TFS_FILENAME_SIZE - 1] = 0;
+    struct tfs_node* node = tfs_node_new(file_block_lba);
+    uint64_t extent_count = file_block.extent_count;
+    for (uint64_t i = 0; (i < extent_count) && (i < TFS_EXTENTS_PER_FILE_BLOCK); i++) {
+        tfs_node_add_extent(node, file_block.extents[i].start, file_block.extents[i].count);
+    }
+    uint64_t remaining = (extent_count > TFS_EXTENTS_PER_FILE_BLOCK) ? extent_count - TFS_EXTENTS_PER_FILE_BLOCK : 0;
+    uint64_t next = file_block.allocation_map;
+    while ((remaining > 0) && (0 != next)) {
+        node->allocation_blocks = tfs_grow(node->allocation_blocks, (node->allocation_count + 1) * sizeof(uint64_t));
+        node->allocation_blocks[node->allocation_count] = next;
+        node->allocation_count += 1;
+        struct tfs_file_allocation_block allocation_block;
+        tfs_read_allocation_block(object_data->partition_object, &allocation_block, next);
+        for (uint64_t i = 0; (i < remaining) && (i < TFS_EXTENTS_PER_ALLOCATION_BLOCK); i++) {
+            tfs_node_add_extent(node, allocation_block.extents[i].start, allocation_block.extents[i].count);
+        }
+        remaining -= (remaining < TFS_EXTENTS_PER_ALLOCATION_BLOCK) ? remaining : TFS_EXTENTS_PER_ALLOCATION_BLOCK;
+        next = allocation_block.allocation_map;
+    }
+    return filesystem_node_new(file, obj, file_block.name, file_block.size, node, object_data->root_node->id);
+}
+
+uint64_t tfs_blocks_for(uint64_t size) {
+    return (size + TFS_BLOCK_SIZE - 1) / TFS_BLOCK_SIZE;
+}
+
+/*
+ * give back the blocks past the first 'blocks'
+ */
+void tfs_node_shrink(struct tfs_objectdata* object_data, struct tfs_node* node, uint64_t blocks) {
+    while (node->blocks > blocks) {
+        struct tfs_extent* last = &(node->extents[node->extent_count - 1]);
+        uint64_t drop = node->blocks - blocks;
+        if (drop >= last->count) {
+            drop = last->count;
+            node->extent_count -= 1;
+        }
+        last->count -= drop;
+        tfs_map_release(&(object_data->map), last->start + last->count, drop);
+        node->blocks -= drop;
+    }
+}
+
+/*
+ * the allocation blocks it takes to hold extent_count extents
+ */
+uint64_t tfs_allocation_blocks_for(uint64_t extent_count) {
+    if (extent_count <= TFS_EXTENTS_PER_FILE_BLOCK) {
+        return 0;
+    }
+    return (extent_count - TFS_EXTENTS_PER_FILE_BLOCK + TFS_EXTENTS_PER_ALLOCATION_BLOCK - 1) /
+           TFS_EXTENTS_PER_ALLOCATION_BLOCK;
+}
+
+/*
+ * give a node the allocation blocks its extents need.  false if the disk fills first
+ */
+bool tfs_node_reserve_allocation_blocks(struct tfs_objectdata* object_data, struct tfs_node* node) {
+    uint64_t needed = tfs_allocation_blocks_for(node->extent_count);
+    while (node->allocation_count < needed) {
+        uint64_t lba = 0;
+        uint64_t near = (node->allocation_count > 0) ? node->allocation_blocks[node->allocation_count - 1] + 1
+                                                     : node->file_block + 1;
+        if (0 == tfs_map_allocate(&(object_data->map), near, 1, &lba)) {
+            return false;
+        }
+        node->allocation_blocks = tfs_grow(node->allocation_blocks, (node->allocation_count + 1) * sizeof(uint64_t));
+        node->allocation_blocks[node->allocation_count] = lba;
+        node->allocation_count += 1;
+    }
     return true;
 }
 
-struct fs_directory_listing* tfs_list_dir(struct object* obj) {
-    ASSERT_NOT_NULL(obj);
-    tfs_dir_iterate_files(obj, &tfs_dir_list_iterator);
-    return 0;
+/*
+ * write a file block, and as many allocation blocks as its extents need.  those were taken as the extents were, so
+ * a full disk can't stop a sync
+ */
+void tfs_node_store(struct tfs_objectdata* object_data, struct filesystem_node* fs_node) {
+    struct tfs_node* node = (struct tfs_node*)fs_node->node_data;
+    tfs_node_shrink(object_data, node, tfs_blocks_for(fs_node->size));
+    uint64_t needed = tfs_allocation_blocks_for(node->extent_count);
+    while (node->allocation_count > needed) {
+        node->allocation_count -= 1;
+        tfs_map_release(&(object_data->map), node->allocation_blocks[node->allocation_count], 1);
+    }
+    ASSERT(node->allocation_count == needed);
+
+    struct tfs_file_block file_block;
+    memzero((uint8_t*)&file_block, sizeof(struct tfs_file_block));
+    strncpy(file_block.name, fs_node->name, TFS_FILENAME_SIZE);
+    file_block.size = fs_node->size;
+    file_block.status = TFS_FILE_STATUS_USED;
+    file_block.extent_count = node->extent_count;
+    file_block.allocation_map = (needed > 0) ? node->allocation_blocks[0] : 0;
+    uint64_t e = 0;
+    for (; (e < node->extent_count) && (e < TFS_EXTENTS_PER_FILE_BLOCK); e++) {
+        file_block.extents[e].start = node->extents[e].start;
+        file_block.extents[e].count = node->extents[e].count;
+    }
+    tfs_write_file_block(object_data->partition_object, &file_block, node->file_block);
+    for (uint64_t a = 0; a < needed; a++) {
+        struct tfs_file_allocation_block allocation_block;
+        memzero((uint8_t*)&allocation_block, sizeof(struct tfs_file_allocation_block));
+        for (uint64_t i = 0; (e < node->extent_count) && (i < TFS_EXTENTS_PER_ALLOCATION_BLOCK); i++, e++) {
+            allocation_block.extents[i].start = node->extents[e].start;
+            allocation_block.extents[i].count = node->extents[e].count;
+        }
+        allocation_block.allocation_map = (a + 1 < needed) ? node->allocation_blocks[a + 1] : 0;
+        tfs_write_allocation_block(object_data->partition_object, &allocation_block, node->allocation_blocks[a]);
+    }
+    node->dirty = false;
 }
 
-void tfs_read(struct object* obj, const uint8_t* name, const uint8_t* data, uint32_t size) {
-    ASSERT_NOT_NULL(obj);
-    ASSERT_NOT_NULL(name);
+void tfs_node_mark_dirty(struct tfs_objectdata* object_data, struct filesystem_node* fs_node) {
+    struct tfs_node* node = (struct tfs_node*)fs_node->node_data;
+    if (!node->dirty) {
+        node->dirty = true;
+        arraylist_add(object_data->dirty, fs_node);
+    }
+}
+
+/*
+ * give a node at least 'blocks' blocks, and up to 'extra' more, continuing its last extent where the map allows.
+ * a new extent comes with the allocation block to record it in, if it needs one.  false if the disk fills first
+ */
+bool tfs_node_extend(struct tfs_objectdata* object_data, struct tfs_node* node, uint64_t blocks, uint64_t extra) {
+    while (node->blocks < blocks) {
+        uint64_t near = node->file_block + 1;
+        if (node->extent_count > 0) {
+            near = node->extents[node->extent_count - 1].start + node->extents[node->extent_count - 1].count;
+        }
+        uint64_t start = 0;
+        uint64_t count = tfs_map_allocate(&(object_data->map), near, blocks + extra - node->blocks, &start);
+        if (0 == count) {
+            return false;
+        }
+        uint64_t extents = node->extent_count;
+        tfs_node_add_extent(node, start, count);
+        if ((node->extent_count > extents) && !tfs_node_reserve_allocation_blocks(object_data, node)) {
+            // nowhere to record the extent, so it goes back
+            tfs_node_shrink(object_data, node, node->blocks - count);
+            return false;
+        }
+    }
+    return true;
+}
+
+/*
+ * move bytes between data and a node's blocks, starting 'offset' bytes in.  each extent is a single transfer
+ */
+void tfs_node_transfer(struct tfs_objectdata* object_data, struct tfs_node* node, uint64_t offset, uint8_t* data,
+                       uint32_t data_size, bool write) {
+    uint64_t extent_offset = 0;  // blocks before extent e
+    uint64_t e = 0;
+    uint32_t done = 0;
+    while (done < data_size) {
+        uint64_t block = (offset + done) / TFS_BLOCK_SIZE;
+        while (block >= (extent_offset + node->extents[e].count)) {
+            extent_offset += node->extents[e].count;
+            e++;
+            ASSERT(e < node->extent_count);
+        }
+        uint64_t in_extent = ((extent_offset + node->extents[e].count) * TFS_BLOCK_SIZE) - (offset + done);
+        uint32_t count = data_size - done;
+        if (count > in_extent) {
+            count = in_extent;
+        }
+        uint64_t lba = node->extents[e].start + (block - extent_offset);
+        uint32_t start_byte = (offset + done) % TFS_BLOCK_SIZE;
+        if (write) {
+            blockutil_update(object_data->partition_object, &(data[done]), count, lba, start_byte);
+        } else {
+            blockutil_read(object_data->partition_object, &(data[done]), count, lba, start_byte);
+        }
+        done += count;
+    }
+}
+
+/*
+ * zero a node from 'from' to 'to', which its blocks already cover
+ */
+void tfs_node_zero(struct tfs_objectdata* object_data, struct tfs_node* node, uint64_t from, uint64_t to) {
+    if (from >= to) {
+        return;
+    }
+    uint32_t size = ((to - from) < TFS_ZERO_CHUNK) ? (to - from) : TFS_ZERO_CHUNK;
+    uint8_t* zeros = kmalloc(size);
+    memzero(zeros, size);
+    while (from < to) {
+        uint32_t count = ((to - from) < size) ? (to - from) : size;
+        tfs_node_transfer(object_data, node, from, zeros, count, true);
+        from += count;
+    }
+    kfree(zeros);
+}
+
+/*
+ * the bytes from the old size to the new one are zeroed.  on a short disk, the node grows as far as it can
+ */
+bool tfs_node_resize(struct tfs_objectdata* object_data, struct filesystem_node* fs_node, uint64_t size) {
+    struct tfs_node* node = (struct tfs_node*)fs_node->node_data;
+    bool ret = true;
+    if (size > fs_node->size) {
+        ret = tfs_node_extend(object_data, node, tfs_blocks_for(size), 0);
+        if (!ret) {
+            size = node->blocks * TFS_BLOCK_SIZE;
+        }
+        tfs_node_zero(object_data, node, fs_node->size, size);
+    } else {
+        tfs_node_shrink(object_data, node, tfs_blocks_for(size));
+    }
+    if (size != fs_node->size) {
+        fs_node->size = size;
+        tfs_node_mark_dirty(object_data, fs_node);
+    }
+    return ret;
+}
+
+uint32_t tfs_read(struct filesystem_node* fs_node, uint64_t offset, uint8_t* data, uint32_t data_size) {
+    ASSERT_NOT_NULL(fs_node);
+    ASSERT_NOT_NULL(fs_node->filesystem_obj);
+    ASSERT_NOT_NULL(fs_node->filesystem_obj->object_data);
     ASSERT_NOT_NULL(data);
-    ASSERT(strlen(name) < TFS_FILENAME_SIZE);
+    if ((file != fs_node->type) || (offset >= fs_node->size)) {
+        return 0;
+    }
+    if (data_size > (fs_node->size - offset)) {
+        data_size = fs_node->size - offset;
+    }
+    struct tfs_objectdata* object_data = (struct tfs_objectdata*)fs_node->filesystem_obj->object_data;
+    tfs_node_transfer(object_data, (struct tfs_node*)fs_node->node_data, offset, data, data_size, false);
+    return data_size;
+}
+
+/*
+ * writes past the end of the file extend it, and a gap before 'offset' is filled with zeros
+ */
+uint32_t tfs_write(struct filesystem_node* fs_node, uint64_t offset, const uint8_t* data, uint32_t data_size) {
+    ASSERT_NOT_NULL(fs_node);
+    ASSERT_NOT_NULL(fs_node->filesystem_obj);
+    ASSERT_NOT_NULL(fs_node->filesystem_obj->object_data);
+    ASSERT_NOT_NULL(data);
+    if ((file != fs_node->type) || (0 == data_size)) {
+        return 0;
+    }
+    struct tfs_objectdata* object_data = (struct tfs_objectdata*)fs_node->filesystem_obj->object_data;
+    struct tfs_node* node = (struct tfs_node*)fs_node->node_data;
+    if (offset > fs_node->size) {
+        if (!tfs_node_resize(object_data, fs_node, offset)) {
+            return 0;
+        }
+    }
+    uint64_t end = offset + data_size;
+    uint64_t extra = (node->blocks < TFS_PREALLOCATE_MAX) ? node->blocks : TFS_PREALLOCATE_MAX;
+    if (!tfs_node_extend(object_data, node, tfs_blocks_for(end), extra)) {
+        // as much as fits
+        end = node->blocks * TFS_BLOCK_SIZE;
+        if (end <= offset) {
+            return 0;
+        }
+        data_size = end - offset;
+    }
+    tfs_node_transfer(object_data, node, offset, (uint8_t*)data, data_size, true);
+    if (end > fs_node->size) {
+        fs_node->size = end;
+        tfs_node_mark_dirty(object_data, fs_node);
+    }
+    return data_size;
+}
+
+bool tfs_truncate(struct filesystem_node* fs_node, uint64_t size) {
+    ASSERT_NOT_NULL(fs_node);
+    ASSERT_NOT_NULL(fs_node->filesystem_obj);
+    ASSERT_NOT_NULL(fs_node->filesystem_obj->object_data);
+    if (file != fs_node->type) {
+        return false;
+    }
+    struct tfs_objectdata* object_data = (struct tfs_objectdata*)fs_node->filesystem_obj->object_data;
+    return tfs_node_resize(object_data, fs_node, size);
+}
+
+/*
+ * write the file blocks that have changed, then the map
+ */
+void tfs_sync(struct object* obj) {
+    ASSERT_NOT_NULL(obj);
     ASSERT_NOT_NULL(obj->object_data);
-    //   struct tfs_objectdata* object_data = (struct tfs_objectdata*)obj->object_data;
+    struct tfs_objectdata* object_data = (struct tfs_objectdata*)obj->object_data;
+    for (uint32_t i = 0; i < arraylist_count(object_data->dirty); i++) {
+        tfs_node_store(object_data, (struct filesystem_node*)arraylist_get(object_data->dirty, i));
+    }
+    arraylist_delete(object_data->dirty);
+    object_data->dirty = arraylist_new();
+    tfs_map_sync(object_data->partition_object, &(object_data->map));
+}
+
+void tfs_open(struct filesystem_node* fs_node) {
+    ASSERT_NOT_NULL(fs_node);
+}
+
+void tfs_close(struct filesystem_node* fs_node) {
+    ASSERT_NOT_NULL(fs_node);
+    tfs_sync(fs_node->filesystem_obj);
 }
 
-void tfs_write(struct object* obj, const uint8_t* name, const uint8_t* data, uint32_t size) {
+struct filesystem_node* tfs_get_root_node(struct object* obj) {
     ASSERT_NOT_NULL(obj);
-    ASSERT_NOT_NULL(name);
-    ASSERT_NOT_NULL(data);
-    ASSERT(strlen(name) < TFS_FILENAME_SIZE);
     ASSERT_NOT_NULL(obj->object_data);
-    //  struct tfs_objectdata* object_data = (struct tfs_objectdata*)obj->object_data;
+    struct tfs_objectdata* object_data = (struct tfs_objectdata*)obj->object_data;
+    return object_data->root_node;
+}
 
-    kprintf("write file: %s of length %llu\n", name, size);
-    /*
-     * find an empty spot in the root dir
-     */
+struct filesystem_node* tfs_find_node_by_id(struct filesystem_node* fs_node, uint64_t id) {
+    ASSERT_NOT_NULL(fs_node);
+    ASSERT_NOT_NULL(fs_node->filesystem_obj);
+    ASSERT_NOT_NULL(fs_node->filesystem_obj->object_data);
+    struct tfs_objectdata* object_data = (struct tfs_objectdata*)fs_node->filesystem_obj->object_data;
+    return filesystem_node_map_find_id(object_data->filesystem_nodes, id);
+}
 
-    /*
-     * write to the dir
-     */
+bool tfs_list_iterator(struct tfs_dir_entry* entry, void* context) {
+    ASSERT_NOT_NULL(entry);
+    struct filesystem_node* fs_node = (struct filesystem_node*)((void**)context)[0];
+    struct filesystem_directory* dir = (struct filesystem_directory*)((void**)context)[1];
+    struct tfs_objectdata* object_data = (struct tfs_objectdata*)fs_node->filesystem_obj->object_data;
+    struct filesystem_node* node =
+        filesystem_node_map_find_child(object_data->filesystem_nodes, fs_node->id, entry->name);
+    if (0 == node) {
+        node = tfs_node_load(fs_node->filesystem_obj, entry->file_block);
+        filesystem_node_map_insert(object_data->filesystem_nodes, node);
+    }
+    dir->ids[dir->count] = node->id;
+    dir->count += 1;
+    return (dir->count < FILESYSTEM_MAX_FILES_PER_DIR);
+}
 
-    /*
-     * make an allocation block
-     */
+/*
+ * TFS has just the root dir
+ */
+void tfs_list_dir(struct filesystem_node* fs_node, struct filesystem_directory* dir) {
+    ASSERT_NOT_NULL(fs_node);
+    ASSERT_NOT_NULL(fs_node->filesystem_obj);
+    ASSERT_NOT_NULL(fs_node->filesystem_obj->object_data);
+    ASSERT_NOT_NULL(dir);
+    struct tfs_objectdata* object_data = (struct tfs_objectdata*)fs_node->filesystem_obj->object_data;
+    dir->count = 0;
+    if (fs_node == object_data->root_node) {
+        void* context[2] = {fs_node, dir};
+        tfs_dir_iterate_files(&(object_data->dir), &tfs_list_iterator, context);
+    }
+}
+
+/*
+ * the file block and dir block are written straight away; data blocks come with writes
+ */
+struct filesystem_node* tfs_create(struct filesystem_node* fs_node, uint8_t* name) {
+    ASSERT_NOT_NULL(fs_node);
+    ASSERT_NOT_NULL(fs_node->filesystem_obj);
+    ASSERT_NOT_NULL(fs_node->filesystem_obj->object_data);
+    ASSERT_NOT_NULL(name);
+    struct tfs_objectdata* object_data = (struct tfs_objectdata*)fs_node->filesystem_obj->object_data;
+    uint32_t length = strlen(name);
+    if ((fs_node != object_data->root_node) || (0 == length) || (length >= TFS_FILENAME_SIZE) ||
+        (0 != tfs_dir_find_file(&(object_data->dir), name))) {
+        return 0;
+    }
+    for (uint32_t i = 0; i < length; i++) {
+        if (FILESYSTEM_NAME_DELIMITER[0] == name[i]) {
+            return 0;
+        }
+    }
+    uint64_t file_block = 0;
+    if (0 == tfs_map_allocate(&(object_data->map), object_data->superblock.root_dir + 1, 1, &file_block)) {
+        return 0;
+    }
+    struct filesystem_node* ret = filesystem_node_new(file, fs_node->filesystem_obj, name, 0,
+                                                      tfs_node_new(file_block), fs_node->id);
+    tfs_node_store(object_data, ret);
+    if (!tfs_dir_add_file(object_data->partition_object, &(object_data->dir), &(object_data->map), name,
+                          file_block)) {
+        tfs_map_release(&(object_data->map), file_block, 1);
+        tfs_node_delete_iterator(ret);
+        filesystem_node_delete(ret);
+        return 0;
+    }
+    filesystem_node_map_insert(object_data->filesystem_nodes, ret);
+    return ret;
 }
 
 /*
@@ -126,6 +565,18 @@ uint8_t tfs_init(struct object* obj) {
     ASSERT_NOT_NULL(obj);
     ASSERT_NOT_NULL(obj->object_data);
     struct tfs_objectdata* object_data = (struct tfs_objectdata*)obj->object_data;
+    tfs_read_superblock(object_data->partition_object, &(object_data->superblock));
+    if ((TFS_MAGIC_SUPERBLOCK != object_data->superblock.magic) ||
+        (TFS_BLOCK_SIZE != object_data->superblock.blocks_size) ||
+        (object_data->superblock.blocks_count > blockutil_get_sector_count(object_data->partition_object))) {
+        // not TFS
+        return 0;
+    }
+    tfs_map_load(object_data->partition_object, &(object_data->map), &(object_data->superblock));
+    tfs_dir_load(object_data->partition_object, &(object_data->dir), object_data->superblock.root_dir);
+    object_data->root_node = filesystem_node_new(folder, obj, obj->name, 0, 0, 0);
+    object_data->filesystem_nodes = filesystem_node_map_new();
+    object_data->dirty = arraylist_new();
     kprintf("Init %s on %s (%s)\n", obj->description, object_data->partition_object->name, obj->name);
     return 1;
 }
@@ -139,6 +590,14 @@ uint8_t tfs_uninit(struct object* obj) {
 
     struct tfs_objectdata* object_data = (struct tfs_objectdata*)obj->object_data;
     kprintf("Uninit %s on %s (%s)\n", obj->description, object_data->partition_object->name, obj->name);
+    tfs_sync(obj);
+    tree_iterate(object_data->filesystem_nodes->filesystem_nodes_by_id, &tfs_node_delete_iterator);
+    filesystem_node_map_clear(object_data->filesystem_nodes);
+    filesystem_node_map_delete(object_data->filesystem_nodes);
+    filesystem_node_delete(object_data->root_node);
+    arraylist_delete(object_data->dirty);
+    tfs_dir_delete(&(object_data->dir));
+    tfs_map_delete(&(object_data->map));
     kfree(obj->api);
     kfree(obj->object_data);
     return 1;
@@ -167,12 +626,23 @@ struct object* tfs_attach(struct object* partition_object) {
     struct objectinterface_filesystem* api =
         (struct objectinterface_filesystem*)kmalloc(sizeof(struct objectinterface_filesystem));
     memzero((uint8_t*)api, sizeof(struct objectinterface_filesystem));
-    //   api->format = &tfs_format;
+    api->close = &tfs_close;
+    api->create = &tfs_create;
+    api->find_id = &tfs_find_node_by_id;
+    api->list = &tfs_list_dir;
+    api->open = &tfs_open;
+    api->read = &tfs_read;
+    api->root = &tfs_get_root_node;
+    api->sync = &tfs_sync;
+    api->truncate = &tfs_truncate;
+    api->write = &tfs_write;
+    api->cached = true;
     objectinstance->api = api;
     /*
      * device data
      */
     struct tfs_objectdata* object_data = (struct tfs_objectdata*)kmalloc(sizeof(struct tfs_objectdata));
+    memzero((uint8_t*)object_data, sizeof(struct tfs_objectdata));
     object_data->partition_object = partition_object;
     objectinstance->object_data = object_data;
 
@@ -208,4 +678,4 @@ void tfs_detach(struct object* obj) {
     * detach
     */
     objectmgr_detach_object(obj);
-}
\ No newline at end of file
+}
@@ -10,6 +10,10 @@
 
 struct object;
 
+/*
+ * make an empty TFS on a block device.  anything on it is lost
+ */
+void tfs_format(struct object* partition_object);
 struct object* tfs_attach(struct object* partition_object);
 void tfs_detach(struct object* obj);
 
@@ -68,3 +68,15 @@ void tfs_read_file_block(struct object* obj, struct tfs_file_block* file_block,
     ASSERT_NOT_NULL(file_block);
     blockutil_read(obj, (uint8_t*)file_block, sizeof(struct tfs_file_block), lba, 0);
 }
+
+void tfs_write_allocation_block(struct object* obj, struct tfs_file_allocation_block* allocation_block, uint64_t lba) {
+    ASSERT_NOT_NULL(obj);
+    ASSERT_NOT_NULL(allocation_block);
+    blockutil_write(obj, (uint8_t*)allocation_block, sizeof(struct tfs_file_allocation_block), lba, 0);
+}
+
+void tfs_read_allocation_block(struct object* obj, struct tfs_file_allocation_block* allocation_block, uint64_t lba) {
+    ASSERT_NOT_NULL(obj);
+    ASSERT_NOT_NULL(allocation_block);
+    blockutil_read(obj, (uint8_t*)allocation_block, sizeof(struct tfs_file_allocation_block), lba, 0);
+}
@@ -14,11 +14,14 @@ struct object;
 
 #define TFS_BLOCK_SIZE 512
 #define TFS_FILES_PER_DIR_BLOCK 63
-#define TFS_FILES_PER_MAP_BLOCK 63
 #define TFS_FILENAME_SIZE 128
-#define TFS_SECTORS_PER_MAP_BLOCK 512
+#define TFS_BLOCKS_PER_MAP_BLOCK (TFS_BLOCK_SIZE * 8)  // a bit for each block
+#define TFS_EXTENTS_PER_FILE_BLOCK 22
+#define TFS_EXTENTS_PER_ALLOCATION_BLOCK 31
 #define TFS_MAGIC_SUPERBLOCK 0x00544653  // 'TFS'
 
+#define TFS_FILE_STATUS_USED 1
+
 // 512 bytes which are 64 uint64_t's
 struct tfs_superblock_block {
     uint64_t magic;              // TFS_MAGIC_SUPERBLOCK
@@ -31,25 +34,35 @@ struct tfs_superblock_block {
 
 // the number of files determined by TFS_BLOCK_SIZE
 struct tfs_dir_block {
-    uint64_t files[TFS_FILES_PER_DIR_BLOCK];  // pointers to file blocks
+    uint64_t files[TFS_FILES_PER_DIR_BLOCK];  // pointers to file blocks, zero if the slot is free
     uint64_t next;                            // next dir block, or zero if no more
 } __attribute__((packed));
 
+// count blocks, starting at block start
+struct tfs_extent {
+    uint64_t start;
+    uint64_t count;
+} __attribute__((packed));
+
 struct tfs_file_block {
     uint8_t name[TFS_FILENAME_SIZE];  // file name
-    uint64_t allocation_map;          // allocation map block
-    uint64_t status;                  // deleted, etc.
-    uint8_t reserved[368];
+    uint64_t size;                    // bytes
+    uint64_t allocation_map;          // first allocation block with more extents, or zero
+    uint64_t status;                  // TFS_FILE_STATUS_USED
+    uint64_t extent_count;            // here and in the allocation blocks
+    struct tfs_extent extents[TFS_EXTENTS_PER_FILE_BLOCK];
 } __attribute__((packed));
 
-// the number of blocks we can reference here is determined by TFS_BLOCK_SIZE
+// extents for files with more than fit in the file block
 struct tfs_file_allocation_block {
-    uint64_t blocks[TFS_FILES_PER_MAP_BLOCK];  // pointers to data blocks
-    uint64_t allocation_map;                   // next dir block, or zero if no more
+    struct tfs_extent extents[TFS_EXTENTS_PER_ALLOCATION_BLOCK];
+    uint64_t allocation_map;  // next allocation block, or zero if no more
+    uint64_t reserved;
 } __attribute__((packed));
 
+// map blocks follow the superblock, and are read and written as one bitmap.  a set bit is a block in use
 struct tfs_map_block {
-    uint8_t map[TFS_SECTORS_PER_MAP_BLOCK];
+    uint64_t map[TFS_BLOCK_SIZE / sizeof(uint64_t)];
 } __attribute__((packed));
 
 void tfs_read_superblock(struct object* obj, struct tfs_superblock_block* superblock);
@@ -60,5 +73,7 @@ void tfs_write_map_block(struct object* obj, struct tfs_map_block* map_block, ui
 void tfs_read_map_block(struct object* obj, struct tfs_map_block* map_block, uint64_t lba);
 void tfs_write_file_block(struct object* obj, struct tfs_file_block* file_block, uint64_t lba);
 void tfs_read_file_block(struct object* obj, struct tfs_file_block* file_block, uint64_t lba);
+void tfs_write_allocation_block(struct object* obj, struct tfs_file_allocation_block* allocation_block, uint64_t lba);
+void tfs_read_allocation_block(struct object* obj, struct tfs_file_allocation_block* allocation_block, uint64_t lba);
 
-#endif
\ No newline at end of file
+#endif
@@ -7,78 +7,195 @@
 
 #include <obj/logical/fs/tfs/tfs_block.h>
 #include <obj/logical/fs/tfs/tfs_dir.h>
+#include <obj/logical/fs/tfs/tfs_map.h>
+#include <sys/collection/arraylist/arraylist.h>
 #include <sys/debug/assert.h>
-#include <sys/kprintf/kprintf.h>
+#include <sys/kmalloc/kmalloc.h>
+#include <sys/string/mem.h>
 #include <sys/string/string.h>
 
 struct object;
 
+struct tfs_dir_block_cache {
+    uint64_t lba;
+    struct tfs_dir_block block;
+};
+
 /*
- * returns file block, or zero
+ * FNV-1a over the name
+ */
+uint16_t tfs_dir_hash(const uint8_t* name) {
+    uint64_t hash = 0xCBF29CE484222325;
+    for (uint16_t i = 0; 0 != name[i]; i++) {
+        hash = (hash ^ name[i]) * 0x100000001B3;
+    }
+    return (hash ^ (hash >> 32)) % TFS_DIR_BUCKETS;
+}
+
+struct tfs_dir_entry** tfs_dir_find_link(struct tfs_dir* dir, uint8_t* filename) {
+    struct tfs_dir_entry** link = &(dir->buckets[tfs_dir_hash(filename)]);
+    while (0 != *link) {
+        if (0 == strcmp((*link)->name, filename)) {
+            return link;
+        }
+        link = &((*link)->next);
+    }
+    return link;
+}
+
+void tfs_dir_insert(struct tfs_dir* dir, uint8_t* filename, uint64_t file_block) {
+    struct tfs_dir_entry* entry = (struct tfs_dir_entry*)kmalloc(sizeof(struct tfs_dir_entry));
+    strncpy(entry->name, filename, TFS_FILENAME_SIZE);
+    entry->file_block = file_block;
+    uint16_t bucket = tfs_dir_hash(filename);
+    entry->next = dir->buckets[bucket];
+    dir->buckets[bucket] = entry;
+    dir->count += 1;
+}
+
+/*
+ * read the dir blocks, and the file blocks they point to for the names
  */
-uint64_t tfs_dir_find_file(struct object* obj, uint8_t* filename) {
+void tfs_dir_load(struct object* obj, struct tfs_dir* dir, uint64_t root_dir) {
     ASSERT_NOT_NULL(obj);
-    ASSERT_NOT_NULL(filename);
-    ASSERT(strlen(filename) < TFS_FILENAME_SIZE);
-    return 0;
+    ASSERT_NOT_NULL(dir);
+    memzero((uint8_t*)dir, sizeof(struct tfs_dir));
+    dir->blocks = arraylist_new();
+    uint64_t block = root_dir;
+    while (0 != block) {
+        struct tfs_dir_block_cache* cache = (struct tfs_dir_block_cache*)kmalloc(sizeof(struct tfs_dir_block_cache));
+        cache->lba = block;
+        tfs_read_dir_block(obj, &(cache->block), block);
+        arraylist_add(dir->blocks, cache);
+        for (uint32_t i = 0; i < TFS_FILES_PER_DIR_BLOCK; i++) {
+            if (0 != cache->block.files[i]) {
+                struct tfs_file_block file_block;
+                tfs_read_file_block(obj, &file_block, cache->block.files[i]);
+                file_block.name[TFS_FILENAME_SIZE - 1] = 0;
+                tfs_dir_insert(dir, file_block.name, cache->block.files[i]);
+            }
+        }
+        block = cache->block.next;
+    }
+}
+
+void tfs_dir_delete(struct tfs_dir* dir) {
+    ASSERT_NOT_NULL(dir);
+    for (uint32_t i = 0; i < TFS_DIR_BUCKETS; i++) {
+        struct tfs_dir_entry* entry = dir->buckets[i];
+        while (0 != entry) {
+            struct tfs_dir_entry* next = entry->next;
+            kfree(entry);
+            entry = next;
+        }
+        dir->buckets[i] = 0;
+    }
+    for (uint32_t i = 0; i < arraylist_count(dir->blocks); i++) {
+        kfree(arraylist_get(dir->blocks, i));
+    }
+    arraylist_delete(dir->blocks);
+    dir->count = 0;
 }
 
 /*
  * returns file block, or zero
  */
-uint64_t tfs_dir_add_file(struct object* obj, uint8_t* filename) {
-    ASSERT_NOT_NULL(obj);
-    ASSERT(strlen(filename) < TFS_FILENAME_SIZE);
+uint64_t tfs_dir_find_file(struct tfs_dir* dir, uint8_t* filename) {
+    ASSERT_NOT_NULL(dir);
     ASSERT_NOT_NULL(filename);
+    ASSERT(strlen(filename) < TFS_FILENAME_SIZE);
+    struct tfs_dir_entry* entry = *tfs_dir_find_link(dir, filename);
+    if (0 != entry) {
+        return entry->file_block;
+    }
     return 0;
 }
 
-void tfs_dir_iterate_files(struct object* obj, tfs_file_iterator file_iterator) {
-    ASSERT_NOT_NULL(file_iterator);
+bool tfs_dir_add_file(struct object* obj, struct tfs_dir* dir, struct tfs_map* map, uint8_t* filename,
+                      uint64_t file_block) {
     ASSERT_NOT_NULL(obj);
+    ASSERT_NOT_NULL(dir);
+    ASSERT_NOT_NULL(map);
+    ASSERT_NOT_NULL(filename);
+    ASSERT(strlen(filename) < TFS_FILENAME_SIZE);
+    ASSERT(0 != file_block);
+    ASSERT(0 == tfs_dir_find_file(dir, filename));
+
     /*
-     * get the superblock
-     */
-    struct tfs_superblock_block superblock;
-    tfs_read_superblock(obj, &superblock);
-    ASSERT(superblock.magic == 0x00444653);
-    kprintf("Superblock blocks_size %llu blocks_count %llu\n", superblock.blocks_size, superblock.blocks_count);
-    /*
-     * iterate directory blocks
+     * a free slot in the dir blocks we have
      */
-    //  bool more = true;
-    uint64_t block = superblock.root_dir;
-    while (block) {
-        /*
-         * get the root dir
-         */
-        struct tfs_dir_block root_dir;
-        tfs_read_dir_block(obj, &root_dir, block);
+    uint32_t count = arraylist_count(dir->blocks);
+    for (uint32_t b = 0; b < count; b++) {
+        struct tfs_dir_block_cache* cache = (struct tfs_dir_block_cache*)arraylist_get(dir->blocks, b);
         for (uint32_t i = 0; i < TFS_FILES_PER_DIR_BLOCK; i++) {
-            uint64_t file_block_block = root_dir.files[i];
-            /*
-             * get the file for that one
-             */
-            struct tfs_file_block file_block;
-            tfs_read_file_block(obj, &file_block, file_block_block);
-            /*
-             * callback
-             */
-            bool cont = file_iterator(&file_block);
-            if (cont == false) {
-                break;
+            if (0 == cache->block.files[i]) {
+                cache->block.files[i] = file_block;
+                tfs_write_dir_block(obj, &(cache->block), cache->lba);
+                tfs_dir_insert(dir, filename, file_block);
+                return true;
             }
         }
-        if (root_dir.next != 0) {
-            block = root_dir.next;
-        } else {
-            block = 0;
+    }
+
+    /*
+     * or another dir block on the end of the chain
+     */
+    ASSERT(count > 0);
+    struct tfs_dir_block_cache* last = (struct tfs_dir_block_cache*)arraylist_get(dir->blocks, count - 1);
+    uint64_t lba = 0;
+    if (0 == tfs_map_allocate(map, last->lba + 1, 1, &lba)) {
+        return false;
+    }
+    struct tfs_dir_block_cache* cache = (struct tfs_dir_block_cache*)kmalloc(sizeof(struct tfs_dir_block_cache));
+    memzero((uint8_t*)cache, sizeof(struct tfs_dir_block_cache));
+    cache->lba = lba;
+    cache->block.files[0] = file_block;
+    tfs_write_dir_block(obj, &(cache->block), cache->lba);
+    arraylist_add(dir->blocks, cache);
+    last->block.next = lba;
+    tfs_write_dir_block(obj, &(last->block), last->lba);
+    tfs_dir_insert(dir, filename, file_block);
+    return true;
+}
+
+void tfs_dir_iterate_files(struct tfs_dir* dir, tfs_file_iterator file_iterator, void* context) {
+    ASSERT_NOT_NULL(file_iterator);
+    ASSERT_NOT_NULL(dir);
+    for (uint32_t i = 0; i < TFS_DIR_BUCKETS; i++) {
+        struct tfs_dir_entry* entry = dir->buckets[i];
+        while (0 != entry) {
+            if (false == file_iterator(entry, context)) {
+                return;
+            }
+            entry = entry->next;
         }
     }
 }
 
-void tfs_dir_remove_file(struct object* obj, uint8_t* filename) {
+uint64_t tfs_dir_remove_file(struct object* obj, struct tfs_dir* dir, uint8_t* filename) {
     ASSERT_NOT_NULL(obj);
-    ASSERT(strlen(filename) < TFS_FILENAME_SIZE);
+    ASSERT_NOT_NULL(dir);
     ASSERT_NOT_NULL(filename);
+    ASSERT(strlen(filename) < TFS_FILENAME_SIZE);
+    struct tfs_dir_entry** link = tfs_dir_find_link(dir, filename);
+    struct tfs_dir_entry* entry = *link;
+    if (0 == entry) {
+        return 0;
+    }
+    uint64_t ret = entry->file_block;
+    *link = entry->next;
+    kfree(entry);
+    dir->count -= 1;
+    for (uint32_t b = 0; b < arraylist_count(dir->blocks); b++) {
+        struct tfs_dir_block_cache* cache = (struct tfs_dir_block_cache*)arraylist_get(dir->blocks, b);
+        for (uint32_t i = 0; i < TFS_FILES_PER_DIR_BLOCK; i++) {
+            if (ret == cache->block.files[i]) {
+                cache->block.files[i] = 0;
+                tfs_write_dir_block(obj, &(cache->block), cache->lba);
+                return ret;
+            }
+        }
+    }
+    PANIC("file not in a dir block");
+    return ret;
 }
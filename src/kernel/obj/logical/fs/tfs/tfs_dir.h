@@ -8,28 +8,51 @@
 #ifndef _TFS_DIR_H
 #define _TFS_DIR_H
 
+#include <obj/logical/fs/tfs/tfs_block.h>
 #include <types.h>
 
 struct object;
-struct tfs_file_block;
+struct arraylist;
+struct tfs_map;
 
-typedef bool (*tfs_file_iterator)(struct tfs_file_block* file_block);
+#define TFS_DIR_BUCKETS 64
 
+struct tfs_dir_entry {
+    struct tfs_dir_entry* next;  // in the bucket
+    uint8_t name[TFS_FILENAME_SIZE];
+    uint64_t file_block;
+};
+
+/*
+ * the root dir, read in whole at attach.  names are hashed, so finding a file doesn't read the dir, and the dir
+ * blocks are kept, so adding or removing a file writes just the one that changes
+ */
+struct tfs_dir {
+    struct tfs_dir_entry* buckets[TFS_DIR_BUCKETS];
+    struct arraylist* blocks;  // struct tfs_dir_block_cache, in chain order
+    uint64_t count;
+};
+
+typedef bool (*tfs_file_iterator)(struct tfs_dir_entry* entry, void* context);
+
+void tfs_dir_load(struct object* obj, struct tfs_dir* dir, uint64_t root_dir);
+void tfs_dir_delete(struct tfs_dir* dir);
 /*
  * find file. returns file block, or zero
  */
-uint64_t tfs_dir_find_file(struct object* obj, uint8_t* filename);
+uint64_t tfs_dir_find_file(struct tfs_dir* dir, uint8_t* filename);
 /*
- * add file. returns file block, or zero
+ * add file. returns false if the dir is full and there's no block to grow it with
  */
-uint64_t tfs_dir_add_file(struct object* obj, uint8_t* filename);
+bool tfs_dir_add_file(struct object* obj, struct tfs_dir* dir, struct tfs_map* map, uint8_t* filename,
+                      uint64_t file_block);
 /*
- * remove file.
+ * remove file. returns its file block, or zero
  */
-void tfs_dir_remove_file(struct object* obj, uint8_t* filename);
+uint64_t tfs_dir_remove_file(struct object* obj, struct tfs_dir* dir, uint8_t* filename);
 /*
- * iterate files
+ * iterate files, until the iterator returns false
  */
-void tfs_dir_iterate_files(struct object* obj, tfs_file_iterator file_iterator);
+void tfs_dir_iterate_files(struct tfs_dir* dir, tfs_file_iterator file_iterator, void* context);
 
-#endif
\ No newline at end of file
+#endif
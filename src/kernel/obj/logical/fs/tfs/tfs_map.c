@@ -8,62 +8,146 @@
 #include <obj/logical/fs/block_util.h>
 #include <obj/logical/fs/tfs/tfs_block.h>
 #include <obj/logical/fs/tfs/tfs_map.h>
+#include <sys/collection/bitmap/bitmap.h>
 #include <sys/debug/assert.h>
-#include <sys/kprintf/kprintf.h>
 
 struct object;
 
 /*
- * find the block for the map entry for a block (indexed to first map block)
+ * the map block holding the bit for a block (indexed to first map block)
  */
-uint64_t tfs_map_sector(uint32_t block) {
-    return block / TFS_SECTORS_PER_MAP_BLOCK;
+uint64_t tfs_map_sector(uint64_t block) {
+    return block / TFS_BLOCKS_PER_MAP_BLOCK;
+}
+
+void tfs_map_mark_dirty(struct tfs_map* map, uint64_t start, uint64_t count) {
+    bitmap_set_range(map->dirty, tfs_map_sector(start), tfs_map_sector(start + count - 1) - tfs_map_sector(start) + 1);
+}
+
+void tfs_map_new(struct tfs_map* map, uint64_t blocks_count, uint64_t number_map_blocks) {
+    ASSERT_NOT_NULL(map);
+    ASSERT((number_map_blocks * TFS_BLOCKS_PER_MAP_BLOCK) >= blocks_count);
+    map->blocks = bitmap_new(number_map_blocks * TFS_BLOCKS_PER_MAP_BLOCK);
+    map->dirty = bitmap_new(number_map_blocks);
+    // the bitmap's words are the map blocks, as they are on the disk
+    ASSERT(map->blocks->byte_size == (number_map_blocks * TFS_BLOCK_SIZE));
+    if (blocks_count < map->blocks->size) {
+        bitmap_set_range(map->blocks, blocks_count, map->blocks->size - blocks_count);
+    }
+    map->free = blocks_count;
+    map->next = 0;
+}
+
+void tfs_map_load(struct object* obj, struct tfs_map* map, struct tfs_superblock_block* superblock) {
+    ASSERT_NOT_NULL(obj);
+    ASSERT_NOT_NULL(map);
+    ASSERT_NOT_NULL(superblock);
+    tfs_map_new(map, superblock->blocks_count, superblock->number_map_blocks);
+    blockutil_read(obj, (uint8_t*)map->blocks->bits, map->blocks->byte_size, 1, 0);
+    map->free = map->blocks->size - bitmap_count_set(map->blocks);
 }
 
 /*
- * find the byte index for the map entry for a block (indexed to first map block)
+ * write the map blocks that have changed, consecutive ones together
  */
-uint64_t tfs_map_index(uint32_t block) {
-    return block - (tfs_map_sector(block) * TFS_SECTORS_PER_MAP_BLOCK);
+void tfs_map_sync(struct object* obj, struct tfs_map* map) {
+    ASSERT_NOT_NULL(obj);
+    ASSERT_NOT_NULL(map);
+    uint64_t first = bitmap_find_next_set(map->dirty, 0);
+    while (BITMAP_NOT_FOUND != first) {
+        uint64_t end = bitmap_find_next_zero(map->dirty, first);
+        if (BITMAP_NOT_FOUND == end) {
+            end = map->dirty->size;
+        }
+        uint8_t* data = (uint8_t*)&(map->blocks->bits[first * (TFS_BLOCK_SIZE / sizeof(uint64_t))]);
+        blockutil_write(obj, data, (end - first) * TFS_BLOCK_SIZE, first + 1, 0);
+        bitmap_clear_range(map->dirty, first, end - first);
+        first = bitmap_find_next_set(map->dirty, end);
+    }
+}
+
+void tfs_map_delete(struct tfs_map* map) {
+    ASSERT_NOT_NULL(map);
+    bitmap_delete(map->blocks);
+    bitmap_delete(map->dirty);
+}
+
+void tfs_map_set(struct tfs_map* map, uint64_t start, uint64_t count) {
+    ASSERT_NOT_NULL(map);
+    ASSERT(count <= map->free);
+    bitmap_set_range(map->blocks, start, count);
+    tfs_map_mark_dirty(map, start, count);
+    map->free -= count;
 }
 
 /*
- * returns zero if no block can be found (disk is full)
+ * the run of count at near if it's free, else the first run of count from the last allocation on, else the
+ * longest run there is
  */
-uint32_t tfs_map_find_free_block(struct object* obj, struct tfs_superblock_block* superblock) {
-    ASSERT_NOT_NULL(obj);
-    ASSERT_NOT_NULL(superblock);
-    uint64_t byte_count = 0;
-    for (uint64_t block = 1; block <= tfs_map_block_count(obj); block++) {
-        struct tfs_map_block mapblock;
-        tfs_read_map_block(obj, &mapblock, block);
-        for (uint64_t i = 0; i < TFS_BLOCK_SIZE; i++) {
-            if (mapblock.map[i] == TFS_MAP_BLOCK_FREE) {
-                mapblock.map[i] = TFS_MAP_BLOCK_USED;
-                return i;
+uint64_t tfs_map_allocate(struct tfs_map* map, uint64_t near, uint64_t count, uint64_t* start) {
+    ASSERT_NOT_NULL(map);
+    ASSERT_NOT_NULL(start);
+    ASSERT(count > 0);
+    if (0 == map->free) {
+        return 0;
+    }
+    if (count > map->free) {
+        count = map->free;
+    }
+    uint64_t found = BITMAP_NOT_FOUND;
+    if ((near < map->blocks->size) && (0 == bitmap_get(map->blocks, near))) {
+        uint64_t end = bitmap_find_next_set(map->blocks, near);
+        if (BITMAP_NOT_FOUND == end) {
+            end = map->blocks->size;
+        }
+        if ((end - near) >= count) {
+            found = near;
+        }
+    }
+    if (BITMAP_NOT_FOUND == found) {
+        found = bitmap_find_next_zero_run(map->blocks, map->next, count);
+    }
+    if ((BITMAP_NOT_FOUND == found) && (map->next > 0)) {
+        found = bitmap_find_zero_run(map->blocks, count);
+    }
+    if (BITMAP_NOT_FOUND == found) {
+        // nothing long enough; take the longest run
+        uint64_t longest = 0;
+        uint64_t run = bitmap_find_next_zero(map->blocks, 0);
+        while (BITMAP_NOT_FOUND != run) {
+            uint64_t end = bitmap_find_next_set(map->blocks, run);
+            if (BITMAP_NOT_FOUND == end) {
+                end = map->blocks->size;
             }
-            /*
-             * make sure we dont index off the end
-             */
-            byte_count++;
-            if (byte_count >= superblock->blocks_count) {
-                // ran out of blocks
-                return 0;
+            if ((end - run) > longest) {
+                longest = end - run;
+                found = run;
             }
+            run = bitmap_find_next_zero(map->blocks, end);
         }
+        count = longest;
     }
-    return 0;
+    ASSERT(BITMAP_NOT_FOUND != found);
+    tfs_map_set(map, found, count);
+    map->next = found + count;
+    *start = found;
+    return count;
 }
 
-void tfs_map_release_block(struct object* obj, uint64_t block, struct tfs_superblock_block* superblock) {
-    ASSERT_NOT_NULL(obj);
-    ASSERT_NOT_NULL(superblock);
-    uint64_t sector = tfs_map_sector(block);
-    uint64_t index = tfs_map_index(block);
-    kprintf("block %llu, sector %llu, index %llu\n", block, sector, index);
+void tfs_map_release(struct tfs_map* map, uint64_t start, uint64_t count) {
+    ASSERT_NOT_NULL(map);
+    if (0 == count) {
+        return;
+    }
+    bitmap_clear_range(map->blocks, start, count);
+    tfs_map_mark_dirty(map, start, count);
+    map->free += count;
 }
 
+/*
+ * map blocks needed for the whole disk
+ */
 uint32_t tfs_map_block_count(struct object* obj) {
     ASSERT_NOT_NULL(obj);
-    return (blockutil_get_sector_count(obj) / TFS_SECTORS_PER_MAP_BLOCK) + 1;
+    return (blockutil_get_sector_count(obj) + TFS_BLOCKS_PER_MAP_BLOCK - 1) / TFS_BLOCKS_PER_MAP_BLOCK;
 }
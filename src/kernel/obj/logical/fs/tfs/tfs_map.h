@@ -11,12 +11,34 @@
 #include <types.h>
 
 struct object;
+struct bitmap;
 struct tfs_superblock_block;
 
-#define TFS_MAP_BLOCK_FREE 0
-#define TFS_MAP_BLOCK_USED 1
+/*
+ * the map blocks, held in memory as one bitmap, so finding free blocks is a search of 64 blocks a step and never
+ * goes to the disk.  changed map blocks are written at sync
+ */
+struct tfs_map {
+    struct bitmap* blocks;  // a bit for each block, set if in use.  blocks past the end of the disk are set
+    struct bitmap* dirty;   // a bit for each map block, set if it has changed
+    uint64_t free;
+    uint64_t next;  // where a search with no better place to start starts
+};
 
-uint32_t tfs_map_find_free_block(struct object* obj, struct tfs_superblock_block* superblock);
-void tfs_map_release_block(struct object* obj, uint64_t block, struct tfs_superblock_block* superblock);
 uint32_t tfs_map_block_count(struct object* obj);
-#endif
\ No newline at end of file
+/*
+ * a map with nothing in use
+ */
+void tfs_map_new(struct tfs_map* map, uint64_t blocks_count, uint64_t number_map_blocks);
+void tfs_map_load(struct object* obj, struct tfs_map* map, struct tfs_superblock_block* superblock);
+void tfs_map_sync(struct object* obj, struct tfs_map* map);
+void tfs_map_delete(struct tfs_map* map);
+/*
+ * take up to count free blocks in one run, preferably starting at near.  returns the number taken, with the
+ * first in start, or zero if the disk is full
+ */
+uint64_t tfs_map_allocate(struct tfs_map* map, uint64_t near, uint64_t count, uint64_t* start);
+void tfs_map_set(struct tfs_map* map, uint64_t start, uint64_t count);
+void tfs_map_release(struct tfs_map* map, uint64_t start, uint64_t count);
+
+#endif
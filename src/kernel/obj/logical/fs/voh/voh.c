@@ -10,6 +10,7 @@
 #include <obj/logical/fs/voh/voh.h>
 #include <sys/collection/arraylist/arraylist.h>
 #include <sys/debug/assert.h>
+#include <sys/fs/dcache.h>
 #include <sys/kmalloc/kmalloc.h>
 #include <sys/kprintf/kprintf.h>
 #include <sys/obj/object/object.h>
@@ -46,7 +47,7 @@ uint8_t voh_uninit(struct object* obj) {
     filesystem_node_map_clear(object_data->filesystem_nodes);
     filesystem_node_map_delete(object_data->filesystem_nodes);
     kfree(obj->api);
-    kfree(object_data->root_node);
+    filesystem_node_delete(object_data->root_node);
     kfree(object_data->children);
     kfree(object_data);
     return 1;
@@ -59,27 +60,27 @@ struct filesystem_node* voh_get_root_node(struct object* filesystem_obj) {
     return object_data->root_node;
 }
 
-uint32_t voh_read(struct filesystem_node* fs_node, uint8_t* data, uint32_t data_size) {
+/*
+* the only node voh owns is its root; the nodes under it belong to the filesystems it holds, and fsfacade reads
+* and writes those through their own filesystem
+*/
+uint32_t voh_read(struct filesystem_node* fs_node, uint64_t offset, uint8_t* data, uint32_t data_size) {
     ASSERT_NOT_NULL(fs_node);
     ASSERT_NOT_NULL(fs_node->filesystem_obj);
     ASSERT_NOT_NULL(fs_node->filesystem_obj->object_data);
 
     ASSERT_NOT_NULL(data);
     ASSERT_NOT_NULL(data_size);
-    // read from node. we cant read from the root node, but we can find underlying file and folder nodes
-    PANIC("not implemented");
     return 0;
 }
 
-uint32_t voh_write(struct filesystem_node* fs_node, const uint8_t* data, uint32_t data_size) {
+uint32_t voh_write(struct filesystem_node* fs_node, uint64_t offset, const uint8_t* data, uint32_t data_size) {
     ASSERT_NOT_NULL(fs_node);
     ASSERT_NOT_NULL(fs_node->filesystem_obj);
     ASSERT_NOT_NULL(fs_node->filesystem_obj->object_data);
 
     ASSERT_NOT_NULL(data);
     ASSERT_NOT_NULL(data_size);
-    // write to node. we cant write to the root node, but we can find underlying file and folder nodes
-    PANIC("not implemented");
     return 0;
 }
 
@@ -186,7 +187,7 @@ struct object* voh_attach(uint8_t* name) {
         filesystem_node_map_clear(object_data->filesystem_nodes);
         filesystem_node_map_delete(object_data->filesystem_nodes);
         kfree(object_data->children);
-        kfree(object_data->root_node);
+        filesystem_node_delete(object_data->root_node);
         kfree(object_data);
         kfree(api);
         kfree(objectinstance);
@@ -214,6 +215,8 @@ void voh_add_child(struct object* voh_device, struct filesystem_node* child_node
     child_node->parent = object_data->root_node->id;
     filesystem_node_map_insert(object_data->filesystem_nodes, child_node);
     arraylist_add(object_data->children, child_node);
+    // a lookup may already have found the name missing
+    dcache_invalidate_directory(object_data->root_node->id);
     //    kprintf("adding voh child id %llu with name %s \n", child_node->id, child_node->name);
 }
 
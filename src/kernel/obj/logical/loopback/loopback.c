@@ -0,0 +1,203 @@
+//*****************************************************************
+// This file is part of CosmOS                                    *
+// Copyright (C) 2021 Tom Everett                                 *
+// Released under the stated terms in the file LICENSE            *
+// See the file "LICENSE" in the source distribution for details  *
+// ****************************************************************
+
+#include <obj/logical/loopback/loopback.h>
+#include <sys/debug/assert.h>
+#include <sys/kmalloc/kmalloc.h>
+#include <sys/kprintf/kprintf.h>
+#include <sys/netbuf/netbuf.h>
+#include <sys/obj/object/object.h>
+#include <sys/obj/objectinterface/objectinterface_nic.h>
+#include <sys/obj/objectmgr/objectmgr.h>
+#include <sys/obj/objecttype/objectype.h>
+#include <sys/string/mem.h>
+#include <types.h>
+
+struct loopback_objectdata {
+    struct object* receiver;
+    nic_receive_function receive;
+    /*
+     * frames sent while we are delivering (a reply, say) are queued, and delivered by the outer call.
+     * this keeps the stack from recursing through itself.
+     */
+    struct netbuf* head;
+    struct netbuf* tail;
+    bool delivering;
+    uint16_t drop;    // frames still to be lost; see loopback_set_loss
+    uint8_t offload;  // NIC_OFFLOAD_* flags we claim; see loopback_set_offload
+};
+
+/*
+ * perform device instance specific init here
+ */
+uint8_t loopback_init(struct object* obj) {
+    ASSERT_NOT_NULL(obj);
+    kprintf("Init %s (%s)\n", obj->description, obj->name);
+    return 1;
+}
+
+/*
+ * perform device instance specific uninit here, like removing API structs and Device data
+ */
+uint8_t loopback_uninit(struct object* obj) {
+    ASSERT_NOT_NULL(obj);
+    ASSERT_NOT_NULL(obj->object_data);
+    kprintf("Uninit %s (%s)\n", obj->description, obj->name);
+    struct loopback_objectdata* object_data = (struct loopback_objectdata*)obj->object_data;
+    while (0 != object_data->head) {
+        struct netbuf* frame = object_data->head;
+        object_data->head = frame->next;
+        netbuf_release(frame);
+    }
+    kfree(obj->api);
+    kfree(obj->object_data);
+    return 1;
+}
+
+void loopback_read(struct object* obj, uint8_t* data, uint16_t size) {
+    ASSERT_NOT_NULL(obj);
+    ASSERT_NOT_NULL(data);
+    // frames are delivered to the receiver as they are written
+}
+
+/*
+ * the frame written is the frame received; nothing is copied
+ */
+void loopback_write(struct object* obj, struct netbuf* frame) {
+    ASSERT_NOT_NULL(obj);
+    ASSERT_NOT_NULL(obj->object_data);
+    ASSERT_NOT_NULL(frame);
+    struct loopback_objectdata* object_data = (struct loopback_objectdata*)obj->object_data;
+
+    // no one listening
+    if (0 == object_data->receive) {
+        netbuf_release(frame);
+        return;
+    }
+    if (object_data->drop > 0) {
+        object_data->drop--;
+        netbuf_release(frame);
+        return;
+    }
+
+    frame->next = 0;
+    if (0 == object_data->tail) {
+        object_data->head = frame;
+    } else {
+        object_data->tail->next = frame;
+    }
+    object_data->tail = frame;
+
+    if (object_data->delivering) {
+        return;
+    }
+    object_data->delivering = true;
+    while (0 != object_data->head) {
+        frame = object_data->head;
+        object_data->head = frame->next;
+        if (0 == object_data->head) {
+            object_data->tail = 0;
+        }
+        frame->next = 0;
+        (*object_data->receive)(object_data->receiver, frame);
+        netbuf_release(frame);
+    }
+    object_data->delivering = false;
+}
+
+void loopback_set_receiver(struct object* obj, struct object* receiver, nic_receive_function receive) {
+    ASSERT_NOT_NULL(obj);
+    ASSERT_NOT_NULL(obj->object_data);
+    struct loopback_objectdata* object_data = (struct loopback_objectdata*)obj->object_data;
+    object_data->receiver = receiver;
+    object_data->receive = receive;
+}
+
+/*
+ * silently lose the next frames written, so tests can exercise retransmission
+ */
+void loopback_set_loss(struct object* obj, uint16_t frames) {
+    ASSERT_NOT_NULL(obj);
+    ASSERT_NOT_NULL(obj->object_data);
+    ASSERT(obj->objectype == OBJECT_TYPE_LOOPBACK);
+    struct loopback_objectdata* object_data = (struct loopback_objectdata*)obj->object_data;
+    object_data->drop = frames;
+}
+
+/*
+ * a frame never leaves memory, so there is nothing to checksum. by default we say we can't, so the stack checks
+ * its own checksums; with NIC_OFFLOAD_TX_CSUM, a partial checksum is delivered as it is, and trusted
+ */
+void loopback_set_offload(struct object* obj, uint8_t offload) {
+    ASSERT_NOT_NULL(obj);
+    ASSERT_NOT_NULL(obj->object_data);
+    ASSERT(obj->objectype == OBJECT_TYPE_LOOPBACK);
+    struct loopback_objectdata* object_data = (struct loopback_objectdata*)obj->object_data;
+    object_data->offload = offload;
+}
+
+uint8_t loopback_offload(struct object* obj) {
+    ASSERT_NOT_NULL(obj);
+    ASSERT_NOT_NULL(obj->object_data);
+    struct loopback_objectdata* object_data = (struct loopback_objectdata*)obj->object_data;
+    return object_data->offload;
+}
+
+void loopback_hw_address(struct object* obj, uint8_t* hw_address) {
+    ASSERT_NOT_NULL(obj);
+    ASSERT_NOT_NULL(hw_address);
+    memzero(hw_address, NIC_HW_ADDRESS_LEN);
+}
+
+struct object* loopback_attach() {
+    /*
+     * register device
+     */
+    struct object* objectinstance = object_new_object();
+    objectinstance->init = &loopback_init;
+    objectinstance->uninit = &loopback_uninit;
+    objectinstance->pci = 0;
+    objectinstance->objectype = OBJECT_TYPE_LOOPBACK;
+    objectmgr_set_object_description(objectinstance, "Loopback NIC");
+    /*
+     * the device api
+     */
+    struct objectinterface_nic* api = (struct objectinterface_nic*)kmalloc(sizeof(struct objectinterface_nic));
+    memzero((uint8_t*)api, sizeof(struct objectinterface_nic));
+    api->read = &loopback_read;
+    api->write = &loopback_write;
+    api->set_receiver = &loopback_set_receiver;
+    api->hw_address = &loopback_hw_address;
+    api->offload = &loopback_offload;
+    objectinstance->api = api;
+    /*
+     * device data
+     */
+    struct loopback_objectdata* object_data =
+        (struct loopback_objectdata*)kmalloc(sizeof(struct loopback_objectdata));
+    memzero((uint8_t*)object_data, sizeof(struct loopback_objectdata));
+    objectinstance->object_data = object_data;
+    /*
+     * register
+     */
+    if (0 != objectmgr_attach_object(objectinstance)) {
+        /*
+        * return device
+        */
+        return objectinstance;
+    } else {
+        kfree(api);
+        kfree(object_data);
+        kfree(objectinstance);
+        return 0;
+    }
+}
+
+void loopback_detach(struct object* obj) {
+    ASSERT_NOT_NULL(obj);
+    objectmgr_detach_object(obj);
+}
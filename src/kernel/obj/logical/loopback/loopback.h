@@ -0,0 +1,22 @@
+//*****************************************************************
+// This file is part of CosmOS                                    *
+// Copyright (C) 2021 Tom Everett                                 *
+// Released under the stated terms in the file LICENSE            *
+// See the file "LICENSE" in the source distribution for details  *
+// ****************************************************************
+/*
+ * a NIC that receives everything it sends.  useful for testing the network stack without a network
+ */
+#ifndef _LOOPBACK_H
+#define _LOOPBACK_H
+
+#include <types.h>
+
+struct object;
+
+struct object* loopback_attach();
+void loopback_detach(struct object* obj);
+void loopback_set_loss(struct object* obj, uint16_t frames);
+void loopback_set_offload(struct object* obj, uint8_t offload);
+
+#endif
@@ -5,20 +5,56 @@
 // See the file "LICENSE" in the source distribution for details  *
 // ****************************************************************
 
+#include <obj/logical/ethernet/ethernet.h>
+#include <obj/logical/tcpip/arp/arpdev.h>
+#include <obj/logical/tcpip/net_endian.h>
 #include <sys/debug/assert.h>
 #include <sys/kmalloc/kmalloc.h>
 #include <sys/kprintf/kprintf.h>
+#include <sys/netbuf/netbuf.h>
 #include <sys/obj/object/object.h>
 #include <sys/obj/objectinterface/objectinterface_arp.h>
+#include <sys/obj/objectinterface/objectinterface_ethernet.h>
+#include <sys/obj/objectinterface/objectinterface_ip.h>
 #include <sys/obj/objectmgr/objectmgr.h>
 #include <sys/obj/objecttype/objectype.h>
 #include <sys/panic/panic.h>
 #include <sys/string/mem.h>
 #include <types.h>
 
+#define ARP_CACHE_SIZE 32
+#define ARP_PENDING_MAX 4  // frames held for each address we are still asking about
+
+#define ARP_ENTRY_FREE 0
+#define ARP_ENTRY_PENDING 1
+#define ARP_ENTRY_RESOLVED 2
+
+/*
+ * a frame waiting for its destination to be resolved
+ */
+struct arp_pending {
+    struct arp_pending* next;
+    uint16_t type;
+    struct netbuf* frame;
+};
+
+struct arp_entry {
+    uint32_t ip;
+    uint8_t hw[ARP_HLEN];
+    uint8_t state;
+    uint8_t pending_count;
+    uint64_t last_used;
+    struct arp_pending* pending;
+};
+
 struct arp_objectdata {
     struct object* ethernet_device;
-} __attribute__((packed));
+    uint32_t ip;
+    uint64_t clock;  // bumped on every cache access, for picking the least recently used entry
+    struct arp_entry cache[ARP_CACHE_SIZE];
+};
+
+void arp_input(struct object* obj, struct eth_hdr* eth, struct netbuf* payload);
 
 /*
  * perform device instance specific init here
@@ -27,16 +63,35 @@ uint8_t arp_init(struct object* obj) {
     ASSERT_NOT_NULL(obj);
     ASSERT_NOT_NULL(obj->object_data);
     struct arp_objectdata* object_data = (struct arp_objectdata*)obj->object_data;
+    struct objectinterface_ethernet* ether_api = (struct objectinterface_ethernet*)object_data->ethernet_device->api;
+    (*ether_api->register_protocol)(object_data->ethernet_device, ETHERNET_TYPE_ARP, obj, &arp_input);
     kprintf("Init %s on %s (%s)\n", obj->description, object_data->ethernet_device->name, obj->name);
     return 1;
 }
 
+void arp_entry_clear(struct arp_entry* entry) {
+    while (0 != entry->pending) {
+        struct arp_pending* p = entry->pending;
+        entry->pending = p->next;
+        netbuf_release(p->frame);
+        kfree(p);
+    }
+    memzero((uint8_t*)entry, sizeof(struct arp_entry));
+}
+
 /*
  * perform device instance specific uninit here, like removing API structs and Device data
  */
 uint8_t arp_uninit(struct object* obj) {
     ASSERT_NOT_NULL(obj);
+    ASSERT_NOT_NULL(obj->object_data);
     kprintf("Uninit %s (%s)\n", obj->description, obj->name);
+    struct arp_objectdata* object_data = (struct arp_objectdata*)obj->object_data;
+    struct objectinterface_ethernet* ether_api = (struct objectinterface_ethernet*)object_data->ethernet_device->api;
+    (*ether_api->register_protocol)(object_data->ethernet_device, ETHERNET_TYPE_ARP, 0, 0);
+    for (uint16_t i = 0; i < ARP_CACHE_SIZE; i++) {
+        arp_entry_clear(&(object_data->cache[i]));
+    }
     kfree(obj->api);
     kfree(obj->object_data);
 
@@ -44,20 +99,189 @@ uint8_t arp_uninit(struct object* obj) {
 }
 
 /*
-* perform an ARP request
-*/
-void arp_request(struct object* obj, struct arp* request, struct arp* response) {
+ * protocol addresses are big-endian byte arrays in the packet
+ */
+uint32_t arp_get_ip(uint8_t* bytes) {
+    return (((uint32_t)bytes[0]) << 24) | (((uint32_t)bytes[1]) << 16) | (((uint32_t)bytes[2]) << 8) | bytes[3];
+}
+
+void arp_put_ip(uint8_t* bytes, uint32_t ip) {
+    bytes[0] = (ip >> 24) & 0xFF;
+    bytes[1] = (ip >> 16) & 0xFF;
+    bytes[2] = (ip >> 8) & 0xFF;
+    bytes[3] = ip & 0xFF;
+}
+
+struct arp_entry* arp_find_entry(struct arp_objectdata* object_data, uint32_t ip) {
+    for (uint16_t i = 0; i < ARP_CACHE_SIZE; i++) {
+        struct arp_entry* entry = &(object_data->cache[i]);
+        if ((ARP_ENTRY_FREE != entry->state) && (entry->ip == ip)) {
+            entry->last_used = object_data->clock++;
+            return entry;
+        }
+    }
+    return 0;
+}
+
+/*
+ * a free entry if there is one, otherwise the least recently used
+ */
+struct arp_entry* arp_new_entry(struct arp_objectdata* object_data, uint32_t ip) {
+    struct arp_entry* victim = &(object_data->cache[0]);
+    for (uint16_t i = 0; i < ARP_CACHE_SIZE; i++) {
+        struct arp_entry* entry = &(object_data->cache[i]);
+        if (ARP_ENTRY_FREE == entry->state) {
+            victim = entry;
+            break;
+        }
+        if (entry->last_used < victim->last_used) {
+            victim = entry;
+        }
+    }
+    arp_entry_clear(victim);
+    victim->ip = ip;
+    victim->state = ARP_ENTRY_PENDING;
+    victim->last_used = object_data->clock++;
+    return victim;
+}
+
+void arp_send(struct arp_objectdata* object_data, uint16_t opcode, uint8_t* dest_hw, uint32_t dest_ip) {
+    struct objectinterface_ethernet* ether_api = (struct objectinterface_ethernet*)object_data->ethernet_device->api;
+    struct netbuf* nb = netbuf_new(NETBUF_HEADROOM);
+    if (0 == nb) {
+        // out of buffers. a request is sent again by whoever is still waiting, and the peer asks again for a reply
+        return;
+    }
+    struct arp* packet = (struct arp*)netbuf_put(nb, sizeof(struct arp));
+    arp_packet_init(packet, opcode);
+    (*ether_api->hw_address)(object_data->ethernet_device, packet->source_hardware);
+    arp_put_ip(packet->source_protocol, object_data->ip);
+    arp_put_ip(packet->dest_protocol, dest_ip);
+    if (ARP_REPLY == opcode) {
+        memcpy(packet->dest_hardware, dest_hw, ARP_HLEN);
+    }
+    (*ether_api->write)(object_data->ethernet_device, dest_hw, ETHERNET_TYPE_ARP, nb);
+}
+
+/*
+ * the entry just got its hardware address; send what was waiting for it
+ */
+void arp_flush_pending(struct arp_objectdata* object_data, struct arp_entry* entry) {
+    struct objectinterface_ethernet* ether_api = (struct objectinterface_ethernet*)object_data->ethernet_device->api;
+    struct arp_pending* p = entry->pending;
+    entry->pending = 0;
+    entry->pending_count = 0;
+    while (0 != p) {
+        struct arp_pending* next = p->next;
+        (*ether_api->write)(object_data->ethernet_device, entry->hw, p->type, p->frame);
+        kfree(p);
+        p = next;
+    }
+}
+
+void arp_set_address(struct object* obj, uint32_t ip) {
+    ASSERT_NOT_NULL(obj);
+    ASSERT_NOT_NULL(obj->object_data);
+    struct arp_objectdata* object_data = (struct arp_objectdata*)obj->object_data;
+    object_data->ip = ip;
+}
+
+uint8_t arp_resolve(struct object* obj, uint32_t ip, uint8_t* hw) {
+    ASSERT_NOT_NULL(obj);
+    ASSERT_NOT_NULL(obj->object_data);
+    ASSERT_NOT_NULL(hw);
+    struct arp_objectdata* object_data = (struct arp_objectdata*)obj->object_data;
+    struct arp_entry* entry = arp_find_entry(object_data, ip);
+    if ((0 != entry) && (ARP_ENTRY_RESOLVED == entry->state)) {
+        memcpy(hw, entry->hw, ARP_HLEN);
+        return 1;
+    }
+    return 0;
+}
+
+void arp_output(struct object* obj, uint32_t ip, uint16_t type, struct netbuf* frame) {
+    ASSERT_NOT_NULL(obj);
+    ASSERT_NOT_NULL(obj->object_data);
+    ASSERT_NOT_NULL(frame);
+    struct arp_objectdata* object_data = (struct arp_objectdata*)obj->object_data;
+    struct objectinterface_ethernet* ether_api = (struct objectinterface_ethernet*)object_data->ethernet_device->api;
+
+    if (IP_BROADCAST == ip) {
+        (*ether_api->write)(object_data->ethernet_device, ethernet_broadcast_hw, type, frame);
+        return;
+    }
+
+    struct arp_entry* entry = arp_find_entry(object_data, ip);
+    if ((0 != entry) && (ARP_ENTRY_RESOLVED == entry->state)) {
+        (*ether_api->write)(object_data->ethernet_device, entry->hw, type, frame);
+        return;
+    }
+    if (0 == entry) {
+        entry = arp_new_entry(object_data, ip);
+    }
+
+    // hold the frame, unless too many are already waiting
+    if (entry->pending_count < ARP_PENDING_MAX) {
+        struct arp_pending* p = (struct arp_pending*)kmalloc(sizeof(struct arp_pending));
+        p->next = 0;
+        p->type = type;
+        p->frame = frame;
+        struct arp_pending** tail = &(entry->pending);
+        while (0 != *tail) {
+            tail = &((*tail)->next);
+        }
+        *tail = p;
+        entry->pending_count++;
+    } else {
+        netbuf_release(frame);
+    }
+
+    // ask (again)
+    arp_send(object_data, ARP_REQUEST, ethernet_broadcast_hw, ip);
+}
+
+/*
+ * ARP packets from the ethernet object; see RFC 826 "Packet Reception"
+ */
+void arp_input(struct object* obj, struct eth_hdr* eth, struct netbuf* payload) {
     ASSERT_NOT_NULL(obj);
     ASSERT_NOT_NULL(obj->object_data);
-    // get our device data for this device
-    //   struct arp_objectdata* object_data = (struct arp_objectdata*)obj->object_data;
-    // get the api for the underlying ethernet device
-    //   struct objectinterface_ethernet* ether_api = (struct objectinterface_ethernet*)object_data->ethernet_device->api;
-    PANIC("Um, what HW addresses do I put in here?");
-    // send
-    //  (*ether_api->write)(object_data->ethernet_device, (uint8_t*)request, sizeof(struct arp));
-    // receive. I presume this blocks?
-    // (*ether_api->read)(object_data->ethernet_device, (uint8_t*)response, sizeof(struct arp));
+    ASSERT_NOT_NULL(payload);
+    struct arp_objectdata* object_data = (struct arp_objectdata*)obj->object_data;
+
+    if (payload->len < sizeof(struct arp)) {
+        return;
+    }
+    struct arp* packet = (struct arp*)payload->data;
+    if ((switch_endian16(packet->htype) != ARP_ETHERNET) || (switch_endian16(packet->ptype) != ARP_IP) ||
+        (packet->hlen != ARP_HLEN) || (packet->plen != ARP_PLEN)) {
+        return;
+    }
+    uint32_t source_ip = arp_get_ip(packet->source_protocol);
+    uint32_t dest_ip = arp_get_ip(packet->dest_protocol);
+
+    // update the sender if we know of it already
+    bool merged = false;
+    struct arp_entry* entry = arp_find_entry(object_data, source_ip);
+    if (0 != entry) {
+        memcpy(entry->hw, packet->source_hardware, ARP_HLEN);
+        entry->state = ARP_ENTRY_RESOLVED;
+        arp_flush_pending(object_data, entry);
+        merged = true;
+    }
+
+    if ((0 == object_data->ip) || (dest_ip != object_data->ip)) {
+        return;
+    }
+    // it's for us, so the sender is probably about to talk to us
+    if (!merged) {
+        entry = arp_new_entry(object_data, source_ip);
+        memcpy(entry->hw, packet->source_hardware, ARP_HLEN);
+        entry->state = ARP_ENTRY_RESOLVED;
+    }
+    if (switch_endian16(packet->opcode) == ARP_REQUEST) {
+        arp_send(object_data, ARP_REPLY, packet->source_hardware, source_ip);
+    }
 }
 
 struct object* arp_attach(struct object* ethernet_device) {
@@ -78,12 +302,15 @@ struct object* arp_attach(struct object* ethernet_device) {
      */
     struct objectinterface_arp* api = (struct objectinterface_arp*)kmalloc(sizeof(struct objectinterface_arp));
     memzero((uint8_t*)api, sizeof(struct objectinterface_arp));
-    api->request = &arp_request;
+    api->set_address = &arp_set_address;
+    api->resolve = &arp_resolve;
+    api->output = &arp_output;
     objectinstance->api = api;
     /*
      * device data
      */
     struct arp_objectdata* object_data = (struct arp_objectdata*)kmalloc(sizeof(struct arp_objectdata));
+    memzero((uint8_t*)object_data, sizeof(struct arp_objectdata));
     object_data->ethernet_device = ethernet_device;
     objectinstance->object_data = object_data;
     /*
@@ -122,11 +349,11 @@ void arp_detach(struct object* obj) {
 
 void arp_packet_init(struct arp* a, uint16_t opcode) {
     ASSERT_NOT_NULL(a);
-    ASSERT(sizeof(struct arp) == 96);
+    ASSERT(sizeof(struct arp) == 28);
     memset((uint8_t*)a, 0, sizeof(struct arp));
-    a->htype = ARP_ETHERNET;
-    a->ptype = ARP_IP;
+    a->htype = switch_endian16(ARP_ETHERNET);
+    a->ptype = switch_endian16(ARP_IP);
     a->hlen = ARP_HLEN;
     a->plen = ARP_PLEN;
-    a->opcode = opcode;
+    a->opcode = switch_endian16(opcode);
 }
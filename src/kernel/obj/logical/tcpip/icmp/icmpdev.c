@@ -9,7 +9,7 @@
 #include <sys/kmalloc/kmalloc.h>
 #include <sys/kprintf/kprintf.h>
 #include <sys/obj/object/object.h>
-#include <sys/obj/objectinterface/objectinterface_ip.h>
+#include <sys/obj/objectinterface/objectinterface_icmp.h>
 #include <sys/obj/objectmgr/objectmgr.h>
 #include <sys/obj/objecttype/objectype.h>
 #include <sys/string/mem.h>
@@ -69,8 +69,8 @@ struct object* icmp_attach(struct object* ethernet_device) {
     /*
      * the device api
      */
-    struct objectinterface_ip* api = (struct objectinterface_ip*)kmalloc(sizeof(struct objectinterface_ip));
-    memzero((uint8_t*)api, sizeof(struct objectinterface_ip));
+    struct objectinterface_icmp* api = (struct objectinterface_icmp*)kmalloc(sizeof(struct objectinterface_icmp));
+    memzero((uint8_t*)api, sizeof(struct objectinterface_icmp));
     api->read = &icmp_read;
     api->write = &icmp_write;
 
@@ -5,19 +5,44 @@
 // See the file "LICENSE" in the source distribution for details  *
 // ****************************************************************
 
+#include <obj/logical/tcpip/ip/ipdev.h>
+#include <obj/logical/tcpip/net_endian.h>
 #include <sys/debug/assert.h>
 #include <sys/kmalloc/kmalloc.h>
 #include <sys/kprintf/kprintf.h>
+#include <sys/netbuf/netbuf.h>
 #include <sys/obj/object/object.h>
+#include <sys/obj/objectinterface/objectinterface_arp.h>
+#include <sys/obj/objectinterface/objectinterface_ethernet.h>
 #include <sys/obj/objectinterface/objectinterface_ip.h>
 #include <sys/obj/objectmgr/objectmgr.h>
 #include <sys/obj/objecttype/objectype.h>
+#include <sys/panic/panic.h>
 #include <sys/string/mem.h>
 #include <types.h>
 
+#define IP_MAX_PROTOCOLS 4
+
+struct ip_protocol {
+    uint8_t protocol;
+    struct object* handler;
+    ip_input_function input;
+};
+
 struct ip_objectdata {
     struct object* ethernet_device;
-} __attribute__((packed));
+    struct object* arp_device;
+    // host byte order
+    uint32_t address;
+    uint32_t netmask;
+    uint32_t gateway;
+    struct ip_protocol protocols[IP_MAX_PROTOCOLS];
+    uint64_t rx_datagrams;
+    uint64_t rx_dropped;
+    uint64_t tx_datagrams;
+};
+
+void ip_input(struct object* obj, struct eth_hdr* eth, struct netbuf* payload);
 
 /*
  * perform device instance specific init here
@@ -26,6 +51,8 @@ uint8_t ip_init(struct object* obj) {
     ASSERT_NOT_NULL(obj);
     ASSERT_NOT_NULL(obj->object_data);
     struct ip_objectdata* object_data = (struct ip_objectdata*)obj->object_data;
+    struct objectinterface_ethernet* ether_api = (struct objectinterface_ethernet*)object_data->ethernet_device->api;
+    (*ether_api->register_protocol)(object_data->ethernet_device, ETHERNET_TYPE_IP, obj, &ip_input);
     kprintf("Init %s on %s (%s)\n", obj->description, object_data->ethernet_device->name, obj->name);
     return 1;
 }
@@ -35,27 +62,158 @@ uint8_t ip_init(struct object* obj) {
  */
 uint8_t ip_uninit(struct object* obj) {
     ASSERT_NOT_NULL(obj);
+    ASSERT_NOT_NULL(obj->object_data);
     kprintf("Uninit %s (%s)\n", obj->description, obj->name);
+    struct ip_objectdata* object_data = (struct ip_objectdata*)obj->object_data;
+    struct objectinterface_ethernet* ether_api = (struct objectinterface_ethernet*)object_data->ethernet_device->api;
+    (*ether_api->register_protocol)(object_data->ethernet_device, ETHERNET_TYPE_IP, 0, 0);
     kfree(obj->api);
     kfree(obj->object_data);
 
     return 1;
 }
 
-void ip_read(struct object* obj, uint8_t* data, uint16_t size) {
+/*
+ * is daddr (host byte order) one of ours
+ */
+bool ip_is_local(struct ip_objectdata* object_data, uint32_t daddr) {
+    if (0 == object_data->address) {
+        return false;
+    }
+    return (daddr == object_data->address) || (daddr == IP_BROADCAST) ||
+           (daddr == (object_data->address | ~(object_data->netmask)));
+}
+
+/*
+ * datagrams from the ethernet object. check the header, and pass the payload to whoever registered the protocol
+ */
+void ip_input(struct object* obj, struct eth_hdr* eth, struct netbuf* payload) {
+    ASSERT_NOT_NULL(obj);
+    ASSERT_NOT_NULL(obj->object_data);
+    ASSERT_NOT_NULL(payload);
+    struct ip_objectdata* object_data = (struct ip_objectdata*)obj->object_data;
+    object_data->rx_datagrams++;
+
+    // the header has to be in the first segment
+    if (payload->len < IP_HEADER_LEN) {
+        object_data->rx_dropped++;
+        return;
+    }
+    struct ip_header* header = (struct ip_header*)payload->data;
+    uint16_t header_len = header->ihl * 4;
+    uint16_t total_len = switch_endian16(header->len);
+    if ((header->version != IP_VERSION_4) || (header_len < IP_HEADER_LEN) || (header_len > payload->len) ||
+        (total_len < header_len) || (total_len > netbuf_length(payload))) {
+        object_data->rx_dropped++;
+        return;
+    }
+    // a valid header sums to zero
+    if (0 != ip_checksum((uint8_t*)header, header_len)) {
+        object_data->rx_dropped++;
+        return;
+    }
+    // we don't reassemble
+    if (0 != (switch_endian16(header->frag_off) & (IP_FLAG_MF | IP_FRAG_OFFSET_MASK))) {
+        object_data->rx_dropped++;
+        return;
+    }
+    if (!ip_is_local(object_data, switch_endian32(header->daddr))) {
+        object_data->rx_dropped++;
+        return;
+    }
+
+    for (uint8_t i = 0; i < IP_MAX_PROTOCOLS; i++) {
+        struct ip_protocol* p = &(object_data->protocols[i]);
+        if ((0 != p->input) && (p->protocol == header->proto)) {
+            // anything past total_len is link layer padding
+            netbuf_trim(payload, total_len);
+            netbuf_pull(payload, header_len);
+            (*p->input)(p->handler, header, payload);
+            return;
+        }
+    }
+    object_data->rx_dropped++;
+}
+
+/*
+ * send a datagram. there is no fragmentation, so size must fit in one frame.
+ * datagrams to our own address go out the interface like any other, which is what a loopback NIC wants.
+ */
+void ip_write(struct object* obj, uint32_t dest, uint8_t protocol, struct netbuf* payload) {
+    ASSERT_NOT_NULL(obj);
+    ASSERT_NOT_NULL(obj->object_data);
+    ASSERT_NOT_NULL(payload);
+    uint16_t size = netbuf_length(payload);
+    ASSERT((size + IP_HEADER_LEN) <= ETHERNET_MTU);
+    struct ip_objectdata* object_data = (struct ip_objectdata*)obj->object_data;
+    struct objectinterface_arp* arp_api = (struct objectinterface_arp*)object_data->arp_device->api;
+
+    struct ip_header* header = (struct ip_header*)netbuf_push(payload, IP_HEADER_LEN);
+    ip_header_init(header, IP_HEADER_LEN + size, protocol, object_data->address, dest);
+
+    // off the subnet, go via the gateway
+    uint32_t next_hop = dest;
+    if ((IP_BROADCAST != dest) && (0 != object_data->gateway) &&
+        ((dest & object_data->netmask) != (object_data->address & object_data->netmask))) {
+        next_hop = object_data->gateway;
+    }
+
+    object_data->tx_datagrams++;
+    (*arp_api->output)(object_data->arp_device, next_hop, ETHERNET_TYPE_IP, payload);
+}
+
+void ip_configure(struct object* obj, uint32_t address, uint32_t netmask, uint32_t gateway) {
     ASSERT_NOT_NULL(obj);
     ASSERT_NOT_NULL(obj->object_data);
-    //  struct ip_objectdata* object_data = (struct ip_objectdata*)obj->object_data;
+    struct ip_objectdata* object_data = (struct ip_objectdata*)obj->object_data;
+    struct objectinterface_arp* arp_api = (struct objectinterface_arp*)object_data->arp_device->api;
+    object_data->address = address;
+    object_data->netmask = netmask;
+    object_data->gateway = gateway;
+    (*arp_api->set_address)(object_data->arp_device, address);
+}
+
+uint32_t ip_address(struct object* obj) {
+    ASSERT_NOT_NULL(obj);
+    ASSERT_NOT_NULL(obj->object_data);
+    struct ip_objectdata* object_data = (struct ip_objectdata*)obj->object_data;
+    return object_data->address;
 }
-void ip_write(struct object* obj, uint8_t* data, uint16_t size) {
+
+void ip_register_protocol(struct object* obj, uint8_t protocol, struct object* handler, ip_input_function input) {
     ASSERT_NOT_NULL(obj);
     ASSERT_NOT_NULL(obj->object_data);
-    //   struct ip_objectdata* object_data = (struct ip_objectdata*)obj->object_data;
+    struct ip_objectdata* object_data = (struct ip_objectdata*)obj->object_data;
+
+    // replace, or remove if input is null
+    for (uint8_t i = 0; i < IP_MAX_PROTOCOLS; i++) {
+        struct ip_protocol* p = &(object_data->protocols[i]);
+        if ((0 != p->input) && (p->protocol == protocol)) {
+            p->handler = handler;
+            p->input = input;
+            return;
+        }
+    }
+    if (0 == input) {
+        return;
+    }
+    for (uint8_t i = 0; i < IP_MAX_PROTOCOLS; i++) {
+        struct ip_protocol* p = &(object_data->protocols[i]);
+        if (0 == p->input) {
+            p->protocol = protocol;
+            p->handler = handler;
+            p->input = input;
+            return;
+        }
+    }
+    PANIC("Too many IP protocols registered");
 }
 
-struct object* ip_attach(struct object* ethernet_device) {
+struct object* ip_attach(struct object* ethernet_device, struct object* arp_device) {
     ASSERT_NOT_NULL(ethernet_device);
     ASSERT(ethernet_device->objectype == OBJECT_TYPE_ETHERNET);
+    ASSERT_NOT_NULL(arp_device);
+    ASSERT(arp_device->objectype == OBJECT_TYPE_ARP);
 
     /*
      * register device
@@ -71,15 +229,19 @@ struct object* ip_attach(struct object* ethernet_device) {
      */
     struct objectinterface_ip* api = (struct objectinterface_ip*)kmalloc(sizeof(struct objectinterface_ip));
     memzero((uint8_t*)api, sizeof(struct objectinterface_ip));
-    api->read = &ip_read;
+    api->configure = &ip_configure;
+    api->address = &ip_address;
     api->write = &ip_write;
+    api->register_protocol = &ip_register_protocol;
 
     objectinstance->api = api;
     /*
      * device data
      */
     struct ip_objectdata* object_data = (struct ip_objectdata*)kmalloc(sizeof(struct ip_objectdata));
+    memzero((uint8_t*)object_data, sizeof(struct ip_objectdata));
     object_data->ethernet_device = ethernet_device;
+    object_data->arp_device = arp_device;
     objectinstance->object_data = object_data;
     /*
      * register
@@ -89,6 +251,7 @@ struct object* ip_attach(struct object* ethernet_device) {
         * increase ref count of underlying device
         */
         objectmgr_increment_object_refcount(ethernet_device);
+        objectmgr_increment_object_refcount(arp_device);
         /*
         * return device
         */
@@ -109,6 +272,7 @@ void ip_detach(struct object* obj) {
     * decrease ref count of underlying device
     */
     objectmgr_decrement_object_refcount(object_data->ethernet_device);
+    objectmgr_decrement_object_refcount(object_data->arp_device);
     /*
     * detach
     */
@@ -118,32 +282,194 @@ void ip_detach(struct object* obj) {
 // https://www.saminiir.com/lets-code-tcp-ip-stack-2-ipv4-icmpv4/
 // https://tools.ietf.org/html/rfc1071
 
-uint16_t ip_checksum(uint16_t* addr, int count) {
-    uint32_t ret = 0;
-    while (count > 1) {
-        ret += *addr++;
+/*
+ * the sum is taken a word at a time, wherever the data starts
+ */
+typedef uint64_t __attribute__((aligned(1), may_alias)) ip_word64;
+typedef uint32_t __attribute__((aligned(1), may_alias)) ip_word32;
+typedef uint16_t __attribute__((aligned(1), may_alias)) ip_word16;
+
+/*
+ * ones' complement add: the carry out of the top goes back in at the bottom
+ */
+uint64_t ip_checksum_add64(uint64_t sum, uint64_t value) {
+    sum += value;
+    return sum + (sum < value);
+}
+
+/*
+ * add count bytes at addr to a running ones' complement sum. fold the result with ip_checksum_fold.
+ * the sum of 64 bit words folds down to the same 16 bit sum as adding 16 bit words (RFC 1071 section 2(C)),
+ * with a quarter of the adds
+ */
+uint32_t ip_checksum_add(uint32_t sum, uint8_t* data, int count) {
+    uint64_t acc = sum;
+    while (count >= 32) {
+        acc = ip_checksum_add64(acc, ((ip_word64*)data)[0]);
+        acc = ip_checksum_add64(acc, ((ip_word64*)data)[1]);
+        acc = ip_checksum_add64(acc, ((ip_word64*)data)[2]);
+        acc = ip_checksum_add64(acc, ((ip_word64*)data)[3]);
+        data += 32;
+        count -= 32;
+    }
+    while (count >= 8) {
+        acc = ip_checksum_add64(acc, *((ip_word64*)data));
+        data += 8;
+        count -= 8;
+    }
+    if (count >= 4) {
+        acc = ip_checksum_add64(acc, *((ip_word32*)data));
+        data += 4;
+        count -= 4;
+    }
+    if (count >= 2) {
+        acc = ip_checksum_add64(acc, *((ip_word16*)data));
+        data += 2;
         count -= 2;
     }
     if (count > 0) {
-        ret += *(uint8_t*)addr;
+        acc = ip_checksum_add64(acc, *data);
+    }
+    // down to 32 bits; the second add takes any carry out of the first
+    acc = (acc & 0xFFFFFFFF) + (acc >> 32);
+    acc = (acc & 0xFFFFFFFF) + (acc >> 32);
+    return (uint32_t)acc;
+}
+
+uint16_t ip_checksum_fold(uint32_t sum) {
+    while (sum >> 16) {
+        sum = (sum & 0xffff) + (sum >> 16);
+    }
+    return ~sum;
+}
+
+uint16_t ip_checksum(uint8_t* data, int count) {
+    return ip_checksum_fold(ip_checksum_add(0, data, count));
+}
+
+/*
+ * incremental update (RFC 1624 eqn. 3), for a 16 or 32 bit field changed from old_value to new_value. the values
+ * are as they are in the packet, in network byte order
+ */
+uint16_t ip_checksum_update16(uint16_t csum, uint16_t old_value, uint16_t new_value) {
+    uint32_t sum = (uint16_t)~csum;
+    sum += (uint16_t)~old_value;
+    sum += new_value;
+    return ip_checksum_fold(sum);
+}
+
+uint16_t ip_checksum_update32(uint16_t csum, uint32_t old_value, uint32_t new_value) {
+    uint32_t sum = (uint16_t)~csum;
+    sum += (uint16_t)~(old_value & 0xFFFF);
+    sum += (uint16_t)~(old_value >> 16);
+    sum += new_value & 0xFFFF;
+    sum += new_value >> 16;
+    return ip_checksum_fold(sum);
+}
+
+/*
+ * add len bytes of a netbuf chain, from offset, to a running sum. a segment that starts on an odd byte of the
+ * packet has its sum byte swapped before it is added (RFC 1071 section 2(B)), so segments can be any length
+ */
+uint32_t ip_checksum_add_netbuf(uint32_t sum, struct netbuf* nb, uint16_t offset, uint16_t len) {
+    uint16_t done = 0;
+    while ((0 != nb) && (done < len)) {
+        if (offset >= nb->len) {
+            offset -= nb->len;
+        } else {
+            uint16_t n = nb->len - offset;
+            if (n > (len - done)) {
+                n = len - done;
+            }
+            uint16_t partial = ~ip_checksum_fold(ip_checksum_add(0, nb->data + offset, n));
+            if (0 != (done & 1)) {
+                partial = (partial << 8) | (partial >> 8);
+            }
+            sum += partial;
+            done += n;
+            offset = 0;
+        }
+        nb = nb->chain;
+    }
+    return sum;
+}
+
+/*
+ * the sum of the pseudo header (RFC 768, RFC 793) for a UDP or TCP segment of len bytes. saddr and daddr are in
+ * network byte order
+ */
+uint32_t ip_checksum_pseudo_header(uint32_t saddr, uint32_t daddr, uint8_t protocol, uint16_t len) {
+    uint16_t pseudo[6];
+    memcpy((uint8_t*)&(pseudo[0]), (uint8_t*)&saddr, sizeof(uint32_t));
+    memcpy((uint8_t*)&(pseudo[2]), (uint8_t*)&daddr, sizeof(uint32_t));
+    pseudo[4] = switch_endian16(protocol);
+    pseudo[5] = switch_endian16(len);
+    return ip_checksum_add(0, (uint8_t*)pseudo, sizeof(pseudo));
+}
+
+/*
+ * checksum over the pseudo header and the first len bytes of a UDP or TCP segment
+ */
+uint16_t ip_checksum_pseudo(uint32_t saddr, uint32_t daddr, uint8_t protocol, struct netbuf* nb, uint16_t len) {
+    uint32_t sum = ip_checksum_pseudo_header(saddr, daddr, protocol, len);
+    sum = ip_checksum_add_netbuf(sum, nb, 0, len);
+    return ip_checksum_fold(sum);
+}
+
+void ip_checksum_store(uint8_t* field, uint16_t csum) {
+    // the sum was taken over memory as it lies, so it goes back the same way
+    field[0] = csum & 0xFF;
+    field[1] = csum >> 8;
+}
+
+/*
+ * start the checksum of the UDP or TCP segment that is all of nb, leaving the sum over the segment itself for
+ * later: the NIC does it if it can, otherwise ip_checksum_complete on the way out.  csum_offset is where the
+ * checksum is in the segment header.  saddr and daddr are in network byte order
+ */
+void ip_checksum_partial(struct netbuf* nb, uint32_t saddr, uint32_t daddr, uint8_t protocol, uint16_t csum_offset) {
+    ASSERT_NOT_NULL(nb);
+    ASSERT((csum_offset + 2) <= nb->len);
+    uint32_t sum = ip_checksum_pseudo_header(saddr, daddr, protocol, netbuf_length(nb));
+    ip_checksum_store(nb->data + csum_offset, ~ip_checksum_fold(sum));
+    nb->csum = NETBUF_CSUM_PARTIAL;
+    nb->csum_start = netbuf_headroom(nb);
+    nb->csum_offset = csum_offset;
+}
+
+/*
+ * finish a checksum ip_checksum_partial started, in software
+ */
+void ip_checksum_complete(struct netbuf* nb) {
+    ASSERT_NOT_NULL(nb);
+    if (NETBUF_CSUM_PARTIAL != nb->csum) {
+        return;
     }
-    while (ret >> 16) {
-        ret = (ret & 0xffff) + (ret >> 16);
+    ASSERT(nb->csum_start >= netbuf_headroom(nb));
+    uint16_t start = nb->csum_start - netbuf_headroom(nb);
+    ASSERT((start + nb->csum_offset + 2) <= nb->len);
+    uint16_t csum = ip_checksum_fold(ip_checksum_add_netbuf(0, nb, start, netbuf_length(nb) - start));
+    // zero means "no checksum" to UDP. all ones is the same sum
+    if (0 == csum) {
+        csum = 0xFFFF;
     }
-    return ~ret;
+    ip_checksum_store(nb->data + start + nb->csum_offset, csum);
+    nb->csum = NETBUF_CSUM_NONE;
 }
 
 void ip_header_init(struct ip_header* header, uint16_t total_length, uint16_t protocol, uint32_t source,
                     uint32_t dest) {
     ASSERT_NOT_NULL(header);
-    ASSERT(sizeof(struct ip_header) == 20);  // ip_header should be 20 bytes
+    ASSERT(sizeof(struct ip_header) == IP_HEADER_LEN);  // ip_header should be 20 bytes
     memzero((uint8_t*)header, sizeof(struct ip_header));
-    header->version = 4;
+    header->version = IP_VERSION_4;
     header->ihl = 5;  // 20 bytes = 160 bits = 5x 32-bits
-    header->len = total_length;
-    header->ttl = 64;
+    header->len = switch_endian16(total_length);
+    // we never fragment, so the id can be zero (RFC 6864)
+    header->frag_off = switch_endian16(IP_FLAG_DF);
+    header->ttl = IP_DEFAULT_TTL;
     header->proto = protocol;
-    header->saddr = source;
-    header->daddr = dest;
-    header->csum = ip_checksum((uint16_t*)header, sizeof(struct ip_header));
+    header->saddr = switch_endian32(source);
+    header->daddr = switch_endian32(dest);
+    header->csum = ip_checksum((uint8_t*)header, sizeof(struct ip_header));
 }
@@ -13,10 +13,19 @@
 
 struct object;
 
-struct object* ip_attach(struct object* ethernet_device);
+struct object* ip_attach(struct object* ethernet_device, struct object* arp_device);
 void ip_detach(struct object* obj);
 
-uint16_t ip_checksum(uint16_t* addr, int count);
+uint32_t ip_checksum_add(uint32_t sum, uint8_t* data, int count);
+uint16_t ip_checksum_fold(uint32_t sum);
+uint16_t ip_checksum(uint8_t* data, int count);
+uint16_t ip_checksum_update16(uint16_t csum, uint16_t old_value, uint16_t new_value);
+uint16_t ip_checksum_update32(uint16_t csum, uint32_t old_value, uint32_t new_value);
+uint32_t ip_checksum_add_netbuf(uint32_t sum, struct netbuf* nb, uint16_t offset, uint16_t len);
+uint32_t ip_checksum_pseudo_header(uint32_t saddr, uint32_t daddr, uint8_t protocol, uint16_t len);
+uint16_t ip_checksum_pseudo(uint32_t saddr, uint32_t daddr, uint8_t protocol, struct netbuf* nb, uint16_t len);
+void ip_checksum_partial(struct netbuf* nb, uint32_t saddr, uint32_t daddr, uint8_t protocol, uint16_t csum_offset);
+void ip_checksum_complete(struct netbuf* nb);
 
 void ip_header_init(struct ip_header* header, uint16_t total_length, uint16_t protocol, uint32_t source, uint32_t dest);
 
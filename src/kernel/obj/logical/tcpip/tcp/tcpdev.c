@@ -5,19 +5,161 @@
 // See the file "LICENSE" in the source distribution for details  *
 // ****************************************************************
 
+#include <obj/logical/tcpip/ip/ipdev.h>
+#include <obj/logical/tcpip/net_endian.h>
+#include <obj/logical/tcpip/tcp/tcpdev.h>
+#include <sys/collection/spscring/spscring.h>
 #include <sys/debug/assert.h>
 #include <sys/kmalloc/kmalloc.h>
 #include <sys/kprintf/kprintf.h>
+#include <sys/netbuf/netbuf.h>
 #include <sys/obj/object/object.h>
+#include <sys/obj/objectinterface/objectinterface_ip.h>
 #include <sys/obj/objectinterface/objectinterface_tcp.h>
+#include <sys/obj/objectinterface/objectinterface_tick.h>
 #include <sys/obj/objectmgr/objectmgr.h>
 #include <sys/obj/objecttype/objectype.h>
 #include <sys/string/mem.h>
 #include <types.h>
 
+#define TCP_CONNECTION_BUCKETS 64  // connections are hashed on their 4-tuple
+#define TCP_WHEEL_SLOTS 64         // retransmit timer wheel; one slot per tick
+#define TCP_BACKLOG 8              // established connections waiting on accept, per listener
+#define TCP_BUFFER_SIZE 16384      // send and receive buffer per connection. no window scaling, so < 64k
+#define TCP_DEFAULT_MSS 536        // when the peer doesn't send the option (RFC 879)
+#define TCP_MSS_OPTION_LEN 4
+#define TCP_MAX_RETRANSMITS 8  // consecutive timeouts before the connection is dropped
+
+/*
+ * timers run off the tick object, which is driven by the PIT at its BIOS rate of about 18.2Hz
+ */
+#define TCP_TICKS_PER_SECOND 18
+#define TCP_RTO_INITIAL TCP_TICKS_PER_SECOND  // one second (RFC 6298)
+#define TCP_RTO_MIN 4                         // about 200ms; RFC 6298 asks for a second, which is slow on a LAN
+#define TCP_RTO_MAX (60 * TCP_TICKS_PER_SECOND)
+#define TCP_TIME_WAIT_TICKS (2 * TCP_TICKS_PER_SECOND)  // a short 2MSL; we are not a busy server
+#define TCP_FIN_WAIT_2_TICKS (60 * TCP_TICKS_PER_SECOND)
+
+#define TCP_TIMER_NONE 0
+#define TCP_TIMER_RETRANSMIT 1
+#define TCP_TIMER_PERSIST 2
+#define TCP_TIMER_TIME_WAIT 3
+
+// sequence number comparisons, modulo 2^32
+#define TCP_SEQ_LT(a, b) (((int32_t)((a) - (b))) < 0)
+#define TCP_SEQ_LEQ(a, b) (((int32_t)((a) - (b))) <= 0)
+#define TCP_SEQ_GT(a, b) (((int32_t)((a) - (b))) > 0)
+#define TCP_SEQ_GEQ(a, b) (((int32_t)((a) - (b))) >= 0)
+
+struct tcp_connection {
+    struct tcp_connection* next;  // in the hash bucket, or the list of listeners
+    uint8_t state;
+    bool user_closed;  // the user has called close, and we free it once it is done
+    bool hashed;
+    uint32_t local_ip;
+    uint32_t remote_ip;
+    uint16_t local_port;
+    uint16_t remote_port;
+    /*
+     * the one timer a connection can have running: retransmit while there is data in flight, persist while the
+     * peer's window is shut, or TIME_WAIT. timer_link points at whatever points at us, so we can unlink from a
+     * slot the wheel has already taken off
+     */
+    uint8_t timer;
+    uint64_t timer_expires;
+    struct tcp_connection* timer_next;
+    struct tcp_connection** timer_link;
+    /*
+     * listeners only
+     */
+    struct tcp_connection* accept_queue[TCP_BACKLOG];
+    uint8_t accept_count;
+    struct tcp_connection* listener;  // the listener we came from, until accepted
+    /*
+     * send side. the send buffer holds everything from snd_una on; its first byte is sequence number buffer_seq
+     */
+    uint32_t iss;
+    uint32_t snd_una;
+    uint32_t snd_nxt;
+    uint32_t snd_max;  // highest sequence number sent; snd_nxt goes back to snd_una on a timeout
+    uint32_t snd_wnd;
+    uint32_t snd_wl1;
+    uint32_t snd_wl2;
+    uint32_t buffer_seq;
+    struct spscring* send_buffer;
+    bool fin_queued;
+    uint16_t mss;
+    /*
+     * receive side
+     */
+    uint32_t irs;
+    uint32_t rcv_nxt;
+    uint32_t rcv_adv;  // window we last advertised
+    struct spscring* receive_buffer;
+    /*
+     * congestion control; NewReno (RFC 5681, RFC 6582)
+     */
+    uint32_t cwnd;
+    uint32_t ssthresh;
+    uint32_t recover;  // the last sequence number sent when we last cut the window
+    uint8_t dupacks;
+    bool in_recovery;
+    /*
+     * round trip time, in ticks (RFC 6298). srtt is kept times 8 and rttvar times 4, as BSD does
+     */
+    uint32_t srtt;
+    uint32_t rttvar;
+    uint32_t rto;
+    bool rtt_timing;
+    uint32_t rtt_seq;
+    uint64_t rtt_start;
+    uint8_t retransmits;
+};
+
+/*
+ * a segment that arrived while we were busy
+ */
+struct tcp_deferred_segment {
+    struct tcp_deferred_segment* next;
+    uint32_t saddr;
+    uint32_t daddr;
+    struct netbuf* payload;
+};
+
 struct tcp_objectdata {
     struct object* ip_device;
-} __attribute__((packed));
+    struct object* tick_device;
+    struct tcp_connection* connections[TCP_CONNECTION_BUCKETS];
+    struct tcp_connection* listeners;
+    struct tcp_connection* wheel[TCP_WHEEL_SLOTS];
+    uint64_t now;
+    /*
+     * we are not reentrant, and over loopback our own output arrives back while we are still sending it. segments
+     * and ticks that arrive while we are busy are queued, and run on the way out
+     */
+    uint32_t busy;
+    uint32_t deferred_ticks;
+    struct tcp_deferred_segment* deferred_head;
+    struct tcp_deferred_segment* deferred_tail;
+    uint16_t next_ephemeral_port;
+    uint32_t iss_seed;
+    uint64_t rx_segments;
+    uint64_t rx_dropped;
+    uint64_t tx_segments;
+    uint64_t retransmits;
+};
+
+void tcp_input(struct object* obj, struct ip_header* ip, struct netbuf* payload);
+void tcp_segment_arrives(struct object* obj, uint32_t saddr, uint32_t daddr, struct netbuf* payload);
+void tcp_tick(struct object* obj);
+void tcp_output(struct object* obj, struct tcp_connection* c);
+
+/*
+ * from tick_run, in thread context.  timers send, and sending allocates, which mustn't happen in an interrupt
+ */
+void tcp_tick_event(struct object* subscriber, uint64_t tick) {
+    tcp_tick(subscriber);
+}
 
 /*
  * perform device instance specific init here
@@ -26,36 +168,1173 @@ uint8_t tcp_init(struct object* obj) {
     ASSERT_NOT_NULL(obj);
     ASSERT_NOT_NULL(obj->object_data);
     struct tcp_objectdata* object_data = (struct tcp_objectdata*)obj->object_data;
+    struct objectinterface_ip* ip_api = (struct objectinterface_ip*)object_data->ip_device->api;
+    (*ip_api->register_protocol)(object_data->ip_device, IP_PROTOCOL_TCP, obj, &tcp_input);
+    if (0 != object_data->tick_device) {
+        struct objectinterface_tick* tick_api = (struct objectinterface_tick*)object_data->tick_device->api;
+        (*tick_api->subscribe)(object_data->tick_device, obj, &tcp_tick_event);
+    }
     kprintf("Init %s on %s (%s)\n", obj->description, object_data->ip_device->name, obj->name);
     return 1;
 }
 
+void tcp_connection_delete(struct tcp_connection* c) {
+    if (0 != c->send_buffer) {
+        spscring_delete(c->send_buffer);
+    }
+    if (0 != c->receive_buffer) {
+        spscring_delete(c->receive_buffer);
+    }
+    kfree(c);
+}
+
 /*
  * perform device instance specific uninit here, like removing API structs and Device data
  */
 uint8_t tcp_uninit(struct object* obj) {
     ASSERT_NOT_NULL(obj);
+    ASSERT_NOT_NULL(obj->object_data);
     kprintf("Uninit %s (%s)\n", obj->description, obj->name);
+    struct tcp_objectdata* object_data = (struct tcp_objectdata*)obj->object_data;
+    if (0 != object_data->tick_device) {
+        struct objectinterface_tick* tick_api = (struct objectinterface_tick*)object_data->tick_device->api;
+        (*tick_api->unsubscribe)(object_data->tick_device, obj);
+    }
+    struct objectinterface_ip* ip_api = (struct objectinterface_ip*)object_data->ip_device->api;
+    (*ip_api->register_protocol)(object_data->ip_device, IP_PROTOCOL_TCP, 0, 0);
+    /*
+     * connections the user still holds go with us. accept queues only hold connections that are also hashed
+     */
+    for (uint16_t i = 0; i < TCP_CONNECTION_BUCKETS; i++) {
+        while (0 != object_data->connections[i]) {
+            struct tcp_connection* c = object_data->connections[i];
+            object_data->connections[i] = c->next;
+            tcp_connection_delete(c);
+        }
+    }
+    while (0 != object_data->listeners) {
+        struct tcp_connection* c = object_data->listeners;
+        object_data->listeners = c->next;
+        tcp_connection_delete(c);
+    }
+    while (0 != object_data->deferred_head) {
+        struct tcp_deferred_segment* d = object_data->deferred_head;
+        object_data->deferred_head = d->next;
+        netbuf_release(d->payload);
+        kfree(d);
+    }
     kfree(obj->api);
     kfree(obj->object_data);
 
     return 1;
 }
 
-void tcp_read(struct object* obj, uint8_t* data, uint16_t size) {
+/*
+ * API calls, input and ticks all go through these
+ */
+void tcp_enter(struct tcp_objectdata* object_data) {
+    object_data->busy++;
+}
+
+void tcp_leave(struct object* obj, struct tcp_objectdata* object_data) {
+    ASSERT(object_data->busy > 0);
+    object_data->busy--;
+    while ((0 == object_data->busy) && (0 != object_data->deferred_head)) {
+        struct tcp_deferred_segment* d = object_data->deferred_head;
+        object_data->deferred_head = d->next;
+        if (0 == object_data->deferred_head) {
+            object_data->deferred_tail = 0;
+        }
+        tcp_segment_arrives(obj, d->saddr, d->daddr, d->payload);
+        netbuf_release(d->payload);
+        kfree(d);
+    }
+    while ((0 == object_data->busy) && (object_data->deferred_ticks > 0)) {
+        object_data->deferred_ticks--;
+        tcp_tick(obj);
+    }
+}
+
+/*
+ * connection table
+ */
+uint16_t tcp_hash(uint32_t remote_ip, uint16_t local_port, uint16_t remote_port) {
+    return (remote_ip ^ (remote_ip >> 16) ^ local_port ^ remote_port) % TCP_CONNECTION_BUCKETS;
+}
+
+struct tcp_connection* tcp_find_connection(struct tcp_objectdata* object_data, uint32_t local_ip,
+                                           uint16_t local_port, uint32_t remote_ip, uint16_t remote_port) {
+    struct tcp_connection* c = object_data->connections[tcp_hash(remote_ip, local_port, remote_port)];
+    while (0 != c) {
+        if ((c->local_port == local_port) && (c->remote_port == remote_port) && (c->remote_ip == remote_ip) &&
+            (c->local_ip == local_ip)) {
+            return c;
+        }
+        c = c->next;
+    }
+    return 0;
+}
+
+struct tcp_connection* tcp_find_listener(struct tcp_objectdata* object_data, uint16_t port) {
+    struct tcp_connection* c = object_data->listeners;
+    while (0 != c) {
+        if (c->local_port == port) {
+            return c;
+        }
+        c = c->next;
+    }
+    return 0;
+}
+
+void tcp_hash_connection(struct tcp_objectdata* object_data, struct tcp_connection* c) {
+    uint16_t bucket = tcp_hash(c->remote_ip, c->local_port, c->remote_port);
+    c->next = object_data->connections[bucket];
+    object_data->connections[bucket] = c;
+    c->hashed = true;
+}
+
+void tcp_unhash_connection(struct tcp_objectdata* object_data, struct tcp_connection* c) {
+    if (!c->hashed) {
+        return;
+    }
+    uint16_t bucket = tcp_hash(c->remote_ip, c->local_port, c->remote_port);
+    struct tcp_connection** link = &(object_data->connections[bucket]);
+    while (*link != c) {
+        ASSERT_NOT_NULL(*link);
+        link = &((*link)->next);
+    }
+    *link = c->next;
+    c->next = 0;
+    c->hashed = false;
+}
+
+/*
+ * the timer wheel. a timer further out than TCP_WHEEL_SLOTS ticks goes round more than once
+ */
+void tcp_timer_cancel(struct tcp_connection* c) {
+    if (TCP_TIMER_NONE == c->timer) {
+        return;
+    }
+    *(c->timer_link) = c->timer_next;
+    if (0 != c->timer_next) {
+        c->timer_next->timer_link = c->timer_link;
+    }
+    c->timer_next = 0;
+    c->timer_link = 0;
+    c->timer = TCP_TIMER_NONE;
+}
+
+void tcp_timer_set(struct tcp_objectdata* object_data, struct tcp_connection* c, uint8_t timer, uint64_t expires) {
+    tcp_timer_cancel(c);
+    struct tcp_connection** slot = &(object_data->wheel[expires % TCP_WHEEL_SLOTS]);
+    c->timer = timer;
+    c->timer_expires = expires;
+    c->timer_next = *slot;
+    if (0 != c->timer_next) {
+        c->timer_next->timer_link = &(c->timer_next);
+    }
+    c->timer_link = slot;
+    *slot = c;
+}
+
+/*
+ * a connection is finished with. if the user is still holding it, it stays around, CLOSED, until they close it
+ */
+void tcp_connection_closed(struct tcp_objectdata* object_data, struct tcp_connection* c) {
+    tcp_timer_cancel(c);
+    tcp_unhash_connection(object_data, c);
+    c->state = TCP_STATE_CLOSED;
+    // not yet accepted, so no one can be holding it
+    if ((0 != c->listener) || c->user_closed) {
+        if (0 != c->listener) {
+            struct tcp_connection* l = c->listener;
+            for (uint8_t i = 0; i < l->accept_count; i++) {
+                if (l->accept_queue[i] == c) {
+                    for (uint8_t j = i; j < (l->accept_count - 1); j++) {
+                        l->accept_queue[j] = l->accept_queue[j + 1];
+                    }
+                    l->accept_count--;
+                    break;
+                }
+            }
+        }
+        tcp_connection_delete(c);
+    }
+}
+
+/*
+ * segment output
+ */
+void tcp_send(struct tcp_objectdata* object_data, uint32_t local_ip, uint32_t remote_ip, uint16_t local_port,
+              uint16_t remote_port, uint32_t seq, uint32_t ack, uint8_t flags, uint16_t window, uint16_t mss,
+              struct spscring* data, uint32_t offset, uint16_t len) {
+    struct objectinterface_ip* ip_api = (struct objectinterface_ip*)object_data->ip_device->api;
+
+    /*
+     * the data goes straight from the send buffer into the frame, behind room for every header below us
+     */
+    uint16_t header_len = TCP_HEADER_LEN + ((0 != mss) ? TCP_MSS_OPTION_LEN : 0);
+    uint16_t segment_len = header_len + len;
+    struct netbuf* nb = netbuf_new(NETBUF_HEADROOM);
+    if (0 == nb) {
+        // out of buffers. the segment is lost, as if on the wire, and the retransmit timer sends it again
+        return;
+    }
+    uint8_t* segment = netbuf_put(nb, segment_len);
+    struct tcp_header* header = (struct tcp_header*)segment;
+    header->source_port = switch_endian16(local_port);
+    header->dest_port = switch_endian16(remote_port);
+    header->seq = switch_endian32(seq);
+    header->ack = switch_endian32((flags & TCP_FLAG_ACK) ? ack : 0);
+    header->reserved = 0;
+    header->offset = header_len / 4;
+    header->flags = flags;
+    header->window = switch_endian16(window);
+    header->csum = 0;
+    header->urgent = 0;
+    if (0 != mss) {
+        uint8_t* option = segment + TCP_HEADER_LEN;
+        option[0] = 2;
+        option[1] = TCP_MSS_OPTION_LEN;
+        option[2] = mss >> 8;
+        option[3] = mss & 0xFF;
+    }
+    if (len > 0) {
+        uint32_t copied = spscring_peek_bulk(data, offset, segment + header_len, len);
+        ASSERT(copied == len);
+    }
+    // the NIC sums the segment itself, if it can
+    ip_checksum_partial(nb, switch_endian32(local_ip), switch_endian32(remote_ip), IP_PROTOCOL_TCP, TCP_CSUM_OFFSET);
+
+    object_data->tx_segments++;
+    (*ip_api->write)(object_data->ip_device, remote_ip, IP_PROTOCOL_TCP, nb);
+}
+
+uint16_t tcp_receive_window(struct tcp_connection* c) {
+    uint32_t space = spscring_space(c->receive_buffer);
+    return (space > 0xFFFF) ? 0xFFFF : space;
+}
+
+/*
+ * a segment on a connection, with len bytes of data from sequence number seq
+ */
+void tcp_send_segment(struct tcp_objectdata* object_data, struct tcp_connection* c, uint32_t seq, uint16_t len,
+                      uint8_t flags) {
+    uint16_t mss = (flags & TCP_FLAG_SYN) ? TCP_MSS : 0;
+    c->rcv_adv = tcp_receive_window(c);
+    tcp_send(object_data, c->local_ip, c->remote_ip, c->local_port, c->remote_port, seq, c->rcv_nxt, flags,
+             c->rcv_adv, mss, c->send_buffer, seq - c->buffer_seq, len);
+}
+
+void tcp_send_ack(struct tcp_objectdata* object_data, struct tcp_connection* c) {
+    tcp_send_segment(object_data, c, c->snd_nxt, 0, TCP_FLAG_ACK);
+}
+
+void tcp_send_reset(struct tcp_objectdata* object_data, struct tcp_connection* c) {
+    tcp_send_segment(object_data, c, c->snd_nxt, 0, TCP_FLAG_RST | TCP_FLAG_ACK);
+}
+
+uint32_t tcp_min(uint32_t a, uint32_t b) {
+    return (a < b) ? a : b;
+}
+
+uint32_t tcp_flight_size(struct tcp_connection* c) {
+    return c->snd_max - c->snd_una;
+}
+
+void tcp_arm_retransmit(struct tcp_objectdata* object_data, struct tcp_connection* c) {
+    tcp_timer_set(object_data, c, TCP_TIMER_RETRANSMIT, object_data->now + c->rto);
+}
+
+/*
+ * send whatever the windows allow
+ */
+void tcp_output(struct object* obj, struct tcp_connection* c) {
+    struct tcp_objectdata* object_data = (struct tcp_objectdata*)obj->object_data;
+
+    if ((TCP_STATE_SYN_SENT == c->state) || (TCP_STATE_SYN_RECEIVED == c->state)) {
+        if (c->snd_nxt == c->iss) {
+            uint8_t flags = TCP_FLAG_SYN | ((TCP_STATE_SYN_RECEIVED == c->state) ? TCP_FLAG_ACK : 0);
+            tcp_send_segment(object_data, c, c->iss, 0, flags);
+            c->snd_nxt = c->iss + 1;
+            if (TCP_SEQ_GT(c->snd_nxt, c->snd_max)) {
+                c->snd_max = c->snd_nxt;
+            }
+        }
+        if (TCP_TIMER_RETRANSMIT != c->timer) {
+            tcp_arm_retransmit(object_data, c);
+        }
+        return;
+    }
+    if ((TCP_STATE_ESTABLISHED != c->state) && (TCP_STATE_CLOSE_WAIT != c->state) &&
+        (TCP_STATE_FIN_WAIT_1 != c->state) && (TCP_STATE_CLOSING != c->state) && (TCP_STATE_LAST_ACK != c->state)) {
+        return;
+    }
+
+    uint32_t count = spscring_count(c->send_buffer);
+    uint32_t window = tcp_min(c->snd_wnd, c->cwnd);
+    while (true) {
+        uint32_t offset = c->snd_nxt - c->buffer_seq;
+        if (offset > count) {
+            // the FIN is out
+            break;
+        }
+        uint32_t available = count - offset;
+        uint32_t in_flight = c->snd_nxt - c->snd_una;
+        uint32_t usable = (window > in_flight) ? (window - in_flight) : 0;
+        uint32_t len = tcp_min(tcp_min(available, usable), c->mss);
+        bool fin = c->fin_queued && (len == available);
+        if ((0 == len) && !fin) {
+            break;
+        }
+
+        uint8_t flags = TCP_FLAG_ACK;
+        if ((len > 0) && (len == available)) {
+            flags |= TCP_FLAG_PSH;
+        }
+        if (fin) {
+            flags |= TCP_FLAG_FIN;
+        }
+        if (!c->rtt_timing && (c->snd_nxt == c->snd_max)) {
+            c->rtt_timing = true;
+            c->rtt_seq = c->snd_nxt;
+            c->rtt_start = object_data->now;
+        }
+        tcp_send_segment(object_data, c, c->snd_nxt, len, flags);
+        c->snd_nxt += len + (fin ? 1 : 0);
+        if (TCP_SEQ_GT(c->snd_nxt, c->snd_max)) {
+            c->snd_max = c->snd_nxt;
+        }
+        if (fin) {
+            break;
+        }
+    }
+
+    if (c->snd_una != c->snd_max) {
+        if (TCP_TIMER_RETRANSMIT != c->timer) {
+            tcp_arm_retransmit(object_data, c);
+        }
+    } else if ((count > 0) && (TCP_TIMER_NONE == c->timer)) {
+        // there is data, and nothing in flight, so the peer's window is shut
+        tcp_timer_set(object_data, c, TCP_TIMER_PERSIST, object_data->now + c->rto);
+    }
+}
+
+/*
+ * resend the first unacknowledged segment, for fast retransmit and NewReno partial acks
+ */
+void tcp_retransmit_first(struct tcp_objectdata* object_data, struct tcp_connection* c) {
+    uint32_t count = spscring_count(c->send_buffer);
+    uint32_t offset = c->snd_una - c->buffer_seq;
+    uint32_t available = (offset < count) ? (count - offset) : 0;
+    uint16_t len = tcp_min(tcp_min(available, c->mss), tcp_flight_size(c));
+    uint8_t flags = TCP_FLAG_ACK;
+    if (c->fin_queued && (len == available) && (c->snd_una + len != c->snd_max)) {
+        // only the FIN is left
+        flags |= TCP_FLAG_FIN;
+    }
+    object_data->retransmits++;
+    c->rtt_timing = false;
+    tcp_send_segment(object_data, c, c->snd_una, len, flags);
+}
+
+/*
+ * timers
+ */
+void tcp_retransmit_timeout(struct object* obj, struct tcp_connection* c) {
+    struct tcp_objectdata* object_data = (struct tcp_objectdata*)obj->object_data;
+
+    c->retransmits++;
+    if (c->retransmits > TCP_MAX_RETRANSMITS) {
+        tcp_send_reset(object_data, c);
+        tcp_connection_closed(object_data, c);
+        return;
+    }
+    object_data->retransmits++;
+
+    // RFC 5681 section 3.1, and back off the timer
+    uint32_t flight = tcp_flight_size(c);
+    c->ssthresh = ((flight / 2) > (2 * c->mss)) ? (flight / 2) : (2 * c->mss);
+    c->cwnd = c->mss;
+    c->dupacks = 0;
+    c->in_recovery = false;
+    c->recover = c->snd_max - 1;
+    c->rto = tcp_min(c->rto * 2, TCP_RTO_MAX);
+    // Karn: don't time retransmitted segments
+    c->rtt_timing = false;
+
+    // go back N
+    c->snd_nxt = c->snd_una;
+    tcp_output(obj, c);
+}
+
+void tcp_persist_timeout(struct object* obj, struct tcp_connection* c) {
+    struct tcp_objectdata* object_data = (struct tcp_objectdata*)obj->object_data;
+
+    /*
+     * an old sequence number gets an ACK back, with the peer's window in it; in case the update that should have
+     * opened it was lost
+     */
+    tcp_send_segment(object_data, c, c->snd_nxt - 1, 0, TCP_FLAG_ACK);
+    c->rto = tcp_min(c->rto * 2, TCP_RTO_MAX);
+    tcp_timer_set(object_data, c, TCP_TIMER_PERSIST, object_data->now + c->rto);
+}
+
+void tcp_tick(struct object* obj) {
+    ASSERT_NOT_NULL(obj);
+    ASSERT_NOT_NULL(obj->object_data);
+    struct tcp_objectdata* object_data = (struct tcp_objectdata*)obj->object_data;
+
+    if (object_data->busy > 0) {
+        object_data->deferred_ticks++;
+        return;
+    }
+    tcp_enter(object_data);
+
+    object_data->now++;
+    /*
+     * take the slot off the wheel first. firing one timer can send a segment that is delivered straight back to
+     * us, and that can move other timers in the slot
+     */
+    struct tcp_connection* due = object_data->wheel[object_data->now % TCP_WHEEL_SLOTS];
+    object_data->wheel[object_data->now % TCP_WHEEL_SLOTS] = 0;
+    if (0 != due) {
+        due->timer_link = &due;
+    }
+    while (0 != due) {
+        struct tcp_connection* c = due;
+        uint8_t timer = c->timer;
+        uint64_t expires = c->timer_expires;
+        tcp_timer_cancel(c);
+        if (expires > object_data->now) {
+            // round again
+            tcp_timer_set(object_data, c, timer, expires);
+        } else if (TCP_TIMER_RETRANSMIT == timer) {
+            tcp_retransmit_timeout(obj, c);
+        } else if (TCP_TIMER_PERSIST == timer) {
+            tcp_persist_timeout(obj, c);
+        } else if (TCP_TIMER_TIME_WAIT == timer) {
+            tcp_connection_closed(object_data, c);
+        }
+    }
+
+    tcp_leave(obj, object_data);
+}
+
+/*
+ * input
+ */
+void tcp_update_rtt(struct tcp_connection* c, uint32_t rtt) {
+    if (0 == c->srtt) {
+        c->srtt = (rtt << 3) | 1;  // never 0 again, so we know we have a sample
+        c->rttvar = rtt << 1;
+    } else {
+        int32_t delta = (int32_t)rtt - (int32_t)(c->srtt >> 3);
+        c->srtt += delta;
+        if (delta < 0) {
+            delta = -delta;
+        }
+        delta -= (c->rttvar >> 2);
+        c->rttvar += delta;
+    }
+    c->rto = (c->srtt >> 3) + ((c->rttvar > 1) ? c->rttvar : 1);
+    if (c->rto < TCP_RTO_MIN) {
+        c->rto = TCP_RTO_MIN;
+    } else if (c->rto > TCP_RTO_MAX) {
+        c->rto = TCP_RTO_MAX;
+    }
+}
+
+/*
+ * ack advances snd_una
+ */
+void tcp_new_ack(struct object* obj, struct tcp_connection* c, uint32_t ack) {
+    struct tcp_objectdata* object_data = (struct tcp_objectdata*)obj->object_data;
+
+    uint32_t acked = ack - c->snd_una;
+    // ack can cover our SYN or FIN as well as data
+    c->buffer_seq += spscring_discard(c->send_buffer, ack - c->buffer_seq);
+    c->snd_una = ack;
+    if (TCP_SEQ_LT(c->snd_nxt, ack)) {
+        c->snd_nxt = ack;
+    }
+    c->retransmits = 0;
+
+    if (c->rtt_timing && TCP_SEQ_GT(ack, c->rtt_seq)) {
+        c->rtt_timing = false;
+        tcp_update_rtt(c, object_data->now - c->rtt_start);
+    }
+
+    if (c->in_recovery) {
+        if (TCP_SEQ_GT(ack, c->recover)) {
+            // full ack; deflate the window (RFC 6582 section 3.2 step 3)
+            c->in_recovery = false;
+            c->cwnd = tcp_min(c->ssthresh, tcp_flight_size(c) + c->mss);
+            c->dupacks = 0;
+        } else {
+            // partial ack; the next hole is lost too
+            tcp_retransmit_first(object_data, c);
+            c->cwnd = ((c->cwnd > acked) ? (c->cwnd - acked) : 0) + c->mss;
+        }
+    } else {
+        c->dupacks = 0;
+        if (c->cwnd < c->ssthresh) {
+            c->cwnd += tcp_min(acked, c->mss);
+        } else {
+            uint32_t increase = (c->mss * c->mss) / c->cwnd;
+            c->cwnd += (increase > 0) ? increase : 1;
+        }
+    }
+
+    if (c->snd_una == c->snd_max) {
+        tcp_timer_cancel(c);
+    } else {
+        tcp_arm_retransmit(object_data, c);
+    }
+}
+
+void tcp_duplicate_ack(struct object* obj, struct tcp_connection* c) {
+    struct tcp_objectdata* object_data = (struct tcp_objectdata*)obj->object_data;
+
+    c->dupacks++;
+    if (c->in_recovery) {
+        // each dup ack means a segment has left the network
+        c->cwnd += c->mss;
+    } else if ((3 == c->dupacks) && TCP_SEQ_GT(c->snd_una, c->recover)) {
+        uint32_t flight = tcp_flight_size(c);
+        c->ssthresh = ((flight / 2) > (2 * c->mss)) ? (flight / 2) : (2 * c->mss);
+        c->recover = c->snd_max - 1;
+        c->in_recovery = true;
+        tcp_retransmit_first(object_data, c);
+        c->cwnd = c->ssthresh + (3 * c->mss);
+        tcp_arm_retransmit(object_data, c);
+    }
+}
+
+uint16_t tcp_parse_mss(uint8_t* options, uint16_t len) {
+    uint16_t i = 0;
+    while (i < len) {
+        if (0 == options[i]) {
+            break;
+        } else if (1 == options[i]) {
+            i++;
+            continue;
+        }
+        if (((i + 1) >= len) || (options[i + 1] < 2) || ((i + options[i + 1]) > len)) {
+            break;
+        }
+        if ((2 == options[i]) && (TCP_MSS_OPTION_LEN == options[i + 1])) {
+            uint16_t mss = (options[i + 2] << 8) | options[i + 3];
+            return ((0 == mss) || (mss > TCP_MSS)) ? TCP_MSS : mss;
+        }
+        i += options[i + 1];
+    }
+    return TCP_DEFAULT_MSS;
+}
+
+struct tcp_connection* tcp_connection_new(struct tcp_objectdata* object_data, uint32_t local_ip,
+                                          uint16_t local_port, uint32_t remote_ip, uint16_t remote_port) {
+    struct tcp_connection* c = (struct tcp_connection*)kmalloc(sizeof(struct tcp_connection));
+    memzero((uint8_t*)c, sizeof(struct tcp_connection));
+    c->local_ip = local_ip;
+    c->local_port = local_port;
+    c->remote_ip = remote_ip;
+    c->remote_port = remote_port;
+    c->send_buffer = spscring_new(TCP_BUFFER_SIZE);
+    c->receive_buffer = spscring_new(TCP_BUFFER_SIZE);
+
+    // RFC 6528 would hash the 4-tuple with a secret; a moving counter at least doesn't repeat
+    object_data->iss_seed += 64000 + (uint32_t)(object_data->now * 250);
+    c->iss = object_data->iss_seed;
+    c->snd_una = c->iss;
+    c->snd_nxt = c->iss;
+    c->snd_max = c->iss;
+    c->buffer_seq = c->iss + 1;
+    c->mss = TCP_DEFAULT_MSS;
+    c->rto = TCP_RTO_INITIAL;
+    c->ssthresh = 0xFFFF;
+    c->recover = c->iss;
+    return c;
+}
+
+/*
+ * segments for no connection get a reset, unless they are one (RFC 793 page 36)
+ */
+void tcp_reset_reply(struct tcp_objectdata* object_data, uint32_t local_ip, uint32_t remote_ip,
+                     uint16_t local_port, uint16_t remote_port, uint32_t seq, uint32_t ack, uint8_t flags,
+                     uint32_t seg_len) {
+    if (flags & TCP_FLAG_RST) {
+        return;
+    }
+    if (flags & TCP_FLAG_ACK) {
+        tcp_send(object_data, local_ip, remote_ip, local_port, remote_port, ack, 0, TCP_FLAG_RST, 0, 0, 0, 0, 0);
+    } else {
+        tcp_send(object_data, local_ip, remote_ip, local_port, remote_port, 0, seq + seg_len,
+                 TCP_FLAG_RST | TCP_FLAG_ACK, 0, 0, 0, 0, 0);
+    }
+}
+
+/*
+ * a SYN for a listener starts a connection in SYN_RECEIVED
+ */
+void tcp_passive_open(struct object* obj, struct tcp_connection* l, uint32_t local_ip, uint32_t remote_ip,
+                      uint16_t remote_port, uint32_t seq, uint16_t window, uint16_t mss) {
+    struct tcp_objectdata* object_data = (struct tcp_objectdata*)obj->object_data;
+
+    if (l->accept_count >= TCP_BACKLOG) {
+        // the peer will try again
+        object_data->rx_dropped++;
+        return;
+    }
+    struct tcp_connection* c = tcp_connection_new(object_data, local_ip, l->local_port, remote_ip, remote_port);
+    c->state = TCP_STATE_SYN_RECEIVED;
+    c->listener = l;
+    c->irs = seq;
+    c->rcv_nxt = seq + 1;
+    c->snd_wnd = window;
+    c->mss = mss;
+    c->cwnd = 2 * mss;
+    tcp_hash_connection(object_data, c);
+    tcp_output(obj, c);
+}
+
+/*
+ * SYN_SENT (RFC 793 page 66)
+ */
+void tcp_input_syn_sent(struct object* obj, struct tcp_connection* c, uint32_t seq, uint32_t ack, uint8_t flags,
+                        uint16_t window, uint16_t mss) {
+    struct tcp_objectdata* object_data = (struct tcp_objectdata*)obj->object_data;
+
+    if (flags & TCP_FLAG_ACK) {
+        if (TCP_SEQ_LEQ(ack, c->iss) || TCP_SEQ_GT(ack, c->snd_max)) {
+            if (!(flags & TCP_FLAG_RST)) {
+                tcp_send(object_data, c->local_ip, c->remote_ip, c->local_port, c->remote_port, ack, 0,
+                         TCP_FLAG_RST, 0, 0, 0, 0, 0);
+            }
+            return;
+        }
+    }
+    if (flags & TCP_FLAG_RST) {
+        if (flags & TCP_FLAG_ACK) {
+            // connection refused
+            tcp_connection_closed(object_data, c);
+        }
+        return;
+    }
+    if (!(flags & TCP_FLAG_SYN)) {
+        return;
+    }
+
+    c->irs = seq;
+    c->rcv_nxt = seq + 1;
+    c->mss = mss;
+    c->cwnd = 2 * mss;
+    c->snd_wnd = window;
+    c->snd_wl1 = seq;
+    c->snd_wl2 = ack;
+    if (flags & TCP_FLAG_ACK) {
+        c->snd_una = ack;
+        c->snd_nxt = ack;
+        c->state = TCP_STATE_ESTABLISHED;
+        tcp_timer_cancel(c);
+        if (c->rtt_timing) {
+            c->rtt_timing = false;
+            tcp_update_rtt(c, object_data->now - c->rtt_start);
+        }
+        c->retransmits = 0;
+        // data queued while connecting can carry the ACK
+        uint64_t sent = object_data->tx_segments;
+        tcp_output(obj, c);
+        if (sent == object_data->tx_segments) {
+            tcp_send_ack(object_data, c);
+        }
+    } else {
+        // simultaneous open; SYN again, with an ACK this time
+        c->state = TCP_STATE_SYN_RECEIVED;
+        c->snd_nxt = c->iss;
+        tcp_output(obj, c);
+    }
+}
+
+/*
+ * len bytes of a (possibly chained) netbuf, from offset, into a ring. returns the number that fit
+ */
+uint32_t tcp_put_netbuf(struct spscring* ring, struct netbuf* nb, uint16_t offset, uint16_t len) {
+    uint32_t ret = 0;
+    while ((0 != nb) && (ret < len)) {
+        if (offset >= nb->len) {
+            offset -= nb->len;
+        } else {
+            uint16_t n = nb->len - offset;
+            if (n > (len - ret)) {
+                n = len - ret;
+            }
+            uint32_t copied = spscring_put_bulk(ring, nb->data + offset, n);
+            ret += copied;
+            if (copied < n) {
+                break;
+            }
+            offset = 0;
+        }
+        nb = nb->chain;
+    }
+    return ret;
+}
+
+/*
+ * segments from the IP object
+ */
+void tcp_input(struct object* obj, struct ip_header* ip, struct netbuf* payload) {
+    ASSERT_NOT_NULL(obj);
+    ASSERT_NOT_NULL(obj->object_data);
+    ASSERT_NOT_NULL(ip);
+    ASSERT_NOT_NULL(payload);
+    struct tcp_objectdata* object_data = (struct tcp_objectdata*)obj->object_data;
+
+    if (0 == object_data->busy) {
+        tcp_segment_arrives(obj, ip->saddr, ip->daddr, payload);
+        return;
+    }
+    // hold on to the buffer, rather than copying it
+    struct tcp_deferred_segment* d = (struct tcp_deferred_segment*)kmalloc(sizeof(struct tcp_deferred_segment));
+    d->next = 0;
+    d->saddr = ip->saddr;
+    d->daddr = ip->daddr;
+    d->payload = netbuf_retain(payload);
+    if (0 == object_data->deferred_tail) {
+        object_data->deferred_head = d;
+    } else {
+        object_data->deferred_tail->next = d;
+    }
+    object_data->deferred_tail = d;
+}
+
+/*
+ * RFC 793 "SEGMENT ARRIVES". saddr and daddr are in network byte order
+ */
+void tcp_segment_arrives(struct object* obj, uint32_t saddr, uint32_t daddr, struct netbuf* payload) {
+    struct tcp_objectdata* object_data = (struct tcp_objectdata*)obj->object_data;
+    object_data->rx_segments++;
+
+    // the header, options and all, has to be in the first segment
+    uint16_t size = netbuf_length(payload);
+    if (payload->len < TCP_HEADER_LEN) {
+        object_data->rx_dropped++;
+        return;
+    }
+    struct tcp_header* header = (struct tcp_header*)payload->data;
+    uint16_t header_len = header->offset * 4;
+    if ((header_len < TCP_HEADER_LEN) || (header_len > payload->len)) {
+        object_data->rx_dropped++;
+        return;
+    }
+    // the checksum is ours to check, unless the NIC has already or the segment never left the machine
+    if ((NETBUF_CSUM_NONE == payload->csum) &&
+        (0 != ip_checksum_pseudo(saddr, daddr, IP_PROTOCOL_TCP, payload, size))) {
+        object_data->rx_dropped++;
+        return;
+    }
+
+    tcp_enter(object_data);
+
+    uint32_t local_ip = switch_endian32(daddr);
+    uint32_t remote_ip = switch_endian32(saddr);
+    uint16_t local_port = switch_endian16(header->dest_port);
+    uint16_t remote_port = switch_endian16(header->source_port);
+    uint32_t seq = switch_endian32(header->seq);
+    uint32_t ack = switch_endian32(header->ack);
+    uint8_t flags = header->flags;
+    uint16_t window = switch_endian16(header->window);
+    uint16_t data_offset = header_len;  // of the data, in payload
+    uint16_t len = size - header_len;
+    uint32_t seg_len = len + ((flags & TCP_FLAG_SYN) ? 1 : 0) + ((flags & TCP_FLAG_FIN) ? 1 : 0);
+
+    struct tcp_connection* c = tcp_find_connection(object_data, local_ip, local_port, remote_ip, remote_port);
+    if (0 == c) {
+        struct tcp_connection* l = tcp_find_listener(object_data, local_port);
+        if ((0 != l) && ((flags & (TCP_FLAG_SYN | TCP_FLAG_ACK | TCP_FLAG_RST)) == TCP_FLAG_SYN)) {
+            uint16_t mss = tcp_parse_mss(payload->data + TCP_HEADER_LEN, header_len - TCP_HEADER_LEN);
+            tcp_passive_open(obj, l, local_ip, remote_ip, remote_port, seq, window, mss);
+        } else {
+            object_data->rx_dropped++;
+            tcp_reset_reply(object_data, local_ip, remote_ip, local_port, remote_port, seq, ack, flags, seg_len);
+        }
+        tcp_leave(obj, object_data);
+        return;
+    }
+
+    if (TCP_STATE_SYN_SENT == c->state) {
+        uint16_t mss = tcp_parse_mss(payload->data + TCP_HEADER_LEN, header_len - TCP_HEADER_LEN);
+        tcp_input_syn_sent(obj, c, seq, ack, flags, window, mss);
+        tcp_leave(obj, object_data);
+        return;
+    }
+
+    /*
+     * is it in the window (RFC 793 page 69)?
+     */
+    uint32_t rcv_wnd = tcp_receive_window(c);
+    bool acceptable;
+    if (0 == seg_len) {
+        acceptable = (0 == rcv_wnd) ? (seq == c->rcv_nxt)
+                                    : (TCP_SEQ_GEQ(seq, c->rcv_nxt) && TCP_SEQ_LT(seq, c->rcv_nxt + rcv_wnd));
+    } else if (0 == rcv_wnd) {
+        acceptable = false;
+    } else {
+        acceptable = (TCP_SEQ_GEQ(seq, c->rcv_nxt) && TCP_SEQ_LT(seq, c->rcv_nxt + rcv_wnd)) ||
+                     (TCP_SEQ_GEQ(seq + seg_len - 1, c->rcv_nxt) &&
+                      TCP_SEQ_LT(seq + seg_len - 1, c->rcv_nxt + rcv_wnd));
+    }
+    if (!acceptable) {
+        // a zero window probe, or an old duplicate; either way, tell them where we are
+        if (!(flags & TCP_FLAG_RST)) {
+            tcp_send_ack(object_data, c);
+        }
+        tcp_leave(obj, object_data);
+        return;
+    }
+
+    if (flags & TCP_FLAG_RST) {
+        tcp_connection_closed(object_data, c);
+        tcp_leave(obj, object_data);
+        return;
+    }
+    if (flags & TCP_FLAG_SYN) {
+        // a retransmitted SYN; our SYN-ACK must have been lost
+        if ((TCP_STATE_SYN_RECEIVED == c->state) && (seq == c->irs)) {
+            c->snd_nxt = c->iss;
+            tcp_output(obj, c);
+        } else {
+            tcp_send_ack(object_data, c);
+        }
+        tcp_leave(obj, object_data);
+        return;
+    }
+    if (!(flags & TCP_FLAG_ACK)) {
+        tcp_leave(obj, object_data);
+        return;
+    }
+
+    /*
+     * the ACK field
+     */
+    if (TCP_STATE_SYN_RECEIVED == c->state) {
+        if (TCP_SEQ_LEQ(ack, c->snd_una) || TCP_SEQ_GT(ack, c->snd_max)) {
+            tcp_send(object_data, local_ip, remote_ip, local_port, remote_port, ack, 0, TCP_FLAG_RST, 0, 0, 0, 0,
+                     0);
+            tcp_leave(obj, object_data);
+            return;
+        }
+        c->state = TCP_STATE_ESTABLISHED;
+        c->snd_wnd = window;
+        c->snd_wl1 = seq;
+        c->snd_wl2 = ack;
+        if (0 != c->listener) {
+            struct tcp_connection* l = c->listener;
+            if (l->accept_count < TCP_BACKLOG) {
+                l->accept_queue[l->accept_count++] = c;
+            } else {
+                tcp_send_reset(object_data, c);
+                tcp_connection_closed(object_data, c);
+                tcp_leave(obj, object_data);
+                return;
+            }
+        }
+    }
+    if (TCP_SEQ_GT(ack, c->snd_max)) {
+        // acks something we haven't sent
+        tcp_send_ack(object_data, c);
+        tcp_leave(obj, object_data);
+        return;
+    }
+    bool fin_acked = false;
+    if (TCP_SEQ_GT(ack, c->snd_una)) {
+        tcp_new_ack(obj, c, ack);
+        fin_acked = c->fin_queued && (0 == spscring_count(c->send_buffer)) && (c->snd_una == c->buffer_seq + 1);
+    } else if ((ack == c->snd_una) && (0 == len) && !(flags & TCP_FLAG_FIN) && (window == c->snd_wnd) &&
+               (c->snd_max != c->snd_una)) {
+        tcp_duplicate_ack(obj, c);
+    }
+    if (TCP_SEQ_LT(c->snd_wl1, seq) || ((c->snd_wl1 == seq) && TCP_SEQ_LEQ(c->snd_wl2, ack))) {
+        if ((0 == c->snd_wnd) && (window > 0) && (TCP_TIMER_PERSIST == c->timer)) {
+            tcp_timer_cancel(c);
+        }
+        c->snd_wnd = window;
+        c->snd_wl1 = seq;
+        c->snd_wl2 = ack;
+    }
+
+    if (fin_acked) {
+        if (TCP_STATE_FIN_WAIT_1 == c->state) {
+            // don't wait forever for a peer that has gone away
+            c->state = TCP_STATE_FIN_WAIT_2;
+            tcp_timer_set(object_data, c, TCP_TIMER_TIME_WAIT, object_data->now + TCP_FIN_WAIT_2_TICKS);
+        } else if (TCP_STATE_CLOSING == c->state) {
+            c->state = TCP_STATE_TIME_WAIT;
+            tcp_timer_set(object_data, c, TCP_TIMER_TIME_WAIT, object_data->now + TCP_TIME_WAIT_TICKS);
+        } else if (TCP_STATE_LAST_ACK == c->state) {
+            tcp_connection_closed(object_data, c);
+            tcp_leave(obj, object_data);
+            return;
+        }
+    }
+
+    /*
+     * the data. only in order data is taken; anything else gets a duplicate ack, which starts the sender's fast
+     * retransmit
+     */
+    bool need_ack = false;
+    bool fin = (flags & TCP_FLAG_FIN) ? true : false;
+    if ((TCP_STATE_ESTABLISHED == c->state) || (TCP_STATE_FIN_WAIT_1 == c->state) ||
+        (TCP_STATE_FIN_WAIT_2 == c->state)) {
+        if (len > 0) {
+            need_ack = true;
+            if (TCP_SEQ_LT(seq, c->rcv_nxt)) {
+                // the front is a duplicate
+                uint32_t skip = c->rcv_nxt - seq;
+                if (skip >= len) {
+                    len = 0;
+                } else {
+                    data_offset += skip;
+                    len -= skip;
+                }
+                seq = c->rcv_nxt;
+            }
+            if ((seq == c->rcv_nxt) && (len > 0)) {
+                uint32_t copied = tcp_put_netbuf(c->receive_buffer, payload, data_offset, len);
+                c->rcv_nxt += copied;
+                if (copied < len) {
+                    // no room for the rest, or the FIN behind it
+                    fin = false;
+                }
+            } else if (seq != c->rcv_nxt) {
+                fin = false;
+            }
+        }
+    } else {
+        // the peer has already sent its FIN; anything more is a retransmission
+        len = 0;
+    }
+
+    if (fin && (seq + len == c->rcv_nxt)) {
+        need_ack = true;
+        c->rcv_nxt++;
+        if ((TCP_STATE_SYN_RECEIVED == c->state) || (TCP_STATE_ESTABLISHED == c->state)) {
+            c->state = TCP_STATE_CLOSE_WAIT;
+        } else if (TCP_STATE_FIN_WAIT_1 == c->state) {
+            // both ends closing at once
+            c->state = TCP_STATE_CLOSING;
+        } else if (TCP_STATE_FIN_WAIT_2 == c->state) {
+            c->state = TCP_STATE_TIME_WAIT;
+        }
+        if (TCP_STATE_TIME_WAIT == c->state) {
+            tcp_timer_set(object_data, c, TCP_TIMER_TIME_WAIT, object_data->now + TCP_TIME_WAIT_TICKS);
+        }
+    } else if (fin && (TCP_STATE_TIME_WAIT == c->state)) {
+        // our last ACK was lost
+        need_ack = true;
+        tcp_timer_set(object_data, c, TCP_TIMER_TIME_WAIT, object_data->now + TCP_TIME_WAIT_TICKS);
+    }
+
+    uint64_t sent = object_data->tx_segments;
+    tcp_output(obj, c);
+    if (need_ack && (sent == object_data->tx_segments)) {
+        tcp_send_ack(object_data, c);
+    }
+
+    tcp_leave(obj, object_data);
+}
+
+/*
+ * API
+ */
+struct tcp_connection* tcp_listen(struct object* obj, uint16_t port) {
     ASSERT_NOT_NULL(obj);
     ASSERT_NOT_NULL(obj->object_data);
-    //  struct ip_objectdata* object_data = (struct ip_objectdata*)obj->object_data;
+    struct tcp_objectdata* object_data = (struct tcp_objectdata*)obj->object_data;
+
+    if ((0 == port) || (0 != tcp_find_listener(object_data, port))) {
+        return 0;
+    }
+    struct tcp_connection* l = (struct tcp_connection*)kmalloc(sizeof(struct tcp_connection));
+    memzero((uint8_t*)l, sizeof(struct tcp_connection));
+    l->state = TCP_STATE_LISTEN;
+    l->local_port = port;
+    l->next = object_data->listeners;
+    object_data->listeners = l;
+    return l;
 }
-void tcp_write(struct object* obj, uint8_t* data, uint16_t size) {
+
+struct tcp_connection* tcp_accept(struct object* obj, struct tcp_connection* listener) {
     ASSERT_NOT_NULL(obj);
     ASSERT_NOT_NULL(obj->object_data);
-    //   struct ip_objectdata* object_data = (struct ip_objectdata*)obj->object_data;
+    ASSERT_NOT_NULL(listener);
+    ASSERT(TCP_STATE_LISTEN == listener->state);
+
+    if (0 == listener->accept_count) {
+        return 0;
+    }
+    struct tcp_connection* c = listener->accept_queue[0];
+    for (uint8_t i = 1; i < listener->accept_count; i++) {
+        listener->accept_queue[i - 1] = listener->accept_queue[i];
+    }
+    listener->accept_count--;
+    c->listener = 0;
+    return c;
 }
 
-struct object* tcp_attach(struct object* ip_device) {
+struct tcp_connection* tcp_connect(struct object* obj, uint32_t dest_ip, uint16_t dest_port) {
+    ASSERT_NOT_NULL(obj);
+    ASSERT_NOT_NULL(obj->object_data);
+    struct tcp_objectdata* object_data = (struct tcp_objectdata*)obj->object_data;
+    struct objectinterface_ip* ip_api = (struct objectinterface_ip*)object_data->ip_device->api;
+    uint32_t local_ip = (*ip_api->address)(object_data->ip_device);
+
+    // the next ephemeral port not in use to this destination
+    uint16_t port = 0;
+    for (uint16_t i = 0; (i <= (0xFFFF - TCP_EPHEMERAL_PORT_START)) && (0 == port); i++) {
+        uint16_t candidate = object_data->next_ephemeral_port;
+        if (candidate == 0xFFFF) {
+            object_data->next_ephemeral_port = TCP_EPHEMERAL_PORT_START;
+        } else {
+            object_data->next_ephemeral_port++;
+        }
+        if ((0 == tcp_find_connection(object_data, local_ip, candidate, dest_ip, dest_port)) &&
+            (0 == tcp_find_listener(object_data, candidate))) {
+            port = candidate;
+        }
+    }
+    if (0 == port) {
+        return 0;
+    }
+
+    tcp_enter(object_data);
+    struct tcp_connection* c = tcp_connection_new(object_data, local_ip, port, dest_ip, dest_port);
+    c->state = TCP_STATE_SYN_SENT;
+    c->cwnd = 2 * c->mss;
+    tcp_hash_connection(object_data, c);
+    c->rtt_timing = true;
+    c->rtt_seq = c->iss;
+    c->rtt_start = object_data->now;
+    tcp_output(obj, c);
+    tcp_leave(obj, object_data);
+    return c;
+}
+
+uint16_t tcp_send_data(struct object* obj, struct tcp_connection* c, uint8_t* data, uint16_t size) {
+    ASSERT_NOT_NULL(obj);
+    ASSERT_NOT_NULL(obj->object_data);
+    ASSERT_NOT_NULL(c);
+    ASSERT_NOT_NULL(data);
+    ASSERT(TCP_STATE_LISTEN != c->state);
+    struct tcp_objectdata* object_data = (struct tcp_objectdata*)obj->object_data;
+
+    if (c->fin_queued || ((TCP_STATE_SYN_SENT != c->state) && (TCP_STATE_SYN_RECEIVED != c->state) &&
+                          (TCP_STATE_ESTABLISHED != c->state) && (TCP_STATE_CLOSE_WAIT != c->state))) {
+        return 0;
+    }
+    tcp_enter(object_data);
+    uint16_t queued = spscring_put_bulk(c->send_buffer, data, size);
+    tcp_output(obj, c);
+    tcp_leave(obj, object_data);
+    return queued;
+}
+
+uint16_t tcp_receive(struct object* obj, struct tcp_connection* c, uint8_t* data, uint16_t size) {
+    ASSERT_NOT_NULL(obj);
+    ASSERT_NOT_NULL(obj->object_data);
+    ASSERT_NOT_NULL(c);
+    ASSERT_NOT_NULL(data);
+    ASSERT(TCP_STATE_LISTEN != c->state);
+    struct tcp_objectdata* object_data = (struct tcp_objectdata*)obj->object_data;
+
+    tcp_enter(object_data);
+    uint16_t copied = spscring_get_bulk(c->receive_buffer, data, size);
+    /*
+     * tell the peer once the window has opened by a segment or more, so a sender stopped by a full buffer
+     * doesn't have to wait for its persist timer
+     */
+    if ((copied > 0) && c->hashed && ((tcp_receive_window(c) - c->rcv_adv) >= c->mss)) {
+        tcp_send_ack(object_data, c);
+    }
+    tcp_leave(obj, object_data);
+    return copied;
+}
+
+void tcp_close(struct object* obj, struct tcp_connection* c) {
+    ASSERT_NOT_NULL(obj);
+    ASSERT_NOT_NULL(obj->object_data);
+    ASSERT_NOT_NULL(c);
+    struct tcp_objectdata* object_data = (struct tcp_objectdata*)obj->object_data;
+
+    tcp_enter(object_data);
+    c->user_closed = true;
+    if (TCP_STATE_LISTEN == c->state) {
+        // anything not yet accepted goes too
+        for (uint16_t i = 0; i < TCP_CONNECTION_BUCKETS; i++) {
+            struct tcp_connection* p = object_data->connections[i];
+            while (0 != p) {
+                struct tcp_connection* next = p->next;
+                if (p->listener == c) {
+                    tcp_send_reset(object_data, p);
+                    tcp_connection_closed(object_data, p);
+                }
+                p = next;
+            }
+        }
+        struct tcp_connection** link = &(object_data->listeners);
+        while (*link != c) {
+            ASSERT_NOT_NULL(*link);
+            link = &((*link)->next);
+        }
+        *link = c->next;
+        tcp_connection_delete(c);
+    } else if ((TCP_STATE_SYN_SENT == c->state) || (TCP_STATE_CLOSED == c->state)) {
+        tcp_connection_closed(object_data, c);
+    } else if ((TCP_STATE_SYN_RECEIVED == c->state) || (TCP_STATE_ESTABLISHED == c->state)) {
+        c->fin_queued = true;
+        c->state = TCP_STATE_FIN_WAIT_1;
+        tcp_output(obj, c);
+    } else if (TCP_STATE_CLOSE_WAIT == c->state) {
+        c->fin_queued = true;
+        c->state = TCP_STATE_LAST_ACK;
+        tcp_output(obj, c);
+    }
+    tcp_leave(obj, object_data);
+}
+
+uint8_t tcp_state(struct object* obj, struct tcp_connection* c) {
+    ASSERT_NOT_NULL(obj);
+    ASSERT_NOT_NULL(c);
+    return c->state;
+}
+
+uint32_t tcp_pending(struct object* obj, struct tcp_connection* c) {
+    ASSERT_NOT_NULL(obj);
+    ASSERT_NOT_NULL(c);
+    if (TCP_STATE_LISTEN == c->state) {
+        return c->accept_count;
+    }
+    return spscring_count(c->receive_buffer);
+}
+
+uint32_t tcp_space(struct object* obj, struct tcp_connection* c) {
+    ASSERT_NOT_NULL(obj);
+    ASSERT_NOT_NULL(c);
+    // as tcp_send_data: nothing more goes out once we have sent our FIN, or before the handshake has started
+    if (c->fin_queued || ((TCP_STATE_SYN_SENT != c->state) && (TCP_STATE_SYN_RECEIVED != c->state) &&
+                          (TCP_STATE_ESTABLISHED != c->state) && (TCP_STATE_CLOSE_WAIT != c->state))) {
+        return 0;
+    }
+    return spscring_space(c->send_buffer);
+}
+
+struct object* tcp_attach(struct object* ip_device, struct object* tick_device) {
     ASSERT_NOT_NULL(ip_device);
     ASSERT(ip_device->objectype == OBJECT_TYPE_IP);
+    if (0 != tick_device) {
+        ASSERT(tick_device->objectype == OBJECT_TYPE_TICK);
+    }
 
     /*
      * register device
@@ -71,24 +1350,38 @@ struct object* tcp_attach(struct object* ip_device) {
      */
     struct objectinterface_tcp* api = (struct objectinterface_tcp*)kmalloc(sizeof(struct objectinterface_tcp));
     memzero((uint8_t*)api, sizeof(struct objectinterface_tcp));
-    api->read = &tcp_read;
-    api->write = &tcp_write;
+    api->listen = &tcp_listen;
+    api->accept = &tcp_accept;
+    api->connect = &tcp_connect;
+    api->send = &tcp_send_data;
+    api->receive = &tcp_receive;
+    api->close = &tcp_close;
+    api->state = &tcp_state;
+    api->tick = &tcp_tick;
+    api->pending = &tcp_pending;
+    api->space = &tcp_space;
 
     objectinstance->api = api;
     /*
      * device data
      */
     struct tcp_objectdata* object_data = (struct tcp_objectdata*)kmalloc(sizeof(struct tcp_objectdata));
+    memzero((uint8_t*)object_data, sizeof(struct tcp_objectdata));
     object_data->ip_device = ip_device;
+    object_data->tick_device = tick_device;
+    object_data->next_ephemeral_port = TCP_EPHEMERAL_PORT_START;
     objectinstance->object_data = object_data;
     /*
      * register
      */
     if (0 != objectmgr_attach_object(objectinstance)) {
         /*
-        * increase ref count of underlying device
+        * increase ref count of underlying devices
         */
         objectmgr_increment_object_refcount(ip_device);
+        if (0 != tick_device) {
+            objectmgr_increment_object_refcount(tick_device);
+        }
         /*
         * return device
         */
@@ -106,11 +1399,14 @@ void tcp_detach(struct object* obj) {
     ASSERT_NOT_NULL(obj->object_data);
     struct tcp_objectdata* object_data = (struct tcp_objectdata*)obj->object_data;
     /*
-    * decrease ref count of underlying device
+    * decrease ref count of underlying devices
     */
     objectmgr_decrement_object_refcount(object_data->ip_device);
+    if (0 != object_data->tick_device) {
+        objectmgr_decrement_object_refcount(object_data->tick_device);
+    }
     /*
     * detach
     */
     objectmgr_detach_object(obj);
-}
\ No newline at end of file
+}
@@ -12,7 +12,7 @@
 
 struct object;
 
-struct object* tcp_attach(struct object* ip_device);
+struct object* tcp_attach(struct object* ip_device, struct object* tick_device);
 void tcp_detach(struct object* obj);
 
 #endif
\ No newline at end of file
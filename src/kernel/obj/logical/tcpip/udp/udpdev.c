@@ -5,19 +5,50 @@
 // See the file "LICENSE" in the source distribution for details  *
 // ****************************************************************
 
+#include <obj/logical/tcpip/ip/ipdev.h>
+#include <obj/logical/tcpip/net_endian.h>
+#include <obj/logical/tcpip/udp/udpdev.h>
 #include <sys/debug/assert.h>
 #include <sys/kmalloc/kmalloc.h>
 #include <sys/kprintf/kprintf.h>
+#include <sys/netbuf/netbuf.h>
 #include <sys/obj/object/object.h>
-#include <sys/obj/objectinterface/objectinterface_tcp.h>
+#include <sys/obj/objectinterface/objectinterface_ethernet.h>
+#include <sys/obj/objectinterface/objectinterface_ip.h>
+#include <sys/obj/objectinterface/objectinterface_udp.h>
 #include <sys/obj/objectmgr/objectmgr.h>
 #include <sys/obj/objecttype/objectype.h>
 #include <sys/string/mem.h>
 #include <types.h>
 
+#define UDP_PORT_BUCKETS 64     // sockets are hashed on port
+#define UDP_SOCKET_QUEUE_MAX 16  // datagrams held per socket before we start dropping
+
+struct udp_datagram {
+    struct udp_datagram* next;
+    uint32_t source_ip;
+    uint16_t source_port;
+    struct netbuf* payload;
+};
+
+struct udp_socket {
+    struct udp_socket* next;  // in the port bucket
+    uint16_t port;
+    uint16_t queued;
+    struct udp_datagram* head;
+    struct udp_datagram* tail;
+};
+
 struct udp_objectdata {
     struct object* ip_device;
-} __attribute__((packed));
+    struct udp_socket* ports[UDP_PORT_BUCKETS];
+    uint16_t next_ephemeral_port;
+    uint64_t rx_datagrams;
+    uint64_t rx_dropped;
+    uint64_t tx_datagrams;
+};
+
+void udp_input(struct object* obj, struct ip_header* ip, struct netbuf* payload);
 
 /*
  * perform device instance specific init here
@@ -26,31 +57,221 @@ uint8_t udp_init(struct object* obj) {
     ASSERT_NOT_NULL(obj);
     ASSERT_NOT_NULL(obj->object_data);
     struct udp_objectdata* object_data = (struct udp_objectdata*)obj->object_data;
+    struct objectinterface_ip* ip_api = (struct objectinterface_ip*)object_data->ip_device->api;
+    (*ip_api->register_protocol)(object_data->ip_device, IP_PROTOCOL_UDP, obj, &udp_input);
     kprintf("Init %s on %s (%s)\n", obj->description, object_data->ip_device->name, obj->name);
     return 1;
 }
 
+void udp_socket_delete(struct udp_socket* socket) {
+    while (0 != socket->head) {
+        struct udp_datagram* d = socket->head;
+        socket->head = d->next;
+        netbuf_release(d->payload);
+        kfree(d);
+    }
+    kfree(socket);
+}
+
 /*
  * perform device instance specific uninit here, like removing API structs and Device data
  */
 uint8_t udp_uninit(struct object* obj) {
     ASSERT_NOT_NULL(obj);
+    ASSERT_NOT_NULL(obj->object_data);
     kprintf("Uninit %s (%s)\n", obj->description, obj->name);
+    struct udp_objectdata* object_data = (struct udp_objectdata*)obj->object_data;
+    struct objectinterface_ip* ip_api = (struct objectinterface_ip*)object_data->ip_device->api;
+    (*ip_api->register_protocol)(object_data->ip_device, IP_PROTOCOL_UDP, 0, 0);
+    for (uint16_t i = 0; i < UDP_PORT_BUCKETS; i++) {
+        while (0 != object_data->ports[i]) {
+            struct udp_socket* socket = object_data->ports[i];
+            object_data->ports[i] = socket->next;
+            udp_socket_delete(socket);
+        }
+    }
     kfree(obj->api);
     kfree(obj->object_data);
 
     return 1;
 }
 
-void udp_read(struct object* obj, uint8_t* data, uint16_t size) {
+struct udp_socket* udp_find_socket(struct udp_objectdata* object_data, uint16_t port) {
+    struct udp_socket* socket = object_data->ports[port % UDP_PORT_BUCKETS];
+    while (0 != socket) {
+        if (socket->port == port) {
+            return socket;
+        }
+        socket = socket->next;
+    }
+    return 0;
+}
+
+/*
+ * datagrams from the IP object. queue them on the socket bound to the destination port; the socket keeps the
+ * buffer they came in, rather than a copy
+ */
+void udp_input(struct object* obj, struct ip_header* ip, struct netbuf* payload) {
+    ASSERT_NOT_NULL(obj);
+    ASSERT_NOT_NULL(obj->object_data);
+    ASSERT_NOT_NULL(ip);
+    ASSERT_NOT_NULL(payload);
+    struct udp_objectdata* object_data = (struct udp_objectdata*)obj->object_data;
+    object_data->rx_datagrams++;
+
+    if (payload->len < UDP_HEADER_LEN) {
+        object_data->rx_dropped++;
+        return;
+    }
+    struct udp_header* header = (struct udp_header*)payload->data;
+    uint16_t len = switch_endian16(header->len);
+    if ((len < UDP_HEADER_LEN) || (len > netbuf_length(payload))) {
+        object_data->rx_dropped++;
+        return;
+    }
+    // a zero checksum means the sender didn't compute one. if the NIC checked it, or it never left the machine,
+    // there is nothing to do
+    if ((0 != header->csum) && (NETBUF_CSUM_NONE == payload->csum) &&
+        (0 != ip_checksum_pseudo(ip->saddr, ip->daddr, IP_PROTOCOL_UDP, payload, len))) {
+        object_data->rx_dropped++;
+        return;
+    }
+
+    struct udp_socket* socket = udp_find_socket(object_data, switch_endian16(header->dest_port));
+    if ((0 == socket) || (socket->queued >= UDP_SOCKET_QUEUE_MAX)) {
+        object_data->rx_dropped++;
+        return;
+    }
+
+    struct udp_datagram* d = (struct udp_datagram*)kmalloc(sizeof(struct udp_datagram));
+    d->next = 0;
+    d->source_ip = switch_endian32(ip->saddr);
+    d->source_port = switch_endian16(header->source_port);
+    netbuf_trim(payload, len);
+    netbuf_pull(payload, UDP_HEADER_LEN);
+    d->payload = netbuf_retain(payload);
+    if (0 == socket->tail) {
+        socket->head = d;
+    } else {
+        socket->tail->next = d;
+    }
+    socket->tail = d;
+    socket->queued++;
+}
+
+struct udp_socket* udp_open(struct object* obj, uint16_t port) {
+    ASSERT_NOT_NULL(obj);
+    ASSERT_NOT_NULL(obj->object_data);
+    struct udp_objectdata* object_data = (struct udp_objectdata*)obj->object_data;
+
+    if (0 == port) {
+        // the next free port in the ephemeral range
+        for (uint16_t i = 0; (i <= (0xFFFF - UDP_EPHEMERAL_PORT_START)) && (0 == port); i++) {
+            uint16_t candidate = object_data->next_ephemeral_port;
+            if (candidate == 0xFFFF) {
+                object_data->next_ephemeral_port = UDP_EPHEMERAL_PORT_START;
+            } else {
+                object_data->next_ephemeral_port++;
+            }
+            if (0 == udp_find_socket(object_data, candidate)) {
+                port = candidate;
+            }
+        }
+        if (0 == port) {
+            return 0;
+        }
+    } else if (0 != udp_find_socket(object_data, port)) {
+        return 0;
+    }
+
+    struct udp_socket* socket = (struct udp_socket*)kmalloc(sizeof(struct udp_socket));
+    memzero((uint8_t*)socket, sizeof(struct udp_socket));
+    socket->port = port;
+    socket->next = object_data->ports[port % UDP_PORT_BUCKETS];
+    object_data->ports[port % UDP_PORT_BUCKETS] = socket;
+    return socket;
+}
+
+void udp_close(struct object* obj, struct udp_socket* socket) {
     ASSERT_NOT_NULL(obj);
     ASSERT_NOT_NULL(obj->object_data);
-    //  struct ip_objectdata* object_data = (struct ip_objectdata*)obj->object_data;
+    ASSERT_NOT_NULL(socket);
+    struct udp_objectdata* object_data = (struct udp_objectdata*)obj->object_data;
+
+    struct udp_socket** link = &(object_data->ports[socket->port % UDP_PORT_BUCKETS]);
+    while (*link != socket) {
+        ASSERT_NOT_NULL(*link);
+        link = &((*link)->next);
+    }
+    *link = socket->next;
+    udp_socket_delete(socket);
+}
+
+uint16_t udp_port(struct object* obj, struct udp_socket* socket) {
+    ASSERT_NOT_NULL(obj);
+    ASSERT_NOT_NULL(socket);
+    return socket->port;
 }
-void udp_write(struct object* obj, uint8_t* data, uint16_t size) {
+
+uint16_t udp_send(struct object* obj, struct udp_socket* socket, uint32_t dest_ip, uint16_t dest_port,
+                  struct netbuf* data) {
     ASSERT_NOT_NULL(obj);
     ASSERT_NOT_NULL(obj->object_data);
-    //   struct ip_objectdata* object_data = (struct ip_objectdata*)obj->object_data;
+    ASSERT_NOT_NULL(socket);
+    ASSERT_NOT_NULL(data);
+    struct udp_objectdata* object_data = (struct udp_objectdata*)obj->object_data;
+    struct objectinterface_ip* ip_api = (struct objectinterface_ip*)object_data->ip_device->api;
+
+    // no fragmentation, so it has to fit in one frame
+    uint16_t size = netbuf_length(data);
+    if ((size + UDP_HEADER_LEN + IP_HEADER_LEN) > ETHERNET_MTU) {
+        netbuf_release(data);
+        return 0;
+    }
+
+    uint16_t len = size + UDP_HEADER_LEN;
+    struct udp_header* header = (struct udp_header*)netbuf_push(data, UDP_HEADER_LEN);
+    header->source_port = switch_endian16(socket->port);
+    header->dest_port = switch_endian16(dest_port);
+    header->len = switch_endian16(len);
+    uint32_t saddr = switch_endian32((*ip_api->address)(object_data->ip_device));
+    ip_checksum_partial(data, saddr, switch_endian32(dest_ip), IP_PROTOCOL_UDP, UDP_CSUM_OFFSET);
+
+    object_data->tx_datagrams++;
+    (*ip_api->write)(object_data->ip_device, dest_ip, IP_PROTOCOL_UDP, data);
+    return size;
+}
+
+struct netbuf* udp_receive(struct object* obj, struct udp_socket* socket, uint32_t* source_ip,
+                           uint16_t* source_port) {
+    ASSERT_NOT_NULL(obj);
+    ASSERT_NOT_NULL(socket);
+
+    struct udp_datagram* d = socket->head;
+    if (0 == d) {
+        return 0;
+    }
+    socket->head = d->next;
+    if (0 == socket->head) {
+        socket->tail = 0;
+    }
+    socket->queued--;
+
+    struct netbuf* ret = d->payload;
+    if (0 != source_ip) {
+        *source_ip = d->source_ip;
+    }
+    if (0 != source_port) {
+        *source_port = d->source_port;
+    }
+    kfree(d);
+    return ret;
+}
+
+uint16_t udp_pending(struct object* obj, struct udp_socket* socket) {
+    ASSERT_NOT_NULL(obj);
+    ASSERT_NOT_NULL(socket);
+    return socket->queued;
 }
 
 struct object* udp_attach(struct object* ip_device) {
@@ -69,17 +290,23 @@ struct object* udp_attach(struct object* ip_device) {
     /*
      * the device api
      */
-    struct objectinterface_tcp* api = (struct objectinterface_tcp*)kmalloc(sizeof(struct objectinterface_tcp));
-    memzero((uint8_t*)api, sizeof(struct objectinterface_tcp));
-    api->read = &udp_read;
-    api->write = &udp_write;
+    struct objectinterface_udp* api = (struct objectinterface_udp*)kmalloc(sizeof(struct objectinterface_udp));
+    memzero((uint8_t*)api, sizeof(struct objectinterface_udp));
+    api->open = &udp_open;
+    api->close = &udp_close;
+    api->port = &udp_port;
+    api->send = &udp_send;
+    api->receive = &udp_receive;
+    api->pending = &udp_pending;
 
     objectinstance->api = api;
     /*
      * device data
      */
     struct udp_objectdata* object_data = (struct udp_objectdata*)kmalloc(sizeof(struct udp_objectdata));
+    memzero((uint8_t*)object_data, sizeof(struct udp_objectdata));
     object_data->ip_device = ip_device;
+    object_data->next_ephemeral_port = UDP_EPHEMERAL_PORT_START;
     objectinstance->object_data = object_data;
     /*
      * register
@@ -5,6 +5,7 @@
 // See the file "LICENSE" in the source distribution for details  *
 // ****************************************************************
 
+#include <sys/collection/arraylist/arraylist.h>
 #include <sys/debug/assert.h>
 #include <sys/kmalloc/kmalloc.h>
 #include <sys/kprintf/kprintf.h>
@@ -16,9 +17,60 @@
 #include <sys/string/mem.h>
 #include <types.h>
 
+struct tick_subscription {
+    struct object* subscriber;
+    tick_event_function event;
+};
+
 struct tick_objectdata {
     struct object* pit_device;
-} __attribute__((packed));
+    struct arraylist* subscriptions;
+    uint64_t pending;  // ticks counted by the interrupt that subscribers haven't been told about
+};
+
+/*
+ * PIT events don't say which tick object they are for, so we keep a list of them, and subscribe with the PIT
+ * once, when the first one attaches
+ */
+struct arraylist* tick_objects = 0;
+
+/*
+ * the interrupt only counts the tick.  subscribers send, and allocate, and so take locks the interrupted thread may
+ * hold; they are told from tick_run instead
+ */
+void tick_pit_event() {
+    for (uint32_t i = 0; i < arraylist_count(tick_objects); i++) {
+        struct object* obj = (struct object*)arraylist_get(tick_objects, i);
+        struct tick_objectdata* object_data = (struct tick_objectdata*)obj->object_data;
+        __atomic_add_fetch(&(object_data->pending), 1, __ATOMIC_RELEASE);
+    }
+}
+
+/*
+ * tell the subscribers about each tick since the last run.  called from thread context, by the idle loop and
+ * whatever is waiting
+ */
+void tick_run() {
+    if (0 == tick_objects) {
+        return;
+    }
+    for (uint32_t i = 0; i < arraylist_count(tick_objects); i++) {
+        struct object* obj = (struct object*)arraylist_get(tick_objects, i);
+        struct tick_objectdata* object_data = (struct tick_objectdata*)obj->object_data;
+        uint64_t pending = __atomic_exchange_n(&(object_data->pending), 0, __ATOMIC_ACQUIRE);
+        if (0 == pending) {
+            continue;
+        }
+        struct objectinterface_pit* api = (struct objectinterface_pit*)object_data->pit_device->api;
+        uint64_t tick = (*api->tickcount)(object_data->pit_device);
+        for (uint64_t k = pending; k > 0; k--) {
+            for (uint32_t j = 0; j < arraylist_count(object_data->subscriptions); j++) {
+                struct tick_subscription* s = (struct tick_subscription*)arraylist_get(object_data->subscriptions, j);
+                (*s->event)(s->subscriber, tick - (k - 1));
+            }
+        }
+    }
+}
 
 /*
  * perform device instance specific init here
@@ -28,6 +80,12 @@ uint8_t tick_init(struct object* obj) {
     ASSERT_NOT_NULL(obj->object_data);
     struct tick_objectdata* object_data = (struct tick_objectdata*)obj->object_data;
     kprintf("Init %s on %s (%s)\n", obj->description, object_data->pit_device->name, obj->name);
+    if (0 == tick_objects) {
+        tick_objects = arraylist_new();
+        struct objectinterface_pit* api = (struct objectinterface_pit*)object_data->pit_device->api;
+        (*api->subscribe)(&tick_pit_event);
+    }
+    arraylist_add(tick_objects, obj);
     return 1;
 }
 
@@ -39,7 +97,19 @@ uint8_t tick_uninit(struct object* obj) {
     ASSERT_NOT_NULL(obj->object_data);
 
     kprintf("Uninit %s (%s)\n", obj->description, obj->name);
+    struct tick_objectdata* object_data = (struct tick_objectdata*)obj->object_data;
+    for (uint32_t i = 0; i < arraylist_count(tick_objects); i++) {
+        if (arraylist_get(tick_objects, i) == obj) {
+            arraylist_remove(tick_objects, i);
+            break;
+        }
+    }
+    for (uint32_t i = 0; i < arraylist_count(object_data->subscriptions); i++) {
+        kfree(arraylist_get(object_data->subscriptions, i));
+    }
+    arraylist_delete(object_data->subscriptions);
     kfree(obj->api);
+    kfree(obj->object_data);
     return 1;
 }
 
@@ -52,6 +122,33 @@ uint64_t tick_read(struct object* obj) {
     return (*api->tickcount)(object_data->pit_device);
 }
 
+void tick_subscribe(struct object* obj, struct object* subscriber, tick_event_function event) {
+    ASSERT_NOT_NULL(obj);
+    ASSERT_NOT_NULL(obj->object_data);
+    ASSERT_NOT_NULL(event);
+    struct tick_objectdata* object_data = (struct tick_objectdata*)obj->object_data;
+
+    struct tick_subscription* s = (struct tick_subscription*)kmalloc(sizeof(struct tick_subscription));
+    s->subscriber = subscriber;
+    s->event = event;
+    arraylist_add(object_data->subscriptions, s);
+}
+
+void tick_unsubscribe(struct object* obj, struct object* subscriber) {
+    ASSERT_NOT_NULL(obj);
+    ASSERT_NOT_NULL(obj->object_data);
+    struct tick_objectdata* object_data = (struct tick_objectdata*)obj->object_data;
+
+    for (uint32_t i = 0; i < arraylist_count(object_data->subscriptions); i++) {
+        struct tick_subscription* s = (struct tick_subscription*)arraylist_get(object_data->subscriptions, i);
+        if (s->subscriber == subscriber) {
+            arraylist_remove(object_data->subscriptions, i);
+            kfree(s);
+            return;
+        }
+    }
+}
+
 struct object* tick_attach(struct object* pit_device) {
     ASSERT_NOT_NULL(pit_device);
     ASSERT(pit_device->objectype == OBJECT_TYPE_PIT);
@@ -70,12 +167,16 @@ struct object* tick_attach(struct object* pit_device) {
     struct objectinterface_tick* api = (struct objectinterface_tick*)kmalloc(sizeof(struct objectinterface_tick));
     memzero((uint8_t*)api, sizeof(struct objectinterface_tick));
     api->read = &tick_read;
+    api->subscribe = &tick_subscribe;
+    api->unsubscribe = &tick_unsubscribe;
     objectinstance->api = api;
     /*
      * device data
      */
     struct tick_objectdata* object_data = (struct tick_objectdata*)kmalloc(sizeof(struct tick_objectdata));
     object_data->pit_device = pit_device;
+    object_data->subscriptions = arraylist_new();
+    object_data->pending = 0;
     objectinstance->object_data = object_data;
     /*
      * register
@@ -90,7 +191,9 @@ struct object* tick_attach(struct object* pit_device) {
         */
         return objectinstance;
     } else {
+        arraylist_delete(object_data->subscriptions);
         kfree(api);
+        kfree(object_data);
         kfree(objectinstance);
         return 0;
     }
@@ -18,5 +18,6 @@ struct object;
 
 struct object* tick_attach(struct object* pit_device);
 void tick_detach(struct object* obj);
+void tick_run();
 
 #endif
\ No newline at end of file
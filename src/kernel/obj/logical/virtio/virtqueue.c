@@ -9,16 +9,21 @@
 #include <sys/debug/assert.h>
 #include <sys/iobuffers/iobuffers.h>
 #include <sys/kmalloc/kmalloc.h>
+#include <sys/kmalloc/kpool.h>
 #include <sys/kprintf/kprintf.h>
 #include <sys/panic/panic.h>
-#include <sys/x86-64/mm/pagetables.h>
+
+// a descriptor is allocated for every packet sent or received
+kpool virtq_descriptor_pool = KPOOL_INIT("virtq_descriptor", struct virtq_descriptor, NULL);
 
 /*
  * create virtq
  */
 struct virtq* virtq_new(uint16_t size) {
-    // virtqueue must be aligned on a 4096-byte boundary
-    struct virtq* ret = (struct virtq*)iobuffers_request_buffer(sizeof(struct virtq));  // 32-bit identity mapped
+    // virtqueue must be aligned on a 4096-byte boundary; a page-class io buffer is
+    ASSERT(sizeof(struct virtq) <= 4096);
+    struct virtq* ret = (struct virtq*)iobuffers_request_buffer(4096);  // 32-bit identity mapped
+    ASSERT_NOT_NULL(ret);
     /*
      * size
      */
@@ -93,13 +98,16 @@ void virtq_delete(struct virtq* queue) {
     if (0 != queue->descriptors) {
         for (uint16_t i = 0; i < queue->size; i++) {
             if (0 != (queue->descriptors)[i]) {
-                kfree((queue->descriptors)[i]);
+                virtq_descriptor_delete((queue->descriptors)[i]);
             }
         }
     } else {
         PANIC("descriptor array should not be null in virtq_delete");
     }
-    kfree(queue);
+    kfree(queue->descriptors);
+    kfree(queue->avail.ring);
+    kfree(queue->used.ring);
+    iobuffers_release_buffer(queue);
 }
 
 /**
@@ -170,10 +178,10 @@ struct virtq_descriptor* virtq_dequeue_descriptor(struct virtq* queue) {
  */
 struct virtq_descriptor* virtq_descriptor_new(uint8_t* buffer, uint32_t len, bool writable) {
     ASSERT_NOT_NULL(buffer);
-    struct virtq_descriptor* ret = kmalloc(sizeof(struct virtq_descriptor));
+    struct virtq_descriptor* ret = kpool_alloc(&virtq_descriptor_pool);
 
-    // buffer address must be guest-physical
-    ret->addr = (uint64_t)CONV_DMAP_ADDR(buffer);
+    // buffer address must be guest-physical, so the buffer must come from iobuffers
+    ret->addr = iobuffers_phys_address(buffer);
 
     if (writable) {
         ret->flags = VIRTQ_DESC_F_DEVICE_WRITE_ONLY;
@@ -191,11 +199,19 @@ struct virtq_descriptor* virtq_descriptor_new(uint8_t* buffer, uint32_t len, boo
 void virtq_descriptor_delete(struct virtq_descriptor* descriptor) {
     ASSERT_NOT_NULL(descriptor);
     if (0 != descriptor->addr) {
-        kfree((uint8_t*)descriptor->addr);
+        iobuffers_release_buffer(iobuffers_virt_address(descriptor->addr));
     } else {
         PANIC("virtq_descriptor address should not be zero");
     }
-    kfree(descriptor);
+    kpool_free(&virtq_descriptor_pool, descriptor);
+}
+
+/*
+ * delete descriptor, leaving its buffer to whoever owns it
+ */
+void virtq_descriptor_free(struct virtq_descriptor* descriptor) {
+    ASSERT_NOT_NULL(descriptor);
+    kpool_free(&virtq_descriptor_pool, descriptor);
 }
 
 /*
@@ -76,6 +76,7 @@ struct virtq_descriptor* virtq_dequeue_descriptor(struct virtq* queue);
 // descriptors
 struct virtq_descriptor* virtq_descriptor_new(uint8_t* buffer, uint32_t len, bool writable);
 void virtq_descriptor_delete(struct virtq_descriptor* descriptor);
+void virtq_descriptor_free(struct virtq_descriptor* descriptor);
 
 // available
 uint16_t virtq_get_available_idx(struct virtq* queue);
@@ -18,6 +18,7 @@
 #include <sys/iobuffers/iobuffers.h>
 #include <sys/kmalloc/kmalloc.h>
 #include <sys/kprintf/kprintf.h>
+#include <sys/netbuf/netbuf.h>
 #include <sys/obj/object/object.h>
 #include <sys/obj/objectinterface/objectinterface_nic.h>
 #include <sys/obj/objectmgr/objectmgr.h>
@@ -76,9 +77,8 @@ void vnic_init_virtqueue(struct virtq** virtqueue, uint16_t queueIndex) {
     ASSERT(q_aligned);
     *virtqueue = q;
 
-    // divide by 4096
-    // The API takes a 32 bit pointer, but we have a 64 bit pointer, so ... some conversions
-    uint32_t q_shifted = (uint64_t)q >> 12;
+    // The API takes a 32 bit physical page number
+    uint32_t q_shifted = iobuffers_phys_address(q) >> 12;
 
     kprintf("  Queue Address(%u): %#hX\n", queueIndex, q);
 
@@ -135,7 +135,8 @@ uint8_t vnic_initialize_device(struct object* obj) {
     }
 
     // Tell the device what features we'll be using
-    vnic_write_register(VIRTIO_GUEST_FEATURES, VIRTIO_NET_REQUIRED_FEATURES);
+    object_data->features = VIRTIO_NET_REQUIRED_FEATURES | (features & VIRTIO_NET_OPTIONAL_FEATURES);
+    vnic_write_register(VIRTIO_GUEST_FEATURES, object_data->features);
 
     // Tell the device the features have been negotiated
     vnic_write_register(VIRTIO_DEVICE_STATUS,
@@ -162,9 +163,10 @@ uint8_t vnic_initialize_device(struct object* obj) {
     vnic_init_virtqueue(&(object_data->send_queue), VIRTQ_NET_TRANSMIT_INDEX);
 
     // Setup the receive queue
-    vnic_setup_receive_buffers(object_data->receive_queue, 16);
+    vnic_setup_receive_buffers(object_data, 16);
 
-    // Setup an interrupt handler for this device
+    // Setup an interrupt handler for this device. receiving is done by netpoll
+    netpoll_register(&(object_data->netpoll), obj);
     interrupt_router_register_interrupt_handler(obj->pci->irq, &vnic_irq_handler);
     kprintf("   init %s at IRQ %llu Vendor %#hX Device %#hX Base %#hX (%s)\n", obj->description, obj->pci->irq,
             obj->pci->vendor_id, obj->pci->device_id, object_data->base, obj->name);
@@ -186,21 +188,64 @@ uint8_t vnic_initialize_device(struct object* obj) {
     return 1;
 }
 
-void vnic_setup_receive_buffers(struct virtq* receiveQueue, uint8_t count) {
-    const uint16_t bufferSize = 1526;  // as per virtio specs
+/*
+ * give the device an empty netbuf to receive into. the device writes the virtio header and the frame from the start
+ * of the storage
+ */
+void vnic_queue_receive_buffer(struct vnic_objectdata* object_data, struct netbuf* nb) {
+    nb->next = object_data->rx_buffers;
+    object_data->rx_buffers = nb;
+    struct virtq_descriptor* desc = virtq_descriptor_new(nb->data, NETBUF_SIZE, true);
 
-    // Allocate and add 16 buffers to receive queue
-    for (uint16_t i = 0; i < count; ++i) {
-        uint8_t* buffer = kmalloc(bufferSize);
-        struct virtq_descriptor* desc = virtq_descriptor_new(buffer, bufferSize, true);
+    virtq_enqueue_descriptor(object_data->receive_queue, desc);
+}
 
-        virtq_enqueue_descriptor(receiveQueue, desc);
+void vnic_setup_receive_buffers(struct vnic_objectdata* object_data, uint8_t count) {
+    for (uint16_t i = 0; i < count; ++i) {
+        struct netbuf* nb = netbuf_new(0);
+        if (0 == nb) {
+            break;
+        }
+        vnic_queue_receive_buffer(object_data, nb);
     }
 
     vnic_write_register(VIRTIO_QUEUE_NOTIFY, VIRTQ_NET_RECEIVE_INDEX);
 }
 
-// the hardware raises an IRQ each time a TX frame is acknowledged, or an RX frame is ready for us.
+/*
+ * take the netbuf holding a descriptor's buffer off a list
+ */
+struct netbuf* vnic_take_buffer(struct netbuf** list, struct virtq_descriptor* desc) {
+    uint8_t* buffer = (uint8_t*)iobuffers_virt_address(desc->addr);
+    while (0 != *list) {
+        struct netbuf* nb = *list;
+        if ((buffer >= nb->head) && (buffer < (nb->head + NETBUF_SIZE))) {
+            *list = nb->next;
+            nb->next = 0;
+            return nb;
+        }
+        list = &(nb->next);
+    }
+    PANIC("vnic descriptor has no netbuf");
+    return 0;
+}
+
+/*
+ * free the netbufs of frames the device has sent. thread context only: releasing a netbuf takes the pool and
+ * iobuffers locks, and tx_buffers changes in vnic_tx
+ */
+void vnic_tx_clean(struct vnic_objectdata* object_data) {
+    while (object_data->send_queue->used.idx != object_data->send_queue->last_seen_used) {
+        struct virtq_descriptor* desc = virtq_dequeue_descriptor(object_data->send_queue);
+        netbuf_release(vnic_take_buffer(&(object_data->tx_buffers), desc));
+        virtq_descriptor_free(desc);
+    }
+}
+
+/*
+ * the hardware raises an IRQ each time a TX frame is acknowledged, or an RX frame is ready for us. both are left
+ * in the used rings for vnic_poll, in thread context
+ */
 void vnic_irq_handler(stack_frame* frame) {
     ASSERT_NOT_NULL(frame);
     kprintf("#");
@@ -217,30 +262,89 @@ void vnic_irq_handler(stack_frame* frame) {
     // get device data
     struct vnic_objectdata* object_data = (struct vnic_objectdata*)obj->object_data;
 
-    // check for used send queues (meaning the device confirmed receipt)
-    while (object_data->send_queue->used.idx != object_data->send_queue->last_seen_used) {
-        kprintf("irqh: Packet sent successfully");
-        struct virtq_descriptor* desc = virtq_dequeue_descriptor(object_data->send_queue);
-        virtq_descriptor_delete(desc);
+    // frames sent (the device confirmed receipt), or received
+    if ((object_data->send_queue->used.idx != object_data->send_queue->last_seen_used) ||
+        (object_data->receive_queue->used.idx != object_data->receive_queue->last_seen_used)) {
+        netpoll_interrupt(&(object_data->netpoll));
     }
 
-    // see if the receive queue has been used
-    while (object_data->receive_queue->used.idx != object_data->receive_queue->last_seen_used) {
-        kprintf("irqh: Packet received successfully");
-
-        // get the descriptor
-        struct virtq_descriptor* desc = virtq_dequeue_descriptor(object_data->receive_queue);
-
-        // TODO: something with the data
+    // EOI sent to the PIC by the interrupt handler
+}
 
-        // delete the descriptor
-        virtq_descriptor_delete(desc);
+/*
+ * free what has been sent, and hand up to budget received frames up the stack. returns how many it took
+ */
+uint16_t vnic_poll(struct object* obj, uint16_t budget) {
+    ASSERT_NOT_NULL(obj);
+    struct vnic_objectdata* object_data = (struct vnic_objectdata*)obj->object_data;
+    vnic_tx_clean(object_data);
+    struct virtq* rq = object_data->receive_queue;
+    uint16_t done = 0;
+    while ((done < budget) && (rq->used.idx != rq->last_seen_used)) {
+        // the device tells us how much it wrote, header included
+        uint32_t len = rq->used.ring[rq->last_seen_used % rq->size].len;
+
+        // get the descriptor, and the netbuf the device wrote into
+        struct virtq_descriptor* desc = virtq_dequeue_descriptor(rq);
+        struct netbuf* nb = vnic_take_buffer(&(object_data->rx_buffers), desc);
+        virtq_descriptor_free(desc);
+
+        // the buffer to restock the queue with. without one, the frame is dropped, and its buffer goes back
+        struct netbuf* fresh = netbuf_new(0);
+        if (0 == fresh) {
+            vnic_queue_receive_buffer(object_data, nb);
+            vnic_write_register(VIRTIO_QUEUE_NOTIFY, VIRTQ_NET_RECEIVE_INDEX);
+            done++;
+            continue;
+        }
+
+        // hand the frame, without the virtio header, up the stack, in the buffer it arrived in
+        if ((0 != object_data->receive) && (len > sizeof(virtio_net_hdr)) && (len <= NETBUF_SIZE)) {
+            netbuf_put(nb, len);
+            // the device may have left the checksum to us, or checked it. csum_start counts from the frame
+            virtio_net_hdr* header = (virtio_net_hdr*)nb->data;
+            if (0 != (header->flags & VIRTIO_NET_HDR_F_NEEDS_CSUM)) {
+                nb->csum = NETBUF_CSUM_PARTIAL;
+                nb->csum_start = sizeof(virtio_net_hdr) + header->csum_start;
+                nb->csum_offset = header->csum_offset;
+            } else if (0 != (header->flags & VIRTIO_NET_HDR_F_DATA_VALID)) {
+                nb->csum = NETBUF_CSUM_VALID;
+            }
+            netbuf_pull(nb, sizeof(virtio_net_hdr));
+            (*object_data->receive)(object_data->receiver, nb);
+        }
+        netbuf_release(nb);
 
         // restock receive queue buffer
-        vnic_setup_receive_buffers(object_data->receive_queue, 1);
+        vnic_queue_receive_buffer(object_data, fresh);
+        vnic_write_register(VIRTIO_QUEUE_NOTIFY, VIRTQ_NET_RECEIVE_INDEX);
+        done++;
     }
+    return done;
+}
 
-    // EOI sent to the PIC by the interrupt handler
+/*
+ * the receive queue's interrupt, off while netpoll has us on its list. the device won't interrupt for buffers it
+ * used while it was off, so we say if there are any, or sent frames still to free
+ */
+bool vnic_interrupts(struct object* obj, bool enable) {
+    ASSERT_NOT_NULL(obj);
+    struct vnic_objectdata* object_data = (struct vnic_objectdata*)obj->object_data;
+    struct virtq* rq = object_data->receive_queue;
+    if (!enable) {
+        rq->avail.flags |= VIRTQ_AVAIL_F_NO_INTERRUPT;
+        return false;
+    }
+    rq->avail.flags &= ~VIRTQ_AVAIL_F_NO_INTERRUPT;
+    __atomic_thread_fence(__ATOMIC_SEQ_CST);
+    struct virtq* sq = object_data->send_queue;
+    return (rq->used.idx != rq->last_seen_used) || (sq->used.idx != sq->last_seen_used);
+}
+
+void vnic_stats(struct object* obj, struct nic_stats* stats) {
+    ASSERT_NOT_NULL(obj);
+    struct vnic_objectdata* object_data = (struct vnic_objectdata*)obj->object_data;
+    netpoll_stats(&(object_data->netpoll), stats);
 }
 
 void vnic_rx(struct object* obj, uint8_t* data, uint16_t size) {
@@ -249,27 +353,68 @@ void vnic_rx(struct object* obj, uint8_t* data, uint16_t size) {
     PANIC("vnic read not implemented yet");
 }
 
-void vnic_tx(struct object* obj, uint8_t* data, uint16_t size) {
+void vnic_set_receiver(struct object* obj, struct object* receiver, nic_receive_function receive) {
     ASSERT_NOT_NULL(obj);
-    ASSERT_NOT_NULL(data);
+    struct vnic_objectdata* object_data = (struct vnic_objectdata*)obj->object_data;
+    object_data->receiver = receiver;
+    object_data->receive = receive;
+}
+
+void vnic_hw_address(struct object* obj, uint8_t* hw_address) {
+    ASSERT_NOT_NULL(obj);
+    ASSERT_NOT_NULL(hw_address);
+    memcpy(hw_address, mac_addr, NIC_HW_ADDRESS_LEN);
+}
+
+uint8_t vnic_offload(struct object* obj) {
+    ASSERT_NOT_NULL(obj);
+    struct vnic_objectdata* object_data = (struct vnic_objectdata*)obj->object_data;
+    uint8_t ret = 0;
+    if (0 != (object_data->features & VIRTIO_NET_F_CSUM)) {
+        ret |= NIC_OFFLOAD_TX_CSUM;
+    }
+    if (0 != (object_data->features & VIRTIO_NET_F_GUEST_CSUM)) {
+        ret |= NIC_OFFLOAD_RX_CSUM;
+    }
+    return ret;
+}
+
+void vnic_tx(struct object* obj, struct netbuf* frame) {
+    ASSERT_NOT_NULL(obj);
+    ASSERT_NOT_NULL(frame);
 
     kprintf("vnic_tx sending data\n");
 
-    // Allocate a buffer for the packet & header
-    uint32_t bufferSize = size + sizeof(virtio_net_hdr);
-    virtio_net_hdr* netBuffer = iobuffers_request_buffer(bufferSize);
+    // the device gets one buffer, so a chain is gathered into one segment
+    frame = netbuf_linearize(frame);
+    if (0 == frame) {
+        // no buffer to gather it into
+        return;
+    }
 
-    // Set the header (basic for now - all zeros)
-    memzero((uint8_t*)netBuffer, sizeof(virtio_net_hdr));
+    // Set the header, in the headroom in front of the frame
+    virtio_net_hdr* header = (virtio_net_hdr*)netbuf_push(frame, sizeof(virtio_net_hdr));
+    memzero((uint8_t*)header, sizeof(virtio_net_hdr));
 
-    // Copy packet to buffer
-    memcpy((uint8_t*)((uint8_t*)netBuffer + sizeof(virtio_net_hdr)), (uint8_t*)data, size);
+    // the device does the checksum we left it. csum_start counts from the frame, after the header
+    if (NETBUF_CSUM_PARTIAL == frame->csum) {
+        header->flags = VIRTIO_NET_HDR_F_NEEDS_CSUM;
+        header->csum_start = frame->csum_start - netbuf_headroom(frame) - sizeof(virtio_net_hdr);
+        header->csum_offset = frame->csum_offset;
+    }
 
     // get the device data
     struct vnic_objectdata* object_data = (struct vnic_objectdata*)obj->object_data;
 
+    // make room, freeing whatever has gone since the last poll
+    vnic_tx_clean(object_data);
+
+    // the device owns the netbuf until it tells us it's sent
+    frame->next = object_data->tx_buffers;
+    object_data->tx_buffers = frame;
+
     // load a descriptor with our buffer
-    struct virtq_descriptor* desc = virtq_descriptor_new((uint8_t*)netBuffer, bufferSize, false);
+    struct virtq_descriptor* desc = virtq_descriptor_new(frame->data, frame->len, false);
 
     // queue it up
     virtq_enqueue_descriptor(object_data->send_queue, desc);
@@ -301,10 +446,17 @@ void objectmgr_register_pci_vnic(struct pci_device* dev) {
     memzero((uint8_t*)api, sizeof(struct objectinterface_nic));
     api->write = &vnic_tx;
     api->read = &vnic_rx;
+    api->set_receiver = &vnic_set_receiver;
+    api->hw_address = &vnic_hw_address;
+    api->offload = &vnic_offload;
+    api->poll = &vnic_poll;
+    api->interrupts = &vnic_interrupts;
+    api->stats = &vnic_stats;
     objectinstance->api = api;
 
     // reserve for device-specific data
     struct vnic_objectdata* object_data = (struct vnic_objectdata*)kmalloc(sizeof(struct vnic_objectdata));
+    memzero((uint8_t*)object_data, sizeof(struct vnic_objectdata));
     objectinstance->object_data = object_data;
 
     // register
@@ -8,6 +8,8 @@
 #ifndef _VNIC_H
 #define _VNIC_H
 
+#include <sys/netpoll/netpoll.h>
+#include <sys/obj/objectinterface/objectinterface_nic.h>
 #include <sys/x86-64/idt/irq.h>
 #include <types.h>
 
@@ -23,9 +25,9 @@ struct virtq;
 #define REG_NIC_STATUS 0x1A
 
 // Feature bits (See 5.1.3 of virtio-v1.0-cs04.pdf)
-#define VIRTIO_NET_F_CSUM 0
-#define VIRTIO_NET_F_GUEST_CSUM 1
-#define VIRTIO_NET_F_CTRL_GUEST_OFFLOADS 2
+#define VIRTIO_NET_F_CSUM 0x1
+#define VIRTIO_NET_F_GUEST_CSUM 0x2
+#define VIRTIO_NET_F_CTRL_GUEST_OFFLOADS 0x4
 #define VIRTIO_NET_F_MAC 0x20
 #define VIRTIO_NET_F_GUEST_TSO4 0x80
 #define VIRTIO_NET_F_GUEST_TSO6 0x100
@@ -48,7 +50,10 @@ struct virtq;
 // These are the features required by this driver
 #undef VIRTIO_NET_REQUIRED_FEATURES
 #define VIRTIO_NET_REQUIRED_FEATURES                                                                                   \
-    (/* VIRTIO_NET_F_CSUM | */ VIRTIO_NET_F_MAC | VIRTIO_NET_F_MRG_RXBUF | VIRTIO_NET_F_STATUS)
+    (VIRTIO_NET_F_MAC | VIRTIO_NET_F_MRG_RXBUF | VIRTIO_NET_F_STATUS)
+
+// and these we use if the device has them
+#define VIRTIO_NET_OPTIONAL_FEATURES (VIRTIO_NET_F_CSUM | VIRTIO_NET_F_GUEST_CSUM)
 
 // Indexes of virtqs on device. See // see 4.1.5.1.3 of virtio-v1.0-cs04.pdf
 #define VIRTQ_NET_RECEIVE_INDEX 0
@@ -85,6 +90,13 @@ struct vnic_objectdata {
     uint64_t base;
     struct virtq* send_queue;
     struct virtq* receive_queue;
+    struct object* receiver;
+    nic_receive_function receive;
+    // the netbufs the device has been given, linked on next, so we can find them when it hands them back
+    struct netbuf* rx_buffers;
+    struct netbuf* tx_buffers;
+    uint32_t features;  // as negotiated
+    struct netpoll netpoll;
 };
 
 void objectmgr_register_vnic_devices();
@@ -93,7 +105,8 @@ uint32_t vnic_read_register(uint32_t reg);
 
 void vnic_write_register(uint32_t reg, uint32_t data);
 
-void vnic_setup_receive_buffers(struct virtq* receiveQueue, uint8_t count);
+void vnic_setup_receive_buffers(struct vnic_objectdata* object_data, uint8_t count);
+void vnic_queue_receive_buffer(struct vnic_objectdata* object_data, struct netbuf* nb);
 
 void vnic_irq_handler(stack_frame* frame);
 
@@ -9,7 +9,7 @@
 #include <obj/x86-64/ata/ata_dma.h>
 #include <sys/collection/linkedlist/linkedlist.h>
 #include <sys/iobuffers/iobuffers.h>
-#include <sys/kmalloc/kmalloc.h>
+#include <sys/kmalloc/kpool.h>
 #include <sys/kprintf/kprintf.h>
 #include <sys/string/mem.h>
 #include <sys/sync/sync.h>
@@ -26,6 +26,8 @@ ata_dma_buf* bufs;
 
 bool ata_dma_buf_avail[NUM_ATA_DMA_BUFS];
 
+kpool ata_dma_job_pool = KPOOL_INIT("ata_dma_job", ata_dma_job, NULL);
+
 linkedlist* dma_jobs;
 linkedlist* dma_ops;
 
@@ -33,7 +35,7 @@ void ata_dma_add_job(struct object* obj, uint64_t start, uint64_t count, BYTE* b
     ata_dma_job* cur_job;
 
     // Add the job queue entry
-    cur_job = kmalloc(sizeof(ata_dma_job));
+    cur_job = kpool_alloc(&ata_dma_job_pool);
     cur_job->buf = buf;
     cur_job->obj = obj;
     cur_job->dir = dir;
@@ -8,7 +8,7 @@
 #include <obj/x86-64/keyboard/abstract_keyboard.h>
 #include <obj/x86-64/keyboard/keyboard.h>
 #include <sys/asm/io.h>
-#include <sys/collection/ringbuffer/ringbuffer.h>
+#include <sys/collection/spscring/spscring.h>
 #include <sys/debug/assert.h>
 #include <sys/interrupt_router/interrupt_router.h>
 #include <sys/kmalloc/kmalloc.h>
@@ -17,7 +17,6 @@
 #include <sys/obj/objectinterface/objectinterface_keyboard.h>
 #include <sys/obj/objectmgr/objectmgr.h>
 #include <sys/obj/objecttype/objectype.h>
-#include <sys/panic/panic.h>
 #include <sys/x86-64/idt/irq.h>
 #include <types.h>
 
@@ -35,21 +34,30 @@
 #define KBD_TEST_FAILED_2 0xFD
 #define KBD_TEST_PASSED 0xAA
 
-#define KBD_RINGBUFFER_SIZE 255
+#define KBD_RING_SIZE 256
 
-struct ringbuffer* keyboard_ringbuffer;
+// key_action_t records, queued by keyboard_irq_read and dequeued by keyboard_read
+struct spscring* keyboard_ring;
 
 void keyboard_add_command_queue(uint8_t command) {}
 
+void keyboard_queue_action(key_action_t* keypress) {
+    // a record only goes in whole; if there isn't room for it the key is lost
+    if (spscring_space(keyboard_ring) >= sizeof(key_action_t)) {
+        spscring_put_bulk(keyboard_ring, (uint8_t*)keypress, sizeof(key_action_t));
+    }
+}
+
 void keyboard_irq_read(stack_frame* frame) {
     ASSERT_NOT_NULL(frame);
-    ASSERT_NOT_NULL(keyboard_ringbuffer);
+    ASSERT_NOT_NULL(keyboard_ring);
 
     kprintf(".");
     uint8_t read_byte;
     static bool long_scan_code = false, longer_scan_code = false;
     static bool prnt_scrn_scan_code = false;
-    key_action_t* keypress = kmalloc(sizeof(key_action_t));
+    key_action_t action;
+    key_action_t* keypress = &action;
 
     read_byte = asm_in_b(KBD_PORT);
 
@@ -62,14 +70,14 @@ void keyboard_irq_read(stack_frame* frame) {
         if (read_byte == 0x37) {
             keypress->key = P(0, 13);
             keypress->state = KEYPRESS_MAKE;
-            ringbuffer_add(keyboard_ringbuffer, keypress);
+            keyboard_queue_action(keypress);
             prnt_scrn_scan_code = false;  // done processing scan codes for print screen
         }
 
-        if ((read_byte = 0xAA)) {
+        if (read_byte == 0xAA) {
             keypress->key = P(0, 13);
             keypress->state = KEYPRESS_BREAK;
-            ringbuffer_add(keyboard_ringbuffer, keypress);
+            keyboard_queue_action(keypress);
             prnt_scrn_scan_code = false;
         }
 
@@ -103,7 +111,7 @@ void keyboard_irq_read(stack_frame* frame) {
             keypress->state = KEYPRESS_MAKE;
         }
 
-        ringbuffer_add(keyboard_ringbuffer, keypress);
+        keyboard_queue_action(keypress);
 
         long_scan_code = false;
 
@@ -117,10 +125,10 @@ void keyboard_irq_read(stack_frame* frame) {
         if (read_byte == 0xC5) {
             keypress->key = P(0, 15);
             keypress->state = KEYPRESS_MAKE;
-            ringbuffer_add(keyboard_ringbuffer, keypress);
+            keyboard_queue_action(keypress);
             keypress->key = P(0, 15);
             keypress->state = KEYPRESS_BREAK;
-            ringbuffer_add(keyboard_ringbuffer, keypress);
+            keyboard_queue_action(keypress);
 
             longer_scan_code = false;
         }
@@ -155,11 +163,11 @@ void keyboard_irq_read(stack_frame* frame) {
             if (read_byte >= 0x80) {
                 keypress->key = abstract_keyboard_grid[read_byte - 0x80];
                 keypress->state = KEYPRESS_BREAK;
-                ringbuffer_add(keyboard_ringbuffer, keypress);
+                keyboard_queue_action(keypress);
             } else {
                 keypress->key = abstract_keyboard_grid[read_byte];
                 keypress->state = KEYPRESS_MAKE;
-                ringbuffer_add(keyboard_ringbuffer, keypress);
+                keyboard_queue_action(keypress);
             }
 
             break;
@@ -183,17 +191,25 @@ uint8_t keyboard_obj_init(struct object* obj) {
     return 1;
 }
 
+/*
+ * returns the oldest queued key action, which the caller must kfree, or 0 if there isn't one
+ */
 key_action_t* keyboard_read(struct object* obj) {
     ASSERT_NOT_NULL(obj);
-    PANIC("Keyboard read not implemented yet");
-    return 0;
+    ASSERT_NOT_NULL(keyboard_ring);
+    if (spscring_count(keyboard_ring) < sizeof(key_action_t)) {
+        return 0;
+    }
+    key_action_t* ret = kmalloc(sizeof(key_action_t));
+    spscring_get_bulk(keyboard_ring, (uint8_t*)ret, sizeof(key_action_t));
+    return ret;
 }
 
 /**
  * find all keyboard devices and register them
  */
 void keyboard_objectmgr_register_objects() {
-    keyboard_ringbuffer = ringbuffer_new(KBD_RINGBUFFER_SIZE);
+    keyboard_ring = spscring_new(KBD_RING_SIZE);
 
     /*
      * register device
@@ -7,6 +7,7 @@
 
 #include <obj/x86-64/mouse/mouse.h>
 #include <sys/asm/io.h>
+#include <sys/collection/spscring/spscring.h>
 #include <sys/debug/assert.h>
 #include <sys/interrupt_router/interrupt_router.h>
 #include <sys/kmalloc/kmalloc.h>
@@ -20,6 +21,8 @@
 
 #define MOUSE_IRQ_NUMBER 12
 
+#define MOUSE_RING_SIZE 256
+
 #define MOUSE_PORT 0x64
 #define KB_PORT 0x60
 
@@ -47,27 +50,15 @@
 
 struct mouse_status* current_mouse_status;
 
+// raw packet bytes, queued by mouse_irq_read and assembled into current_mouse_status by ps2mouse_status
+struct spscring* mouse_ring;
+
 void mouse_irq_read(stack_frame* frame) {
     ASSERT_NOT_NULL(frame);
-    ASSERT_NOT_NULL(current_mouse_status);
+    ASSERT_NOT_NULL(mouse_ring);
 
     kprintf("$");
-    switch (current_mouse_status->mouse_cycle) {
-        case 0:
-            current_mouse_status->mouse_byte[0] = asm_in_b(KB_PORT);
-            current_mouse_status->mouse_cycle++;
-            break;
-        case 1:
-            current_mouse_status->mouse_byte[1] = asm_in_b(KB_PORT);
-            current_mouse_status->mouse_cycle++;
-            break;
-        case 2:
-            current_mouse_status->mouse_byte[2] = asm_in_b(KB_PORT);
-            current_mouse_status->mouse_x = current_mouse_status->mouse_byte[1];
-            current_mouse_status->mouse_y = current_mouse_status->mouse_byte[2];
-            current_mouse_status->mouse_cycle = 0;
-            break;
-    }
+    spscring_put(mouse_ring, asm_in_b(KB_PORT));
 }
 
 void mouse_wait(uint8_t a_type) {
@@ -112,11 +103,13 @@ uint8_t mouse_read() {
 uint8_t mouse_obj_init(struct object* obj) {
     ASSERT_NOT_NULL(obj);
     kprintf("Init %s at IRQ %llu (%s)\n", obj->description, MOUSE_IRQ_NUMBER, obj->name);
-    interrupt_router_register_interrupt_handler(MOUSE_IRQ_NUMBER, &mouse_irq_read);
 
     // alloc struct
     current_mouse_status = kmalloc(sizeof(struct mouse_status));
     current_mouse_status->mouse_cycle = 0;
+    mouse_ring = spscring_new(MOUSE_RING_SIZE);
+
+    interrupt_router_register_interrupt_handler(MOUSE_IRQ_NUMBER, &mouse_irq_read);
 
     // enable aux mouse
     mouse_wait(1);
@@ -145,6 +138,20 @@ uint8_t mouse_obj_init(struct object* obj) {
 struct mouse_status* ps2mouse_status(struct object* obj) {
     ASSERT_NOT_NULL(obj);
     ASSERT_NOT_NULL(current_mouse_status);
+    ASSERT_NOT_NULL(mouse_ring);
+
+    // catch up on whatever has arrived since we were last asked
+    uint8_t data;
+    while (spscring_get(mouse_ring, &data)) {
+        current_mouse_status->mouse_byte[current_mouse_status->mouse_cycle] = data;
+        if (current_mouse_status->mouse_cycle == 2) {
+            current_mouse_status->mouse_x = current_mouse_status->mouse_byte[1];
+            current_mouse_status->mouse_y = current_mouse_status->mouse_byte[2];
+            current_mouse_status->mouse_cycle = 0;
+        } else {
+            current_mouse_status->mouse_cycle++;
+        }
+    }
     return current_mouse_status;
 }
 
@@ -5,23 +5,278 @@
 // See the file "LICENSE" in the source distribution for details  *
 // ****************************************************************
 
+// https://wiki.osdev.org/Intel_Ethernet_i217
+
 #include <obj/x86-64/network/e1000/e1000.h>
 #include <obj/x86-64/pci/devicetree.h>
+#include <obj/x86-64/pci/pci.h>
 #include <obj/x86-64/pci/pci_device.h>
 #include <sys/debug/assert.h>
 #include <sys/interrupt_router/interrupt_router.h>
+#include <sys/iobuffers/iobuffers.h>
 #include <sys/kmalloc/kmalloc.h>
 #include <sys/kprintf/kprintf.h>
+#include <sys/netbuf/netbuf.h>
 #include <sys/obj/object/object.h>
 #include <sys/obj/objectinterface/objectinterface_nic.h>
 #include <sys/obj/objectmgr/objectmgr.h>
 #include <sys/obj/objecttype/objectype.h>
 #include <sys/panic/panic.h>
+#include <sys/sleep/sleep.h>
+#include <sys/string/mem.h>
 #include <sys/x86-64/idt/irq.h>
+#include <sys/x86-64/mm/pagetables.h>
 #include <types.h>
 
+#define E1000_DESCRIPTION "E1000 NIC"
+
+uint32_t e1000_read(struct e1000_objectdata* object_data, uint32_t reg) {
+    return *((volatile uint32_t*)(object_data->base + reg));
+}
+
+void e1000_write(struct e1000_objectdata* object_data, uint32_t reg, uint32_t value) {
+    *((volatile uint32_t*)(object_data->base + reg)) = value;
+}
+
+/*
+ * give a receive slot an empty netbuf
+ */
+void e1000_rx_refill(struct e1000_objectdata* object_data, uint16_t slot, struct netbuf* nb) {
+    object_data->rx_buffers[slot] = nb;
+    object_data->rx_ring[slot].addr = iobuffers_phys_address(nb->data);
+    object_data->rx_ring[slot].status = 0;
+}
+
+void e1000_tx_clean(struct e1000_objectdata* object_data);
+void e1000_tx_kick(struct e1000_objectdata* object_data, bool force);
+
+/*
+ * free what has been sent, and post what has been held back. then hand up to budget frames the device has finished
+ * up the stack, and give the descriptors back to the device, with one write of the tail for the lot. returns how
+ * many it took
+ */
+uint16_t e1000_poll(struct object* obj, uint16_t budget) {
+    ASSERT_NOT_NULL(obj);
+    ASSERT_NOT_NULL(obj->object_data);
+    struct e1000_objectdata* object_data = (struct e1000_objectdata*)obj->object_data;
+    e1000_tx_clean(object_data);
+    e1000_tx_kick(object_data, true);
+    uint16_t done = 0;
+    uint16_t last = 0;
+    while ((done < budget) && (0 != (object_data->rx_ring[object_data->rx_next].status & E1000_RXD_STAT_DD))) {
+        // the status is read before the rest of the descriptor
+        __atomic_thread_fence(__ATOMIC_ACQUIRE);
+        uint16_t slot = object_data->rx_next;
+        struct e1000_rx_desc* desc = &(object_data->rx_ring[slot]);
+        struct netbuf* nb = object_data->rx_buffers[slot];
+        struct netbuf* fresh = 0;
+        uint8_t status = desc->status;
+        uint8_t errors = desc->errors;
+
+        if (0 == (status & E1000_RXD_STAT_EOP)) {
+            // a frame bigger than a buffer; there shouldn't be one, since we don't do jumbo frames
+            object_data->rx_discard = true;
+            desc->status = 0;
+        } else if (object_data->rx_discard) {
+            object_data->rx_discard = false;
+            object_data->rx_dropped++;
+            desc->status = 0;
+        } else if (0 == (fresh = netbuf_new(0))) {
+            // nothing to replace the buffer with, so the frame is dropped, and the device gets the buffer back
+            object_data->rx_dropped++;
+            desc->status = 0;
+        } else {
+            netbuf_put(nb, desc->length);
+            if ((0 == (status & E1000_RXD_STAT_IXSM)) && (0 != (status & E1000_RXD_STAT_TCPCS)) &&
+                (0 == (errors & E1000_RXD_ERR_TCPE))) {
+                nb->csum = NETBUF_CSUM_VALID;
+            }
+            if (0 != object_data->receive) {
+                (*object_data->receive)(object_data->receiver, nb);
+            }
+            object_data->rx_packets++;
+            netbuf_release(nb);
+            e1000_rx_refill(object_data, slot, fresh);
+        }
+        last = slot;
+        done++;
+        object_data->rx_next = (slot + 1) % E1000_RX_DESCRIPTORS;
+    }
+    if (done > 0) {
+        __atomic_thread_fence(__ATOMIC_RELEASE);
+        e1000_write(object_data, E1000_RDT, last);
+    }
+    return done;
+}
+
+/*
+ * the receive interrupt, off while netpoll has us on its list. the device latches causes while they are masked,
+ * so unmasking raises any it missed, but a frame already done is worth a look anyway. so are sent frames, or held
+ * back ones, since a transmit interrupt that came while we were on the list only found us there
+ */
+bool e1000_interrupts(struct object* obj, bool enable) {
+    ASSERT_NOT_NULL(obj);
+    ASSERT_NOT_NULL(obj->object_data);
+    struct e1000_objectdata* object_data = (struct e1000_objectdata*)obj->object_data;
+    if (!enable) {
+        e1000_write(object_data, E1000_IMC, E1000_ICR_RX);
+        return false;
+    }
+    e1000_write(object_data, E1000_IMS, E1000_ICR_RX);
+    __atomic_thread_fence(__ATOMIC_SEQ_CST);
+    bool tx_done = (object_data->tx_clean != object_data->tx_hw_tail) &&
+                   (0 != (object_data->tx_ring[object_data->tx_clean].status & E1000_TXD_STAT_DD));
+    bool tx_held = (object_data->tx_tail != object_data->tx_hw_tail);
+    return (0 != (object_data->rx_ring[object_data->rx_next].status & E1000_RXD_STAT_DD)) || tx_done || tx_held;
+}
+
+/*
+ * free the frames the device has sent. thread context only, from e1000_ethernet_write and e1000_poll: releasing a
+ * netbuf takes locks, and the two mustn't both be at the ring at once
+ */
+void e1000_tx_clean(struct e1000_objectdata* object_data) {
+    while ((object_data->tx_clean != object_data->tx_hw_tail) &&
+           (0 != (object_data->tx_ring[object_data->tx_clean].status & E1000_TXD_STAT_DD))) {
+        uint16_t slot = object_data->tx_clean;
+        if (0 != object_data->tx_buffers[slot]) {
+            netbuf_release(object_data->tx_buffers[slot]);
+            object_data->tx_buffers[slot] = 0;
+        }
+        object_data->tx_clean = (slot + 1) % E1000_TX_DESCRIPTORS;
+    }
+}
+
+/*
+ * tell the device about the descriptors posted since we last did. unless forced, that waits while the device
+ * still has work, until enough have built up to be worth it; the poll the next transmit interrupt schedules forces it
+ */
+void e1000_tx_kick(struct e1000_objectdata* object_data, bool force) {
+    uint16_t pending = (object_data->tx_tail - object_data->tx_hw_tail + E1000_TX_DESCRIPTORS) % E1000_TX_DESCRIPTORS;
+    if (0 == pending) {
+        return;
+    }
+    bool idle = (object_data->tx_clean == object_data->tx_hw_tail);
+    if (force || idle || (pending >= E1000_TX_BATCH)) {
+        // the descriptors are in memory before the device is told they are there
+        __atomic_thread_fence(__ATOMIC_RELEASE);
+        e1000_write(object_data, E1000_TDT, object_data->tx_tail);
+        object_data->tx_hw_tail = object_data->tx_tail;
+    }
+}
+
+void e1000_irq_handler_for_device(struct object* obj) {
+    ASSERT_NOT_NULL(obj);
+    ASSERT_NOT_NULL(obj->object_data);
+    struct e1000_objectdata* object_data = (struct e1000_objectdata*)obj->object_data;
+
+    // reading ICR clears it. nothing set means the interrupt is someone else's
+    uint32_t icr = e1000_read(object_data, E1000_ICR);
+    if (0 == icr) {
+        return;
+    }
+    object_data->interrupts++;
+    if (0 != (icr & E1000_ICR_LSC)) {
+        e1000_write(object_data, E1000_CTRL, e1000_read(object_data, E1000_CTRL) | E1000_CTRL_SLU);
+    }
+    // receiving, and cleaning up after sending, are left to netpoll, in thread context
+    if (0 != (icr & (E1000_ICR_RX | E1000_ICR_TXDW))) {
+        netpoll_interrupt(&(object_data->netpoll));
+    }
+}
+
 void e1000_irq_handler(stack_frame* frame) {
     ASSERT_NOT_NULL(frame);
+    objectmgr_find_objects_by_description(OBJECT_TYPE_NIC, E1000_DESCRIPTION, &e1000_irq_handler_for_device);
+}
+
+uint16_t e1000_read_eeprom(struct e1000_objectdata* object_data, uint8_t address) {
+    e1000_write(object_data, E1000_EERD, E1000_EERD_START | (address << E1000_EERD_ADDR_SHIFT));
+    uint32_t eerd = 0;
+    while (0 == ((eerd = e1000_read(object_data, E1000_EERD)) & E1000_EERD_DONE)) {
+    }
+    return eerd >> E1000_EERD_DATA_SHIFT;
+}
+
+void e1000_read_mac(struct e1000_objectdata* object_data) {
+    // the address the device loaded from the EEPROM at reset, or failing that the EEPROM itself
+    uint32_t rah = e1000_read(object_data, E1000_RAH);
+    if (0 != (rah & E1000_RAH_AV)) {
+        uint32_t ral = e1000_read(object_data, E1000_RAL);
+        for (uint8_t i = 0; i < 4; i++) {
+            object_data->mac[i] = (ral >> (i * 8)) & 0xFF;
+        }
+        object_data->mac[4] = rah & 0xFF;
+        object_data->mac[5] = (rah >> 8) & 0xFF;
+    } else {
+        for (uint8_t i = 0; i < 3; i++) {
+            uint16_t word = e1000_read_eeprom(object_data, i);
+            object_data->mac[i * 2] = word & 0xFF;
+            object_data->mac[(i * 2) + 1] = word >> 8;
+        }
+    }
+    kprintf("   MAC %#hX:%#hX:%#hX:%#hX:%#hX:%#hX\n", object_data->mac[0], object_data->mac[1], object_data->mac[2],
+            object_data->mac[3], object_data->mac[4], object_data->mac[5]);
+}
+
+void e1000_reset(struct e1000_objectdata* object_data) {
+    e1000_write(object_data, E1000_CTRL, e1000_read(object_data, E1000_CTRL) | E1000_CTRL_RST);
+    sleep_wait(1);
+    while (0 != (e1000_read(object_data, E1000_CTRL) & E1000_CTRL_RST)) {
+        sleep_wait(1);
+    }
+    // no interrupts until we are ready for them
+    e1000_write(object_data, E1000_IMC, 0xFFFFFFFF);
+    e1000_read(object_data, E1000_ICR);
+}
+
+void e1000_init_rx(struct e1000_objectdata* object_data) {
+    uint32_t size = E1000_RX_DESCRIPTORS * sizeof(struct e1000_rx_desc);
+    object_data->rx_ring = (struct e1000_rx_desc*)iobuffers_request_buffer(size);
+    ASSERT_NOT_NULL(object_data->rx_ring);
+    memzero((uint8_t*)object_data->rx_ring, size);
+    for (uint16_t i = 0; i < E1000_RX_DESCRIPTORS; i++) {
+        struct netbuf* nb = netbuf_new(0);
+        if (0 == nb) {
+            PANIC("Unable to allocate e1000 receive buffers");
+        }
+        e1000_rx_refill(object_data, i, nb);
+    }
+    object_data->rx_next = 0;
+    object_data->rx_discard = false;
+
+    uint64_t phys = iobuffers_phys_address(object_data->rx_ring);
+    e1000_write(object_data, E1000_RDBAL, phys & 0xFFFFFFFF);
+    e1000_write(object_data, E1000_RDBAH, phys >> 32);
+    e1000_write(object_data, E1000_RDLEN, size);
+    // the device owns every descriptor but one; a full ring would look empty
+    e1000_write(object_data, E1000_RDH, 0);
+    e1000_write(object_data, E1000_RDT, E1000_RX_DESCRIPTORS - 1);
+    // no receive delay of its own; ITR does the throttling
+    e1000_write(object_data, E1000_RDTR, 0);
+    e1000_write(object_data, E1000_RXCSUM, E1000_RXCSUM_TUOFL);
+    e1000_write(object_data, E1000_RCTL, E1000_RCTL_EN | E1000_RCTL_BAM | E1000_RCTL_BSIZE_2048 | E1000_RCTL_SECRC);
+}
+
+void e1000_init_tx(struct e1000_objectdata* object_data) {
+    uint32_t size = E1000_TX_DESCRIPTORS * sizeof(struct e1000_tx_desc);
+    object_data->tx_ring = (struct e1000_tx_desc*)iobuffers_request_buffer(size);
+    ASSERT_NOT_NULL(object_data->tx_ring);
+    memzero((uint8_t*)object_data->tx_ring, size);
+    object_data->tx_tail = 0;
+    object_data->tx_clean = 0;
+    object_data->tx_hw_tail = 0;
+    object_data->tx_context_css = 0;
+    object_data->tx_context_cso = 0;
+
+    uint64_t phys = iobuffers_phys_address(object_data->tx_ring);
+    e1000_write(object_data, E1000_TDBAL, phys & 0xFFFFFFFF);
+    e1000_write(object_data, E1000_TDBAH, phys >> 32);
+    e1000_write(object_data, E1000_TDLEN, size);
+    e1000_write(object_data, E1000_TDH, 0);
+    e1000_write(object_data, E1000_TDT, 0);
+    e1000_write(object_data, E1000_TCTL,
+                E1000_TCTL_EN | E1000_TCTL_PSP | (0x0F << E1000_TCTL_CT_SHIFT) | (0x40 << E1000_TCTL_COLD_SHIFT));
+    e1000_write(object_data, E1000_TIPG, E1000_TIPG_DEFAULT);
 }
 
 /*
@@ -29,9 +284,60 @@ void e1000_irq_handler(stack_frame* frame) {
  */
 uint8_t e1000_init(struct object* obj) {
     ASSERT_NOT_NULL(obj);
-    kprintf("Init %s at IRQ %llu Vendor %#hX Device %#hX (%s)\n", obj->description, obj->pci->irq, obj->pci->vendor_id,
-            obj->pci->device_id, obj->name);
+    ASSERT_NOT_NULL(obj->object_data);
+    struct e1000_objectdata* object_data = (struct e1000_objectdata*)obj->object_data;
+    // BAR0 is 32 bit memory
+    object_data->base = (uint64_t)CONV_PHYS_ADDR(pci_get_bar_base(obj->pci->bars[0]));
+    kprintf("Init %s at IRQ %llu Vendor %#hX Device %#hX Base %#llX (%s)\n", obj->description, obj->pci->irq,
+            obj->pci->vendor_id, obj->pci->device_id, object_data->base, obj->name);
+    pci_header_enable_bus_master(obj->pci->bus, obj->pci->device, obj->pci->function);
+
+    e1000_reset(object_data);
+    e1000_write(object_data, E1000_CTRL,
+                (e1000_read(object_data, E1000_CTRL) | E1000_CTRL_SLU | E1000_CTRL_ASDE) & ~E1000_CTRL_PHY_RST);
+    e1000_read_mac(object_data);
+    // no multicast
+    for (uint16_t i = 0; i < 128; i++) {
+        e1000_write(object_data, E1000_MTA + (i * 4), 0);
+    }
+    e1000_init_rx(object_data);
+    e1000_init_tx(object_data);
+
+    /*
+     * interrupts, no more than E1000_INTERRUPTS_PER_SECOND
+     */
+    e1000_write(object_data, E1000_ITR, E1000_ITR_INTERVAL);
+    netpoll_register(&(object_data->netpoll), obj);
     interrupt_router_register_interrupt_handler(obj->pci->irq, &e1000_irq_handler);
+    e1000_write(object_data, E1000_IMS, E1000_ICR_TXDW | E1000_ICR_LSC | E1000_ICR_RX);
+
+    bool up = (0 != (e1000_read(object_data, E1000_STATUS) & E1000_STATUS_LU));
+    kprintf("   link %s\n", up ? "UP" : "DOWN");
+    return 1;
+}
+
+/*
+ * perform device instance specific uninit here
+ */
+uint8_t e1000_uninit(struct object* obj) {
+    ASSERT_NOT_NULL(obj);
+    ASSERT_NOT_NULL(obj->object_data);
+    struct e1000_objectdata* object_data = (struct e1000_objectdata*)obj->object_data;
+    kprintf("Uninit %s (%s)\n", obj->description, obj->name);
+    e1000_write(object_data, E1000_IMC, 0xFFFFFFFF);
+    netpoll_unregister(&(object_data->netpoll));
+    e1000_write(object_data, E1000_RCTL, 0);
+    e1000_write(object_data, E1000_TCTL, 0);
+    for (uint16_t i = 0; i < E1000_RX_DESCRIPTORS; i++) {
+        netbuf_release(object_data->rx_buffers[i]);
+    }
+    for (uint16_t i = 0; i < E1000_TX_DESCRIPTORS; i++) {
+        netbuf_release(object_data->tx_buffers[i]);
+    }
+    iobuffers_release_buffer(object_data->rx_ring);
+    iobuffers_release_buffer(object_data->tx_ring);
+    kfree(obj->api);
+    kfree(object_data);
     return 1;
 }
 
@@ -39,13 +345,112 @@ void e1000_ethernet_read(struct object* obj, uint8_t* data, uint16_t size) {
     ASSERT_NOT_NULL(obj);
     ASSERT_NOT_NULL(data);
 
-    PANIC("Ethernet read not implemented yet");
+    PANIC("Ethernet read not implemented; frames go to the receiver");
+}
+
+/*
+ * post a frame, a descriptor per segment, so a chain goes out without being copied. a frame with a checksum still
+ * to be done gets it done by the device, with a context descriptor first if the last frame's was different
+ */
+void e1000_ethernet_write(struct object* obj, struct netbuf* frame) {
+    ASSERT_NOT_NULL(obj);
+    ASSERT_NOT_NULL(obj->object_data);
+    ASSERT_NOT_NULL(frame);
+    struct e1000_objectdata* object_data = (struct e1000_objectdata*)obj->object_data;
+
+    e1000_tx_clean(object_data);
+
+    bool csum = (NETBUF_CSUM_PARTIAL == frame->csum);
+    uint8_t css = 0;
+    uint8_t cso = 0;
+    uint16_t needed = 0;
+    if (csum) {
+        ASSERT((frame->csum_start - netbuf_headroom(frame) + frame->csum_offset) < 0xFF);
+        css = frame->csum_start - netbuf_headroom(frame);
+        cso = css + frame->csum_offset;
+        if ((css != object_data->tx_context_css) || (cso != object_data->tx_context_cso)) {
+            needed++;
+        }
+    }
+    for (struct netbuf* segment = frame; 0 != segment; segment = segment->chain) {
+        if (segment->len > 0) {
+            needed++;
+        }
+    }
+    uint16_t used = (object_data->tx_tail - object_data->tx_clean + E1000_TX_DESCRIPTORS) % E1000_TX_DESCRIPTORS;
+    if ((needed + used) >= E1000_TX_DESCRIPTORS) {
+        object_data->tx_dropped++;
+        netbuf_release(frame);
+        return;
+    }
+
+    // the tail moves once the whole frame is in place, since the interrupt handler may pass it to the device
+    uint16_t tail = object_data->tx_tail;
+    if (csum && ((css != object_data->tx_context_css) || (cso != object_data->tx_context_cso))) {
+        uint16_t slot = tail;
+        struct e1000_tx_context_desc* context = (struct e1000_tx_context_desc*)&(object_data->tx_ring[slot]);
+        memzero((uint8_t*)context, sizeof(struct e1000_tx_context_desc));
+        context->tucss = css;
+        context->tucso = cso;
+        context->tucse = 0;
+        context->cmd_length = E1000_TXD_DTYP_C | E1000_TXD_CMD_DEXT | E1000_TXD_CMD_RS;
+        object_data->tx_buffers[slot] = 0;
+        object_data->tx_context_css = css;
+        object_data->tx_context_cso = cso;
+        tail = (slot + 1) % E1000_TX_DESCRIPTORS;
+    }
+
+    uint16_t last = tail;
+    for (struct netbuf* segment = frame; 0 != segment; segment = segment->chain) {
+        if (0 == segment->len) {
+            continue;
+        }
+        uint16_t slot = tail;
+        struct e1000_tx_desc* desc = &(object_data->tx_ring[slot]);
+        desc->addr = iobuffers_phys_address(segment->data);
+        desc->cmd_length = segment->len | E1000_TXD_DTYP_D | E1000_TXD_CMD_DEXT | E1000_TXD_CMD_IFCS | E1000_TXD_CMD_RS;
+        desc->status = 0;
+        desc->popts = csum ? E1000_TXD_POPTS_TXSM : 0;
+        desc->special = 0;
+        object_data->tx_buffers[slot] = 0;
+        last = slot;
+        tail = (slot + 1) % E1000_TX_DESCRIPTORS;
+    }
+    object_data->tx_ring[last].cmd_length |= E1000_TXD_CMD_EOP;
+    // the last descriptor holds the frame, and so the whole chain, until the device is done with it
+    object_data->tx_buffers[last] = frame;
+    __atomic_store_n(&(object_data->tx_tail), tail, __ATOMIC_RELEASE);
+    object_data->tx_packets++;
+
+    e1000_tx_kick(object_data, false);
 }
-void e1000_ethernet_write(struct object* obj, uint8_t* data, uint16_t size) {
+
+void e1000_set_receiver(struct object* obj, struct object* receiver, nic_receive_function receive) {
     ASSERT_NOT_NULL(obj);
-    ASSERT_NOT_NULL(data);
+    ASSERT_NOT_NULL(obj->object_data);
+    struct e1000_objectdata* object_data = (struct e1000_objectdata*)obj->object_data;
+    object_data->receiver = receiver;
+    object_data->receive = receive;
+}
+
+void e1000_hw_address(struct object* obj, uint8_t* hw_address) {
+    ASSERT_NOT_NULL(obj);
+    ASSERT_NOT_NULL(obj->object_data);
+    ASSERT_NOT_NULL(hw_address);
+    struct e1000_objectdata* object_data = (struct e1000_objectdata*)obj->object_data;
+    memcpy(hw_address, object_data->mac, NIC_HW_ADDRESS_LEN);
+}
+
+void e1000_stats(struct object* obj, struct nic_stats* stats) {
+    ASSERT_NOT_NULL(obj);
+    ASSERT_NOT_NULL(obj->object_data);
+    struct e1000_objectdata* object_data = (struct e1000_objectdata*)obj->object_data;
+    netpoll_stats(&(object_data->netpoll), stats);
+}
 
-    PANIC("Ethernet write not implemented yet");
+uint8_t e1000_offload(struct object* obj) {
+    ASSERT_NOT_NULL(obj);
+    return NIC_OFFLOAD_TX_CSUM | NIC_OFFLOAD_RX_CSUM;
 }
 
 void e1000_search_cb(struct pci_device* dev) {
@@ -54,16 +459,30 @@ void e1000_search_cb(struct pci_device* dev) {
      */
     struct object* objectinstance = object_new_object();
     objectinstance->init = &e1000_init;
+    objectinstance->uninit = &e1000_uninit;
     objectinstance->pci = dev;
     objectinstance->objectype = OBJECT_TYPE_NIC;
-    objectmgr_set_object_description(objectinstance, "E1000 NIC");
+    objectmgr_set_object_description(objectinstance, E1000_DESCRIPTION);
     /*
      * the device api
      */
     struct objectinterface_nic* api = (struct objectinterface_nic*)kmalloc(sizeof(struct objectinterface_nic));
-    api->write = &e1000_ethernet_read;
-    api->read = &e1000_ethernet_write;
+    memzero((uint8_t*)api, sizeof(struct objectinterface_nic));
+    api->write = &e1000_ethernet_write;
+    api->read = &e1000_ethernet_read;
+    api->set_receiver = &e1000_set_receiver;
+    api->hw_address = &e1000_hw_address;
+    api->offload = &e1000_offload;
+    api->poll = &e1000_poll;
+    api->interrupts = &e1000_interrupts;
+    api->stats = &e1000_stats;
     objectinstance->api = api;
+    /*
+     * device data
+     */
+    struct e1000_objectdata* object_data = (struct e1000_objectdata*)kmalloc(sizeof(struct e1000_objectdata));
+    memzero((uint8_t*)object_data, sizeof(struct e1000_objectdata));
+    objectinstance->object_data = object_data;
     /*
      * register
      */
@@ -5,9 +5,181 @@
 // See the file "LICENSE" in the source distribution for details  *
 // ****************************************************************
 
+// Intel 8254x (e1000) family. register names as in the PCI/PCI-X Family of Gigabit Ethernet Controllers
+// Software Developer's Manual
+
 #ifndef _E1000_H
 #define _E1000_H
 
+#include <sys/netpoll/netpoll.h>
+#include <sys/obj/objectinterface/objectinterface_nic.h>
+#include <types.h>
+
+// registers, as offsets into BAR0
+#define E1000_CTRL 0x0000
+#define E1000_STATUS 0x0008
+#define E1000_EERD 0x0014
+#define E1000_ICR 0x00C0
+#define E1000_ITR 0x00C4
+#define E1000_IMS 0x00D0
+#define E1000_IMC 0x00D8
+#define E1000_RCTL 0x0100
+#define E1000_TCTL 0x0400
+#define E1000_TIPG 0x0410
+#define E1000_RDBAL 0x2800
+#define E1000_RDBAH 0x2804
+#define E1000_RDLEN 0x2808
+#define E1000_RDH 0x2810
+#define E1000_RDT 0x2818
+#define E1000_RDTR 0x2820
+#define E1000_TDBAL 0x3800
+#define E1000_TDBAH 0x3804
+#define E1000_TDLEN 0x3808
+#define E1000_TDH 0x3810
+#define E1000_TDT 0x3818
+#define E1000_RXCSUM 0x5000
+#define E1000_MTA 0x5200  // 128 dwords
+#define E1000_RAL 0x5400
+#define E1000_RAH 0x5404
+
+// CTRL
+#define E1000_CTRL_ASDE (1 << 5)
+#define E1000_CTRL_SLU (1 << 6)
+#define E1000_CTRL_RST (1 << 26)
+#define E1000_CTRL_PHY_RST 0x80000000
+
+// STATUS
+#define E1000_STATUS_LU (1 << 1)
+
+// EERD
+#define E1000_EERD_START (1 << 0)
+#define E1000_EERD_DONE (1 << 4)
+#define E1000_EERD_ADDR_SHIFT 8
+#define E1000_EERD_DATA_SHIFT 16
+
+// interrupt causes, for ICR, IMS and IMC
+#define E1000_ICR_TXDW (1 << 0)    // a descriptor was written back
+#define E1000_ICR_TXQE (1 << 1)    // the transmit queue is empty
+#define E1000_ICR_LSC (1 << 2)     // link status change
+#define E1000_ICR_RXDMT0 (1 << 4)  // receive descriptors are running low
+#define E1000_ICR_RXO (1 << 6)     // receive overrun
+#define E1000_ICR_RXT0 (1 << 7)    // receive timer
+
+// the causes that mean there is something to receive; netpoll turns these off and on
+#define E1000_ICR_RX (E1000_ICR_RXDMT0 | E1000_ICR_RXO | E1000_ICR_RXT0)
+
+// RCTL
+#define E1000_RCTL_EN (1 << 1)
+#define E1000_RCTL_BAM (1 << 15)  // accept broadcast
+#define E1000_RCTL_BSIZE_2048 (0 << 16)
+#define E1000_RCTL_SECRC (1 << 26)  // strip the CRC
+
+// TCTL
+#define E1000_TCTL_EN (1 << 1)
+#define E1000_TCTL_PSP (1 << 3)  // pad short packets
+#define E1000_TCTL_CT_SHIFT 4
+#define E1000_TCTL_COLD_SHIFT 12
+
+// TIPG, the recommended values for copper
+#define E1000_TIPG_DEFAULT (10 | (8 << 10) | (6 << 20))
+
+// RXCSUM
+#define E1000_RXCSUM_TUOFL (1 << 9)  // check TCP and UDP checksums
+
+// RAH
+#define E1000_RAH_AV 0x80000000
+
+/*
+ * ITR is the least time between interrupts, in 256ns units.  8000 a second is a few frames an interrupt at gigabit
+ * rates, and at most 122us of extra latency
+ */
+#define E1000_INTERRUPTS_PER_SECOND 8000
+#define E1000_ITR_INTERVAL (1000000000 / (E1000_INTERRUPTS_PER_SECOND * 256))
+
+// receive descriptor
+#define E1000_RXD_STAT_DD (1 << 0)     // done
+#define E1000_RXD_STAT_EOP (1 << 1)    // end of packet
+#define E1000_RXD_STAT_IXSM (1 << 2)   // ignore the checksum bits
+#define E1000_RXD_STAT_TCPCS (1 << 5)  // TCP or UDP checksum checked
+#define E1000_RXD_ERR_TCPE (1 << 5)    // and it was bad
+
+struct e1000_rx_desc {
+    uint64_t addr;
+    uint16_t length;
+    uint16_t csum;
+    uint8_t status;
+    uint8_t errors;
+    uint16_t special;
+} __attribute__((packed));
+
+// transmit descriptors. we use the extended ones, a context descriptor for the checksum offload and data
+// descriptors for the frames
+#define E1000_TXD_DTYP_C (0x0 << 20)  // context
+#define E1000_TXD_DTYP_D (0x1 << 20)  // data
+#define E1000_TXD_CMD_EOP (1 << 24)   // end of packet
+#define E1000_TXD_CMD_IFCS (1 << 25)  // insert the CRC
+#define E1000_TXD_CMD_RS (1 << 27)    // report status
+#define E1000_TXD_CMD_DEXT (1 << 29)  // extended descriptor
+#define E1000_TXD_STAT_DD (1 << 0)
+#define E1000_TXD_POPTS_TXSM (1 << 1)  // insert the TCP or UDP checksum, per the context
+
+struct e1000_tx_desc {
+    uint64_t addr;
+    uint32_t cmd_length;  // length, DTYP and command
+    uint8_t status;
+    uint8_t popts;
+    uint16_t special;
+} __attribute__((packed));
+
+struct e1000_tx_context_desc {
+    uint8_t ipcss;
+    uint8_t ipcso;
+    uint16_t ipcse;
+    uint8_t tucss;  // the TCP or UDP checksum covers from here
+    uint8_t tucso;  // is stored here
+    uint16_t tucse;  // and ends here; 0 is the end of the packet
+    uint32_t cmd_length;
+    uint8_t status;
+    uint8_t hdr_len;
+    uint16_t mss;
+} __attribute__((packed));
+
+// both rings fill an IOBUFFERS_CLASS_PAGE buffer
+#define E1000_RX_DESCRIPTORS 256
+#define E1000_TX_DESCRIPTORS 256
+
+/*
+ * frames are posted to the transmit ring straight away, but the tail is only written (which traps to the
+ * hypervisor under emulation) when the device is idle, or this many descriptors are waiting. otherwise the next
+ * transmit interrupt writes it, for all of them at once
+ */
+#define E1000_TX_BATCH 32
+
+struct e1000_objectdata {
+    uint64_t base;  // BAR0, through the direct map
+    uint8_t mac[6];
+    struct e1000_rx_desc* rx_ring;
+    struct e1000_tx_desc* tx_ring;
+    // the netbuf in each receive slot; in each transmit slot, the packet it ends
+    struct netbuf* rx_buffers[E1000_RX_DESCRIPTORS];
+    struct netbuf* tx_buffers[E1000_TX_DESCRIPTORS];
+    uint16_t rx_next;      // the next descriptor the device will fill
+    bool rx_discard;       // dropping the rest of a frame too big for one descriptor
+    uint16_t tx_tail;      // the next free descriptor
+    uint16_t tx_clean;     // the oldest descriptor the device has yet to finish
+    uint16_t tx_hw_tail;   // the tail as the device knows it
+    uint8_t tx_context_css;  // the checksum context the device has; 0 is none
+    uint8_t tx_context_cso;
+    struct object* receiver;
+    nic_receive_function receive;
+    struct netpoll netpoll;
+    uint64_t rx_packets;
+    uint64_t rx_dropped;
+    uint64_t tx_packets;
+    uint64_t tx_dropped;
+    uint64_t interrupts;
+};
+
 void e1000_objectmgr_register_objects();
 
-#endif
\ No newline at end of file
+#endif
@@ -164,9 +164,9 @@ void ne2000pci_ethernet_read(struct object* obj, uint8_t* data, uint16_t size) {
 
     PANIC("Ethernet read not implemented yet");
 }
-void ne2000pci_ethernet_write(struct object* obj, uint8_t* data, uint16_t size) {
+void ne2000pci_ethernet_write(struct object* obj, struct netbuf* frame) {
     ASSERT_NOT_NULL(obj);
-    ASSERT_NOT_NULL(data);
+    ASSERT_NOT_NULL(frame);
 
     PANIC("Ethernet write not implemented yet");
 }
@@ -184,8 +184,8 @@ void ne2000_pci_search_cb(struct pci_device* dev) {
      * the device api
      */
     struct objectinterface_nic* api = (struct objectinterface_nic*)kmalloc(sizeof(struct objectinterface_nic));
-    api->write = &ne2000pci_ethernet_read;
-    api->read = &ne2000pci_ethernet_write;
+    api->write = &ne2000pci_ethernet_write;
+    api->read = &ne2000pci_ethernet_read;
     objectinstance->api = api;
     /*
      * the object_data
@@ -4,6 +4,7 @@
 // See the file "LICENSE" in the source distribution for details  *
 // ****************************************************************
 
+#include <obj/x86-64/network/e1000/e1000.h>
 #include <obj/x86-64/network/network.h>
 #include <obj/x86-64/network/rtl8139/rtl8139.h>
 
@@ -11,6 +12,6 @@ void network_objectmgr_register_objects() {
     rtl8139_objectmgr_register_objects();
     // ne2000pci_objectmgr_register_objects();
     //   ne2000isa_objectmgr_register_objects();
-    //  e1000_objectmgr_register_objects();
+    e1000_objectmgr_register_objects();
     //   vnic_objectmgr_register_objects();
 }
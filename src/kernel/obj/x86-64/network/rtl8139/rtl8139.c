@@ -18,6 +18,7 @@
 #include <sys/iobuffers/iobuffers.h>
 #include <sys/kmalloc/kmalloc.h>
 #include <sys/kprintf/kprintf.h>
+#include <sys/netbuf/netbuf.h>
 #include <sys/obj/object/object.h>
 #include <sys/obj/objectinterface/objectinterface_nic.h>
 #include <sys/obj/objectmgr/objectmgr.h>
@@ -100,8 +101,8 @@ void rtl8139_set_rx_buffer(struct object* obj, uint8_t* buffer) {
     ASSERT_NOT_NULL(obj);
     ASSERT_NOT_NULL(buffer);
 
-    // 32 bit address
-    uint32_t add = LOW_OF_QWORD((uint64_t)buffer);
+    // 32 bit physical address
+    uint32_t add = LOW_OF_QWORD(iobuffers_phys_address(buffer));
     rtl8139_write_dword(obj, RTL8139_REGISTER_RBSTART, add);
 }
 
@@ -197,11 +198,18 @@ void rtl8139_ethernet_read(struct object* obj, uint8_t* data, uint16_t size) {
     PANIC("Ethernet read not implemented yet");
 }
 
-void rtl8139_ethernet_write(struct object* obj, uint8_t* data, uint16_t size) {
+void rtl8139_ethernet_write(struct object* obj, struct netbuf* frame) {
     ASSERT_NOT_NULL(obj);
-    ASSERT_NOT_NULL(data);
+    ASSERT_NOT_NULL(frame);
     ASSERT_NOT_NULL(obj->object_data);
     struct rtl8139_objectdata* devicedata = (struct rtl8139_objectdata*)obj->object_data;
+    // the controller takes one buffer per frame
+    frame = netbuf_linearize(frame);
+    if (0 == frame) {
+        // no buffer to gather it into
+        return;
+    }
+    uint16_t size = frame->len;
     // i dunno, some magic
     ASSERT(size < 1792);
 
@@ -241,6 +249,7 @@ void rtl8139_ethernet_write(struct object* obj, uint8_t* data, uint16_t size) {
         sleep_wait(10);
         stat = rtl8139_read_word(obj, txstatus);
     }
+    netbuf_release(frame);
 }
 
 void rtl8139_search_cb(struct pci_device* dev) {
@@ -256,8 +265,8 @@ void rtl8139_search_cb(struct pci_device* dev) {
      * the device api
      */
     struct objectinterface_nic* api = (struct objectinterface_nic*)kmalloc(sizeof(struct objectinterface_nic));
-    api->write = &rtl8139_ethernet_read;
-    api->read = &rtl8139_ethernet_write;
+    api->write = &rtl8139_ethernet_write;
+    api->read = &rtl8139_ethernet_read;
     objectinstance->api = api;
     /*
      * the object_data
@@ -21,6 +21,8 @@
 #define PCI_BAR4_OFFSET 0x20
 #define PCI_BAR5_OFFSET 0x24
 
+#define PCI_COMMAND_BUS_MASTER 0x04
+
 typedef enum pci_bar_type { PCI_BAR_PORT, PCI_BAR_MMIO } pci_bar_type;
 
 uint32_t pci_config_address_build(uint8_t bus, uint8_t device, uint8_t function, uint8_t offset, uint8_t enabled);
@@ -41,6 +43,7 @@ uint8_t pci_header_read_type(uint8_t bus, uint8_t device, uint8_t function);
 uint16_t pci_header_read_vendor(uint8_t bus, uint8_t device, uint8_t function);
 
 void pci_header_set_irq(uint8_t bus, uint8_t device, uint8_t function, uint8_t irq);
+void pci_header_enable_bus_master(uint8_t bus, uint8_t device, uint8_t function);
 
 void pci_init();
 
@@ -132,6 +132,18 @@ void pci_header_set_irq(uint8_t bus, uint8_t device, uint8_t function, uint8_t i
     return;
 }
 
+/*
+ * let the device master the bus, so it can DMA
+ */
+void pci_header_enable_bus_master(uint8_t bus, uint8_t device, uint8_t function) {
+    // the command register is the low word of the dword at offset 0x04. the status bits in the high word are cleared
+    // by writing ones, so we write zeros there
+    asm_out_d(PCI_CONFIG_ADDRESS_PORT, pci_config_address_build(bus, device, function, 0x04, 1));
+    uint32_t command = asm_in_d(PCI_CONFIG_DATA_PORT) & 0xFFFF;
+    asm_out_d(PCI_CONFIG_ADDRESS_PORT, pci_config_address_build(bus, device, function, 0x04, 1));
+    asm_out_d(PCI_CONFIG_DATA_PORT, command | PCI_COMMAND_BUS_MASTER);
+}
+
 // https://wiki.osdev.org/PCI
 uint64_t pci_calcbar(struct pci_device* pci_dev) {
     ASSERT_NOT_NULL(pci_dev);
@@ -40,6 +40,11 @@ void pit_handle_irq(stack_frame* frame) {
     ASSERT_NOT_NULL(frame);
     //  kprintf("@");
     tickcount = tickcount + 1;
+
+    for (uint32_t i = 0; i < arraylist_count(pitEvents); i++) {
+        pit_event pitEvent = (pit_event)arraylist_get(pitEvents, i);
+        (*pitEvent)();
+    }
 }
 
 /*
@@ -9,7 +9,7 @@
 #include <obj/x86-64/serial/ns16550.h>
 #include <obj/x86-64/serial/serial.h>
 #include <sys/asm/io.h>
-#include <sys/collection/ringbuffer/ringbuffer.h>
+#include <sys/collection/spscring/spscring.h>
 #include <sys/debug/assert.h>
 #include <sys/interrupt_router/interrupt_router.h>
 #include <sys/kmalloc/kmalloc.h>
@@ -21,7 +21,10 @@
 #include <sys/x86-64/idt/irq.h>
 #include <types.h>
 
-#define SERIAL_RINGBUFFER_SIZE 255
+#define SERIAL_RING_SIZE 256
+
+// the 16550 FIFO is 16 bytes deep
+#define SERIAL_FIFO_SIZE 16
 
 #define SERIAL_DESCRIPTION "RS232"
 
@@ -31,7 +34,7 @@ void serial_writechar(struct object* obj, const int8_t c);
 struct serial_objectdata {
     uint8_t irq;
     uint64_t address;
-    struct ringbuffer* buffer;
+    struct spscring* buffer;  // filled by serial_irq_handler, drained by readers
 
 } __attribute__((packed));
 
@@ -90,7 +93,9 @@ uint8_t serial_readchar(struct object* obj) {
     ASSERT_NOT_NULL(obj);
     ASSERT_NOT_NULL(obj->object_data);
     struct serial_objectdata* object_data = (struct serial_objectdata*)obj->object_data;
-    return (uint8_t)(uint64_t)ringbuffer_consume(object_data->buffer);
+    uint8_t c = 0;
+    spscring_get(object_data->buffer, &c);
+    return c;
 }
 
 int serial_is_transmit_empty(struct object* obj) {
@@ -119,7 +124,7 @@ uint16_t serial_avail(struct object* obj) {
     ASSERT_NOT_NULL(obj);
     ASSERT_NOT_NULL(obj->object_data);
     struct serial_objectdata* object_data = (struct serial_objectdata*)obj->object_data;
-    return ringbuffer_avail(object_data->buffer);
+    return (uint16_t)spscring_count(object_data->buffer);
 }
 
 void serial_irq_handler_for_device(struct object* obj) {
@@ -129,13 +134,25 @@ void serial_irq_handler_for_device(struct object* obj) {
     uint64_t address = object_data->address;
     struct rs232_16550* comport = (struct rs232_16550*)address;
 
+    /*
+     * drain the FIFO, then publish what we got in one go.  if the reader has
+     * fallen behind and the ring is full, the excess is dropped
+     */
+    uint8_t data[SERIAL_FIFO_SIZE];
+    uint32_t count = 0;
     while (serial_is_read_ready(obj)) {
-        uint8_t data = asm_in_b((uint64_t) & (comport->data));
-        ringbuffer_add(object_data->buffer, (void*)(uint64_t)data);
+        data[count++] = asm_in_b((uint64_t) & (comport->data));
+        if (count == SERIAL_FIFO_SIZE) {
+            spscring_put_bulk(object_data->buffer, data, count);
+            count = 0;
+        }
 
         // echo the data
         //  serial_writechar(obj, data);
     }
+    if (count > 0) {
+        spscring_put_bulk(object_data->buffer, data, count);
+    }
 }
 
 void serial_irq_handler(stack_frame* frame) {
@@ -150,7 +167,7 @@ void serial_register_device(uint8_t irq, uint64_t base) {
     struct serial_objectdata* object_data = kmalloc(sizeof(struct serial_objectdata));
     object_data->irq = irq;
     object_data->address = base;
-    object_data->buffer = ringbuffer_new(SERIAL_RINGBUFFER_SIZE);
+    object_data->buffer = spscring_new(SERIAL_RING_SIZE);
     /*
      * the device instance
      */
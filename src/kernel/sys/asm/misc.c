@@ -21,6 +21,26 @@ void asm_cli() {
     return;
 }
 
+void asm_cpuid(uint32_t function, uint32_t subfunction, uint32_t* eax, uint32_t* ebx, uint32_t* ecx, uint32_t* edx) {
+    asm volatile("cpuid" : "=a"(*eax), "=b"(*ebx), "=c"(*ecx), "=d"(*edx) : "a"(function), "c"(subfunction));
+
+    return;
+}
+
+uint64_t asm_cr0_read() {
+    uint64_t cr0;
+
+    asm volatile("mov %%cr0, %0" : "=r"(cr0));
+
+    return cr0;
+}
+
+void asm_cr0_write(uint64_t cr0) {
+    asm volatile("mov %0, %%cr0" : : "r"(cr0) : "memory");
+
+    return;
+}
+
 void* asm_cr2_read() {
     void* ret;
 
@@ -47,6 +67,43 @@ void asm_cr3_reload() {
     return;
 }
 
+void asm_cr3_write(pttentry cr3) {
+    asm volatile("mov %0, %%cr3" : : "r"(cr3) : "memory");
+
+    return;
+}
+
+uint64_t asm_cr4_read() {
+    uint64_t cr4;
+
+    asm volatile("mov %%cr4, %0" : "=r"(cr4));
+
+    return cr4;
+}
+
+void asm_cr4_write(uint64_t cr4) {
+    asm volatile("mov %0, %%cr4" : : "r"(cr4) : "memory");
+
+    return;
+}
+
+void asm_invlpg(void* address) {
+    asm volatile("invlpg (%0)" : : "r"(address) : "memory");
+
+    return;
+}
+
+void asm_invpcid(uint64_t type, uint16_t pcid, void* address) {
+    struct {
+        uint64_t pcid;
+        void* address;
+    } __attribute__((packed)) descriptor = {pcid, address};
+
+    asm volatile("invpcid %0, %1" : : "m"(descriptor), "r"(type) : "memory");
+
+    return;
+}
+
 void asm_sti() {
     asm volatile("sti");
 
@@ -5,10 +5,18 @@
 #include <sys/x86-64/mm/mm.h>
 
 void asm_cli();
+void asm_cpuid(uint32_t function, uint32_t subfunction, uint32_t* eax, uint32_t* ebx, uint32_t* ecx, uint32_t* edx);
 void asm_hlt();
 void asm_sti();
+uint64_t asm_cr0_read();
+void asm_cr0_write(uint64_t cr0);
 void* asm_cr2_read();
 pttentry asm_cr3_read();
 void asm_cr3_reload();
+void asm_cr3_write(pttentry cr3);
+uint64_t asm_cr4_read();
+void asm_cr4_write(uint64_t cr4);
+void asm_invlpg(void* address);
+void asm_invpcid(uint64_t type, uint16_t pcid, void* address);
 
 #endif
\ No newline at end of file
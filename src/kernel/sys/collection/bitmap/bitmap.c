@@ -1,4 +1,3 @@
-
 //*****************************************************************
 // This file is part of CosmOS                                    *
 // Copyright (C) 2020-2021 Tom Everett                            *
@@ -10,60 +9,201 @@
 #include <sys/debug/assert.h>
 #include <sys/kmalloc/kmalloc.h>
 
+/*
+ * number of trailing zeros in a non-zero word (bsf/tzcnt)
+ */
+#define BITMAP_TZCNT(w) ((uint64_t)__builtin_ctzll(w))
+
 struct bitmap* bitmap_new(uint32_t size) {
     struct bitmap* ret = (struct bitmap*)kmalloc(sizeof(struct bitmap));
-    ret->byte_size = (size / 8);
-    if (ret->byte_size % 8 != 0) {
-        ret->byte_size = ret->byte_size + 1;
+    uint64_t words = (size + BITMAP_WORD_BITS - 1) / BITMAP_WORD_BITS;
+    if (0 == words) {
+        words = 1;
     }
-    //    kprintf("byte size: %llu\n", ret->byte_size);
-    ret->bits = kmalloc(ret->byte_size * (sizeof(uint8_t)));
-    for (uint16_t i = 0; i < ret->byte_size; i++) {
+    ret->byte_size = words * sizeof(uint64_t);
+    ret->bits = (uint64_t*)kmalloc(ret->byte_size);
+    for (uint64_t i = 0; i < words; i++) {
         ret->bits[i] = 0;
     }
     ret->size = size;
     return ret;
 }
+
 void bitmap_delete(struct bitmap* bm) {
     ASSERT_NOT_NULL(bm);
     kfree(bm->bits);
     kfree(bm);
 }
 
-void bit_index(uint64_t idx, uint64_t* byte, uint64_t* bit) {
-    *byte = idx / 8;
-    *bit = idx - (*byte * 8);
+uint64_t bitmap_word_count(struct bitmap* bm) {
+    return (bm->size + BITMAP_WORD_BITS - 1) / BITMAP_WORD_BITS;
+}
+
+/*
+ * a mask of the bits in word w that are past the end of the bitmap
+ */
+uint64_t bitmap_tail_mask(struct bitmap* bm, uint64_t w) {
+    uint64_t end = (w + 1) * BITMAP_WORD_BITS;
+    if (end <= bm->size) {
+        return 0;
+    }
+    return ~((1ULL << (bm->size % BITMAP_WORD_BITS)) - 1);
+}
+
+/*
+ * popcount without the popcnt instruction, which not every cpu we run on has
+ */
+uint64_t bitmap_popcount(uint64_t w) {
+    w = w - ((w >> 1) & 0x5555555555555555ULL);
+    w = (w & 0x3333333333333333ULL) + ((w >> 2) & 0x3333333333333333ULL);
+    w = (w + (w >> 4)) & 0x0F0F0F0F0F0F0F0FULL;
+    return (w * 0x0101010101010101ULL) >> 56;
 }
 
 void bitmap_set(struct bitmap* bm, uint32_t position, uint8_t value) {
     ASSERT_NOT_NULL(bm);
     ASSERT(position < bm->size);
 
-    uint64_t byte = 0;
-    uint64_t bit = 0;
-    bit_index(position, &byte, &bit);
-    uint8_t b = bm->bits[byte];
+    uint64_t bit = 1ULL << (position % BITMAP_WORD_BITS);
     if (value > 0) {
         // set
-        b = b | (1 << bit);
+        bm->bits[position / BITMAP_WORD_BITS] |= bit;
     } else {
         // clear
-        b = b & ~(1 << bit);
+        bm->bits[position / BITMAP_WORD_BITS] &= ~bit;
     }
-    bm->bits[byte] = b;
 }
 
 uint8_t bitmap_get(struct bitmap* bm, uint32_t position) {
     ASSERT_NOT_NULL(bm);
     ASSERT(position < bm->size);
-    uint64_t byte = 0;
-    uint64_t bit = 0;
-    bit_index(position, &byte, &bit);
-    uint8_t b = bm->bits[byte];
 
-    if (b & (1 << bit)) {
+    if (bm->bits[position / BITMAP_WORD_BITS] & (1ULL << (position % BITMAP_WORD_BITS))) {
         return 1;
     } else {
         return 0;
     }
-}
\ No newline at end of file
+}
+
+uint64_t bitmap_find_first_zero(struct bitmap* bm) {
+    return bitmap_find_next_zero(bm, 0);
+}
+
+/*
+ * first clear bit at or after start
+ */
+uint64_t bitmap_find_next_zero(struct bitmap* bm, uint64_t start) {
+    ASSERT_NOT_NULL(bm);
+    if (start >= bm->size) {
+        return BITMAP_NOT_FOUND;
+    }
+    uint64_t words = bitmap_word_count(bm);
+    uint64_t w = start / BITMAP_WORD_BITS;
+
+    // invert, so we're looking for set bits; ignore those before start and past the end
+    uint64_t word = ~bm->bits[w] & (~0ULL << (start % BITMAP_WORD_BITS));
+    while (1) {
+        word &= ~bitmap_tail_mask(bm, w);
+        if (0 != word) {
+            return (w * BITMAP_WORD_BITS) + BITMAP_TZCNT(word);
+        }
+        w++;
+        if (w == words) {
+            return BITMAP_NOT_FOUND;
+        }
+        word = ~bm->bits[w];
+    }
+}
+
+/*
+ * first set bit at or after start
+ */
+uint64_t bitmap_find_next_set(struct bitmap* bm, uint64_t start) {
+    ASSERT_NOT_NULL(bm);
+    if (start >= bm->size) {
+        return BITMAP_NOT_FOUND;
+    }
+    uint64_t words = bitmap_word_count(bm);
+    uint64_t w = start / BITMAP_WORD_BITS;
+
+    uint64_t word = bm->bits[w] & (~0ULL << (start % BITMAP_WORD_BITS));
+    while (1) {
+        if (0 != word) {
+            return (w * BITMAP_WORD_BITS) + BITMAP_TZCNT(word);
+        }
+        w++;
+        if (w == words) {
+            return BITMAP_NOT_FOUND;
+        }
+        word = bm->bits[w];
+    }
+}
+
+/*
+ * start of the first run of count clear bits.  hops from zero to set bit and
+ * back, so whole words of set or clear bits are skipped in one step
+ */
+uint64_t bitmap_find_zero_run(struct bitmap* bm, uint64_t count) {
+    return bitmap_find_next_zero_run(bm, 0, count);
+}
+
+/*
+ * start of the first run of count clear bits at or after start
+ */
+uint64_t bitmap_find_next_zero_run(struct bitmap* bm, uint64_t start, uint64_t count) {
+    ASSERT_NOT_NULL(bm);
+    ASSERT_NOT_NULL(count);
+
+    start = bitmap_find_next_zero(bm, start);
+    while ((BITMAP_NOT_FOUND != start) && ((start + count) <= bm->size)) {
+        uint64_t next_set = bitmap_find_next_set(bm, start);
+        if ((BITMAP_NOT_FOUND == next_set) || ((next_set - start) >= count)) {
+            return start;
+        }
+        start = bitmap_find_next_zero(bm, next_set);
+    }
+    return BITMAP_NOT_FOUND;
+}
+
+uint64_t bitmap_count_set(struct bitmap* bm) {
+    ASSERT_NOT_NULL(bm);
+    uint64_t ret = 0;
+    uint64_t words = bitmap_word_count(bm);
+    for (uint64_t w = 0; w < words; w++) {
+        ret += bitmap_popcount(bm->bits[w] & ~bitmap_tail_mask(bm, w));
+    }
+    return ret;
+}
+
+/*
+ * apply value to count bits from start, a word at a time where we can
+ */
+void bitmap_fill_range(struct bitmap* bm, uint64_t start, uint64_t count, uint8_t value) {
+    ASSERT_NOT_NULL(bm);
+    ASSERT((start + count) <= bm->size);
+
+    uint64_t end = start + count;
+    while (start < end) {
+        uint64_t w = start / BITMAP_WORD_BITS;
+        uint64_t first = start % BITMAP_WORD_BITS;
+        uint64_t n = BITMAP_WORD_BITS - first;
+        if (n > (end - start)) {
+            n = end - start;
+        }
+        uint64_t mask = (n == BITMAP_WORD_BITS) ? ~0ULL : (((1ULL << n) - 1) << first);
+        if (value > 0) {
+            bm->bits[w] |= mask;
+        } else {
+            bm->bits[w] &= ~mask;
+        }
+        start += n;
+    }
+}
+
+void bitmap_set_range(struct bitmap* bm, uint64_t start, uint64_t count) {
+    bitmap_fill_range(bm, start, count, 1);
+}
+
+void bitmap_clear_range(struct bitmap* bm, uint64_t start, uint64_t count) {
+    bitmap_fill_range(bm, start, count, 0);
+}
@@ -1,4 +1,3 @@
-
 //*****************************************************************
 // This file is part of CosmOS                                    *
 // Copyright (C) 2020-2021 Tom Everett                            *
@@ -11,8 +10,17 @@
 
 #include <types.h>
 
+#define BITMAP_WORD_BITS 64
+
+// returned by the find functions when there's no such bit
+#define BITMAP_NOT_FOUND 0xFFFFFFFFFFFFFFFF
+
+/*
+ * bits are kept in 64-bit words so that searches and range operations can
+ * look at 64 bits at a time
+ */
 struct bitmap {
-    uint8_t* bits;
+    uint64_t* bits;
     uint64_t size;       // bits
     uint32_t byte_size;  // number of bytes we used
 };
@@ -22,4 +30,20 @@ void bitmap_delete(struct bitmap* bm);
 void bitmap_set(struct bitmap* bm, uint32_t position, uint8_t value);
 uint8_t bitmap_get(struct bitmap* bm, uint32_t position);
 
-#endif
\ No newline at end of file
+/*
+ * searches
+ */
+uint64_t bitmap_find_first_zero(struct bitmap* bm);
+uint64_t bitmap_find_next_zero(struct bitmap* bm, uint64_t start);
+uint64_t bitmap_find_next_set(struct bitmap* bm, uint64_t start);
+uint64_t bitmap_find_zero_run(struct bitmap* bm, uint64_t count);
+uint64_t bitmap_find_next_zero_run(struct bitmap* bm, uint64_t start, uint64_t count);
+uint64_t bitmap_count_set(struct bitmap* bm);
+
+/*
+ * ranges
+ */
+void bitmap_set_range(struct bitmap* bm, uint64_t start, uint64_t count);
+void bitmap_clear_range(struct bitmap* bm, uint64_t start, uint64_t count);
+
+#endif
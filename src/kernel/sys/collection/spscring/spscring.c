@@ -0,0 +1,163 @@
+//*****************************************************************
+// This file is part of CosmOS                                    *
+// Copyright (C) 2021 Tom Everett                                 *
+// Released under the stated terms in the file LICENSE            *
+// See the file "LICENSE" in the source distribution for details  *
+// ****************************************************************
+
+#include <sys/collection/spscring/spscring.h>
+#include <sys/debug/assert.h>
+#include <sys/kmalloc/kmalloc.h>
+#include <sys/string/mem.h>
+
+/*
+ * size is rounded up to the next power of two
+ */
+struct spscring* spscring_new(uint32_t size) {
+    ASSERT(size > 0);
+    ASSERT(size <= 0x80000000);
+
+    uint32_t capacity = 1;
+    while (capacity < size) {
+        capacity = capacity << 1;
+    }
+
+    struct spscring* ret = (struct spscring*)kmalloc(sizeof(struct spscring));
+    ret->head = 0;
+    ret->tail = 0;
+    ret->size = capacity;
+    ret->mask = capacity - 1;
+    ret->data = kmalloc(capacity);
+    return ret;
+}
+
+void spscring_delete(struct spscring* ring) {
+    ASSERT_NOT_NULL(ring);
+    kfree(ring->data);
+    kfree(ring);
+}
+
+uint32_t spscring_size(struct spscring* ring) {
+    ASSERT_NOT_NULL(ring);
+    return ring->size;
+}
+
+/*
+ * bytes waiting to be read.  exact for the consumer, a lower bound for anyone else
+ */
+uint32_t spscring_count(struct spscring* ring) {
+    ASSERT_NOT_NULL(ring);
+    uint32_t head = __atomic_load_n(&ring->head, __ATOMIC_ACQUIRE);
+    uint32_t tail = __atomic_load_n(&ring->tail, __ATOMIC_ACQUIRE);
+    return head - tail;
+}
+
+/*
+ * bytes that can be written.  exact for the producer, a lower bound for anyone else
+ */
+uint32_t spscring_space(struct spscring* ring) {
+    ASSERT_NOT_NULL(ring);
+    return ring->size - spscring_count(ring);
+}
+
+bool spscring_put(struct spscring* ring, uint8_t byte) {
+    return (1 == spscring_put_bulk(ring, &byte, 1));
+}
+
+/*
+ * copy up to len bytes in; returns how many fit
+ */
+uint32_t spscring_put_bulk(struct spscring* ring, const uint8_t* data, uint32_t len) {
+    ASSERT_NOT_NULL(ring);
+    ASSERT_NOT_NULL(data);
+
+    // only we write head, so a relaxed load is fine; tail needs acquire so we don't overwrite unread bytes
+    uint32_t head = __atomic_load_n(&ring->head, __ATOMIC_RELAXED);
+    uint32_t tail = __atomic_load_n(&ring->tail, __ATOMIC_ACQUIRE);
+    uint32_t space = ring->size - (head - tail);
+    if (len > space) {
+        len = space;
+    }
+    if (0 == len) {
+        return 0;
+    }
+
+    // at most two copies: up to the end of the array, then from the start
+    uint32_t offset = head & ring->mask;
+    uint32_t first = ring->size - offset;
+    if (first > len) {
+        first = len;
+    }
+    memcpy(&(ring->data[offset]), data, first);
+    if (len > first) {
+        memcpy(ring->data, &(data[first]), len - first);
+    }
+
+    // publish the bytes before the new head
+    __atomic_store_n(&ring->head, head + len, __ATOMIC_RELEASE);
+    return len;
+}
+
+bool spscring_get(struct spscring* ring, uint8_t* byte) {
+    return (1 == spscring_get_bulk(ring, byte, 1));
+}
+
+/*
+ * copy up to len bytes out; returns how many there were
+ */
+uint32_t spscring_get_bulk(struct spscring* ring, uint8_t* data, uint32_t len) {
+    len = spscring_peek_bulk(ring, 0, data, len);
+    spscring_discard(ring, len);
+    return len;
+}
+
+/*
+ * copy up to len bytes, starting offset bytes in, without consuming them; returns how many there were
+ */
+uint32_t spscring_peek_bulk(struct spscring* ring, uint32_t offset, uint8_t* data, uint32_t len) {
+    ASSERT_NOT_NULL(ring);
+    ASSERT_NOT_NULL(data);
+
+    // only we write tail; head needs acquire so we see the bytes it covers
+    uint32_t tail = __atomic_load_n(&ring->tail, __ATOMIC_RELAXED);
+    uint32_t head = __atomic_load_n(&ring->head, __ATOMIC_ACQUIRE);
+    uint32_t count = head - tail;
+    if (offset >= count) {
+        return 0;
+    }
+    if (len > (count - offset)) {
+        len = count - offset;
+    }
+    if (0 == len) {
+        return 0;
+    }
+
+    uint32_t start = (tail + offset) & ring->mask;
+    uint32_t first = ring->size - start;
+    if (first > len) {
+        first = len;
+    }
+    memcpy(data, &(ring->data[start]), first);
+    if (len > first) {
+        memcpy(&(data[first]), ring->data, len - first);
+    }
+    return len;
+}
+
+/*
+ * drop up to len bytes; returns how many there were
+ */
+uint32_t spscring_discard(struct spscring* ring, uint32_t len) {
+    ASSERT_NOT_NULL(ring);
+
+    uint32_t tail = __atomic_load_n(&ring->tail, __ATOMIC_RELAXED);
+    uint32_t head = __atomic_load_n(&ring->head, __ATOMIC_ACQUIRE);
+    uint32_t count = head - tail;
+    if (len > count) {
+        len = count;
+    }
+
+    // hand the space back only once we're done reading it
+    __atomic_store_n(&ring->tail, tail + len, __ATOMIC_RELEASE);
+    return len;
+}
@@ -0,0 +1,51 @@
+//*****************************************************************
+// This file is part of CosmOS                                    *
+// Copyright (C) 2021 Tom Everett                                 *
+// Released under the stated terms in the file LICENSE            *
+// See the file "LICENSE" in the source distribution for details  *
+// ****************************************************************
+
+#ifndef _SPSCRING_H
+#define _SPSCRING_H
+
+#include <types.h>
+
+#define SPSCRING_CACHE_LINE 64
+
+/**
+ * a lock-free byte ring for exactly one producer and one consumer, such as
+ * an interrupt handler feeding a reader thread.  head is only written by the
+ * producer and tail only by the consumer; each sits on its own cache line.
+ * both count up forever and are masked into data, so size is a power of two.
+ */
+typedef struct spscring {
+    volatile uint32_t head;
+    uint8_t pad0[SPSCRING_CACHE_LINE - sizeof(uint32_t)];
+    volatile uint32_t tail;
+    uint8_t pad1[SPSCRING_CACHE_LINE - sizeof(uint32_t)];
+    uint32_t size;
+    uint32_t mask;
+    uint8_t* data;
+} spscring_t;
+
+struct spscring* spscring_new(uint32_t size);
+void spscring_delete(struct spscring* ring);
+uint32_t spscring_size(struct spscring* ring);
+uint32_t spscring_count(struct spscring* ring);
+uint32_t spscring_space(struct spscring* ring);
+
+/*
+ * producer side
+ */
+bool spscring_put(struct spscring* ring, uint8_t byte);
+uint32_t spscring_put_bulk(struct spscring* ring, const uint8_t* data, uint32_t len);
+
+/*
+ * consumer side
+ */
+bool spscring_get(struct spscring* ring, uint8_t* byte);
+uint32_t spscring_get_bulk(struct spscring* ring, uint8_t* data, uint32_t len);
+uint32_t spscring_peek_bulk(struct spscring* ring, uint32_t offset, uint8_t* data, uint32_t len);
+uint32_t spscring_discard(struct spscring* ring, uint32_t len);
+
+#endif
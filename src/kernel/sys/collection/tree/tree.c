@@ -122,7 +122,10 @@ uint64_t tree_find(struct tree* t, tree_comparator comparator, void* value) {
         }
     }
     if (0 != t->left) {
-        return tree_find(t->left, comparator, value);
+        uint64_t ret = tree_find(t->left, comparator, value);
+        if (0 != ret) {
+            return ret;
+        }
     }
     if (0 != t->right) {
         return tree_find(t->right, comparator, value);
@@ -0,0 +1,79 @@
+//*****************************************************************
+// This file is part of CosmOS                                    *
+// Copyright (C) 2020-2021 Tom Everett                            *
+// Released under the stated terms in the file LICENSE            *
+// See the file "LICENSE" in the source distribution for details  *
+// ****************************************************************
+
+#include <sys/compress/lz4.h>
+#include <sys/debug/assert.h>
+#include <sys/string/mem.h>
+
+/*
+ * a length nibble of 15 goes on in the bytes after, each adding up to 255.  false if src runs out
+ */
+bool lz4_length(const uint8_t* src, uint32_t src_size, uint32_t* position, uint32_t* length) {
+    if (15 != *length) {
+        return true;
+    }
+    uint8_t b = 255;
+    while (255 == b) {
+        if (*position >= src_size) {
+            return false;
+        }
+        b = src[*position];
+        *position += 1;
+        *length += b;
+    }
+    return true;
+}
+
+uint32_t lz4_decompress(const uint8_t* src, uint32_t src_size, uint8_t* dst, uint32_t dst_size) {
+    ASSERT_NOT_NULL(src);
+    ASSERT_NOT_NULL(dst);
+    uint32_t in = 0;
+    uint32_t out = 0;
+    while (in < src_size) {
+        uint8_t token = src[in++];
+        /*
+         * literals
+         */
+        uint32_t literals = token >> 4;
+        if ((!lz4_length(src, src_size, &in, &literals)) || (literals > (src_size - in)) ||
+            (literals > (dst_size - out))) {
+            return 0;
+        }
+        if (literals > 0) {
+            memcpy(&(dst[out]), &(src[in]), literals);
+            in += literals;
+            out += literals;
+        }
+        if (in == src_size) {
+            // the last sequence is only literals
+            return out;
+        }
+        /*
+         * then a match, some way back in what's been decoded
+         */
+        if (2 > (src_size - in)) {
+            return 0;
+        }
+        uint32_t offset = src[in] | (src[in + 1] << 8);
+        in += 2;
+        uint32_t match = token & 0x0F;
+        if ((0 == offset) || (offset > out) || (!lz4_length(src, src_size, &in, &match))) {
+            return 0;
+        }
+        match += 4;
+        if (match > (dst_size - out)) {
+            return 0;
+        }
+        // byte by byte, as the match can overlap what it makes
+        for (uint32_t i = 0; i < match; i++) {
+            dst[out] = dst[out - offset];
+            out++;
+        }
+    }
+    // a block ends with literals
+    return 0;
+}
@@ -0,0 +1,22 @@
+//*****************************************************************
+// This file is part of CosmOS                                    *
+// Copyright (C) 2020-2021 Tom Everett                            *
+// Released under the stated terms in the file LICENSE            *
+// See the file "LICENSE" in the source distribution for details  *
+// ****************************************************************
+
+/*
+ * https://github.com/lz4/lz4/blob/dev/doc/lz4_Block_format.md
+ */
+#ifndef _LZ4_H
+#define _LZ4_H
+
+#include <types.h>
+
+/*
+ * decode an LZ4 block into dst.  returns the bytes decoded, or 0 if the block is corrupt or would decode to more
+ * than dst_size bytes.  a corrupt block never reads or writes outside src and dst
+ */
+uint32_t lz4_decompress(const uint8_t* src, uint32_t src_size, uint8_t* dst, uint32_t dst_size);
+
+#endif
@@ -272,7 +272,7 @@ struct elf_binary* elf_load_node(struct filesystem_node* fs_node) {
 
     elf_binary->len = fsfacade_size(fs_node);
     elf_binary->binary = kmalloc(elf_binary->len);
-    fsfacade_read(fs_node, elf_binary->binary, elf_binary->len);
+    fsfacade_read_all(fs_node, elf_binary->binary, elf_binary->len);
 
     ASSERT_NOT_NULL(elf_binary->len);
     ASSERT_NOT_NULL(elf_binary->binary);
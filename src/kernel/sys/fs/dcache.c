@@ -0,0 +1,198 @@
+//*****************************************************************
+// This file is part of CosmOS                                    *
+// Copyright (C) 2021 Tom Everett                                 *
+// Released under the stated terms in the file LICENSE            *
+// See the file "LICENSE" in the source distribution for details  *
+// ****************************************************************
+
+#include <sys/debug/assert.h>
+#include <sys/fs/dcache.h>
+#include <sys/kmalloc/kpool.h>
+#include <sys/obj/objectinterface/objectinterface_filesystem.h>
+#include <sys/string/mem.h>
+#include <sys/string/string.h>
+#include <types.h>
+
+struct dcache_entry {
+    struct dcache_entry* next;  // in the bucket
+    struct dcache_entry* lru_prev;
+    struct dcache_entry* lru_next;
+    uint64_t parent;
+    uint64_t id;  // 0 if the name isn't there
+    uint8_t name[FILESYSTEM_MAX_NAME];
+};
+
+kpool dcache_entry_pool = KPOOL_INIT("dcache_entry", struct dcache_entry, NULL);
+
+struct dcache_entry* dcache_buckets[DCACHE_BUCKETS];
+
+// most recently used first
+struct dcache_entry* dcache_lru_head = 0;
+struct dcache_entry* dcache_lru_tail = 0;
+
+struct dcache_stats dcache_counters;
+
+/*
+ * FNV-1a over the name, folded with the parent
+ */
+uint16_t dcache_hash(uint64_t parent, const uint8_t* name) {
+    uint64_t hash = 0xCBF29CE484222325;
+    for (uint16_t i = 0; 0 != name[i]; i++) {
+        hash = (hash ^ name[i]) * 0x100000001B3;
+    }
+    hash ^= parent * 0x9E3779B97F4A7C15;
+    return (hash ^ (hash >> 32)) % DCACHE_BUCKETS;
+}
+
+void dcache_lru_unlink(struct dcache_entry* e) {
+    if (0 != e->lru_prev) {
+        e->lru_prev->lru_next = e->lru_next;
+    } else {
+        dcache_lru_head = e->lru_next;
+    }
+    if (0 != e->lru_next) {
+        e->lru_next->lru_prev = e->lru_prev;
+    } else {
+        dcache_lru_tail = e->lru_prev;
+    }
+    e->lru_prev = 0;
+    e->lru_next = 0;
+}
+
+void dcache_lru_push(struct dcache_entry* e) {
+    e->lru_prev = 0;
+    e->lru_next = dcache_lru_head;
+    if (0 != dcache_lru_head) {
+        dcache_lru_head->lru_prev = e;
+    } else {
+        dcache_lru_tail = e;
+    }
+    dcache_lru_head = e;
+}
+
+struct dcache_entry** dcache_find_link(uint64_t parent, const uint8_t* name) {
+    struct dcache_entry** link = &(dcache_buckets[dcache_hash(parent, name)]);
+    while (0 != *link) {
+        if (((*link)->parent == parent) && (0 == strcmp((*link)->name, name))) {
+            return link;
+        }
+        link = &((*link)->next);
+    }
+    return link;
+}
+
+void dcache_unlink(struct dcache_entry** link) {
+    struct dcache_entry* e = *link;
+    *link = e->next;
+    dcache_lru_unlink(e);
+    kpool_free(&dcache_entry_pool, e);
+    dcache_counters.entries--;
+}
+
+/*
+ * names too long to store whole aren't cached
+ */
+bool dcache_cacheable(const uint8_t* name) {
+    return (strlen(name) < FILESYSTEM_MAX_NAME);
+}
+
+/*
+ * true if the cache knows the name. id is then the node's id, or 0 if the name isn't there
+ */
+bool dcache_lookup(uint64_t parent, const uint8_t* name, uint64_t* id) {
+    ASSERT_NOT_NULL(name);
+    ASSERT_NOT_NULL(id);
+    if (dcache_cacheable(name)) {
+        struct dcache_entry* e = *(dcache_find_link(parent, name));
+        if (0 != e) {
+            dcache_lru_unlink(e);
+            dcache_lru_push(e);
+            *id = e->id;
+            if (0 == e->id) {
+                dcache_counters.negative_hits++;
+            } else {
+                dcache_counters.hits++;
+            }
+            return true;
+        }
+    }
+    dcache_counters.misses++;
+    return false;
+}
+
+void dcache_insert(uint64_t parent, const uint8_t* name, uint64_t id) {
+    ASSERT_NOT_NULL(name);
+    if (!dcache_cacheable(name)) {
+        return;
+    }
+    struct dcache_entry** link = dcache_find_link(parent, name);
+    struct dcache_entry* e = *link;
+    if (0 == e) {
+        if (dcache_counters.entries >= DCACHE_MAX_ENTRIES) {
+            struct dcache_entry* victim = dcache_lru_tail;
+            ASSERT_NOT_NULL(victim);
+            struct dcache_entry** victim_link = dcache_find_link(victim->parent, victim->name);
+            ASSERT(*victim_link == victim);
+            dcache_unlink(victim_link);
+            dcache_counters.evictions++;
+            // the victim may have been in our bucket, in front of where we were going
+            link = dcache_find_link(parent, name);
+        }
+        e = (struct dcache_entry*)kpool_alloc(&dcache_entry_pool);
+        memzero((uint8_t*)e, sizeof(struct dcache_entry));
+        e->parent = parent;
+        strncpy(e->name, name, FILESYSTEM_MAX_NAME);
+        *link = e;
+        dcache_counters.entries++;
+    } else {
+        dcache_lru_unlink(e);
+    }
+    e->id = id;
+    dcache_lru_push(e);
+}
+
+void dcache_remove(uint64_t parent, const uint8_t* name) {
+    ASSERT_NOT_NULL(name);
+    if (!dcache_cacheable(name)) {
+        return;
+    }
+    struct dcache_entry** link = dcache_find_link(parent, name);
+    if (0 != *link) {
+        dcache_unlink(link);
+    }
+}
+
+/*
+ * drop everything known about the names in a directory, found or not
+ */
+void dcache_invalidate_directory(uint64_t parent) {
+    if (0 == dcache_counters.entries) {
+        return;
+    }
+    for (uint16_t i = 0; i < DCACHE_BUCKETS; i++) {
+        struct dcache_entry** link = &(dcache_buckets[i]);
+        while (0 != *link) {
+            if ((*link)->parent == parent) {
+                dcache_unlink(link);
+            } else {
+                link = &((*link)->next);
+            }
+        }
+    }
+}
+
+void dcache_clear() {
+    if (0 == dcache_counters.entries) {
+        return;
+    }
+    for (uint16_t i = 0; i < DCACHE_BUCKETS; i++) {
+        while (0 != dcache_buckets[i]) {
+            dcache_unlink(&(dcache_buckets[i]));
+        }
+    }
+}
+
+void dcache_stats(struct dcache_stats* stats) {
+    ASSERT_NOT_NULL(stats);
+    memcpy((uint8_t*)stats, (uint8_t*)&dcache_counters, sizeof(struct dcache_stats));
+}
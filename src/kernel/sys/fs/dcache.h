@@ -0,0 +1,39 @@
+//*****************************************************************
+// This file is part of CosmOS                                    *
+// Copyright (C) 2021 Tom Everett                                 *
+// Released under the stated terms in the file LICENSE            *
+// See the file "LICENSE" in the source distribution for details  *
+// ****************************************************************
+/*
+ * the dentry cache remembers what a name in a directory turned out to be, so a lookup doesn't have to list the
+ * directory again.  entries are hashed on (parent node id, name) and hold the id of the node found, or 0 for a
+ * name that isn't there (a negative entry).  node ids are never reused, across all filesystems, so an entry can't
+ * match the wrong node; one whose node has gone just stops resolving, and is dropped.
+ *
+ * fsfacade fills the cache as it looks names up.  writes through fsfacade drop the entries of the directory
+ * written to, and objects coming and going drop everything, since objfs and voh list them.
+ */
+#ifndef _DCACHE_H
+#define _DCACHE_H
+
+#include <types.h>
+
+#define DCACHE_BUCKETS 256
+#define DCACHE_MAX_ENTRIES 512  // after which the least recently used entry goes
+
+struct dcache_stats {
+    uint64_t hits;
+    uint64_t negative_hits;  // hits on a negative entry
+    uint64_t misses;
+    uint64_t evictions;
+    uint64_t entries;
+};
+
+bool dcache_lookup(uint64_t parent, const uint8_t* name, uint64_t* id);
+void dcache_insert(uint64_t parent, const uint8_t* name, uint64_t id);
+void dcache_remove(uint64_t parent, const uint8_t* name);
+void dcache_invalidate_directory(uint64_t parent);
+void dcache_clear();
+void dcache_stats(struct dcache_stats* stats);
+
+#endif
@@ -29,14 +29,14 @@ uint8_t* file_util_read_file(uint8_t* device_name, uint8_t* file_name, uint32_t*
         */
         struct filesystem_node* fs_root_node = fsfacade_get_fs_rootnode(fs_dev);
         /*
-        * file node
+        * file node. file_name can be a path
         */
-        struct filesystem_node* fs_node = fsfacade_find_node_by_name(fs_root_node, file_name);
+        struct filesystem_node* fs_node = fsfacade_find_node_by_path(fs_root_node, file_name);
         if (0 != fs_node) {
             uint32_t buffer_size = fsfacade_size(fs_node);
             *len = buffer_size;
             uint8_t* ret = kmalloc(buffer_size);
-            fsfacade_read(fs_node, ret, buffer_size);
+            fsfacade_read_all(fs_node, ret, buffer_size);
             return ret;
         } else {
             kprintf("Unable to find file %s\n", file_name);
@@ -60,9 +60,9 @@ struct filesystem_node* file_util_find_file(uint8_t* device_name, uint8_t* file_
         */
         struct filesystem_node* fs_root_node = fsfacade_get_fs_rootnode(fs_dev);
         /*
-        * file node
+        * file node. file_name can be a path
         */
-        struct filesystem_node* fs_node = fsfacade_find_node_by_name(fs_root_node, file_name);
+        struct filesystem_node* fs_node = fsfacade_find_node_by_path(fs_root_node, file_name);
         if (0 != fs_node) {
             return fs_node;
         } else {
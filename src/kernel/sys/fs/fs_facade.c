@@ -6,7 +6,10 @@
 // ****************************************************************
 
 #include <sys/debug/assert.h>
+#include <sys/fs/dcache.h>
 #include <sys/fs/fs_facade.h>
+#include <sys/fs/pagecache.h>
+#include <sys/kmalloc/kmalloc.h>
 #include <sys/kprintf/kprintf.h>
 #include <sys/obj/object/object.h>
 #include <sys/obj/objectinterface/objectinterface_filesystem.h>
@@ -45,18 +48,18 @@ void fsfacade_traverse_internal(struct filesystem_node* fs_node, fsfacade_traver
     // call the callback
     (*f)(fs_node, depth);
 
-    struct filesystem_directory dir;
-    memzero((uint8_t*)&dir, sizeof(struct filesystem_directory));
-    fsfacade_list_directory(fs_node, &dir);
+    // on the heap; at 8k a level, the stack wouldn't last long
+    struct filesystem_directory* dir = (struct filesystem_directory*)kmalloc(sizeof(struct filesystem_directory));
+    dir->count = 0;
+    fsfacade_list_directory(fs_node, dir);
 
-    if (dir.count > 0) {
-        for (uint32_t i = 0; i < dir.count; i++) {
-            //    kprintf("dir %s index: %llu child id: %#llX\n", fs_node->name, i, dir.ids[i]);
-            struct filesystem_node* child = fsfacade_find_node_by_id(fs_node, dir.ids[i]);
-            ASSERT_NOT_NULL(child);
-            fsfacade_traverse_internal(child, f, depth + 1);
-        }
+    for (uint32_t i = 0; i < dir->count; i++) {
+        //    kprintf("dir %s index: %llu child id: %#llX\n", fs_node->name, i, dir->ids[i]);
+        struct filesystem_node* child = fsfacade_find_node_by_id(fs_node, dir->ids[i]);
+        ASSERT_NOT_NULL(child);
+        fsfacade_traverse_internal(child, f, depth + 1);
     }
+    kfree(dir);
 }
 
 /*
@@ -112,42 +115,122 @@ uint64_t fsfacade_size(struct filesystem_node* fs_node) {
     return fs_node->size;
 }
 
+/*
+ * look a name up in a directory. the dentry cache answers repeat lookups, found or not; otherwise the directory
+ * is listed, and every name in it goes in the cache
+ */
 struct filesystem_node* fsfacade_find_node_by_name(struct filesystem_node* fs_node, char* name) {
     ASSERT_NOT_NULL(fs_node);
     ASSERT_NOT_NULL(fs_node->filesystem_obj);
     ASSERT_NOT_NULL(fs_node->filesystem_obj->api);
     ASSERT_NOT_NULL(name);
 
-    struct filesystem_directory dir;
-    fsfacade_list_directory(fs_node, &dir);
+    uint64_t id = 0;
+    if (dcache_lookup(fs_node->id, name, &id)) {
+        if (0 == id) {
+            return 0;
+        }
+        struct filesystem_node* node = fsfacade_find_node_by_id(fs_node, id);
+        if (0 != node) {
+            return node;
+        }
+        // the node has gone from under us
+        dcache_remove(fs_node->id, name);
+    }
+
+    struct filesystem_node* ret = 0;
+    struct filesystem_directory* dir = (struct filesystem_directory*)kmalloc(sizeof(struct filesystem_directory));
+    dir->count = 0;
+    fsfacade_list_directory(fs_node, dir);
+    for (uint32_t i = 0; i < dir->count; i++) {
+        struct filesystem_node* node = fsfacade_find_node_by_id(fs_node, dir->ids[i]);
+        ASSERT_NOT_NULL(node);
+        dcache_insert(fs_node->id, node->name, node->id);
+        if ((0 == ret) && (strcmp(node->name, name) == 0)) {
+            ret = node;
+        }
+    }
+    kfree(dir);
+    if (0 == ret) {
+        dcache_insert(fs_node->id, name, 0);
+    }
+    return ret;
+}
+
+/*
+ * resolve a path of names separated by FILESYSTEM_NAME_DELIMITER, from fs_node. empty components and "." are
+ * skipped, and ".." goes up a level, stopping at the root
+ */
+struct filesystem_node* fsfacade_find_node_by_path(struct filesystem_node* fs_node, char* path) {
+    ASSERT_NOT_NULL(fs_node);
+    ASSERT_NOT_NULL(path);
 
-    if (dir.count > 0) {
-        for (uint32_t i = 0; i < dir.count; i++) {
-            uint64_t id = dir.ids[i];
-            struct filesystem_node* node = fsfacade_find_node_by_id(fs_node, id);
-            ASSERT_NOT_NULL(node);
-            if (strcmp(node->name, name) == 0) {
-                return node;
+    uint8_t delimiter = FILESYSTEM_NAME_DELIMITER[0];
+    uint8_t component[FILESYSTEM_MAX_NAME];
+    struct filesystem_node* node = fs_node;
+    uint32_t depth = 0;
+    uint64_t i = 0;
+    while (0 != path[i]) {
+        uint64_t len = 0;
+        while ((0 != path[i]) && (delimiter != path[i])) {
+            if (len >= (FILESYSTEM_MAX_NAME - 1)) {
+                return 0;
+            }
+            component[len++] = path[i++];
+        }
+        component[len] = 0;
+        if (delimiter == path[i]) {
+            i++;
+        }
+        if ((0 == len) || (0 == strcmp(component, "."))) {
+            continue;
+        }
+        if (++depth > FILESYSTEM_MAX_DEPTH) {
+            return 0;
+        }
+        if (0 == strcmp(component, "..")) {
+            if (0 != node->parent) {
+                // not every filesystem can find its own root by id
+                struct filesystem_node* root = fsfacade_get_fs_rootnode(node->filesystem_obj);
+                if (root->id == node->parent) {
+                    node = root;
+                } else {
+                    node = fsfacade_find_node_by_id(node, node->parent);
+                }
+                if (0 == node) {
+                    return 0;
+                }
             }
+            continue;
+        }
+        if (folder != node->type) {
+            return 0;
+        }
+        node = fsfacade_find_node_by_name(node, component);
+        if (0 == node) {
+            return 0;
         }
     }
-    return 0;
+    return node;
 }
 
-uint32_t fsfacade_read(struct filesystem_node* fs_node, uint8_t* data, uint32_t data_size) {
+uint32_t fsfacade_read(struct filesystem_node* fs_node, uint64_t offset, uint8_t* data, uint32_t data_size) {
     ASSERT_NOT_NULL(fs_node);
     ASSERT_NOT_NULL(fs_node->filesystem_obj);
     ASSERT_NOT_NULL(fs_node->filesystem_obj->api);
     ASSERT_NOT_NULL(data);
     ASSERT_NOT_NULL(data_size);
     struct objectinterface_filesystem* fs_api = (struct objectinterface_filesystem*)fs_node->filesystem_obj->api;
+    if (pagecache_cacheable(fs_node)) {
+        return pagecache_read(fs_node, offset, data, data_size);
+    }
     if (0 != fs_api->read) {
-        return (*fs_api->read)(fs_node, data, data_size);
+        return (*fs_api->read)(fs_node, offset, data, data_size);
     }
     return 0;
 }
 
-uint32_t fsfacade_write(struct filesystem_node* fs_node, const uint8_t* data, uint32_t data_size) {
+uint32_t fsfacade_write(struct filesystem_node* fs_node, uint64_t offset, const uint8_t* data, uint32_t data_size) {
     ASSERT_NOT_NULL(fs_node);
     ASSERT_NOT_NULL(fs_node->filesystem_obj);
     ASSERT_NOT_NULL(fs_node->filesystem_obj->api);
@@ -156,11 +239,91 @@ uint32_t fsfacade_write(struct filesystem_node* fs_node, const uint8_t* data, ui
 
     struct objectinterface_filesystem* fs_api = (struct objectinterface_filesystem*)fs_node->filesystem_obj->api;
     if (0 != fs_api->write) {
-        return (*fs_api->write)(fs_node, data, data_size);
+        uint64_t from = (offset < fs_node->size) ? offset : fs_node->size;
+        uint32_t ret = (*fs_api->write)(fs_node, offset, data, data_size);
+        // the cached pages written, and, for a write past the end, those from the old end on
+        pagecache_invalidate(fs_node, from, (offset + data_size) - from);
+        // writing a file's data leaves its directory's names as they were; writing a folder may not
+        if (folder == fs_node->type) {
+            dcache_invalidate_directory(fs_node->id);
+        }
+        return ret;
     }
     return 0;
 }
 
+struct filesystem_node* fsfacade_create(struct filesystem_node* fs_node, uint8_t* name) {
+    ASSERT_NOT_NULL(fs_node);
+    ASSERT_NOT_NULL(fs_node->filesystem_obj);
+    ASSERT_NOT_NULL(fs_node->filesystem_obj->api);
+    ASSERT_NOT_NULL(name);
+    struct objectinterface_filesystem* fs_api = (struct objectinterface_filesystem*)fs_node->filesystem_obj->api;
+    if (0 != fs_api->create) {
+        struct filesystem_node* ret = (*fs_api->create)(fs_node, name);
+        // the cache may say the name isn't there
+        dcache_invalidate_directory(fs_node->id);
+        return ret;
+    }
+    return 0;
+}
+
+bool fsfacade_truncate(struct filesystem_node* fs_node, uint64_t size) {
+    ASSERT_NOT_NULL(fs_node);
+    ASSERT_NOT_NULL(fs_node->filesystem_obj);
+    ASSERT_NOT_NULL(fs_node->filesystem_obj->api);
+    struct objectinterface_filesystem* fs_api = (struct objectinterface_filesystem*)fs_node->filesystem_obj->api;
+    if (0 != fs_api->truncate) {
+        uint64_t old_size = fs_node->size;
+        bool ret = (*fs_api->truncate)(fs_node, size);
+        // everything from the nearer end on
+        pagecache_invalidate(fs_node, (size < old_size) ? size : old_size, 0);
+        return ret;
+    }
+    return false;
+}
+
+void fsfacade_sync(struct object* filesystem_obj) {
+    ASSERT_NOT_NULL(filesystem_obj);
+    ASSERT_NOT_NULL(filesystem_obj->api);
+    struct objectinterface_filesystem* fs_api = (struct objectinterface_filesystem*)filesystem_obj->api;
+    if (0 != fs_api->sync) {
+        (*fs_api->sync)(filesystem_obj);
+    }
+}
+
+const uint8_t* fsfacade_map(struct filesystem_node* fs_node) {
+    ASSERT_NOT_NULL(fs_node);
+    ASSERT_NOT_NULL(fs_node->filesystem_obj);
+    ASSERT_NOT_NULL(fs_node->filesystem_obj->api);
+    struct objectinterface_filesystem* fs_api = (struct objectinterface_filesystem*)fs_node->filesystem_obj->api;
+    if (0 != fs_api->map) {
+        return (*fs_api->map)(fs_node);
+    }
+    return 0;
+}
+
+/*
+ * read a whole node into data, FSFACADE_CHUNK bytes at a time.  returns the bytes read, which is short if the
+ * node ends early
+ */
+uint64_t fsfacade_read_all(struct filesystem_node* fs_node, uint8_t* data, uint64_t data_size) {
+    ASSERT_NOT_NULL(fs_node);
+    ASSERT_NOT_NULL(data);
+    uint64_t done = 0;
+    while (done < data_size) {
+        uint64_t chunk = data_size - done;
+        if (chunk > FSFACADE_CHUNK) {
+            chunk = FSFACADE_CHUNK;
+        }
+        uint32_t read = fsfacade_read(fs_node, done, &(data[done]), (uint32_t)chunk);
+        if (0 == read) {
+            break;
+        }
+        done += read;
+    }
+    return done;
+}
+
 void dump_VOH() {
     //    kprintf("\n");
     //    kprintf("***** VOH (Virtual Object Hierarchy) *****\n");
@@ -31,9 +31,36 @@ uint64_t fsfacade_size(struct filesystem_node* fs_node);
 
 struct filesystem_node* fsfacade_find_node_by_name(struct filesystem_node* fs_node, char* name);
 
-uint32_t fsfacade_read(struct filesystem_node* fs_node, uint8_t* data, uint32_t data_size);
+struct filesystem_node* fsfacade_find_node_by_path(struct filesystem_node* fs_node, char* path);
 
-uint32_t fsfacade_write(struct filesystem_node* fs_node, const uint8_t* data, uint32_t data_size);
+/*
+* read and write take a byte offset into the node, so a big file can be read a buffer at a time
+*/
+uint32_t fsfacade_read(struct filesystem_node* fs_node, uint64_t offset, uint8_t* data, uint32_t data_size);
+
+uint32_t fsfacade_write(struct filesystem_node* fs_node, uint64_t offset, const uint8_t* data, uint32_t data_size);
+
+/*
+* create makes an empty file in a folder.  truncate sets a file's size.  a filesystem may hold writes back; sync
+* writes them out
+*/
+struct filesystem_node* fsfacade_create(struct filesystem_node* fs_node, uint8_t* name);
+
+bool fsfacade_truncate(struct filesystem_node* fs_node, uint64_t size);
+
+void fsfacade_sync(struct object* filesystem_obj);
+
+/*
+* the node's contents in memory, a page at a time, or 0 if the filesystem can't map it.  the pages aren't to be written
+*/
+const uint8_t* fsfacade_map(struct filesystem_node* fs_node);
+
+/*
+* the most fsfacade_read_all asks for at once
+*/
+#define FSFACADE_CHUNK (64 * 1024)
+
+uint64_t fsfacade_read_all(struct filesystem_node* fs_node, uint8_t* data, uint64_t data_size);
 
 void fsfacade_dump_node(struct filesystem_node* fs_node);
 void dump_VOH();
@@ -0,0 +1,381 @@
+//*****************************************************************
+// This file is part of CosmOS                                    *
+// Copyright (C) 2021 Tom Everett                                 *
+// Released under the stated terms in the file LICENSE            *
+// See the file "LICENSE" in the source distribution for details  *
+// ****************************************************************
+
+#include <sys/debug/assert.h>
+#include <sys/fs/pagecache.h>
+#include <sys/kmalloc/kpool.h>
+#include <sys/obj/object/object.h>
+#include <sys/obj/objectinterface/objectinterface_filesystem.h>
+#include <sys/string/mem.h>
+#include <sys/sync/sync.h>
+#include <sys/x86-64/mm/mm.h>
+#include <sys/x86-64/mm/pagetables.h>
+#include <types.h>
+
+struct pagecache_entry {
+    struct pagecache_entry* next;  // in the bucket
+    struct pagecache_entry* lru_prev;
+    struct pagecache_entry* lru_next;
+    uint64_t node;    // node id
+    uint64_t index;   // page in the node
+    uint64_t page;    // page directory index of the physical page
+    uint32_t length;  // bytes of the node in the page; the rest is zeros
+};
+
+kpool pagecache_entry_pool = KPOOL_INIT("pagecache_entry", struct pagecache_entry, NULL);
+
+struct pagecache_entry* pagecache_buckets[PAGECACHE_BUCKETS];
+
+// most recently used first
+struct pagecache_entry* pagecache_lru_head = 0;
+struct pagecache_entry* pagecache_lru_tail = 0;
+
+struct pagecache_stats pagecache_counters;
+
+// bumped by every invalidate, so a fill that raced one knows its page may be stale
+uint64_t pagecache_generation = 0;
+
+/*
+ * pagecache_lock covers the buckets, the LRU, the counters and the generation.  it is never held while the cache
+ * allocates or reads, since allocating can call back into the shrinker.  page_dir_lock is taken inside it
+ */
+
+uint16_t pagecache_hash(uint64_t node, uint64_t index) {
+    uint64_t hash = (node * 0x9E3779B97F4A7C15) ^ (index * 0xC2B2AE3D27D4EB4F);
+    return (hash ^ (hash >> 32)) % PAGECACHE_BUCKETS;
+}
+
+/*
+ * the cache holds a reference on each of its pages, and so does whoever pagecache_get_page gave one to.  the page is
+ * freed when the last goes
+ */
+void pagecache_page_hold(uint64_t page) {
+    spinlock_acquire(&page_dir_lock);
+    page_directory[page].ref_count++;
+    spinlock_release(&page_dir_lock);
+}
+
+void pagecache_page_release(uint64_t page) {
+    spinlock_acquire(&page_dir_lock);
+    ASSERT_NOT_NULL(page_directory[page].ref_count);
+    bool last = (0 == --page_directory[page].ref_count);
+    spinlock_release(&page_dir_lock);
+    if (last) {
+        slab_free(page, 1);
+    }
+}
+
+bool pagecache_page_held(uint64_t page) {
+    spinlock_acquire(&page_dir_lock);
+    bool ret = (page_directory[page].ref_count > 1);
+    spinlock_release(&page_dir_lock);
+    return ret;
+}
+
+void pagecache_lru_unlink(struct pagecache_entry* e) {
+    if (0 != e->lru_prev) {
+        e->lru_prev->lru_next = e->lru_next;
+    } else {
+        pagecache_lru_head = e->lru_next;
+    }
+    if (0 != e->lru_next) {
+        e->lru_next->lru_prev = e->lru_prev;
+    } else {
+        pagecache_lru_tail = e->lru_prev;
+    }
+    e->lru_prev = 0;
+    e->lru_next = 0;
+}
+
+void pagecache_lru_push(struct pagecache_entry* e) {
+    e->lru_prev = 0;
+    e->lru_next = pagecache_lru_head;
+    if (0 != pagecache_lru_head) {
+        pagecache_lru_head->lru_prev = e;
+    } else {
+        pagecache_lru_tail = e;
+    }
+    pagecache_lru_head = e;
+}
+
+struct pagecache_entry** pagecache_find_link(uint64_t node, uint64_t index) {
+    struct pagecache_entry** link = &(pagecache_buckets[pagecache_hash(node, index)]);
+    while (0 != *link) {
+        if (((*link)->node == node) && ((*link)->index == index)) {
+            return link;
+        }
+        link = &((*link)->next);
+    }
+    return link;
+}
+
+void pagecache_unlink(struct pagecache_entry** link) {
+    struct pagecache_entry* e = *link;
+    *link = e->next;
+    pagecache_lru_unlink(e);
+    pagecache_page_release(e->page);
+    kpool_free(&pagecache_entry_pool, e);
+    pagecache_counters.pages--;
+}
+
+void pagecache_drop(struct pagecache_entry* e) {
+    struct pagecache_entry** link = pagecache_find_link(e->node, e->index);
+    ASSERT(*link == e);
+    pagecache_unlink(link);
+}
+
+/*
+ * drop up to count of the least recently used pages that nobody holds.  returns the number dropped.  the caller holds
+ * pagecache_lock
+ */
+uint64_t pagecache_evict(uint64_t count) {
+    uint64_t dropped = 0;
+    struct pagecache_entry* e = pagecache_lru_tail;
+    while ((0 != e) && (dropped < count)) {
+        struct pagecache_entry* prev = e->lru_prev;
+        if (!pagecache_page_held(e->page)) {
+            pagecache_drop(e);
+            pagecache_counters.evictions++;
+            dropped++;
+        }
+        e = prev;
+    }
+    return dropped;
+}
+
+/*
+ * only files are cached, and only on filesystems whose files don't change behind fsfacade's back
+ */
+bool pagecache_cacheable(struct filesystem_node* fs_node) {
+    struct objectinterface_filesystem* fs_api = (struct objectinterface_filesystem*)fs_node->filesystem_obj->api;
+    return (file == fs_node->type) && (0 != fs_api->read) && fs_api->cached;
+}
+
+/*
+ * read a page of the node from its filesystem, and cache it.  returns the page held, as pagecache_get_page does, and
+ * sets length to the bytes of the node in it.  0 past the end of the node, or if there's no memory.  the lock is
+ * dropped while the page is read, so the page may turn up in the cache meanwhile, in which case that copy is used;
+ * or the node may be written, in which case the page is returned uncached, since it may be stale
+ */
+uint64_t pagecache_fill(struct filesystem_node* fs_node, uint64_t index, uint64_t generation, uint32_t* length) {
+    struct objectinterface_filesystem* fs_api = (struct objectinterface_filesystem*)fs_node->filesystem_obj->api;
+    uint64_t page = slab_allocate(1, PDT_INUSE);
+    if (0 == page) {
+        return 0;
+    }
+    uint8_t* data = CONV_PHYS_ADDR(page * PAGE_SIZE);
+    memzero(data, PAGE_SIZE);
+    uint32_t read_length = 0;
+    while (read_length < PAGE_SIZE) {
+        uint32_t read = (*fs_api->read)(fs_node, (index * PAGE_SIZE) + read_length, &(data[read_length]),
+                                        PAGE_SIZE - read_length);
+        if (0 == read) {
+            break;
+        }
+        read_length += read;
+    }
+    if (0 == read_length) {
+        slab_free(page, 1);
+        return 0;
+    }
+    *length = read_length;
+    struct pagecache_entry* e = (struct pagecache_entry*)kpool_alloc(&pagecache_entry_pool);
+    memzero((uint8_t*)e, sizeof(struct pagecache_entry));
+    e->node = fs_node->id;
+    e->index = index;
+    e->page = page;
+    e->length = read_length;
+
+    spinlock_acquire(&pagecache_lock);
+    if (generation != pagecache_generation) {
+        // the page read is the caller's alone
+        spinlock_release(&pagecache_lock);
+        kpool_free(&pagecache_entry_pool, e);
+        return page;
+    }
+    struct pagecache_entry** link = pagecache_find_link(e->node, e->index);
+    if (0 != *link) {
+        struct pagecache_entry* other = *link;
+        pagecache_lru_unlink(other);
+        pagecache_lru_push(other);
+        pagecache_page_hold(other->page);
+        uint64_t ret = other->page;
+        *length = other->length;
+        spinlock_release(&pagecache_lock);
+        kpool_free(&pagecache_entry_pool, e);
+        slab_free(page, 1);
+        return ret;
+    }
+    if (pagecache_counters.pages >= PAGECACHE_MAX_PAGES) {
+        pagecache_evict(1);
+        // which may have changed the bucket
+        link = pagecache_find_link(e->node, e->index);
+    }
+    *link = e;
+    pagecache_lru_push(e);
+    pagecache_counters.pages++;
+    pagecache_page_hold(page);
+    spinlock_release(&pagecache_lock);
+    return page;
+}
+
+/*
+ * the page holding page index of the node, held, as from pagecache_get_page, with the bytes of the node in it in
+ * length.  0 if there isn't one
+ */
+uint64_t pagecache_lookup(struct filesystem_node* fs_node, uint64_t index, uint32_t* length) {
+    spinlock_acquire(&pagecache_lock);
+    struct pagecache_entry* e = *(pagecache_find_link(fs_node->id, index));
+    if (0 != e) {
+        pagecache_lru_unlink(e);
+        pagecache_lru_push(e);
+        pagecache_counters.hits++;
+        pagecache_page_hold(e->page);
+        uint64_t ret = e->page;
+        *length = e->length;
+        spinlock_release(&pagecache_lock);
+        return ret;
+    }
+    pagecache_counters.misses++;
+    uint64_t generation = pagecache_generation;
+    spinlock_release(&pagecache_lock);
+    return pagecache_fill(fs_node, index, generation, length);
+}
+
+/*
+ * read like filesystem_read_function, from the cache, reading the pages that aren't there from the filesystem.  a
+ * node that isn't cached is read from the filesystem
+ */
+uint32_t pagecache_read(struct filesystem_node* fs_node, uint64_t offset, uint8_t* data, uint32_t data_size) {
+    ASSERT_NOT_NULL(fs_node);
+    ASSERT_NOT_NULL(fs_node->filesystem_obj);
+    ASSERT_NOT_NULL(fs_node->filesystem_obj->api);
+    ASSERT_NOT_NULL(data);
+    if (!pagecache_cacheable(fs_node)) {
+        struct objectinterface_filesystem* fs_api = (struct objectinterface_filesystem*)fs_node->filesystem_obj->api;
+        return (0 != fs_api->read) ? (*fs_api->read)(fs_node, offset, data, data_size) : 0;
+    }
+    uint32_t done = 0;
+    while (done < data_size) {
+        uint64_t at = (offset + done) % PAGE_SIZE;
+        uint32_t length = 0;
+        uint64_t page = pagecache_lookup(fs_node, (offset + done) / PAGE_SIZE, &length);
+        if (0 == page) {
+            break;
+        }
+        if (at >= length) {
+            pagecache_page_release(page);
+            break;
+        }
+        uint32_t chunk = length - at;
+        if (chunk > (data_size - done)) {
+            chunk = data_size - done;
+        }
+        uint8_t* page_data = CONV_PHYS_ADDR(page * PAGE_SIZE);
+        memcpy(&(data[done]), &(page_data[at]), chunk);
+        pagecache_page_release(page);
+        done += chunk;
+        if (length < PAGE_SIZE) {
+            // the end of the node
+            break;
+        }
+    }
+    return done;
+}
+
+/*
+ * the page directory index of page index of the node, in the cache, zero filled past the end of the node.  the caller
+ * holds the page until it puts it back, so it can be mapped.  the page isn't to be written.  0 if the node isn't
+ * cached, or the page is past its end
+ */
+uint64_t pagecache_get_page(struct filesystem_node* fs_node, uint64_t index) {
+    ASSERT_NOT_NULL(fs_node);
+    ASSERT_NOT_NULL(fs_node->filesystem_obj);
+    ASSERT_NOT_NULL(fs_node->filesystem_obj->api);
+    if (!pagecache_cacheable(fs_node)) {
+        return 0;
+    }
+    uint32_t length = 0;
+    return pagecache_lookup(fs_node, index, &length);
+}
+
+void pagecache_put_page(uint64_t page) {
+    ASSERT_NOT_NULL(page);
+    pagecache_page_release(page);
+}
+
+/*
+ * drop the cached pages holding bytes offset to offset + size of the node.  a size of 0 drops everything from offset
+ * on
+ */
+void pagecache_invalidate(struct filesystem_node* fs_node, uint64_t offset, uint64_t size) {
+    ASSERT_NOT_NULL(fs_node);
+    spinlock_acquire(&pagecache_lock);
+    pagecache_generation++;
+    if (0 == pagecache_counters.pages) {
+        spinlock_release(&pagecache_lock);
+        return;
+    }
+    uint64_t first = offset / PAGE_SIZE;
+    uint64_t last = 0xFFFFFFFFFFFFFFFF;
+    if ((0 != size) && (size <= (last - offset))) {
+        last = (offset + size - 1) / PAGE_SIZE;
+    }
+    if ((last - first) < PAGECACHE_BUCKETS) {
+        for (uint64_t i = first; i <= last; i++) {
+            struct pagecache_entry** link = pagecache_find_link(fs_node->id, i);
+            if (0 != *link) {
+                pagecache_unlink(link);
+            }
+        }
+        spinlock_release(&pagecache_lock);
+        return;
+    }
+    for (uint16_t i = 0; i < PAGECACHE_BUCKETS; i++) {
+        struct pagecache_entry** link = &(pagecache_buckets[i]);
+        while (0 != *link) {
+            if (((*link)->node == fs_node->id) && ((*link)->index >= first) && ((*link)->index <= last)) {
+                pagecache_unlink(link);
+            } else {
+                link = &((*link)->next);
+            }
+        }
+    }
+    spinlock_release(&pagecache_lock);
+}
+
+/*
+ * the shrinker.  the page allocator calls it when it runs out, before it goes to swap, since a clean page can be
+ * dropped without writing it anywhere.  returns the pages freed; none if the cache is locked, since the allocating
+ * thread may be the one holding the lock
+ */
+uint64_t pagecache_shrink(uint64_t count) {
+    if (!spinlock_try_acquire(&pagecache_lock)) {
+        return 0;
+    }
+    uint64_t ret = pagecache_evict(count);
+    spinlock_release(&pagecache_lock);
+    return ret;
+}
+
+void pagecache_clear() {
+    spinlock_acquire(&pagecache_lock);
+    pagecache_generation++;
+    for (uint16_t i = 0; i < PAGECACHE_BUCKETS; i++) {
+        while (0 != pagecache_buckets[i]) {
+            pagecache_unlink(&(pagecache_buckets[i]));
+        }
+    }
+    spinlock_release(&pagecache_lock);
+}
+
+void pagecache_stats(struct pagecache_stats* stats) {
+    ASSERT_NOT_NULL(stats);
+    spinlock_acquire(&pagecache_lock);
+    memcpy((uint8_t*)stats, (uint8_t*)&pagecache_counters, sizeof(struct pagecache_stats));
+    spinlock_release(&pagecache_lock);
+}
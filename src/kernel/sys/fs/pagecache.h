@@ -0,0 +1,45 @@
+//*****************************************************************
+// This file is part of CosmOS                                    *
+// Copyright (C) 2021 Tom Everett                                 *
+// Released under the stated terms in the file LICENSE            *
+// See the file "LICENSE" in the source distribution for details  *
+// ****************************************************************
+/*
+ * the page cache holds the contents of files, a physical page at a time, so a file read twice is read from the
+ * disk once, and an executable can be mapped from the same pages its reads came from.  pages are hashed on (node id,
+ * page index in the node); node ids are never reused, so a page can't be found for the wrong file.
+ *
+ * fsfacade reads through the cache for filesystems that set cached in their api, which are those whose files only
+ * change through fsfacade.  writes and truncates through fsfacade go to the filesystem, and drop the pages they
+ * change, so every cached page is clean and can be dropped at any time.  past PAGECACHE_MAX_PAGES, and when the
+ * page allocator runs out, the least recently used pages go; the allocator's shrink gives up, rather than wait, if
+ * the cache is locked.  a page someone holds (pagecache_get_page) stays until it is put back, even if it has been
+ * dropped from the cache.
+ */
+#ifndef _PAGECACHE_H
+#define _PAGECACHE_H
+
+#include <types.h>
+
+struct filesystem_node;
+
+#define PAGECACHE_BUCKETS 256
+#define PAGECACHE_MAX_PAGES 1024  // 4MB
+
+struct pagecache_stats {
+    uint64_t hits;
+    uint64_t misses;
+    uint64_t evictions;  // pages dropped to make room, or by the shrinker
+    uint64_t pages;
+};
+
+bool pagecache_cacheable(struct filesystem_node* fs_node);
+uint32_t pagecache_read(struct filesystem_node* fs_node, uint64_t offset, uint8_t* data, uint32_t data_size);
+uint64_t pagecache_get_page(struct filesystem_node* fs_node, uint64_t index);
+void pagecache_put_page(uint64_t page);
+void pagecache_invalidate(struct filesystem_node* fs_node, uint64_t offset, uint64_t size);
+uint64_t pagecache_shrink(uint64_t count);
+void pagecache_clear();
+void pagecache_stats(struct pagecache_stats* stats);
+
+#endif
@@ -5,17 +5,21 @@
 // See the file "LICENSE" in the source distribution for details  *
 // ****************************************************************
 
-#include <sys/collection/arraylist/arraylist.h>
 #include <sys/collection/bitmap/bitmap.h>
 #include <sys/debug/assert.h>
 #include <sys/iobuffers/iobuffers.h>
 #include <sys/kmalloc/kmalloc.h>
 #include <sys/kprintf/kprintf.h>
 #include <sys/panic/panic.h>
+#include <sys/string/mem.h>
+#include <sys/sync/sync.h>
 #include <sys/x86-64/mm/pagetables.h>
 
 #define SIXTY_FOUR_MEGA_BYTES 0x4000000
 
+// a page that isn't carved into a size class
+#define IOBUFFERS_CLASS_NONE 0xFF
+
 void* iobuffers_buffer_end_adddress(uint32_t start, uint32_t count);
 
 /*
@@ -26,25 +30,54 @@ uint64_t io_buf = 0;
  * IO buffer size
  */
 uint64_t io_buf_bytes = 0;
+/*
+ * physical address of io_buf. worked out once, so drivers never have to.
+ */
+uint64_t io_buf_phys = 0;
 /*
  * number of io_buffers
  */
 uint64_t number_io_buffers = 0;
 
-struct arraylist* buffer_list = 0;
 struct bitmap* map = 0;
 
-struct iobuffers_buffer {
-    uint64_t start_page;
-    uint64_t num_pages;
-    void* address;
+/*
+ * one record per 16k page, indexed by page number, so a release never has to search
+ */
+struct iobuffers_page {
+    uint8_t class;    // IOBUFFERS_CLASS_NONE, or the size class the page is carved into
+    uint16_t in_use;  // for size class pages, the number of buffers handed out
+    uint32_t run;     // for the first page of a multi-page buffer, the number of pages
 };
 
+struct iobuffers_page* iobuffers_pages = 0;
+
+/*
+ * free buffers in a size class are chained through their first bytes
+ */
+struct iobuffers_chunk {
+    struct iobuffers_chunk* next;
+};
+
+struct iobuffers_class {
+    uint32_t size;
+    struct iobuffers_chunk* free_list;
+    struct iobuffers_class_stats stats;
+};
+
+struct iobuffers_class iobuffers_classes[IOBUFFERS_CLASS_COUNT] = {
+    {.size = 512}, {.size = 2048}, {.size = 4096}};
+
+uint64_t iobuffers_requests = 0;
+uint64_t iobuffers_releases = 0;
+uint64_t iobuffers_failures = 0;
+
 void iobuffers_init() {
     ASSERT_NOT_NULL(io_buf);
     kprintf("   IO space size (bytes): %#hX\n", io_buf_bytes);
 
     number_io_buffers = io_buf_bytes / IOBUFFERS_BUFFER_SIZE;
+    io_buf_phys = (uint64_t)CONV_DMAP_ADDR(io_buf);
 
     uint64_t end_of_buffers = (uint64_t)iobuffers_buffer_end_adddress(0, number_io_buffers);
 
@@ -52,8 +85,18 @@ void iobuffers_init() {
             IOBUFFERS_BUFFER_SIZE, io_buf, end_of_buffers);
     ASSERT((uint64_t)CONV_DMAP_ADDR(end_of_buffers) < (uint64_t)SIXTY_FOUR_MEGA_BYTES);
 
-    buffer_list = arraylist_new(number_io_buffers);
     map = bitmap_new(number_io_buffers);
+    iobuffers_pages = (struct iobuffers_page*)kmalloc(sizeof(struct iobuffers_page) * number_io_buffers);
+    for (uint32_t i = 0; i < number_io_buffers; i++) {
+        iobuffers_pages[i].class = IOBUFFERS_CLASS_NONE;
+        iobuffers_pages[i].in_use = 0;
+        iobuffers_pages[i].run = 0;
+    }
+    for (uint8_t c = 0; c < IOBUFFERS_CLASS_COUNT; c++) {
+        iobuffers_classes[c].free_list = 0;
+        memzero((uint8_t*)&(iobuffers_classes[c].stats), sizeof(struct iobuffers_class_stats));
+        iobuffers_classes[c].stats.size = iobuffers_classes[c].size;
+    }
 }
 
 /*
@@ -65,25 +108,22 @@ void iobuffers_init() {
 uint8_t iobuffers_is_free_pages(uint32_t start, uint32_t count) {
     ASSERT_NOT_NULL(count);
     ASSERT_NOT_NULL(map);
-    ASSERT_NOT_NULL(buffer_list);
 
-    for (uint32_t i = 0; i < count; i++) {
-        // indexed off the end
-        if ((start + i) > number_io_buffers) {
-            return 0;
-        }
-        // check if used
-        if (bitmap_get(map, start + i) > 0) {
-            return 0;
-        }
+    // indexed off the end
+    if ((start + count) > number_io_buffers) {
+        return 0;
+    }
+    // free if the first used page is past the end of the chunk
+    uint64_t used = bitmap_find_next_set(map, start);
+    if ((BITMAP_NOT_FOUND == used) || (used >= (start + count))) {
+        return 1;
     }
-    return 1;
+    return 0;
 }
 
 uint32_t iobuffers_calc_num_pages(uint32_t size) {
     ASSERT_NOT_NULL(size);
     ASSERT_NOT_NULL(map);
-    ASSERT_NOT_NULL(buffer_list);
 
     if (size <= IOBUFFERS_BUFFER_SIZE) {
         return 1;
@@ -100,76 +140,217 @@ void* iobuffers_address(uint32_t start) {
     return (void*)(((uint64_t)io_buf) + (start * IOBUFFERS_BUFFER_SIZE));
 }
 
+/*
+ * the page a buffer lives in
+ */
+uint32_t iobuffers_page_index(void* buffer) {
+    ASSERT(((uint64_t)buffer >= io_buf) && ((uint64_t)buffer < (io_buf + io_buf_bytes)));
+    return ((uint64_t)buffer - io_buf) / IOBUFFERS_BUFFER_SIZE;
+}
+
 void iobuffers_mark_pages_free(uint32_t start, uint32_t count) {
     ASSERT_NOT_NULL(count);
     ASSERT_NOT_NULL(map);
-    ASSERT_NOT_NULL(buffer_list);
     // mark the pages
-    for (uint32_t i = 0; i < count; i++) {
-        bitmap_set(map, start + i, 1);
-    }
+    bitmap_clear_range(map, start, count);
 }
 
 void iobuffers_mark_pages_used(uint32_t start, uint32_t count) {
     ASSERT_NOT_NULL(count);
     ASSERT_NOT_NULL(map);
-    ASSERT_NOT_NULL(buffer_list);
     // mark the pages
-    for (uint32_t i = 0; i < count; i++) {
-        bitmap_set(map, start + i, 1);
-    }
+    bitmap_set_range(map, start, count);
 }
 
 void* iobuffers_buffer_end_adddress(uint32_t start, uint32_t count) {
     return iobuffers_address(start + count) + (IOBUFFERS_BUFFER_SIZE - 1);
 }
 
+/*
+ * the smallest size class a request fits in, or IOBUFFERS_CLASS_NONE if it needs whole pages
+ */
+uint8_t iobuffers_size_class(uint32_t size) {
+    for (uint8_t c = 0; c < IOBUFFERS_CLASS_COUNT; c++) {
+        if (size <= iobuffers_classes[c].size) {
+            return c;
+        }
+    }
+    return IOBUFFERS_CLASS_NONE;
+}
+
+/*
+ * take a run of free pages from the bitmap. returns the first page, or BITMAP_NOT_FOUND
+ */
+uint64_t iobuffers_take_pages(uint32_t page_count) {
+    // one word-at-a-time pass over the map finds the first hole big enough
+    uint64_t i = bitmap_find_zero_run(map, page_count);
+    if (BITMAP_NOT_FOUND != i) {
+        iobuffers_mark_pages_used(i, page_count);
+    }
+    return i;
+}
+
+/*
+ * size class pages are kept in their class once carved, so the next request of that size is a list pop.
+ * when the page bitmap runs dry, hand back any class pages with nothing in use.
+ */
+uint32_t iobuffers_trim_classes() {
+    uint32_t released = 0;
+    for (uint8_t c = 0; c < IOBUFFERS_CLASS_COUNT; c++) {
+        struct iobuffers_class* cls = &(iobuffers_classes[c]);
+
+        // unlink the free buffers that sit on idle pages
+        struct iobuffers_chunk** link = &(cls->free_list);
+        while (0 != *link) {
+            if (0 == iobuffers_pages[iobuffers_page_index(*link)].in_use) {
+                *link = (*link)->next;
+                cls->stats.free--;
+            } else {
+                link = &((*link)->next);
+            }
+        }
+
+        // and return the pages themselves
+        for (uint32_t i = 0; i < number_io_buffers; i++) {
+            if ((iobuffers_pages[i].class == c) && (0 == iobuffers_pages[i].in_use)) {
+                iobuffers_pages[i].class = IOBUFFERS_CLASS_NONE;
+                iobuffers_mark_pages_free(i, 1);
+                cls->stats.pages--;
+                released++;
+            }
+        }
+    }
+    return released;
+}
+
+/*
+ * carve a fresh page into buffers for a size class
+ */
+bool iobuffers_grow_class(uint8_t c) {
+    struct iobuffers_class* cls = &(iobuffers_classes[c]);
+
+    uint64_t page = iobuffers_take_pages(1);
+    if ((BITMAP_NOT_FOUND == page) && (iobuffers_trim_classes() > 0)) {
+        page = iobuffers_take_pages(1);
+    }
+    if (BITMAP_NOT_FOUND == page) {
+        return false;
+    }
+    iobuffers_pages[page].class = c;
+    iobuffers_pages[page].in_use = 0;
+    cls->stats.pages++;
+
+    uint8_t* base = (uint8_t*)iobuffers_address(page);
+    for (uint32_t offset = 0; offset < IOBUFFERS_BUFFER_SIZE; offset += cls->size) {
+        struct iobuffers_chunk* chunk = (struct iobuffers_chunk*)(base + offset);
+        chunk->next = cls->free_list;
+        cls->free_list = chunk;
+        cls->stats.free++;
+    }
+    return true;
+}
+
+void* iobuffers_request_class(uint8_t c) {
+    struct iobuffers_class* cls = &(iobuffers_classes[c]);
+
+    if (0 != cls->free_list) {
+        cls->stats.recycled++;
+    } else if (!iobuffers_grow_class(c)) {
+        return 0;
+    }
+    struct iobuffers_chunk* chunk = cls->free_list;
+    cls->free_list = chunk->next;
+    cls->stats.free--;
+    cls->stats.in_use++;
+    iobuffers_pages[iobuffers_page_index(chunk)].in_use++;
+    return (void*)chunk;
+}
+
+void* iobuffers_request_pages(uint32_t size) {
+    uint32_t page_count = iobuffers_calc_num_pages(size);
+    //   kprintf("   iobuffers_request_buffer for size %llu requires %llu pages of size %#hX \n", size, page_count, IOBUFFERS_BUFFER_SIZE);
+
+    uint64_t i = iobuffers_take_pages(page_count);
+    if ((BITMAP_NOT_FOUND == i) && (iobuffers_trim_classes() > 0)) {
+        i = iobuffers_take_pages(page_count);
+    }
+    if (BITMAP_NOT_FOUND == i) {
+        return 0;
+    }
+    iobuffers_pages[i].run = page_count;
+
+    //    kprintf("   iobuffers_request_buffer found free pages at index %llu, address %#hX-%#hX for base address %#hX\n", i, iobuffers_address(i), iobuffers_buffer_end_adddress(i, page_count), io_buf);
+    return iobuffers_address(i);
+}
+
 void* iobuffers_request_buffer(uint32_t size) {
     ASSERT_NOT_NULL(size);
     ASSERT_NOT_NULL(map);
-    ASSERT_NOT_NULL(buffer_list);
 
-    uint32_t page_count = iobuffers_calc_num_pages(size);
-    //   kprintf("   iobuffers_request_buffer for size %llu requires %llu pages of size %#hX \n", size, page_count, IOBUFFERS_BUFFER_SIZE);
+    spinlock_acquire(&iobuffers_lock);
 
-    for (uint32_t i = 0; i < (number_io_buffers - page_count); i++) {
-        if (iobuffers_is_free_pages(i, page_count)) {
-            // mark used
-            iobuffers_mark_pages_used(i, page_count);
-            // add a buffer record
-            struct iobuffers_buffer* b = (struct iobuffers_buffer*)kmalloc(sizeof(struct iobuffers_buffer));
-            b->start_page = i;
-            b->num_pages = page_count;
-            b->address = iobuffers_address(i);
-            arraylist_add(buffer_list, b);
-
-            //    kprintf("   iobuffers_request_buffer found free pages at index %llu, address %#hX-%#hX for base address %#hX\n", i, b->address, iobuffers_buffer_end_adddress(b->start_page, b->num_pages), io_buf);
-            return b->address;
-        }
+    void* ret;
+    uint8_t c = iobuffers_size_class(size);
+    if (IOBUFFERS_CLASS_NONE != c) {
+        ret = iobuffers_request_class(c);
+    } else {
+        ret = iobuffers_request_pages(size);
     }
-    return 0;
+    iobuffers_requests++;
+    if (0 == ret) {
+        iobuffers_failures++;
+    }
+
+    spinlock_release(&iobuffers_lock);
+    return ret;
 }
 
 void iobuffers_release_buffer(void* buffer) {
     ASSERT_NOT_NULL(buffer);
     ASSERT_NOT_NULL(map);
-    ASSERT_NOT_NULL(buffer_list);
-    /*
-     * find the buffer
-     */
-    for (uint32_t i = 0; i < arraylist_count(buffer_list); i++) {
-        struct iobuffers_buffer* buffer_record = (struct iobuffers_buffer*)arraylist_get(buffer_list, i);
-        ASSERT_NOT_NULL(buffer_record);
-        if (buffer_record->address == buffer) {
-            // mark free
-            iobuffers_mark_pages_free(buffer_record->start_page, buffer_record->num_pages);
-            // remove record
-            arraylist_remove(buffer_list, i);
-            kfree(buffer_record);
-            return;
+
+    spinlock_acquire(&iobuffers_lock);
+
+    uint32_t page = iobuffers_page_index(buffer);
+    struct iobuffers_page* record = &(iobuffers_pages[page]);
+    if (IOBUFFERS_CLASS_NONE != record->class) {
+        struct iobuffers_class* cls = &(iobuffers_classes[record->class]);
+        ASSERT(0 == (((uint64_t)buffer - io_buf) % cls->size));
+        ASSERT_NOT_NULL(record->in_use);
+
+        // back on the free list, ready for the next request of this size
+        struct iobuffers_chunk* chunk = (struct iobuffers_chunk*)buffer;
+        chunk->next = cls->free_list;
+        cls->free_list = chunk;
+        cls->stats.free++;
+        cls->stats.in_use--;
+        record->in_use--;
+    } else {
+        if ((buffer != iobuffers_address(page)) || (0 == record->run)) {
+            PANIC("unable to find record of io buffer");
         }
+        iobuffers_mark_pages_free(page, record->run);
+        record->run = 0;
     }
-    PANIC("unable to find record of io buffer");
+    iobuffers_releases++;
+
+    spinlock_release(&iobuffers_lock);
+}
+
+/*
+ * the address to program into a device for a buffer from iobuffers_request_buffer
+ */
+uint64_t iobuffers_phys_address(void* buffer) {
+    ASSERT(((uint64_t)buffer >= io_buf) && ((uint64_t)buffer < (io_buf + io_buf_bytes)));
+    return io_buf_phys + ((uint64_t)buffer - io_buf);
+}
+
+/*
+ * and back again, for addresses a device hands us
+ */
+void* iobuffers_virt_address(uint64_t phys) {
+    ASSERT((phys >= io_buf_phys) && (phys < (io_buf_phys + io_buf_bytes)));
+    return (void*)(io_buf + (phys - io_buf_phys));
 }
 
 uint32_t iobuffers_total_pages() {
@@ -177,11 +358,25 @@ uint32_t iobuffers_total_pages() {
 }
 
 uint32_t iobuffers_used_pages() {
-    uint32_t ret = 0;
-    for (uint32_t i = 0; i < arraylist_count(buffer_list); i++) {
-        struct iobuffers_buffer* buffer_record = (struct iobuffers_buffer*)arraylist_get(buffer_list, i);
-        ASSERT_NOT_NULL(buffer_record);
-        ret += buffer_record->num_pages;
+    ASSERT_NOT_NULL(map);
+    return bitmap_count_set(map);
+}
+
+void iobuffers_get_stats(struct iobuffers_stats* stats) {
+    ASSERT_NOT_NULL(stats);
+    ASSERT_NOT_NULL(map);
+
+    spinlock_acquire(&iobuffers_lock);
+
+    stats->total_pages = number_io_buffers;
+    stats->used_pages = bitmap_count_set(map);
+    stats->requests = iobuffers_requests;
+    stats->releases = iobuffers_releases;
+    stats->failures = iobuffers_failures;
+    for (uint8_t c = 0; c < IOBUFFERS_CLASS_COUNT; c++) {
+        memcpy((uint8_t*)&(stats->classes[c]), (uint8_t*)&(iobuffers_classes[c].stats),
+               sizeof(struct iobuffers_class_stats));
     }
-    return ret;
-}
\ No newline at end of file
+
+    spinlock_release(&iobuffers_lock);
+}
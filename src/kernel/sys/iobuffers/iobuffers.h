@@ -16,14 +16,43 @@
 // IO_SPACE_SIZE is defined in mm.h
 #define IOBUFFERS_NUMBER (IO_SPACE_SIZE / IOBUFFERS_BUFFER_SIZE)
 
+/*
+ * small requests are rounded up to one of these size classes, and carved out of 16k pages.
+ * a buffer from a size class is aligned on its class size.
+ */
+#define IOBUFFERS_CLASS_SECTOR 0  // 512 bytes; disk sectors, PRDTs
+#define IOBUFFERS_CLASS_PACKET 1  // 2k; an ethernet frame plus headers
+#define IOBUFFERS_CLASS_PAGE 2    // 4k; virtqueues and other page-aligned structures
+#define IOBUFFERS_CLASS_COUNT 3
+
+struct iobuffers_class_stats {
+    uint32_t size;      // bytes per buffer
+    uint32_t pages;     // 16k pages owned by the class
+    uint32_t in_use;    // buffers handed out
+    uint32_t free;      // buffers on the free list
+    uint64_t recycled;  // requests satisfied from the free list
+};
+
+struct iobuffers_stats {
+    uint32_t total_pages;
+    uint32_t used_pages;  // pages owned by size classes or handed out as runs
+    uint64_t requests;
+    uint64_t releases;
+    uint64_t failures;
+    struct iobuffers_class_stats classes[IOBUFFERS_CLASS_COUNT];
+};
+
 void iobuffers_init();
 void* iobuffers_request_buffer(uint32_t size);
 void iobuffers_release_buffer(void* buffer);
+uint64_t iobuffers_phys_address(void* buffer);
+void* iobuffers_virt_address(uint64_t phys);
 uint32_t iobuffers_total_pages();
 uint32_t iobuffers_used_pages();
+void iobuffers_get_stats(struct iobuffers_stats* stats);
 
 // this set up by mm
 extern uint64_t io_buf;
 extern uint64_t io_buf_bytes;
 
-#endif
\ No newline at end of file
+#endif
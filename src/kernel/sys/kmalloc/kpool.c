@@ -0,0 +1,150 @@
+/*****************************************************************
+ * This file is part of CosmOS                                   *
+ * Copyright (C) 2021 Kurt M. Weber                              *
+ * Released under the stated terms in the file LICENSE           *
+ * See the file "LICENSE" in the source distribution for details *
+ *****************************************************************/
+
+#include <sys/debug/assert.h>
+#include <sys/kmalloc/kmalloc.h>
+#include <sys/kmalloc/kpool.h>
+#include <sys/panic/panic.h>
+#include <sys/sync/sync.h>
+#include <types.h>
+
+uint64_t kpool_slot_size(kpool* pool);
+void kpool_grow(kpool* pool);
+
+uint64_t kpool_slot_size(kpool* pool) {
+    // Objects must be big enough to hold a free-list link, and stay aligned like kmalloc()'s
+    uint64_t size;
+
+    size = (pool->obj_size < sizeof(kpool_free_obj)) ? sizeof(kpool_free_obj) : pool->obj_size;
+
+    if (size % KMALLOC_ALIGN_BYTES) {
+        size += (KMALLOC_ALIGN_BYTES - (size % KMALLOC_ALIGN_BYTES));
+    }
+
+    return size;
+}
+
+void kpool_grow(kpool* pool) {
+    /*
+     * Adds one slab's worth of objects to the free list.  Caller must not
+     * hold pool->lock: kmalloc() takes locks of its own, so the slab is
+     * allocated and carved up first, and the lock is only taken to link it
+     * in.  Slabs are never given back; a pool only ever grows to its
+     * high-water mark, which for the structures we use pools for is small.
+     */
+    kpool_slab* slab;
+    kpool_free_obj *obj, *first, *last;
+    uint64_t slot_size, count, i;
+
+    slot_size = kpool_slot_size(pool);
+    count = (KPOOL_SLAB_SIZE - sizeof(kpool_slab)) / slot_size;
+
+    // Objects too big to share a slab get one each
+    if (!count) {
+        count = 1;
+    }
+
+    slab = kmalloc(sizeof(kpool_slab) + (count * slot_size));
+    if (!slab) {
+        PANIC("Unable to grow object pool");
+    }
+
+    /*
+     * Chain the objects in address order, so consecutive allocations sit
+     * next to each other.
+     */
+    first = (kpool_free_obj*)((uint8_t*)slab + sizeof(kpool_slab));
+    last = first;
+    for (i = 1; i < count; i++) {
+        obj = (kpool_free_obj*)((uint8_t*)first + (i * slot_size));
+        last->next = obj;
+        last = obj;
+    }
+
+    spinlock_acquire(&pool->lock);
+
+    slab->next = pool->slabs;
+    pool->slabs = slab;
+    pool->stats.slabs++;
+
+    last->next = pool->free_list;
+    pool->free_list = first;
+
+    spinlock_release(&pool->lock);
+
+    return;
+}
+
+void* kpool_alloc(kpool* pool) {
+    kpool_free_obj* obj;
+
+    ASSERT_NOT_NULL(pool);
+    ASSERT_NOT_NULL(pool->obj_size);
+
+    spinlock_acquire(&pool->lock);
+
+    /*
+     * Grow without the lock held.  Someone else may take the new objects
+     * before we get the lock back, so check again.
+     */
+    while (!pool->free_list) {
+        spinlock_release(&pool->lock);
+        kpool_grow(pool);
+        spinlock_acquire(&pool->lock);
+    }
+
+    obj = pool->free_list;
+    pool->free_list = obj->next;
+
+    pool->stats.allocs++;
+    pool->stats.in_use++;
+    if (pool->stats.in_use > pool->stats.peak) {
+        pool->stats.peak = pool->stats.in_use;
+    }
+
+    spinlock_release(&pool->lock);
+
+    if (pool->ctor) {
+        pool->ctor((void*)obj);
+    }
+
+    return (void*)obj;
+}
+
+void kpool_free(kpool* pool, void* obj) {
+    kpool_free_obj* f;
+
+    ASSERT_NOT_NULL(pool);
+    ASSERT_NOT_NULL(obj);
+
+    f = (kpool_free_obj*)obj;
+
+    spinlock_acquire(&pool->lock);
+
+    ASSERT(pool->stats.in_use > 0);
+
+    f->next = pool->free_list;
+    pool->free_list = f;
+
+    pool->stats.frees++;
+    pool->stats.in_use--;
+
+    spinlock_release(&pool->lock);
+
+    return;
+}
+
+void kpool_get_stats(kpool* pool, kpool_stats* stats) {
+    ASSERT_NOT_NULL(pool);
+    ASSERT_NOT_NULL(stats);
+
+    spinlock_acquire(&pool->lock);
+    *stats = pool->stats;
+    spinlock_release(&pool->lock);
+
+    return;
+}
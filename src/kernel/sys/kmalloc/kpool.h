@@ -0,0 +1,70 @@
+/*****************************************************************
+ * This file is part of CosmOS                                   *
+ * Copyright (C) 2021 Kurt M. Weber                              *
+ * Released under the stated terms in the file LICENSE           *
+ * See the file "LICENSE" in the source distribution for details *
+ *****************************************************************/
+
+#ifndef _KPOOL_H
+#define _KPOOL_H
+
+#include <sys/sync/sync.h>
+#include <types.h>
+
+// Each slab is carved up into as many objects as will fit
+#define KPOOL_SLAB_SIZE 4096
+
+// Run on every object kpool_alloc() hands out, before it's returned
+typedef void (*kpool_ctor)(void* obj);
+
+/*
+ * A free object holds the pointer to the next free object in its first eight
+ * bytes, so the free list costs nothing beyond the objects themselves.
+ */
+typedef struct kpool_free_obj {
+    struct kpool_free_obj* next;
+} kpool_free_obj;
+
+// Each slab begins with one of these, linking it to the pool's other slabs
+typedef struct kpool_slab {
+    struct kpool_slab* next;
+} kpool_slab;
+
+typedef struct kpool_stats {
+    uint64_t allocs;  // total kpool_alloc() calls
+    uint64_t frees;   // total kpool_free() calls
+    uint64_t in_use;  // objects currently handed out
+    uint64_t peak;    // high-water mark of in_use
+    uint64_t slabs;   // slabs the pool has grown to
+} kpool_stats;
+
+typedef struct kpool {
+    const char* name;
+    uint64_t obj_size;
+    kpool_ctor ctor;
+    kpool_free_obj* free_list;
+    kpool_slab* slabs;
+    kpool_stats stats;
+    kernel_spinlock lock;
+} kpool;
+
+/*
+ * Static initializer for a pool of objects of type t, e.g.
+ *
+ *     kpool foo_pool = KPOOL_INIT("foo", struct foo, NULL);
+ *
+ * The pool takes its first slab the first time it's allocated from, so it
+ * needs no further setup.
+ */
+#define KPOOL_INIT(n, t, c)                                                                  \
+    {                                                                                        \
+        .name = n, .obj_size = sizeof(t), .ctor = c, .free_list = NULL, .slabs = NULL,       \
+        .stats = {.allocs = 0, .frees = 0, .in_use = 0, .peak = 0, .slabs = 0}, .lock = false \
+    }
+
+// kpool.c
+void* kpool_alloc(kpool* pool);
+void kpool_free(kpool* pool, void* obj);
+void kpool_get_stats(kpool* pool, kpool_stats* stats);
+
+#endif
@@ -0,0 +1,191 @@
+//*****************************************************************
+// This file is part of CosmOS                                    *
+// Copyright (C) 2021 Tom Everett                                 *
+// Released under the stated terms in the file LICENSE            *
+// See the file "LICENSE" in the source distribution for details  *
+// ****************************************************************
+
+#include <sys/debug/assert.h>
+#include <sys/iobuffers/iobuffers.h>
+#include <sys/kmalloc/kpool.h>
+#include <sys/netbuf/netbuf.h>
+#include <sys/string/mem.h>
+
+kpool netbuf_pool = KPOOL_INIT("netbuf", struct netbuf, NULL);
+
+/*
+ * an empty buffer, with headroom bytes reserved in front of the data. 0 if the iobuffers have run out, which a burst
+ * of traffic can do; the caller drops whatever it was for
+ */
+struct netbuf* netbuf_new(uint16_t headroom) {
+    ASSERT(headroom <= NETBUF_SIZE);
+    struct netbuf* nb = (struct netbuf*)kpool_alloc(&netbuf_pool);
+    ASSERT_NOT_NULL(nb);
+    nb->head = (uint8_t*)iobuffers_request_buffer(NETBUF_SIZE);
+    if (0 == nb->head) {
+        kpool_free(&netbuf_pool, nb);
+        return 0;
+    }
+    nb->next = 0;
+    nb->chain = 0;
+    nb->data = nb->head + headroom;
+    nb->len = 0;
+    nb->refcount = 1;
+    nb->csum = NETBUF_CSUM_NONE;
+    nb->csum_start = 0;
+    nb->csum_offset = 0;
+    return nb;
+}
+
+struct netbuf* netbuf_retain(struct netbuf* nb) {
+    ASSERT_NOT_NULL(nb);
+    ASSERT(nb->refcount > 0);
+    nb->refcount++;
+    return nb;
+}
+
+/*
+ * drop a reference. the last one frees the buffer, and its reference on the rest of the chain
+ */
+void netbuf_release(struct netbuf* nb) {
+    while (0 != nb) {
+        ASSERT(nb->refcount > 0);
+        if (--nb->refcount > 0) {
+            return;
+        }
+        struct netbuf* chain = nb->chain;
+        iobuffers_release_buffer(nb->head);
+        kpool_free(&netbuf_pool, nb);
+        nb = chain;
+    }
+}
+
+uint16_t netbuf_headroom(struct netbuf* nb) {
+    ASSERT_NOT_NULL(nb);
+    return nb->data - nb->head;
+}
+
+uint16_t netbuf_tailroom(struct netbuf* nb) {
+    ASSERT_NOT_NULL(nb);
+    return NETBUF_SIZE - netbuf_headroom(nb) - nb->len;
+}
+
+/*
+ * make room for len bytes in front of the data, for a header on the way down
+ */
+uint8_t* netbuf_push(struct netbuf* nb, uint16_t len) {
+    ASSERT(netbuf_headroom(nb) >= len);
+    nb->data -= len;
+    nb->len += len;
+    return nb->data;
+}
+
+/*
+ * take len bytes off the front, for a header on the way up. returns the new start of the data
+ */
+uint8_t* netbuf_pull(struct netbuf* nb, uint16_t len) {
+    ASSERT_NOT_NULL(nb);
+    ASSERT(nb->len >= len);
+    nb->data += len;
+    nb->len -= len;
+    return nb->data;
+}
+
+/*
+ * make room for len bytes after the data. returns where they go
+ */
+uint8_t* netbuf_put(struct netbuf* nb, uint16_t len) {
+    ASSERT(netbuf_tailroom(nb) >= len);
+    uint8_t* ret = nb->data + nb->len;
+    nb->len += len;
+    return ret;
+}
+
+/*
+ * cut the packet down to len bytes, freeing any segments past the end
+ */
+void netbuf_trim(struct netbuf* nb, uint16_t len) {
+    ASSERT_NOT_NULL(nb);
+    while (0 != nb) {
+        if (nb->len >= len) {
+            nb->len = len;
+            netbuf_release(nb->chain);
+            nb->chain = 0;
+            return;
+        }
+        len -= nb->len;
+        nb = nb->chain;
+    }
+}
+
+/*
+ * add segment to the end of the chain. the chain takes over the caller's reference
+ */
+void netbuf_append(struct netbuf* nb, struct netbuf* segment) {
+    ASSERT_NOT_NULL(nb);
+    ASSERT_NOT_NULL(segment);
+    while (0 != nb->chain) {
+        nb = nb->chain;
+    }
+    nb->chain = segment;
+}
+
+/*
+ * bytes in the whole chain
+ */
+uint16_t netbuf_length(struct netbuf* nb) {
+    uint16_t ret = 0;
+    while (0 != nb) {
+        ret += nb->len;
+        nb = nb->chain;
+    }
+    return ret;
+}
+
+/*
+ * copy up to len bytes, starting offset bytes into the chain. returns the number copied
+ */
+uint16_t netbuf_copy_out(struct netbuf* nb, uint16_t offset, uint8_t* data, uint16_t len) {
+    ASSERT_NOT_NULL(data);
+    uint16_t ret = 0;
+    while ((0 != nb) && (ret < len)) {
+        if (offset >= nb->len) {
+            offset -= nb->len;
+        } else {
+            uint16_t n = nb->len - offset;
+            if (n > (len - ret)) {
+                n = len - ret;
+            }
+            memcpy(data + ret, nb->data + offset, n);
+            ret += n;
+            offset = 0;
+        }
+        nb = nb->chain;
+    }
+    return ret;
+}
+
+/*
+ * a chain as one segment, with the default headroom. takes the caller's reference; a buffer that is already one
+ * segment is returned as is
+ */
+struct netbuf* netbuf_linearize(struct netbuf* nb) {
+    ASSERT_NOT_NULL(nb);
+    if (0 == nb->chain) {
+        return nb;
+    }
+    uint16_t len = netbuf_length(nb);
+    ASSERT(len <= (NETBUF_SIZE - NETBUF_HEADROOM));
+    struct netbuf* ret = netbuf_new(NETBUF_HEADROOM);
+    if (0 == ret) {
+        netbuf_release(nb);
+        return 0;
+    }
+    netbuf_copy_out(nb, 0, netbuf_put(ret, len), len);
+    // a checksum still to be done moves with the data
+    ret->csum = nb->csum;
+    ret->csum_start = nb->csum_start - netbuf_headroom(nb) + NETBUF_HEADROOM;
+    ret->csum_offset = nb->csum_offset;
+    netbuf_release(nb);
+    return ret;
+}
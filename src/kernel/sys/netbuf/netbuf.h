@@ -0,0 +1,59 @@
+//*****************************************************************
+// This file is part of CosmOS                                    *
+// Copyright (C) 2021 Tom Everett                                 *
+// Released under the stated terms in the file LICENSE            *
+// See the file "LICENSE" in the source distribution for details  *
+// ****************************************************************
+/*
+ * a network buffer holds one packet, or a segment of one, as it moves through the network stack.  the storage is
+ * an iobuffer, so a NIC can DMA straight to and from it.  space is left in front of the data, so each layer on
+ * the way down can push its header on without copying the packet, and each layer on the way up pulls its own off.
+ */
+#ifndef _NETBUF_H
+#define _NETBUF_H
+
+#include <types.h>
+
+#define NETBUF_SIZE 2048  // one IOBUFFERS_CLASS_PACKET buffer
+
+/*
+ * enough headroom for every header down the stack: virtio-net, ethernet, IP and TCP with options
+ */
+#define NETBUF_HEADROOM 128
+
+/*
+ * the state of the UDP or TCP checksum
+ */
+#define NETBUF_CSUM_NONE 0     // nothing is known; software checks it on the way up
+#define NETBUF_CSUM_PARTIAL 1  // the checksum field holds the pseudo header sum; see ip_checksum_partial
+#define NETBUF_CSUM_VALID 2    // the NIC checked it
+
+struct netbuf {
+    struct netbuf* next;   // the next packet, for whoever has this one queued
+    struct netbuf* chain;  // the next segment of this packet; this segment holds a reference to it
+    uint8_t* head;         // start of the storage
+    uint8_t* data;         // first byte of the packet in this segment
+    uint16_t len;          // bytes from data
+    uint16_t refcount;
+    uint8_t csum;          // NETBUF_CSUM_*
+    uint16_t csum_start;   // NETBUF_CSUM_PARTIAL: the sum covers from here, counted from head, to the end
+    uint16_t csum_offset;  // and is stored this far past csum_start
+};
+
+struct netbuf* netbuf_new(uint16_t headroom);
+struct netbuf* netbuf_retain(struct netbuf* nb);
+void netbuf_release(struct netbuf* nb);
+
+uint16_t netbuf_headroom(struct netbuf* nb);
+uint16_t netbuf_tailroom(struct netbuf* nb);
+uint8_t* netbuf_push(struct netbuf* nb, uint16_t len);
+uint8_t* netbuf_pull(struct netbuf* nb, uint16_t len);
+uint8_t* netbuf_put(struct netbuf* nb, uint16_t len);
+void netbuf_trim(struct netbuf* nb, uint16_t len);
+
+void netbuf_append(struct netbuf* nb, struct netbuf* segment);
+uint16_t netbuf_length(struct netbuf* nb);
+uint16_t netbuf_copy_out(struct netbuf* nb, uint16_t offset, uint8_t* data, uint16_t len);
+struct netbuf* netbuf_linearize(struct netbuf* nb);
+
+#endif
@@ -0,0 +1,151 @@
+//*****************************************************************
+// This file is part of CosmOS                                    *
+// Copyright (C) 2021 Tom Everett                                 *
+// Released under the stated terms in the file LICENSE            *
+// See the file "LICENSE" in the source distribution for details  *
+// ****************************************************************
+
+#include <sys/debug/assert.h>
+#include <sys/netpoll/netpoll.h>
+#include <sys/obj/object/object.h>
+#include <sys/obj/objectinterface/objectinterface_nic.h>
+#include <sys/obj/objectinterface/objectinterface_tick.h>
+#include <sys/string/mem.h>
+#include <types.h>
+
+/*
+ * the list only changes as NICs come and go. the interrupt handlers only set scheduled, so they and netpoll_run
+ * don't need a lock between them
+ */
+struct netpoll* netpoll_list = 0;
+
+/*
+ * netpoll_run only runs in thread context. a poll goes all the way up the stack, which allocates and takes locks
+ * the interrupted thread may hold. the tick only marks a run due
+ */
+bool netpoll_pending = false;
+
+// netpoll_run doesn't nest
+bool netpoll_running = false;
+
+void netpoll_register(struct netpoll* np, struct object* nic) {
+    ASSERT_NOT_NULL(np);
+    ASSERT_NOT_NULL(nic);
+    struct objectinterface_nic* api = (struct objectinterface_nic*)nic->api;
+    ASSERT_NOT_NULL(api->poll);
+    ASSERT_NOT_NULL(api->interrupts);
+    np->nic = nic;
+    np->scheduled = false;
+    memzero((uint8_t*)&(np->stats), sizeof(struct nic_stats));
+    np->next = netpoll_list;
+    netpoll_list = np;
+}
+
+void netpoll_unregister(struct netpoll* np) {
+    ASSERT_NOT_NULL(np);
+    struct netpoll** p = &netpoll_list;
+    while (0 != *p) {
+        if (*p == np) {
+            *p = np->next;
+            np->next = 0;
+            return;
+        }
+        p = &((*p)->next);
+    }
+}
+
+/*
+ * called from the NIC's interrupt handler when it has received something: no more receive interrupts until the
+ * poll list has drained it
+ */
+void netpoll_interrupt(struct netpoll* np) {
+    ASSERT_NOT_NULL(np);
+    np->stats.interrupts++;
+    if (np->scheduled) {
+        return;
+    }
+    struct objectinterface_nic* api = (struct objectinterface_nic*)np->nic->api;
+    (*api->interrupts)(np->nic, false);
+    __atomic_store_n(&(np->scheduled), true, __ATOMIC_RELEASE);
+}
+
+/*
+ * give one NIC its turn. returns true if it is still on the poll list
+ */
+bool netpoll_poll(struct netpoll* np) {
+    struct objectinterface_nic* api = (struct objectinterface_nic*)np->nic->api;
+    uint16_t done = (*api->poll)(np->nic, NETPOLL_BUDGET);
+    np->stats.polls++;
+    np->stats.packets += done;
+    if (done >= NETPOLL_BUDGET) {
+        np->stats.exhausted++;
+        return true;
+    }
+    // drained. off the list before the interrupt is on, so an interrupt straight after puts it back
+    __atomic_store_n(&(np->scheduled), false, __ATOMIC_RELEASE);
+    if ((*api->interrupts)(np->nic, true)) {
+        // frames came in after the poll, and the NIC won't interrupt for them
+        (*api->interrupts)(np->nic, false);
+        __atomic_store_n(&(np->scheduled), true, __ATOMIC_RELEASE);
+        return true;
+    }
+    return false;
+}
+
+/*
+ * poll every NIC on the poll list, round robin, for up to NETPOLL_PASSES turns each. anything left waits for the
+ * next run. thread context only; called from the idle loop and from sleep_wait
+ */
+void netpoll_run() {
+    if (__atomic_exchange_n(&netpoll_running, true, __ATOMIC_ACQUIRE)) {
+        return;
+    }
+    __atomic_store_n(&netpoll_pending, false, __ATOMIC_RELEASE);
+    for (uint16_t pass = 0; pass < NETPOLL_PASSES; pass++) {
+        bool more = false;
+        for (struct netpoll* np = netpoll_list; 0 != np; np = np->next) {
+            if (__atomic_load_n(&(np->scheduled), __ATOMIC_ACQUIRE)) {
+                more |= netpoll_poll(np);
+            }
+        }
+        if (!more) {
+            break;
+        }
+    }
+    __atomic_store_n(&netpoll_running, false, __ATOMIC_RELEASE);
+}
+
+void netpoll_stats(struct netpoll* np, struct nic_stats* stats) {
+    ASSERT_NOT_NULL(np);
+    ASSERT_NOT_NULL(stats);
+    memcpy((uint8_t*)stats, (uint8_t*)&(np->stats), sizeof(struct nic_stats));
+}
+
+/*
+ * true if a NIC is on the poll list, or the tick has come round since the last run
+ */
+bool netpoll_due() {
+    if (__atomic_load_n(&netpoll_pending, __ATOMIC_ACQUIRE)) {
+        return true;
+    }
+    for (struct netpoll* np = netpoll_list; 0 != np; np = np->next) {
+        if (__atomic_load_n(&(np->scheduled), __ATOMIC_ACQUIRE)) {
+            return true;
+        }
+    }
+    return false;
+}
+
+void netpoll_tick_event(struct object* subscriber, uint64_t tick) {
+    __atomic_store_n(&netpoll_pending, true, __ATOMIC_RELEASE);
+}
+
+/*
+ * the idle loop runs the poll list whenever an interrupt wakes it. the tick marks a run due, so a thread waiting in
+ * sleep_wait runs it at least once a tick
+ */
+void netpoll_attach_tick(struct object* tick) {
+    ASSERT_NOT_NULL(tick);
+    struct objectinterface_tick* tick_api = (struct objectinterface_tick*)tick->api;
+    (*tick_api->subscribe)(tick, 0, &netpoll_tick_event);
+}
@@ -0,0 +1,40 @@
+//*****************************************************************
+// This file is part of CosmOS                                    *
+// Copyright (C) 2021 Tom Everett                                 *
+// Released under the stated terms in the file LICENSE            *
+// See the file "LICENSE" in the source distribution for details  *
+// ****************************************************************
+/*
+ * polled receive for NICs, after Linux's NAPI.  a NIC's first receive interrupt turns its receive interrupt off and
+ * puts it on the poll list; from then on, netpoll_run takes up to NETPOLL_BUDGET frames at a time from it, round
+ * robin with any other NICs on the list, until it has none left and its interrupt goes back on.  under load, there
+ * is one interrupt per burst, not per frame, and the rest of the kernel still gets a look in between polls.
+ *
+ * a NIC that uses this implements poll and interrupts in objectinterface_nic, keeps a struct netpoll in its
+ * object data, and calls netpoll_interrupt from its interrupt handler instead of receiving there.
+ */
+#ifndef _NETPOLL_H
+#define _NETPOLL_H
+
+#include <sys/obj/objectinterface/objectinterface_nic.h>
+#include <types.h>
+
+#define NETPOLL_BUDGET 64  // frames from one NIC before the next gets a turn
+#define NETPOLL_PASSES 4   // turns each NIC gets in one netpoll_run
+
+struct netpoll {
+    struct netpoll* next;  // all the registered NICs
+    struct object* nic;
+    bool scheduled;  // on the poll list, with its receive interrupt off
+    struct nic_stats stats;
+};
+
+void netpoll_register(struct netpoll* np, struct object* nic);
+void netpoll_unregister(struct netpoll* np);
+void netpoll_interrupt(struct netpoll* np);
+void netpoll_run();
+bool netpoll_due();
+void netpoll_stats(struct netpoll* np, struct nic_stats* stats);
+void netpoll_attach_tick(struct object* tick);
+
+#endif
@@ -10,6 +10,7 @@
 #ifndef _OBJECTTYPE_ARP_H
 #define _OBJECTTYPE_ARP_H
 
+#include <sys/netbuf/netbuf.h>
 #include <sys/obj/objectmgr/objectmgr.h>
 
 #include <types.h>
@@ -23,6 +24,7 @@
 #define RARP_REQUEST 0x0003
 #define RARP_REPLY 0x0004
 
+// an ARP packet as it is on the wire; multi-byte fields are in network byte order
 struct arp {
     uint16_t htype;                     // Hardware type
     uint16_t ptype;                     // Protocol type
@@ -33,12 +35,22 @@ struct arp {
     uint8_t source_protocol[ARP_PLEN];  // Source protocol address
     uint8_t dest_hardware[ARP_HLEN];    // Destination hardware address
     uint8_t dest_protocol[ARP_PLEN];    // Destination protocol address
-};
+} __attribute__((packed));
 
-typedef void (*arp_request_function)(struct object* obj, struct arp* request, struct arp* response);
+/*
+ * IPv4 addresses are passed in host byte order
+ */
+// set the protocol address we answer requests for
+typedef void (*arp_set_address_function)(struct object* obj, uint32_t ip);
+// look up ip in the cache. returns 1 and fills in hw if it's resolved
+typedef uint8_t (*arp_resolve_function)(struct object* obj, uint32_t ip, uint8_t* hw);
+// send a frame of EtherType type to ip; if ip isn't resolved yet, the frame waits while we ask. takes the reference
+typedef void (*arp_output_function)(struct object* obj, uint32_t ip, uint16_t type, struct netbuf* frame);
 
 struct objectinterface_arp {
-    arp_request_function request;
+    arp_set_address_function set_address;
+    arp_resolve_function resolve;
+    arp_output_function output;
 };
 
-#endif
\ No newline at end of file
+#endif
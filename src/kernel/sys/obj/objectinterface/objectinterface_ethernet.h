@@ -10,25 +10,43 @@
 #ifndef _OBJECTTYPE_ETHERNET_H
 #define _OBJECTTYPE_ETHERNET_H
 
+#include <sys/netbuf/netbuf.h>
 #include <sys/obj/objectmgr/objectmgr.h>
 
 #include <types.h>
 
 #define ETHERNET_HW_LEN 6
+#define ETHERNET_HEADER_LEN 14
+#define ETHERNET_MTU 1500
 
+// EtherTypes, host byte order
+#define ETHERNET_TYPE_IP 0x0800
+#define ETHERNET_TYPE_ARP 0x0806
+
+// the header as it is on the wire. type is in network byte order
 struct eth_hdr {
     uint8_t dest_hw[ETHERNET_HW_LEN];
     uint8_t source_hw[ETHERNET_HW_LEN];
     uint16_t type;
-    uint8_t* data;
-};
+} __attribute__((packed));
+
+/*
+ * called for each received frame of a registered EtherType. the header has been pulled off payload, which is
+ * lent for the call
+ */
+typedef void (*ethernet_input_function)(struct object* protocol, struct eth_hdr* eth, struct netbuf* payload);
 
-typedef void (*ethernet_read_function)(struct object* obj, struct eth_hdr* eth, uint16_t size);
-typedef void (*ethernet_write_function)(struct object* obj, struct eth_hdr* eth, uint16_t size);
+// pushes the header onto payload and takes the caller's reference
+typedef void (*ethernet_write_function)(struct object* obj, uint8_t* dest_hw, uint16_t type,
+                                        struct netbuf* payload);
+typedef void (*ethernet_register_function)(struct object* obj, uint16_t type, struct object* protocol,
+                                           ethernet_input_function input);
+typedef void (*ethernet_hw_address_function)(struct object* obj, uint8_t* hw_address);
 
 struct objectinterface_ethernet {
-    ethernet_read_function read;
     ethernet_write_function write;
+    ethernet_register_function register_protocol;
+    ethernet_hw_address_function hw_address;
 };
 
-#endif
\ No newline at end of file
+#endif
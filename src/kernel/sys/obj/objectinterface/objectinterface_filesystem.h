@@ -62,13 +62,16 @@ struct filesystem_directory {
 typedef struct filesystem_node* (*filesystem_get_root_node_function)(struct object* filesystem_obj);
 
 /*
-* read bytes from node
+* read up to data_size bytes from node, starting offset bytes into it.  returns the bytes read, which is less than
+* data_size at the end of the node and 0 past it.  a caller can stream a large node a buffer at a time
 */
-typedef uint32_t (*filesystem_read_function)(struct filesystem_node* fs_node, uint8_t* data, uint32_t data_size);
+typedef uint32_t (*filesystem_read_function)(struct filesystem_node* fs_node, uint64_t offset, uint8_t* data,
+                                             uint32_t data_size);
 /*
-* write bytes to node
+* write data_size bytes to node, starting offset bytes into it.  returns the bytes written
 */
-typedef uint32_t (*filesystem_write_function)(struct filesystem_node* fs_node, const uint8_t* data, uint32_t data_size);
+typedef uint32_t (*filesystem_write_function)(struct filesystem_node* fs_node, uint64_t offset, const uint8_t* data,
+                                              uint32_t data_size);
 typedef void (*filesystem_open_function)(struct filesystem_node* fs_node);
 typedef void (*filesystem_close_function)(struct filesystem_node* fs_node);
 /*
@@ -79,6 +82,23 @@ typedef struct filesystem_node* (*filesystem_find_node_by_id_function)(struct fi
 * get directory list.  fills struct. 
 */
 typedef void (*filesystem_list_directory_function)(struct filesystem_node* fs_node, struct filesystem_directory* dir);
+/*
+* make an empty file called name in the folder fs_node.  returns the new node, or 0
+*/
+typedef struct filesystem_node* (*filesystem_create_function)(struct filesystem_node* fs_node, uint8_t* name);
+/*
+* set the size of a file, dropping what is past the new size or adding zeros
+*/
+typedef bool (*filesystem_truncate_function)(struct filesystem_node* fs_node, uint64_t size);
+/*
+* write out anything the filesystem is holding back
+*/
+typedef void (*filesystem_sync_function)(struct object* filesystem_obj);
+/*
+* where all of a node is in memory, starting on a page boundary and zero filled to the end of its last page, so it can
+* be mapped rather than read.  0 if it isn't
+*/
+typedef const uint8_t* (*filesystem_map_function)(struct filesystem_node* fs_node);
 
 struct objectinterface_filesystem {
     filesystem_get_root_node_function root;
@@ -88,6 +108,14 @@ struct objectinterface_filesystem {
     filesystem_close_function close;
     filesystem_find_node_by_id_function find_id;
     filesystem_list_directory_function list;
+    filesystem_create_function create;
+    filesystem_truncate_function truncate;
+    filesystem_sync_function sync;
+    filesystem_map_function map;
+    /*
+    * true if the filesystem's files only change through fsfacade, so reads can go through the page cache
+    */
+    bool cached;
 };
 
 #endif
\ No newline at end of file
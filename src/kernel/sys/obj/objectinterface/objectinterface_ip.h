@@ -10,31 +10,64 @@
 #ifndef _OBJECTTYPE_IP_H
 #define _OBJECTTYPE_IP_H
 
+#include <sys/netbuf/netbuf.h>
 #include <sys/obj/objectmgr/objectmgr.h>
 
 #include <types.h>
 
+#define IP_VERSION_4 4
+#define IP_HEADER_LEN 20
+#define IP_DEFAULT_TTL 64
+
+#define IP_PROTOCOL_ICMP 1
+#define IP_PROTOCOL_TCP 6
+#define IP_PROTOCOL_UDP 17
+
+// fragment flags, in the host byte order frag_off
+#define IP_FLAG_MF 0x2000
+#define IP_FLAG_DF 0x4000
+#define IP_FRAG_OFFSET_MASK 0x1FFF
+
+// build a host byte order address from dotted quad a.b.c.d
+#define IP_ADDRESS(a, b, c, d) ((((uint32_t)(a)) << 24) | (((uint32_t)(b)) << 16) | (((uint32_t)(c)) << 8) | (d))
+#define IP_BROADCAST 0xFFFFFFFF
+
+// the header as it is on the wire; multi-byte fields are in network byte order
 struct ip_header {
-    uint8_t version : 4;
     uint8_t ihl : 4;
+    uint8_t version : 4;
     uint8_t tos;
     uint16_t len;
     uint16_t id;
-    uint16_t flags : 3;
-    uint16_t frag_offset : 13;
+    uint16_t frag_off;
     uint8_t ttl;
     uint8_t proto;
     uint16_t csum;
     uint32_t saddr;
     uint32_t daddr;
-} __attribute__((packed)) __attribute__((aligned(8)));
+} __attribute__((packed));
 
-typedef void (*ip_read_function)(struct object* obj, uint8_t* data, uint16_t size);
-typedef void (*ip_write_function)(struct object* obj, uint8_t* data, uint16_t size);
+/*
+ * called for each received datagram of a registered protocol. the header has been pulled off payload, which is
+ * trimmed to the datagram and lent for the call.  addresses in ip are in network byte order
+ */
+typedef void (*ip_input_function)(struct object* protocol, struct ip_header* ip, struct netbuf* payload);
+
+/*
+ * addresses are in host byte order
+ */
+typedef void (*ip_configure_function)(struct object* obj, uint32_t address, uint32_t netmask, uint32_t gateway);
+typedef uint32_t (*ip_address_function)(struct object* obj);
+// pushes the header onto payload and takes the caller's reference
+typedef void (*ip_write_function)(struct object* obj, uint32_t dest, uint8_t protocol, struct netbuf* payload);
+typedef void (*ip_register_function)(struct object* obj, uint8_t protocol, struct object* handler,
+                                     ip_input_function input);
 
 struct objectinterface_ip {
-    ip_read_function read;
+    ip_configure_function configure;
+    ip_address_function address;
     ip_write_function write;
+    ip_register_function register_protocol;
 };
 
-#endif
\ No newline at end of file
+#endif
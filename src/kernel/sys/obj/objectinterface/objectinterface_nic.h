@@ -10,16 +10,56 @@
 #ifndef _OBJECTTYPE_NIC_H
 #define _OBJECTTYPE_NIC_H
 
+#include <sys/netbuf/netbuf.h>
 #include <sys/obj/objectmgr/objectmgr.h>
 
 #include <types.h>
 
+#define NIC_HW_ADDRESS_LEN 6
+
+// what a NIC can do for us
+#define NIC_OFFLOAD_TX_CSUM 0x01  // it finishes NETBUF_CSUM_PARTIAL checksums on the way out
+#define NIC_OFFLOAD_RX_CSUM 0x02  // it checks checksums on the way in, and marks frames NETBUF_CSUM_VALID
+
+/*
+ * called by the NIC, for each frame it receives, on the object set with set_receiver. the frame is lent for the
+ * call; a receiver that keeps it must netbuf_retain it
+ */
+typedef void (*nic_receive_function)(struct object* receiver, struct netbuf* frame);
+
 typedef void (*nic_read_function)(struct object* obj, uint8_t* data, uint16_t size);
-typedef void (*nic_write_function)(struct object* obj, uint8_t* data, uint16_t size);
+// takes the caller's reference on the frame
+typedef void (*nic_write_function)(struct object* obj, struct netbuf* frame);
+typedef void (*nic_set_receiver_function)(struct object* obj, struct object* receiver, nic_receive_function receive);
+typedef void (*nic_hw_address_function)(struct object* obj, uint8_t* hw_address);
+typedef uint8_t (*nic_offload_function)(struct object* obj);
+
+/*
+ * polled receive; see sys/netpoll/netpoll.h.  poll hands up to budget frames to the receiver and returns how many
+ * it did.  interrupts turns the receive interrupt off and on; turning it on returns true if frames are already
+ * waiting that won't raise one
+ */
+typedef uint16_t (*nic_poll_function)(struct object* obj, uint16_t budget);
+typedef bool (*nic_interrupts_function)(struct object* obj, bool enable);
+
+struct nic_stats {
+    uint64_t interrupts;  // receive interrupts taken
+    uint64_t polls;       // calls to poll
+    uint64_t packets;     // frames poll handed up
+    uint64_t exhausted;   // polls that used their whole budget, so the NIC stayed on the poll list
+};
+
+typedef void (*nic_stats_function)(struct object* obj, struct nic_stats* stats);
 
 struct objectinterface_nic {
     nic_read_function read;
     nic_write_function write;
+    nic_set_receiver_function set_receiver;  // optional; NICs without it can only transmit
+    nic_hw_address_function hw_address;      // optional; NIC_HW_ADDRESS_LEN bytes
+    nic_offload_function offload;            // optional; NIC_OFFLOAD_* flags
+    nic_poll_function poll;                  // optional, with interrupts; for NICs that use netpoll
+    nic_interrupts_function interrupts;
+    nic_stats_function stats;                // optional
 };
 
 #endif
\ No newline at end of file
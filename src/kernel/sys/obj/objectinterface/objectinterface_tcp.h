@@ -14,12 +14,87 @@
 
 #include <types.h>
 
-typedef void (*tcp_read_function)(struct object* obj, uint8_t* data, uint16_t size);
-typedef void (*tcp_write_function)(struct object* obj, uint8_t* data, uint16_t size);
+#define TCP_HEADER_LEN 20
+#define TCP_CSUM_OFFSET 16  // of the checksum, in the header
+
+// the largest segment we send or accept, for an ethernet MTU
+#define TCP_MSS 1460
+
+// first port handed out to an outgoing connection
+#define TCP_EPHEMERAL_PORT_START 49152
+
+// header flags
+#define TCP_FLAG_FIN 0x01
+#define TCP_FLAG_SYN 0x02
+#define TCP_FLAG_RST 0x04
+#define TCP_FLAG_PSH 0x08
+#define TCP_FLAG_ACK 0x10
+#define TCP_FLAG_URG 0x20
+
+// connection states, from RFC 793
+#define TCP_STATE_CLOSED 0
+#define TCP_STATE_LISTEN 1
+#define TCP_STATE_SYN_SENT 2
+#define TCP_STATE_SYN_RECEIVED 3
+#define TCP_STATE_ESTABLISHED 4
+#define TCP_STATE_FIN_WAIT_1 5
+#define TCP_STATE_FIN_WAIT_2 6
+#define TCP_STATE_CLOSE_WAIT 7
+#define TCP_STATE_CLOSING 8
+#define TCP_STATE_LAST_ACK 9
+#define TCP_STATE_TIME_WAIT 10
+
+// the header as it is on the wire; multi-byte fields are in network byte order
+struct tcp_header {
+    uint16_t source_port;
+    uint16_t dest_port;
+    uint32_t seq;
+    uint32_t ack;
+    uint8_t reserved : 4;
+    uint8_t offset : 4;  // header length in 32 bit words
+    uint8_t flags;
+    uint16_t window;
+    uint16_t csum;
+    uint16_t urgent;
+} __attribute__((packed));
+
+struct tcp_connection;
+
+/*
+ * addresses and ports are in host byte order.
+ * listen returns 0 if the port is taken. accept, send and receive don't block: accept returns 0 if no
+ * connection has been established yet, send returns the number of bytes queued and receive the number of bytes
+ * copied. receive returns 0 at end of stream too; state tells the two apart.
+ * pending is the number of bytes waiting to be received or, on a listener, of connections waiting to be accepted.
+ * space is the number of bytes send would queue now; 0 once the connection can't send any more.
+ * close hands the connection back to the object, which finishes closing it and frees it; it can't be used after.
+ * tick advances the retransmit timers by one tick. it is called from the tick object given to tcp_attach, or by
+ * hand when there isn't one.
+ */
+typedef struct tcp_connection* (*tcp_listen_function)(struct object* obj, uint16_t port);
+typedef struct tcp_connection* (*tcp_accept_function)(struct object* obj, struct tcp_connection* listener);
+typedef struct tcp_connection* (*tcp_connect_function)(struct object* obj, uint32_t dest_ip, uint16_t dest_port);
+typedef uint16_t (*tcp_send_function)(struct object* obj, struct tcp_connection* connection, uint8_t* data,
+                                      uint16_t size);
+typedef uint16_t (*tcp_receive_function)(struct object* obj, struct tcp_connection* connection, uint8_t* data,
+                                         uint16_t size);
+typedef void (*tcp_close_function)(struct object* obj, struct tcp_connection* connection);
+typedef uint8_t (*tcp_state_function)(struct object* obj, struct tcp_connection* connection);
+typedef void (*tcp_tick_function)(struct object* obj);
+typedef uint32_t (*tcp_pending_function)(struct object* obj, struct tcp_connection* connection);
+typedef uint32_t (*tcp_space_function)(struct object* obj, struct tcp_connection* connection);
 
 struct objectinterface_tcp {
-    tcp_read_function read;
-    tcp_write_function write;
+    tcp_listen_function listen;
+    tcp_accept_function accept;
+    tcp_connect_function connect;
+    tcp_send_function send;
+    tcp_receive_function receive;
+    tcp_close_function close;
+    tcp_state_function state;
+    tcp_tick_function tick;
+    tcp_pending_function pending;
+    tcp_space_function space;
 };
 
-#endif
\ No newline at end of file
+#endif
@@ -14,10 +14,20 @@
 
 #include <types.h>
 
+/*
+ * called once for every tick, with its tick count.  not from the timer interrupt: the interrupt only counts the
+ * tick, and tick_run calls the subscribers later, from thread context
+ */
+typedef void (*tick_event_function)(struct object* subscriber, uint64_t tick);
+
 typedef uint64_t (*tick_read_function)(struct object* obj);
+typedef void (*tick_subscribe_function)(struct object* obj, struct object* subscriber, tick_event_function event);
+typedef void (*tick_unsubscribe_function)(struct object* obj, struct object* subscriber);
 
 struct objectinterface_tick {
     tick_read_function read;
+    tick_subscribe_function subscribe;
+    tick_unsubscribe_function unsubscribe;
 };
 
 #endif
\ No newline at end of file
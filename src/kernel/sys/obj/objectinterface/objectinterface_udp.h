@@ -10,16 +10,51 @@
 #ifndef _OBJECTTYPE_UDP_H
 #define _OBJECTTYPE_UDP_H
 
+#include <sys/netbuf/netbuf.h>
 #include <sys/obj/objectmgr/objectmgr.h>
 
 #include <types.h>
 
-typedef void (*udp_read_function)(struct object* obj, uint8_t* data, uint16_t size);
-typedef void (*udp_write_function)(struct object* obj, uint8_t* data, uint16_t size);
+#define UDP_HEADER_LEN 8
+#define UDP_CSUM_OFFSET 6  // of the checksum, in the header
+
+// first port handed out when a socket is opened on port 0
+#define UDP_EPHEMERAL_PORT_START 49152
+
+// the header as it is on the wire; fields are in network byte order
+struct udp_header {
+    uint16_t source_port;
+    uint16_t dest_port;
+    uint16_t len;
+    uint16_t csum;
+} __attribute__((packed));
+
+struct udp_socket;
+
+/*
+ * addresses and ports are in host byte order.
+ * open returns 0 if the port is taken. port 0 asks for an ephemeral port.
+ * send pushes the header onto data and takes the caller's reference. it returns the payload size sent, or 0 if
+ * the datagram won't fit in a frame.
+ * receive doesn't block; it returns 0 if no datagram is waiting, otherwise the payload, which the caller releases.
+ * pending is the number of datagrams waiting to be received.
+ */
+typedef struct udp_socket* (*udp_open_function)(struct object* obj, uint16_t port);
+typedef void (*udp_close_function)(struct object* obj, struct udp_socket* socket);
+typedef uint16_t (*udp_port_function)(struct object* obj, struct udp_socket* socket);
+typedef uint16_t (*udp_send_function)(struct object* obj, struct udp_socket* socket, uint32_t dest_ip,
+                                      uint16_t dest_port, struct netbuf* data);
+typedef struct netbuf* (*udp_receive_function)(struct object* obj, struct udp_socket* socket, uint32_t* source_ip,
+                                               uint16_t* source_port);
+typedef uint16_t (*udp_pending_function)(struct object* obj, struct udp_socket* socket);
 
 struct objectinterface_udp {
-    udp_read_function read;
-    udp_write_function write;
+    udp_open_function open;
+    udp_close_function close;
+    udp_port_function port;
+    udp_send_function send;
+    udp_receive_function receive;
+    udp_pending_function pending;
 };
 
-#endif
\ No newline at end of file
+#endif
@@ -31,6 +31,7 @@
 #include <obj/x86-64/speaker/speaker.h>
 #include <obj/x86-64/usb_ehci/usb_ehci.h>
 #include <sys/debug/assert.h>
+#include <sys/fs/dcache.h>
 #include <sys/kmalloc/kmalloc.h>
 #include <sys/kprintf/kprintf.h>
 #include <sys/obj/object/object.h>
@@ -81,6 +82,10 @@ void objectmgr_register_object(struct object* obj) {
      * register
      */
     objectregistry_registerobject(obj);
+    /*
+     * objfs and voh list objects, so what the dentry cache knows of them is out of date
+     */
+    dcache_clear();
 }
 
 void objectmgr_unregister_object(struct object* obj) {
@@ -89,6 +94,7 @@ void objectmgr_unregister_object(struct object* obj) {
      * unregister
      */
     objectregistry_unregisterobject(obj);
+    dcache_clear();
 }
 
 uint16_t objectmgr_object_count() {
@@ -63,6 +63,7 @@
 #define OBJECT_TYPE_SERIALIZER 0x30       // serializer0 objecttype_serializer
 #define OBJECT_TYPE_HOSTID 0x31           // hostid0 objecttype_hostid
 #define OBJECT_TYPE_TIME 0x32             // time0 objecttype_time
+#define OBJECT_TYPE_LOOPBACK 0x33         // lo0 objecttype_nic
 
 struct object_type {
     uint8_t name[OBJECT_TYPE_MAX_NAME];
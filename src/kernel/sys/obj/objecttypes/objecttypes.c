@@ -66,6 +66,7 @@ void objecttypes_init() {
     objecttypes_add(objecttype_new("serializer", OBJECT_TYPE_SERIALIZER));
     objecttypes_add(objecttype_new("hostid", OBJECT_TYPE_HOSTID));
     objecttypes_add(objecttype_new("time", OBJECT_TYPE_TIME));
+    objecttypes_add(objecttype_new("lo", OBJECT_TYPE_LOOPBACK));
 }
 
 uint32_t objecttypes_count() {
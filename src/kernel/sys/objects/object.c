@@ -5,7 +5,7 @@
  * See the file "LICENSE" in the source distribution for details *
  *****************************************************************/
 
-#include <sys/collection/dtable/dtable.h>
+#include <sys/debug/assert.h>
 #include <sys/kmalloc/kmalloc.h>
 #include <sys/objects/objects.h>
 
@@ -13,29 +13,40 @@ object_handle_t object_create(object_types_t type, void* object_data) {
     object_t* obj;
 
     obj = (object_t*)kmalloc(sizeof(object_t));
-    obj->type = type;
-    obj->name = 0;
 
     if (!obj) {
         return 0;
     }
 
+    obj->type = type;
+    obj->name = 0;
     obj->data = object_data;
 
     /*
-     * To allow functions that return an object_handle_t to return 0 on error,
-     * the minimum handle # is 1. However, we still want zero-based numbering
-     * for object_table, so we subtract 1 when placing it in the table.  We also
-     * will have to do a similar adjustment when getting object data.
+     * Handles are never 0, which allows functions that return an
+     * object_handle_t to return 0 on error.
      */
-    dtable_set(object_table, object_table_next_idx - 1, obj);
-
-    // object knows its own handle; we want the value BEFORE increment
-    obj->handle = object_table_next_idx++;
+    obj->handle = object_table_add(obj);
 
     return obj->handle;
 }
 
+void object_delete(object_handle_t handle) {
+    /*
+     * Removes the object from the object table and frees it.  The object's
+     * data is the caller's to deal with.  Any copies of the handle that are
+     * still around will no longer resolve to anything.
+     */
+    object_t* obj;
+
+    obj = object_table_remove(handle);
+    ASSERT_NOT_NULL(obj);
+
+    kfree(obj);
+
+    return;
+}
+
 object_types_t object_type_(object_handle_t obj) {
     object_t* o;
 
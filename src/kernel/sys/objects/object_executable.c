@@ -7,6 +7,7 @@
 
 #include <sys/debug/assert.h>
 #include <sys/fs/fs_facade.h>
+#include <sys/fs/pagecache.h>
 #include <sys/kmalloc/kmalloc.h>
 #include <sys/obj/objectinterface/objectinterface_filesystem.h>
 #include <sys/objects/objects.h>
@@ -16,6 +17,35 @@
 #include <sys/x86-64/mm/pagetables.h>
 #include <types.h>
 
+bool object_executable_hold_cached_pages(object_executable_t* exe_obj, filesystem_node_t* node) {
+    /*
+     * Take the image's pages from the page cache, reading any that aren't
+     * there, and hold them for as long as the executable is around.  Returns
+     * false if the file isn't cached, or a page couldn't be had.
+     */
+    uint64_t i;
+
+    if (!pagecache_cacheable(node)) {
+        return false;
+    }
+
+    exe_obj->pages = (uint64_t*)kmalloc(sizeof(uint64_t) * exe_obj->page_count);
+
+    for (i = 0; i < exe_obj->page_count; i++) {
+        exe_obj->pages[i] = pagecache_get_page(node, i);
+        if (!exe_obj->pages[i]) {
+            while (i > 0) {
+                pagecache_put_page(exe_obj->pages[--i]);
+            }
+            kfree(exe_obj->pages);
+            exe_obj->pages = NULL;
+            return false;
+        }
+    }
+
+    return true;
+}
+
 object_handle_t object_executable_create_from_presentation(object_handle_t pres_handle) {
     object_presentation_t* pres_obj;
     object_executable_t* exe_obj;
@@ -24,12 +54,13 @@ object_handle_t object_executable_create_from_presentation(object_handle_t pres_
     object_handle_t exe_handle;
     BYTE* exe_buf;
     filesystem_node_t* node;
+    const uint8_t* mapped;
     uint64_t i;
 
     pres_obj = OBJECT_DATA(pres_handle, object_presentation_t);
     node = pres_obj->node;
 
-    exe_obj = (object_executable_t*)kmalloc(sizeof(obj_executable_t));
+    exe_obj = (object_executable_t*)kmalloc(sizeof(object_executable_t));
 
     /*
     * set name
@@ -44,19 +75,63 @@ object_handle_t object_executable_create_from_presentation(object_handle_t pres_
 
     exe_obj->page_count = (pres_len / PAGE_SIZE) + ((pres_len % PAGE_SIZE) ? 1 : 0);
 
-    exe_obj->page_base = slab_allocate(exe_obj->page_count, PDT_INUSE);
+    /*
+     * if the filesystem has the file in memory already (the initrd, when the
+     * boot loader loaded it), use its pages rather than reading a copy.
+     * otherwise use the page cache's, if it caches the file
+     */
+    exe_obj->pages = NULL;
+    mapped = fsfacade_map(node);
+    if (mapped) {
+        exe_obj->page_base = (uint64_t)CONV_DMAP_ADDR(mapped) / PAGE_SIZE;
+        exe_obj->shared = true;
+    } else if (object_executable_hold_cached_pages(exe_obj, node)) {
+        exe_obj->page_base = 0;
+        exe_obj->shared = true;
+    } else {
+        exe_obj->page_base = slab_allocate(exe_obj->page_count, PDT_INUSE);
+        exe_obj->shared = false;
+
+        for (i = 0; i < exe_obj->page_count; i++) {
+            memset((uint8_t*)CONV_PHYS_ADDR((exe_obj->page_base + i) * PAGE_SIZE), 0, PAGE_SIZE);
+        }
 
-    for (i = 0; i < exe_obj->page_count; i++) {
-        memset((uint8_t*)CONV_PHYS_ADDR(exe_obj->page_base + (i * PAGE_SIZE)), 0, PAGE_SIZE);
+        exe_buf = (BYTE*)CONV_PHYS_ADDR((exe_obj->page_base * PAGE_SIZE));
+        fsfacade_read_all(node, (uint8_t*)exe_buf, pres_len);
     }
 
-    exe_buf = (BYTE*)CONV_PHYS_ADDR((exe_obj->page_base * PAGE_SIZE));
-    fsfacade_read(node, (uint8_t*)exe_buf, pres_len);
-
     exe_obj->from_presentation = true;
     exe_obj->presentation = pres_handle;
 
     exe_handle = object_create(OBJECT_EXECUTABLE, (void*)exe_obj);
 
     return exe_handle;
-}
\ No newline at end of file
+}
+void object_executable_delete(object_handle_t exe_handle) {
+    /*
+     * Frees an executable, putting back the page cache pages it holds.
+     * Mapping a page doesn't take a reference on it, so this is only for
+     * once no process has the image mapped.  An image read for the
+     * executable alone is mapped straight into the process, so it is the
+     * process's to free.  Nothing calls this yet--there is no process
+     * teardown--so until there is, an executable's cached pages stay held
+     * for good.
+     */
+    object_executable_t* exe_obj;
+    uint64_t i;
+
+    exe_obj = OBJECT_DATA(exe_handle, object_executable_t);
+
+    if (exe_obj->pages) {
+        for (i = 0; i < exe_obj->page_count; i++) {
+            pagecache_put_page(exe_obj->pages[i]);
+        }
+        kfree(exe_obj->pages);
+    }
+
+    kfree(exe_obj->exe_name);
+    kfree(exe_obj);
+    object_delete(exe_handle);
+
+    return;
+}
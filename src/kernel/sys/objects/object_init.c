@@ -5,13 +5,10 @@
  * See the file "LICENSE" in the source distribution for details *
  *****************************************************************/
 
-#include <sys/collection/dtable/dtable.h>
 #include <sys/objects/objects.h>
 
 void object_init() {
-    object_table = dtable_init();
-
-    object_table_next_idx = 1;
+    object_table_init();
 
     return;
 }
\ No newline at end of file
@@ -5,17 +5,148 @@
  * See the file "LICENSE" in the source distribution for details *
  *****************************************************************/
 
-// Right now these are basically just wrappers for the dtable functions, but
-// using them instead of dtables directly should simplify matters if we ever
-// change the underlying representation of the table
+/*
+ * Handles are handed out densely, so rather than a dtable we keep a two-level
+ * table: a small top-level array of pointers to chunks of slots, with chunks
+ * allocated as the table grows.  The top level stays in cache, so a lookup
+ * costs one miss on the slot itself.
+ *
+ * The top level is a fixed size, and chunks are never freed, so a chunk never
+ * moves once it's there.  That lets object_table_get() look a handle up
+ * without object_table_lock: a chunk is published with a release store once
+ * it has been zeroed, and read with an acquire load.
+ *
+ * The low 32 bits of a handle are its slot number plus one (so no handle is
+ * ever 0), and the high 32 bits are the slot's generation at the time the
+ * handle was issued.  Removing an object bumps its slot's generation, so the
+ * slot can be reused without stale handles resolving to the new object.
+ */
 
-#include <sys/collection/dtable/dtable.h>
+#include <sys/debug/assert.h>
+#include <sys/kmalloc/kmalloc.h>
 #include <sys/objects/objects.h>
+#include <sys/panic/panic.h>
+#include <sys/string/mem.h>
+#include <sys/sync/sync.h>
 #include <types.h>
 
-dtable object_table;
-uint64_t object_table_next_idx;
+object_table_slot_t* object_table[OBJECT_TABLE_MAX_CHUNKS];
+uint64_t object_table_next_idx;  // slots below this have been handed out at least once
+uint64_t object_table_free;      // head of the list of released slots, as slot number + 1; 0 if empty
+
+object_table_slot_t* object_table_slot(uint64_t idx);
+
+void object_table_init() {
+    memzero((uint8_t*)object_table, sizeof(object_table));
+
+    object_table_next_idx = 0;
+    object_table_free = 0;
+
+    return;
+}
+
+object_table_slot_t* object_table_slot(uint64_t idx) {
+    // Caller must hold object_table_lock, since the slot's chunk may need adding
+    uint64_t chunk;
+    object_table_slot_t* slots;
+
+    chunk = idx >> OBJECT_TABLE_CHUNK_SHIFT;
+    ASSERT(chunk < OBJECT_TABLE_MAX_CHUNKS);
+
+    if (!object_table[chunk]) {
+        slots = (object_table_slot_t*)kmalloc(sizeof(object_table_slot_t) * OBJECT_TABLE_CHUNK_SIZE);
+        memzero((uint8_t*)slots, sizeof(object_table_slot_t) * OBJECT_TABLE_CHUNK_SIZE);
+        __atomic_store_n(&object_table[chunk], slots, __ATOMIC_RELEASE);
+    }
+
+    return &object_table[chunk][idx & (OBJECT_TABLE_CHUNK_SIZE - 1)];
+}
+
+object_handle_t object_table_add(object_t* obj) {
+    object_table_slot_t* slot;
+    uint64_t idx;
+    object_handle_t handle;
+
+    ASSERT_NOT_NULL(obj);
+
+    spinlock_acquire(&object_table_lock);
+
+    // Reuse a released slot if there is one, so the table stays dense
+    if (object_table_free) {
+        idx = object_table_free - 1;
+        slot = object_table_slot(idx);
+        object_table_free = slot->next_free;
+    } else {
+        idx = object_table_next_idx++;
+        if (idx >= (OBJECT_TABLE_MAX_CHUNKS * OBJECT_TABLE_CHUNK_SIZE)) {
+            PANIC("Object table full");
+        }
+        slot = object_table_slot(idx);
+    }
+
+    slot->obj = obj;
+    slot->next_free = 0;
+
+    handle = ((object_handle_t)slot->generation << OBJECT_HANDLE_GENERATION_SHIFT) | (idx + 1);
+
+    spinlock_release(&object_table_lock);
+
+    return handle;
+}
 
 object_t* object_table_get(object_handle_t handle) {
-    return (object_t*)dtable_get(object_table, (uint64_t)handle - 1);
-}
\ No newline at end of file
+    /*
+     * Returns NULL for a handle that was never issued or whose object has since
+     * been removed.
+     */
+    object_table_slot_t* slot;
+    object_table_slot_t* slots;
+    uint64_t idx, chunk;
+
+    idx = (handle & OBJECT_HANDLE_INDEX_MASK) - 1;
+    chunk = idx >> OBJECT_TABLE_CHUNK_SHIFT;
+
+    if (!(handle & OBJECT_HANDLE_INDEX_MASK) || (chunk >= OBJECT_TABLE_MAX_CHUNKS)) {
+        return NULL;
+    }
+
+    slots = __atomic_load_n(&object_table[chunk], __ATOMIC_ACQUIRE);
+    if (!slots) {
+        return NULL;
+    }
+
+    slot = &slots[idx & (OBJECT_TABLE_CHUNK_SIZE - 1)];
+
+    if (slot->generation != (handle >> OBJECT_HANDLE_GENERATION_SHIFT)) {
+        return NULL;
+    }
+
+    return slot->obj;
+}
+
+object_t* object_table_remove(object_handle_t handle) {
+    /*
+     * Removes the object from the table and returns it, so the caller can
+     * free it.  The slot goes on the free list for object_table_add() to reuse.
+     */
+    object_table_slot_t* slot;
+    object_t* obj;
+
+    spinlock_acquire(&object_table_lock);
+
+    obj = object_table_get(handle);
+    if (!obj) {
+        spinlock_release(&object_table_lock);
+        return NULL;
+    }
+
+    slot = object_table_slot((handle & OBJECT_HANDLE_INDEX_MASK) - 1);
+    slot->obj = NULL;
+    slot->generation++;
+    slot->next_free = object_table_free;
+    object_table_free = handle & OBJECT_HANDLE_INDEX_MASK;
+
+    spinlock_release(&object_table_lock);
+
+    return obj;
+}
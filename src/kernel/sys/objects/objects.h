@@ -13,13 +13,21 @@
 #ifndef _OBJECTS_H
 #define _OBJECTS_H
 
-#include <sys/collection/dtable/dtable.h>
 #include <sys/collection/linkedlist/linkedlist.h>
 #include <sys/obj/objectmgr/objectmgr.h>
 
 #include <sys/obj/objectinterface/objectinterface_filesystem.h>
 #include <types.h>
 
+// object handles: slot number + 1 in the low 32 bits, slot generation in the high 32
+#define OBJECT_HANDLE_INDEX_MASK 0xFFFFFFFF
+#define OBJECT_HANDLE_GENERATION_SHIFT 32
+
+// object_table is an array of pointers to chunks of this many slots
+#define OBJECT_TABLE_CHUNK_SHIFT 9
+#define OBJECT_TABLE_CHUNK_SIZE (1 << OBJECT_TABLE_CHUNK_SHIFT)
+#define OBJECT_TABLE_MAX_CHUNKS 1024  // so up to 512K objects at once
+
 // given a handle, retrieve object from table and return its data member
 #define OBJECT_DATA(handle, type) ((type*)(object_table_get(handle)->data))
 
@@ -49,9 +57,17 @@ typedef struct object_t {
     object_handle_t handle;
 } object_t;
 
+typedef struct object_table_slot_t {
+    object_t* obj;  // NULL if the slot is free
+    uint32_t generation;
+    uint32_t next_free;  // next free slot number + 1, while this slot is on the free list
+} object_table_slot_t;
+
 typedef struct object_executable_t {
     uint64_t page_base;
     uint64_t page_count;
+    uint64_t* pages;  // the image's pages, one by one, if they aren't contiguous from page_base; NULL if they are
+    bool shared;      // the pages are the filesystem's or the page cache's, so they're mapped copy-on-write
     bool from_presentation;  // if false, the value in presentation is not valid
     object_handle_t presentation;
     char* exe_name;
@@ -82,15 +98,17 @@ typedef struct object_task_t {
     linkedlist* sched_task;
 } object_task_t;
 
-extern dtable object_table;
+extern object_table_slot_t* object_table[OBJECT_TABLE_MAX_CHUNKS];
 extern uint64_t object_table_next_idx;
 
 // object.c
 object_handle_t object_create(object_types_t type, void* object_data);
+void object_delete(object_handle_t handle);
 object_types_t object_type_(object_handle_t obj);
 
 // object_executable.c
 object_handle_t object_executable_create_from_presentation(object_handle_t pres);
+void object_executable_delete(object_handle_t exe_handle);
 
 // object_init.c
 void object_init();
@@ -105,7 +123,10 @@ object_handle_t object_presentation_create(filesystem_node_t* node);
 object_handle_t object_process_create(object_handle_t exe);
 
 // object_table.c
+object_handle_t object_table_add(object_t* obj);
 object_t* object_table_get(object_handle_t handle);
+void object_table_init();
+object_t* object_table_remove(object_handle_t handle);
 
 // object_task.c
 object_handle_t object_task_create(object_handle_t proc);
@@ -5,6 +5,8 @@
  * See the file "LICENSE" in the source distribution for details *
  *****************************************************************/
 
+#include <obj/logical/tick/tick.h>
+#include <sys/netpoll/netpoll.h>
 #include <types.h>
 
 void* kernel_idle(void* arg) {
@@ -13,6 +15,10 @@ void* kernel_idle(void* arg) {
 
     while (1) {
         asm("hlt");
+        // the timer interrupt may have counted ticks for the tick subscribers
+        tick_run();
+        // whatever woke us may have been a NIC with frames for us
+        netpoll_run();
     }
 
     return NULL;
@@ -29,17 +29,23 @@ void proc_adjust_kernel_stack(pttentry cr3) {
     pttentry* pml4;
     uint8_t i;
     uint64_t stack_page;
+    tlb_batch_t batch;
 
     // Clear the last PML4 entry--this is where the stack is, and we don't want
     // to overwrite system page tables.
     pml4 = CONV_PHYS_ADDR(PTT_EXTRACT_BASE(cr3));
     pml4[511] = 0;
 
+    tlb_batch_init(&batch, cr3);
+
     for (i = 0; i < 4; i++) {
         stack_page = slab_allocate(1, PDT_INUSE);
         map_page_at(stack_page, (void*)(DEFAULT_PROC_KERNEL_STACK_START + (i * PAGE_SIZE)), cr3, false);
+        tlb_batch_add(&batch, (void*)(DEFAULT_PROC_KERNEL_STACK_START + (i * PAGE_SIZE)));
     }
 
+    tlb_batch_flush(&batch);
+
     return;
 }
 
@@ -64,14 +70,28 @@ void proc_map_image(pttentry cr3, object_handle_t exe_obj) {
     // into the PML4 table specified by cr3.
 
     object_executable_t* obj;
-    uint64_t i;
     void* vaddr = LOAD_BASE_VIRTUAL;
+    tlb_batch_t batch;
+    uint64_t i;
 
     obj = OBJECT_DATA(exe_obj, object_executable_t);
 
-    for (i = 0; i < obj->page_count; i++) {
-        map_page_at(obj->page_base + i, vaddr + (PAGE_SIZE * i), cr3, true);
+    tlb_batch_init(&batch, cr3);
+
+    // a contiguous image gets 2MB mappings, if it's large.  pages shared with
+    // the filesystem or the page cache are copied if the process writes them
+    if (obj->pages) {
+        for (i = 0; i < obj->page_count; i++) {
+            map_pages_cow_at(obj->pages[i], 1, (void*)((uint64_t)vaddr + (i * PAGE_SIZE)), cr3, true);
+        }
+    } else if (obj->shared) {
+        map_pages_cow_at(obj->page_base, obj->page_count, vaddr, cr3, true);
+    } else {
+        map_pages_at(obj->page_base, obj->page_count, vaddr, cr3, true);
     }
+    tlb_batch_add_range(&batch, vaddr, obj->page_count);
+
+    tlb_batch_flush(&batch);
 
     return;
 }
@@ -92,11 +112,19 @@ void proc_map_kernelspace(pttentry cr3) {
 void proc_map_stack(pttentry cr3) {
     uint8_t i;
     uint64_t stack_page;
+    tlb_batch_t batch;
+
+    tlb_batch_init(&batch, cr3);
 
     for (i = 0; i < 4; i++) {
         stack_page = slab_allocate(1, PDT_INUSE);
         map_page_at(stack_page, (void*)(DEFAULT_PROC_USER_STACK_START + (i * PAGE_SIZE)), cr3, true);
+        reclaim_track_page(stack_page, cr3, (void*)(DEFAULT_PROC_USER_STACK_START + (i * PAGE_SIZE)));
+        tlb_batch_add(&batch, (void*)(DEFAULT_PROC_USER_STACK_START + (i * PAGE_SIZE)));
     }
+
+    tlb_batch_flush(&batch);
+
     return;
 }
 
@@ -113,6 +141,9 @@ pttentry proc_obtain_cr3() {
     proc_cr3 = cr3_page * PAGE_SIZE;  // we don't need to set any flags
     memset(CONV_PHYS_ADDR(proc_cr3), 0, PAGE_SIZE);
 
+    // An earlier address space may have used this page, and its PCID with it
+    tlb_release_address_space(proc_cr3);
+
     return proc_cr3;
 }
 
@@ -81,7 +81,7 @@ linkedlist* get_current_task(uint64_t cpu, uint64_t core);
 linkedlist* task_find(pid_t pid);
 
 // task_jump.asm
-void task_jump(proc_info_t* proc);
+void task_jump(proc_info_t* proc, pttentry cr3);
 
 // task_select.c
 linkedlist* task_select();
@@ -6,18 +6,21 @@
  *****************************************************************/
 
 #include <sys/collection/linkedlist/linkedlist.h>
-#include <sys/kmalloc/kmalloc.h>
+#include <sys/kmalloc/kpool.h>
 #include <sys/objects/objects.h>
 #include <sys/proc/proc.h>
 #include <sys/sched/sched.h>
 #include <sys/sync/sync.h>
 #include <types.h>
 
+kpool sched_task_pool = KPOOL_INIT("scheduler_task", scheduler_task_t, NULL);
+kpool sched_list_pool = KPOOL_INIT("scheduler_list", linkedlist, NULL);
+
 linkedlist* sched_add(uint64_t cpu, uint64_t core, pid_t pid, object_handle_t obj) {
     scheduler_task_t* new_task;
     linkedlist* new_list_entry;
 
-    new_task = (scheduler_task_t*)kmalloc(sizeof(scheduler_task_t));
+    new_task = (scheduler_task_t*)kpool_alloc(&sched_task_pool);
 
     new_task->pid = pid;
     new_task->notify_term = 0;
@@ -32,7 +35,7 @@ linkedlist* sched_add(uint64_t cpu, uint64_t core, pid_t pid, object_handle_t ob
     new_task->times_skipped = 0;
     new_task->obj = obj;
 
-    new_list_entry = linkedlist_new();
+    new_list_entry = (linkedlist*)kpool_alloc(&sched_list_pool);
 
     new_list_entry->data = (void*)new_task;
 
@@ -8,6 +8,7 @@
 #include <sys/collection/linkedlist/linkedlist.h>
 #include <sys/proc/proc.h>
 #include <sys/sched/sched.h>
+#include <sys/socket/socket.h>
 
 void sched_terminate(pid_t pid) {
     linkedlist* task;
@@ -16,5 +17,8 @@ void sched_terminate(pid_t pid) {
 
     TASK_DATA(task)->state = SCHED_TERMINATE;
 
+    // Nobody else can use its sockets, so they'd never be closed otherwise
+    socket_close_process(pid);
+
     return;
 }
\ No newline at end of file
@@ -9,6 +9,7 @@
 #include <sys/objects/objects.h>
 #include <sys/proc/proc.h>
 #include <sys/sched/sched.h>
+#include <sys/x86-64/mm/mm.h>
 #include <types.h>
 
 void switch_to_task(linkedlist* task) {
@@ -23,7 +24,8 @@ void switch_to_task(linkedlist* task) {
 
     current_task[CUR_CPU][CUR_CORE] = task;
 
-    task_jump(proc);
+    // With PCIDs, this keeps whatever translations the task still has cached
+    task_jump(proc, tlb_switch_cr3(proc->cr3));
 
     return;
 }
\ No newline at end of file
@@ -5,7 +5,9 @@
  * See the file "LICENSE" in the source distribution for details *
  *****************************************************************/
 
+#include <obj/logical/tick/tick.h>
 #include <sys/asm/misc.h>
+#include <sys/netpoll/netpoll.h>
 #include <types.h>
 
 volatile uint64_t sleep_countdown;
@@ -39,6 +41,10 @@ void sleep_wait(uint64_t milliseconds) {
 
     while (sleep_countdown) {
         asm_hlt();
+        tick_run();
+        if (netpoll_due()) {
+            netpoll_run();
+        }
     }
 
     return;
@@ -0,0 +1,360 @@
+//*****************************************************************
+// This file is part of CosmOS                                    *
+// Copyright (C) 2021 Tom Everett                                 *
+// Released under the stated terms in the file LICENSE            *
+// See the file "LICENSE" in the source distribution for details  *
+// ****************************************************************
+
+#include <sys/asm/misc.h>
+#include <sys/debug/assert.h>
+#include <sys/netbuf/netbuf.h>
+#include <sys/obj/object/object.h>
+#include <sys/obj/objectinterface/objectinterface_tcp.h>
+#include <sys/obj/objectinterface/objectinterface_udp.h>
+#include <sys/obj/objecttype/objectype.h>
+#include <sys/proc/proc.h>
+#include <sys/sched/sched.h>
+#include <sys/socket/socket.h>
+#include <sys/string/mem.h>
+#include <types.h>
+
+struct socket {
+    bool open;
+    uint8_t type;
+    pid_t owner;   // the process that opened it
+    pttentry cr3;  // and its address space, which the registered messages are in
+    struct object* transport;
+    struct udp_socket* udp;
+    struct tcp_connection* tcp;
+    bool listening;
+    uint32_t peer_ip;  // connect's destination
+    uint16_t peer_port;
+    struct socket_message* messages;
+    uint16_t message_count;
+};
+
+struct socket socket_table[SOCKET_MAX];
+
+/*
+ * the calling process, or 0 in the kernel before there are any
+ */
+pid_t socket_caller() {
+    linkedlist* task = get_current_task(CUR_CPU, CUR_CORE);
+    return (0 != task) ? TASK_DATA(task)->pid : 0;
+}
+
+/*
+ * a socket is only the process's that opened it, in the address space it opened it in, so the registered messages
+ * are always read and written through the owner's mappings
+ */
+struct socket* socket_get(uint64_t socket) {
+    if ((0 == socket) || (socket > SOCKET_MAX)) {
+        return 0;
+    }
+    struct socket* s = &(socket_table[socket - 1]);
+    if ((!s->open) || (s->owner != socket_caller()) || (s->cr3 != PTT_EXTRACT_BASE(asm_cr3_read()))) {
+        return 0;
+    }
+    return s;
+}
+
+uint64_t socket_new(struct object* transport, uint8_t type) {
+    for (uint16_t i = 0; i < SOCKET_MAX; i++) {
+        struct socket* s = &(socket_table[i]);
+        if (!s->open) {
+            memzero((uint8_t*)s, sizeof(struct socket));
+            s->open = true;
+            s->type = type;
+            s->owner = socket_caller();
+            s->cr3 = PTT_EXTRACT_BASE(asm_cr3_read());
+            s->transport = transport;
+            return i + 1;
+        }
+    }
+    return 0;
+}
+
+uint64_t socket_open(struct object* transport) {
+    ASSERT_NOT_NULL(transport);
+    if (OBJECT_TYPE_TCP == transport->objectype) {
+        return socket_new(transport, SOCKET_TYPE_STREAM);
+    } else if (OBJECT_TYPE_UDP == transport->objectype) {
+        return socket_new(transport, SOCKET_TYPE_DGRAM);
+    }
+    return 0;
+}
+
+bool socket_register(uint64_t socket, struct socket_message* messages, uint16_t count) {
+    struct socket* s = socket_get(socket);
+    if ((0 == s) || (0 == messages) || (0 == count) || (count > SOCKET_MESSAGES_MAX)) {
+        return false;
+    }
+    s->messages = messages;
+    s->message_count = count;
+    return true;
+}
+
+bool socket_bind(uint64_t socket, uint16_t port) {
+    struct socket* s = socket_get(socket);
+    if ((0 == s) || (0 != s->udp) || (0 != s->tcp)) {
+        return false;
+    }
+    if (SOCKET_TYPE_DGRAM == s->type) {
+        struct objectinterface_udp* api = (struct objectinterface_udp*)s->transport->api;
+        s->udp = (*api->open)(s->transport, port);
+        return (0 != s->udp);
+    }
+    struct objectinterface_tcp* api = (struct objectinterface_tcp*)s->transport->api;
+    s->tcp = (*api->listen)(s->transport, port);
+    s->listening = (0 != s->tcp);
+    return s->listening;
+}
+
+bool socket_connect(uint64_t socket, uint32_t ip, uint16_t port) {
+    struct socket* s = socket_get(socket);
+    if ((0 == s) || (0 != s->tcp)) {
+        return false;
+    }
+    if (SOCKET_TYPE_DGRAM == s->type) {
+        if (0 == s->udp) {
+            struct objectinterface_udp* api = (struct objectinterface_udp*)s->transport->api;
+            s->udp = (*api->open)(s->transport, 0);
+            if (0 == s->udp) {
+                return false;
+            }
+        }
+        s->peer_ip = ip;
+        s->peer_port = port;
+        return true;
+    }
+    struct objectinterface_tcp* api = (struct objectinterface_tcp*)s->transport->api;
+    s->tcp = (*api->connect)(s->transport, ip, port);
+    if (0 == s->tcp) {
+        return false;
+    }
+    s->peer_ip = ip;
+    s->peer_port = port;
+    return true;
+}
+
+uint64_t socket_accept(uint64_t socket) {
+    struct socket* s = socket_get(socket);
+    if ((0 == s) || (!s->listening)) {
+        return 0;
+    }
+    struct objectinterface_tcp* api = (struct objectinterface_tcp*)s->transport->api;
+    if (0 == (*api->pending)(s->transport, s->tcp)) {
+        return 0;
+    }
+    // take a descriptor first, so a full table leaves the connection waiting
+    uint64_t ret = socket_new(s->transport, SOCKET_TYPE_STREAM);
+    if (0 == ret) {
+        return 0;
+    }
+    struct socket* accepted = socket_get(ret);
+    accepted->tcp = (*api->accept)(s->transport, s->tcp);
+    ASSERT_NOT_NULL(accepted->tcp);
+    return ret;
+}
+
+uint16_t socket_send_datagrams(struct socket* s, uint16_t count) {
+    struct objectinterface_udp* api = (struct objectinterface_udp*)s->transport->api;
+    if (0 == s->udp) {
+        s->udp = (*api->open)(s->transport, 0);
+        if (0 == s->udp) {
+            return 0;
+        }
+    }
+    uint16_t sent = 0;
+    for (; sent < count; sent++) {
+        struct socket_message* m = &(s->messages[sent]);
+        uint16_t size = m->size;
+        uint32_t ip = m->ip;
+        uint16_t port = m->port;
+        if (0 == ip) {
+            ip = s->peer_ip;
+            port = s->peer_port;
+        }
+        if ((size > SOCKET_MESSAGE_DATA) || (0 == ip) || (0 == port)) {
+            break;
+        }
+        struct netbuf* nb = netbuf_new(NETBUF_HEADROOM);
+        if (0 == nb) {
+            // out of buffers; the rest wait for the next call
+            break;
+        }
+        if (size > 0) {
+            memcpy(netbuf_put(nb, size), m->data, size);
+        }
+        (*api->send)(s->transport, s->udp, ip, port, nb);
+    }
+    return sent;
+}
+
+uint16_t socket_send_stream(struct socket* s, uint16_t count) {
+    struct objectinterface_tcp* api = (struct objectinterface_tcp*)s->transport->api;
+    uint16_t sent = 0;
+    for (; sent < count; sent++) {
+        struct socket_message* m = &(s->messages[sent]);
+        uint16_t size = m->size;
+        if (size > SOCKET_MESSAGE_DATA) {
+            break;
+        }
+        if (0 == size) {
+            continue;
+        }
+        uint16_t queued = (*api->send)(s->transport, s->tcp, m->data, size);
+        if (queued < size) {
+            // keep the rest for next time
+            for (uint16_t i = queued; i < size; i++) {
+                m->data[i - queued] = m->data[i];
+            }
+            m->size = size - queued;
+            break;
+        }
+    }
+    return sent;
+}
+
+uint16_t socket_send(uint64_t socket, uint16_t count) {
+    struct socket* s = socket_get(socket);
+    if ((0 == s) || (count > s->message_count) || (s->listening)) {
+        return 0;
+    }
+    if (SOCKET_TYPE_DGRAM == s->type) {
+        return socket_send_datagrams(s, count);
+    }
+    if (0 == s->tcp) {
+        return 0;
+    }
+    return socket_send_stream(s, count);
+}
+
+uint16_t socket_receive(uint64_t socket, uint16_t count) {
+    struct socket* s = socket_get(socket);
+    if ((0 == s) || (count > s->message_count) || (s->listening)) {
+        return 0;
+    }
+    uint16_t received = 0;
+    if (SOCKET_TYPE_DGRAM == s->type) {
+        if (0 == s->udp) {
+            return 0;
+        }
+        struct objectinterface_udp* api = (struct objectinterface_udp*)s->transport->api;
+        for (; received < count; received++) {
+            struct socket_message* m = &(s->messages[received]);
+            uint32_t ip = 0;
+            uint16_t port = 0;
+            struct netbuf* nb = (*api->receive)(s->transport, s->udp, &ip, &port);
+            if (0 == nb) {
+                break;
+            }
+            // anything past SOCKET_MESSAGE_DATA is dropped, but no datagram that fits in a frame is bigger
+            m->size = 0;
+            if (netbuf_length(nb) > 0) {
+                m->size = netbuf_copy_out(nb, 0, m->data, SOCKET_MESSAGE_DATA);
+            }
+            m->ip = ip;
+            m->port = port;
+            netbuf_release(nb);
+        }
+        return received;
+    }
+    if (0 == s->tcp) {
+        return 0;
+    }
+    struct objectinterface_tcp* api = (struct objectinterface_tcp*)s->transport->api;
+    for (; received < count; received++) {
+        struct socket_message* m = &(s->messages[received]);
+        uint16_t size = (*api->receive)(s->transport, s->tcp, m->data, SOCKET_MESSAGE_DATA);
+        if (0 == size) {
+            break;
+        }
+        m->size = size;
+        m->ip = s->peer_ip;
+        m->port = s->peer_port;
+    }
+    return received;
+}
+
+uint16_t socket_poll_stream(struct socket* s) {
+    if (0 == s->tcp) {
+        return 0;
+    }
+    struct objectinterface_tcp* api = (struct objectinterface_tcp*)s->transport->api;
+    uint16_t ret = 0;
+    if ((*api->pending)(s->transport, s->tcp) > 0) {
+        ret |= SOCKET_POLL_IN;
+    }
+    if (s->listening) {
+        return ret;
+    }
+    uint8_t state = (*api->state)(s->transport, s->tcp);
+    // still connecting isn't ready to send, though send would queue
+    if ((TCP_STATE_SYN_SENT != state) && (TCP_STATE_SYN_RECEIVED != state) &&
+        ((*api->space)(s->transport, s->tcp) > 0)) {
+        ret |= SOCKET_POLL_OUT;
+    }
+    if ((TCP_STATE_CLOSE_WAIT == state) || (TCP_STATE_CLOSING == state) || (TCP_STATE_LAST_ACK == state) ||
+        (TCP_STATE_TIME_WAIT == state) || (TCP_STATE_CLOSED == state)) {
+        ret |= SOCKET_POLL_HUP;
+    }
+    return ret;
+}
+
+uint16_t socket_poll(struct socket_poll* polls, uint16_t count) {
+    ASSERT_NOT_NULL(polls);
+    uint16_t ready = 0;
+    for (uint16_t i = 0; i < count; i++) {
+        struct socket_poll* p = &(polls[i]);
+        struct socket* s = socket_get(p->socket);
+        uint16_t revents = 0;
+        if (0 == s) {
+            revents = SOCKET_POLL_NVAL;
+        } else if (SOCKET_TYPE_DGRAM == s->type) {
+            struct objectinterface_udp* api = (struct objectinterface_udp*)s->transport->api;
+            if ((0 != s->udp) && ((*api->pending)(s->transport, s->udp) > 0)) {
+                revents |= SOCKET_POLL_IN;
+            }
+            revents |= SOCKET_POLL_OUT;
+        } else {
+            revents = socket_poll_stream(s);
+        }
+        p->revents = revents & (p->events | SOCKET_POLL_HUP | SOCKET_POLL_NVAL);
+        if (0 != p->revents) {
+            ready++;
+        }
+    }
+    return ready;
+}
+
+void socket_release(struct socket* s) {
+    if (0 != s->udp) {
+        struct objectinterface_udp* api = (struct objectinterface_udp*)s->transport->api;
+        (*api->close)(s->transport, s->udp);
+    }
+    if (0 != s->tcp) {
+        struct objectinterface_tcp* api = (struct objectinterface_tcp*)s->transport->api;
+        (*api->close)(s->transport, s->tcp);
+    }
+    memzero((uint8_t*)s, sizeof(struct socket));
+}
+
+void socket_close(uint64_t socket) {
+    struct socket* s = socket_get(socket);
+    if (0 != s) {
+        socket_release(s);
+    }
+}
+
+/*
+ * close everything a process has open, when it terminates
+ */
+void socket_close_process(uint64_t pid) {
+    for (uint16_t i = 0; i < SOCKET_MAX; i++) {
+        struct socket* s = &(socket_table[i]);
+        if ((s->open) && (s->owner == pid)) {
+            socket_release(s);
+        }
+    }
+}
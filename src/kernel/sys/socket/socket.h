@@ -0,0 +1,83 @@
+//*****************************************************************
+// This file is part of CosmOS                                    *
+// Copyright (C) 2021 Tom Everett                                 *
+// Released under the stated terms in the file LICENSE            *
+// See the file "LICENSE" in the source distribution for details  *
+// ****************************************************************
+/*
+ * sockets, for user processes, over the TCP and UDP objects.  a socket is a descriptor in one kernel wide table, but
+ * only the process that opened it can use it; to anyone else it isn't open.  a process's sockets are closed when it
+ * terminates.
+ *
+ * data doesn't go through the socket calls themselves.  the owner registers an array of messages with the socket
+ * once, and send and receive then move a batch of them at a time: send takes the first count messages from the
+ * array, receive fills in up to count of them.  so a process pays for one syscall per batch, not per datagram.
+ * on a datagram socket a message is one datagram, with its address; on a stream socket it is the next piece of
+ * the stream.
+ *
+ * nothing blocks.  poll says which sockets are ready, and a process sleeps when none are.
+ */
+#ifndef _SOCKET_H
+#define _SOCKET_H
+
+#include <types.h>
+
+#define SOCKET_MAX 64           // open sockets, across the kernel
+#define SOCKET_MESSAGES_MAX 64  // the most messages that can be registered on one socket
+
+// socket types
+#define SOCKET_TYPE_STREAM 1  // TCP
+#define SOCKET_TYPE_DGRAM 2   // UDP
+
+// the largest UDP payload that fits in an ethernet frame; bigger than a TCP segment too
+#define SOCKET_MESSAGE_DATA 1472
+
+// poll events
+#define SOCKET_POLL_IN 0x01    // there is something to receive or, on a listener, to accept
+#define SOCKET_POLL_OUT 0x02   // send will take something
+#define SOCKET_POLL_HUP 0x04   // the peer has finished sending; receive has the rest of the stream, then 0
+#define SOCKET_POLL_NVAL 0x08  // not an open socket
+
+/*
+ * ip and port are the destination of a datagram to send and the source of one received, in host byte order. a
+ * datagram sent to ip 0 goes to the address given to connect. size is the bytes of data in use
+ */
+struct socket_message {
+    uint32_t ip;
+    uint16_t port;
+    uint16_t size;
+    uint8_t data[SOCKET_MESSAGE_DATA];
+} __attribute__((packed));
+
+struct socket_poll {
+    uint64_t socket;
+    uint16_t events;   // SOCKET_POLL_IN and SOCKET_POLL_OUT, as wanted
+    uint16_t revents;  // what is ready; SOCKET_POLL_HUP and SOCKET_POLL_NVAL are reported unasked
+    uint32_t reserved;
+} __attribute__((packed));
+
+struct object;
+
+/*
+ * socket descriptors start at 1; 0 is failure.
+ * open makes a socket on a TCP or UDP object.
+ * bind opens a datagram socket on a port, or makes a stream socket listen on one.
+ * connect gives a datagram socket its default destination, opening it on an ephemeral port if it isn't bound yet,
+ * or starts a stream socket's connection; poll for SOCKET_POLL_OUT to see it established.
+ * accept returns a new socket for the next connection on a listener, or 0 if there isn't one waiting.
+ * send and receive return the number of messages moved. a stream message that only partly fits in the send buffer
+ * is left holding the rest, at the start of its data, and send stops there.
+ * poll returns the number of entries with anything in revents.
+ */
+uint64_t socket_open(struct object* transport);
+bool socket_register(uint64_t socket, struct socket_message* messages, uint16_t count);
+bool socket_bind(uint64_t socket, uint16_t port);
+bool socket_connect(uint64_t socket, uint32_t ip, uint16_t port);
+uint64_t socket_accept(uint64_t socket);
+uint16_t socket_send(uint64_t socket, uint16_t count);
+uint16_t socket_receive(uint64_t socket, uint16_t count);
+uint16_t socket_poll(struct socket_poll* polls, uint16_t count);
+void socket_close(uint64_t socket);
+void socket_close_process(uint64_t pid);
+
+#endif
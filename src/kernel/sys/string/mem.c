@@ -10,6 +10,18 @@
 #include <sys/debug/assert.h>
 #include <sys/string/mem.h>
 
+int8_t memcmp(const uint8_t* ptr1, const uint8_t* ptr2, uint64_t size) {
+    ASSERT_NOT_NULL(ptr1);
+    ASSERT_NOT_NULL(ptr2);
+
+    for (uint64_t i = 0; i < size; i++) {
+        if (ptr1[i] != ptr2[i]) {
+            return (ptr1[i] < ptr2[i]) ? -1 : 1;
+        }
+    }
+    return 0;
+}
+
 uint8_t* memcpy(uint8_t* restrict dstptr, const uint8_t* restrict srcptr, uint64_t size) {
     ASSERT_NOT_NULL(dstptr);
     ASSERT_NOT_NULL(srcptr);
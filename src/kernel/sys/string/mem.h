@@ -10,6 +10,7 @@
 
 #include <types.h>
 
+int8_t memcmp(const uint8_t* ptr1, const uint8_t* ptr2, uint64_t size);
 uint8_t* memcpy(uint8_t* restrict dstptr, const uint8_t* restrict srcptr, uint64_t size);
 uint8_t* memset(uint8_t* bufptr, uint8_t value, uint64_t size);
 uint8_t* memzero(uint8_t* bufptr, uint64_t size);
@@ -10,17 +10,25 @@
 
 kernel_spinlock dma_buf_lock;
 kernel_spinlock dma_list_lock;
+kernel_spinlock iobuffers_lock;
+kernel_spinlock object_table_lock;
 kernel_spinlock page_dir_lock;
 kernel_spinlock page_table_lock;
+kernel_spinlock pagecache_lock;
 kernel_spinlock proc_table_lock;
+kernel_spinlock swap_slot_lock;
 kernel_spinlock task_list_lock;
 
 void spinlocks_init() {
     dma_buf_lock = false;
     dma_list_lock = false;
+    iobuffers_lock = false;
+    object_table_lock = false;
     page_dir_lock = false;
     page_table_lock = false;
+    pagecache_lock = false;
     proc_table_lock = false;
+    swap_slot_lock = false;
     task_list_lock = false;
 
     return;
@@ -49,4 +57,15 @@ void spinlock_release(kernel_spinlock* lock) {
     *lock = false;
 
     return;
-}
\ No newline at end of file
+}
+
+bool spinlock_try_acquire(kernel_spinlock* lock) {
+    /*
+     * Takes the lock if it is free, and returns whether it did, for a caller
+     * that can't wait--one that may already hold it, say.
+     */
+    bool expected = false;
+    bool desired = true;
+
+    return __atomic_compare_exchange(lock, &expected, &desired, false, __ATOMIC_SEQ_CST, __ATOMIC_SEQ_CST);
+}
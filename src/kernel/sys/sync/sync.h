@@ -13,11 +13,16 @@ typedef volatile bool
 // spinlock.c
 extern kernel_spinlock dma_buf_lock;
 extern kernel_spinlock dma_list_lock;
+extern kernel_spinlock iobuffers_lock;
+extern kernel_spinlock object_table_lock;
 extern kernel_spinlock page_dir_lock;
 extern kernel_spinlock page_table_lock;
+extern kernel_spinlock pagecache_lock;
 extern kernel_spinlock proc_table_lock;
+extern kernel_spinlock swap_slot_lock;
 extern kernel_spinlock task_list_lock;
 
 void spinlocks_init();
 void spinlock_acquire(kernel_spinlock* lock);
-void spinlock_release(kernel_spinlock* lock);
\ No newline at end of file
+void spinlock_release(kernel_spinlock* lock);
+bool spinlock_try_acquire(kernel_spinlock* lock);
\ No newline at end of file
@@ -42,6 +42,16 @@ typedef enum syscalls {
     // object mgr
     SYSCALL_OBJMGR_GET_DEVICE_BY_NAME = 2800,
     SYSCALL_OBJMGR_GET_DEVICE_BY_HANDLE = 2801,
+    // socket
+    SYSCALL_SOCKET_OPEN = 2900,
+    SYSCALL_SOCKET_BIND = 2901,
+    SYSCALL_SOCKET_CONNECT = 2902,
+    SYSCALL_SOCKET_ACCEPT = 2903,
+    SYSCALL_SOCKET_REGISTER = 2904,
+    SYSCALL_SOCKET_SEND = 2905,
+    SYSCALL_SOCKET_RECEIVE = 2906,
+    SYSCALL_SOCKET_POLL = 2907,
+    SYSCALL_SOCKET_CLOSE = 2908,
     // max
     SYSCALL_MAX
 } syscalls;
@@ -17,6 +17,7 @@
 #include <sys/syscall/syscalls_objectmgr.h>
 #include <sys/syscall/syscalls_process.h>
 #include <sys/syscall/syscalls_serial.h>
+#include <sys/syscall/syscalls_socket.h>
 #include <types.h>
 
 syscall_handler syscall_table[SYSCALL_MAX];
@@ -79,4 +80,14 @@ void syscall_dispatcher_init() {
     syscall_add(SYSCALL_OBJMGR_GET_DEVICE_BY_HANDLE, &syscall_objectmgr_get_device_by_handle);
     // keyboard
     syscall_add(SYSCALL_KEYBOARD_READ, &syscall_keyboard_read);
+    // socket
+    syscall_add(SYSCALL_SOCKET_OPEN, &syscall_socket_open);
+    syscall_add(SYSCALL_SOCKET_BIND, &syscall_socket_bind);
+    syscall_add(SYSCALL_SOCKET_CONNECT, &syscall_socket_connect);
+    syscall_add(SYSCALL_SOCKET_ACCEPT, &syscall_socket_accept);
+    syscall_add(SYSCALL_SOCKET_REGISTER, &syscall_socket_register);
+    syscall_add(SYSCALL_SOCKET_SEND, &syscall_socket_send);
+    syscall_add(SYSCALL_SOCKET_RECEIVE, &syscall_socket_receive);
+    syscall_add(SYSCALL_SOCKET_POLL, &syscall_socket_poll);
+    syscall_add(SYSCALL_SOCKET_CLOSE, &syscall_socket_close);
 }
\ No newline at end of file
@@ -0,0 +1,93 @@
+//*****************************************************************
+// This file is part of CosmOS                                    *
+// Copyright (C) 2021 Tom Everett                                 *
+// Released under the stated terms in the file LICENSE            *
+// See the file "LICENSE" in the source distribution for details  *
+// ****************************************************************
+
+#include <sys/obj/object/object.h>
+#include <sys/obj/objectmgr/objectmgr.h>
+#include <sys/proc/proc.h>
+#include <sys/socket/socket.h>
+#include <sys/syscall/syscalls_socket.h>
+
+// the transports sockets are made on: the stack cosmos_logical_objs attaches first
+#define SYSCALL_SOCKET_TCP_DEVICE "tcp0"
+#define SYSCALL_SOCKET_UDP_DEVICE "udp0"
+
+/*
+ * the kernel reads and writes registered messages and poll entries in place, so they have to be wholly in the
+ * user half
+ */
+bool syscall_socket_user_range(uint64_t address, uint64_t size) {
+    if ((0 == address) || (address > USER_HALF_MAX_ADDR)) {
+        return false;
+    }
+    return (size <= (USER_HALF_MAX_ADDR - address + 1));
+}
+
+uint64_t syscall_socket_open(uint64_t syscall_id, struct syscall_args* args) {
+    struct object* transport = 0;
+    if (SOCKET_TYPE_STREAM == args->arg1) {
+        transport = objectmgr_find_object_by_name(SYSCALL_SOCKET_TCP_DEVICE);
+    } else if (SOCKET_TYPE_DGRAM == args->arg1) {
+        transport = objectmgr_find_object_by_name(SYSCALL_SOCKET_UDP_DEVICE);
+    }
+    if (0 == transport) {
+        return 0;
+    }
+    return socket_open(transport);
+}
+
+uint64_t syscall_socket_bind(uint64_t syscall_id, struct syscall_args* args) {
+    if (args->arg2 > 0xFFFF) {
+        return 0;
+    }
+    return socket_bind(args->arg1, args->arg2);
+}
+
+uint64_t syscall_socket_connect(uint64_t syscall_id, struct syscall_args* args) {
+    if ((args->arg2 > 0xFFFFFFFF) || (args->arg3 > 0xFFFF)) {
+        return 0;
+    }
+    return socket_connect(args->arg1, args->arg2, args->arg3);
+}
+
+uint64_t syscall_socket_accept(uint64_t syscall_id, struct syscall_args* args) {
+    return socket_accept(args->arg1);
+}
+
+uint64_t syscall_socket_register(uint64_t syscall_id, struct syscall_args* args) {
+    if ((0 == args->arg3) || (args->arg3 > SOCKET_MESSAGES_MAX) ||
+        (!syscall_socket_user_range(args->arg2, args->arg3 * sizeof(struct socket_message)))) {
+        return 0;
+    }
+    return socket_register(args->arg1, (struct socket_message*)args->arg2, args->arg3);
+}
+
+uint64_t syscall_socket_send(uint64_t syscall_id, struct syscall_args* args) {
+    if (args->arg2 > SOCKET_MESSAGES_MAX) {
+        return 0;
+    }
+    return socket_send(args->arg1, args->arg2);
+}
+
+uint64_t syscall_socket_receive(uint64_t syscall_id, struct syscall_args* args) {
+    if (args->arg2 > SOCKET_MESSAGES_MAX) {
+        return 0;
+    }
+    return socket_receive(args->arg1, args->arg2);
+}
+
+uint64_t syscall_socket_poll(uint64_t syscall_id, struct syscall_args* args) {
+    if ((0 == args->arg2) || (args->arg2 > SOCKET_MAX) ||
+        (!syscall_socket_user_range(args->arg1, args->arg2 * sizeof(struct socket_poll)))) {
+        return 0;
+    }
+    return socket_poll((struct socket_poll*)args->arg1, args->arg2);
+}
+
+uint64_t syscall_socket_close(uint64_t syscall_id, struct syscall_args* args) {
+    socket_close(args->arg1);
+    return 0;
+}
@@ -0,0 +1,24 @@
+//*****************************************************************
+// This file is part of CosmOS                                    *
+// Copyright (C) 2021 Tom Everett                                 *
+// Released under the stated terms in the file LICENSE            *
+// See the file "LICENSE" in the source distribution for details  *
+// ****************************************************************
+
+#ifndef _SYSCALLS_SOCKET_H
+#define _SYSCALLS_SOCKET_H
+
+#include <sys/syscall/syscall.h>
+#include <types.h>
+
+uint64_t syscall_socket_open(uint64_t syscall_id, struct syscall_args* args);
+uint64_t syscall_socket_bind(uint64_t syscall_id, struct syscall_args* args);
+uint64_t syscall_socket_connect(uint64_t syscall_id, struct syscall_args* args);
+uint64_t syscall_socket_accept(uint64_t syscall_id, struct syscall_args* args);
+uint64_t syscall_socket_register(uint64_t syscall_id, struct syscall_args* args);
+uint64_t syscall_socket_send(uint64_t syscall_id, struct syscall_args* args);
+uint64_t syscall_socket_receive(uint64_t syscall_id, struct syscall_args* args);
+uint64_t syscall_socket_poll(uint64_t syscall_id, struct syscall_args* args);
+uint64_t syscall_socket_close(uint64_t syscall_id, struct syscall_args* args);
+
+#endif
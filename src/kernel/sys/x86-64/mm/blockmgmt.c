@@ -8,6 +8,7 @@
 #include <sys/debug/assert.h>
 #include <sys/kmalloc/kmalloc.h>
 #include <sys/x86-64/mm/mm.h>
+#include <sys/x86-64/mm/pagetables.h>
 #include <types.h>
 
 mem_block* find_containing_block(void* addr, mem_block* list) {
@@ -56,4 +57,11 @@ int_15_map* read_int_15_map(uint8_t* num_blocks, uint8_t* lrg_block) {
     *num_blocks = i;
 
     return map;
+}
+
+// boot3.asm fills this in, after loading the initrd
+const uint16_t initrd_info_addr = 0xF000;
+
+boot_initrd_info* read_boot_initrd_info() {
+    return (boot_initrd_info*)CONV_PHYS_ADDR(initrd_info_addr);
 }
\ No newline at end of file
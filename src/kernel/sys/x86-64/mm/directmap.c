@@ -14,6 +14,7 @@
 #include <types.h>
 
 int_15_map find_suitable_block(int_15_map* phys_map, uint8_t num_blocks, void* min, uint64_t space);
+void* map_direct_range(pttentry cr3, uint64_t start, uint64_t end, void* cur_phys_loc, void* safe_base, bool giant);
 uint64_t size_pd(uint64_t space);
 
 void* adjust_cur_phys_loc(void* cur_phys_loc, void* safe_base) {
@@ -60,6 +61,9 @@ int_15_map find_suitable_block(int_15_map* phys_map, uint8_t num_blocks, void* m
      * have at least one table at each level.
      * How many levels depends on page size, and furthermore each table, regardless of how many
      * entries it has, takes up a full 4KB.
+     *
+     * The direct map itself uses large pages now (see map_direct_range), so this is a generous
+     * overestimate, which does no harm.
      */
 
     if (PAGE_SIZE == 4096) {
@@ -152,17 +156,89 @@ int_15_map find_suitable_block(int_15_map* phys_map, uint8_t num_blocks, void* m
     return phys_map[best];
 }
 
+void* map_direct_range(pttentry cr3, uint64_t start, uint64_t end, void* cur_phys_loc, void* safe_base, bool giant) {
+    /*
+     * Direct-maps the physical range from start up to (but not including)
+     * end, using large pages: 1GB PDP entries when giant is set and the range
+     * covers a whole aligned gigabyte, and 2MB PD entries otherwise.  start is
+     * rounded down to a 2MB boundary, and the last 2MB page may extend past
+     * end.  Any tables we need are carved out at cur_phys_loc, and the updated
+     * location is returned.
+     */
+    uint64_t addr;
+    void* active_virt_loc;
+    uint16_t idx;
+    pttentry *pml4, *pdp, *pd;
+
+    pml4 = (pttentry*)PTT_EXTRACT_BASE(cr3);
+
+    addr = start - (start % HUGE_PAGE_SIZE);
+
+    while (addr < end) {
+        active_virt_loc = (void*)(addr + DIRECT_MAP_OFFSET);
+
+        idx = vaddr_ptt_index(active_virt_loc, PML4);
+
+        /*
+         * Bootloader clears PML4 area for us, so we can count on this being a
+         * reliable test as to whether there is already an entry there or not.  If
+         * there is, we follow it; if not, we write a new one.
+         */
+        if (!pml4[idx]) {
+            // Clear the page table we're about to point to in PML4 and set up
+            memset(PTT_ADJUST_BASE(cur_phys_loc), 0, PAGE_SIZE);
+            pml4[idx] = ptt_entry_create(cur_phys_loc, true, true, false);
+            cur_phys_loc = adjust_cur_phys_loc(cur_phys_loc, safe_base);
+        }
+
+        pdp = (pttentry*)PTT_ADJUST_BASE(PTT_EXTRACT_BASE(pml4[idx]));
+        idx = vaddr_ptt_index(active_virt_loc, PDP);
+
+        // Already covered by a 1GB page on an earlier pass
+        if (pdp[idx] & PTT_FLAG_PS) {
+            addr = addr - (addr % GIANT_PAGE_SIZE) + GIANT_PAGE_SIZE;
+            continue;
+        }
+
+        if (giant && !pdp[idx] && !(addr % GIANT_PAGE_SIZE) && ((end - addr) >= GIANT_PAGE_SIZE)) {
+            pdp[idx] = ptt_entry_create((void*)addr, true, true, false) | PTT_FLAG_PS;
+            tlb_invalidate_kernel();
+            addr += GIANT_PAGE_SIZE;
+            continue;
+        }
+
+        /*
+         * And, similarly, bootloader or kernel will clear newly-assigned page
+         * table areas at all levels.
+         */
+        if (!pdp[idx]) {
+            memset(PTT_ADJUST_BASE(cur_phys_loc), 0, PAGE_SIZE);
+            pdp[idx] = ptt_entry_create(cur_phys_loc, true, true, false);
+            cur_phys_loc = adjust_cur_phys_loc(cur_phys_loc, safe_base);
+        }
+
+        pd = (pttentry*)PTT_ADJUST_BASE(PTT_EXTRACT_BASE(pdp[idx]));
+        idx = vaddr_ptt_index(active_virt_loc, PD);
+
+        if (!pd[idx]) {
+            pd[idx] = ptt_entry_create((void*)addr, true, true, false) | PTT_FLAG_PS;
+            tlb_invalidate_kernel();
+        }
+
+        addr += HUGE_PAGE_SIZE;
+    }
+
+    return cur_phys_loc;
+}
+
 void* setup_direct_map(int_15_map* phys_map, uint8_t num_blocks) {
     ptt_t cr3;
-    void* active_virt_loc;
     void* cur_phys_loc = (void*)EARLY_PAGE_TABLE_PHYS_BASE;
-    uint64_t i;
-    uint16_t idx;
     int_15_map best_block;
     void* last_phys_addr = 0;
     uint64_t num_phys_pages;
-    pttentry *pml4, *pdp, *pd, *pt;
     void* dmap_start = 0;
+    bool giant;
 
     kprintf("Initializing Direct Map...\n");
 
@@ -210,138 +286,36 @@ void* setup_direct_map(int_15_map* phys_map, uint8_t num_blocks) {
 
     cr3 = asm_cr3_read();
 
-    /*
-     * Now we loop through.  We start at the virtual address that will
-     * correspond to the first address of the physical block we're using, and
-     * map pages until we reach the end of the address space.  Then we do
-     * another loop to start at 0, and stop when we get up to where we started.
-     * Even though we're direct-mapping all the physical space, we'll start with
-     * the block we found above so we can start putting stuff in it ASAP, before
-     * we run out of room in the ID-mapped first megabyte
-     */
+    giant = cpu_has_giant_pages();
+    if (giant) {
+        kprintf("   Direct map using 1GB pages\n");
+    }
 
     /*
-     * Zero-based numbering works to our advantage here: because unsigned
-     * integer division truncates, the value of best_block.base/PAGE_SIZE will
-     * be the zero-based index of the page #. For example, 0/4096 = 0,
-     * 4095/4096=0, 4096/4096=1, etc. Keep in mind, though, that num_phys_pages
-     * is a 1-based count.
+     * The direct map is built from large pages, so there is no PT level at
+     * all, and only a handful of PDP and PD tables are needed to cover even a
+     * large physical address space.  That means far fewer page tables to
+     * allocate here and far fewer TLB entries consumed at runtime.
+     *
+     * We start at the 2MB page containing the physical block we're using, and
+     * map up to the end of the address space.  Then we do another pass to
+     * start at 0, and stop when we get up to where we started.  Even though
+     * we're direct-mapping all the physical space, we'll start with the block
+     * we found above so we can start putting stuff in it ASAP, before we run
+     * out of room in the ID-mapped first megabyte.
      */
+    cur_phys_loc = map_direct_range(cr3, (uint64_t)dmap_start, num_phys_pages * PAGE_SIZE, cur_phys_loc, dmap_start,
+                                    giant);
 
-    for (i = (uint64_t)dmap_start / PAGE_SIZE; i < num_phys_pages; i++) {
-        /*
-         * This loop performs a lot of unncessary checks of the higher levels
-         * of the page-table hierarchy.  We can optimize that later if it
-         * becomes an issue.
-         */
-
-        active_virt_loc = (void*)((i * PAGE_SIZE) + DIRECT_MAP_OFFSET);
-
-        pml4 = (pttentry*)PTT_EXTRACT_BASE(cr3);
-        idx = vaddr_ptt_index(active_virt_loc, PML4);
-
-        /*
-         * Bootloader clears PML4 area for us, so we can count on this being a
-         * reliable test as to whether there is already an entry there or not.  If
-         * there is, we follow it; if not, we write a new one.
-         */
-        if (!pml4[idx]) {
-            // Clear the page table we're about to point to in PML4 and set up
-            memset(PTT_ADJUST_BASE(cur_phys_loc), 0, PAGE_SIZE);
-            pml4[idx] = ptt_entry_create(cur_phys_loc, true, true, false);
-            cur_phys_loc = adjust_cur_phys_loc(cur_phys_loc, dmap_start);
-        }
-
-        pdp = (pttentry*)PTT_ADJUST_BASE(PTT_EXTRACT_BASE(pml4[idx]));
-        idx = vaddr_ptt_index(active_virt_loc, PDP);
-
-        /*
-         * And, similarly, bootloader or kernel will clear newly-assigned page
-         * table areas at all levels.
-         */
-
-        if (!pdp[idx]) {
-            memset(PTT_ADJUST_BASE(cur_phys_loc), 0, PAGE_SIZE);
-            pdp[idx] = ptt_entry_create(cur_phys_loc, true, true, false);
-            cur_phys_loc = adjust_cur_phys_loc(cur_phys_loc, dmap_start);
-        }
+    cur_phys_loc = map_direct_range(cr3, 0, (uint64_t)best_block.base, cur_phys_loc, dmap_start, giant);
 
-        pd = (pttentry*)PTT_ADJUST_BASE(PTT_EXTRACT_BASE(pdp[idx]));
-        idx = vaddr_ptt_index(active_virt_loc, PD);
-
-        if (!pd[idx]) {
-            memset(PTT_ADJUST_BASE(cur_phys_loc), 0, PAGE_SIZE);
-            pd[idx] = ptt_entry_create(cur_phys_loc, true, true, false);
-            cur_phys_loc = adjust_cur_phys_loc(cur_phys_loc, dmap_start);
-        }
-
-        pt = (pttentry*)PTT_ADJUST_BASE(PTT_EXTRACT_BASE(pd[idx]));
-        idx = vaddr_ptt_index(active_virt_loc, PT);
-
-        if (!pt[idx]) {
-            pt[idx] = ptt_entry_create((void*)(i * PAGE_SIZE), true, true, false);
-        }
-
-        asm_cr3_reload();
-    }
-
-    // And now, starting from 0 up to where we started the last loop
-
-    for (i = 0; i < (uint64_t)best_block.base / PAGE_SIZE; i++) {
-        /*
-         * This loop performs a lot of unncessary checks of the higher levels
-         * of the page-table hierarchy.  We can optimize that later if it
-         * becomes an issue.
-         */
-
-        active_virt_loc = (void*)((i * PAGE_SIZE) + DIRECT_MAP_OFFSET);
-
-        pml4 = (pttentry*)PTT_EXTRACT_BASE(cr3);
-        idx = vaddr_ptt_index(active_virt_loc, PML4);
-
-        /*
-         * Bootloader clears PML4 area for us, so we can count on this being a
-         * reliable test as to whether there is already an entry there or not.  If
-         * there is, we follow it; if not, we write a new one.
-         */
-        if (!pml4[idx]) {
-            // Clear the page table we're about to point to in PML4 and set up
-            memset(PTT_ADJUST_BASE(cur_phys_loc), 0, PAGE_SIZE);
-            pml4[idx] = ptt_entry_create(cur_phys_loc, true, true, false);
-            cur_phys_loc = adjust_cur_phys_loc(cur_phys_loc, dmap_start);
-        }
-
-        pdp = (pttentry*)PTT_ADJUST_BASE(PTT_EXTRACT_BASE(pml4[idx]));
-        idx = vaddr_ptt_index(active_virt_loc, PDP);
-
-        /*
-         * And, similarly, bootloader or kernel will clear newly-assigned page
-         * table areas at all levels.
-         */
-
-        if (!pdp[idx]) {
-            memset(PTT_ADJUST_BASE(cur_phys_loc), 0, PAGE_SIZE);
-            pdp[idx] = ptt_entry_create(cur_phys_loc, true, true, false);
-            cur_phys_loc = adjust_cur_phys_loc(cur_phys_loc, dmap_start);
-        }
-
-        pd = (pttentry*)PTT_ADJUST_BASE(PTT_EXTRACT_BASE(pdp[idx]));
-        idx = vaddr_ptt_index(active_virt_loc, PD);
-
-        if (!pd[idx]) {
-            memset(PTT_ADJUST_BASE(cur_phys_loc), 0, PAGE_SIZE);
-            pd[idx] = ptt_entry_create(cur_phys_loc, true, true, false);
-            cur_phys_loc = adjust_cur_phys_loc(cur_phys_loc, dmap_start);
-        }
-
-        pt = (pttentry*)PTT_ADJUST_BASE(PTT_EXTRACT_BASE(pd[idx]));
-        idx = vaddr_ptt_index(active_virt_loc, PT);
-
-        if (!pt[idx]) {
-            pt[idx] = ptt_entry_create((void*)(i * PAGE_SIZE), true, true, false);
-        }
-
-        asm_cr3_reload();
+    /*
+     * With large pages, the tables may all have fit in the early page table
+     * area, in which case the page directory simply starts at the beginning of
+     * the block we chose.  It must never land in the early area itself.
+     */
+    if (cur_phys_loc < dmap_start) {
+        return CONV_PHYS_ADDR(dmap_start);
     }
 
     // Return the first address after the direct-map page tables
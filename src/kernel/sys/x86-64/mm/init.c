@@ -54,6 +54,13 @@ void mmu_init() {
 
     setup_tss();
 
+    tlb_init();
+
+    reclaim_init();
+
+    // so that the kernel writing to a copy-on-write page, on behalf of a process, gets it copied
+    asm_cr0_write(asm_cr0_read() | CR0_WP);
+
     return;
 }
 
@@ -38,6 +38,19 @@
 
 #define TSS_SELECTOR 40
 
+#define CR0_WP (1 << 16)  // the kernel's writes to read-only pages fault too
+
+// TLB management
+#define TLB_PCID_COUNT 4096
+#define TLB_BATCH_MAX 32                     // past this many pages, a batch does a full flush instead
+#define CR3_PCID_NOFLUSH 0x8000000000000000  // keep the new PCID's cached translations when loading cr3
+#define CR4_PGE (1 << 7)  // changing it flushes every PCID, global pages included
+#define CR4_PCIDE (1 << 17)
+#define CPUID_FEAT_ECX_PCID (1 << 17)
+#define CPUID_FEAT_EBX_INVPCID (1 << 10)  // leaf 7
+#define INVPCID_ALL_CONTEXTS 2
+#define TLB_KERNEL_HALF_START 0xFFFF800000000000  // translations from here up are kernel ones, in every address space
+
 // defined in cosmos.ld
 extern uint64_t _end;
 
@@ -75,6 +88,20 @@ typedef struct int_15_map {
     uint32_t acpi;
 } __attribute__((packed)) int_15_map;
 
+// Where the boot loader put the initrd, if it loaded it.  base and size are zero if it didn't
+typedef struct boot_initrd_info {
+    uint64_t base;  // physical
+    uint64_t size;
+} __attribute__((packed)) boot_initrd_info;
+
+// A set of pages in one address space whose translations need invalidating
+typedef struct tlb_batch_t {
+    pttentry cr3;
+    uint64_t count;
+    bool kernel;  // some of the pages are in the kernel half
+    void* pages[TLB_BATCH_MAX];
+} tlb_batch_t;
+
 typedef struct tss64_t {
     DWORD reserved;  // always = 0
     QWORD rsp0;
@@ -107,6 +134,7 @@ typedef struct tss64_descriptor_t {
 // blockmgmt.c
 mem_block* find_containing_block(void* addr, mem_block* list);
 int_15_map* read_int_15_map(uint8_t* num_blocks, uint8_t* lrg_block);
+boot_initrd_info* read_boot_initrd_info();
 
 // init.c
 extern uint64_t future_pt_expansion[3];
@@ -122,6 +150,7 @@ void* find_aligned_after(void* address, uint64_t alignment);
 void* find_last_phys_addr(int_15_map* phys_map, uint8_t num_blocks);
 
 // pagefault.c
+bool cow_fault(void* vaddr, pttentry cr3);
 void page_fault_handler(uint64_t error, void* cr2, pttentry cr3);
 
 // pagetables.c
@@ -132,8 +161,33 @@ pttentry* extract_pttentry_base_address(pttentry entry);
 uint16_t vaddr_ptt_index(void* address, ptt_levels level);
 void* vaddr_to_physical(void* address, pttentry cr3);
 
+// reclaim.c
+struct object;
+extern struct object* reclaim_swap;
+bool reclaim_fault_in(void* vaddr, pttentry cr3);
+void reclaim_init();
+uint64_t reclaim_pages(uint64_t count);
+bool reclaim_set_swap(struct object* swap);
+void reclaim_track_page(uint64_t page, pttentry cr3, void* vaddr);
+void reclaim_untrack_page(uint64_t page);
+
 // slab.c
 uint64_t slab_allocate(uint64_t pages, page_directory_types purpose);
+uint64_t slab_allocate_aligned(uint64_t pages, uint64_t alignment, page_directory_types purpose);
+uint64_t slab_allocate_noreclaim(uint64_t pages, page_directory_types purpose);
 void slab_free(uint64_t start, uint64_t len);
 
+// tlb.c
+extern bool tlb_pcid_enabled;
+void tlb_batch_add(tlb_batch_t* batch, void* vaddr);
+void tlb_batch_add_range(tlb_batch_t* batch, void* vaddr, uint64_t pages);
+void tlb_batch_flush(tlb_batch_t* batch);
+void tlb_batch_init(tlb_batch_t* batch, pttentry cr3);
+void tlb_init();
+void tlb_invalidate_all();
+void tlb_invalidate_kernel();
+void tlb_invalidate_page(pttentry cr3, void* vaddr);
+void tlb_release_address_space(pttentry cr3);
+pttentry tlb_switch_cr3(pttentry cr3);
+
 #endif
\ No newline at end of file
@@ -5,21 +5,85 @@
  * See the file "LICENSE" in the source distribution for details *
  *****************************************************************/
 
-#include <sys/asm/misc.h>
+#include <sys/panic/panic.h>
+#include <sys/string/mem.h>
+#include <sys/sync/sync.h>
 #include <sys/x86-64/mm/mm.h>
 #include <sys/x86-64/mm/pagetables.h>
 #include <types.h>
 
+bool cow_fault(void* vaddr, pttentry cr3) {
+    /*
+     * Called by the page fault handler for a write to a present page.  If the
+     * page was mapped copy-on-write, copy it, map the copy writable where it
+     * was, and return true.  The shared page itself is never written.
+     */
+    pttentry* pte;
+    pttentry entry;
+    uint64_t page;
+    bool user;
+
+    spinlock_acquire(&page_table_lock);
+
+    pte = find_pt_entry(vaddr, cr3);
+    if (!pte || !(*pte & PTT_FLAG_PRESENT) || !(*pte & PTT_FLAG_COW)) {
+        spinlock_release(&page_table_lock);
+        return false;
+    }
+
+    entry = *pte;
+
+    spinlock_release(&page_table_lock);
+
+    user = (entry & PTT_FLAG_USER) ? true : false;
+
+    page = slab_allocate(1, PDT_INUSE);
+    if (!page) {
+        PANIC("Out of memory copying a copy-on-write page!");
+    }
+
+    memcpy(CONV_PHYS_ADDR(page * PAGE_SIZE), CONV_PHYS_ADDR(PTT_EXTRACT_BASE(entry)), PAGE_SIZE);
+
+    spinlock_acquire(&page_table_lock);
+    pte = find_pt_entry(vaddr, cr3);
+    *pte = ptt_entry_create((void*)(page * PAGE_SIZE), true, true, user);
+    spinlock_release(&page_table_lock);
+
+    // The copy is the process's own, so it can be swapped out like any other
+    if (user) {
+        reclaim_track_page(page, cr3, vaddr);
+    }
+
+    return true;
+}
+
 void page_fault_handler(uint64_t error, void* cr2, pttentry cr3) {
     uint64_t page;
+    bool user;
 
     // note that the PFE_ERROR_PRESENT flag is zero if the flag is NOT present
     if (!(error & PFE_ERROR_PRESENT)) {
+        // A page we evicted earlier?  Then bring it back rather than handing out a fresh one
+        if (reclaim_fault_in(cr2, cr3)) {
+            tlb_invalidate_page(cr3, cr2);
+            return;
+        }
+
+        user = (error & PFE_ERROR_USER) ? true : false;
+
         page = slab_allocate(1, PDT_INUSE);
 
-        map_page_at(page, cr2, asm_cr3_read(), false);
+        map_page_at(page, cr2, cr3, user);
+
+        // Pages faulted in by userland belong to nobody else, so they can be swapped out
+        if (user) {
+            reclaim_track_page(page, cr3, cr2);
+        }
 
-        asm_cr3_reload();
+        // Only the one page changed, so there's no need to flush the whole TLB
+        tlb_invalidate_page(cr3, cr2);
+    } else if ((error & PFE_ERROR_WRITE) && cow_fault(cr2, cr3)) {
+        tlb_invalidate_page(cr3, cr2);
     }
 
     return;
@@ -57,21 +57,26 @@ bool is_page_allocated(void* address) {
 
     cr3 = asm_cr3_read();
 
-    pml4_base = extract_cr3_base_address(cr3);
+    pml4_base = CONV_PHYS_ADDR(extract_cr3_base_address(cr3));
     pml4_index = vaddr_ptt_index(address, PML4);
     pml4_entry = pml4_base[pml4_index];
     if (!pml4_entry) {
         return false;
     }
 
-    pdp_base = extract_pttentry_base_address(pml4_entry);
+    pdp_base = CONV_PHYS_ADDR(extract_pttentry_base_address(pml4_entry));
     pdp_index = vaddr_ptt_index(address, PDP);
     pdp_entry = pdp_base[pdp_index];
     if (!pdp_entry) {
         return false;
     }
 
-    pd_base = extract_pttentry_base_address(pdp_entry);
+    // a 1GB page
+    if (pdp_entry & PTT_FLAG_PS) {
+        return true;
+    }
+
+    pd_base = CONV_PHYS_ADDR(extract_pttentry_base_address(pdp_entry));
     pd_index = vaddr_ptt_index(address, PD);
     pd_entry = pd_base[pd_index];
 
@@ -79,16 +84,101 @@ bool is_page_allocated(void* address) {
         return false;
     }
 
-    pt_base = extract_pttentry_base_address(pd_entry);
+    // a 2MB page
+    if (pd_entry & PTT_FLAG_PS) {
+        return true;
+    }
+
+    pt_base = CONV_PHYS_ADDR(extract_pttentry_base_address(pd_entry));
     pt_index = vaddr_ptt_index(address, PT);
     pt_entry = pt_base[pt_index];
-    if (!pt_entry) {
+
+    // an evicted page leaves a non-zero entry behind, so check the present bit
+    if (!(pt_entry & PTT_FLAG_PRESENT)) {
         return false;
     }
 
     return true;
 }
 
+bool cpu_has_giant_pages() {
+    uint32_t eax, ebx, ecx, edx;
+
+    // Make sure the extended leaf exists before asking it anything
+    asm_cpuid(0x80000000, 0, &eax, &ebx, &ecx, &edx);
+    if (eax < CPUID_EXT_FEATURES) {
+        return false;
+    }
+
+    asm_cpuid(CPUID_EXT_FEATURES, 0, &eax, &ebx, &ecx, &edx);
+
+    return (edx & CPUID_EXT_EDX_PAGE1GB) ? true : false;
+}
+
+pttentry* find_pt_entry(void* vaddr, pttentry pml4_entry) {
+    /*
+     * Returns a pointer to the PT-level entry for vaddr in the address space
+     * specified by pml4_entry, whether or not it's present, or NULL if there is
+     * no page table covering vaddr (including when it's mapped by a large
+     * page).  Unlike obtain_ptt_entry(), this never creates or splits tables.
+     *
+     * Caller should hold page_table_lock if it means to modify the entry.
+     */
+    pttentry* table;
+    pttentry entry;
+    ptt_levels level;
+
+    entry = pml4_entry;
+
+    for (level = PML4; level < PT; level++) {
+        table = CONV_PHYS_ADDR(PTT_EXTRACT_BASE(entry));
+        entry = table[vaddr_ptt_index(vaddr, level)];
+
+        if (!(entry & PTT_FLAG_PRESENT) || ((level != PML4) && (entry & PTT_FLAG_PS))) {
+            return NULL;
+        }
+    }
+
+    table = CONV_PHYS_ADDR(PTT_EXTRACT_BASE(entry));
+
+    return &table[vaddr_ptt_index(vaddr, PT)];
+}
+
+bool map_huge_page_at(uint64_t page, void* vaddr, pttentry pml4_entry, bool user) {
+    /*
+     * Maps the 2MB physical range starting at page (which must be 2MB-aligned)
+     * with a single PD entry.  Returns false, and maps nothing, if any part of
+     * the 2MB virtual range containing vaddr is already mapped--callers should
+     * fall back on map_page_at() in that case.
+     */
+    void* vaddr_huge_base;
+    pttentry pdp_entry, pd_entry;
+    pttentry* pd;
+    uint16_t index;
+    bool ret = false;
+
+    ASSERT(!(page % PAGES_PER_HUGE_PAGE));
+
+    spinlock_acquire(&page_table_lock);
+
+    vaddr_huge_base = (void*)(((uint64_t)vaddr / HUGE_PAGE_SIZE) * HUGE_PAGE_SIZE);
+
+    pdp_entry = obtain_ptt_entry(vaddr_huge_base, pml4_entry, PML4, user);
+    pd_entry = obtain_ptt_entry(vaddr_huge_base, pdp_entry, PDP, user);
+
+    pd = CONV_PHYS_ADDR(PTT_EXTRACT_BASE(pd_entry));
+    index = vaddr_ptt_index(vaddr_huge_base, PD);
+
+    if (!pd[index]) {
+        pd[index] = ptt_entry_create((void*)(page * PAGE_SIZE), true, true, user) | PTT_FLAG_PS;
+        ret = true;
+    }
+
+    spinlock_release(&page_table_lock);
+
+    return ret;
+}
+
 void map_page_at(uint64_t page, void* vaddr, pttentry pml4_entry, bool user) {
     void* vaddr_page_base;
     pttentry pdp_entry, pd_entry, pt_entry;
@@ -108,6 +198,54 @@ void map_page_at(uint64_t page, void* vaddr, pttentry pml4_entry, bool user) {
     return;
 }
 
+void map_pages_at(uint64_t page, uint64_t count, void* vaddr, pttentry pml4_entry, bool user) {
+    /*
+     * Maps count physically-contiguous pages, starting at page, to the
+     * virtual addresses starting at vaddr.  Wherever both the physical and
+     * virtual addresses are 2MB-aligned and at least 2MB remain to be mapped,
+     * we use a single PD-level entry rather than 512 PT entries, which saves
+     * both page-table memory and TLB entries.
+     */
+    uint64_t i = 0;
+    void* cur_vaddr;
+
+    while (i < count) {
+        cur_vaddr = vaddr + (i * PAGE_SIZE);
+
+        if (!((page + i) % PAGES_PER_HUGE_PAGE) && !((uint64_t)cur_vaddr % HUGE_PAGE_SIZE) &&
+            ((count - i) >= PAGES_PER_HUGE_PAGE) && map_huge_page_at(page + i, cur_vaddr, pml4_entry, user)) {
+            i += PAGES_PER_HUGE_PAGE;
+        } else {
+            map_page_at(page + i, cur_vaddr, pml4_entry, user);
+            i++;
+        }
+    }
+
+    return;
+}
+
+void map_pages_cow_at(uint64_t page, uint64_t count, void* vaddr, pttentry pml4_entry, bool user) {
+    /*
+     * Maps count physically-contiguous pages that belong to something else
+     * (the initrd, when the boot loader left it in memory) a page at a time,
+     * read-only and flagged copy-on-write.  The first write to one of them
+     * gets the writer a copy of its own--see cow_fault().
+     */
+    uint64_t i;
+    pttentry* pte;
+
+    for (i = 0; i < count; i++) {
+        map_page_at(page + i, vaddr + (i * PAGE_SIZE), pml4_entry, user);
+
+        spinlock_acquire(&page_table_lock);
+        pte = find_pt_entry(vaddr + (i * PAGE_SIZE), pml4_entry);
+        *pte = (*pte & ~((pttentry)PTT_FLAG_RW)) | PTT_FLAG_COW;
+        spinlock_release(&page_table_lock);
+    }
+
+    return;
+}
+
 pttentry obtain_ptt_entry(virt_addr* vaddr, pttentry parent_entry, ptt_levels level, bool user) {
     uint16_t index;
     pttentry* base;
@@ -125,6 +263,14 @@ pttentry obtain_ptt_entry(virt_addr* vaddr, pttentry parent_entry, ptt_levels le
         reserve_next_ptt(level + 1, future_pt_expansion);
         memset((void*)CONV_PHYS_ADDR((new_ptt_page * PAGE_SIZE)), 0, PAGE_SIZE);
         base[index] = ptt_entry_create((void*)(new_ptt_page * PAGE_SIZE), true, true, user);
+    } else if ((level != PML4) && (base[index] & PTT_FLAG_PS)) {
+        /*
+         * vaddr falls within a large page, so there is no lower-level table to
+         * return.  Break the large page up into a table of smaller pages that
+         * map exactly the same range, so the caller can change just the part
+         * it's interested in.
+         */
+        ptt_split_huge_entry(&base[index], level);
     }
 
     return base[index];
@@ -159,18 +305,112 @@ pttentry ptt_entry_create(void* base_address, bool present, bool rw, bool user)
     return r;
 }
 
+void ptt_split_huge_entry(pttentry* entry, ptt_levels level) {
+    /*
+     * Replace the large-page entry pointed to by entry, which lives in a table
+     * at the specified level, with a pointer to a new next-level table whose
+     * 512 entries together map the same physical range with the same flags.
+     * Splitting a 1GB PDP entry yields 2MB PD entries (which keep
+     * PTT_FLAG_PS); splitting a 2MB PD entry yields 4KB PT entries.
+     *
+     * Caller must hold page_table_lock.
+     */
+    pttentry* new_table;
+    uint64_t new_ptt_page;
+    uint64_t base, flags, step;
+    uint16_t i;
+
+    ASSERT((level == PDP) || (level == PD));
+    ASSERT((*entry & PTT_FLAG_PS));
+
+    base = PTT_EXTRACT_BASE(*entry);
+    flags = *entry & PTT_FLAGS_MASK;
+
+    if (level == PDP) {
+        step = HUGE_PAGE_SIZE;
+    } else {
+        step = PAGE_SIZE;
+        flags &= ~((uint64_t)PTT_FLAG_PS);
+    }
+
+    new_ptt_page = future_pt_expansion[level];
+    reserve_next_ptt(level + 1, future_pt_expansion);
+    new_table = CONV_PHYS_ADDR(new_ptt_page * PAGE_SIZE);
+
+    for (i = 0; i < 512; i++) {
+        new_table[i] = (base + (i * step)) | flags;
+    }
+
+    *entry = ptt_entry_create((void*)(new_ptt_page * PAGE_SIZE), true, true, (flags & PTT_FLAG_USER) ? true : false);
+
+    return;
+}
+
 void reserve_next_ptt(ptt_levels level, uint64_t* expansion) {
     /*
      * This function does not handle the situation where a page cannot be
      * reserved, because how to handle it may vary based on circumstances.
      * Caller must therefore ensure that a page was reserved as requested, and
      * act accordingly if it was not.
+     *
+     * Callers hold page_table_lock, so this mustn't reclaim: reclaiming takes
+     * that lock too.
      */
 
     ASSERT((level == PDP) || (level == PD) || (level == PT));
 
     // PDP = 1 because PML4 = 0, so we subtract 1 to get the proper array index
-    expansion[level - 1] = slab_allocate(1, PDT_SYSTEM_RESERVED);
+    expansion[level - 1] = slab_allocate_noreclaim(1, PDT_SYSTEM_RESERVED);
+}
+
+void unmap_page_at(void* vaddr, pttentry pml4_entry) {
+    /*
+     * Removes the 4KB mapping for vaddr, if there is one.  If vaddr is covered
+     * by a large page, the large page is split first so that only the one 4KB
+     * page goes away and the rest of the range stays mapped.  The physical
+     * page itself is not freed; that's up to the caller.
+     */
+    pttentry *pml4, *pdp, *pd, *pt;
+    uint16_t idx;
+
+    spinlock_acquire(&page_table_lock);
+
+    pml4 = CONV_PHYS_ADDR(PTT_EXTRACT_BASE(pml4_entry));
+    idx = vaddr_ptt_index(vaddr, PML4);
+    if (!pml4[idx]) {
+        spinlock_release(&page_table_lock);
+        return;
+    }
+
+    pdp = CONV_PHYS_ADDR(PTT_EXTRACT_BASE(pml4[idx]));
+    idx = vaddr_ptt_index(vaddr, PDP);
+    if (!pdp[idx]) {
+        spinlock_release(&page_table_lock);
+        return;
+    }
+    if (pdp[idx] & PTT_FLAG_PS) {
+        ptt_split_huge_entry(&pdp[idx], PDP);
+    }
+
+    pd = CONV_PHYS_ADDR(PTT_EXTRACT_BASE(pdp[idx]));
+    idx = vaddr_ptt_index(vaddr, PD);
+    if (!pd[idx]) {
+        spinlock_release(&page_table_lock);
+        return;
+    }
+    if (pd[idx] & PTT_FLAG_PS) {
+        ptt_split_huge_entry(&pd[idx], PD);
+    }
+
+    pt = CONV_PHYS_ADDR(PTT_EXTRACT_BASE(pd[idx]));
+    idx = vaddr_ptt_index(vaddr, PT);
+    pt[idx] = 0;
+
+    spinlock_release(&page_table_lock);
+
+    tlb_invalidate_page(pml4_entry, vaddr);
+
+    return;
 }
 
 uint16_t vaddr_ptt_index(void* address, ptt_levels level) {
@@ -207,20 +447,32 @@ void* vaddr_to_physical(void* address, pttentry cr3) {
     ASSERT_NOT_NULL(address);
 
     pttentry *pml4_base, *pdp_base, *pd_base, *pt_base;
+    pttentry entry;
     uint16_t idx;
 
     void* phys_addr;
 
-    // function does not work--need way to translate physical addresses in page tables to virtual addresses.
-
-    pml4_base = extract_cr3_base_address(cr3);
+    pml4_base = CONV_PHYS_ADDR(extract_cr3_base_address(cr3));
     idx = vaddr_ptt_index(address, PML4);
-    pdp_base = extract_pttentry_base_address(pml4_base[idx]);
+    pdp_base = CONV_PHYS_ADDR(extract_pttentry_base_address(pml4_base[idx]));
     idx = vaddr_ptt_index(address, PDP);
-    pd_base = extract_pttentry_base_address(pdp_base[idx]);
+    entry = pdp_base[idx];
+
+    // 1GB page, so the low 30 bits are the offset within it
+    if (entry & PTT_FLAG_PS) {
+        return (void*)(PTT_EXTRACT_BASE(entry) + ((uint64_t)address % GIANT_PAGE_SIZE));
+    }
+
+    pd_base = CONV_PHYS_ADDR(extract_pttentry_base_address(entry));
     idx = vaddr_ptt_index(address, PD);
+    entry = pd_base[idx];
 
-    pt_base = extract_pttentry_base_address(pd_base[idx]);
+    // 2MB page, so the low 21 bits are the offset within it
+    if (entry & PTT_FLAG_PS) {
+        return (void*)(PTT_EXTRACT_BASE(entry) + ((uint64_t)address % HUGE_PAGE_SIZE));
+    }
+
+    pt_base = CONV_PHYS_ADDR(extract_pttentry_base_address(entry));
     idx = vaddr_ptt_index(address, PT);
 
     phys_addr = (void*)((pt_base[idx] >> 12) << 12);
@@ -228,4 +480,4 @@ void* vaddr_to_physical(void* address, pttentry cr3) {
     phys_addr += ((uint64_t)address % PAGE_SIZE);
 
     return phys_addr;
-}
\ No newline at end of file
+}
@@ -45,10 +45,22 @@ typedef uint64_t ptt_t;  // page translation table
 #define PTT_FLAG_PWD 16       // 0 = cacheable, 1 = disable caching
 #define PTT_FLAG_ACCESSED 32  // has page been accessed?
 #define PTT_FLAG_DIRTY 64     // has it been written to?
-#define PTT_FLAG_PS                                                                                                    \
-    128                      // page size - see AMD64 docs for information, for now we'll                              \
-                             // use 4-kb pages so it should always be 0
+#define PTT_FLAG_PS 128      // page size - in a PD (or PDP) entry, maps a 2MB (or 1GB) page instead of a table
 #define PTT_FLAG_GLOBAL 256  // 1 for global page
+#define PTT_FLAG_SWAPPED 512  // software bit - not-present entry whose base is a swap slot number instead
+#define PTT_FLAG_COW 1024     // software bit - read-only entry for a shared page, copied on the first write
+
+// Flag bits carried by an entry, as opposed to its base address
+#define PTT_FLAGS_MASK 0xFFF
+
+// Large pages, mapped directly by a PD entry (2MB) or PDP entry (1GB) with PTT_FLAG_PS set
+#define HUGE_PAGE_SIZE 0x200000
+#define GIANT_PAGE_SIZE 0x40000000
+#define PAGES_PER_HUGE_PAGE (HUGE_PAGE_SIZE / PAGE_SIZE)
+
+// CPUID leaf and bit that advertise 1GB page support
+#define CPUID_EXT_FEATURES 0x80000001
+#define CPUID_EXT_EDX_PAGE1GB (1 << 26)
 
 typedef enum page_directory_types {
     PDT_PHYS_AVAIL,                       // Physical memory available for allocation
@@ -72,6 +84,9 @@ typedef void* virt_addr;
 
 typedef uint64_t pttentry;
 
+// Flags in page_directory_t.flags
+#define PD_FLAG_RECLAIMABLE 1  // may be evicted to swap; the base bits of flags hold the owning cr3
+
 typedef struct page_directory_t {
     uint64_t ref_count;
     union {
@@ -94,9 +109,16 @@ void setup_page_directory(void* start, int_15_map* phys_map, uint8_t num_blocks)
 
 // pagetables.c
 void add_pt_page(virt_addr* vaddr, uint64_t page, pttentry parent_entry, bool user);
+bool cpu_has_giant_pages();
+pttentry* find_pt_entry(void* vaddr, pttentry pml4_entry);
+bool map_huge_page_at(uint64_t page, void* vaddr, pttentry pml4_entry, bool user);
 void map_page_at(uint64_t page, void* vaddr, pttentry pml4_entry, bool user);
+void map_pages_at(uint64_t page, uint64_t count, void* vaddr, pttentry pml4_entry, bool user);
+void map_pages_cow_at(uint64_t page, uint64_t count, void* vaddr, pttentry pml4_entry, bool user);
 pttentry obtain_ptt_entry(virt_addr* vaddr, pttentry parent_entry, ptt_levels level, bool user);
 pttentry ptt_entry_create(void* base_address, bool present, bool rw, bool user);
+void ptt_split_huge_entry(pttentry* entry, ptt_levels level);
 void reserve_next_ptt(ptt_levels level, uint64_t* expansion);
+void unmap_page_at(void* vaddr, pttentry pml4_entry);
 
 #endif
\ No newline at end of file
@@ -0,0 +1,319 @@
+/*****************************************************************
+ * This file is part of CosmOS                                   *
+ * Copyright (C) 2021 Kurt M. Weber                              *
+ * Released under the stated terms in the file LICENSE           *
+ * See the file "LICENSE" in the source distribution for details *
+ *****************************************************************/
+
+#include <sys/debug/assert.h>
+#include <sys/kmalloc/kmalloc.h>
+#include <sys/kprintf/kprintf.h>
+#include <sys/obj/object/object.h>
+#include <sys/obj/objectinterface/objectinterface_swap.h>
+#include <sys/string/mem.h>
+#include <sys/sync/sync.h>
+#include <sys/x86-64/mm/mm.h>
+#include <sys/x86-64/mm/pagetables.h>
+#include <types.h>
+
+/*
+ * The swap device is carved up into page-sized slots, each made up of
+ * (PAGE_SIZE / block size) consecutive swap blocks.  reclaim_swap_map has one
+ * bit per slot, set when the slot holds a page.
+ */
+struct object* reclaim_swap;
+uint8_t* reclaim_swap_map;
+uint64_t reclaim_swap_slots;
+uint64_t reclaim_swap_slots_used;
+uint16_t reclaim_blocks_per_slot;
+
+// Next page-directory entry the clock hand will look at
+uint64_t reclaim_clock_hand;
+
+/*
+ * Evicting a page means doing I/O, and the driver doing it may itself need
+ * memory.  If that allocation fails we must not try to reclaim again.
+ */
+bool reclaim_in_progress;
+
+uint64_t reclaim_slot_allocate();
+void reclaim_slot_free(uint64_t slot);
+void reclaim_slot_io(uint64_t slot, uint64_t page, bool write);
+
+void reclaim_init() {
+    reclaim_swap = NULL;
+    reclaim_swap_map = NULL;
+    reclaim_swap_slots = 0;
+    reclaim_swap_slots_used = 0;
+    reclaim_blocks_per_slot = 0;
+    reclaim_clock_hand = 0;
+    reclaim_in_progress = false;
+
+    return;
+}
+
+bool reclaim_set_swap(struct object* swap) {
+    /*
+     * Use the swap object swap as backing store for evicted pages.  Passing
+     * NULL turns eviction off again.  The device can't be changed while any
+     * pages are out on it, so we return false in that case.
+     */
+    struct objectinterface_swap* api;
+    uint16_t block_size;
+
+    if (reclaim_swap_slots_used) {
+        return false;
+    }
+
+    if (reclaim_swap_map) {
+        kfree(reclaim_swap_map);
+    }
+
+    reclaim_swap = NULL;
+    reclaim_swap_map = NULL;
+    reclaim_swap_slots = 0;
+
+    if (!swap) {
+        return true;
+    }
+
+    ASSERT_NOT_NULL(swap->api);
+    api = (struct objectinterface_swap*)swap->api;
+
+    block_size = (*api->block_size)(swap);
+    ASSERT_NOT_NULL(block_size);
+    ASSERT(!(PAGE_SIZE % block_size));
+
+    reclaim_blocks_per_slot = PAGE_SIZE / block_size;
+    reclaim_swap_slots = (*api->block_count)(swap) / reclaim_blocks_per_slot;
+    if (!reclaim_swap_slots) {
+        return false;
+    }
+
+    reclaim_swap_map = kmalloc((reclaim_swap_slots / 8) + 1);
+    memzero(reclaim_swap_map, (reclaim_swap_slots / 8) + 1);
+    reclaim_swap = swap;
+
+    kprintf("   Swapping to %s, %llu pages\n", swap->name, reclaim_swap_slots);
+
+    return true;
+}
+
+void reclaim_track_page(uint64_t page, pttentry cr3, void* vaddr) {
+    /*
+     * Make page, which is mapped at vaddr in the address space specified by
+     * cr3 and nowhere else, a candidate for eviction.  The page directory
+     * entry doubles as the reverse mapping: backing_addr holds vaddr, and the
+     * bits of flags above PD_FLAG_RECLAIMABLE hold the base of cr3.
+     */
+    spinlock_acquire(&page_dir_lock);
+
+    page_directory[page].backing_addr = (void*)((uint64_t)vaddr & ~((uint64_t)PTT_FLAGS_MASK));
+    page_directory[page].flags = PTT_EXTRACT_BASE(cr3) | PD_FLAG_RECLAIMABLE;
+
+    spinlock_release(&page_dir_lock);
+
+    return;
+}
+
+void reclaim_untrack_page(uint64_t page) {
+    spinlock_acquire(&page_dir_lock);
+
+    page_directory[page].backing_addr = 0;
+    page_directory[page].flags = 0;
+
+    spinlock_release(&page_dir_lock);
+
+    return;
+}
+
+uint64_t reclaim_pages(uint64_t count) {
+    /*
+     * Evicts up to count pages to swap, and returns the number actually
+     * evicted.  Victims are chosen by a clock sweep over the page directory:
+     * a reclaimable page whose accessed bit is set gets a second chance (the
+     * bit is cleared, and the translation flushed so the CPU will set it again
+     * on the next access), and one whose bit is still clear when the hand
+     * comes back round is written out.  The hand makes at most two full
+     * revolutions per call, which is enough to have cleared every bit once.
+     */
+    uint64_t evicted = 0;
+    uint64_t steps, page, slot;
+    pttentry cr3;
+    pttentry* pte;
+    void* vaddr;
+
+    if (!reclaim_swap || reclaim_in_progress) {
+        return 0;
+    }
+
+    reclaim_in_progress = true;
+
+    for (steps = 0; (steps < (page_directory_size * 2)) && (evicted < count); steps++) {
+        // Take a snapshot of the entry under the hand, and move the hand on
+        spinlock_acquire(&page_dir_lock);
+
+        page = reclaim_clock_hand;
+        reclaim_clock_hand = (reclaim_clock_hand + 1) % page_directory_size;
+
+        if ((page_directory[page].type != PDT_INUSE) || (page_directory[page].ref_count != 1) ||
+            !(page_directory[page].flags & PD_FLAG_RECLAIMABLE)) {
+            spinlock_release(&page_dir_lock);
+            continue;
+        }
+
+        cr3 = PTT_EXTRACT_BASE(page_directory[page].flags);
+        vaddr = page_directory[page].backing_addr;
+
+        spinlock_release(&page_dir_lock);
+
+        /*
+         * Page tables can't be walked while holding page_dir_lock, since
+         * map_page_at() takes them in the opposite order.
+         */
+        spinlock_acquire(&page_table_lock);
+
+        pte = find_pt_entry(vaddr, cr3);
+        if (!pte || !(*pte & PTT_FLAG_PRESENT) || (PTT_EXTRACT_BASE(*pte) != (page * PAGE_SIZE))) {
+            // The mapping went away without anyone telling us
+            spinlock_release(&page_table_lock);
+            reclaim_untrack_page(page);
+            continue;
+        }
+
+        if (*pte & PTT_FLAG_ACCESSED) {
+            *pte &= ~((uint64_t)PTT_FLAG_ACCESSED);
+            spinlock_release(&page_table_lock);
+            tlb_invalidate_page(cr3, vaddr);
+            continue;
+        }
+
+        slot = reclaim_slot_allocate();
+        if (slot == reclaim_swap_slots) {
+            // Swap is full
+            spinlock_release(&page_table_lock);
+            break;
+        }
+
+        /*
+         * Unmap first, so nothing can write to the page while it's on its way
+         * out.  The entry keeps the slot number where the base would be, along
+         * with the permission bits, so the fault handler can put it all back.
+         */
+        *pte = (slot * PAGE_SIZE) | PTT_FLAG_SWAPPED | (*pte & (PTT_FLAG_RW | PTT_FLAG_USER));
+
+        spinlock_release(&page_table_lock);
+
+        tlb_invalidate_page(cr3, vaddr);
+
+        reclaim_slot_io(slot, page, true);
+
+        reclaim_untrack_page(page);
+        slab_free(page, 1);
+
+        evicted++;
+    }
+
+    reclaim_in_progress = false;
+
+    return evicted;
+}
+
+bool reclaim_fault_in(void* vaddr, pttentry cr3) {
+    /*
+     * Called by the page fault handler for a not-present fault.  If vaddr
+     * belongs to a page that was evicted, read it back in from swap, map it
+     * where it was, and return true.  Otherwise return false and let the
+     * fault be handled some other way.
+     */
+    pttentry* pte;
+    pttentry entry;
+    uint64_t page, slot;
+    bool user;
+
+    spinlock_acquire(&page_table_lock);
+
+    pte = find_pt_entry(vaddr, cr3);
+    if (!pte || (*pte & PTT_FLAG_PRESENT) || !(*pte & PTT_FLAG_SWAPPED)) {
+        spinlock_release(&page_table_lock);
+        return false;
+    }
+
+    entry = *pte;
+
+    spinlock_release(&page_table_lock);
+
+    slot = PTT_EXTRACT_BASE(entry) / PAGE_SIZE;
+    user = (entry & PTT_FLAG_USER) ? true : false;
+
+    page = slab_allocate(1, PDT_INUSE);
+    if (!page) {
+        PANIC("Out of memory bringing a page in from swap!");
+    }
+
+    reclaim_slot_io(slot, page, false);
+
+    // map_page_at() overwrites the swap entry with the real mapping
+    map_page_at(page, vaddr, cr3, user);
+    reclaim_slot_free(slot);
+
+    reclaim_track_page(page, cr3, vaddr);
+
+    return true;
+}
+
+uint64_t reclaim_slot_allocate() {
+    // Returns reclaim_swap_slots if every slot is taken
+    uint64_t i;
+
+    spinlock_acquire(&swap_slot_lock);
+
+    for (i = 0; i < reclaim_swap_slots; i++) {
+        if (!(reclaim_swap_map[i / 8] & (1 << (i % 8)))) {
+            reclaim_swap_map[i / 8] |= (1 << (i % 8));
+            reclaim_swap_slots_used++;
+            break;
+        }
+    }
+
+    spinlock_release(&swap_slot_lock);
+
+    return i;
+}
+
+void reclaim_slot_free(uint64_t slot) {
+    ASSERT((slot < reclaim_swap_slots));
+
+    spinlock_acquire(&swap_slot_lock);
+
+    reclaim_swap_map[slot / 8] &= ~(1 << (slot % 8));
+    reclaim_swap_slots_used--;
+
+    spinlock_release(&swap_slot_lock);
+
+    return;
+}
+
+void reclaim_slot_io(uint64_t slot, uint64_t page, bool write) {
+    // Moves one page between physical page page and swap slot slot
+    struct objectinterface_swap* api;
+    uint8_t* data;
+    uint16_t block_size;
+    uint16_t i;
+
+    ASSERT_NOT_NULL(reclaim_swap);
+
+    api = (struct objectinterface_swap*)reclaim_swap->api;
+    block_size = PAGE_SIZE / reclaim_blocks_per_slot;
+    data = CONV_PHYS_ADDR(page * PAGE_SIZE);
+
+    for (i = 0; i < reclaim_blocks_per_slot; i++) {
+        if (write) {
+            (*api->write)(reclaim_swap, data + (i * block_size), (slot * reclaim_blocks_per_slot) + i);
+        } else {
+            (*api->read)(reclaim_swap, data + (i * block_size), (slot * reclaim_blocks_per_slot) + i);
+        }
+    }
+
+    return;
+}
@@ -5,6 +5,8 @@
  * See the file "LICENSE" in the source distribution for details *
  *****************************************************************/
 
+#include <sys/debug/assert.h>
+#include <sys/fs/pagecache.h>
 #include <sys/sync/sync.h>
 #include <sys/x86-64/mm/mm.h>
 #include <sys/x86-64/mm/pagetables.h>
@@ -17,12 +19,66 @@ uint64_t slab_allocate(uint64_t pages, page_directory_types purpose) {
      * cannot be found, return 0. Zero is a valid page-directory index, of
      * course, but it refers to the first page which is system-reserved and will
      * never be made available, so we can use it for these purposes.
+     *
+     * Allocations of 2MB or more are placed on a 2MB boundary if at all
+     * possible, so that map_pages_at() can map them with large pages.
+     *
+     * Reclaiming memory takes page_table_lock and does swap I/O, so a caller
+     * holding page_table_lock or page_dir_lock must use
+     * slab_allocate_noreclaim() instead.
+     */
+
+    uint64_t start_page;
+
+    start_page = slab_allocate_noreclaim(pages, purpose);
+
+    /*
+     * Out of memory--drop clean pages from the page cache and try again, and
+     * if that still isn't enough, push some pages out to swap and try once
+     * more.  Either way the pages freed are scattered, so this mostly helps
+     * small allocations.
+     */
+    if (!start_page && pagecache_shrink(pages)) {
+        start_page = slab_allocate_aligned(pages, 1, purpose);
+    }
+
+    if (!start_page && reclaim_pages(pages)) {
+        start_page = slab_allocate_aligned(pages, 1, purpose);
+    }
+
+    return start_page;
+}
+
+uint64_t slab_allocate_noreclaim(uint64_t pages, page_directory_types purpose) {
+    /*
+     * Same as slab_allocate(), except that nothing is reclaimed if memory has
+     * run out; the caller just gets 0.
+     */
+
+    uint64_t start_page;
+
+    if (pages >= PAGES_PER_HUGE_PAGE) {
+        start_page = slab_allocate_aligned(pages, PAGES_PER_HUGE_PAGE, purpose);
+        if (start_page) {
+            return start_page;
+        }
+    }
+
+    return slab_allocate_aligned(pages, 1, purpose);
+}
+
+uint64_t slab_allocate_aligned(uint64_t pages, uint64_t alignment, page_directory_types purpose) {
+    /*
+     * Same as slab_allocate(), except that the first page of the chunk is
+     * guaranteed to be a multiple of alignment (which is a number of pages).
      */
 
     uint64_t consecutive_pages = 0;
     uint64_t i, j;
     uint64_t start_page = 0;
 
+    ASSERT_NOT_NULL(alignment);
+
     spinlock_acquire(&page_dir_lock);
 
     /*
@@ -35,10 +91,14 @@ uint64_t slab_allocate(uint64_t pages, page_directory_types purpose) {
             /*
              * If this is the first free block, or the last free block was of
              * insufficient size, then we mark this page as the start of the
-             * current free block.  If it's the start of a free block OR a
-             * continuation, we increment the # of consecutive free pages.
+             * current free block--provided it's suitably aligned.  If it's the
+             * start of a free block OR a continuation, we increment the # of
+             * consecutive free pages.
              */
             if (start_page == 0) {
+                if (i % alignment) {
+                    continue;
+                }
                 start_page = i;
             }
             consecutive_pages++;
@@ -46,8 +106,8 @@ uint64_t slab_allocate(uint64_t pages, page_directory_types purpose) {
             // Mark pages as used and return if we've got what we need
             if (consecutive_pages == pages) {
                 for (j = start_page; j < consecutive_pages + start_page; j++) {
-                    page_directory[i].ref_count++;
-                    page_directory[i].type = purpose;
+                    page_directory[j].ref_count++;
+                    page_directory[j].type = purpose;
                 }
                 spinlock_release(&page_dir_lock);
                 return start_page;
@@ -84,6 +144,8 @@ void slab_free(uint64_t start, uint64_t len) {
     for (i = start; i < (start + len); i++) {
         page_directory[i].ref_count = 0;
         page_directory[i].type = PDT_PHYS_AVAIL;
+        page_directory[i].backing_addr = 0;
+        page_directory[i].flags = 0;
     }
 
     spinlock_release(&page_dir_lock);
@@ -0,0 +1,264 @@
+/*****************************************************************
+ * This file is part of CosmOS                                   *
+ * Copyright (C) 2021 Kurt M. Weber                              *
+ * Released under the stated terms in the file LICENSE           *
+ * See the file "LICENSE" in the source distribution for details *
+ *****************************************************************/
+
+#include <sys/asm/misc.h>
+#include <sys/debug/assert.h>
+#include <sys/kprintf/kprintf.h>
+#include <sys/x86-64/mm/mm.h>
+#include <sys/x86-64/mm/pagetables.h>
+#include <types.h>
+
+bool tlb_pcid_enabled;
+bool tlb_invpcid_enabled;
+
+/*
+ * For each PCID, the base address of the PML4 table whose translations the TLB
+ * may currently be holding under that PCID.  Zero means that nothing we can
+ * trust is cached under it, so the next address space to use it has to flush.
+ */
+uint64_t tlb_pcid_owner[TLB_PCID_COUNT];
+
+bool tlb_is_current(pttentry cr3);
+bool tlb_is_kernel(void* vaddr);
+uint16_t tlb_pcid_for(pttentry cr3);
+
+void tlb_init() {
+    uint32_t eax, ebx, ecx, edx;
+    uint16_t i;
+
+    tlb_pcid_enabled = false;
+    tlb_invpcid_enabled = false;
+
+    for (i = 0; i < TLB_PCID_COUNT; i++) {
+        tlb_pcid_owner[i] = 0;
+    }
+
+    asm_cpuid(1, 0, &eax, &ebx, &ecx, &edx);
+    if (!(ecx & CPUID_FEAT_ECX_PCID)) {
+        return;
+    }
+
+    // CR4.PCIDE may only be set while the current PCID is zero
+    if (asm_cr3_read() & PTT_FLAGS_MASK) {
+        return;
+    }
+
+    asm_cr4_write(asm_cr4_read() | CR4_PCIDE);
+    tlb_pcid_enabled = true;
+
+    kprintf("   PCIDs enabled\n");
+
+    // INVPCID flushes every PCID at once; without it, tlb_invalidate_kernel() toggles CR4.PGE
+    asm_cpuid(0, 0, &eax, &ebx, &ecx, &edx);
+    if (eax >= 7) {
+        asm_cpuid(7, 0, &eax, &ebx, &ecx, &edx);
+        tlb_invpcid_enabled = (ebx & CPUID_FEAT_EBX_INVPCID) ? true : false;
+    }
+
+    return;
+}
+
+bool tlb_is_current(pttentry cr3) {
+    return (PTT_EXTRACT_BASE(cr3) == PTT_EXTRACT_BASE(asm_cr3_read())) ? true : false;
+}
+
+bool tlb_is_kernel(void* vaddr) {
+    return ((uint64_t)vaddr >= TLB_KERNEL_HALF_START) ? true : false;
+}
+
+uint16_t tlb_pcid_for(pttentry cr3) {
+    /*
+     * PCID 0 is left for the kernel's own address space, so process address
+     * spaces are spread across 1-4095 by their PML4 page number.  Two address
+     * spaces can end up sharing a PCID; tlb_pcid_owner tells us when that has
+     * happened, and tlb_switch_cr3() flushes in that case.
+     */
+    return (uint16_t)(((PTT_EXTRACT_BASE(cr3) / PAGE_SIZE) % (TLB_PCID_COUNT - 1)) + 1);
+}
+
+void tlb_invalidate_page(pttentry cr3, void* vaddr) {
+    /*
+     * Invalidate any cached translation for vaddr in the address space
+     * specified by cr3.  invlpg only reaches the active address space, so for
+     * any other we just forget that its PCID is trustworthy and let the next
+     * switch to it flush.  Kernel-half translations may be cached under every
+     * PCID, so those go everywhere.
+     */
+    if (tlb_is_kernel(vaddr)) {
+        if (tlb_pcid_enabled) {
+            tlb_invalidate_kernel();
+        } else {
+            asm_invlpg(vaddr);
+        }
+    } else if (tlb_is_current(cr3)) {
+        asm_invlpg(vaddr);
+    } else {
+        tlb_release_address_space(cr3);
+    }
+
+    return;
+}
+
+void tlb_invalidate_all() {
+    // Reloading cr3 flushes all non-global translations for the current PCID
+    asm_cr3_reload();
+
+    return;
+}
+
+void tlb_invalidate_kernel() {
+    /*
+     * Flush every translation under every PCID, for a change to the kernel
+     * half: those mappings are shared, so any address space that has run may
+     * be holding them.  Without PCIDs, reloading cr3 already does that.
+     */
+    uint64_t cr4;
+
+    if (!tlb_pcid_enabled) {
+        asm_cr3_reload();
+    } else if (tlb_invpcid_enabled) {
+        asm_invpcid(INVPCID_ALL_CONTEXTS, 0, 0);
+    } else {
+        cr4 = asm_cr4_read();
+        asm_cr4_write(cr4 ^ CR4_PGE);
+        asm_cr4_write(cr4);
+    }
+
+    return;
+}
+
+void tlb_release_address_space(pttentry cr3) {
+    /*
+     * Call this whenever the address space specified by cr3 is created, torn
+     * down, or modified while it's not the active one.  Whoever next runs
+     * under its PCID will start with a clean slate.
+     */
+    uint16_t pcid;
+
+    if (!tlb_pcid_enabled) {
+        return;
+    }
+
+    pcid = tlb_pcid_for(cr3);
+
+    if (tlb_pcid_owner[pcid] == PTT_EXTRACT_BASE(cr3)) {
+        tlb_pcid_owner[pcid] = 0;
+    }
+
+    return;
+}
+
+pttentry tlb_switch_cr3(pttentry cr3) {
+    /*
+     * Returns the value to load into cr3 to switch to the specified address
+     * space.  With PCIDs, translations cached the last time this address space
+     * ran survive the switch unless something has invalidated them since.
+     * Without PCIDs, it's the usual full flush.
+     */
+    uint64_t base;
+    uint16_t pcid;
+
+    base = PTT_EXTRACT_BASE(cr3);
+
+    if (!tlb_pcid_enabled) {
+        return base;
+    }
+
+    pcid = tlb_pcid_for(cr3);
+
+    if (tlb_pcid_owner[pcid] == base) {
+        return base | pcid | CR3_PCID_NOFLUSH;
+    }
+
+    // Someone else's translations (or none at all) are cached under this PCID
+    tlb_pcid_owner[pcid] = base;
+
+    return base | pcid;
+}
+
+void tlb_batch_init(tlb_batch_t* batch, pttentry cr3) {
+    ASSERT_NOT_NULL(batch);
+
+    batch->cr3 = cr3;
+    batch->count = 0;
+    batch->kernel = false;
+
+    return;
+}
+
+void tlb_batch_add(tlb_batch_t* batch, void* vaddr) {
+    ASSERT_NOT_NULL(batch);
+
+    /*
+     * Past TLB_BATCH_MAX pages, a full flush is cheaper than invalidating one
+     * page at a time, so we stop recording and just remember that we overflowed.
+     */
+    if (batch->count < TLB_BATCH_MAX) {
+        batch->pages[batch->count] = vaddr;
+    }
+    batch->count++;
+
+    if (tlb_is_kernel(vaddr)) {
+        batch->kernel = true;
+    }
+
+    return;
+}
+
+void tlb_batch_add_range(tlb_batch_t* batch, void* vaddr, uint64_t pages) {
+    uint64_t i;
+
+    ASSERT_NOT_NULL(batch);
+
+    if ((batch->count + pages) > TLB_BATCH_MAX) {
+        batch->count += pages;
+        if (tlb_is_kernel(vaddr + ((pages - 1) * PAGE_SIZE))) {
+            batch->kernel = true;
+        }
+        return;
+    }
+
+    for (i = 0; i < pages; i++) {
+        tlb_batch_add(batch, vaddr + (i * PAGE_SIZE));
+    }
+
+    return;
+}
+
+void tlb_batch_flush(tlb_batch_t* batch) {
+    uint64_t i;
+
+    ASSERT_NOT_NULL(batch);
+
+    if (!batch->count) {
+        return;
+    }
+
+    if (batch->kernel && tlb_pcid_enabled) {
+        // Kernel-half pages may be cached under any PCID
+        tlb_invalidate_kernel();
+    } else if (batch->kernel && (batch->count > TLB_BATCH_MAX)) {
+        tlb_invalidate_all();
+    } else if (batch->kernel) {
+        for (i = 0; i < batch->count; i++) {
+            asm_invlpg(batch->pages[i]);
+        }
+    } else if (!tlb_is_current(batch->cr3)) {
+        // One invalidation covers the whole batch
+        tlb_release_address_space(batch->cr3);
+    } else if (batch->count > TLB_BATCH_MAX) {
+        tlb_invalidate_all();
+    } else {
+        for (i = 0; i < batch->count; i++) {
+            asm_invlpg(batch->pages[i]);
+        }
+    }
+
+    batch->count = 0;
+
+    return;
+}
@@ -3,8 +3,9 @@
 global task_jump;
 
 task_jump:
-         mov rax, [rdi + 8]   ; cr3
-         mov cr3, rax
+         ; rsi holds the value to load into cr3, which may carry a PCID and
+         ; the no-flush bit in addition to the PML4 address in [rdi + 8]
+         mov cr3, rsi
 
          ; We need to set the stack pointers first, to make sure that we're
          ; pushing onto the stack that iretq will be seeing later on
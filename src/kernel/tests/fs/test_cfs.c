@@ -6,19 +6,50 @@
 // ****************************************************************
 
 #include <obj/logical/fs/cfs/cfs.h>
+#include <sys/debug/assert.h>
 #include <sys/kprintf/kprintf.h>
 #include <sys/obj/objectmgr/objectmgr.h>
+#include <tests/fs/ramdisk_helper.h>
 #include <tests/fs/test_cfs.h>
 #include <types.h>
 
 void test_cfs() {
-    uint8_t devicename[] = {"disk1"};
+    kprintf("Testing CFS\n");
 
-    struct object* dsk = objectmgr_find_object_by_name(devicename);
-    if (0 != dsk) {
-        struct object* obj = cfs_attach(dsk);
-        cfs_detach(obj);
-    } else {
-        kprintf("Unable to find %s\n", devicename);
+    struct object* dsk = ramdisk_helper_create_rd();
+    ASSERT_NOT_NULL(dsk);
+    // nothing there yet
+    ASSERT(0 == cfs_attach(dsk));
+    cfs_format(dsk);
+
+    struct object* obj = cfs_attach(dsk);
+    ASSERT_NOT_NULL(obj);
+    ASSERT(0 == cfs_count(obj, CFS_KIND_DATA));
+    // enough to need more directories, and more than one transaction
+    uint64_t first = 0;
+    for (uint32_t i = 0; i < 100; i++) {
+        uint64_t lba = cfs_create(obj, CFS_KIND_DATA);
+        ASSERT(0 != lba);
+        if (0 == first) {
+            first = lba;
+        }
     }
+    ASSERT(0 != cfs_create(obj, CFS_KIND_GROUP));
+    cfs_sync(obj);
+    ASSERT(100 == cfs_count(obj, CFS_KIND_DATA));
+    cfs_detach(obj);
+
+    obj = cfs_attach(dsk);
+    ASSERT_NOT_NULL(obj);
+    ASSERT(100 == cfs_count(obj, CFS_KIND_DATA));
+    ASSERT(1 == cfs_count(obj, CFS_KIND_GROUP));
+    ASSERT(0 == cfs_count(obj, CFS_KIND_PRESENTATION));
+    ASSERT(cfs_delete(obj, CFS_KIND_DATA, first));
+    ASSERT(!cfs_delete(obj, CFS_KIND_DATA, first));
+    // the sector freed is the next one used
+    ASSERT(first == cfs_create(obj, CFS_KIND_PRESENTATION));
+    ASSERT(99 == cfs_count(obj, CFS_KIND_DATA));
+    cfs_detach(obj);
+
+    ramdisk_helper_remove_rd(dsk);
 }
@@ -0,0 +1,111 @@
+//*****************************************************************
+// This file is part of CosmOS                                    *
+// Copyright (C) 2021 Tom Everett                                 *
+// Released under the stated terms in the file LICENSE            *
+// See the file "LICENSE" in the source distribution for details  *
+// ****************************************************************
+
+#include <sys/debug/assert.h>
+#include <sys/fs/dcache.h>
+#include <sys/fs/fs_facade.h>
+#include <sys/kprintf/kprintf.h>
+#include <sys/obj/objectinterface/objectinterface_filesystem.h>
+#include <sys/obj/objectmgr/objectmgr.h>
+#include <sys/string/string.h>
+#include <tests/fs/test_dcache.h>
+#include <types.h>
+
+// node ids are handed out from 0x80 up, so these won't be anybody's
+#define TEST_DCACHE_PARENT 0x7F
+#define TEST_DCACHE_OTHER_PARENT 0x7E
+
+void test_dcache_entries() {
+    uint64_t id = 0;
+    ASSERT(!dcache_lookup(TEST_DCACHE_PARENT, "a", &id));
+    dcache_insert(TEST_DCACHE_PARENT, "a", 100);
+    dcache_insert(TEST_DCACHE_PARENT, "b", 0);
+    dcache_insert(TEST_DCACHE_OTHER_PARENT, "a", 200);
+
+    // a name is per directory
+    ASSERT(dcache_lookup(TEST_DCACHE_PARENT, "a", &id));
+    ASSERT(100 == id);
+    ASSERT(dcache_lookup(TEST_DCACHE_OTHER_PARENT, "a", &id));
+    ASSERT(200 == id);
+
+    // a negative entry is a hit, on nothing
+    id = 1;
+    ASSERT(dcache_lookup(TEST_DCACHE_PARENT, "b", &id));
+    ASSERT(0 == id);
+
+    // and is replaced when the name turns up
+    dcache_insert(TEST_DCACHE_PARENT, "b", 101);
+    ASSERT(dcache_lookup(TEST_DCACHE_PARENT, "b", &id));
+    ASSERT(101 == id);
+
+    dcache_remove(TEST_DCACHE_PARENT, "a");
+    ASSERT(!dcache_lookup(TEST_DCACHE_PARENT, "a", &id));
+
+    // a directory goes without touching the others
+    dcache_invalidate_directory(TEST_DCACHE_PARENT);
+    ASSERT(!dcache_lookup(TEST_DCACHE_PARENT, "b", &id));
+    ASSERT(dcache_lookup(TEST_DCACHE_OTHER_PARENT, "a", &id));
+    dcache_invalidate_directory(TEST_DCACHE_OTHER_PARENT);
+
+    // past DCACHE_MAX_ENTRIES the least recently used goes
+    struct dcache_stats before;
+    dcache_stats(&before);
+    uint8_t name[32];
+    for (uint16_t i = 0; i <= DCACHE_MAX_ENTRIES; i++) {
+        uitoa3(i, name, sizeof(name), 10);
+        dcache_insert(TEST_DCACHE_PARENT, name, 1000 + i);
+    }
+    struct dcache_stats after;
+    dcache_stats(&after);
+    ASSERT(DCACHE_MAX_ENTRIES == after.entries);
+    ASSERT(after.evictions > before.evictions);
+    uitoa3(DCACHE_MAX_ENTRIES, name, sizeof(name), 10);
+    ASSERT(dcache_lookup(TEST_DCACHE_PARENT, name, &id));
+    ASSERT((1000 + DCACHE_MAX_ENTRIES) == id);
+    dcache_invalidate_directory(TEST_DCACHE_PARENT);
+}
+
+void test_dcache_paths() {
+    // voh0 has objfs0 under it, and that has every object, voh0 included
+    struct object* voh = objectmgr_find_object_by_name("voh0");
+    ASSERT_NOT_NULL(voh);
+    struct filesystem_node* root = fsfacade_get_fs_rootnode(voh);
+    ASSERT_NOT_NULL(root);
+
+    struct dcache_stats before;
+    dcache_stats(&before);
+    struct filesystem_node* node = fsfacade_find_node_by_path(root, "/objfs0/voh0");
+    ASSERT_NOT_NULL(node);
+    ASSERT(0 == strcmp(node->name, "voh0"));
+
+    // the second time is all cache hits
+    struct dcache_stats after;
+    dcache_stats(&after);
+    ASSERT(node == fsfacade_find_node_by_path(root, "objfs0//./voh0"));
+    struct dcache_stats again;
+    dcache_stats(&again);
+    ASSERT(again.misses == after.misses);
+    ASSERT(again.hits == (after.hits + 2));
+
+    // a name that isn't there is remembered too
+    ASSERT(0 == fsfacade_find_node_by_path(root, "/objfs0/nothere"));
+    dcache_stats(&after);
+    ASSERT(0 == fsfacade_find_node_by_path(root, "/objfs0/nothere"));
+    dcache_stats(&again);
+    ASSERT(again.negative_hits == (after.negative_hits + 1));
+
+    // up a level and back down; and a file has nothing under it
+    ASSERT(node == fsfacade_find_node_by_path(root, "/objfs0/voh0/../voh0"));
+    ASSERT(0 == fsfacade_find_node_by_path(root, "/objfs0/voh0/more"));
+    ASSERT(root == fsfacade_find_node_by_path(root, "/"));
+}
+
+void test_dcache() {
+    kprintf("Testing dcache\n");
+    test_dcache_entries();
+    test_dcache_paths();
+}
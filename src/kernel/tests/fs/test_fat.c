@@ -5,43 +5,104 @@
 // See the file "LICENSE" in the source distribution for details  *
 // ****************************************************************
 
+#include <obj/logical/fs/block_util.h>
 #include <obj/logical/fs/fat/fat.h>
+#include <obj/logical/fs/fat/fat_support.h>
 #include <sys/debug/assert.h>
 #include <sys/fs/fs_facade.h>
 #include <sys/kprintf/kprintf.h>
 #include <sys/obj/objectinterface/objectinterface_filesystem.h>
-#include <sys/obj/objectmgr/objectmgr.h>
+#include <sys/string/mem.h>
 #include <sys/string/string.h>
+#include <tests/fs/ramdisk_helper.h>
 #include <tests/fs/test_fat.h>
 #include <types.h>
 
+uint8_t TEST_FAT_CONTENT[] = {"Do not modify this file.  It contains test data for test_initrd.c."};
+
+/*
+ * an empty FAT12 volume: a boot sector, two FATs, a sector of root folder entries, and a cluster for each sector
+ * after that.  the FATs are sized for an entry, of a byte and a half, for every sector on the disk
+ */
+void test_fat_make_image(struct object* dsk) {
+    struct fat_BS boot;
+    memzero((uint8_t*)&boot, sizeof(struct fat_BS));
+    boot.bytes_per_sector = RAMDISK_SECTOR_SIZE;
+    boot.sectors_per_cluster = 1;
+    boot.reserved_sector_count = 1;
+    boot.table_count = 2;
+    boot.root_entry_count = RAMDISK_SECTOR_SIZE / sizeof(struct fat_dir_entry);
+    boot.total_sectors_16 = blockutil_get_sector_count(dsk);
+    boot.media_type = 0xF8;
+    boot.table_size_16 = (((boot.total_sectors_16 + 2) * 3 / 2) + RAMDISK_SECTOR_SIZE - 1) / RAMDISK_SECTOR_SIZE;
+    blockutil_update(dsk, (uint8_t*)&boot, sizeof(struct fat_BS), 0, 0);
+
+    // entries 0 and 1 are reserved: the media type, then an end of chain
+    uint8_t table[] = {0xF8, 0xFF, 0xFF};
+    for (uint8_t i = 0; i < boot.table_count; i++) {
+        blockutil_update(dsk, table, sizeof(table), boot.reserved_sector_count + (i * boot.table_size_16), 0);
+    }
+}
+
+/*
+ * a scratch volume on a ramdisk, so nothing is left behind on the shared disk images
+ */
 void test_fat() {
     kprintf("Testing FAT\n");
 
-    uint8_t devicename[] = {"fs0"};
-
-    struct object* fatfs = objectmgr_find_object_by_name(devicename);
-    if (0 != fatfs) {
+    struct object* dsk = ramdisk_helper_create_rd();
+    ASSERT_NOT_NULL(dsk);
+    test_fat_make_image(dsk);
+    struct object* fatfs = fat_attach(dsk);
+    ASSERT_NOT_NULL(fatfs);
+    struct filesystem_node* fs_root_node = fsfacade_get_fs_rootnode(fatfs);
+    ASSERT_NOT_NULL(fs_root_node);
+    uint32_t len = strlen(TEST_FAT_CONTENT);
+    struct filesystem_node* fs_file_node = fsfacade_create(fs_root_node, "testdata.txt");
+    ASSERT_NOT_NULL(fs_file_node);
+    ASSERT(len == fsfacade_write(fs_file_node, 0, TEST_FAT_CONTENT, len));
+    fat_detach(fatfs);
 
-        struct filesystem_node* fs_root_node = fsfacade_get_fs_rootnode(fatfs);
-        ASSERT_NOT_NULL(fs_root_node);
-        ASSERT(fs_root_node->type == folder);
+    // from the disk this time
+    fatfs = fat_attach(dsk);
+    ASSERT_NOT_NULL(fatfs);
+    fs_root_node = fsfacade_get_fs_rootnode(fatfs);
+    ASSERT_NOT_NULL(fs_root_node);
+    ASSERT(fs_root_node->type == folder);
 
-        struct filesystem_node* fs_file_node = fsfacade_find_node_by_name(fs_root_node, "testdata.txt");
-        ASSERT_NOT_NULL(fs_file_node);
-        ASSERT(fs_file_node->type == file);
+    fs_file_node = fsfacade_find_node_by_name(fs_root_node, "testdata.txt");
+    ASSERT_NOT_NULL(fs_file_node);
+    ASSERT(fs_file_node->type == file);
+    ASSERT(fsfacade_size(fs_file_node) == len);
 
-        uint32_t len = fsfacade_size(fs_file_node);
-        ASSERT(len == 66);
+    uint8_t data[len + 1];
+    fsfacade_read(fs_file_node, 0, data, len);
+    data[len] = 0;
+    ASSERT(0 == strcmp(data, TEST_FAT_CONTENT));
 
-        uint8_t data[len + 1];
-        fsfacade_read(fs_file_node, data, len);
-        data[len] = 0;
-        //debug_show_memblock(data, len);
-        //kprintf("data '%s'\n", data);
-        ASSERT(0 == strcmp(data, "Do not modify this file.  It contains test data for test_initrd.c."));
+    // part way in, and across the end
+    uint8_t part[8];
+    ASSERT(6 == fsfacade_read(fs_file_node, 3, part, 6));
+    ASSERT(0 == memcmp(part, "not mo", 6));
+    ASSERT(3 == fsfacade_read(fs_file_node, len - 3, part, 8));
+    ASSERT(0 == memcmp(part, ".c.", 3));
+    ASSERT(0 == fsfacade_read(fs_file_node, len, part, 8));
 
-    } else {
-        kprintf("Unable to find %s\n", devicename);
+    uint8_t new_name[] = {"write.tmp"};
+    struct filesystem_node* fs_new_node = fsfacade_create(fs_root_node, new_name);
+    ASSERT_NOT_NULL(fs_new_node);
+    ASSERT(fsfacade_size(fs_new_node) == 0);
+    for (uint32_t i = 0; i < 10; i++) {
+        ASSERT(len == fsfacade_write(fs_new_node, i * len, data, len));
     }
+    ASSERT(fsfacade_size(fs_new_node) == (10 * len));
+    fsfacade_sync(fatfs);
+    ASSERT(6 == fsfacade_read(fs_new_node, (9 * len) + 3, part, 6));
+    ASSERT(0 == memcmp(part, "not mo", 6));
+    ASSERT(fsfacade_truncate(fs_new_node, 5));
+    ASSERT(0 == fsfacade_read(fs_new_node, 5, part, 8));
+    fat_detach(fatfs);
+
+    // and write.tmp with it
+    ramdisk_helper_remove_rd(dsk);
 }
@@ -5,16 +5,189 @@
 // See the file "LICENSE" in the source distribution for details  *
 // ****************************************************************
 
+#include <obj/logical/fs/block_util.h>
 #include <obj/logical/fs/initrd/initrd.h>
 #include <sys/debug/assert.h>
 #include <sys/fs/fs_facade.h>
+#include <sys/kmalloc/kmalloc.h>
 #include <sys/kprintf/kprintf.h>
 #include <sys/obj/objectinterface/objectinterface_filesystem.h>
 #include <sys/obj/objectmgr/objectmgr.h>
+#include <sys/string/mem.h>
 #include <sys/string/string.h>
+#include <tests/fs/ramdisk_helper.h>
 #include <tests/fs/test_initrd.h>
 #include <types.h>
 
+#define TEST_INITRD_LBA 10
+
+/*
+ * "abcabcabcabcabcabcabcaEND!!": the literals "abc", a match 3 back for 19 bytes, and the literals "END!!"
+ */
+const uint8_t TEST_INITRD_LZ4[] = {0x3F, 'a', 'b', 'c', 0x03, 0x00, 0x00, 0x50, 'E', 'N', 'D', '!', '!'};
+const uint8_t TEST_INITRD_DECODED[] = {"abcabcabcabcabcabcabcaEND!!"};
+
+/*
+ * a version 2 image, with a file stored as it is and a compressed one
+ */
+void test_initrd_v2(struct object* dsk) {
+    uint8_t image[512];
+    memzero(image, sizeof(image));
+    struct initrd2_header* header = (struct initrd2_header*)image;
+    memcpy(header->magic, INITRD_MAGIC, sizeof(header->magic));
+    header->version = INITRD_VERSION;
+    header->entry_size = sizeof(struct initrd2_entry);
+    header->number_files = 2;
+    header->index_offset = sizeof(struct initrd2_header);
+    header->image_size = sizeof(image);
+    struct initrd2_entry* entries = (struct initrd2_entry*)&(image[header->index_offset]);
+    uint64_t offset = header->index_offset + (2 * sizeof(struct initrd2_entry));
+    // sorted by name
+    strncpy(entries[0].name, "abc", INITRD_NAME_SIZE);
+    entries[0].offset = offset;
+    entries[0].length = strlen(TEST_INITRD_DECODED);
+    entries[0].stored_length = (2 * sizeof(uint64_t)) + sizeof(TEST_INITRD_LZ4);
+    entries[0].compression = INITRD_COMPRESSION_LZ4;
+    uint64_t chunks[2] = {2 * sizeof(uint64_t), (2 * sizeof(uint64_t)) + sizeof(TEST_INITRD_LZ4)};
+    memcpy(&(image[offset]), (uint8_t*)chunks, sizeof(chunks));
+    memcpy(&(image[offset + sizeof(chunks)]), TEST_INITRD_LZ4, sizeof(TEST_INITRD_LZ4));
+    offset += entries[0].stored_length;
+    strncpy(entries[1].name, "plain", INITRD_NAME_SIZE);
+    entries[1].offset = offset;
+    entries[1].length = 5;
+    entries[1].stored_length = 5;
+    entries[1].compression = INITRD_COMPRESSION_NONE;
+    memcpy(&(image[offset]), "plain", 5);
+    blockutil_update(dsk, image, sizeof(image), TEST_INITRD_LBA, 0);
+
+    struct object* initrd = initrd_attach(dsk, TEST_INITRD_LBA);
+    ASSERT_NOT_NULL(initrd);
+    struct filesystem_node* root = fsfacade_get_fs_rootnode(initrd);
+    struct filesystem_directory dir;
+    fsfacade_list_directory(root, &dir);
+    ASSERT(2 == dir.count);
+    ASSERT(0 == initrd_find_node_by_name(initrd, "missing"));
+    struct filesystem_node* abc = initrd_find_node_by_name(initrd, "abc");
+    ASSERT_NOT_NULL(abc);
+    ASSERT(abc == fsfacade_find_node_by_name(root, "abc"));
+    uint32_t len = fsfacade_size(abc);
+    ASSERT(len == strlen(TEST_INITRD_DECODED));
+    uint8_t data[len];
+    ASSERT(len == fsfacade_read(abc, 0, data, len));
+    ASSERT(0 == memcmp(data, TEST_INITRD_DECODED, len));
+    ASSERT(5 == fsfacade_read(abc, 22, data, 10));
+    ASSERT(0 == memcmp(data, "END!!", 5));
+    struct filesystem_node* plain = initrd_find_node_by_name(initrd, "plain");
+    ASSERT_NOT_NULL(plain);
+    ASSERT(3 == fsfacade_read(plain, 2, data, 10));
+    ASSERT(0 == memcmp(data, "ain", 3));
+    initrd_detach(initrd);
+}
+
+/*
+ * a version 1 image, whose table isn't sorted
+ */
+void test_initrd_v1(struct object* dsk) {
+    uint8_t image[sizeof(struct initrd_header) + 8];
+    memzero(image, sizeof(image));
+    struct initrd_header* header = (struct initrd_header*)image;
+    header->number_files = 2;
+    header->headers[0].magic = INITRD_FILE_MAGIC;
+    strncpy(header->headers[0].name, "zeta", INITRD_NAME_SIZE);
+    header->headers[0].offset = sizeof(struct initrd_header);
+    header->headers[0].length = 4;
+    header->headers[1].magic = INITRD_FILE_MAGIC;
+    strncpy(header->headers[1].name, "alpha", INITRD_NAME_SIZE);
+    header->headers[1].offset = sizeof(struct initrd_header) + 4;
+    header->headers[1].length = 4;
+    memcpy(&(image[sizeof(struct initrd_header)]), "zzzzaaaa", 8);
+    blockutil_update(dsk, image, sizeof(image), TEST_INITRD_LBA, 0);
+
+    struct object* initrd = initrd_attach(dsk, TEST_INITRD_LBA);
+    ASSERT_NOT_NULL(initrd);
+    uint8_t data[4];
+    struct filesystem_node* alpha = initrd_find_node_by_name(initrd, "alpha");
+    ASSERT_NOT_NULL(alpha);
+    ASSERT(4 == fsfacade_read(alpha, 0, data, 4));
+    ASSERT(0 == memcmp(data, "aaaa", 4));
+    struct filesystem_node* zeta = initrd_find_node_by_name(initrd, "zeta");
+    ASSERT_NOT_NULL(zeta);
+    ASSERT(4 == fsfacade_read(zeta, 0, data, 4));
+    ASSERT(0 == memcmp(data, "zzzz", 4));
+    initrd_detach(initrd);
+}
+
+/*
+ * a version 2 image in memory, with the disk under it empty.  a file stored as it is, on a page of its own, can be
+ * mapped; a compressed one can't
+ */
+void test_initrd_memory(struct object* dsk) {
+    uint8_t* buffer = kmalloc(4 * INITRD_PAGE_SIZE);
+    uint8_t* image = (uint8_t*)((((uint64_t)buffer + INITRD_PAGE_SIZE - 1) / INITRD_PAGE_SIZE) * INITRD_PAGE_SIZE);
+    uint64_t image_size = 2 * INITRD_PAGE_SIZE;
+    memzero(image, image_size);
+    struct initrd2_header* header = (struct initrd2_header*)image;
+    memcpy(header->magic, INITRD_MAGIC, sizeof(header->magic));
+    header->version = INITRD_VERSION;
+    header->entry_size = sizeof(struct initrd2_entry);
+    header->number_files = 2;
+    header->index_offset = sizeof(struct initrd2_header);
+    header->image_size = image_size;
+    struct initrd2_entry* entries = (struct initrd2_entry*)&(image[header->index_offset]);
+    uint64_t offset = header->index_offset + (2 * sizeof(struct initrd2_entry));
+    strncpy(entries[0].name, "abc", INITRD_NAME_SIZE);
+    entries[0].offset = offset;
+    entries[0].length = strlen(TEST_INITRD_DECODED);
+    entries[0].stored_length = (2 * sizeof(uint64_t)) + sizeof(TEST_INITRD_LZ4);
+    entries[0].compression = INITRD_COMPRESSION_LZ4;
+    uint64_t chunks[2] = {2 * sizeof(uint64_t), (2 * sizeof(uint64_t)) + sizeof(TEST_INITRD_LZ4)};
+    memcpy(&(image[offset]), (uint8_t*)chunks, sizeof(chunks));
+    memcpy(&(image[offset + sizeof(chunks)]), TEST_INITRD_LZ4, sizeof(TEST_INITRD_LZ4));
+    strncpy(entries[1].name, "page", INITRD_NAME_SIZE);
+    entries[1].offset = INITRD_PAGE_SIZE;
+    entries[1].length = 4;
+    entries[1].stored_length = 4;
+    entries[1].compression = INITRD_COMPRESSION_NONE;
+    memcpy(&(image[INITRD_PAGE_SIZE]), "page", 4);
+    // nothing on the disk
+    uint8_t zeros[512];
+    memzero(zeros, sizeof(zeros));
+    blockutil_update(dsk, zeros, sizeof(zeros), TEST_INITRD_LBA, 0);
+
+    struct object* initrd = initrd_attach_image(dsk, TEST_INITRD_LBA, image, image_size);
+    ASSERT_NOT_NULL(initrd);
+    struct filesystem_node* abc = initrd_find_node_by_name(initrd, "abc");
+    ASSERT_NOT_NULL(abc);
+    uint32_t len = fsfacade_size(abc);
+    uint8_t data[len];
+    ASSERT(len == fsfacade_read(abc, 0, data, len));
+    ASSERT(0 == memcmp(data, TEST_INITRD_DECODED, len));
+    ASSERT(0 == fsfacade_map(abc));
+    struct filesystem_node* page = initrd_find_node_by_name(initrd, "page");
+    ASSERT_NOT_NULL(page);
+    ASSERT(&(image[INITRD_PAGE_SIZE]) == fsfacade_map(page));
+    ASSERT(3 == fsfacade_read(page, 1, data, 3));
+    ASSERT(0 == memcmp(data, "age", 3));
+    // past the end of the page isn't zeros, so it's not to be mapped
+    image[(2 * INITRD_PAGE_SIZE) - 1] = 1;
+    ASSERT(0 == fsfacade_map(page));
+    initrd_detach(initrd);
+    kfree(buffer);
+}
+
+/*
+ * both versions, on a ramdisk, and an image in memory
+ */
+void test_initrd_formats() {
+    kprintf("Testing initrd formats\n");
+    struct object* dsk = ramdisk_helper_create_rd();
+    ASSERT_NOT_NULL(dsk);
+    test_initrd_v2(dsk);
+    test_initrd_v1(dsk);
+    test_initrd_memory(dsk);
+    ramdisk_helper_remove_rd(dsk);
+}
+
 void test_initrd() {
     kprintf("Testing initrd\n");
 
@@ -40,12 +213,20 @@ void test_initrd() {
         ASSERT(len == 66);
 
         uint8_t data[len + 1];
-        fsfacade_read(fs_file_node, data, len);
+        fsfacade_read(fs_file_node, 0, data, len);
         data[len] = 0;
         //debug_show_memblock(data, len);
         //kprintf("data '%s'\n", data);
         ASSERT(0 == strcmp(data, "Do not modify this file.  It contains test data for test_initrd.c."));
 
+        // part way in, and across the end
+        uint8_t part[8];
+        ASSERT(6 == fsfacade_read(fs_file_node, 3, part, 6));
+        ASSERT(0 == memcmp(part, "not mo", 6));
+        ASSERT(3 == fsfacade_read(fs_file_node, len - 3, part, 8));
+        ASSERT(0 == memcmp(part, ".c.", 3));
+        ASSERT(0 == fsfacade_read(fs_file_node, len, part, 8));
+
         // detach
         initrd_detach(initrd);
     } else {
@@ -9,5 +9,6 @@
 #define __TEST_INITRD_H
 
 void test_initrd();
+void test_initrd_formats();
 
 #endif
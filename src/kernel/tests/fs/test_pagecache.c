@@ -0,0 +1,119 @@
+//*****************************************************************
+// This file is part of CosmOS                                    *
+// Copyright (C) 2021 Tom Everett                                 *
+// Released under the stated terms in the file LICENSE            *
+// See the file "LICENSE" in the source distribution for details  *
+// ****************************************************************
+
+#include <obj/logical/fs/tfs/tfs.h>
+#include <sys/debug/assert.h>
+#include <sys/fs/fs_facade.h>
+#include <sys/fs/pagecache.h>
+#include <sys/kmalloc/kmalloc.h>
+#include <sys/kprintf/kprintf.h>
+#include <sys/obj/objectinterface/objectinterface_filesystem.h>
+#include <sys/string/mem.h>
+#include <sys/sync/sync.h>
+#include <sys/x86-64/mm/mm.h>
+#include <sys/x86-64/mm/pagetables.h>
+#include <tests/fs/ramdisk_helper.h>
+#include <tests/fs/test_pagecache.h>
+#include <types.h>
+
+// a page and a bit
+#define TEST_PAGECACHE_SIZE (PAGE_SIZE + 100)
+
+void test_pagecache() {
+    kprintf("Testing page cache\n");
+
+    struct object* dsk = ramdisk_helper_create_rd();
+    ASSERT_NOT_NULL(dsk);
+    tfs_format(dsk);
+    struct object* obj = tfs_attach(dsk);
+    ASSERT_NOT_NULL(obj);
+    struct filesystem_node* root = fsfacade_get_fs_rootnode(obj);
+    struct filesystem_node* node = fsfacade_create(root, "pc");
+    ASSERT_NOT_NULL(node);
+
+    uint8_t* data = kmalloc(TEST_PAGECACHE_SIZE);
+    uint8_t* got = kmalloc(TEST_PAGECACHE_SIZE);
+    for (uint32_t i = 0; i < TEST_PAGECACHE_SIZE; i++) {
+        data[i] = (uint8_t)((i * 7) + (i / PAGE_SIZE));
+    }
+    ASSERT(TEST_PAGECACHE_SIZE == fsfacade_write(node, 0, data, TEST_PAGECACHE_SIZE));
+
+    // the first read fills the cache, and the second comes from it
+    struct pagecache_stats before;
+    struct pagecache_stats after;
+    pagecache_stats(&before);
+    ASSERT(TEST_PAGECACHE_SIZE == fsfacade_read(node, 0, got, TEST_PAGECACHE_SIZE));
+    ASSERT(0 == memcmp(got, data, TEST_PAGECACHE_SIZE));
+    pagecache_stats(&after);
+    ASSERT((before.misses + 2) == after.misses);
+    ASSERT(TEST_PAGECACHE_SIZE == fsfacade_read(node, 0, got, TEST_PAGECACHE_SIZE));
+    ASSERT(0 == memcmp(got, data, TEST_PAGECACHE_SIZE));
+    pagecache_stats(&before);
+    ASSERT((after.hits + 2) == before.hits);
+    ASSERT(after.misses == before.misses);
+
+    // reads at the end are short
+    ASSERT(10 == fsfacade_read(node, TEST_PAGECACHE_SIZE - 10, got, 100));
+    ASSERT(0 == fsfacade_read(node, TEST_PAGECACHE_SIZE, got, 100));
+
+    // a write is seen by the next read
+    memset(&(data[PAGE_SIZE - 5]), 'x', 10);
+    ASSERT(10 == fsfacade_write(node, PAGE_SIZE - 5, &(data[PAGE_SIZE - 5]), 10));
+    ASSERT(20 == fsfacade_read(node, PAGE_SIZE - 10, got, 20));
+    ASSERT(0 == memcmp(got, &(data[PAGE_SIZE - 10]), 20));
+
+    // and so is the gap a write past the end leaves, in what was the last page
+    ASSERT(1 == fsfacade_write(node, 3 * PAGE_SIZE, "!", 1));
+    ASSERT(((3 * PAGE_SIZE) + 1) == fsfacade_size(node));
+    ASSERT(100 == fsfacade_read(node, TEST_PAGECACHE_SIZE - 50, got, 100));
+    ASSERT(0 == memcmp(got, &(data[TEST_PAGECACHE_SIZE - 50]), 50));
+    for (uint32_t i = 50; i < 100; i++) {
+        ASSERT(0 == got[i]);
+    }
+
+    // the shrinker gives up, rather than wait, when the cache is locked
+    pagecache_stats(&before);
+    ASSERT(before.pages > 1);
+    spinlock_acquire(&pagecache_lock);
+    ASSERT(0 == pagecache_shrink(PAGECACHE_MAX_PAGES));
+    spinlock_release(&pagecache_lock);
+    pagecache_stats(&after);
+    ASSERT(before.pages == after.pages);
+
+    // a page that's held is the one reads come from, and the shrinker leaves it
+    uint64_t page = pagecache_get_page(node, 0);
+    ASSERT_NOT_NULL(page);
+    ASSERT(0 == memcmp(CONV_PHYS_ADDR(page * PAGE_SIZE), data, PAGE_SIZE));
+    pagecache_shrink(PAGECACHE_MAX_PAGES);
+    pagecache_stats(&after);
+    ASSERT(1 == after.pages);
+    ASSERT(page == pagecache_get_page(node, 0));
+    pagecache_put_page(page);
+
+    // the last page is zero filled past the end
+    uint64_t last = pagecache_get_page(node, 3);
+    ASSERT_NOT_NULL(last);
+    uint8_t* last_data = CONV_PHYS_ADDR(last * PAGE_SIZE);
+    ASSERT('!' == last_data[0]);
+    for (uint32_t i = 1; i < PAGE_SIZE; i++) {
+        ASSERT(0 == last_data[i]);
+    }
+    pagecache_put_page(last);
+    ASSERT(0 == pagecache_get_page(node, 4));
+
+    // a truncated file reads short, even from a held page
+    ASSERT(fsfacade_truncate(node, 5));
+    ASSERT(5 == fsfacade_read(node, 0, got, TEST_PAGECACHE_SIZE));
+    ASSERT(0 == memcmp(got, data, 5));
+    ASSERT(0 == memcmp(CONV_PHYS_ADDR(page * PAGE_SIZE), data, PAGE_SIZE));
+    pagecache_put_page(page);
+
+    kfree(data);
+    kfree(got);
+    tfs_detach(obj);
+    ramdisk_helper_remove_rd(dsk);
+}
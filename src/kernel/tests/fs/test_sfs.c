@@ -5,20 +5,105 @@
 // See the file "LICENSE" in the source distribution for details  *
 // ****************************************************************
 
+#include <obj/logical/fs/block_util.h>
 #include <obj/logical/fs/sfs/sfs.h>
+#include <obj/logical/fs/sfs/sfs_block.h>
+#include <sys/debug/assert.h>
+#include <sys/fs/fs_facade.h>
 #include <sys/kprintf/kprintf.h>
+#include <sys/obj/objectinterface/objectinterface_filesystem.h>
 #include <sys/obj/objectmgr/objectmgr.h>
+#include <sys/string/mem.h>
+#include <sys/string/string.h>
+#include <tests/fs/ramdisk_helper.h>
 #include <tests/fs/test_sfs.h>
 #include <types.h>
 
+#define TEST_SFS_LONG_NAME "docs/a name too long for the file entry alone"
+
+/*
+ * an index area of starting marker, folder "docs", file "hello" at block 1 and a file under docs at block 4,
+ * whose name takes a continuation entry, and the volume identifier
+ */
+void test_sfs_make_image(struct object* dsk, uint32_t length) {
+    uint8_t index[6 * SFS_ENTRY_SIZE];
+    memzero(index, sizeof(index));
+    index[0] = SFS_STARTING_MARKER;
+    struct sfs_directory_entry* dir = (struct sfs_directory_entry*)&(index[SFS_ENTRY_SIZE]);
+    dir->entry_type = SFS_DIRECTORY_ENTRY;
+    strncpy(dir->name, "docs", SFS_DIRECTORY_NAME_SIZE);
+    struct sfs_file_entry* hello = (struct sfs_file_entry*)&(index[2 * SFS_ENTRY_SIZE]);
+    hello->entry_type = SFS_FILE_ENTRY;
+    hello->start_block = 1;
+    hello->end_block = 3;
+    hello->file_length = length;
+    strncpy(hello->name, "hello", SFS_FILE_NAME_SIZE);
+    struct sfs_file_entry* other = (struct sfs_file_entry*)&(index[3 * SFS_ENTRY_SIZE]);
+    other->entry_type = SFS_FILE_ENTRY;
+    other->number_continuations = 1;
+    other->start_block = 4;
+    other->end_block = 4;
+    other->file_length = 5;
+    memcpy(&(index[4 * SFS_ENTRY_SIZE - SFS_FILE_NAME_SIZE]), TEST_SFS_LONG_NAME, strlen(TEST_SFS_LONG_NAME));
+    index[5 * SFS_ENTRY_SIZE] = SFS_VOLUME_IDENTIFIER;
+    uint32_t sectors = blockutil_get_sector_count(dsk);
+    blockutil_update(dsk, index, sizeof(index), sectors - 1, 512 - sizeof(index));
+
+    struct sfs_superblock superblock;
+    blockutil_read(dsk, (uint8_t*)&superblock, sizeof(struct sfs_superblock), 0, 0);
+    superblock.indexarea_size_bytes = sizeof(index);
+    superblock.dataarea_size_blocks = 4;
+    // keep the checksum right
+    superblock.checksum -= 2 * SFS_ENTRY_SIZE;
+    superblock.checksum += sizeof(index);
+    blockutil_update(dsk, (uint8_t*)&superblock, sizeof(struct sfs_superblock), 0, 0);
+}
+
 void test_sfs() {
-    uint8_t devicename[] = {"disk1"};
-
-    struct object* dsk = objectmgr_find_object_by_name(devicename);
-    if (0 != dsk) {
-        struct object* obj = sfs_attach(dsk);
-        sfs_detach(obj);
-    } else {
-        kprintf("Unable to find %s\n", devicename);
+    kprintf("Testing SFS\n");
+
+    struct object* dsk = ramdisk_helper_create_rd();
+    ASSERT_NOT_NULL(dsk);
+    // nothing there yet
+    ASSERT(0 == sfs_attach(dsk));
+    sfs_format(dsk);
+
+    struct object* obj = sfs_attach(dsk);
+    ASSERT_NOT_NULL(obj);
+    struct filesystem_node* root = fsfacade_get_fs_rootnode(obj);
+    ASSERT_NOT_NULL(root);
+    // read-only
+    ASSERT(0 == fsfacade_create(root, "file"));
+    sfs_detach(obj);
+
+    // 1200 bytes, over blocks 1 to 3
+    uint8_t data[1200];
+    for (uint32_t i = 0; i < sizeof(data); i++) {
+        data[i] = i & 0xFF;
     }
+    blockutil_update(dsk, data, sizeof(data), 1, 0);
+    blockutil_update(dsk, "hello", 5, 4, 0);
+    test_sfs_make_image(dsk, sizeof(data));
+
+    obj = sfs_attach(dsk);
+    ASSERT_NOT_NULL(obj);
+    root = fsfacade_get_fs_rootnode(obj);
+    struct filesystem_node* hello = fsfacade_find_node_by_name(root, "hello");
+    ASSERT_NOT_NULL(hello);
+    ASSERT(hello == sfs_find_node_by_path(obj, "hello"));
+    ASSERT(sizeof(data) == fsfacade_size(hello));
+    uint8_t buffer[sizeof(data)];
+    ASSERT(sizeof(data) == fsfacade_read(hello, 0, buffer, sizeof(buffer)));
+    ASSERT(0 == memcmp(buffer, data, sizeof(data)));
+    ASSERT(100 == fsfacade_read(hello, 1100, buffer, sizeof(buffer)));
+    ASSERT(0 == memcmp(buffer, &(data[1100]), 100));
+    struct filesystem_node* other = fsfacade_find_node_by_path(root, TEST_SFS_LONG_NAME);
+    ASSERT_NOT_NULL(other);
+    ASSERT(other == sfs_find_node_by_path(obj, TEST_SFS_LONG_NAME));
+    ASSERT(5 == fsfacade_read(other, 0, buffer, sizeof(buffer)));
+    ASSERT(0 == memcmp(buffer, "hello", 5));
+    ASSERT(0 == sfs_find_node_by_path(obj, "docs/missing"));
+    sfs_detach(obj);
+
+    ramdisk_helper_remove_rd(dsk);
 }
@@ -6,22 +6,124 @@
 // ****************************************************************
 
 #include <obj/logical/fs/tfs/tfs.h>
+#include <obj/logical/fs/tfs/tfs_block.h>
+#include <sys/debug/assert.h>
+#include <sys/fs/fs_facade.h>
 #include <sys/kprintf/kprintf.h>
+#include <sys/obj/objectinterface/objectinterface_filesystem.h>
 #include <sys/obj/objectmgr/objectmgr.h>
+#include <sys/string/mem.h>
+#include <sys/string/string.h>
+#include <tests/fs/ramdisk_helper.h>
 #include <tests/fs/test_tfs.h>
 #include <types.h>
 
 uint8_t FILE1_CONTENT[] = {"This is the file i am i am, this is the file i am"};
 uint8_t FILE1_NAME[] = {"Dave"};
+uint8_t FILE2_NAME[] = {"Hal"};
+uint8_t FILE3_NAME[] = {"Frank"};
+uint8_t FILE4_NAME[] = {"Poole"};
+
+/*
+ * two files take a block each in turn, with a sync between so neither keeps what it preallocated.  that gives
+ * each all the extents its file block holds.  a third fills the disk, less a block, so the next extent has no room
+ * for the allocation block that has to record it
+ */
+void test_tfs_full_disk(struct object* dsk) {
+    tfs_format(dsk);
+    struct object* obj = tfs_attach(dsk);
+    ASSERT_NOT_NULL(obj);
+    struct filesystem_node* root = fsfacade_get_fs_rootnode(obj);
+    struct filesystem_node* files[3];
+    files[0] = fsfacade_create(root, FILE2_NAME);
+    files[1] = fsfacade_create(root, FILE3_NAME);
+    files[2] = fsfacade_create(root, FILE4_NAME);
+    uint8_t block[TFS_BLOCK_SIZE];
+    uint64_t written[3] = {0, 0, 0};
+    for (uint8_t e = 0; e < TFS_EXTENTS_PER_FILE_BLOCK; e++) {
+        for (uint8_t i = 0; i < 2; i++) {
+            memset(block, 'a' + i, TFS_BLOCK_SIZE);
+            ASSERT(TFS_BLOCK_SIZE == fsfacade_write(files[i], written[i], block, TFS_BLOCK_SIZE));
+            written[i] += TFS_BLOCK_SIZE;
+            fsfacade_sync(obj);
+        }
+    }
+    memset(block, 'c', TFS_BLOCK_SIZE);
+    uint32_t count = 0;
+    do {
+        count = fsfacade_write(files[2], written[2], block, TFS_BLOCK_SIZE);
+        written[2] += count;
+        fsfacade_sync(obj);
+    } while (0 != count);
+    written[2] -= TFS_BLOCK_SIZE;
+    ASSERT(fsfacade_truncate(files[2], written[2]));
+    fsfacade_sync(obj);
+
+    // a block for the data, none to record where it is
+    memset(block, 'a', TFS_BLOCK_SIZE);
+    ASSERT(0 == fsfacade_write(files[0], written[0], block, TFS_BLOCK_SIZE));
+    fsfacade_sync(obj);
+    written[2] -= TFS_BLOCK_SIZE;
+    ASSERT(fsfacade_truncate(files[2], written[2]));
+    ASSERT(TFS_BLOCK_SIZE == fsfacade_write(files[0], written[0], block, TFS_BLOCK_SIZE));
+    written[0] += TFS_BLOCK_SIZE;
+    tfs_detach(obj);
+
+    obj = tfs_attach(dsk);
+    ASSERT_NOT_NULL(obj);
+    root = fsfacade_get_fs_rootnode(obj);
+    files[0] = fsfacade_find_node_by_name(root, FILE2_NAME);
+    files[1] = fsfacade_find_node_by_name(root, FILE3_NAME);
+    files[2] = fsfacade_find_node_by_name(root, FILE4_NAME);
+    for (uint8_t i = 0; i < 3; i++) {
+        ASSERT_NOT_NULL(files[i]);
+        ASSERT(fsfacade_size(files[i]) == written[i]);
+        ASSERT(TFS_BLOCK_SIZE == fsfacade_read(files[i], written[i] - TFS_BLOCK_SIZE, block, TFS_BLOCK_SIZE));
+        ASSERT(('a' + i) == block[0]);
+        ASSERT(('a' + i) == block[TFS_BLOCK_SIZE - 1]);
+    }
+    tfs_detach(obj);
+}
 
 void test_tfs() {
-    uint8_t devicename[] = {"disk1"};
-
-    struct object* dsk = objectmgr_find_object_by_name(devicename);
-    if (0 != dsk) {
-        struct object* obj = tfs_attach(dsk);
-        tfs_detach(obj);
-    } else {
-        kprintf("Unable to find %s\n", devicename);
+    kprintf("Testing TFS\n");
+
+    struct object* dsk = ramdisk_helper_create_rd();
+    ASSERT_NOT_NULL(dsk);
+    // nothing there yet
+    ASSERT(0 == tfs_attach(dsk));
+    tfs_format(dsk);
+
+    struct object* obj = tfs_attach(dsk);
+    ASSERT_NOT_NULL(obj);
+    struct filesystem_node* root = fsfacade_get_fs_rootnode(obj);
+    ASSERT_NOT_NULL(root);
+    struct filesystem_node* file1 = fsfacade_create(root, FILE1_NAME);
+    ASSERT_NOT_NULL(file1);
+    ASSERT(0 == fsfacade_create(root, FILE1_NAME));
+    uint32_t len = strlen(FILE1_CONTENT);
+    // a few times over, across block boundaries
+    for (uint32_t i = 0; i < 40; i++) {
+        ASSERT(len == fsfacade_write(file1, i * len, FILE1_CONTENT, len));
     }
+    ASSERT(fsfacade_size(file1) == (40 * len));
+    tfs_detach(obj);
+
+    obj = tfs_attach(dsk);
+    ASSERT_NOT_NULL(obj);
+    root = fsfacade_get_fs_rootnode(obj);
+    file1 = fsfacade_find_node_by_name(root, FILE1_NAME);
+    ASSERT_NOT_NULL(file1);
+    ASSERT(fsfacade_size(file1) == (40 * len));
+    uint8_t data[len];
+    ASSERT(len == fsfacade_read(file1, 39 * len, data, len));
+    ASSERT(0 == memcmp(data, FILE1_CONTENT, len));
+    ASSERT(fsfacade_truncate(file1, 5));
+    ASSERT(5 == fsfacade_read(file1, 0, data, len));
+    ASSERT(0 == memcmp(data, FILE1_CONTENT, 5));
+    tfs_detach(obj);
+
+    test_tfs_full_disk(dsk);
+
+    ramdisk_helper_remove_rd(dsk);
 }
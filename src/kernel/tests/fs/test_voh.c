@@ -8,8 +8,11 @@
 #include <sys/debug/assert.h>
 #include <sys/fs/fs_facade.h>
 #include <sys/kprintf/kprintf.h>
+#include <sys/obj/object/object.h>
 #include <sys/obj/objectinterface/objectinterface_filesystem.h>
 #include <sys/obj/objectmgr/objectmgr.h>
+#include <sys/string/mem.h>
+#include <sys/string/string.h>
 
 void test_voh() {
     kprintf("Testing voh\n");
@@ -20,4 +23,19 @@ void test_voh() {
     struct filesystem_node* fsnode = fsfacade_get_fs_rootnode(vohdev_device);
     ASSERT_NOT_NULL(fsnode);
     ASSERT(fsnode->type == folder);
+
+    // the root has no data
+    uint8_t data[OBJECT_MAX_DESCRIPTION + 1];
+    ASSERT(0 == fsfacade_read(fsnode, 0, data, sizeof(data)));
+
+    // an objfs node reads as the object's description
+    struct filesystem_node* objnode = fsfacade_find_node_by_path(fsnode, "objfs0/voh0");
+    ASSERT_NOT_NULL(objnode);
+    uint32_t len = strlen(vohdev_device->description);
+    ASSERT(fsfacade_size(objnode) == len + 1);
+    ASSERT(len + 1 == fsfacade_read(objnode, 0, data, sizeof(data)));
+    ASSERT(0 == memcmp(data, vohdev_device->description, len));
+    ASSERT('\n' == data[len]);
+    ASSERT(2 == fsfacade_read(objnode, len - 1, data, sizeof(data)));
+    ASSERT(0 == fsfacade_read(objnode, len + 1, data, sizeof(data)));
 }
\ No newline at end of file
@@ -5,34 +5,57 @@
 // See the file "LICENSE" in the source distribution for details  *
 // ****************************************************************
 
+#include <obj/logical/ethernet/ethernet.h>
+#include <obj/logical/loopback/loopback.h>
 #include <obj/logical/tcpip/arp/arpdev.h>
-#include <sys/debug/debug.h>
+#include <sys/debug/assert.h>
 #include <sys/kprintf/kprintf.h>
+#include <sys/netbuf/netbuf.h>
 #include <sys/obj/object/object.h>
 #include <sys/obj/objectinterface/objectinterface_arp.h>
+#include <sys/obj/objectinterface/objectinterface_ip.h>
 #include <sys/obj/objectmgr/objectmgr.h>
 #include <sys/string/mem.h>
 #include <tests/obj/test_arp.h>
 #include <types.h>
 
-void test_arp() {
-    uint8_t devicename[] = {"arp0"};
-
-    struct object* arp = objectmgr_find_object_by_name(devicename);
-    if (0 != arp) {
-        struct objectinterface_arp* arp_api = (struct objectinterface_arp*)arp->api;
-
-        struct arp arp_request;
-        arp_packet_init(&arp_request, ARP_REQUEST);
-
-        struct arp arp_response;
-        memzero((uint8_t*)&arp_response, sizeof(struct arp));
-
-        (*arp_api->request)(arp, &arp_request, &arp_response);
-
-        debug_show_memblock((uint8_t*)&arp_response, sizeof(struct arp));
+struct netbuf* test_arp_frame(uint8_t* data, uint16_t size) {
+    struct netbuf* nb = netbuf_new(NETBUF_HEADROOM);
+    memcpy(netbuf_put(nb, size), data, size);
+    return nb;
+}
 
-    } else {
-        kprintf("Unable to find %s\n", devicename);
-    }
+void test_arp() {
+    kprintf("Testing ARP\n");
+
+    // ARP on a loopback NIC answers its own requests
+    struct object* lo = loopback_attach();
+    struct object* eth = ethernet_attach(lo);
+    struct object* arp = arp_attach(eth);
+    ASSERT_NOT_NULL(arp);
+    struct objectinterface_arp* arp_api = (struct objectinterface_arp*)arp->api;
+
+    uint32_t local = IP_ADDRESS(127, 0, 0, 1);
+    uint32_t remote = IP_ADDRESS(127, 0, 0, 2);
+    (*arp_api->set_address)(arp, local);
+
+    uint8_t hw[ARP_HLEN];
+    memset(hw, 0xAA, ARP_HLEN);
+    ASSERT(0 == (*arp_api->resolve)(arp, local, hw));
+
+    // sending to an unresolved address queues the frame and sends a request, which comes back to us
+    uint8_t payload[] = {"arp pending"};
+    (*arp_api->output)(arp, local, ETHERNET_TYPE_IP, test_arp_frame(payload, sizeof(payload)));
+    ASSERT(1 == (*arp_api->resolve)(arp, local, hw));
+    uint8_t lo_hw[ARP_HLEN];
+    memzero(lo_hw, ARP_HLEN);
+    ASSERT(0 == memcmp(hw, lo_hw, ARP_HLEN));
+
+    // no one answers for remote
+    (*arp_api->output)(arp, remote, ETHERNET_TYPE_IP, test_arp_frame(payload, sizeof(payload)));
+    ASSERT(0 == (*arp_api->resolve)(arp, remote, hw));
+
+    arp_detach(arp);
+    ethernet_detach(eth);
+    loopback_detach(lo);
 }
@@ -0,0 +1,133 @@
+//*****************************************************************
+// This file is part of CosmOS                                    *
+// Copyright (C) 2021 Tom Everett                                 *
+// Released under the stated terms in the file LICENSE            *
+// See the file "LICENSE" in the source distribution for details  *
+// ****************************************************************
+
+#include <obj/logical/tcpip/ip/ipdev.h>
+#include <sys/debug/assert.h>
+#include <sys/kprintf/kprintf.h>
+#include <sys/netbuf/netbuf.h>
+#include <sys/obj/objectinterface/objectinterface_ip.h>
+#include <sys/obj/objectinterface/objectinterface_udp.h>
+#include <sys/string/mem.h>
+#include <tests/obj/test_checksum.h>
+#include <types.h>
+
+#define TEST_CHECKSUM_MAX 100
+
+/*
+ * RFC 1071, one 16 bit word at a time, as the words lie in memory
+ */
+uint16_t test_checksum_reference(uint8_t* data, uint16_t count) {
+    uint32_t sum = 0;
+    for (uint16_t i = 0; (i + 1) < count; i += 2) {
+        sum += data[i] | (data[i + 1] << 8);
+    }
+    if (0 != (count & 1)) {
+        sum += data[count - 1];
+    }
+    while (sum >> 16) {
+        sum = (sum & 0xFFFF) + (sum >> 16);
+    }
+    return ~sum;
+}
+
+/*
+ * a UDP segment of header and payload, split into segments of the given sizes. the first holds the header
+ */
+struct netbuf* test_checksum_segment(uint16_t* sizes, uint8_t count) {
+    struct netbuf* ret = 0;
+    uint8_t n = 0;
+    for (uint8_t i = 0; i < count; i++) {
+        struct netbuf* nb = netbuf_new(NETBUF_HEADROOM);
+        uint8_t* data = netbuf_put(nb, sizes[i]);
+        for (uint16_t j = 0; j < sizes[i]; j++) {
+            data[j] = 0xF0 + (n++ % 17);
+        }
+        if (0 == ret) {
+            ret = nb;
+        } else {
+            netbuf_append(ret, nb);
+        }
+    }
+    return ret;
+}
+
+void test_checksum() {
+    kprintf("Testing checksum\n");
+
+    /*
+     * the word at a time sum agrees with the reference, for any length and alignment. the data is mostly 0xFF, so
+     * every add carries
+     */
+    uint8_t data[TEST_CHECKSUM_MAX + 8];
+    for (uint16_t i = 0; i < sizeof(data); i++) {
+        data[i] = (0 == (i % 5)) ? i : 0xFF;
+    }
+    for (uint8_t align = 0; align < 8; align++) {
+        for (uint16_t count = 0; count <= TEST_CHECKSUM_MAX; count++) {
+            ASSERT(ip_checksum(data + align, count) == test_checksum_reference(data + align, count));
+        }
+    }
+
+    /*
+     * an IP header changed a field at a time, as a router would: the incremental update matches a full recompute
+     */
+    struct ip_header header;
+    ip_header_init(&header, 100, IP_PROTOCOL_UDP, IP_ADDRESS(10, 0, 2, 15), IP_ADDRESS(10, 0, 2, 2));
+    ASSERT(0 == ip_checksum((uint8_t*)&header, IP_HEADER_LEN));
+
+    uint16_t old_word;
+    uint16_t new_word;
+    memcpy((uint8_t*)&old_word, ((uint8_t*)&header) + 8, sizeof(uint16_t));  // ttl and protocol
+    header.ttl--;
+    memcpy((uint8_t*)&new_word, ((uint8_t*)&header) + 8, sizeof(uint16_t));
+    uint16_t csum = ip_checksum_update16(header.csum, old_word, new_word);
+    header.csum = 0;
+    ASSERT(csum == ip_checksum((uint8_t*)&header, IP_HEADER_LEN));
+    header.csum = csum;
+
+    uint32_t old_address = header.daddr;
+    uint32_t new_address = IP_ADDRESS(192, 168, 255, 254);
+    header.daddr = new_address;
+    csum = ip_checksum_update32(header.csum, old_address, new_address);
+    header.csum = 0;
+    ASSERT(csum == ip_checksum((uint8_t*)&header, IP_HEADER_LEN));
+    header.csum = csum;
+    ASSERT(0 == ip_checksum((uint8_t*)&header, IP_HEADER_LEN));
+
+    /*
+     * a checksum started with the pseudo header and finished later, in one segment or many, verifies
+     */
+    uint32_t saddr = IP_ADDRESS(1, 2, 3, 4);
+    uint32_t daddr = IP_ADDRESS(5, 6, 7, 8);
+    uint16_t one[] = {UDP_HEADER_LEN + 57};
+    uint16_t many[] = {UDP_HEADER_LEN + 3, 1, 16, 7, 30};
+    struct netbuf* segments[] = {test_checksum_segment(one, 1), test_checksum_segment(many, 5)};
+    for (uint8_t i = 0; i < 2; i++) {
+        struct netbuf* nb = segments[i];
+        uint16_t len = netbuf_length(nb);
+        ASSERT((UDP_HEADER_LEN + 57) == len);
+        ip_checksum_partial(nb, saddr, daddr, IP_PROTOCOL_UDP, UDP_CSUM_OFFSET);
+        ASSERT(NETBUF_CSUM_PARTIAL == nb->csum);
+        ip_checksum_complete(nb);
+        ASSERT(NETBUF_CSUM_NONE == nb->csum);
+        ASSERT(0 == ip_checksum_pseudo(saddr, daddr, IP_PROTOCOL_UDP, nb, len));
+        // and a flipped bit doesn't
+        nb->data[UDP_HEADER_LEN] ^= 0x10;
+        ASSERT(0 != ip_checksum_pseudo(saddr, daddr, IP_PROTOCOL_UDP, nb, len));
+        netbuf_release(nb);
+    }
+
+    // linearizing a chain keeps the checksum still to be done where it was
+    struct netbuf* nb = test_checksum_segment(many, 5);
+    uint16_t len = netbuf_length(nb);
+    ip_checksum_partial(nb, saddr, daddr, IP_PROTOCOL_UDP, UDP_CSUM_OFFSET);
+    nb = netbuf_linearize(nb);
+    ASSERT(0 == nb->chain);
+    ip_checksum_complete(nb);
+    ASSERT(0 == ip_checksum_pseudo(saddr, daddr, IP_PROTOCOL_UDP, nb, len));
+    netbuf_release(nb);
+}
@@ -0,0 +1,13 @@
+//*****************************************************************
+// This file is part of CosmOS                                    *
+// Copyright (C) 2021 Tom Everett                                 *
+// Released under the stated terms in the file LICENSE            *
+// See the file "LICENSE" in the source distribution for details  *
+// ****************************************************************
+
+#ifndef __TEST_CHECKSUM_H
+#define __TEST_CHECKSUM_H
+
+void test_checksum();
+
+#endif
@@ -0,0 +1,172 @@
+//*****************************************************************
+// This file is part of CosmOS                                    *
+// Copyright (C) 2021 Tom Everett                                 *
+// Released under the stated terms in the file LICENSE            *
+// See the file "LICENSE" in the source distribution for details  *
+// ****************************************************************
+
+#include <obj/logical/ethernet/ethernet.h>
+#include <obj/logical/loopback/loopback.h>
+#include <obj/logical/tcpip/arp/arpdev.h>
+#include <obj/logical/tcpip/ip/ipdev.h>
+#include <obj/logical/tcpip/tcp/tcpdev.h>
+#include <sys/debug/assert.h>
+#include <sys/kmalloc/kmalloc.h>
+#include <sys/kprintf/kprintf.h>
+#include <sys/obj/object/object.h>
+#include <sys/obj/objectinterface/objectinterface_ip.h>
+#include <sys/obj/objectinterface/objectinterface_tcp.h>
+#include <sys/obj/objectinterface/objectinterface_tick.h>
+#include <sys/obj/objectmgr/objectmgr.h>
+#include <sys/string/mem.h>
+#include <tests/obj/test_tcp.h>
+#include <types.h>
+
+#define TEST_TCP_PORT 80
+#define TEST_TCP_BULK_BYTES (1024 * 1024)
+#define TEST_TCP_CHUNK 4096
+
+uint8_t test_tcp_pattern(uint32_t i) {
+    return (i * 7) % 251;
+}
+
+/*
+ * pump the pattern from client to server, reading as we go, and check what arrives
+ */
+void test_tcp_bulk(struct object* tcp, struct tcp_connection* client, struct tcp_connection* server, uint32_t bytes) {
+    struct objectinterface_tcp* tcp_api = (struct objectinterface_tcp*)tcp->api;
+    uint8_t* chunk = kmalloc(TEST_TCP_CHUNK);
+    uint32_t sent = 0;
+    uint32_t received = 0;
+    uint32_t rounds = 0;
+    while (received < bytes) {
+        if (sent < bytes) {
+            uint16_t size = ((bytes - sent) < TEST_TCP_CHUNK) ? (bytes - sent) : TEST_TCP_CHUNK;
+            for (uint16_t i = 0; i < size; i++) {
+                chunk[i] = test_tcp_pattern(sent + i);
+            }
+            sent += (*tcp_api->send)(tcp, client, chunk, size);
+        }
+        uint16_t got = (*tcp_api->receive)(tcp, server, chunk, TEST_TCP_CHUNK);
+        for (uint16_t i = 0; i < got; i++) {
+            ASSERT(chunk[i] == test_tcp_pattern(received + i));
+        }
+        received += got;
+        // nothing is lost, so it never has to wait for a timer
+        ASSERT(++rounds < (bytes / 64));
+    }
+    ASSERT(sent == bytes);
+    kfree(chunk);
+}
+
+void test_tcp() {
+    kprintf("Testing TCP\n");
+
+    // a whole stack on a loopback NIC. with no tick object, we drive the timers by hand
+    struct object* lo = loopback_attach();
+    struct object* eth = ethernet_attach(lo);
+    struct object* arp = arp_attach(eth);
+    struct object* ip = ip_attach(eth, arp);
+    struct object* tcp = tcp_attach(ip, 0);
+    ASSERT_NOT_NULL(tcp);
+
+    uint32_t address = IP_ADDRESS(127, 0, 0, 1);
+    struct objectinterface_ip* ip_api = (struct objectinterface_ip*)ip->api;
+    (*ip_api->configure)(ip, address, IP_ADDRESS(255, 0, 0, 0), 0);
+
+    struct objectinterface_tcp* tcp_api = (struct objectinterface_tcp*)tcp->api;
+    struct tcp_connection* listener = (*tcp_api->listen)(tcp, TEST_TCP_PORT);
+    ASSERT_NOT_NULL(listener);
+    ASSERT(0 == (*tcp_api->listen)(tcp, TEST_TCP_PORT));
+    ASSERT(0 == (*tcp_api->accept)(tcp, listener));
+
+    // nothing on this port, so we are reset
+    struct tcp_connection* refused = (*tcp_api->connect)(tcp, address, TEST_TCP_PORT + 1);
+    ASSERT_NOT_NULL(refused);
+    ASSERT(TCP_STATE_CLOSED == (*tcp_api->state)(tcp, refused));
+    (*tcp_api->close)(tcp, refused);
+
+    /*
+     * three way handshake
+     */
+    struct tcp_connection* client = (*tcp_api->connect)(tcp, address, TEST_TCP_PORT);
+    ASSERT_NOT_NULL(client);
+    ASSERT(TCP_STATE_ESTABLISHED == (*tcp_api->state)(tcp, client));
+    struct tcp_connection* server = (*tcp_api->accept)(tcp, listener);
+    ASSERT_NOT_NULL(server);
+    ASSERT(TCP_STATE_ESTABLISHED == (*tcp_api->state)(tcp, server));
+    ASSERT(0 == (*tcp_api->accept)(tcp, listener));
+
+    /*
+     * both ways
+     */
+    uint8_t buffer[64];
+    ASSERT(0 == (*tcp_api->receive)(tcp, server, buffer, sizeof(buffer)));
+    uint8_t message[] = {"hello, world"};
+    ASSERT(sizeof(message) == (*tcp_api->send)(tcp, client, message, sizeof(message)));
+    memzero(buffer, sizeof(buffer));
+    ASSERT(sizeof(message) == (*tcp_api->receive)(tcp, server, buffer, sizeof(buffer)));
+    ASSERT(0 == memcmp(buffer, message, sizeof(message)));
+    uint8_t reply[] = {"goodbye"};
+    ASSERT(sizeof(reply) == (*tcp_api->send)(tcp, server, reply, sizeof(reply)));
+    memzero(buffer, sizeof(buffer));
+    ASSERT(sizeof(reply) == (*tcp_api->receive)(tcp, client, buffer, sizeof(buffer)));
+    ASSERT(0 == memcmp(buffer, reply, sizeof(reply)));
+
+    /*
+     * bulk transfer, timed by the tick object if there is one
+     */
+    struct object* tick = objectmgr_find_object_by_name("tick0");
+    uint64_t start = 0;
+    if (0 != tick) {
+        start = (*((struct objectinterface_tick*)tick->api)->read)(tick);
+    }
+    test_tcp_bulk(tcp, client, server, TEST_TCP_BULK_BYTES);
+    if (0 != tick) {
+        uint64_t ticks = (*((struct objectinterface_tick*)tick->api)->read)(tick) - start;
+        kprintf("   TCP moved %llu bytes over loopback in %llu ticks\n", (uint64_t)TEST_TCP_BULK_BYTES, ticks);
+    }
+
+    /*
+     * the window is wide open after that. if the first of a window of segments is lost, the duplicate acks from
+     * the rest bring it back, without a timer
+     */
+    loopback_set_loss(lo, 1);
+    test_tcp_bulk(tcp, client, server, 8 * TCP_MSS);
+
+    /*
+     * the next segment is lost. the retransmit timer brings it back
+     */
+    loopback_set_loss(lo, 1);
+    ASSERT(sizeof(message) == (*tcp_api->send)(tcp, client, message, sizeof(message)));
+    ASSERT(0 == (*tcp_api->receive)(tcp, server, buffer, sizeof(buffer)));
+    uint16_t ticks = 0;
+    uint16_t got = 0;
+    while (0 == got) {
+        (*tcp_api->tick)(tcp);
+        got = (*tcp_api->receive)(tcp, server, buffer, sizeof(buffer));
+        ASSERT(++ticks < 64);
+    }
+    ASSERT(sizeof(message) == got);
+    ASSERT(0 == memcmp(buffer, message, sizeof(message)));
+
+    /*
+     * the client closes, then the server
+     */
+    (*tcp_api->close)(tcp, client);
+    ASSERT(TCP_STATE_CLOSE_WAIT == (*tcp_api->state)(tcp, server));
+    ASSERT(0 == (*tcp_api->receive)(tcp, server, buffer, sizeof(buffer)));
+    (*tcp_api->close)(tcp, server);
+    (*tcp_api->close)(tcp, listener);
+
+    // the client's end sits in TIME_WAIT for a while
+    for (uint16_t i = 0; i < 128; i++) {
+        (*tcp_api->tick)(tcp);
+    }
+
+    tcp_detach(tcp);
+    ip_detach(ip);
+    arp_detach(arp);
+    ethernet_detach(eth);
+    loopback_detach(lo);
+}
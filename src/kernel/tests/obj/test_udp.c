@@ -0,0 +1,165 @@
+//*****************************************************************
+// This file is part of CosmOS                                    *
+// Copyright (C) 2021 Tom Everett                                 *
+// Released under the stated terms in the file LICENSE            *
+// See the file "LICENSE" in the source distribution for details  *
+// ****************************************************************
+
+#include <obj/logical/ethernet/ethernet.h>
+#include <obj/logical/loopback/loopback.h>
+#include <obj/logical/tcpip/arp/arpdev.h>
+#include <obj/logical/tcpip/ip/ipdev.h>
+#include <obj/logical/tcpip/net_endian.h>
+#include <obj/logical/tcpip/udp/udpdev.h>
+#include <sys/debug/assert.h>
+#include <sys/kprintf/kprintf.h>
+#include <sys/netbuf/netbuf.h>
+#include <sys/obj/object/object.h>
+#include <sys/obj/objectinterface/objectinterface_ethernet.h>
+#include <sys/obj/objectinterface/objectinterface_ip.h>
+#include <sys/obj/objectinterface/objectinterface_nic.h>
+#include <sys/obj/objectinterface/objectinterface_udp.h>
+#include <sys/obj/objectmgr/objectmgr.h>
+#include <sys/string/mem.h>
+#include <tests/obj/test_udp.h>
+#include <types.h>
+
+#define TEST_UDP_PORT 7
+
+struct netbuf* test_udp_netbuf(uint8_t* data, uint16_t size) {
+    struct netbuf* nb = netbuf_new(NETBUF_HEADROOM);
+    memcpy(netbuf_put(nb, size), data, size);
+    return nb;
+}
+
+/*
+ * copy out up to size bytes of the next datagram on the socket, if there is one
+ */
+uint16_t test_udp_receive(struct object* udp, struct udp_socket* socket, uint32_t* source_ip, uint16_t* source_port,
+                          uint8_t* data, uint16_t size) {
+    struct objectinterface_udp* udp_api = (struct objectinterface_udp*)udp->api;
+    struct netbuf* nb = (*udp_api->receive)(udp, socket, source_ip, source_port);
+    if (0 == nb) {
+        return 0;
+    }
+    uint16_t ret = netbuf_copy_out(nb, 0, data, size);
+    netbuf_release(nb);
+    return ret;
+}
+
+/*
+ * a hand built UDP datagram to port, straight onto the wire
+ */
+void test_udp_inject(struct object* eth, uint32_t address, uint16_t port, bool good_checksum) {
+    struct objectinterface_ethernet* eth_api = (struct objectinterface_ethernet*)eth->api;
+    struct netbuf* nb = netbuf_new(NETBUF_HEADROOM);
+    uint8_t* packet = netbuf_put(nb, IP_HEADER_LEN + UDP_HEADER_LEN + 4);
+    memzero(packet, nb->len);
+    ip_header_init((struct ip_header*)packet, nb->len, IP_PROTOCOL_UDP, address, address);
+    if (!good_checksum) {
+        ((struct ip_header*)packet)->csum ^= 0x1234;
+    }
+    struct udp_header* udp = (struct udp_header*)(packet + IP_HEADER_LEN);
+    udp->source_port = switch_endian16(1000);
+    udp->dest_port = switch_endian16(port);
+    udp->len = switch_endian16(UDP_HEADER_LEN + 4);
+    udp->csum = 0;
+
+    uint8_t hw[ETHERNET_HW_LEN];
+    (*eth_api->hw_address)(eth, hw);
+    (*eth_api->write)(eth, hw, ETHERNET_TYPE_IP, nb);
+}
+
+void test_udp() {
+    kprintf("Testing UDP\n");
+
+    // a whole stack on a loopback NIC
+    struct object* lo = loopback_attach();
+    struct object* eth = ethernet_attach(lo);
+    struct object* arp = arp_attach(eth);
+    struct object* ip = ip_attach(eth, arp);
+    struct object* udp = udp_attach(ip);
+    ASSERT_NOT_NULL(udp);
+
+    uint32_t address = IP_ADDRESS(127, 0, 0, 1);
+    struct objectinterface_ip* ip_api = (struct objectinterface_ip*)ip->api;
+    (*ip_api->configure)(ip, address, IP_ADDRESS(255, 0, 0, 0), 0);
+    ASSERT(address == (*ip_api->address)(ip));
+
+    struct objectinterface_udp* udp_api = (struct objectinterface_udp*)udp->api;
+    struct udp_socket* server = (*udp_api->open)(udp, TEST_UDP_PORT);
+    ASSERT_NOT_NULL(server);
+    // the port is taken now
+    ASSERT(0 == (*udp_api->open)(udp, TEST_UDP_PORT));
+    struct udp_socket* client = (*udp_api->open)(udp, 0);
+    ASSERT_NOT_NULL(client);
+    uint16_t client_port = (*udp_api->port)(udp, client);
+    ASSERT(client_port >= UDP_EPHEMERAL_PORT_START);
+
+    // nothing waiting
+    uint8_t buffer[64];
+    ASSERT(0 == test_udp_receive(udp, server, 0, 0, buffer, sizeof(buffer)));
+
+    // client to server; the first send has to wait for ARP
+    uint8_t message[] = {"hello, world"};
+    ASSERT(sizeof(message) ==
+           (*udp_api->send)(udp, client, address, TEST_UDP_PORT, test_udp_netbuf(message, sizeof(message))));
+    uint32_t source_ip = 0;
+    uint16_t source_port = 0;
+    memzero(buffer, sizeof(buffer));
+    ASSERT(sizeof(message) == test_udp_receive(udp, server, &source_ip, &source_port, buffer, sizeof(buffer)));
+    ASSERT(0 == memcmp(buffer, message, sizeof(message)));
+    ASSERT(source_ip == address);
+    ASSERT(source_port == client_port);
+
+    // and back
+    uint8_t reply[] = {"goodbye"};
+    ASSERT(sizeof(reply) ==
+           (*udp_api->send)(udp, server, source_ip, source_port, test_udp_netbuf(reply, sizeof(reply))));
+    memzero(buffer, sizeof(buffer));
+    ASSERT(sizeof(reply) == test_udp_receive(udp, client, 0, 0, buffer, sizeof(buffer)));
+    ASSERT(0 == memcmp(buffer, reply, sizeof(reply)));
+
+    // a datagram sent as a chain of odd sized segments arrives whole, with a good checksum
+    struct netbuf* chain = test_udp_netbuf(message, 5);
+    netbuf_append(chain, test_udp_netbuf(message + 5, sizeof(message) - 5));
+    ASSERT(sizeof(message) == (*udp_api->send)(udp, client, address, TEST_UDP_PORT, chain));
+    memzero(buffer, sizeof(buffer));
+    ASSERT(sizeof(message) == test_udp_receive(udp, server, 0, 0, buffer, sizeof(buffer)));
+    ASSERT(0 == memcmp(buffer, message, sizeof(message)));
+    ASSERT(0 == test_udp_receive(udp, server, 0, 0, buffer, sizeof(buffer)));
+
+    // a NIC that says it does checksums gets the datagram with the checksum unfinished, and it is trusted
+    loopback_set_offload(lo, NIC_OFFLOAD_TX_CSUM | NIC_OFFLOAD_RX_CSUM);
+    ASSERT(sizeof(message) ==
+           (*udp_api->send)(udp, client, address, TEST_UDP_PORT, test_udp_netbuf(message, sizeof(message))));
+    struct netbuf* nb = (*udp_api->receive)(udp, server, 0, 0);
+    ASSERT_NOT_NULL(nb);
+    ASSERT(NETBUF_CSUM_PARTIAL == nb->csum);
+    ASSERT(sizeof(message) == netbuf_copy_out(nb, 0, buffer, sizeof(buffer)));
+    ASSERT(0 == memcmp(buffer, message, sizeof(message)));
+    netbuf_release(nb);
+    loopback_set_offload(lo, 0);
+
+    // nothing is listening on the server's port once it's closed
+    (*udp_api->close)(udp, server);
+    (*udp_api->send)(udp, client, address, TEST_UDP_PORT, test_udp_netbuf(message, sizeof(message)));
+    server = (*udp_api->open)(udp, TEST_UDP_PORT);
+    ASSERT(0 == test_udp_receive(udp, server, 0, 0, buffer, sizeof(buffer)));
+
+    // IP drops a datagram with a bad header checksum, and accepts a good one
+    test_udp_inject(eth, address, TEST_UDP_PORT, false);
+    ASSERT(0 == test_udp_receive(udp, server, 0, 0, buffer, sizeof(buffer)));
+    test_udp_inject(eth, address, TEST_UDP_PORT, true);
+    ASSERT(4 == test_udp_receive(udp, server, &source_ip, &source_port, buffer, sizeof(buffer)));
+    ASSERT(1000 == source_port);
+
+    (*udp_api->close)(udp, server);
+    (*udp_api->close)(udp, client);
+
+    udp_detach(udp);
+    ip_detach(ip);
+    arp_detach(arp);
+    ethernet_detach(eth);
+    loopback_detach(lo);
+}
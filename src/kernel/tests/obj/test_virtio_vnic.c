@@ -7,12 +7,13 @@
 
 #include <obj/logical/virtio/virtqueue.h>
 #include <obj/logical/virtio/vnic/vnic.h>
-#include <sys/kmalloc/kmalloc.h>
 #include <sys/kprintf/kprintf.h>
+#include <sys/netbuf/netbuf.h>
 #include <sys/obj/object/object.h>
 #include <sys/obj/objectinterface/objectinterface_nic.h>
 #include <sys/obj/objectmgr/objectmgr.h>
 #include <sys/panic/panic.h>
+#include <sys/string/mem.h>
 #include <sys/string/string.h>
 #include <tests/obj/test_virtio_vnic.h>
 #include <types.h>
@@ -38,9 +39,9 @@ void test_virtio_vnic() {
         virtq_print(txq, object_data->send_queue);
 
         uint8_t s[] = "this is a test of the emergency broadcasting system\0";
-        uint8_t* buffer = (uint8_t*)kmalloc(strlen(s));
-        strncpy(buffer, s, strlen(s) + 1);
-        nic_api->write(obj, buffer, strlen(s));
+        struct netbuf* nb = netbuf_new(NETBUF_HEADROOM);
+        memcpy(netbuf_put(nb, strlen(s)), s, strlen(s));
+        nic_api->write(obj, nb);
     }
     virtq_print(rxq, object_data->receive_queue);
 }
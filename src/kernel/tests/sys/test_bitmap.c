@@ -10,6 +10,49 @@
 #include <sys/kprintf/kprintf.h>
 #include <tests/sys/test_bitmap.h>
 
+void test_bitmap_search() {
+    // a bit over three words
+    struct bitmap* bm = bitmap_new(200);
+
+    ASSERT(bitmap_find_first_zero(bm) == 0);
+    ASSERT(bitmap_find_next_set(bm, 0) == BITMAP_NOT_FOUND);
+    ASSERT(bitmap_count_set(bm) == 0);
+
+    // a range spanning a word boundary
+    bitmap_set_range(bm, 0, 70);
+    ASSERT(bitmap_get(bm, 0) == 1);
+    ASSERT(bitmap_get(bm, 63) == 1);
+    ASSERT(bitmap_get(bm, 69) == 1);
+    ASSERT(bitmap_get(bm, 70) == 0);
+    ASSERT(bitmap_count_set(bm) == 70);
+    ASSERT(bitmap_find_first_zero(bm) == 70);
+
+    bitmap_set(bm, 100, 1);
+    ASSERT(bitmap_find_next_set(bm, 70) == 100);
+    ASSERT(bitmap_find_next_zero(bm, 100) == 101);
+
+    // the hole at 70-99 is too small for 40, so the run starts after 100
+    ASSERT(bitmap_find_zero_run(bm, 30) == 70);
+    ASSERT(bitmap_find_zero_run(bm, 40) == 101);
+    ASSERT(bitmap_find_zero_run(bm, 99) == 101);
+    ASSERT(bitmap_find_zero_run(bm, 100) == BITMAP_NOT_FOUND);
+    ASSERT(bitmap_find_next_zero_run(bm, 80, 10) == 80);
+    ASSERT(bitmap_find_next_zero_run(bm, 95, 10) == 101);
+
+    bitmap_clear_range(bm, 10, 60);
+    ASSERT(bitmap_get(bm, 9) == 1);
+    ASSERT(bitmap_get(bm, 10) == 0);
+    ASSERT(bitmap_count_set(bm) == 11);
+    ASSERT(bitmap_find_zero_run(bm, 90) == 10);
+
+    // bits past the end never count as clear
+    bitmap_set_range(bm, 0, 200);
+    ASSERT(bitmap_find_first_zero(bm) == BITMAP_NOT_FOUND);
+    ASSERT(bitmap_count_set(bm) == 200);
+
+    bitmap_delete(bm);
+}
+
 void test_bitmap() {
     kprintf("Testing bitmap\n");
 
@@ -24,4 +67,6 @@ void test_bitmap() {
     ASSERT(bitmap_get(bm, 0) == 0);
 
     bitmap_delete(bm);
+
+    test_bitmap_search();
 }
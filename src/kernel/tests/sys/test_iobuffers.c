@@ -11,6 +11,48 @@
 #include <tests/sys/test_iobuffers.h>
 #include <types.h>
 
+void test_iobuffers_classes() {
+    struct iobuffers_stats before;
+    struct iobuffers_stats after;
+
+    iobuffers_get_stats(&before);
+
+    // a packet sized buffer comes from the packet class, aligned on the class size
+    void* p1 = iobuffers_request_buffer(1526);
+    ASSERT_NOT_NULL(p1);
+    ASSERT(0 == (iobuffers_phys_address(p1) % 2048));
+    iobuffers_get_stats(&after);
+    ASSERT(after.classes[IOBUFFERS_CLASS_PACKET].in_use == before.classes[IOBUFFERS_CLASS_PACKET].in_use + 1);
+
+    // releasing it, then asking again, recycles the same buffer
+    iobuffers_release_buffer(p1);
+    void* p2 = iobuffers_request_buffer(2000);
+    ASSERT(p2 == p1);
+    iobuffers_get_stats(&after);
+    ASSERT(after.classes[IOBUFFERS_CLASS_PACKET].recycled > before.classes[IOBUFFERS_CLASS_PACKET].recycled);
+    iobuffers_release_buffer(p2);
+
+    // sector and page classes
+    void* s = iobuffers_request_buffer(512);
+    ASSERT(0 == (iobuffers_phys_address(s) % 512));
+    void* pg = iobuffers_request_buffer(4096);
+    ASSERT(0 == (iobuffers_phys_address(pg) % 4096));
+    iobuffers_release_buffer(s);
+    iobuffers_release_buffer(pg);
+
+    // physical and virtual addresses round trip, and are below 64MB
+    uint64_t phys = iobuffers_phys_address(s);
+    ASSERT(phys < 0x4000000);
+    ASSERT(iobuffers_virt_address(phys) == s);
+
+    iobuffers_get_stats(&after);
+    ASSERT(after.requests == before.requests + 4);
+    ASSERT(after.releases == before.releases + 4);
+    for (uint8_t c = 0; c < IOBUFFERS_CLASS_COUNT; c++) {
+        ASSERT(after.classes[c].in_use == before.classes[c].in_use);
+    }
+}
+
 void test_iobuffers() {
     kprintf("Testing iobuffers\n");
 
@@ -24,4 +66,13 @@ void test_iobuffers() {
     ASSERT(iobuffers_used_pages() > used);
     iobuffers_release_buffer(m);
     ASSERT(iobuffers_used_pages() == used);
+
+    // allocate 40k, which needs a run of pages
+    m = iobuffers_request_buffer(1024 * 40);
+    ASSERT_NOT_NULL(m);
+    ASSERT(iobuffers_used_pages() == used + 3);
+    iobuffers_release_buffer(m);
+    ASSERT(iobuffers_used_pages() == used);
+
+    test_iobuffers_classes();
 }
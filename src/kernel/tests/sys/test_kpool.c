@@ -0,0 +1,68 @@
+//*****************************************************************
+// This file is part of CosmOS                                    *
+// Copyright (C) 2021 Tom Everett                                 *
+// Released under the stated terms in the file LICENSE            *
+// See the file "LICENSE" in the source distribution for details  *
+// ****************************************************************
+
+#include <sys/debug/assert.h>
+#include <sys/kmalloc/kpool.h>
+#include <sys/kprintf/kprintf.h>
+#include <tests/sys/test_kpool.h>
+
+#define TEST_KPOOL_COUNT 300
+
+struct test_kpool_obj {
+    uint64_t a;
+    uint64_t b;
+    uint8_t c;
+};
+
+void test_kpool_ctor(void* obj) {
+    struct test_kpool_obj* o = (struct test_kpool_obj*)obj;
+    o->a = 1;
+    o->b = 2;
+    o->c = 3;
+}
+
+kpool test_kpool_pool = KPOOL_INIT("test", struct test_kpool_obj, &test_kpool_ctor);
+
+void test_kpool() {
+    kprintf("Testing kpool\n");
+
+    struct test_kpool_obj* objs[TEST_KPOOL_COUNT];
+    kpool_stats stats;
+
+    // more than fit in one slab
+    for (uint16_t i = 0; i < TEST_KPOOL_COUNT; i++) {
+        objs[i] = kpool_alloc(&test_kpool_pool);
+        ASSERT_NOT_NULL(objs[i]);
+        ASSERT(objs[i]->a == 1);
+        ASSERT(objs[i]->b == 2);
+        ASSERT(objs[i]->c == 3);
+        objs[i]->a = i;
+    }
+    for (uint16_t i = 0; i < TEST_KPOOL_COUNT; i++) {
+        ASSERT(objs[i]->a == i);
+    }
+
+    kpool_get_stats(&test_kpool_pool, &stats);
+    ASSERT(stats.allocs == TEST_KPOOL_COUNT);
+    ASSERT(stats.in_use == TEST_KPOOL_COUNT);
+    ASSERT(stats.peak == TEST_KPOOL_COUNT);
+    ASSERT(stats.slabs > 1);
+
+    // the last one freed is the next one handed out
+    struct test_kpool_obj* last = objs[TEST_KPOOL_COUNT - 1];
+    kpool_free(&test_kpool_pool, last);
+    ASSERT(kpool_alloc(&test_kpool_pool) == last);
+
+    for (uint16_t i = 0; i < TEST_KPOOL_COUNT; i++) {
+        kpool_free(&test_kpool_pool, objs[i]);
+    }
+
+    kpool_get_stats(&test_kpool_pool, &stats);
+    ASSERT(stats.in_use == 0);
+    ASSERT(stats.frees == TEST_KPOOL_COUNT + 1);
+    ASSERT(stats.peak == TEST_KPOOL_COUNT);
+}
@@ -0,0 +1,40 @@
+//*****************************************************************
+// This file is part of CosmOS                                    *
+// Copyright (C) 2020-2021 Tom Everett                            *
+// Released under the stated terms in the file LICENSE            *
+// See the file "LICENSE" in the source distribution for details  *
+// ****************************************************************
+
+#include <sys/compress/lz4.h>
+#include <sys/debug/assert.h>
+#include <sys/kprintf/kprintf.h>
+#include <sys/string/mem.h>
+#include <tests/sys/test_lz4.h>
+#include <types.h>
+
+void test_lz4() {
+    kprintf("Testing lz4\n");
+    uint8_t out[300];
+
+    // just literals
+    const uint8_t literals[] = {0x50, 'h', 'e', 'l', 'l', 'o'};
+    ASSERT(5 == lz4_decompress(literals, sizeof(literals), out, sizeof(out)));
+    ASSERT(0 == memcmp(out, "hello", 5));
+
+    // "a", then a match 1 back for 4+15+255+6 bytes, overlapping itself, then "bcdef"
+    const uint8_t run[] = {0x1F, 'a', 0x01, 0x00, 0xFF, 0x06, 0x50, 'b', 'c', 'd', 'e', 'f'};
+    ASSERT(286 == lz4_decompress(run, sizeof(run), out, sizeof(out)));
+    for (uint32_t i = 0; i < 281; i++) {
+        ASSERT('a' == out[i]);
+    }
+    ASSERT(0 == memcmp(&(out[281]), "bcdef", 5));
+
+    // too big for out
+    ASSERT(0 == lz4_decompress(run, sizeof(run), out, 100));
+    // a match from before the start
+    const uint8_t back[] = {0x10, 'a', 0x02, 0x00, 0x50, 'b', 'c', 'd', 'e', 'f'};
+    ASSERT(0 == lz4_decompress(back, sizeof(back), out, sizeof(out)));
+    // cut short
+    ASSERT(0 == lz4_decompress(run, 3, out, sizeof(out)));
+    ASSERT(0 == lz4_decompress(literals, 4, out, sizeof(out)));
+}
@@ -0,0 +1,93 @@
+//*****************************************************************
+// This file is part of CosmOS                                    *
+// Copyright (C) 2021 Tom Everett                                 *
+// Released under the stated terms in the file LICENSE            *
+// See the file "LICENSE" in the source distribution for details  *
+// ****************************************************************
+
+#include <sys/debug/assert.h>
+#include <sys/iobuffers/iobuffers.h>
+#include <sys/kprintf/kprintf.h>
+#include <sys/netbuf/netbuf.h>
+#include <sys/string/mem.h>
+#include <tests/sys/test_netbuf.h>
+#include <types.h>
+
+void test_netbuf() {
+    kprintf("Testing netbuf\n");
+
+    // every buffer goes back to iobuffers
+    struct iobuffers_stats stats;
+    iobuffers_get_stats(&stats);
+    uint32_t in_use = stats.classes[IOBUFFERS_CLASS_PACKET].in_use;
+
+    /*
+     * a payload, then headers pushed on in front of it, then pulled off again
+     */
+    struct netbuf* nb = netbuf_new(NETBUF_HEADROOM);
+    ASSERT_NOT_NULL(nb);
+    ASSERT(0 == nb->len);
+    ASSERT(NETBUF_HEADROOM == netbuf_headroom(nb));
+    ASSERT((NETBUF_SIZE - NETBUF_HEADROOM) == netbuf_tailroom(nb));
+
+    uint8_t payload[] = {"payload"};
+    memcpy(netbuf_put(nb, sizeof(payload)), payload, sizeof(payload));
+    uint8_t* data = nb->data;
+    uint8_t* header = netbuf_push(nb, 4);
+    ASSERT(header == (data - 4));
+    memset(header, 0xAB, 4);
+    ASSERT((sizeof(payload) + 4) == nb->len);
+    ASSERT((NETBUF_HEADROOM - 4) == netbuf_headroom(nb));
+    ASSERT(data == netbuf_pull(nb, 4));
+    ASSERT(0 == memcmp(nb->data, payload, sizeof(payload)));
+
+    // trailing padding is trimmed off
+    netbuf_put(nb, 10);
+    netbuf_trim(nb, sizeof(payload));
+    ASSERT(sizeof(payload) == netbuf_length(nb));
+
+    /*
+     * a chain of segments, read as one packet
+     */
+    uint8_t more[] = {"and more"};
+    struct netbuf* tail = netbuf_new(0);
+    memcpy(netbuf_put(tail, sizeof(more)), more, sizeof(more));
+    netbuf_append(nb, tail);
+    ASSERT((sizeof(payload) + sizeof(more)) == netbuf_length(nb));
+
+    uint8_t buffer[32];
+    memzero(buffer, sizeof(buffer));
+    ASSERT((sizeof(payload) + sizeof(more)) == netbuf_copy_out(nb, 0, buffer, sizeof(buffer)));
+    ASSERT(0 == memcmp(buffer, payload, sizeof(payload)));
+    ASSERT(0 == memcmp(buffer + sizeof(payload), more, sizeof(more)));
+    // across the boundary
+    ASSERT(4 == netbuf_copy_out(nb, sizeof(payload) - 2, buffer, 4));
+    ASSERT(0 == memcmp(buffer, payload + sizeof(payload) - 2, 2));
+    ASSERT(0 == memcmp(buffer + 2, more, 2));
+
+    // gathered into one segment
+    nb = netbuf_linearize(nb);
+    ASSERT(0 == nb->chain);
+    ASSERT((sizeof(payload) + sizeof(more)) == nb->len);
+    ASSERT(0 == memcmp(nb->data + sizeof(payload), more, sizeof(more)));
+
+    // trimming a chain frees what is past the end
+    tail = netbuf_new(0);
+    netbuf_put(tail, 100);
+    netbuf_append(nb, tail);
+    netbuf_trim(nb, 3);
+    ASSERT(0 == nb->chain);
+    ASSERT(3 == netbuf_length(nb));
+
+    /*
+     * the last reference frees it
+     */
+    ASSERT(nb == netbuf_retain(nb));
+    ASSERT(2 == nb->refcount);
+    netbuf_release(nb);
+    ASSERT(1 == nb->refcount);
+    netbuf_release(nb);
+
+    iobuffers_get_stats(&stats);
+    ASSERT(in_use == stats.classes[IOBUFFERS_CLASS_PACKET].in_use);
+}
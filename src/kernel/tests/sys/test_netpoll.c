@@ -0,0 +1,110 @@
+//*****************************************************************
+// This file is part of CosmOS                                    *
+// Copyright (C) 2021 Tom Everett                                 *
+// Released under the stated terms in the file LICENSE            *
+// See the file "LICENSE" in the source distribution for details  *
+// ****************************************************************
+
+#include <sys/debug/assert.h>
+#include <sys/kprintf/kprintf.h>
+#include <sys/netpoll/netpoll.h>
+#include <sys/obj/object/object.h>
+#include <sys/obj/objectinterface/objectinterface_nic.h>
+#include <sys/string/mem.h>
+#include <tests/sys/test_netpoll.h>
+#include <types.h>
+
+/*
+ * a pretend NIC: a count of frames waiting, and whether its interrupt is on
+ */
+struct test_netpoll_nic {
+    uint32_t waiting;
+    bool enabled;
+    uint32_t late;  // frames that turn up as the interrupt goes back on
+};
+
+uint16_t test_netpoll_poll(struct object* obj, uint16_t budget) {
+    struct test_netpoll_nic* nic = (struct test_netpoll_nic*)obj->object_data;
+    uint16_t ret = (nic->waiting < budget) ? nic->waiting : budget;
+    nic->waiting -= ret;
+    return ret;
+}
+
+bool test_netpoll_interrupts(struct object* obj, bool enable) {
+    struct test_netpoll_nic* nic = (struct test_netpoll_nic*)obj->object_data;
+    nic->enabled = enable;
+    if (enable && (nic->late > 0)) {
+        nic->waiting += nic->late;
+        nic->late = 0;
+    }
+    return enable && (nic->waiting > 0);
+}
+
+void test_netpoll() {
+    kprintf("Testing netpoll\n");
+
+    struct objectinterface_nic api;
+    memzero((uint8_t*)&api, sizeof(struct objectinterface_nic));
+    api.poll = &test_netpoll_poll;
+    api.interrupts = &test_netpoll_interrupts;
+    struct test_netpoll_nic nic = {.waiting = 0, .enabled = true, .late = 0};
+    struct object obj;
+    memzero((uint8_t*)&obj, sizeof(struct object));
+    obj.api = &api;
+    obj.object_data = &nic;
+
+    struct netpoll np;
+    netpoll_register(&np, &obj);
+
+    // nothing scheduled, nothing polled
+    netpoll_run();
+    struct nic_stats stats;
+    netpoll_stats(&np, &stats);
+    ASSERT(0 == stats.polls);
+
+    /*
+     * a burst: one interrupt, then polls of a budget each until it is gone, and the interrupt back on
+     */
+    uint32_t burst = (NETPOLL_BUDGET * 2) + 5;
+    nic.waiting = burst;
+    netpoll_interrupt(&np);
+    ASSERT(!nic.enabled);
+    ASSERT(np.scheduled);
+    // more interrupts while scheduled only count
+    netpoll_interrupt(&np);
+    netpoll_run();
+    ASSERT(0 == nic.waiting);
+    ASSERT(nic.enabled);
+    ASSERT(!np.scheduled);
+    netpoll_stats(&np, &stats);
+    ASSERT(2 == stats.interrupts);
+    ASSERT(3 == stats.polls);
+    ASSERT(burst == stats.packets);
+    ASSERT(2 == stats.exhausted);
+
+    /*
+     * more than a run's worth stays scheduled, with its interrupt off, for the next run
+     */
+    nic.waiting = (NETPOLL_BUDGET * NETPOLL_PASSES) + 1;
+    netpoll_interrupt(&np);
+    netpoll_run();
+    ASSERT(1 == nic.waiting);
+    ASSERT(np.scheduled);
+    ASSERT(!nic.enabled);
+    netpoll_run();
+    ASSERT(0 == nic.waiting);
+    ASSERT(nic.enabled);
+
+    /*
+     * frames that arrive as the interrupt goes back on, and won't raise one, are polled too
+     */
+    nic.waiting = 1;
+    nic.late = 3;
+    netpoll_interrupt(&np);
+    netpoll_run();
+    ASSERT(0 == nic.waiting);
+    ASSERT(nic.enabled);
+    ASSERT(!np.scheduled);
+
+    netpoll_unregister(&np);
+}
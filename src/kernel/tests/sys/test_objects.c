@@ -5,14 +5,41 @@
  * See the file "LICENSE" in the source distribution for details *
  *****************************************************************/
 
+#include <sys/debug/assert.h>
 #include <sys/kprintf/kprintf.h>
+#include <sys/objects/objects.h>
+#include <tests/sys/test_objects.h>
 
 void test_objects() {
-    /*device_t* disk;
-    device_t* initrd;
-    uint8_t idx;*/
+    object_handle_t a, b, c;
+    uint64_t data_a, data_b, data_c;
 
     kprintf("Testing objects\n");
 
+    a = object_create(OBJECT_KERNEL_WORK, &data_a);
+    b = object_create(OBJECT_KERNEL_WORK, &data_b);
+    ASSERT(a != 0);
+    ASSERT(b != a);
+    ASSERT(object_table_get(a)->handle == a);
+    ASSERT(OBJECT_DATA(a, uint64_t) == &data_a);
+    ASSERT(OBJECT_DATA(b, uint64_t) == &data_b);
+
+    // never-issued handles resolve to nothing
+    ASSERT(object_table_get(0) == 0);
+    ASSERT(object_table_get(b + 1000000) == 0);
+
+    // a deleted object's slot is reused, but the old handle stays dead
+    object_delete(a);
+    ASSERT(object_table_get(a) == 0);
+    c = object_create(OBJECT_KERNEL_WORK, &data_c);
+    ASSERT(c != a);
+    ASSERT((c & OBJECT_HANDLE_INDEX_MASK) == (a & OBJECT_HANDLE_INDEX_MASK));
+    ASSERT(object_table_get(a) == 0);
+    ASSERT(OBJECT_DATA(c, uint64_t) == &data_c);
+    ASSERT(OBJECT_DATA(b, uint64_t) == &data_b);
+
+    object_delete(b);
+    object_delete(c);
+
     return;
-}
\ No newline at end of file
+}
@@ -0,0 +1,65 @@
+//*****************************************************************
+// This file is part of CosmOS                                    *
+// Copyright (C) 2021 Tom Everett                                 *
+// Released under the stated terms in the file LICENSE            *
+// See the file "LICENSE" in the source distribution for details  *
+// ****************************************************************
+
+#include <obj/logical/fs/swap/swap.h>
+#include <sys/asm/misc.h>
+#include <sys/debug/assert.h>
+#include <sys/kprintf/kprintf.h>
+#include <sys/obj/object/object.h>
+#include <sys/x86-64/mm/mm.h>
+#include <sys/x86-64/mm/pagetables.h>
+#include <tests/fs/ramdisk_helper.h>
+#include <tests/sys/test_reclaim.h>
+#include <types.h>
+
+// nothing else lives down here in the kernel address space
+#define TEST_RECLAIM_VADDR 0x0000600000000000
+
+void test_reclaim() {
+    kprintf("Testing reclaim\n");
+
+    pttentry cr3 = asm_cr3_read();
+    uint64_t* vaddr = (uint64_t*)TEST_RECLAIM_VADDR;
+    struct object* saved_swap = reclaim_swap;
+
+    // swap to a ram disk for the duration of the test
+    struct object* rd = ramdisk_helper_create_rd();
+    ASSERT_NOT_NULL(rd);
+    struct object* swap_device = swap_attach(rd);
+    ASSERT_NOT_NULL(swap_device);
+    ASSERT(reclaim_set_swap(swap_device));
+
+    // map a page and fill it
+    uint64_t page = slab_allocate(1, PDT_INUSE);
+    ASSERT_NOT_NULL(page);
+    map_page_at(page, vaddr, cr3, false);
+    for (uint16_t i = 0; i < (PAGE_SIZE / sizeof(uint64_t)); i++) {
+        vaddr[i] = 0x1234567800000000 + i;
+    }
+    reclaim_track_page(page, cr3, vaddr);
+
+    // the first pass only clears the accessed bit, so it can take a second to push it out
+    for (uint8_t tries = 0; (tries < 3) && is_page_allocated(vaddr); tries++) {
+        reclaim_pages(1);
+    }
+    ASSERT(!is_page_allocated(vaddr));
+
+    // touching it faults it back in
+    for (uint16_t i = 0; i < (PAGE_SIZE / sizeof(uint64_t)); i++) {
+        ASSERT(vaddr[i] == (0x1234567800000000 + i));
+    }
+    ASSERT(is_page_allocated(vaddr));
+
+    // clean up
+    page = (uint64_t)vaddr_to_physical(vaddr, cr3) / PAGE_SIZE;
+    unmap_page_at(vaddr, cr3);
+    slab_free(page, 1);
+
+    ASSERT(reclaim_set_swap(saved_swap));
+    swap_detach(swap_device);
+    ramdisk_helper_remove_rd(rd);
+}
@@ -0,0 +1,187 @@
+//*****************************************************************
+// This file is part of CosmOS                                    *
+// Copyright (C) 2021 Tom Everett                                 *
+// Released under the stated terms in the file LICENSE            *
+// See the file "LICENSE" in the source distribution for details  *
+// ****************************************************************
+
+#include <obj/logical/ethernet/ethernet.h>
+#include <obj/logical/loopback/loopback.h>
+#include <obj/logical/tcpip/arp/arpdev.h>
+#include <obj/logical/tcpip/ip/ipdev.h>
+#include <obj/logical/tcpip/tcp/tcpdev.h>
+#include <obj/logical/tcpip/udp/udpdev.h>
+#include <sys/debug/assert.h>
+#include <sys/kmalloc/kmalloc.h>
+#include <sys/kprintf/kprintf.h>
+#include <sys/obj/object/object.h>
+#include <sys/obj/objectinterface/objectinterface_ip.h>
+#include <sys/obj/objectinterface/objectinterface_tcp.h>
+#include <sys/sched/sched.h>
+#include <sys/socket/socket.h>
+#include <sys/string/mem.h>
+#include <tests/sys/test_socket.h>
+#include <types.h>
+
+#define TEST_SOCKET_PORT 7
+#define TEST_SOCKET_MESSAGES 4
+
+struct socket_message* test_socket_messages() {
+    uint64_t size = TEST_SOCKET_MESSAGES * sizeof(struct socket_message);
+    struct socket_message* ret = (struct socket_message*)kmalloc(size);
+    memzero((uint8_t*)ret, size);
+    return ret;
+}
+
+void test_socket_message(struct socket_message* m, uint8_t* data, uint16_t size) {
+    memcpy(m->data, data, size);
+    m->size = size;
+    m->ip = 0;
+    m->port = 0;
+}
+
+uint16_t test_socket_poll(uint64_t socket, uint16_t events) {
+    struct socket_poll p;
+    p.socket = socket;
+    p.events = events;
+    p.revents = 0;
+    socket_poll(&p, 1);
+    return p.revents;
+}
+
+void test_socket_dgram(struct object* udp, uint32_t address) {
+    struct socket_message* server_messages = test_socket_messages();
+    struct socket_message* client_messages = test_socket_messages();
+
+    uint64_t server = socket_open(udp);
+    ASSERT(0 != server);
+    ASSERT(socket_register(server, server_messages, TEST_SOCKET_MESSAGES));
+    ASSERT(socket_bind(server, TEST_SOCKET_PORT));
+    ASSERT(!socket_bind(server, TEST_SOCKET_PORT));
+    uint64_t client = socket_open(udp);
+    ASSERT(socket_register(client, client_messages, TEST_SOCKET_MESSAGES));
+    ASSERT(socket_connect(client, address, TEST_SOCKET_PORT));
+
+    // nothing waiting, but always room to send
+    ASSERT(SOCKET_POLL_OUT == test_socket_poll(server, SOCKET_POLL_IN | SOCKET_POLL_OUT));
+    ASSERT(0 == socket_receive(server, TEST_SOCKET_MESSAGES));
+
+    // a batch of three, to connect's address, in one call
+    uint8_t message[] = {"hello, world"};
+    for (uint16_t i = 0; i < 3; i++) {
+        test_socket_message(&(client_messages[i]), message, sizeof(message) - i);
+    }
+    ASSERT(3 == socket_send(client, 3));
+    ASSERT(SOCKET_POLL_IN == test_socket_poll(server, SOCKET_POLL_IN));
+    ASSERT(3 == socket_receive(server, TEST_SOCKET_MESSAGES));
+    for (uint16_t i = 0; i < 3; i++) {
+        ASSERT(server_messages[i].size == (sizeof(message) - i));
+        ASSERT(0 == memcmp(server_messages[i].data, message, sizeof(message) - i));
+        ASSERT(server_messages[i].ip == address);
+    }
+    ASSERT(0 == test_socket_poll(server, SOCKET_POLL_IN));
+
+    // and back to where the first came from
+    uint8_t reply[] = {"goodbye"};
+    uint16_t client_port = server_messages[0].port;
+    test_socket_message(&(server_messages[0]), reply, sizeof(reply));
+    server_messages[0].ip = address;
+    server_messages[0].port = client_port;
+    ASSERT(1 == socket_send(server, 1));
+    ASSERT(1 == socket_receive(client, TEST_SOCKET_MESSAGES));
+    ASSERT(sizeof(reply) == client_messages[0].size);
+    ASSERT(0 == memcmp(client_messages[0].data, reply, sizeof(reply)));
+    ASSERT(TEST_SOCKET_PORT == client_messages[0].port);
+
+    // no more than was registered
+    ASSERT(0 == socket_send(client, TEST_SOCKET_MESSAGES + 1));
+
+    socket_close(server);
+    socket_close(client);
+    ASSERT(SOCKET_POLL_NVAL == test_socket_poll(server, SOCKET_POLL_IN));
+    ASSERT(0 == socket_send(client, 1));
+    kfree(server_messages);
+    kfree(client_messages);
+}
+
+void test_socket_stream(struct object* tcp, uint32_t address) {
+    struct socket_message* server_messages = test_socket_messages();
+    struct socket_message* client_messages = test_socket_messages();
+
+    uint64_t listener = socket_open(tcp);
+    ASSERT(socket_bind(listener, TEST_SOCKET_PORT));
+    ASSERT(0 == socket_accept(listener));
+    ASSERT(0 == test_socket_poll(listener, SOCKET_POLL_IN));
+
+    // over loopback the handshake is done before connect returns
+    uint64_t client = socket_open(tcp);
+    ASSERT(socket_register(client, client_messages, TEST_SOCKET_MESSAGES));
+    ASSERT(socket_connect(client, address, TEST_SOCKET_PORT));
+    ASSERT(SOCKET_POLL_IN == test_socket_poll(listener, SOCKET_POLL_IN));
+    uint64_t server = socket_accept(listener);
+    ASSERT(0 != server);
+    ASSERT(socket_register(server, server_messages, TEST_SOCKET_MESSAGES));
+    ASSERT(SOCKET_POLL_OUT == test_socket_poll(client, SOCKET_POLL_IN | SOCKET_POLL_OUT));
+
+    // a batch goes out as one stream
+    uint8_t message[] = {"hello, world"};
+    test_socket_message(&(client_messages[0]), message, 5);
+    test_socket_message(&(client_messages[1]), message + 5, sizeof(message) - 5);
+    ASSERT(2 == socket_send(client, 2));
+    ASSERT(SOCKET_POLL_IN & test_socket_poll(server, SOCKET_POLL_IN));
+    ASSERT(1 == socket_receive(server, TEST_SOCKET_MESSAGES));
+    ASSERT(sizeof(message) == server_messages[0].size);
+    ASSERT(0 == memcmp(server_messages[0].data, message, sizeof(message)));
+    ASSERT(0 == socket_receive(server, TEST_SOCKET_MESSAGES));
+
+    // the client closes; the server sees the end of the stream
+    socket_close(client);
+    ASSERT(SOCKET_POLL_HUP == test_socket_poll(server, SOCKET_POLL_IN));
+    ASSERT(0 == socket_receive(server, TEST_SOCKET_MESSAGES));
+
+    socket_close(server);
+    socket_close(listener);
+    kfree(server_messages);
+    kfree(client_messages);
+
+    // the client's end sits in TIME_WAIT for a while
+    struct objectinterface_tcp* tcp_api = (struct objectinterface_tcp*)tcp->api;
+    for (uint16_t i = 0; i < 128; i++) {
+        (*tcp_api->tick)(tcp);
+    }
+}
+
+void test_socket() {
+    kprintf("Testing Sockets\n");
+
+    // a whole stack on a loopback NIC
+    struct object* lo = loopback_attach();
+    struct object* eth = ethernet_attach(lo);
+    struct object* arp = arp_attach(eth);
+    struct object* ip = ip_attach(eth, arp);
+    struct object* tcp = tcp_attach(ip, 0);
+    struct object* udp = udp_attach(ip);
+    uint32_t address = IP_ADDRESS(127, 0, 0, 1);
+    struct objectinterface_ip* ip_api = (struct objectinterface_ip*)ip->api;
+    (*ip_api->configure)(ip, address, IP_ADDRESS(255, 0, 0, 0), 0);
+
+    // only TCP and UDP objects carry sockets
+    ASSERT(0 == socket_open(ip));
+
+    test_socket_dgram(udp, address);
+    test_socket_stream(tcp, address);
+
+    // a process's sockets are closed when it terminates
+    uint64_t socket = socket_open(udp);
+    ASSERT(0 != socket);
+    linkedlist* task = get_current_task(CUR_CPU, CUR_CORE);
+    socket_close_process((0 != task) ? TASK_DATA(task)->pid : 0);
+    ASSERT(SOCKET_POLL_NVAL == test_socket_poll(socket, SOCKET_POLL_IN));
+
+    udp_detach(udp);
+    tcp_detach(tcp);
+    ip_detach(ip);
+    arp_detach(arp);
+    ethernet_detach(eth);
+    loopback_detach(lo);
+}
@@ -0,0 +1,78 @@
+//*****************************************************************
+// This file is part of CosmOS                                    *
+// Copyright (C) 2021 Tom Everett                                 *
+// Released under the stated terms in the file LICENSE            *
+// See the file "LICENSE" in the source distribution for details  *
+// ****************************************************************
+
+#include <sys/collection/spscring/spscring.h>
+#include <sys/debug/assert.h>
+#include <sys/kprintf/kprintf.h>
+#include <tests/sys/test_spscring.h>
+
+uint8_t test_spscring_same(uint8_t* a, uint8_t* b, uint32_t len) {
+    for (uint32_t i = 0; i < len; i++) {
+        if (a[i] != b[i]) {
+            return 0;
+        }
+    }
+    return 1;
+}
+
+void test_spscring() {
+    kprintf("Testing spscring\n");
+
+    // rounded up to a power of two
+    struct spscring* ring = spscring_new(6);
+    ASSERT(spscring_size(ring) == 8);
+    ASSERT(spscring_count(ring) == 0);
+    ASSERT(spscring_space(ring) == 8);
+
+    /*
+     * single bytes
+     */
+    uint8_t c = 0;
+    ASSERT(!spscring_get(ring, &c));
+    ASSERT(spscring_put(ring, 'A'));
+    ASSERT(spscring_put(ring, 'B'));
+    ASSERT(spscring_count(ring) == 2);
+    ASSERT(spscring_get(ring, &c));
+    ASSERT(c == 'A');
+    ASSERT(spscring_get(ring, &c));
+    ASSERT(c == 'B');
+    ASSERT(!spscring_get(ring, &c));
+
+    /*
+     * bulk, wrapping round the end of the array
+     */
+    uint8_t in[] = {"0123456789"};
+    uint8_t out[10];
+    ASSERT(spscring_put_bulk(ring, in, 5) == 5);
+    ASSERT(spscring_get_bulk(ring, out, 10) == 5);
+    ASSERT(test_spscring_same(out, in, 5));
+
+    // only 8 fit
+    ASSERT(spscring_put_bulk(ring, in, 10) == 8);
+    ASSERT(spscring_space(ring) == 0);
+    ASSERT(!spscring_put(ring, 'X'));
+    ASSERT(spscring_get_bulk(ring, out, 3) == 3);
+    ASSERT(test_spscring_same(out, in, 3));
+    ASSERT(spscring_get_bulk(ring, out, 10) == 5);
+    ASSERT(test_spscring_same(out, &(in[3]), 5));
+    ASSERT(spscring_count(ring) == 0);
+
+    /*
+     * peeking leaves the bytes in place until they are discarded
+     */
+    ASSERT(spscring_put_bulk(ring, in, 6) == 6);
+    ASSERT(spscring_peek_bulk(ring, 2, out, 10) == 4);
+    ASSERT(test_spscring_same(out, &(in[2]), 4));
+    ASSERT(spscring_peek_bulk(ring, 6, out, 10) == 0);
+    ASSERT(spscring_count(ring) == 6);
+    ASSERT(spscring_discard(ring, 4) == 4);
+    ASSERT(spscring_get_bulk(ring, out, 10) == 2);
+    ASSERT(test_spscring_same(out, &(in[4]), 2));
+    ASSERT(spscring_discard(ring, 1) == 0);
+
+    spscring_delete(ring);
+}
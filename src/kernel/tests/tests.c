@@ -5,61 +5,95 @@
 // See the file "LICENSE" in the source distribution for details  *
 // ****************************************************************
 
+#include <tests/fs/test_cfs.h>
+#include <tests/fs/test_dcache.h>
 #include <tests/fs/test_devfs.h>
 #include <tests/fs/test_fat.h>
 #include <tests/fs/test_gpt.h>
 #include <tests/fs/test_initrd.h>
+#include <tests/fs/test_pagecache.h>
+#include <tests/fs/test_sfs.h>
 #include <tests/fs/test_swap.h>
+#include <tests/fs/test_tfs.h>
 #include <tests/fs/test_voh.h>
+#include <tests/obj/test_arp.h>
 #include <tests/obj/test_ata.h>
 #include <tests/obj/test_bda.h>
+#include <tests/obj/test_checksum.h>
 #include <tests/obj/test_kernelmap.h>
 #include <tests/obj/test_null.h>
 #include <tests/obj/test_ramdisk.h>
 #include <tests/obj/test_rand.h>
 #include <tests/obj/test_serializer.h>
 #include <tests/obj/test_smbios.h>
+#include <tests/obj/test_tcp.h>
+#include <tests/obj/test_udp.h>
 #include <tests/sys/test_array.h>
 #include <tests/sys/test_arraylist.h>
 #include <tests/sys/test_bitmap.h>
 #include <tests/sys/test_dynabuffer.h>
 #include <tests/sys/test_init_loader.h>
 #include <tests/sys/test_iobuffers.h>
+#include <tests/sys/test_kpool.h>
 #include <tests/sys/test_linkedlist.h>
+#include <tests/sys/test_lz4.h>
 #include <tests/sys/test_malloc.h>
+#include <tests/sys/test_netbuf.h>
+#include <tests/sys/test_netpoll.h>
+#include <tests/sys/test_objects.h>
 #include <tests/sys/test_props.h>
+#include <tests/sys/test_reclaim.h>
 #include <tests/sys/test_ringbuffer.h>
+#include <tests/sys/test_socket.h>
+#include <tests/sys/test_spscring.h>
 #include <tests/sys/test_string.h>
 #include <tests/sys/test_tree.h>
 #include <tests/tests.h>
 
 void tests_run() {
     test_malloc();
+    test_kpool();
     test_array();
     test_arraylist();
     test_ringbuffer();
+    test_spscring();
     test_linkedlist();
     test_tree();
     test_string();
     test_bitmap();
+    test_lz4();
     test_iobuffers();
+    test_netbuf();
+    test_netpoll();
     test_voh();
+    test_dcache();
     test_devfs();
     test_gpt();
     test_bda();
     test_smbios();
     test_ramdisk();
     test_swap();
+    test_tfs();
+    test_pagecache();
+    test_cfs();
+    test_sfs();
+    test_initrd_formats();
+    test_reclaim();
     test_rand();
     test_null();
+    test_checksum();
+    test_arp();
+    test_udp();
+    test_tcp();
+    test_socket();
     //    test_initrd();
     test_ata();
     //  test_init_loader();
-    //test_objects();
+    test_objects();
     test_kernelmap();
     test_dynabuffer();
     test_serializer();
     //test_mm();
-    //test_fat();
+    test_fat();
     test_props();
 }
@@ -126,3 +126,75 @@ uint64_t syscall_bga_blt(uint64_t object, uint8_t* buffer, uint64_t size) {
     args.arg3 = size;
     return syscall(SYSCALL_BGA_BLT, &args);
 }
+
+uint64_t syscall_socket_open(uint64_t type) {
+    struct syscall_args args;
+    args.arg1 = type;
+    args.arg2 = 0;
+    args.arg3 = 0;
+    return syscall(SYSCALL_SOCKET_OPEN, &args);
+}
+
+uint64_t syscall_socket_bind(uint64_t socket, uint16_t port) {
+    struct syscall_args args;
+    args.arg1 = socket;
+    args.arg2 = port;
+    args.arg3 = 0;
+    return syscall(SYSCALL_SOCKET_BIND, &args);
+}
+
+uint64_t syscall_socket_connect(uint64_t socket, uint32_t ip, uint16_t port) {
+    struct syscall_args args;
+    args.arg1 = socket;
+    args.arg2 = ip;
+    args.arg3 = port;
+    return syscall(SYSCALL_SOCKET_CONNECT, &args);
+}
+
+uint64_t syscall_socket_accept(uint64_t socket) {
+    struct syscall_args args;
+    args.arg1 = socket;
+    args.arg2 = 0;
+    args.arg3 = 0;
+    return syscall(SYSCALL_SOCKET_ACCEPT, &args);
+}
+
+uint64_t syscall_socket_register(uint64_t socket, struct syscall_socket_message* messages, uint16_t count) {
+    struct syscall_args args;
+    args.arg1 = socket;
+    args.arg2 = (uint64_t)messages;
+    args.arg3 = count;
+    return syscall(SYSCALL_SOCKET_REGISTER, &args);
+}
+
+uint64_t syscall_socket_send(uint64_t socket, uint16_t count) {
+    struct syscall_args args;
+    args.arg1 = socket;
+    args.arg2 = count;
+    args.arg3 = 0;
+    return syscall(SYSCALL_SOCKET_SEND, &args);
+}
+
+uint64_t syscall_socket_receive(uint64_t socket, uint16_t count) {
+    struct syscall_args args;
+    args.arg1 = socket;
+    args.arg2 = count;
+    args.arg3 = 0;
+    return syscall(SYSCALL_SOCKET_RECEIVE, &args);
+}
+
+uint64_t syscall_socket_poll(struct syscall_socket_poll* polls, uint16_t count) {
+    struct syscall_args args;
+    args.arg1 = (uint64_t)polls;
+    args.arg2 = count;
+    args.arg3 = 0;
+    return syscall(SYSCALL_SOCKET_POLL, &args);
+}
+
+uint64_t syscall_socket_close(uint64_t socket) {
+    struct syscall_args args;
+    args.arg1 = socket;
+    args.arg2 = 0;
+    args.arg3 = 0;
+    return syscall(SYSCALL_SOCKET_CLOSE, &args);
+}
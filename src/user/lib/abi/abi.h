@@ -49,4 +49,38 @@ uint64_t syscall_bga_set_resolution(uint64_t object, struct syscall_objectinterf
 uint64_t syscall_bga_get_buffersize(uint64_t object);
 uint64_t syscall_bga_blt(uint64_t object, uint8_t* buffer, uint64_t size);
 
+// socket; these match the kernel's socket.h
+#define SYSCALL_SOCKET_TYPE_STREAM 1
+#define SYSCALL_SOCKET_TYPE_DGRAM 2
+#define SYSCALL_SOCKET_MESSAGES_MAX 64
+#define SYSCALL_SOCKET_MESSAGE_DATA 1472
+#define SYSCALL_SOCKET_POLL_IN 0x01
+#define SYSCALL_SOCKET_POLL_OUT 0x02
+#define SYSCALL_SOCKET_POLL_HUP 0x04
+#define SYSCALL_SOCKET_POLL_NVAL 0x08
+
+struct syscall_socket_message {
+    uint32_t ip;
+    uint16_t port;
+    uint16_t size;
+    uint8_t data[SYSCALL_SOCKET_MESSAGE_DATA];
+} __attribute__((packed));
+
+struct syscall_socket_poll {
+    uint64_t socket;
+    uint16_t events;
+    uint16_t revents;
+    uint32_t reserved;
+} __attribute__((packed));
+
+uint64_t syscall_socket_open(uint64_t type);
+uint64_t syscall_socket_bind(uint64_t socket, uint16_t port);
+uint64_t syscall_socket_connect(uint64_t socket, uint32_t ip, uint16_t port);
+uint64_t syscall_socket_accept(uint64_t socket);
+uint64_t syscall_socket_register(uint64_t socket, struct syscall_socket_message* messages, uint16_t count);
+uint64_t syscall_socket_send(uint64_t socket, uint16_t count);
+uint64_t syscall_socket_receive(uint64_t socket, uint16_t count);
+uint64_t syscall_socket_poll(struct syscall_socket_poll* polls, uint16_t count);
+uint64_t syscall_socket_close(uint64_t socket);
+
 #endif
\ No newline at end of file
@@ -37,6 +37,16 @@
 // object mgr
 #define SYSCALL_OBJMGR_GET_DEVICE_BY_NAME 2800
 #define SYSCALL_OBJMGR_GET_DEVICE_BY_HANDLE 2801
+// socket
+#define SYSCALL_SOCKET_OPEN 2900
+#define SYSCALL_SOCKET_BIND 2901
+#define SYSCALL_SOCKET_CONNECT 2902
+#define SYSCALL_SOCKET_ACCEPT 2903
+#define SYSCALL_SOCKET_REGISTER 2904
+#define SYSCALL_SOCKET_SEND 2905
+#define SYSCALL_SOCKET_RECEIVE 2906
+#define SYSCALL_SOCKET_POLL 2907
+#define SYSCALL_SOCKET_CLOSE 2908
 
 struct syscall_args {
     uint64_t arg1;
@@ -22,6 +22,7 @@ extern "C" {
 #include <new.hpp>
 #include <object/objects.hpp>
 #include <process.hpp>
+#include <socket.hpp>
 #include <string.hpp>
 
 #endif
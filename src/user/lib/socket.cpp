@@ -0,0 +1,81 @@
+//*****************************************************************
+// This file is part of CosmOS                                    *
+// Copyright (C) 2021 Tom Everett                                 *
+// Released under the stated terms in the file LICENSE            *
+// See the file "LICENSE" in the source distribution for details  *
+// ****************************************************************
+
+extern "C" {
+#include <malloc.h>
+}
+#include <assert.hpp>
+#include <socket.hpp>
+
+Socket::Socket(uint64_t socket) {
+    this->socket = socket;
+    this->messages =
+        (struct syscall_socket_message*)malloc(SOCKET_MESSAGES * sizeof(struct syscall_socket_message));
+    ASSERT_NOT_NULL(this->messages);
+    syscall_socket_register(socket, this->messages, SOCKET_MESSAGES);
+}
+
+Socket::~Socket() {
+    syscall_socket_close(this->socket);
+    free(this->messages);
+}
+
+Socket* Socket::open(uint8_t type) {
+    uint64_t socket = syscall_socket_open(type);
+    if (0 == socket) {
+        return 0;
+    }
+    return new Socket(socket);
+}
+
+bool Socket::bind(uint16_t port) {
+    return (0 != syscall_socket_bind(this->socket, port));
+}
+
+bool Socket::connect(uint32_t ip, uint16_t port) {
+    return (0 != syscall_socket_connect(this->socket, ip, port));
+}
+
+Socket* Socket::accept() {
+    uint64_t socket = syscall_socket_accept(this->socket);
+    if (0 == socket) {
+        return 0;
+    }
+    return new Socket(socket);
+}
+
+struct syscall_socket_message* Socket::message(uint16_t i) {
+    ASSERT(i < SOCKET_MESSAGES);
+    return &(this->messages[i]);
+}
+
+uint16_t Socket::send(uint16_t count) {
+    ASSERT(count <= SOCKET_MESSAGES);
+    return syscall_socket_send(this->socket, count);
+}
+
+uint16_t Socket::receive() {
+    return syscall_socket_receive(this->socket, SOCKET_MESSAGES);
+}
+
+uint16_t Socket::poll(uint16_t events) {
+    struct syscall_socket_poll p;
+    p.socket = this->socket;
+    p.events = events;
+    p.revents = 0;
+    syscall_socket_poll(&p, 1);
+    return p.revents;
+}
+
+uint16_t Socket::poll(struct syscall_socket_poll* polls, uint16_t count) {
+    ASSERT_NOT_NULL(polls);
+    return syscall_socket_poll(polls, count);
+}
+
+uint64_t Socket::getDescriptor() {
+    return this->socket;
+}
@@ -0,0 +1,42 @@
+//*****************************************************************
+// This file is part of CosmOS                                    *
+// Copyright (C) 2021 Tom Everett                                 *
+// Released under the stated terms in the file LICENSE            *
+// See the file "LICENSE" in the source distribution for details  *
+// ****************************************************************
+/*
+* userland wrapper for kernel sockets.  each socket registers its own array of messages with the kernel; fill in
+* the first n and send(n) sends them all in one syscall, and receive() fills in as many as are waiting.
+*/
+#ifndef _SOCKET_HPP
+#define _SOCKET_HPP
+
+extern "C" {
+#include <abi/abi.h>
+}
+#include <types.h>
+
+#define SOCKET_MESSAGES 16  // messages in a socket's batch
+
+class Socket {
+  private:
+    uint64_t socket;
+    struct syscall_socket_message* messages;
+    Socket(uint64_t socket);
+
+  public:
+    ~Socket();
+    // SYSCALL_SOCKET_TYPE_STREAM or SYSCALL_SOCKET_TYPE_DGRAM; 0 if the kernel has no more sockets
+    static Socket* open(uint8_t type);
+    bool bind(uint16_t port);
+    bool connect(uint32_t ip, uint16_t port);
+    Socket* accept();
+    struct syscall_socket_message* message(uint16_t i);
+    uint16_t send(uint16_t count);
+    uint16_t receive();
+    uint16_t poll(uint16_t events);
+    static uint16_t poll(struct syscall_socket_poll* polls, uint16_t count);
+    uint64_t getDescriptor();
+};
+
+#endif
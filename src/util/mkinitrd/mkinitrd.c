@@ -7,98 +7,270 @@
 
 // http://www.jamesmolloy.co.uk/tutorial_html/8.-The%20VFS%20and%20the%20initrd.html
 
+/*
+ * writes a version 2 initrd: a header, an index sorted by name, then the files.  files are compressed a 64KB chunk
+ * at a time, as LZ4 blocks, unless -u is given.  files stored as they are start on a page boundary, and are padded
+ * with zeros to the next, so the kernel can map them.  see obj/logical/fs/initrd/initrd.h in the kernel
+ */
+
 #include <dirent.h>
+#include <stdint.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 
 #define INITRD_NAME_SIZE 64
-#define INITRD_MAX_FILES 64
+#define INITRD_MAGIC "CSINITRD"
+#define INITRD_VERSION 2
+#define INITRD_CHUNK_SIZE (64 * 1024)
+#define INITRD_COMPRESSION_NONE 0
+#define INITRD_COMPRESSION_LZ4 1
+#define INITRD_PAGE_SIZE 4096
 
 #define INITRD_IMAGE_NAME "./initrd.img"
 
-struct initrd_file_header {
-    unsigned char magic;
-    char name[INITRD_NAME_SIZE];
-    unsigned int offset;
-    unsigned int length;
-};
+struct initrd2_header {
+    uint8_t magic[8];
+    uint32_t version;
+    uint32_t entry_size;
+    uint64_t number_files;
+    uint64_t index_offset;
+    uint64_t image_size;
+    uint8_t reserved[24];
+} __attribute__((packed));
 
-struct initrd_fs_header {
-    int nheaders;
-    struct initrd_file_header headers[INITRD_MAX_FILES];
-};
+struct initrd2_entry {
+    char name[INITRD_NAME_SIZE];
+    uint64_t offset;
+    uint64_t length;
+    uint64_t stored_length;
+    uint32_t compression;
+    uint32_t reserved;
+} __attribute__((packed));
 
 struct f {
-    char longname[INITRD_NAME_SIZE];
+    char* longname;
     char shortname[INITRD_NAME_SIZE];
+    unsigned char* stored;  // as it goes in the image
 };
 
 struct filenames {
     int count;
-    struct f names[INITRD_MAX_FILES];
+    int capacity;
+    struct f* names;
 };
 
 /*
-* fill the structure fs_header
+ * LZ4 block format.  https://github.com/lz4/lz4/blob/dev/doc/lz4_Block_format.md
+ */
+#define LZ4_HASH_BITS 12
+#define LZ4_MIN_MATCH 4
+#define LZ4_LAST_LITERALS 5  // a block ends with at least this many literals
+#define LZ4_MATCH_LIMIT 12   // and no match starts this close to the end
+#define LZ4_MAX_OFFSET 65535
+
+static uint32_t lz4_read32(const unsigned char* p) {
+    uint32_t ret;
+    memcpy(&ret, p, sizeof(ret));
+    return ret;
+}
+
+static uint32_t lz4_hash(uint32_t v) {
+    return (v * 2654435761U) >> (32 - LZ4_HASH_BITS);
+}
+
+static unsigned char* lz4_length(unsigned char* op, uint32_t length) {
+    while (length >= 255) {
+        *op++ = 255;
+        length -= 255;
+    }
+    *op++ = length;
+    return op;
+}
+
+static unsigned char* lz4_sequence(unsigned char* op, const unsigned char* literals, uint32_t literal_count,
+                                   uint32_t offset, uint32_t match) {
+    unsigned char* token = op++;
+    *token = (literal_count >= 15 ? 15 : literal_count) << 4;
+    if (literal_count >= 15) {
+        op = lz4_length(op, literal_count - 15);
+    }
+    memcpy(op, literals, literal_count);
+    op += literal_count;
+    if (0 == match) {
+        return op;
+    }
+    *op++ = offset & 0xFF;
+    *op++ = offset >> 8;
+    match -= LZ4_MIN_MATCH;
+    *token |= (match >= 15 ? 15 : match);
+    if (match >= 15) {
+        op = lz4_length(op, match - 15);
+    }
+    return op;
+}
+
+/*
+ * greedy.  dst needs room for n + n/255 + 16 bytes.  returns the compressed size
+ */
+static uint32_t lz4_compress(const unsigned char* src, uint32_t n, unsigned char* dst) {
+    uint32_t table[1 << LZ4_HASH_BITS];  // position + 1, 0 if none
+    memset(table, 0, sizeof(table));
+    unsigned char* op = dst;
+    uint32_t anchor = 0;
+    uint32_t ip = 0;
+    while ((n > LZ4_MATCH_LIMIT) && (ip < (n - LZ4_MATCH_LIMIT))) {
+        uint32_t h = lz4_hash(lz4_read32(&src[ip]));
+        uint32_t ref = table[h];
+        table[h] = ip + 1;
+        if ((0 == ref) || ((ip - (ref - 1)) > LZ4_MAX_OFFSET) || (lz4_read32(&src[ref - 1]) != lz4_read32(&src[ip]))) {
+            ip++;
+            continue;
+        }
+        ref -= 1;
+        uint32_t match = LZ4_MIN_MATCH;
+        while (((ip + match) < (n - LZ4_LAST_LITERALS)) && (src[ref + match] == src[ip + match])) {
+            match++;
+        }
+        op = lz4_sequence(op, &src[anchor], ip - anchor, ip - ref, match);
+        ip += match;
+        anchor = ip;
+    }
+    op = lz4_sequence(op, &src[anchor], n - anchor, 0, 0);
+    return op - dst;
+}
+
+/*
+ * a table of chunk offsets, then the chunks.  0 if that's no smaller than the file
+ */
+uint64_t compress_file(const unsigned char* data, uint64_t length, unsigned char** stored) {
+    uint64_t chunks = (length + INITRD_CHUNK_SIZE - 1) / INITRD_CHUNK_SIZE;
+    uint64_t table_size = (chunks + 1) * sizeof(uint64_t);
+    unsigned char* ret = (unsigned char*)malloc(table_size + length + (chunks * ((INITRD_CHUNK_SIZE / 255) + 16)));
+    uint64_t* table = (uint64_t*)ret;
+    uint64_t off = table_size;
+    for (uint64_t c = 0; c < chunks; c++) {
+        uint32_t size = INITRD_CHUNK_SIZE;
+        if (c == (chunks - 1)) {
+            size = length - (c * INITRD_CHUNK_SIZE);
+        }
+        table[c] = off;
+        uint32_t compressed = lz4_compress(&data[c * INITRD_CHUNK_SIZE], size, &ret[off]);
+        if (compressed >= size) {
+            // stored as it is
+            memcpy(&ret[off], &data[c * INITRD_CHUNK_SIZE], size);
+            compressed = size;
+        }
+        off += compressed;
+    }
+    table[chunks] = off;
+    if (off >= length) {
+        free(ret);
+        return 0;
+    }
+    *stored = ret;
+    return off;
+}
+
+unsigned char* read_file(const char* name, uint64_t* length) {
+    FILE* stream = fopen(name, "r");
+    if (stream == 0) {
+        printf("Error: file not found: %s\n", name);
+        exit(1);
+    }
+    fseek(stream, 0, SEEK_END);
+    *length = ftell(stream);
+    fseek(stream, 0, SEEK_SET);
+    unsigned char* ret = (unsigned char*)malloc(*length + 1);
+    if (*length != fread(ret, 1, *length, stream)) {
+        printf("Error: can't read %s\n", name);
+        exit(1);
+    }
+    fclose(stream);
+    return ret;
+}
+
+int compare_names(const void* a, const void* b) {
+    return strcmp(((const struct f*)a)->shortname, ((const struct f*)b)->shortname);
+}
+
+uint64_t page_align(uint64_t off) {
+    return ((off + INITRD_PAGE_SIZE - 1) / INITRD_PAGE_SIZE) * INITRD_PAGE_SIZE;
+}
+
+/*
+* fill the index, and compress the files
 */
-unsigned int makeheaders(struct initrd_fs_header* fs_header, struct filenames* fns) {
-    unsigned int off = sizeof(struct initrd_fs_header);
-    for (int i = 0; i < fs_header->nheaders; i++) {
-        char* shortname = fns->names[i].shortname;
-        char* longname = fns->names[i].longname;
-        printf("writing file '%s' -> '%s' at 0x%x\n", longname, shortname, off);
-        strcpy(fs_header->headers[i].name, shortname);
-        fs_header->headers[i].offset = off;
-        FILE* stream = fopen(longname, "r");
-        if (stream == 0) {
-            printf("Error: file not found: %s\n", longname);
-            return 1;
+uint64_t makeindex(struct initrd2_entry* index, struct filenames* fns, int compress) {
+    uint64_t off = sizeof(struct initrd2_header) + (fns->count * sizeof(struct initrd2_entry));
+    for (int i = 0; i < fns->count; i++) {
+        struct f* fn = &(fns->names[i]);
+        uint64_t length = 0;
+        unsigned char* data = read_file(fn->longname, &length);
+        strcpy(index[i].name, fn->shortname);
+        index[i].offset = off;
+        index[i].length = length;
+        index[i].stored_length = 0;
+        if (compress) {
+            index[i].stored_length = compress_file(data, length, &(fn->stored));
+        }
+        if (0 == index[i].stored_length) {
+            off = page_align(off);
+            index[i].offset = off;
+            index[i].compression = INITRD_COMPRESSION_NONE;
+            index[i].stored_length = length;
+            fn->stored = data;
+        } else {
+            index[i].compression = INITRD_COMPRESSION_LZ4;
+            free(data);
+        }
+        printf("writing file '%s' -> '%s' at 0x%llx, %llu bytes as %llu\n", fn->longname, fn->shortname,
+               (unsigned long long)off, (unsigned long long)length, (unsigned long long)index[i].stored_length);
+        off += index[i].stored_length;
+        if (INITRD_COMPRESSION_NONE == index[i].compression) {
+            off = page_align(off);
         }
-        fseek(stream, 0, SEEK_END);
-        fs_header->headers[i].length = ftell(stream);
-        off += fs_header->headers[i].length;
-        fclose(stream);
-        fs_header->headers[i].magic = 0xBF;
     }
     return off;
 }
 
 /*
-* write the header and files
+* write the header, index and files
 */
-void addfiles(struct initrd_fs_header* fs_header, struct filenames* fns, unsigned int off) {
+void addfiles(struct initrd2_header* fs_header, struct initrd2_entry* index, struct filenames* fns) {
     FILE* wstream = fopen(INITRD_IMAGE_NAME, "w");
-    /*
-    * write the headers
-    */
-    fwrite(fs_header, sizeof(struct initrd_fs_header), 1, wstream);
-
-    /*
-    * write the files
-    */
-    unsigned char* data = (unsigned char*)malloc(off);
-    for (int i = 0; i < fs_header->nheaders; i++) {
-        char* longname = fns->names[i].longname;
-        FILE* stream = fopen(longname, "r");
-        unsigned char* buf = (unsigned char*)malloc(fs_header->headers[i].length);
-        fread(buf, 1, fs_header->headers[i].length, stream);
-        fwrite(buf, 1, fs_header->headers[i].length, wstream);
-        fclose(stream);
-        free(buf);
+    fwrite(fs_header, sizeof(struct initrd2_header), 1, wstream);
+    fwrite(index, sizeof(struct initrd2_entry), fns->count, wstream);
+    uint64_t off = sizeof(struct initrd2_header) + (fns->count * sizeof(struct initrd2_entry));
+    for (int i = 0; i < fns->count; i++) {
+        // padding
+        for (; off < index[i].offset; off++) {
+            fputc(0, wstream);
+        }
+        fwrite(fns->names[i].stored, 1, index[i].stored_length, wstream);
+        free(fns->names[i].stored);
+        off += index[i].stored_length;
+    }
+    for (; off < fs_header->image_size; off++) {
+        fputc(0, wstream);
     }
     fclose(wstream);
-    free(data);
 }
 
 void addfile(struct filenames* fns, char* fn) {
-    strcpy((fns->names[fns->count].longname), fn);
     char* c = strrchr(fn, '/');
-    if (0 == c) {
-        strcpy((fns->names[fns->count].shortname), fn);
-    } else {
-        strcpy((fns->names[fns->count].shortname), c + 1);
+    char* shortname = (0 == c) ? fn : c + 1;
+    if (strlen(shortname) >= INITRD_NAME_SIZE) {
+        printf("Error: name too long: %s\n", shortname);
+        exit(1);
+    }
+    if (fns->count == fns->capacity) {
+        fns->capacity = (0 == fns->capacity) ? 64 : fns->capacity * 2;
+        fns->names = (struct f*)realloc(fns->names, fns->capacity * sizeof(struct f));
     }
+    memset(&(fns->names[fns->count]), 0, sizeof(struct f));
+    fns->names[fns->count].longname = strdup(fn);
+    strcpy(fns->names[fns->count].shortname, shortname);
     fns->count = fns->count + 1;
 }
 
@@ -110,9 +282,7 @@ void fillnames(char* dirname, struct filenames* fns) {
             if ((0 != strcmp(dir->d_name, "..")) && (0 != strcmp(dir->d_name, "."))) {
                 char fn[1024];
                 strcpy(fn, dirname);
-                //                strcat(fn, "/");
                 strcat(fn, dir->d_name);
-                //     printf("%s\n", fn);
                 addfile(fns, fn);
             }
         }
@@ -126,36 +296,46 @@ int main(int argc, char** argv) {
     * fn list
     */
     struct filenames fns;
-    fns.count = 0;
+    memset(&fns, 0, sizeof(struct filenames));
+    int compress = 1;
     /*
     * walk args
     */
-    int nargs = argc - 1;
-    for (int i = 1; i <= nargs; i++) {
+    for (int i = 1; i < argc; i++) {
         char* a = argv[i];
-        if (a[strlen(a) - 1] == '/') {
+        if (0 == strcmp(a, "-u")) {
+            compress = 0;
+        } else if (a[strlen(a) - 1] == '/') {
             fillnames(a, &fns);
         } else {
             addfile(&fns, a);
         }
     }
-    //
-    /*
-    * make the fs header
-    */
-    struct initrd_fs_header fs_header;
-    memset(&fs_header, 0, sizeof(struct initrd_fs_header));
-    fs_header.nheaders = fns.count;
-    printf("Size of filesystem header: %lu\n", sizeof(struct initrd_fs_header));
-    printf("Size of initrd file header: %lu\n", sizeof(struct initrd_file_header));
-
-    /*
-    * add the headers, return the current file offset
-    */
-    unsigned int off = makeheaders(&fs_header, &fns);
     /*
-    * add files
+    * the kernel finds files by binary search
     */
-    addfiles(&fs_header, &fns, off);
+    qsort(fns.names, fns.count, sizeof(struct f), &compare_names);
+    for (int i = 1; i < fns.count; i++) {
+        if (0 == strcmp(fns.names[i - 1].shortname, fns.names[i].shortname)) {
+            printf("Error: two files called %s\n", fns.names[i].shortname);
+            return 1;
+        }
+    }
+    struct initrd2_entry* index = (struct initrd2_entry*)calloc(fns.count + 1, sizeof(struct initrd2_entry));
+    struct initrd2_header fs_header;
+    memset(&fs_header, 0, sizeof(struct initrd2_header));
+    memcpy(fs_header.magic, INITRD_MAGIC, sizeof(fs_header.magic));
+    fs_header.version = INITRD_VERSION;
+    fs_header.entry_size = sizeof(struct initrd2_entry);
+    fs_header.number_files = fns.count;
+    fs_header.index_offset = sizeof(struct initrd2_header);
+    fs_header.image_size = makeindex(index, &fns, compress);
+    printf("%d files, %llu bytes\n", fns.count, (unsigned long long)fs_header.image_size);
+    addfiles(&fs_header, index, &fns);
+    for (int i = 0; i < fns.count; i++) {
+        free(fns.names[i].longname);
+    }
+    free(fns.names);
+    free(index);
     return 0;
-}
\ No newline at end of file
+}